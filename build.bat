@@ -24,8 +24,14 @@ echo Current directory: %CD%
 rc /r %scriptpath%\resources\resources.rc
 
 :: /GS (Buffer Security Check) - alternative to gcc -fsanitize=safe-stack
-cl /W4 /wd4146 /wd4245 /RTCcsu  /GS /TC /Zi /c %scriptpath%\code\%filename%.c /Fo%scriptpath%build\ /Fd%scriptpath%build\%filename%.pdb /Fe%scriptpath%build
+:: code\*.c - Win32 shell plus the portable history engine (history.c, textmatch.c, ...)
+cl /W4 /wd4146 /wd4245 /RTCcsu  /GS /TC /Zi /c %scriptpath%\code\*.c /Fo%scriptpath%build\ /Fd%scriptpath%build\%filename%.pdb /Fe%scriptpath%build
 
 :: /CETCOMPAT Shadow Stack compatible executable
-link -incremental:no /CETCOMPAT /DEBUG %scriptpath%\build\*.obj /SUBSYSTEM:windows /OUT:%scriptpath%\build\%filename%.exe user32.lib shell32.lib gdi32.lib Shlwapi.lib %scriptpath%\resources\resources.res
+link -incremental:no /CETCOMPAT /DEBUG %scriptpath%\build\*.obj /SUBSYSTEM:windows /OUT:%scriptpath%\build\%filename%.exe user32.lib shell32.lib gdi32.lib %scriptpath%\resources\resources.res
+
+:: mclip_query - command-line reader of the history snapshot (tools\mclip_query.c), with the
+:: engine files it uses. Objects go to build\tools\ to stay out of the mclip link above.
+if not exist %scriptpath%build\tools mkdir %scriptpath%build\tools
+cl /W4 /wd4146 /wd4245 /RTCcsu  /GS /TC /Zi %scriptpath%\tools\mclip_query.c %scriptpath%\code\snapshot.c %scriptpath%\code\platform.c %scriptpath%\code\utf8.c /Fo%scriptpath%build\tools\ /Fd%scriptpath%build\tools\mclip_query.pdb /Fe%scriptpath%build\mclip_query.exe /link /CETCOMPAT user32.lib
 
@@ -0,0 +1,156 @@
+#include "arena.h"
+
+#include <stdlib.h>
+
+struct ArenaChunk {
+    ArenaChunk* next;
+    size_t size;
+    // Padding keeps the payload 16-byte aligned on 32-bit targets as well
+    size_t reserved[2];
+};
+
+struct ArenaLarge {
+    ArenaLarge* prev;
+    ArenaLarge* next;
+    size_t size;
+    size_t reserved;
+};
+
+// Block sizes: 16-byte steps up to 128, then four classes per power of two
+static const size_t g_arenaClassSize[ARENA_CLASS_COUNT] = {
+      16,   32,   48,   64,   80,   96,  112,  128,
+     160,  192,  224,  256,  320,  384,  448,  512,
+     640,  768,  896, 1024, 1280, 1536, 1792, 2048,
+    2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192
+};
+
+// Smallest class that fits 'size' (size <= ARENA_MAX_CLASS)
+static int
+ArenaClassIndex(size_t size)
+{
+    int lo = 0, hi = ARENA_CLASS_COUNT - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (g_arenaClassSize[mid] >= size) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+// Largest class that fits inside 'size', or -1
+static int
+ArenaClassBelow(size_t size)
+{
+    int index = -1;
+    while (index + 1 < ARENA_CLASS_COUNT && g_arenaClassSize[index + 1] <= size) index++;
+    return index;
+}
+
+static void
+ArenaPush(Arena* arena, int classIndex, void* block)
+{
+    *(void**)block = arena->freeLists[classIndex];
+    arena->freeLists[classIndex] = block;
+}
+
+void
+ArenaInit(Arena* arena)
+{
+    *arena = (Arena){0};
+}
+
+void
+ArenaFree(Arena* arena)
+{
+    ArenaChunk* chunk = arena->chunks;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    ArenaLarge* large = arena->large;
+    while (large) {
+        ArenaLarge* next = large->next;
+        free(large);
+        large = next;
+    }
+    ArenaInit(arena);
+}
+
+static void*
+ArenaAllocLarge(Arena* arena, size_t size)
+{
+    ArenaLarge* large = malloc(sizeof(ArenaLarge) + size);
+    if (!large) return NULL;
+
+    large->prev = NULL;
+    large->next = arena->large;
+    large->size = size;
+    if (arena->large) arena->large->prev = large;
+    arena->large = large;
+
+    arena->bytesReserved += sizeof(ArenaLarge) + size;
+    return large + 1;
+}
+
+void*
+ArenaAlloc(Arena* arena, size_t size)
+{
+    if (size == 0) size = 1;
+
+    void* block;
+    if (size > ARENA_MAX_CLASS) {
+        block = ArenaAllocLarge(arena, size);
+        if (!block) return NULL;
+    } else {
+        int classIndex = ArenaClassIndex(size);
+        size_t classSize = g_arenaClassSize[classIndex];
+
+        if (arena->freeLists[classIndex]) {
+            block = arena->freeLists[classIndex];
+            arena->freeLists[classIndex] = *(void**)block;
+            arena->recycled++;
+        } else {
+            if (arena->bumpLeft < classSize) {
+                // Keep the tail of the old chunk usable for smaller requests
+                int tailClass = ArenaClassBelow(arena->bumpLeft);
+                if (tailClass >= 0) ArenaPush(arena, tailClass, arena->bump);
+
+                ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + ARENA_CHUNK_SIZE);
+                if (!chunk) return NULL;
+                chunk->next = arena->chunks;
+                chunk->size = ARENA_CHUNK_SIZE;
+                arena->chunks = chunk;
+                arena->bump = (unsigned char*)(chunk + 1);
+                arena->bumpLeft = ARENA_CHUNK_SIZE;
+                arena->bytesReserved += sizeof(ArenaChunk) + ARENA_CHUNK_SIZE;
+            }
+            block = arena->bump;
+            arena->bump += classSize;
+            arena->bumpLeft -= classSize;
+        }
+    }
+
+    arena->bytesUsed += size;
+    arena->allocations++;
+    return block;
+}
+
+void
+ArenaRelease(Arena* arena, void* block, size_t size)
+{
+    if (!block) return;
+    if (size == 0) size = 1;
+    arena->bytesUsed -= size;
+
+    if (size > ARENA_MAX_CLASS) {
+        ArenaLarge* large = (ArenaLarge*)block - 1;
+        if (large->prev) large->prev->next = large->next;
+        else arena->large = large->next;
+        if (large->next) large->next->prev = large->prev;
+        arena->bytesReserved -= sizeof(ArenaLarge) + large->size;
+        free(large);
+        return;
+    }
+    ArenaPush(arena, ArenaClassIndex(size), block);
+}
@@ -0,0 +1,44 @@
+#ifndef MCLIP_ARENA_H
+#define MCLIP_ARENA_H
+
+#include <stddef.h>
+
+// --- String Arena ---
+// Size-classed slab allocator owned by the history store. Small blocks are
+// bump-allocated out of large chunks; released blocks go onto a per-class free
+// list and are handed out again first, so ring-order eviction recycles the
+// memory of the evicted entry for the next insert instead of going back to the
+// general-purpose heap. Blocks above ARENA_MAX_CLASS use malloc directly.
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_MAX_CLASS 8192
+#define ARENA_CLASS_COUNT 32
+
+typedef struct ArenaChunk ArenaChunk;
+typedef struct ArenaLarge ArenaLarge;
+
+typedef struct {
+    void* freeLists[ARENA_CLASS_COUNT]; // Recycled blocks, one list per size class
+    ArenaChunk* chunks;                 // All slab chunks (newest first)
+    ArenaLarge* large;                  // Oversized blocks (doubly linked)
+    unsigned char* bump;                // Next free byte in the newest chunk
+    size_t bumpLeft;                    // Bytes left in the newest chunk
+
+    size_t bytesUsed;                   // Bytes requested by live allocations
+    size_t bytesReserved;               // Chunks + oversized blocks obtained from the heap
+    size_t allocations;                 // Total ArenaAlloc calls that succeeded
+    size_t recycled;                    // ... of which were served from a free list
+} Arena;
+
+void ArenaInit(Arena* arena);
+
+// Returns all memory to the heap; every block handed out becomes invalid
+void ArenaFree(Arena* arena);
+
+// Allocates 'size' bytes (16-byte aligned). NULL on failure.
+void* ArenaAlloc(Arena* arena, size_t size);
+
+// Gives a block back. 'size' must be the size passed to ArenaAlloc.
+void ArenaRelease(Arena* arena, void* block, size_t size);
+
+#endif // MCLIP_ARENA_H
@@ -0,0 +1,224 @@
+#include "blobstore.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// --- Hashing ---
+
+static inline uint64_t
+BlobRotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+BlobMix(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+// 64-bit load from any alignment. Native order: every mclip target is
+// little-endian, where this is MurmurHash3's reference byte order.
+static inline uint64_t
+BlobLoad64(const unsigned char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+BlobHash
+BlobHash128(const void* data, size_t size)
+{
+    const unsigned char* bytes = data;
+    const uint64_t c1 = 0x87c37b91114253d5ull;
+    const uint64_t c2 = 0x4cf5ad432745937full;
+    uint64_t h1 = 0, h2 = 0;
+
+    size_t blocks = size / 16;
+    for (size_t i = 0; i < blocks; ++i) {
+        uint64_t k1 = BlobLoad64(bytes + i * 16);
+        uint64_t k2 = BlobLoad64(bytes + i * 16 + 8);
+
+        k1 *= c1; k1 = BlobRotl(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = BlobRotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+        k2 *= c2; k2 = BlobRotl(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = BlobRotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const unsigned char* tail = bytes + blocks * 16;
+    uint64_t k1 = 0, k2 = 0;
+    switch (size & 15) {
+    case 15: k2 ^= (uint64_t)tail[14] << 48; // fall through
+    case 14: k2 ^= (uint64_t)tail[13] << 40; // fall through
+    case 13: k2 ^= (uint64_t)tail[12] << 32; // fall through
+    case 12: k2 ^= (uint64_t)tail[11] << 24; // fall through
+    case 11: k2 ^= (uint64_t)tail[10] << 16; // fall through
+    case 10: k2 ^= (uint64_t)tail[9] << 8;   // fall through
+    case 9:  k2 ^= (uint64_t)tail[8];
+             k2 *= c2; k2 = BlobRotl(k2, 33); k2 *= c1; h2 ^= k2;
+             // fall through
+    case 8:  k1 ^= (uint64_t)tail[7] << 56;  // fall through
+    case 7:  k1 ^= (uint64_t)tail[6] << 48;  // fall through
+    case 6:  k1 ^= (uint64_t)tail[5] << 40;  // fall through
+    case 5:  k1 ^= (uint64_t)tail[4] << 32;  // fall through
+    case 4:  k1 ^= (uint64_t)tail[3] << 24;  // fall through
+    case 3:  k1 ^= (uint64_t)tail[2] << 16;  // fall through
+    case 2:  k1 ^= (uint64_t)tail[1] << 8;   // fall through
+    case 1:  k1 ^= (uint64_t)tail[0];
+             k1 *= c1; k1 = BlobRotl(k1, 31); k1 *= c2; h1 ^= k1;
+             break;
+    default: break;
+    }
+
+    h1 ^= (uint64_t)size;
+    h2 ^= (uint64_t)size;
+    h1 += h2;
+    h2 += h1;
+    h1 = BlobMix(h1);
+    h2 = BlobMix(h2);
+    h1 += h2;
+    h2 += h1;
+
+    BlobHash hash = { h1, h2 };
+    return hash;
+}
+
+// --- Store ---
+
+bool
+BlobStoreInit(BlobStore* store)
+{
+    memset(store, 0, sizeof(*store));
+    ArenaInit(&store->arena);
+    return HashIndexInit(&store->index, 64);
+}
+
+void
+BlobStoreFree(BlobStore* store)
+{
+    free(store->slots);
+    HashIndexFree(&store->index);
+    ArenaFree(&store->arena);
+    memset(store, 0, sizeof(*store));
+}
+
+static BlobSlot*
+BlobStoreSlot(const BlobStore* store, uint32_t blob)
+{
+    if (blob == BLOB_NONE || blob > store->slotCount) return NULL;
+    BlobSlot* slot = &store->slots[blob - 1];
+    return slot->refs > 0 ? slot : NULL;
+}
+
+// Takes an unused blob number, growing the slot array if there is none
+static uint32_t
+BlobStoreNewSlot(BlobStore* store)
+{
+    if (store->freeList != BLOB_NONE) {
+        uint32_t blob = store->freeList;
+        store->freeList = store->slots[blob - 1].nextFree;
+        return blob;
+    }
+    if (store->slotCount == store->slotCapacity) {
+        size_t capacity = store->slotCapacity ? store->slotCapacity * 2 : 64;
+        if (capacity > UINT32_MAX - 1) return BLOB_NONE;
+        BlobSlot* grown = realloc(store->slots, capacity * sizeof(BlobSlot));
+        if (!grown) return BLOB_NONE;
+        store->slots = grown;
+        store->slotCapacity = capacity;
+    }
+    return (uint32_t)++store->slotCount;
+}
+
+uint32_t
+BlobStorePut(BlobStore* store, const void* data, size_t size)
+{
+    BlobHash hash = BlobHash128(data, size);
+
+    HashIndexIter iter;
+    uint32_t blob;
+    HashIndexFind(&store->index, (uint32_t)hash.lo, &iter);
+    while (HashIndexNext(&iter, &blob)) {
+        BlobSlot* slot = &store->slots[blob - 1];
+        if (slot->hash.lo == hash.lo && slot->hash.hi == hash.hi && slot->size == size) {
+            slot->refs++;
+            store->puts++;
+            store->putBytes += size;
+            store->dedupHits++;
+            return blob;
+        }
+    }
+
+    void* copy = NULL;
+    if (size > 0) {
+        copy = ArenaAlloc(&store->arena, size);
+        if (!copy) return BLOB_NONE;
+        memcpy(copy, data, size);
+    }
+    blob = BlobStoreNewSlot(store);
+    if (blob == BLOB_NONE || !HashIndexInsert(&store->index, (uint32_t)hash.lo, blob)) {
+        if (blob != BLOB_NONE) { // Back on the free list
+            store->slots[blob - 1].refs = 0;
+            store->slots[blob - 1].nextFree = store->freeList;
+            store->freeList = blob;
+        }
+        if (copy) ArenaRelease(&store->arena, copy, size);
+        return BLOB_NONE;
+    }
+
+    BlobSlot* slot = &store->slots[blob - 1];
+    slot->hash = hash;
+    slot->data = copy;
+    slot->size = size;
+    slot->refs = 1;
+    slot->nextFree = BLOB_NONE;
+    store->blobs++;
+    store->storedBytes += size;
+    store->puts++;
+    store->putBytes += size;
+    return blob;
+}
+
+void
+BlobStoreRetain(BlobStore* store, uint32_t blob)
+{
+    BlobSlot* slot = BlobStoreSlot(store, blob);
+    if (slot) slot->refs++;
+}
+
+void
+BlobStoreRelease(BlobStore* store, uint32_t blob)
+{
+    BlobSlot* slot = BlobStoreSlot(store, blob);
+    if (!slot || --slot->refs > 0) return;
+
+    HashIndexRemove(&store->index, (uint32_t)slot->hash.lo, blob);
+    if (slot->data) ArenaRelease(&store->arena, slot->data, slot->size);
+    store->blobs--;
+    store->storedBytes -= slot->size;
+    memset(slot, 0, sizeof(*slot));
+    slot->nextFree = store->freeList;
+    store->freeList = blob;
+}
+
+const void*
+BlobStoreGet(const BlobStore* store, uint32_t blob, size_t* size)
+{
+    const BlobSlot* slot = BlobStoreSlot(store, blob);
+    if (!slot) return NULL;
+    if (size) *size = slot->size;
+    return slot->data ? slot->data : (const void*)slot; // Empty payloads are still non-NULL
+}
+
+const BlobHash*
+BlobStoreHash(const BlobStore* store, uint32_t blob)
+{
+    const BlobSlot* slot = BlobStoreSlot(store, blob);
+    return slot ? &slot->hash : NULL;
+}
@@ -0,0 +1,69 @@
+#ifndef MCLIP_BLOBSTORE_H
+#define MCLIP_BLOBSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "arena.h"
+#include "hashindex.h"
+
+// --- Blob Store ---
+// Content-addressed, reference-counted byte payloads (images, file lists,
+// HTML...). A payload is identified by its 128-bit hash: storing one that is
+// already present only takes another reference, so copying the same image
+// again costs one hashing pass and a lookup. At 128 bits an accidental
+// collision is not a practical concern, so contents are not compared.
+//
+// Blobs are numbered from 1 (BLOB_NONE is 0); numbers of released blobs are
+// reused. Payload memory comes from an Arena, the lookup is a HashIndex on
+// the hash's low 32 bits.
+
+#define BLOB_NONE 0
+
+typedef struct {
+    uint64_t lo, hi;
+} BlobHash;
+
+typedef struct {
+    BlobHash hash;
+    void* data;          // In the arena; NULL for an empty payload
+    size_t size;
+    uint32_t refs;       // 0: unused, on the free list
+    uint32_t nextFree;   // Next unused blob, BLOB_NONE at the end
+} BlobSlot;
+
+typedef struct {
+    BlobSlot* slots;     // Blob n is slots[n - 1]
+    size_t slotCount;
+    size_t slotCapacity;
+    uint32_t freeList;
+    HashIndex index;     // Low 32 bits of the hash -> blob number
+    Arena arena;
+
+    size_t blobs;        // Distinct payloads stored ...
+    size_t storedBytes;  // ... and their size
+    uint64_t puts;       // BlobStorePut calls that succeeded ...
+    uint64_t putBytes;   // ... the bytes they were given ...
+    uint64_t dedupHits;  // ... and how many found the payload already stored
+} BlobStore;
+
+// MurmurHash3 (x64, 128-bit) of 'size' bytes
+BlobHash BlobHash128(const void* data, size_t size);
+
+bool BlobStoreInit(BlobStore* store);
+void BlobStoreFree(BlobStore* store);
+
+// Returns the blob holding a copy of 'data' with one more reference, or
+// BLOB_NONE if memory runs out
+uint32_t BlobStorePut(BlobStore* store, const void* data, size_t size);
+
+// Adds / drops a reference. The last release frees the payload.
+void BlobStoreRetain(BlobStore* store, uint32_t blob);
+void BlobStoreRelease(BlobStore* store, uint32_t blob);
+
+// Payload of a live blob, NULL for BLOB_NONE or a released one
+const void* BlobStoreGet(const BlobStore* store, uint32_t blob, size_t* size);
+const BlobHash* BlobStoreHash(const BlobStore* store, uint32_t blob);
+
+#endif // MCLIP_BLOBSTORE_H
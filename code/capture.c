@@ -0,0 +1,87 @@
+#include "capture.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool
+CaptureStoreInit(CaptureStore* store)
+{
+    memset(store, 0, sizeof(*store));
+    return BlobStoreInit(&store->blobs);
+}
+
+void
+CaptureStoreFree(CaptureStore* store)
+{
+    BlobStoreFree(&store->blobs);
+    free(store->records);
+    memset(store, 0, sizeof(*store));
+}
+
+static void
+CaptureReleaseRecord(CaptureStore* store, CaptureRecord* record)
+{
+    for (uint32_t i = 0; i < record->count; ++i) BlobStoreRelease(&store->blobs, record->formats[i].blob);
+    record->count = 0;
+}
+
+bool
+CaptureStoreAttach(CaptureStore* store, uint32_t seq, const CapturePayload* payloads, size_t count,
+                   bool textIsLabel)
+{
+    if (store->count > 0 && store->records[store->count - 1].seq >= seq) return false;
+    if (store->count == store->capacity) {
+        size_t capacity = store->capacity ? store->capacity * 2 : 32;
+        CaptureRecord* grown = realloc(store->records, capacity * sizeof(CaptureRecord));
+        if (!grown) return false;
+        store->records = grown;
+        store->capacity = capacity;
+    }
+
+    CaptureRecord* record = &store->records[store->count];
+    record->seq = seq;
+    record->textIsLabel = textIsLabel;
+    record->count = 0;
+    for (size_t i = 0; i < count && i < CAPTURE_MAX_FORMATS; ++i) {
+        uint32_t blob = BlobStorePut(&store->blobs, payloads[i].data, payloads[i].size);
+        if (blob == BLOB_NONE) {
+            CaptureReleaseRecord(store, record);
+            return false;
+        }
+        record->formats[record->count].format = payloads[i].format;
+        record->formats[record->count].blob = blob;
+        record->count++;
+    }
+    store->count++;
+    return true;
+}
+
+const CaptureRecord*
+CaptureStoreFind(const CaptureStore* store, uint32_t seq)
+{
+    size_t low = 0, high = store->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (store->records[mid].seq < seq) low = mid + 1;
+        else high = mid;
+    }
+    return low < store->count && store->records[low].seq == seq ? &store->records[low] : NULL;
+}
+
+size_t
+CaptureStorePrune(CaptureStore* store, const History* history)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < store->count; ++i) {
+        CaptureRecord* record = &store->records[i];
+        if (HistoryFindSeq(history, record->seq)) {
+            if (kept != i) store->records[kept] = *record;
+            kept++;
+        } else {
+            CaptureReleaseRecord(store, record);
+        }
+    }
+    size_t dropped = store->count - kept;
+    store->count = kept;
+    return dropped;
+}
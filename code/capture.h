@@ -0,0 +1,61 @@
+#ifndef MCLIP_CAPTURE_H
+#define MCLIP_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "blobstore.h"
+#include "history.h"
+
+// --- Captured Formats ---
+// The clipboard formats captured with a history entry besides its text
+// (files, images, HTML...), so that pasting the entry puts all of them back.
+// Records are keyed by entry sequence number and hold their payloads in a
+// BlobStore, so an image copied several times is stored once. Format ids are
+// the platform's (CF_* and registered formats); nothing here interprets them.
+// Records live for the session only.
+
+#define CAPTURE_MAX_FORMATS 8
+
+typedef struct {
+    uint32_t format;     // Clipboard format id
+    const void* data;
+    size_t size;
+} CapturePayload;
+
+typedef struct {
+    uint32_t format;
+    uint32_t blob;       // In the store's BlobStore
+} CaptureFormat;
+
+typedef struct {
+    uint32_t seq;        // History entry the formats belong to
+    bool textIsLabel;    // The entry's text only describes the formats (e.g. an image): not put back as text
+    uint32_t count;
+    CaptureFormat formats[CAPTURE_MAX_FORMATS];
+} CaptureRecord;
+
+typedef struct {
+    BlobStore blobs;
+    CaptureRecord* records; // Ascending seq
+    size_t count;
+    size_t capacity;
+} CaptureStore;
+
+bool CaptureStoreInit(CaptureStore* store);
+void CaptureStoreFree(CaptureStore* store);
+
+// Records the formats of entry 'seq', newer than any recorded so far
+// (payloads beyond CAPTURE_MAX_FORMATS are ignored). False if memory runs out.
+bool CaptureStoreAttach(CaptureStore* store, uint32_t seq, const CapturePayload* payloads, size_t count,
+                        bool textIsLabel);
+
+// Formats of entry 'seq', NULL if none were captured. O(log n).
+const CaptureRecord* CaptureStoreFind(const CaptureStore* store, uint32_t seq);
+
+// Drops the records of entries no longer in 'history', releasing their
+// payloads. Returns how many were dropped.
+size_t CaptureStorePrune(CaptureStore* store, const History* history);
+
+#endif // MCLIP_CAPTURE_H
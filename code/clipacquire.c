@@ -0,0 +1,85 @@
+#include "clipacquire.h"
+
+#include <string.h>
+
+// xorshift32: jitter only needs to differ between retries and processes
+static uint32_t
+ClipAcquireRandom(ClipAcquire* acquire)
+{
+    uint32_t x = acquire->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    acquire->random = x;
+    return x;
+}
+
+void
+ClipAcquireInit(ClipAcquire* acquire, uint32_t seed)
+{
+    memset(acquire, 0, sizeof(*acquire));
+    acquire->random = seed ? seed : 0x9E3779B9u; // xorshift is stuck at zero
+}
+
+// Starts an episode: the time from here to a successful read is what is measured
+static void
+ClipAcquireBegin(ClipAcquire* acquire, uint64_t nowNs)
+{
+    acquire->pending = true;
+    acquire->failures = 0;
+    acquire->noticedNs = nowNs;
+    acquire->alerted = false;
+}
+
+void
+ClipAcquireNotify(ClipAcquire* acquire, uint64_t nowNs)
+{
+    acquire->updates++;
+    // Already pending: same episode, the latest copy is what gets read
+    if (!acquire->pending) ClipAcquireBegin(acquire, nowNs);
+}
+
+unsigned
+ClipAcquireAttempted(ClipAcquire* acquire, ClipAttemptResult result, uint64_t nowNs)
+{
+    acquire->attempts++;
+    if (!acquire->pending) ClipAcquireBegin(acquire, nowNs); // Attempt without a notification
+
+    if (result != CLIP_ATTEMPT_BUSY) {
+        if (result == CLIP_ATTEMPT_ACQUIRED) {
+            uint64_t elapsed = nowNs - acquire->noticedNs;
+            acquire->acquired++;
+            acquire->totalAcquireNs += elapsed;
+            acquire->lastAcquireNs = elapsed;
+            if (elapsed > acquire->maxAcquireNs) acquire->maxAcquireNs = elapsed;
+        } else {
+            acquire->failed++;
+        }
+        acquire->pending = false;
+        return 0;
+    }
+
+    acquire->busy++;
+    if (acquire->failures++ == 0) acquire->contended++;
+    if (!acquire->alerted && nowNs - acquire->noticedNs >= CLIP_ACQUIRE_ALERT_NS) {
+        acquire->alerted = true;
+        acquire->alertDue = true;
+    }
+
+    // Equal jitter: half the backoff is fixed, half random
+    unsigned delay = CLIP_ACQUIRE_MAX_RETRY_MS;
+    if (acquire->failures <= 16) {
+        uint64_t backoff = (uint64_t)CLIP_ACQUIRE_FIRST_RETRY_MS << (acquire->failures - 1);
+        if (backoff < delay) delay = (unsigned)backoff;
+    }
+    unsigned half = delay / 2;
+    return delay - half + ClipAcquireRandom(acquire) % (half + 1);
+}
+
+bool
+ClipAcquireTakeAlert(ClipAcquire* acquire)
+{
+    bool due = acquire->alertDue;
+    acquire->alertDue = false;
+    return due;
+}
@@ -0,0 +1,68 @@
+#ifndef MCLIP_CLIPACQUIRE_H
+#define MCLIP_CLIPACQUIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- Clipboard Acquisition ---
+// Decides when to (re)try reading the clipboard after a change notification.
+// Another application may hold the clipboard open; instead of sleeping
+// between attempts, the UI schedules the next one on a timer, with
+// exponential backoff and jitter so that several waiting readers don't
+// retry in lockstep. The machine never gives up while the clipboard is only
+// busy: the latest copy is read as soon as its owner lets go. After
+// CLIP_ACQUIRE_ALERT_NS of contention it asks the UI, once, to tell the user.
+//
+// The machine only schedules; opening the clipboard and processing what was
+// read are the caller's, and no OS call happens here, so it runs headless.
+//
+//   WM_CLIPBOARDUPDATE -> ClipAcquireNotify -> attempt now
+//   attempt            -> ClipAcquireAttempted -> 0 (done) or a retry delay
+//   retry timer        -> attempt
+
+#define CLIP_ACQUIRE_FIRST_RETRY_MS 5       // Backoff starts here and doubles
+#define CLIP_ACQUIRE_MAX_RETRY_MS 500       // and stops growing here
+#define CLIP_ACQUIRE_ALERT_NS 250000000ull  // Contention the user is told about
+
+typedef enum {
+    CLIP_ATTEMPT_ACQUIRED, // The clipboard was opened (whether or not it held text)
+    CLIP_ATTEMPT_BUSY,     // Another application has it open: retry later
+    CLIP_ATTEMPT_FAILED    // Any other error: not retried
+} ClipAttemptResult;
+
+typedef struct {
+    bool pending;            // An update has not been read yet
+    uint32_t failures;       // Busy attempts for the pending update
+    uint64_t noticedNs;      // When the pending update was notified
+    bool alerted;            // The user was told about this episode
+    bool alertDue;           // Not yet taken with ClipAcquireTakeAlert
+    uint32_t random;         // Jitter state
+
+    // Counters (diagnostics)
+    uint64_t updates;        // Notifications
+    uint64_t attempts;
+    uint64_t busy;           // Attempts that found the clipboard busy
+    uint64_t contended;      // Updates that needed more than one attempt
+    uint64_t acquired;
+    uint64_t failed;
+    uint64_t totalAcquireNs; // Notification to successful attempt, summed
+    uint64_t maxAcquireNs;
+    uint64_t lastAcquireNs;  // Same, of the latest successful attempt
+} ClipAcquire;
+
+// 'seed' varies the jitter between processes
+void ClipAcquireInit(ClipAcquire* acquire, uint32_t seed);
+
+// A change was notified at 'nowNs'. The caller attempts a read right away
+// (cancelling any scheduled retry); a read already pending keeps its backoff.
+void ClipAcquireNotify(ClipAcquire* acquire, uint64_t nowNs);
+
+// Records the outcome of an attempt. Returns the milliseconds to wait before
+// the next attempt, or 0 when there is nothing left to do.
+unsigned ClipAcquireAttempted(ClipAcquire* acquire, ClipAttemptResult result, uint64_t nowNs);
+
+// True once per contention episode that lasted CLIP_ACQUIRE_ALERT_NS
+bool ClipAcquireTakeAlert(ClipAcquire* acquire);
+
+#endif // MCLIP_CLIPACQUIRE_H
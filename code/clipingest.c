@@ -0,0 +1,76 @@
+#include "clipingest.h"
+#include "platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void
+ClipContentFree(ClipContent* content)
+{
+    free(content->text);
+    for (size_t i = 0; i < content->payloadCount; ++i) free((void*)content->payloads[i].data);
+    memset(content, 0, sizeof(*content));
+}
+
+bool
+ClipExcluded(ExcludeRules* rules, const wchar_t* text, size_t length, ClipContent* content)
+{
+    content->excluded = rules && ExcludeCheck(rules, text, length) != EXCLUDE_NONE;
+    return content->excluded;
+}
+
+unsigned
+ClipTryRead(const ClipBackend* backend, ClipAcquire* acquire, Metrics* metrics, ClipContent* content,
+            uint64_t nowNs)
+{
+    memset(content, 0, sizeof(*content));
+    content->time = (int64_t)time(NULL);
+    uint64_t start = PlatformNowNs();
+    ClipAttemptResult result = backend->read(backend->context, content);
+    uint64_t readNs = PlatformNowNs() - start;
+
+    unsigned retryMs = ClipAcquireAttempted(acquire, result, nowNs);
+    if (result == CLIP_ATTEMPT_ACQUIRED) {
+        MetricsRecord(metrics, METRIC_CLIPBOARD_READ, readNs);
+        MetricsRecord(metrics, METRIC_CLIPBOARD_WAIT, acquire->lastAcquireNs);
+        if (content->excluded) MetricsCount(metrics, METRIC_EXCLUDED, 1);
+    }
+    return retryMs;
+}
+
+HistoryAddResult
+ClipIngest(const ClipSink* sink, const ClipContent* content, const wchar_t* label)
+{
+    bool textIsLabel = content->text == NULL;
+    const wchar_t* text = textIsLabel ? label : content->text;
+    if (!text) return HISTORY_EMPTY;
+
+    uint64_t start = PlatformNowNs();
+    HistoryAddResult result = HistoryAdd(sink->history, text);
+    MetricsRecord(sink->metrics, METRIC_HISTORY_ADD, PlatformNowNs() - start);
+
+    if (result != HISTORY_ADDED && result != HISTORY_DUPLICATE) return result;
+
+    const HistoryEntry* entry = HistoryGet(sink->history, 0);
+    HistorySetOrigin(sink->history, entry, content->time, content->source);
+    if (textIsLabel) HistorySetClass(sink->history, entry, content->labelClass);
+    bool logged = sink->log && !textIsLabel && HistoryLogIsOpen(sink->log) && !sink->log->failed;
+    if (result == HISTORY_DUPLICATE) {
+        // The re-copy moved the entry up: logged again, a reload replays that
+        MetricsCount(sink->metrics, METRIC_DUPLICATES, 1);
+        if (logged) HistoryLogAppend(sink->log, text, entry->length, entry->hash);
+        return result;
+    }
+    MetricsCount(sink->metrics, METRIC_ENTRIES_ADDED, 1);
+    MetricsCount(sink->metrics, METRIC_BYTES_ADDED, entry->length * sizeof(wchar_t));
+    if (sink->captures) {
+        // Out of memory: the entry keeps its text only
+        if (content->payloadCount > 0) {
+            CaptureStoreAttach(sink->captures, entry->seq, content->payloads, content->payloadCount, textIsLabel);
+        }
+        CaptureStorePrune(sink->captures, sink->history); // Formats of the entry just evicted, if any
+    }
+    if (logged) HistoryLogAppend(sink->log, text, entry->length, entry->hash); // Failures show in log->failed
+    return result;
+}
@@ -0,0 +1,77 @@
+#ifndef MCLIP_CLIPINGEST_H
+#define MCLIP_CLIPINGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include "capture.h"
+#include "clipacquire.h"
+#include "exclude.h"
+#include "history.h"
+#include "historylog.h"
+#include "meta.h"
+#include "metrics.h"
+
+// --- Clipboard Ingestion ---
+// Everything between "the clipboard changed" and "the entry is stored"
+// except the OS. A ClipBackend reads the clipboard: the Win32 one lives in
+// mclip.c, an in-memory fake drives the tests and the replay harness
+// (tests/replay.c). ClipTryRead makes one read attempt on the ClipAcquire
+// schedule, and ClipIngest stores what was read. The shell and the harness
+// run the same code from there on, so replayed traces measure what users get.
+
+// One read of the clipboard, copied out so it is processed with the clipboard closed
+typedef struct {
+    wchar_t* text;                                // malloc'd, NULL if there was no text
+    CapturePayload payloads[CAPTURE_MAX_FORMATS]; // 'data' malloc'd
+    size_t payloadCount;
+    bool excluded;                                // The text matched an exclusion rule: nothing was copied
+    int64_t time;                                 // Unix time of the read (set by ClipTryRead)
+    wchar_t source[META_SOURCE_CHARS];            // Process that put it on the clipboard, "" if unknown
+    MetaClass labelClass;                         // What a label stands for (META_CLASS_IMAGE...), see ClipIngest
+} ClipContent;
+
+typedef struct {
+    // Opens the clipboard, copies its text and the formats worth keeping into
+    // 'content' (zeroed but for its time), names the source if it knows it,
+    // and closes the clipboard. CLIP_ATTEMPT_ACQUIRED with nothing
+    // copied when it holds nothing worth keeping. The text is checked with
+    // ClipExcluded where it lies, before anything is copied: if excluded,
+    // nothing is.
+    ClipAttemptResult (*read)(void* context, ClipContent* content);
+    void* context;
+} ClipBackend;
+
+// Where ingested content goes
+typedef struct {
+    History* history;
+    CaptureStore* captures; // NULL: other formats are not kept
+    HistoryLog* log;        // NULL: entries are not saved
+    Metrics* metrics;       // Stage timings and counters
+} ClipSink;
+
+void ClipContentFree(ClipContent* content);
+
+// For ClipBackend.read: true, and 'content' marked excluded, if the rules
+// (NULL: none) refuse the clipboard text of 'length' characters
+bool ClipExcluded(ExcludeRules* rules, const wchar_t* text, size_t length, ClipContent* content);
+
+// One attempt at reading a changed clipboard (after ClipAcquireNotify, then on
+// every retry). Returns the milliseconds until the next attempt, 0 when done;
+// on success *content has what was read, for ClipIngest.
+// Records METRIC_CLIPBOARD_READ and METRIC_CLIPBOARD_WAIT, and counts METRIC_EXCLUDED.
+unsigned ClipTryRead(const ClipBackend* backend, ClipAcquire* acquire, Metrics* metrics, ClipContent* content,
+                     uint64_t nowNs);
+
+// Stores what was read: its text, or 'label' for content without text (NULL:
+// nothing is stored then), as the newest entry, and the other formats with
+// it. The entry's metadata gets the time and source of the read, and a
+// labelled one the content's 'labelClass'. The formats of entries evicted meanwhile are dropped. Entries, and
+// re-copies of ones already stored, are queued on the log unless only
+// labelled (see HistoryLogAppend; flushing is the caller's). The caller holds whatever guards the history.
+// Records METRIC_HISTORY_ADD and the entry counters.
+HistoryAddResult ClipIngest(const ClipSink* sink, const ClipContent* content, const wchar_t* label);
+
+#endif // MCLIP_CLIPINGEST_H
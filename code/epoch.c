@@ -0,0 +1,133 @@
+#include "epoch.h"
+#include "platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define EPOCH_STEP 2
+
+void
+EpochInit(EpochDomain* domain)
+{
+    memset(domain, 0, sizeof(*domain));
+    for (int i = 0; i < EPOCH_MAX_READERS; ++i) domain->readers[i].pinned = EPOCH_IDLE;
+}
+
+void
+EpochFree(EpochDomain* domain)
+{
+    for (size_t i = 0; i < domain->retiredCount; ++i) domain->retired[i].release(domain->retired[i].object);
+    free(domain->retired);
+    EpochInit(domain);
+}
+
+int
+EpochRegister(EpochDomain* domain)
+{
+    for (int i = 0; i < EPOCH_MAX_READERS; ++i) {
+        if (PlatformAtomicCompareExchange(&domain->readers[i].claimed, 0, 1)) return i;
+    }
+    return -1;
+}
+
+void
+EpochUnregister(EpochDomain* domain, int reader)
+{
+    PlatformAtomicStore(&domain->readers[reader].pinned, EPOCH_IDLE);
+    PlatformAtomicStore(&domain->readers[reader].claimed, 0);
+}
+
+void
+EpochPin(EpochDomain* domain, int reader)
+{
+    volatile int32_t* pinned = &domain->readers[reader].pinned;
+    int32_t epoch = PlatformAtomicLoad(&domain->epoch);
+    for (;;) {
+        PlatformAtomicStore(pinned, epoch);
+        // Still current once announced: a writer advancing past it from
+        // here on sees the pin and waits for it
+        int32_t now = PlatformAtomicLoad(&domain->epoch);
+        if (now == epoch) return;
+        epoch = now;
+    }
+}
+
+void
+EpochUnpin(EpochDomain* domain, int reader)
+{
+    PlatformAtomicStore(&domain->readers[reader].pinned, EPOCH_IDLE);
+}
+
+// Moves the epoch on if every pinned reader is in the current one
+static bool
+EpochTryAdvance(EpochDomain* domain)
+{
+    int32_t epoch = PlatformAtomicLoad(&domain->epoch);
+    for (int i = 0; i < EPOCH_MAX_READERS; ++i) {
+        int32_t pinned = PlatformAtomicLoad(&domain->readers[i].pinned);
+        if (pinned != EPOCH_IDLE && pinned != epoch) return false;
+    }
+    PlatformAtomicStore(&domain->epoch, (int32_t)((uint32_t)epoch + EPOCH_STEP)); // Wraps, compared by difference
+    domain->advances++;
+    return true;
+}
+
+// Releases the objects retired two advances ago or earlier
+static size_t
+EpochRelease(EpochDomain* domain)
+{
+    int32_t epoch = PlatformAtomicLoad(&domain->epoch);
+    size_t kept = 0, released = 0;
+    for (size_t i = 0; i < domain->retiredCount; ++i) {
+        EpochRetired* retired = &domain->retired[i];
+        if ((int32_t)((uint32_t)epoch - (uint32_t)retired->epoch) > EPOCH_STEP) {
+            retired->release(retired->object);
+            released++;
+        } else {
+            domain->retired[kept++] = *retired;
+        }
+    }
+    domain->retiredCount = kept;
+    domain->released += released;
+    return released;
+}
+
+size_t
+EpochCollect(EpochDomain* domain)
+{
+    if (domain->retiredCount == 0) return 0;
+    EpochTryAdvance(domain);
+    return EpochRelease(domain);
+}
+
+void
+EpochSynchronize(EpochDomain* domain)
+{
+    // Two advances take every reader pinned now out of the epoch it is in
+    for (int advances = 0; advances < 2;) {
+        if (EpochTryAdvance(domain)) advances++;
+        else PlatformYield();
+    }
+    EpochRelease(domain);
+}
+
+void
+EpochRetire(EpochDomain* domain, void* object, void (*release)(void* object))
+{
+    if (domain->retiredCount == domain->retiredCapacity) {
+        size_t capacity = domain->retiredCapacity ? domain->retiredCapacity * 2 : 64;
+        EpochRetired* retired = realloc(domain->retired, capacity * sizeof(EpochRetired));
+        if (!retired) {
+            EpochSynchronize(domain); // Out of memory: nobody can hold the object past this
+            release(object);
+            domain->released++;
+            return;
+        }
+        domain->retired = retired;
+        domain->retiredCapacity = capacity;
+    }
+    EpochRetired* retired = &domain->retired[domain->retiredCount++];
+    retired->object = object;
+    retired->release = release;
+    retired->epoch = PlatformAtomicLoad(&domain->epoch);
+}
@@ -0,0 +1,75 @@
+#ifndef MCLIP_EPOCH_H
+#define MCLIP_EPOCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- Epoch-Based Reclamation ---
+// Lets one writer free objects that lock-free readers may still be looking
+// at. A reader pins the domain around each access (EpochPin / EpochUnpin:
+// two atomic stores, no lock, nothing shared with other readers); the writer
+// unlinks an object from whatever readers reach it through, then retires it
+// instead of freeing it. A retired object is released once every reader
+// that could have seen it has unpinned.
+//
+// The global epoch advances (by 2) when every pinned reader has caught up
+// with it. An object retired at epoch e can only be held by readers pinned
+// at e or earlier, so it is released once the epoch is past e + 2: both
+// advances needed readers to leave e behind. A reader that stays pinned
+// holds back reclamation, never the writer.
+//
+// Readers each own a slot, taken with EpochRegister. Retire and Collect are
+// for the writer only (one thread, or callers serialise them).
+
+#define EPOCH_MAX_READERS 64
+#define EPOCH_IDLE 1           // Slot value of an unpinned reader; epochs are even
+
+typedef struct {
+    volatile int32_t pinned;   // Epoch the reader is in, EPOCH_IDLE outside
+    volatile int32_t claimed;  // Taken by EpochRegister
+    char padding[56];          // One cache line per reader: pins don't contend
+} EpochReader;
+
+typedef struct {
+    void* object;
+    void (*release)(void* object);
+    int32_t epoch;             // Epoch it was retired in
+} EpochRetired;
+
+typedef struct {
+    EpochReader readers[EPOCH_MAX_READERS];
+    volatile int32_t epoch;
+    EpochRetired* retired;     // Writer only: objects waiting for readers
+    size_t retiredCount;
+    size_t retiredCapacity;
+    size_t released;           // Objects released so far (diagnostics)
+    size_t advances;           // Times the epoch moved on
+} EpochDomain;
+
+void EpochInit(EpochDomain* domain);
+
+// Releases everything still retired. No reader may be pinned.
+void EpochFree(EpochDomain* domain);
+
+// A reader slot for the calling thread, or -1 if all EPOCH_MAX_READERS are taken
+int EpochRegister(EpochDomain* domain);
+void EpochUnregister(EpochDomain* domain, int reader);
+
+// Brackets a read. Objects reached between the two stay valid until EpochUnpin.
+void EpochPin(EpochDomain* domain, int reader);
+void EpochUnpin(EpochDomain* domain, int reader);
+
+// Hands an object readers can no longer reach to 'release(object)', once
+// no reader holds it. Never fails: if the list cannot grow, waits for the
+// readers (EpochSynchronize) and releases the object at once.
+void EpochRetire(EpochDomain* domain, void* object, void (*release)(void* object));
+
+// Advances the epoch if readers allow and releases what is safe to release.
+// Returns the number of objects released. Cheap; called after each retire.
+size_t EpochCollect(EpochDomain* domain);
+
+// Waits until every reader pinned now has unpinned, then releases all retired objects
+void EpochSynchronize(EpochDomain* domain);
+
+#endif // MCLIP_EPOCH_H
@@ -0,0 +1,391 @@
+#include "exclude.h"
+#include "textmatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+
+// Automaton state flags
+#define EXCLUDE_STATE_CONTAINS 1    // A contains rule ends here, or at a suffix of here
+#define EXCLUDE_STATE_PREFIX 2      // A prefix rule ends here
+#define EXCLUDE_STATE_PREFIX_LINK 4 // One ends at a proper suffix (prefixLink)
+
+// Transitions hold the row of the next state (state * classCount), so a
+// step is one load, and this bit if that state has flags
+#define EXCLUDE_NEXT_FLAGGED 0x80000000u
+
+void
+ExcludeRulesInit(ExcludeRules* rules)
+{
+    memset(rules, 0, sizeof(*rules));
+}
+
+// Drops what ExcludeRulesBuild made
+static void
+ExcludeRulesReset(ExcludeRules* rules)
+{
+    free(rules->next);
+    free(rules->flags);
+    free(rules->depth);
+    free(rules->prefixLink);
+    free(rules->wideChars);
+    free(rules->wideClasses);
+    for (size_t i = 0; i < rules->regexCount; ++i) RegexFree(&rules->regexes[i]);
+    free(rules->regexes);
+    rules->next = NULL;
+    rules->flags = NULL;
+    rules->depth = NULL;
+    rules->prefixLink = NULL;
+    rules->stateCount = 0;
+    rules->classCount = 0;
+    memset(rules->byteClass, 0, sizeof(rules->byteClass));
+    rules->wideChars = NULL;
+    rules->wideClasses = NULL;
+    rules->wideCount = 0;
+    rules->shortest = 0;
+    rules->regexes = NULL;
+    rules->regexCount = 0;
+    rules->built = false;
+}
+
+void
+ExcludeRulesFree(ExcludeRules* rules)
+{
+    ExcludeRulesReset(rules);
+    for (size_t i = 0; i < rules->count; ++i) free(rules->rules[i].pattern);
+    free(rules->rules);
+    ExcludeRulesInit(rules);
+}
+
+bool
+ExcludeRulesAdd(ExcludeRules* rules, ExcludeKind kind, const wchar_t* pattern, size_t length)
+{
+    if (length == 0) return false;
+    if (kind == EXCLUDE_REGEX) {
+        Regex regex; // Refused now rather than at build time
+        if (RegexCompile(&regex, pattern, length) != REGEX_OK) return false;
+        RegexFree(&regex);
+    } else if (kind != EXCLUDE_CONTAINS && kind != EXCLUDE_PREFIX) {
+        return false;
+    }
+    if (rules->count == rules->capacity) {
+        size_t capacity = rules->capacity ? rules->capacity * 2 : 16;
+        ExcludeRule* grown = realloc(rules->rules, capacity * sizeof(ExcludeRule));
+        if (!grown) return false;
+        rules->rules = grown;
+        rules->capacity = capacity;
+    }
+    wchar_t* copy = malloc((length + 1) * sizeof(wchar_t));
+    if (!copy) return false;
+    for (size_t i = 0; i < length; ++i) copy[i] = kind == EXCLUDE_REGEX ? pattern[i] : TextFoldChar(pattern[i]);
+    copy[length] = L'\0';
+    rules->rules[rules->count++] = (ExcludeRule){ kind, copy, length };
+    return true;
+}
+
+// Value of a "key=value" line if it has that key, else NULL
+static const wchar_t*
+ExcludeSettingValue(const wchar_t* line, const wchar_t* key)
+{
+    size_t length = wcslen(key);
+    return wcsncmp(line, key, length) == 0 && line[length] == L'=' ? line + length + 1 : NULL;
+}
+
+static bool
+ExcludeParseCount(const wchar_t* value, size_t* count)
+{
+    wchar_t* end;
+    unsigned long long parsed = wcstoull(value, &end, 10);
+    if (end == value || *end != L'\0' || *value == L'-') return false;
+    *count = (size_t)parsed;
+    return true;
+}
+
+bool
+ExcludeRulesAddSetting(ExcludeRules* rules, const wchar_t* line)
+{
+    static const struct {
+        const wchar_t* key;
+        ExcludeKind kind;
+    } kinds[] = { { L"contains", EXCLUDE_CONTAINS }, { L"prefix", EXCLUDE_PREFIX }, { L"regex", EXCLUDE_REGEX } };
+    for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); ++i) {
+        const wchar_t* value = ExcludeSettingValue(line, kinds[i].key);
+        if (value) return ExcludeRulesAdd(rules, kinds[i].kind, value, wcslen(value));
+    }
+    const wchar_t* value = ExcludeSettingValue(line, L"max_chars");
+    if (value) return ExcludeParseCount(value, &rules->maxChars);
+    value = ExcludeSettingValue(line, L"min_chars");
+    if (value) return ExcludeParseCount(value, &rules->minChars);
+    return false;
+}
+
+// --- Building ---
+
+static int
+ExcludeCompareChars(const void* a, const void* b)
+{
+    wchar_t x = *(const wchar_t*)a, y = *(const wchar_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Class of a folded character; 0 if no rule uses it
+static inline uint32_t
+ExcludeFoldedClass(const ExcludeRules* rules, wchar_t c)
+{
+    if ((uint32_t)c < 256) return rules->byteClass[c];
+    size_t lo = 0, hi = rules->wideCount;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (rules->wideChars[mid] < c) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < rules->wideCount && rules->wideChars[lo] == c ? rules->wideClasses[lo] : 0;
+}
+
+// One class per distinct (folded) character of the literal rules
+static bool
+ExcludeBuildClasses(ExcludeRules* rules, size_t literalChars)
+{
+    bool used[256] = { false };
+    wchar_t* wide = malloc((literalChars ? literalChars : 1) * sizeof(wchar_t));
+    if (!wide) return false;
+    size_t wideCount = 0;
+    for (size_t r = 0; r < rules->count; ++r) {
+        const ExcludeRule* rule = &rules->rules[r];
+        if (rule->kind == EXCLUDE_REGEX) continue;
+        for (size_t i = 0; i < rule->length; ++i) {
+            if ((uint32_t)rule->pattern[i] < 256) used[rule->pattern[i]] = true;
+            else wide[wideCount++] = rule->pattern[i];
+        }
+    }
+    qsort(wide, wideCount, sizeof(wchar_t), ExcludeCompareChars);
+    size_t unique = 0;
+    for (size_t i = 0; i < wideCount; ++i) {
+        if (unique == 0 || wide[unique - 1] != wide[i]) wide[unique++] = wide[i];
+    }
+
+    uint32_t classes = 1;
+    uint16_t folded[256] = { 0 };
+    for (int c = 0; c < 256; ++c) {
+        if (used[c]) folded[c] = (uint16_t)classes++;
+    }
+    if (classes + unique > UINT16_MAX) {
+        free(wide);
+        return false;
+    }
+    rules->wideClasses = malloc((unique ? unique : 1) * sizeof(uint16_t));
+    if (!rules->wideClasses) {
+        free(wide);
+        return false;
+    }
+    for (size_t i = 0; i < unique; ++i) rules->wideClasses[i] = (uint16_t)classes++;
+    rules->wideChars = wide;
+    rules->wideCount = unique;
+    rules->classCount = classes;
+
+    // Characters below 256 are looked up as they are: fold them now
+    memcpy(rules->byteClass, folded, sizeof(folded));
+    for (int c = 0; c < 256; ++c) folded[c] = (uint16_t)ExcludeFoldedClass(rules, TextFoldChar((wchar_t)c));
+    memcpy(rules->byteClass, folded, sizeof(folded));
+    return true;
+}
+
+// Trie of the literal rules, then failure links filled into a full transition table
+static bool
+ExcludeBuildAutomaton(ExcludeRules* rules, size_t literalChars)
+{
+    if (literalChars + 1 > EXCLUDE_MAX_STATES) return false;
+    size_t maxStates = literalChars + 1;
+    if (maxStates * rules->classCount > EXCLUDE_MAX_TABLE_BYTES / sizeof(uint32_t)) return false;
+    size_t classCount = rules->classCount;
+    rules->next = calloc(maxStates * classCount, sizeof(uint32_t));
+    rules->flags = calloc(maxStates, sizeof(uint8_t));
+    rules->depth = calloc(maxStates, sizeof(uint32_t));
+    rules->prefixLink = calloc(maxStates, sizeof(uint32_t));
+    uint32_t* fail = calloc(maxStates, sizeof(uint32_t));
+    uint32_t* queue = malloc(maxStates * sizeof(uint32_t));
+    if (!rules->next || !rules->flags || !rules->depth || !rules->prefixLink || !fail || !queue) {
+        free(fail);
+        free(queue);
+        return false;
+    }
+
+    // Trie: 0 in 'next' is "no child" (the root is nobody's child)
+    uint32_t states = 1;
+    rules->shortest = SIZE_MAX;
+    for (size_t r = 0; r < rules->count; ++r) {
+        const ExcludeRule* rule = &rules->rules[r];
+        if (rule->kind == EXCLUDE_REGEX) continue;
+        uint32_t state = 0;
+        for (size_t i = 0; i < rule->length; ++i) {
+            uint32_t* child = &rules->next[state * classCount + ExcludeFoldedClass(rules, rule->pattern[i])];
+            if (*child == 0) {
+                rules->depth[states] = rules->depth[state] + 1;
+                *child = states++;
+            }
+            state = *child;
+        }
+        rules->flags[state] |= rule->kind == EXCLUDE_CONTAINS ? EXCLUDE_STATE_CONTAINS : EXCLUDE_STATE_PREFIX;
+        if (rule->length < rules->shortest) rules->shortest = rule->length;
+    }
+
+    // Breadth first, so the failure state of a state (shallower) is complete
+    // before its row is filled from it
+    size_t head = 0, tail = 0;
+    for (size_t c = 0; c < classCount; ++c) {
+        if (rules->next[c]) queue[tail++] = rules->next[c];
+    }
+    while (head < tail) {
+        uint32_t state = queue[head++];
+        uint32_t* row = &rules->next[state * classCount];
+        const uint32_t* failRow = &rules->next[(size_t)fail[state] * classCount];
+        for (size_t c = 0; c < classCount; ++c) {
+            uint32_t child = row[c];
+            if (child == 0) {
+                row[c] = failRow[c];
+                continue;
+            }
+            uint32_t suffix = failRow[c];
+            fail[child] = suffix;
+            rules->flags[child] |= rules->flags[suffix] & EXCLUDE_STATE_CONTAINS;
+            rules->prefixLink[child] = rules->flags[suffix] & EXCLUDE_STATE_PREFIX ? suffix : rules->prefixLink[suffix];
+            if (rules->prefixLink[child]) rules->flags[child] |= EXCLUDE_STATE_PREFIX_LINK;
+            queue[tail++] = child;
+        }
+    }
+    free(fail);
+    free(queue);
+
+    uint32_t* next = realloc(rules->next, (size_t)states * classCount * sizeof(uint32_t));
+    if (next) rules->next = next;
+    for (size_t i = 0; i < (size_t)states * classCount; ++i) {
+        uint32_t state = rules->next[i];
+        rules->next[i] = state * (uint32_t)classCount | (rules->flags[state] ? EXCLUDE_NEXT_FLAGGED : 0);
+    }
+    rules->stateCount = states;
+    return true;
+}
+
+// Regex rules joined into as few alternations as fit REGEX_MAX_PATTERN. A
+// group that does not compile (too many NFA states, or one rule that fills
+// the pattern on its own) is compiled rule by rule.
+static bool
+ExcludeBuildRegexes(ExcludeRules* rules, size_t regexRules)
+{
+    if (regexRules == 0) return true;
+    rules->regexes = malloc(regexRules * sizeof(Regex));
+    wchar_t* joined = malloc((REGEX_MAX_PATTERN + 5) * sizeof(wchar_t)); // One rule may take all of it
+    if (!rules->regexes || !joined) {
+        free(joined);
+        return false;
+    }
+    size_t r = 0;
+    while (r < rules->count) {
+        if (rules->rules[r].kind != EXCLUDE_REGEX) {
+            r++;
+            continue;
+        }
+        size_t first = r, members = 0, length = 0;
+        for (; r < rules->count; ++r) {
+            const ExcludeRule* rule = &rules->rules[r];
+            if (rule->kind != EXCLUDE_REGEX) continue;
+            size_t needed = rule->length + 5 + (members ? 1 : 0); // "|(?:" ... ")"
+            if (members > 0 && length + needed > REGEX_MAX_PATTERN) break;
+            if (members > 0) joined[length++] = L'|';
+            wmemcpy(joined + length, L"(?:", 3);
+            wmemcpy(joined + length + 3, rule->pattern, rule->length);
+            length += rule->length + 3;
+            joined[length++] = L')';
+            members++;
+        }
+        RegexError error = RegexCompile(&rules->regexes[rules->regexCount], joined, length);
+        if (error == REGEX_OK) {
+            rules->regexCount++;
+            continue;
+        }
+        if (error == REGEX_ERROR_MEMORY) {
+            free(joined);
+            return false;
+        }
+        for (size_t i = first; i < r; ++i) {
+            const ExcludeRule* rule = &rules->rules[i];
+            if (rule->kind != EXCLUDE_REGEX) continue;
+            if (RegexCompile(&rules->regexes[rules->regexCount], rule->pattern, rule->length) != REGEX_OK) {
+                free(joined);
+                return false;
+            }
+            rules->regexCount++;
+        }
+    }
+    free(joined);
+    return true;
+}
+
+bool
+ExcludeRulesBuild(ExcludeRules* rules)
+{
+    ExcludeRulesReset(rules);
+    size_t literalChars = 0, regexRules = 0;
+    for (size_t r = 0; r < rules->count; ++r) {
+        if (rules->rules[r].kind == EXCLUDE_REGEX) regexRules++;
+        else literalChars += rules->rules[r].length;
+    }
+    if (!ExcludeBuildClasses(rules, literalChars) || !ExcludeBuildAutomaton(rules, literalChars) ||
+        !ExcludeBuildRegexes(rules, regexRules)) {
+        ExcludeRulesReset(rules);
+        return false;
+    }
+    rules->built = true;
+    return true;
+}
+
+// --- Checking ---
+
+static inline bool
+ExcludeIsWordChar(wchar_t c)
+{
+    return c == L'_' || iswalnum((wint_t)c);
+}
+
+// A literal rule somewhere in the text, in one pass over it
+static ExcludeKind
+ExcludeScan(const ExcludeRules* rules, const wchar_t* text, size_t length)
+{
+    const uint32_t* next = rules->next;
+    const uint8_t* flags = rules->flags;
+    uint32_t row = 0;
+    for (size_t i = 0; i < length; ++i) {
+        wchar_t c = text[i];
+        uint32_t cls = (uint32_t)c < 256 ? rules->byteClass[c] : ExcludeFoldedClass(rules, TextFoldChar(c));
+        row = next[row + cls];
+        if (!(row & EXCLUDE_NEXT_FLAGGED)) continue;
+        row &= ~EXCLUDE_NEXT_FLAGGED;
+        uint32_t state = row / rules->classCount;
+        if (flags[state] & EXCLUDE_STATE_CONTAINS) return EXCLUDE_CONTAINS;
+
+        // Prefix rules ending here: each must start a word. At most one per
+        // length, so this is bounded by the longest rule, not their number.
+        uint32_t s = flags[state] & EXCLUDE_STATE_PREFIX ? state : rules->prefixLink[state];
+        for (; s; s = rules->prefixLink[s]) {
+            size_t start = i + 1 - rules->depth[s];
+            if (start == 0 || !ExcludeIsWordChar(text[start - 1])) return EXCLUDE_PREFIX;
+        }
+    }
+    return EXCLUDE_NONE;
+}
+
+ExcludeKind
+ExcludeCheck(ExcludeRules* rules, const wchar_t* text, size_t length)
+{
+    if (rules->maxChars && length > rules->maxChars) return EXCLUDE_TOO_LONG;
+    if (length < rules->minChars) return EXCLUDE_TOO_SHORT;
+    if (!rules->built) return EXCLUDE_NONE;
+    if (rules->stateCount > 1 && length >= rules->shortest) {
+        ExcludeKind kind = ExcludeScan(rules, text, length);
+        if (kind != EXCLUDE_NONE) return kind;
+    }
+    for (size_t i = 0; i < rules->regexCount; ++i) {
+        if (RegexMatch(&rules->regexes[i], text, length)) return EXCLUDE_REGEX;
+    }
+    return EXCLUDE_NONE;
+}
@@ -0,0 +1,97 @@
+#ifndef MCLIP_EXCLUDE_H
+#define MCLIP_EXCLUDE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include "regex.h"
+
+// --- Exclusion Rules ---
+// Clipboard text that must never enter the history: passwords, access
+// tokens, huge generated blobs. Rules are
+//
+//   contains=TEXT   the text contains TEXT
+//   prefix=TEXT     a word of the text starts with TEXT (ghp_, AKIA): TEXT
+//                   at the start or after a character that is not a letter,
+//                   digit or '_'
+//   regex=PATTERN   the pattern matches somewhere (syntax of regex.h)
+//   max_chars=N     the text is longer than N characters
+//   min_chars=N     the text is shorter than N characters
+//
+// all case-insensitive, like searches (TextFoldChar). ExcludeRulesBuild
+// compiles every contains and prefix rule into one Aho-Corasick automaton,
+// a full transition table over the classes of the characters the rules
+// use, so checking a text is a single pass at one table lookup per
+// character however many rules there are. The length limits are checked
+// first, at no cost. Regex rules are joined into alternations of up to
+// REGEX_MAX_PATTERN characters, each a single DFA pass (see regex.h): a
+// handful of them cost one extra pass, not one per rule.
+//
+// Checking runs the regex DFAs, which modifies them: one thread at a time.
+
+#define EXCLUDE_MAX_STATES (1u << 20)             // Automaton states: characters of the literal rules, plus one
+#define EXCLUDE_MAX_TABLE_BYTES (64u << 20)       // Its transition table (under 2^31 entries)
+
+typedef enum {
+    EXCLUDE_NONE = 0,    // Not excluded
+    EXCLUDE_TOO_LONG,    // Over max_chars
+    EXCLUDE_TOO_SHORT,   // Under min_chars
+    EXCLUDE_CONTAINS,
+    EXCLUDE_PREFIX,
+    EXCLUDE_REGEX
+} ExcludeKind;
+
+typedef struct {
+    ExcludeKind kind;    // EXCLUDE_CONTAINS, EXCLUDE_PREFIX or EXCLUDE_REGEX
+    wchar_t* pattern;    // Owned; folded for the literal kinds
+    size_t length;
+} ExcludeRule;
+
+typedef struct {
+    ExcludeRule* rules;
+    size_t count;
+    size_t capacity;
+    size_t maxChars;     // 0 = no limit
+    size_t minChars;
+
+    // Automaton over the literal rules (ExcludeRulesBuild)
+    uint32_t* next;      // [state * classCount + class]: next state's row (exclude.c)
+    uint8_t* flags;      // Per state: EXCLUDE_STATE_* (exclude.c)
+    uint32_t* depth;     // Per state: characters from the root
+    uint32_t* prefixLink; // Per state: nearest proper suffix state ending a prefix rule, 0 = none
+    uint32_t stateCount;
+    uint32_t classCount; // Class 0: characters in no rule
+    uint16_t byteClass[256];  // Class of each (folded) character below 256 ...
+    wchar_t* wideChars;  // ... and of the others the rules use, sorted
+    uint16_t* wideClasses;
+    size_t wideCount;
+    size_t shortest;     // Length of the shortest literal rule
+
+    Regex* regexes;      // Alternations of the regex rules
+    size_t regexCount;
+    bool built;
+} ExcludeRules;
+
+void ExcludeRulesInit(ExcludeRules* rules);
+void ExcludeRulesFree(ExcludeRules* rules);
+
+// Adds a contains, prefix or regex rule. False if the pattern is empty, too
+// long, does not compile (regexes) or memory ran out. Takes effect at the
+// next ExcludeRulesBuild.
+bool ExcludeRulesAdd(ExcludeRules* rules, ExcludeKind kind, const wchar_t* pattern, size_t length);
+
+// Adds one "key=value" line of the list above (as in a settings.ini
+// section). False, and nothing added, if it is not understood.
+bool ExcludeRulesAddSetting(ExcludeRules* rules, const wchar_t* line);
+
+// Compiles the rules added so far. False if the automaton would be over the
+// limits above or memory ran out: nothing but the length limits is checked then.
+bool ExcludeRulesBuild(ExcludeRules* rules);
+
+// Whether, and by which kind of rule, the text of 'length' characters is
+// excluded. Cost O(length), independent of the number of literal rules.
+ExcludeKind ExcludeCheck(ExcludeRules* rules, const wchar_t* text, size_t length);
+
+#endif // MCLIP_EXCLUDE_H
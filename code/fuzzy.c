@@ -0,0 +1,215 @@
+#include "fuzzy.h"
+#include "textmatch.h"
+
+#include <string.h>
+#include <wctype.h>
+
+typedef enum {
+    FUZZY_CLASS_WHITE = 0,
+    FUZZY_CLASS_DELIMITER,
+    FUZZY_CLASS_NON_WORD,
+    FUZZY_CLASS_LOWER,
+    FUZZY_CLASS_UPPER,
+    FUZZY_CLASS_LETTER,   // Letters without case
+    FUZZY_CLASS_NUMBER
+} FuzzyCharClass;
+
+// Class of each ASCII character
+#define W FUZZY_CLASS_WHITE
+#define D FUZZY_CLASS_DELIMITER
+#define P FUZZY_CLASS_NON_WORD
+#define L FUZZY_CLASS_LOWER
+#define U FUZZY_CLASS_UPPER
+#define N FUZZY_CLASS_NUMBER
+static const unsigned char g_asciiClass[128] = {
+    P, P, P, P, P, P, P, P, P, W, W, W, W, W, P, P,
+    P, P, P, P, P, P, P, P, P, P, P, P, P, P, P, P,
+    W, P, P, P, P, P, P, P, P, P, P, P, D, P, P, D,
+    N, N, N, N, N, N, N, N, N, N, D, D, P, P, P, P,
+    P, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U,
+    U, U, U, U, U, U, U, U, U, U, U, P, P, P, P, P,
+    P, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+    L, L, L, L, L, L, L, L, L, L, L, P, D, P, P, P,
+};
+#undef W
+#undef D
+#undef P
+#undef L
+#undef U
+#undef N
+
+// FuzzyCharBit index of each folded ASCII character
+static const unsigned char g_asciiBit[128] = {
+    36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56,
+    26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 40, 41, 42, 43, 44, 45,
+    46,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 46, 47, 48, 49, 50,
+    51,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 51, 52, 53, 54, 55,
+};
+
+// ASCII fast path of TextFoldChar, which is a call per character otherwise
+static inline wchar_t
+FuzzyFold(wchar_t c)
+{
+    if (c < 0x80) return (c >= L'A' && c <= L'Z') ? (wchar_t)(c | 0x20) : c;
+    return TextFoldChar(c);
+}
+
+static inline FuzzyCharClass
+FuzzyClassOf(wchar_t c)
+{
+    if (c < 0x80) return (FuzzyCharClass)g_asciiClass[c];
+    if (iswspace((wint_t)c)) return FUZZY_CLASS_WHITE;
+    if (iswupper((wint_t)c)) return FUZZY_CLASS_UPPER;
+    if (iswlower((wint_t)c)) return FUZZY_CLASS_LOWER;
+    if (iswdigit((wint_t)c)) return FUZZY_CLASS_NUMBER;
+    if (iswalpha((wint_t)c)) return FUZZY_CLASS_LETTER;
+    return FUZZY_CLASS_NON_WORD;
+}
+
+// Bonus for a matched character of class 'current' following one of class 'previous'
+static int32_t
+FuzzyBonus(FuzzyCharClass previous, FuzzyCharClass current)
+{
+    if (current > FUZZY_CLASS_NON_WORD) {
+        switch (previous) {
+        case FUZZY_CLASS_WHITE: return FUZZY_BONUS_BOUNDARY_WHITE;
+        case FUZZY_CLASS_DELIMITER: return FUZZY_BONUS_BOUNDARY_DELIMITER;
+        case FUZZY_CLASS_NON_WORD: return FUZZY_BONUS_BOUNDARY;
+        default: break;
+        }
+    }
+    if ((previous == FUZZY_CLASS_LOWER && current == FUZZY_CLASS_UPPER) ||
+        (previous != FUZZY_CLASS_NUMBER && current == FUZZY_CLASS_NUMBER)) {
+        return FUZZY_BONUS_CAMEL;
+    }
+    if (current <= FUZZY_CLASS_NON_WORD) return FUZZY_BONUS_NON_WORD;
+    return 0;
+}
+
+// Bit of one folded character in a FuzzyCharMask
+static inline uint64_t
+FuzzyCharBit(wchar_t folded)
+{
+    if (folded >= L'a' && folded <= L'z') return 1ull << (folded - L'a');
+    if (folded >= L'0' && folded <= L'9') return 1ull << (26 + folded - L'0');
+    if (folded < 0x80) return 1ull << (36 + folded % 27);
+    return 1ull << 63;
+}
+
+void
+FuzzyCompile(FuzzyPattern* fuzzy, const wchar_t* pattern, size_t length)
+{
+    fuzzy->termCount = 0;
+    fuzzy->mask = 0;
+
+    size_t used = 0;
+    bool inTerm = false;
+    for (size_t i = 0; i < length && used < FUZZY_MAX_PATTERN; ++i) {
+        if (pattern[i] == L' ') {
+            inTerm = false;
+            continue;
+        }
+        if (!inTerm) {
+            if (fuzzy->termCount == FUZZY_MAX_TERMS) break;
+            fuzzy->termStart[fuzzy->termCount] = (uint16_t)used;
+            fuzzy->termLength[fuzzy->termCount] = 0;
+            fuzzy->termCount++;
+            inTerm = true;
+        }
+        wchar_t folded = FuzzyFold(pattern[i]);
+        fuzzy->chars[used++] = folded;
+        fuzzy->termLength[fuzzy->termCount - 1]++;
+        fuzzy->mask |= FuzzyCharBit(folded);
+    }
+}
+
+uint64_t
+FuzzyCharMask(const wchar_t* text, size_t length)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < length; ++i) {
+        wchar_t c = text[i];
+        // Non-ASCII characters fold first: some fold into ASCII (e.g. the Kelvin sign)
+        mask |= c < 0x80 ? 1ull << g_asciiBit[c] : FuzzyCharBit(TextFoldChar(c));
+    }
+    return mask;
+}
+
+// Scores one term over the window [start, end) found by FuzzyMatchTerm
+static int32_t
+FuzzyScoreWindow(const wchar_t* term, size_t termLength, const wchar_t* text, size_t start, size_t end)
+{
+    FuzzyCharClass previous = start > 0 ? FuzzyClassOf(text[start - 1]) : FUZZY_CLASS_WHITE;
+    int32_t score = 0;
+    int32_t firstBonus = 0; // Bonus of the first character of the current run
+    size_t consecutive = 0;
+    bool inGap = false;
+    size_t matched = 0;
+
+    for (size_t i = start; i < end; ++i) {
+        FuzzyCharClass current = FuzzyClassOf(text[i]);
+        if (matched < termLength && FuzzyFold(text[i]) == term[matched]) {
+            int32_t bonus = FuzzyBonus(previous, current);
+            if (consecutive == 0) {
+                firstBonus = bonus;
+            } else {
+                // A run inherits the bonus of its start, so "foo" in "xFooBar" beats "f..o..o"
+                if (bonus >= FUZZY_BONUS_BOUNDARY && bonus > firstBonus) firstBonus = bonus;
+                if (firstBonus > bonus) bonus = firstBonus;
+                if (bonus < FUZZY_BONUS_CONSECUTIVE) bonus = FUZZY_BONUS_CONSECUTIVE;
+            }
+            score += FUZZY_SCORE_MATCH + (matched == 0 ? bonus * FUZZY_BONUS_FIRST_MULTIPLIER : bonus);
+            inGap = false;
+            consecutive++;
+            matched++;
+        } else {
+            score += inGap ? FUZZY_SCORE_GAP_EXTENSION : FUZZY_SCORE_GAP_START;
+            inGap = true;
+            consecutive = 0;
+            firstBonus = 0;
+        }
+        previous = current;
+    }
+    return score;
+}
+
+// Finds the term as a subsequence: the first complete occurrence scanning
+// forward, then the shortest window ending there scanning backward
+static bool
+FuzzyMatchTerm(const wchar_t* term, size_t termLength, const wchar_t* text, size_t length, int32_t* score)
+{
+    size_t matched = 0;
+    size_t end = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (FuzzyFold(text[i]) == term[matched] && ++matched == termLength) {
+            end = i + 1;
+            break;
+        }
+    }
+    if (matched < termLength) return false;
+
+    size_t start = end;
+    while (matched > 0) {
+        --start;
+        if (FuzzyFold(text[start]) == term[matched - 1]) matched--;
+    }
+
+    *score += FuzzyScoreWindow(term, termLength, text, start, end);
+    return true;
+}
+
+bool
+FuzzyMatch(const FuzzyPattern* fuzzy, const wchar_t* text, size_t length, int32_t* score)
+{
+    int32_t total = 0;
+    for (size_t t = 0; t < fuzzy->termCount; ++t) {
+        const wchar_t* term = fuzzy->chars + fuzzy->termStart[t];
+        if (!FuzzyMatchTerm(term, fuzzy->termLength[t], text, length, &total)) return false;
+    }
+    if (score) *score = total;
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef MCLIP_FUZZY_H
+#define MCLIP_FUZZY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+// --- Fuzzy Matching ---
+// fzf-style ranked matching. A pattern is split on spaces into terms; an entry
+// matches if every term occurs in it as a case-insensitive subsequence. Each
+// term is located greedily (first occurrence forward, then shortened
+// backward) and scored over the window it spans: points per matched
+// character, bonuses for characters at word boundaries, camelCase humps and
+// consecutive runs, penalties for gaps. A term's first character counts its
+// bonus twice. The entry's score is the sum over its terms.
+//
+// FuzzyCharMask gives a 64-bit set of the (folded) characters in a text. An
+// entry can only match if its mask contains the pattern's, so callers that
+// keep masks around reject most non-candidates with one AND.
+
+#define FUZZY_MAX_PATTERN 256 // Characters kept from a pattern; the rest is ignored
+#define FUZZY_MAX_TERMS 16    // Terms kept from a pattern; the rest are ignored
+
+#define FUZZY_SCORE_MATCH 16
+#define FUZZY_SCORE_GAP_START -3
+#define FUZZY_SCORE_GAP_EXTENSION -1
+#define FUZZY_BONUS_BOUNDARY_WHITE 10 // After whitespace or at the start of the text
+#define FUZZY_BONUS_BOUNDARY_DELIMITER 9 // After / , : ; |
+#define FUZZY_BONUS_BOUNDARY 8        // After other punctuation
+#define FUZZY_BONUS_NON_WORD 8        // The character is punctuation itself
+#define FUZZY_BONUS_CAMEL 7           // lower -> Upper, or letter -> digit
+#define FUZZY_BONUS_CONSECUTIVE 4     // Minimum bonus inside a run of matches
+#define FUZZY_BONUS_FIRST_MULTIPLIER 2
+
+typedef struct {
+    wchar_t chars[FUZZY_MAX_PATTERN]; // Folded characters of all terms, back to back
+    uint16_t termStart[FUZZY_MAX_TERMS];
+    uint16_t termLength[FUZZY_MAX_TERMS];
+    size_t termCount;                 // 0: the pattern matches everything
+    uint64_t mask;                    // FuzzyCharMask of all terms
+} FuzzyPattern;
+
+// Prepares 'pattern' (case-folded, split on spaces)
+void FuzzyCompile(FuzzyPattern* fuzzy, const wchar_t* pattern, size_t length);
+
+// Set of folded characters in the text (letters and digits exactly, other
+// ASCII in shared buckets, everything else in one bit)
+uint64_t FuzzyCharMask(const wchar_t* text, size_t length);
+
+// True if every term matches 'text'; *score (optional) gets the total score
+bool FuzzyMatch(const FuzzyPattern* fuzzy, const wchar_t* text, size_t length, int32_t* score);
+
+#endif // MCLIP_FUZZY_H
@@ -0,0 +1,136 @@
+#include "hashindex.h"
+
+#include <stdlib.h>
+
+static bool
+HashIndexAllocate(HashIndex* index, size_t bucketCount)
+{
+    index->buckets = malloc(bucketCount * sizeof(HashIndexBucket));
+    if (!index->buckets) return false;
+
+    for (size_t i = 0; i < bucketCount; ++i) {
+        index->buckets[i].value = HASH_INDEX_EMPTY;
+    }
+    index->mask = bucketCount - 1;
+    index->count = 0;
+    return true;
+}
+
+// Places a pair without checking load (caller guarantees a free bucket)
+static void
+HashIndexPlace(HashIndex* index, uint32_t hash, uint32_t value)
+{
+    size_t pos = hash & index->mask;
+    while (index->buckets[pos].value != HASH_INDEX_EMPTY) {
+        pos = (pos + 1) & index->mask;
+    }
+    index->buckets[pos].hash = hash;
+    index->buckets[pos].value = value;
+    index->count++;
+}
+
+bool
+HashIndexInit(HashIndex* index, size_t expected)
+{
+    // Keep load at or below 50% for the expected size
+    size_t bucketCount = 16;
+    while (bucketCount < expected * 2) bucketCount <<= 1;
+
+    index->buckets = NULL;
+    return HashIndexAllocate(index, bucketCount);
+}
+
+void
+HashIndexFree(HashIndex* index)
+{
+    free(index->buckets);
+    index->buckets = NULL;
+    index->mask = 0;
+    index->count = 0;
+}
+
+static bool
+HashIndexGrow(HashIndex* index)
+{
+    HashIndex grown;
+    size_t oldCount = index->mask + 1;
+    if (!HashIndexAllocate(&grown, oldCount * 2)) return false;
+
+    for (size_t i = 0; i < oldCount; ++i) {
+        if (index->buckets[i].value != HASH_INDEX_EMPTY) {
+            HashIndexPlace(&grown, index->buckets[i].hash, index->buckets[i].value);
+        }
+    }
+    free(index->buckets);
+    *index = grown;
+    return true;
+}
+
+bool
+HashIndexInsert(HashIndex* index, uint32_t hash, uint32_t value)
+{
+    if ((index->count + 1) * 4 > (index->mask + 1) * 3) {
+        if (!HashIndexGrow(index)) return false;
+    }
+    HashIndexPlace(index, hash, value);
+    return true;
+}
+
+bool
+HashIndexRemove(HashIndex* index, uint32_t hash, uint32_t value)
+{
+    size_t pos = hash & index->mask;
+    for (;;) {
+        HashIndexBucket* bucket = &index->buckets[pos];
+        if (bucket->value == HASH_INDEX_EMPTY) return false;
+        if (bucket->hash == hash && bucket->value == value) break;
+        pos = (pos + 1) & index->mask;
+    }
+
+    // Backward-shift deletion: pull later members of the probe chain into the hole
+    size_t hole = pos;
+    size_t next = (hole + 1) & index->mask;
+    while (index->buckets[next].value != HASH_INDEX_EMPTY) {
+        size_t home = index->buckets[next].hash & index->mask;
+        // Move if 'home' is not cyclically within (hole, next]
+        bool canMove = (hole <= next) ? (home <= hole || home > next)
+                                      : (home <= hole && home > next);
+        if (canMove) {
+            index->buckets[hole] = index->buckets[next];
+            hole = next;
+        }
+        next = (next + 1) & index->mask;
+    }
+    index->buckets[hole].value = HASH_INDEX_EMPTY;
+    index->count--;
+    return true;
+}
+
+void
+HashIndexFind(const HashIndex* index, uint32_t hash, HashIndexIter* iter)
+{
+    iter->index = index;
+    iter->pos = hash & index->mask;
+    iter->hash = hash;
+}
+
+bool
+HashIndexNext(HashIndexIter* iter, uint32_t* value)
+{
+    const HashIndex* index = iter->index;
+    for (;;) {
+        const HashIndexBucket* bucket = &index->buckets[iter->pos];
+        if (bucket->value == HASH_INDEX_EMPTY) return false;
+        iter->pos = (iter->pos + 1) & index->mask;
+        if (bucket->hash == iter->hash) {
+            *value = bucket->value;
+            return true;
+        }
+    }
+}
+
+size_t
+HashIndexMemory(const HashIndex* index)
+{
+    return index->buckets ? (index->mask + 1) * sizeof(HashIndexBucket) : 0;
+}
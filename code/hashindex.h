@@ -0,0 +1,53 @@
+#ifndef MCLIP_HASHINDEX_H
+#define MCLIP_HASHINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- Hash Index ---
+// Open-addressing multimap from a 32-bit hash to a 32-bit value (slot number).
+// Linear probing with backward-shift deletion, so there are no tombstones and
+// lookups stay short under constant insert/evict churn. Several values may
+// share one hash; callers confirm a hit by comparing the real content.
+
+#define HASH_INDEX_EMPTY UINT32_MAX
+
+typedef struct {
+    uint32_t hash;
+    uint32_t value;       // HASH_INDEX_EMPTY marks an unused bucket
+} HashIndexBucket;
+
+typedef struct {
+    HashIndexBucket* buckets;
+    size_t mask;          // Bucket count - 1 (power of two)
+    size_t count;
+} HashIndex;
+
+typedef struct {
+    const HashIndex* index;
+    size_t pos;
+    uint32_t hash;
+} HashIndexIter;
+
+// Sizes the table for 'expected' values without growing
+bool HashIndexInit(HashIndex* index, size_t expected);
+void HashIndexFree(HashIndex* index);
+
+// Adds a (hash, value) pair. Grows the table past 75% load; false on allocation failure.
+bool HashIndexInsert(HashIndex* index, uint32_t hash, uint32_t value);
+
+// Removes one (hash, value) pair. Returns false if it was not present.
+bool HashIndexRemove(HashIndex* index, uint32_t hash, uint32_t value);
+
+// Iterates all values stored under 'hash':
+//   HashIndexIter it; uint32_t v;
+//   HashIndexFind(&index, hash, &it);
+//   while (HashIndexNext(&it, &v)) { ... }
+void HashIndexFind(const HashIndex* index, uint32_t hash, HashIndexIter* iter);
+bool HashIndexNext(HashIndexIter* iter, uint32_t* value);
+
+// Bytes held by the bucket array
+size_t HashIndexMemory(const HashIndex* index);
+
+#endif // MCLIP_HASHINDEX_H
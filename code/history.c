@@ -0,0 +1,1621 @@
+#include "history.h"
+#include "lz.h"
+#include "platform.h"
+#include "textmatch.h"
+#include "utf8.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define HISTORY_NOT_SPILLED UINT64_MAX
+
+struct HistoryPacked {
+    uint32_t packedBytes;  // LZ stream size, stream follows the header unless spilled
+    uint32_t utf8Bytes;    // Size of the UTF-8 text it decodes to
+    uint64_t spillOffset;  // Where the stream is in the spill file, HISTORY_NOT_SPILLED if in the arena
+};
+
+typedef struct {
+    wchar_t* text;         // Decoded text (NUL-terminated), NULL if the slot is unused
+    size_t capacity;       // Characters 'text' has room for
+    uint32_t seq;          // Entry it belongs to
+    uint64_t lastUse;
+} HistoryTextSlot;
+
+struct HistoryDecoder {
+    HistoryTextSlot slots[HISTORY_TEXT_CACHE_SLOTS];
+    uint64_t useClock;
+    char* utf8;            // Scratch for the intermediate UTF-8 (and a spilled stream after it)
+    size_t utf8Capacity;
+    uint64_t decodes;
+    uint64_t decodeNs;
+    uint64_t decodeMaxNs;
+};
+
+// Last HistoryGetInOrder position, per HistoryOrder
+struct HistoryCursor {
+    uint64_t generation;   // History generation the positions belong to
+    size_t index[2];
+    uint32_t slot[2];      // HISTORY_NO_SLOT: none
+};
+
+static unsigned
+HistoryPopCount(uint64_t value)
+{
+#if defined(_MSC_VER)
+    return (unsigned)__popcnt64(value);
+#else
+    return (unsigned)__builtin_popcountll(value);
+#endif
+}
+
+// Key of a sequence number in 'seqs'. Live ones are mostly consecutive, which
+// linear probing would pile up into one long run; this spreads them, and
+// being a bijection, never makes two collide.
+static inline uint32_t
+HistorySeqHash(uint32_t seq)
+{
+    seq ^= seq >> 16;
+    seq *= 0x85ebca6bu;
+    seq ^= seq >> 13;
+    seq *= 0xc2b2ae35u;
+    seq ^= seq >> 16;
+    return seq;
+}
+
+static void
+HistoryForgetCursor(HistoryCursor* cursor)
+{
+    cursor->slot[HISTORY_ORDER_RECENT] = cursor->slot[HISTORY_ORDER_FREQUENT] = HISTORY_NO_SLOT;
+}
+
+// --- Recency Stamps ---
+// Every entry has a stamp, higher the more recently it was used, and the
+// stamps in use are bits of a bitmap with a count per block. The recency
+// index of an entry is the number of stamps above its own. Stamps are handed
+// out in increasing order and renumbered 0..count-1 when the window runs
+// out; the window is at least twice the capacity, so that is amortized O(1).
+
+static void
+HistoryMarkStamp(History* history, uint32_t stamp, bool live)
+{
+    uint64_t bit = 1ull << (stamp % 64);
+    if (live) {
+        history->stamps[stamp / 64] |= bit;
+        history->stampBlocks[stamp / HISTORY_STAMP_BLOCK]++;
+    } else {
+        history->stamps[stamp / 64] &= ~bit;
+        history->stampBlocks[stamp / HISTORY_STAMP_BLOCK]--;
+    }
+}
+
+static void
+HistoryRenumberStamps(History* history)
+{
+    memset(history->stamps, 0, history->stampWindow / 8);
+    memset(history->stampBlocks, 0, history->stampWindow / HISTORY_STAMP_BLOCK * sizeof(uint32_t));
+    uint32_t stamp = 0;
+    for (uint32_t slot = history->oldest; slot != HISTORY_NO_SLOT; slot = history->entries[slot].newer) {
+        history->entries[slot].stamp = stamp;
+        HistoryMarkStamp(history, stamp++, true);
+    }
+    history->nextStamp = stamp;
+}
+
+// A stamp above all others. The entry it is for must not be linked yet.
+static uint32_t
+HistoryTakeStamp(History* history)
+{
+    if (history->nextStamp == history->stampWindow) HistoryRenumberStamps(history);
+    uint32_t stamp = history->nextStamp++;
+    HistoryMarkStamp(history, stamp, true);
+    return stamp;
+}
+
+// Stamps in use in [from, to), both within one word range of the bitmap
+static size_t
+HistoryCountBits(const uint64_t* bits, size_t from, size_t to)
+{
+    size_t count = 0;
+    while (from < to) {
+        size_t shift = from % 64;
+        size_t span = 64 - shift;
+        uint64_t word = bits[from / 64] >> shift;
+        if (to - from < span) {
+            span = to - from;
+            word &= (1ull << span) - 1;
+        }
+        count += HistoryPopCount(word);
+        from += span;
+    }
+    return count;
+}
+
+// Stamps in use in [from, to): bits at the ends, block counts in between
+static size_t
+HistoryCountStamps(const History* history, size_t from, size_t to)
+{
+    if (from >= to) return 0;
+    size_t first = from / HISTORY_STAMP_BLOCK;
+    size_t last = (to - 1) / HISTORY_STAMP_BLOCK;
+    if (first == last) return HistoryCountBits(history->stamps, from, to);
+
+    size_t count = HistoryCountBits(history->stamps, from, (first + 1) * HISTORY_STAMP_BLOCK) +
+                   HistoryCountBits(history->stamps, last * HISTORY_STAMP_BLOCK, to);
+    for (size_t block = first + 1; block < last; ++block) count += history->stampBlocks[block];
+    return count;
+}
+
+// --- Use Buckets ---
+
+// Chains a bucket for entries used 'uses' times in between two others
+static uint32_t
+HistoryNewBucket(History* history, uint32_t uses, uint32_t more, uint32_t fewer)
+{
+    uint32_t id = history->freeBucket; // There is always one: see HistoryResize
+    HistoryUseBucket* bucket = &history->buckets[id];
+    history->freeBucket = bucket->more;
+    bucket->uses = uses;
+    bucket->newest = bucket->oldest = HISTORY_NO_SLOT;
+    bucket->more = more;
+    bucket->fewer = fewer;
+    if (more != HISTORY_NO_SLOT) history->buckets[more].fewer = id;
+    else history->mostUsed = id;
+    if (fewer != HISTORY_NO_SLOT) history->buckets[fewer].more = id;
+    else history->leastUsed = id;
+    return id;
+}
+
+static void
+HistoryDropBucket(History* history, uint32_t id)
+{
+    HistoryUseBucket* bucket = &history->buckets[id];
+    if (bucket->more != HISTORY_NO_SLOT) history->buckets[bucket->more].fewer = bucket->fewer;
+    else history->mostUsed = bucket->fewer;
+    if (bucket->fewer != HISTORY_NO_SLOT) history->buckets[bucket->fewer].more = bucket->more;
+    else history->leastUsed = bucket->more;
+    bucket->more = history->freeBucket;
+    history->freeBucket = id;
+}
+
+// Bucket of the entries used 'uses' times, chained in if there is none
+static uint32_t
+HistoryBucketFor(History* history, uint32_t uses)
+{
+    uint32_t fewer = HISTORY_NO_SLOT, bucket = history->leastUsed;
+    while (bucket != HISTORY_NO_SLOT && history->buckets[bucket].uses < uses) {
+        fewer = bucket;
+        bucket = history->buckets[bucket].more;
+    }
+    if (bucket != HISTORY_NO_SLOT && history->buckets[bucket].uses == uses) return bucket;
+    return HistoryNewBucket(history, uses, bucket, fewer);
+}
+
+// Makes an entry the most recent one of bucket 'id'
+static void
+HistoryBucketPush(History* history, uint32_t slot, uint32_t id)
+{
+    HistoryEntry* entry = &history->entries[slot];
+    HistoryUseBucket* bucket = &history->buckets[id];
+    entry->bucket = id;
+    entry->bucketNewer = HISTORY_NO_SLOT;
+    entry->bucketOlder = bucket->newest;
+    if (bucket->newest != HISTORY_NO_SLOT) history->entries[bucket->newest].bucketNewer = slot;
+    else bucket->oldest = slot;
+    bucket->newest = slot;
+}
+
+// Takes an entry out of its bucket, which is left in place even if empty
+static void
+HistoryBucketUnlink(History* history, uint32_t slot)
+{
+    HistoryEntry* entry = &history->entries[slot];
+    HistoryUseBucket* bucket = &history->buckets[entry->bucket];
+    if (entry->bucketNewer != HISTORY_NO_SLOT) history->entries[entry->bucketNewer].bucketOlder = entry->bucketOlder;
+    else bucket->newest = entry->bucketOlder;
+    if (entry->bucketOlder != HISTORY_NO_SLOT) history->entries[entry->bucketOlder].bucketNewer = entry->bucketNewer;
+    else bucket->oldest = entry->bucketNewer;
+}
+
+// --- Recency List ---
+
+static void
+HistoryLinkNewest(History* history, uint32_t slot)
+{
+    HistoryEntry* entry = &history->entries[slot];
+    entry->stamp = HistoryTakeStamp(history);
+    entry->newer = HISTORY_NO_SLOT;
+    entry->older = history->newest;
+    if (history->newest != HISTORY_NO_SLOT) history->entries[history->newest].newer = slot;
+    else history->oldest = slot;
+    history->newest = slot;
+}
+
+static void
+HistoryUnlink(History* history, uint32_t slot)
+{
+    HistoryEntry* entry = &history->entries[slot];
+    if (entry->newer != HISTORY_NO_SLOT) history->entries[entry->newer].older = entry->older;
+    else history->newest = entry->older;
+    if (entry->older != HISTORY_NO_SLOT) history->entries[entry->older].newer = entry->newer;
+    else history->oldest = entry->newer;
+    HistoryMarkStamp(history, entry->stamp, false);
+}
+
+static bool HistoryResize(History* history, size_t capacity);
+
+bool
+HistoryInit(History* history, size_t maxEntries)
+{
+    memset(history, 0, sizeof(*history));
+    history->spill.handle = -1;
+    history->newest = history->oldest = history->freeSlot = HISTORY_NO_SLOT;
+    history->mostUsed = history->leastUsed = history->freeBucket = HISTORY_NO_SLOT;
+    MetaSourcesInit(&history->sources);
+    if (maxEntries == 0) return false;
+
+    history->decoder = calloc(1, sizeof(HistoryDecoder));
+    history->cursor = calloc(1, sizeof(HistoryCursor));
+    size_t capacity = maxEntries < HISTORY_MIN_SLOTS ? maxEntries : HISTORY_MIN_SLOTS;
+    if (!history->decoder || !history->cursor || !HistoryResize(history, capacity)) {
+        free(history->decoder);
+        free(history->cursor);
+        history->decoder = NULL;
+        history->cursor = NULL;
+        return false;
+    }
+
+    ArenaInit(&history->arena);
+    history->maxEntries = maxEntries;
+    return true;
+}
+
+void
+HistoryFree(History* history)
+{
+    // Entry text lives in the arena and goes away with it (borrowed text is the caller's)
+    free(history->entries);
+    free(history->buckets);
+    free(history->stamps);
+    free(history->stampBlocks);
+    free(history->cursor);
+    HashIndexFree(&history->index);
+    HashIndexFree(&history->seqs);
+    MetaColumnsFree(&history->meta);
+    MetaSourcesFree(&history->sources);
+    ArenaFree(&history->arena);
+    HistoryEnableTrigramIndex(history, false);
+    HistoryEnableNearDuplicates(history, NULL);
+    if (history->decoder) {
+        for (size_t i = 0; i < HISTORY_TEXT_CACHE_SLOTS; ++i) free(history->decoder->slots[i].text);
+        free(history->decoder->utf8);
+        free(history->decoder);
+    }
+    PlatformFileClose(&history->spill);
+    memset(history, 0, sizeof(*history));
+    history->spill.handle = -1;
+}
+
+// --- Capacity ---
+
+// Moves the entries into a pool of 'capacity' slots (at least 'count'),
+// oldest in slot 0, with their metadata, and rebuilds what refers to slots:
+// the recency list, the use buckets (in the same order), both hash indexes and the stamps. Recency
+// indices and sequence numbers stay as they were. False (and nothing
+// changed) if memory runs out.
+static bool
+HistoryResize(History* history, size_t capacity)
+{
+    size_t window = (2 * capacity + HISTORY_STAMP_BLOCK - 1) / HISTORY_STAMP_BLOCK * HISTORY_STAMP_BLOCK;
+    HistoryEntry* entries = calloc(capacity, sizeof(HistoryEntry));
+    HistoryUseBucket* buckets = malloc((capacity + 1) * sizeof(HistoryUseBucket));
+    uint32_t* bucketIds = malloc((history->capacity + 1) * sizeof(uint32_t)); // Old bucket -> new
+    uint64_t* stamps = calloc(window / 64, sizeof(uint64_t));
+    uint32_t* stampBlocks = calloc(window / HISTORY_STAMP_BLOCK, sizeof(uint32_t));
+    HashIndex index = { 0 }, seqs = { 0 };
+    MetaColumns meta = { 0 };
+    bool ok = entries && buckets && bucketIds && stamps && stampBlocks &&
+              HashIndexInit(&index, capacity) && HashIndexInit(&seqs, capacity) && MetaColumnsInit(&meta, capacity);
+
+    uint32_t count = 0;
+    for (uint32_t old = history->oldest; ok && old != HISTORY_NO_SLOT; old = history->entries[old].newer) {
+        HistoryEntry* entry = &entries[count];
+        *entry = history->entries[old];
+        entry->older = count > 0 ? count - 1 : HISTORY_NO_SLOT;
+        entry->newer = count + 1 < history->count ? count + 1 : HISTORY_NO_SLOT;
+        entry->stamp = count;
+        stamps[count / 64] |= 1ull << (count % 64);
+        stampBlocks[count / HISTORY_STAMP_BLOCK]++;
+        ok = HashIndexInsert(&index, entry->hash, count) && HashIndexInsert(&seqs, HistorySeqHash(entry->seq), count);
+        MetaColumnsCopy(&meta, count, &history->meta, old);
+        count++;
+    }
+    if (!ok) {
+        free(entries);
+        free(buckets);
+        free(bucketIds);
+        free(stamps);
+        free(stampBlocks);
+        HashIndexFree(&index);
+        HashIndexFree(&seqs);
+        MetaColumnsFree(&meta);
+        return false;
+    }
+
+    uint32_t used = 0;
+    for (uint32_t old = history->mostUsed; old != HISTORY_NO_SLOT; old = history->buckets[old].fewer, ++used) {
+        bucketIds[old] = used;
+        buckets[used].uses = history->buckets[old].uses;
+        buckets[used].newest = buckets[used].oldest = HISTORY_NO_SLOT;
+        buckets[used].more = used > 0 ? used - 1 : HISTORY_NO_SLOT;
+        buckets[used].fewer = HISTORY_NO_SLOT;
+        if (used > 0) buckets[used - 1].fewer = used;
+    }
+    for (size_t id = used; id <= capacity; ++id) buckets[id].more = id < capacity ? (uint32_t)id + 1 : HISTORY_NO_SLOT;
+    for (size_t slot = count; slot < capacity; ++slot) {
+        entries[slot].older = slot + 1 < capacity ? (uint32_t)slot + 1 : HISTORY_NO_SLOT;
+    }
+
+    free(history->entries);
+    free(history->buckets);
+    free(history->stamps);
+    free(history->stampBlocks);
+    HashIndexFree(&history->index);
+    HashIndexFree(&history->seqs);
+    MetaColumnsFree(&history->meta);
+    history->entries = entries;
+    history->buckets = buckets;
+    history->stamps = stamps;
+    history->stampBlocks = stampBlocks;
+    history->index = index;
+    history->seqs = seqs;
+    history->meta = meta;
+    history->capacity = capacity;
+    history->stampWindow = window;
+    history->nextStamp = count;
+    history->newest = count > 0 ? count - 1 : HISTORY_NO_SLOT;
+    history->oldest = count > 0 ? 0 : HISTORY_NO_SLOT;
+    history->freeSlot = count < capacity ? count : HISTORY_NO_SLOT;
+    history->mostUsed = used > 0 ? 0 : HISTORY_NO_SLOT;
+    history->leastUsed = used > 0 ? used - 1 : HISTORY_NO_SLOT;
+    history->freeBucket = used <= capacity ? used : HISTORY_NO_SLOT;
+
+    // Oldest first, so the most recent of each bucket ends up in front
+    for (uint32_t slot = 0; slot < count; ++slot) HistoryBucketPush(history, slot, bucketIds[entries[slot].bucket]);
+    free(bucketIds);
+    HistoryForgetCursor(history->cursor);
+    return true;
+}
+
+// Most slots the pool may have (0 = no limit): the entry limit, plus one with
+// near-duplicates on, where a replacement is stored before the entry it
+// replaces is removed
+static size_t
+HistorySlotLimit(const History* history)
+{
+    if (history->maxEntries == 0) return 0;
+    return history->maxEntries + (history->nearDups ? 1 : 0);
+}
+
+// Makes room for one more entry: doubles the pool, up to the slot limit.
+// False when it is full and cannot grow.
+static bool
+HistoryGrow(History* history)
+{
+    size_t limit = HistorySlotLimit(history);
+    if (history->count < history->capacity) return true;
+    if (limit > 0 && history->capacity >= limit) return false;
+    if (history->capacity > UINT32_MAX / 2) return false; // Slots must fit the index's 32-bit values
+
+    size_t capacity = history->capacity * 2;
+    if (limit > 0 && capacity > limit) capacity = limit;
+    return HistoryResize(history, capacity);
+}
+
+// Halves the pool while a quarter of it or less is in use, so memory follows
+// the entries down after evictions (and a full pool does not shrink on the
+// next one). Shrinking is optional: it is skipped if memory runs out.
+static void
+HistoryShrink(History* history)
+{
+    size_t capacity = history->capacity;
+    while (capacity / 2 >= HISTORY_MIN_SLOTS && history->count <= capacity / 4) capacity /= 2;
+    size_t limit = HistorySlotLimit(history);
+    if (limit > 0 && capacity > limit) capacity = limit;
+    if (capacity < history->count) capacity = history->count;
+    if (capacity != history->capacity) HistoryResize(history, capacity ? capacity : 1);
+}
+
+// Evicts the oldest entries until the limits hold, keeping the newest one.
+// Returns how many went.
+static size_t
+HistoryEnforceLimits(History* history)
+{
+    size_t evicted = 0;
+    while (history->maxEntries > 0 && history->count > history->maxEntries && HistoryEvictOldest(history)) {
+        evicted++;
+    }
+    while (history->maxBytes > 0 && history->bytes > history->maxBytes && history->count > 1 &&
+           HistoryEvictOldest(history)) {
+        history->byteEvictions++;
+        evicted++;
+    }
+    if (evicted > 0) HistoryShrink(history);
+    return evicted;
+}
+
+size_t
+HistorySetLimits(History* history, size_t maxEntries, size_t maxBytes)
+{
+    history->maxEntries = maxEntries;
+    history->maxBytes = maxBytes;
+    size_t evicted = HistoryEnforceLimits(history);
+    HistoryShrink(history); // Also brings the pool within a lowered entry limit
+    return evicted;
+}
+
+// --- Compression ---
+
+static size_t
+HistoryPackedSize(const HistoryPacked* packed)
+{
+    return sizeof(HistoryPacked) + (packed->spillOffset == HISTORY_NOT_SPILLED ? packed->packedBytes : 0);
+}
+
+// Arena bytes of an entry's plain text, whichever form it is in
+static size_t
+HistoryPlainSize(const HistoryEntry* entry)
+{
+    return entry->utf8 ? (size_t)entry->utf8Bytes + 1 : (entry->length + 1) * sizeof(wchar_t);
+}
+
+size_t
+HistoryEntryBytes(const HistoryEntry* entry)
+{
+    size_t bytes = sizeof(HistoryEntry);
+    bytes += entry->packed ? HistoryPackedSize(entry->packed) : HistoryPlainSize(entry);
+    if (entry->preview) bytes += (entry->previewLength + 1) * sizeof(wchar_t);
+    return bytes;
+}
+
+// LZ-compresses UTF-8 text into a new malloc'd buffer. NULL if memory runs out.
+static char*
+HistoryCompressText(const char* utf8, size_t utf8Bytes, size_t* packedBytes)
+{
+    size_t bound = LzCompressBound(utf8Bytes);
+    char* stream = malloc(bound);
+    if (!stream) return NULL;
+    *packedBytes = LzCompress(utf8, utf8Bytes, stream, bound);
+    if (*packedBytes == 0 || *packedBytes > UINT32_MAX) {
+        free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+// Compresses UTF-8 text into a new arena block. NULL if that would not save
+// at least an eighth of 'plainBytes', what the text takes uncompressed, or
+// if memory runs out.
+static HistoryPacked*
+HistoryPack(History* history, const char* utf8, size_t utf8Bytes, size_t plainBytes)
+{
+    size_t packedBytes;
+    char* stream = HistoryCompressText(utf8, utf8Bytes, &packedBytes);
+    if (!stream) return NULL;
+
+    HistoryPacked* packed = NULL;
+    if (sizeof(HistoryPacked) + packedBytes <= plainBytes - plainBytes / 8) {
+        packed = ArenaAlloc(&history->arena, sizeof(HistoryPacked) + packedBytes);
+        if (packed) {
+            packed->packedBytes = (uint32_t)packedBytes;
+            packed->utf8Bytes = (uint32_t)utf8Bytes;
+            packed->spillOffset = HISTORY_NOT_SPILLED;
+            memcpy(packed + 1, stream, packedBytes);
+            history->packedEntries++;
+            history->packedRawBytes += utf8Bytes + 1;
+            history->packedBytes += HistoryPackedSize(packed);
+        }
+    }
+    free(stream);
+    return packed;
+}
+
+// UTF-8 size of text the store can encode, UTF8_INVALID if it cannot (values
+// outside Unicode, on platforms where wchar_t has room for them)
+static size_t
+HistoryUtf8Size(const wchar_t* text, size_t length)
+{
+    size_t utf8Bytes = Utf8EncodedSize(text, length);
+    return utf8Bytes < UINT32_MAX ? utf8Bytes : UTF8_INVALID;
+}
+
+// HistoryPack for wchar_t text of 'utf8Bytes' in UTF-8
+static HistoryPacked*
+HistoryPackWide(History* history, const wchar_t* text, size_t length, size_t utf8Bytes, size_t plainBytes)
+{
+    char* utf8 = malloc(utf8Bytes + 1);
+    if (!utf8) return NULL;
+    Utf8Encode(text, length, utf8);
+    HistoryPacked* packed = HistoryPack(history, utf8, utf8Bytes, plainBytes);
+    free(utf8);
+    return packed;
+}
+
+// UTF-8 encodes and compresses text into the spill file; only the header
+// stays in the arena. NULL if the text cannot be encoded, on memory or I/O errors.
+static HistoryPacked*
+HistorySpill(History* history, const wchar_t* text, size_t length)
+{
+    size_t utf8Bytes = HistoryUtf8Size(text, length);
+    if (utf8Bytes == UTF8_INVALID) return NULL;
+    char* utf8 = malloc(utf8Bytes + 1);
+    if (!utf8) return NULL;
+    Utf8Encode(text, length, utf8);
+    size_t packedBytes;
+    char* stream = HistoryCompressText(utf8, utf8Bytes, &packedBytes);
+    free(utf8);
+    if (!stream) return NULL;
+
+    HistoryPacked* packed = ArenaAlloc(&history->arena, sizeof(HistoryPacked));
+    if (packed && PlatformFileWrite(&history->spill, history->spillEnd, stream, packedBytes)) {
+        packed->packedBytes = (uint32_t)packedBytes;
+        packed->utf8Bytes = (uint32_t)utf8Bytes;
+        packed->spillOffset = history->spillEnd;
+        history->spillEnd += packedBytes;
+        history->spillLiveBytes += packedBytes;
+        history->spilledEntries++;
+    } else if (packed) {
+        ArenaRelease(&history->arena, packed, sizeof(HistoryPacked));
+        packed = NULL;
+    }
+    free(stream);
+    return packed;
+}
+
+static void
+HistoryReleasePacked(History* history, HistoryEntry* entry)
+{
+    HistoryPacked* packed = entry->packed;
+    if (packed->spillOffset == HISTORY_NOT_SPILLED) {
+        history->packedEntries--;
+        history->packedRawBytes -= (size_t)packed->utf8Bytes + 1;
+        history->packedBytes -= HistoryPackedSize(packed);
+    } else {
+        history->spilledEntries--;
+        history->spillLiveBytes -= packed->packedBytes;
+        if (history->spillLiveBytes == 0) { // Nothing referenced: start over from an empty file
+            PlatformFileTruncate(&history->spill, 0);
+            history->spillEnd = 0;
+        }
+    }
+    ArenaRelease(&history->arena, packed, HistoryPackedSize(packed));
+    entry->packed = NULL;
+}
+
+// Frees an entry's plain text, UTF-8 or wchar_t (unless borrowed)
+static void
+HistoryReleasePlain(History* history, HistoryEntry* entry)
+{
+    if (entry->utf8) {
+        ArenaRelease(&history->arena, (void*)entry->utf8, (size_t)entry->utf8Bytes + 1);
+    } else if (!entry->borrowed && entry->text) {
+        ArenaRelease(&history->arena, (void*)entry->text, (entry->length + 1) * sizeof(wchar_t));
+    }
+    entry->text = NULL;
+    entry->utf8 = NULL;
+}
+
+// Frees an entry's text, in whatever form it is stored, and its preview
+static void
+HistoryReleaseText(History* history, HistoryEntry* entry)
+{
+    if (entry->packed) {
+        HistoryReleasePacked(history, entry);
+    } else {
+        HistoryReleasePlain(history, entry);
+    }
+    if (entry->preview) {
+        ArenaRelease(&history->arena, (void*)entry->preview, (entry->previewLength + 1) * sizeof(wchar_t));
+    }
+    entry->preview = NULL;
+    entry->previewLength = 0;
+}
+
+// Gives an entry whose plain text is 'text' a preview, unless the text is
+// its own preview and will stay in plain form. False if memory runs out.
+static bool
+HistoryAttachPreview(History* history, HistoryEntry* entry, const wchar_t* text, bool plain)
+{
+    wchar_t preview[HISTORY_PREVIEW_CHARS + 1];
+    size_t length = HistoryMakePreview(text, entry->length, preview);
+    if (plain && length == entry->length && wmemcmp(preview, text, length) == 0) return true;
+
+    wchar_t* copy = ArenaAlloc(&history->arena, (length + 1) * sizeof(wchar_t));
+    if (!copy) return false;
+    memcpy(copy, preview, (length + 1) * sizeof(wchar_t));
+    entry->preview = copy;
+    entry->previewLength = (uint16_t)length;
+    return true;
+}
+
+// Compresses an entry that has become cold, if it is plain and big enough
+static void
+HistoryCompressCold(History* history, HistoryEntry* entry)
+{
+    size_t plainBytes = HistoryPlainSize(entry);
+    if (entry->packed || entry->borrowed || plainBytes < HISTORY_COLD_MIN_BYTES) return;
+
+    // Painting must not have to decompress it
+    if (!entry->preview) {
+        const wchar_t* text = HistoryEntryText(history, entry);
+        if (!text || !HistoryAttachPreview(history, entry, text, false)) return;
+    }
+
+    HistoryPacked* packed = NULL;
+    if (entry->utf8) {
+        packed = HistoryPack(history, entry->utf8, entry->utf8Bytes, plainBytes);
+    } else {
+        size_t utf8Bytes = HistoryUtf8Size(entry->text, entry->length);
+        if (utf8Bytes != UTF8_INVALID) {
+            packed = HistoryPackWide(history, entry->text, entry->length, utf8Bytes, plainBytes);
+        }
+    }
+    if (!packed) return;
+    history->bytes -= HistoryEntryBytes(entry);
+    HistoryReleasePlain(history, entry);
+    entry->packed = packed;
+    entry->utf8Bytes = packed->utf8Bytes;
+    entry->ascii = packed->utf8Bytes == entry->length;
+    history->bytes += HistoryEntryBytes(entry);
+}
+
+// Decompresses a packed entry into the decoder's UTF-8 scratch; false on
+// memory, I/O or format errors
+static bool
+HistoryDecompress(const History* history, const HistoryEntry* entry)
+{
+    HistoryDecoder* decoder = history->decoder;
+    const HistoryPacked* packed = entry->packed;
+    bool spilled = packed->spillOffset != HISTORY_NOT_SPILLED;
+    size_t scratchBytes = (size_t)packed->utf8Bytes + (spilled ? packed->packedBytes : 0);
+    uint64_t start = PlatformNowNs();
+
+    if (decoder->utf8Capacity < scratchBytes) {
+        char* grown = realloc(decoder->utf8, scratchBytes);
+        if (!grown) return false;
+        decoder->utf8 = grown;
+        decoder->utf8Capacity = scratchBytes;
+    }
+    const void* stream = packed + 1;
+    if (spilled) {
+        stream = decoder->utf8 + packed->utf8Bytes;
+        if (!PlatformFileRead(&history->spill, packed->spillOffset, decoder->utf8 + packed->utf8Bytes,
+                              packed->packedBytes)) {
+            return false;
+        }
+    }
+    if (!LzDecompress(stream, packed->packedBytes, decoder->utf8, packed->utf8Bytes)) return false;
+
+    uint64_t elapsed = PlatformNowNs() - start;
+    decoder->decodes++;
+    decoder->decodeNs += elapsed;
+    if (elapsed > decoder->decodeMaxNs) decoder->decodeMaxNs = elapsed;
+    return true;
+}
+
+// Converts an entry's UTF-8 text, plain or packed, into 'slot'; false on
+// memory, I/O or format errors
+static bool
+HistoryDecode(const History* history, const HistoryEntry* entry, HistoryTextSlot* slot)
+{
+    if (slot->capacity < entry->length + 1) {
+        wchar_t* grown = realloc(slot->text, (entry->length + 1) * sizeof(wchar_t));
+        if (!grown) return false;
+        slot->text = grown;
+        slot->capacity = entry->length + 1;
+    }
+
+    const char* utf8 = entry->utf8;
+    if (entry->packed) {
+        if (!HistoryDecompress(history, entry)) return false;
+        utf8 = history->decoder->utf8;
+    }
+    if (entry->ascii) {
+        for (size_t i = 0; i < entry->length; ++i) slot->text[i] = (wchar_t)(unsigned char)utf8[i];
+    } else if (Utf8Decode(utf8, entry->utf8Bytes, slot->text) != entry->length) {
+        return false;
+    }
+    slot->text[entry->length] = L'\0';
+    slot->seq = entry->seq;
+    return true;
+}
+
+// Frees least recently used slots (never 'keep') until the cache fits its budget
+static void
+HistoryTrimTextCache(HistoryDecoder* decoder, const HistoryTextSlot* keep)
+{
+    for (;;) {
+        size_t bytes = 0;
+        HistoryTextSlot* oldest = NULL;
+        for (size_t i = 0; i < HISTORY_TEXT_CACHE_SLOTS; ++i) {
+            HistoryTextSlot* slot = &decoder->slots[i];
+            if (!slot->text || slot == keep) continue;
+            bytes += slot->capacity * sizeof(wchar_t);
+            if (!oldest || slot->lastUse < oldest->lastUse) oldest = slot;
+        }
+        if (bytes <= HISTORY_TEXT_CACHE_BYTES || !oldest) return;
+        free(oldest->text);
+        memset(oldest, 0, sizeof(*oldest));
+    }
+}
+
+void
+HistorySetCompression(History* history, size_t minBytes, size_t age)
+{
+    history->compressMinBytes = minBytes;
+    history->compressAge = age;
+}
+
+void
+HistorySetSizeLimit(History* history, size_t maxChars, HistoryOversizePolicy policy)
+{
+    history->maxChars = maxChars;
+    history->oversize = policy;
+}
+
+bool
+HistoryOpenSpill(History* history, const char* path)
+{
+    if (history->spilledEntries > 0) return false;
+
+    PlatformFileClose(&history->spill);
+    history->spillEnd = 0;
+    history->spillLiveBytes = 0;
+    if (!PlatformFileOpen(&history->spill, path)) return false;
+    if (!PlatformFileTruncate(&history->spill, 0)) {
+        PlatformFileClose(&history->spill);
+        return false;
+    }
+    return true;
+}
+
+// --- Previews ---
+
+// Ends a preview that was cut short with an ellipsis, never after half a surrogate pair
+static size_t
+HistoryEndPreview(wchar_t* preview, size_t used)
+{
+    if (used == HISTORY_PREVIEW_CHARS) used--;
+    if (used > 0 && preview[used - 1] >= 0xD800 && preview[used - 1] <= 0xDBFF) used--;
+    preview[used++] = 0x2026;
+    return used;
+}
+
+size_t
+HistoryMakePreview(const wchar_t* text, size_t length, wchar_t* preview)
+{
+    size_t used = 0;
+    size_t spaces = 0;      // Whitespace seen since the last character written
+    bool lineBreak = false; // ... and whether it had a line break or tab in it
+
+    for (size_t i = 0; i < length; ++i) {
+        wchar_t c = text[i];
+        if (c == L' ') {
+            spaces++;
+            continue;
+        }
+        if (c >= L'\t' && c <= L'\r') {
+            spaces++;
+            lineBreak = true;
+            continue;
+        }
+        if (c < 0x20 || c == 0x7F) continue;
+
+        size_t gap = used == 0 ? 0 : lineBreak ? 1 : spaces; // Leading whitespace is dropped
+        if (used + gap + 1 > HISTORY_PREVIEW_CHARS) {
+            used = HistoryEndPreview(preview, used);
+            break;
+        }
+        for (size_t s = 0; s < gap; ++s) preview[used++] = L' ';
+        preview[used++] = c;
+        spaces = 0;
+        lineBreak = false;
+    }
+    preview[used] = L'\0';
+    return used;
+}
+
+const wchar_t*
+HistoryEntryPreview(const History* history, const HistoryEntry* entry, size_t* length)
+{
+    if (entry->preview) {
+        *length = entry->previewLength;
+        return entry->preview;
+    }
+    // Without a preview the plain text is one (compressed entries always have one)
+    *length = entry->length;
+    return HistoryEntryText(history, entry);
+}
+
+const wchar_t*
+HistoryEntryText(const History* history, const HistoryEntry* entry)
+{
+    if (entry->text) return entry->text;
+
+    HistoryDecoder* decoder = history->decoder;
+    HistoryTextSlot* victim = &decoder->slots[0];
+    for (size_t i = 0; i < HISTORY_TEXT_CACHE_SLOTS; ++i) {
+        HistoryTextSlot* slot = &decoder->slots[i];
+        if (slot->text && slot->seq == entry->seq) {
+            slot->lastUse = ++decoder->useClock;
+            return slot->text;
+        }
+        if (!slot->text) {
+            if (victim->text) victim = slot;
+        } else if (victim->text && slot->lastUse < victim->lastUse) {
+            victim = slot;
+        }
+    }
+
+    if (!HistoryDecode(history, entry, victim)) {
+        free(victim->text);
+        memset(victim, 0, sizeof(*victim));
+        return NULL;
+    }
+    victim->lastUse = ++decoder->useClock;
+    HistoryTrimTextCache(decoder, victim);
+    return victim->text;
+}
+
+void
+HistoryPrepareFilter(HistoryFilter* filter, const wchar_t* text, size_t length)
+{
+    filter->text = text;
+    filter->length = length;
+    filter->ascii = TextFoldsToAscii(text, length);
+}
+
+bool
+HistoryEntryContains(const History* history, const HistoryEntry* entry, const HistoryFilter* filter)
+{
+    if (filter->length == 0) return true;
+    if (entry->utf8 && filter->ascii) {
+        return TextFindNoCaseUtf8(entry->utf8, entry->utf8Bytes, filter->text, filter->length) != NULL;
+    }
+    if (entry->ascii && !filter->ascii) return false; // ASCII only folds to ASCII
+    const wchar_t* text = HistoryEntryText(history, entry);
+    return text && TextFindNoCase(text, entry->length, filter->text, filter->length) != NULL;
+}
+
+// Slot of an entry with the given folded hash and equal (case-insensitive)
+// text, HISTORY_NO_SLOT if there is none
+static uint32_t
+HistoryFindHashed(const History* history, const wchar_t* text, size_t length, uint32_t hash)
+{
+    HashIndexIter iter;
+    uint32_t slot;
+
+    HashIndexFind(&history->index, hash, &iter);
+    while (HashIndexNext(&iter, &slot)) {
+        const HistoryEntry* entry = &history->entries[slot];
+        if (entry->length != length) continue; // Folding never changes the length
+        const wchar_t* entryText = HistoryEntryText(history, entry);
+        if (entryText && TextEqualsNoCase(entryText, entry->length, text, length)) {
+            return slot;
+        }
+    }
+    return HISTORY_NO_SLOT;
+}
+
+// Stores an entry's text in the arena: compressed if it takes at least
+// 'compressMinBytes' plain and shrinks, otherwise as UTF-8, or as wchar_t
+// where that is smaller (CJK in UTF-16) or UTF-8 cannot hold it. False if
+// memory runs out.
+static bool
+HistoryStoreText(History* history, HistoryEntry* entry, const wchar_t* text, size_t length)
+{
+    size_t utf8Bytes = HistoryUtf8Size(text, length);
+    size_t wideBytes = (length + 1) * sizeof(wchar_t);
+    bool wide = utf8Bytes == UTF8_INVALID || utf8Bytes + 1 > wideBytes;
+    size_t plainBytes = wide ? wideBytes : utf8Bytes + 1;
+
+    if (utf8Bytes != UTF8_INVALID && history->compressMinBytes > 0 && plainBytes >= history->compressMinBytes) {
+        entry->packed = HistoryPackWide(history, text, length, utf8Bytes, plainBytes);
+        if (entry->packed) {
+            entry->utf8Bytes = (uint32_t)utf8Bytes;
+            entry->ascii = utf8Bytes == length;
+            return true;
+        }
+    }
+    if (wide) {
+        wchar_t* copy = ArenaAlloc(&history->arena, wideBytes);
+        if (!copy) return false;
+        memcpy(copy, text, length * sizeof(wchar_t));
+        copy[length] = L'\0';
+        entry->text = copy;
+        return true;
+    }
+
+    char* utf8 = ArenaAlloc(&history->arena, utf8Bytes + 1);
+    if (!utf8) return false;
+    Utf8Encode(text, length, utf8);
+    utf8[utf8Bytes] = '\0';
+    entry->utf8 = utf8;
+    entry->utf8Bytes = (uint32_t)utf8Bytes;
+    entry->ascii = utf8Bytes == length; // Anything else takes more than a byte per wchar_t
+    return true;
+}
+
+// Size of an entry's text in UTF-8, for the metadata (3 bytes a character
+// for text UTF-8 cannot hold)
+static uint32_t
+HistoryMetaBytes(const HistoryEntry* entry, const wchar_t* text)
+{
+    if (entry->utf8 || entry->packed) return entry->utf8Bytes;
+    size_t bytes = HistoryUtf8Size(text, entry->length);
+    if (bytes == UTF8_INVALID) bytes = entry->length * 3;
+    return bytes < UINT32_MAX ? (uint32_t)bytes : UINT32_MAX;
+}
+
+static void HistoryRemove(History* history, uint32_t slot);
+
+// Slot of a near-duplicate of the text 'print' was taken of, among the
+// entries the index's window covers; HISTORY_NO_SLOT if there is none
+static uint32_t
+HistoryFindNear(const History* history, const NearDupPrint* print)
+{
+    size_t window = history->nearDups->config.window;
+    uint32_t minSeq = window > 0 && history->nextSeq > window ? history->nextSeq - (uint32_t)window : 0;
+    uint32_t seq;
+    if (!NearDupFind(history->nearDups, print, minSeq, &seq)) return HISTORY_NO_SLOT;
+    const HistoryEntry* entry = HistoryFindSeq(history, seq);
+    return entry ? (uint32_t)(entry - history->entries) : HISTORY_NO_SLOT;
+}
+
+// Stores text as the newest entry, encoded (or compressed) into the arena
+// unless borrowed or already 'spilled'. 'text' need not be NUL-terminated at 'length'.
+static HistoryAddResult
+HistoryInsert(History* history, const wchar_t* text, size_t length, uint32_t hash, bool borrowed,
+              HistoryPacked* spilled)
+{
+    uint32_t duplicate = spilled ? HISTORY_NO_SLOT : HistoryFindHashed(history, text, length, hash);
+    if (duplicate != HISTORY_NO_SLOT) {
+        HistoryPromote(history, &history->entries[duplicate]);
+        return HISTORY_DUPLICATE;
+    }
+
+    // A near-duplicate is replaced rather than the oldest entry evicted: it
+    // keeps its place until the new entry is stored, then goes (see
+    // HistorySlotLimit), so running out of memory loses neither.
+    NearDupPrint print;
+    uint32_t uses = 1;
+    uint32_t nearSeq = 0;
+    bool replacing = false;
+    if (history->nearDups) {
+        NearDupFingerprint(text, length, &print);
+        uint32_t near = HistoryFindNear(history, &print);
+        if (near != HISTORY_NO_SLOT) {
+            uint32_t nearUses = history->entries[near].uses;
+            uses = nearUses < UINT32_MAX ? nearUses + 1 : nearUses;
+            nearSeq = history->entries[near].seq; // Slots move when the pool is resized
+            replacing = true;
+        }
+    }
+
+    // Evict first so the oldest entry's block is recycled for this one; the
+    // pool only grows when the entry limit allows it (or, out of memory, not at all)
+    if (history->maxEntries > 0 && history->count >= history->maxEntries) {
+        HistoryEnforceLimits(history); // A lowered limit may leave more than one too many
+        if (history->count >= history->maxEntries && !replacing) HistoryEvictOldest(history);
+    }
+    if (!HistoryGrow(history)) {
+        HistoryEvictOldest(history);
+    }
+
+    uint32_t slot = history->freeSlot;
+    HistoryEntry* entry = &history->entries[slot];
+    entry->text = borrowed ? text : NULL;
+    entry->utf8 = NULL;
+    entry->length = length;
+    entry->hash = hash;
+    entry->utf8Bytes = spilled ? spilled->utf8Bytes : 0;
+    entry->ascii = spilled && spilled->utf8Bytes == length;
+    entry->borrowed = borrowed;
+    entry->packed = spilled;
+    entry->preview = NULL;
+    entry->previewLength = 0;
+    if (!borrowed && !spilled && !HistoryStoreText(history, entry, text, length)) return HISTORY_NO_MEMORY;
+
+    if (!HistoryAttachPreview(history, entry, text, entry->packed == NULL) ||
+        !HashIndexInsert(&history->index, hash, slot)) {
+        HistoryReleaseText(history, entry);
+        return HISTORY_NO_MEMORY;
+    }
+    if (!HashIndexInsert(&history->seqs, HistorySeqHash(history->nextSeq), slot)) {
+        HashIndexRemove(&history->index, hash, slot);
+        HistoryReleaseText(history, entry);
+        return HISTORY_NO_MEMORY;
+    }
+    entry->seq = history->nextSeq++;
+    history->bytes += HistoryEntryBytes(entry);
+    history->meta.times[slot] = 0;
+    history->meta.sources[slot] = 0;
+    history->meta.bytes[slot] = HistoryMetaBytes(entry, text);
+    history->meta.classes[slot] = (uint8_t)MetaClassify(text, length);
+
+    // The index is only an accelerator: if it cannot keep up, drop it and scan
+    if (history->trigrams && !TrigramAdd(history->trigrams, entry->seq, text, length)) {
+        HistoryEnableTrigramIndex(history, false);
+    }
+    if (history->nearDups && !NearDupAdd(history->nearDups, entry->seq, &print)) {
+        HistoryEnableNearDuplicates(history, NULL);
+    }
+
+    history->freeSlot = entry->older;
+    HistoryLinkNewest(history, slot);
+    entry->uses = uses;
+    entry->reordered = false;
+    HistoryBucketPush(history, slot, HistoryBucketFor(history, uses));
+    history->count++;
+    history->generation++;
+
+    const HistoryEntry* near = replacing ? HistoryFindSeq(history, nearSeq) : NULL;
+    if (near) { // Unless the limits took it already
+        HistoryRemove(history, (uint32_t)(near - history->entries));
+        history->nearDuplicates++;
+    }
+
+    // Cold: 'compressAge' entries were added since. Re-copied ones are not.
+    if (history->compressAge > 0 && history->compressAge < history->nextSeq) {
+        HistoryEntry* cold = (HistoryEntry*)HistoryFindSeq(history, entry->seq - (uint32_t)history->compressAge);
+        if (cold && !cold->reordered) HistoryCompressCold(history, cold);
+    }
+    HistoryEnforceLimits(history); // The byte budget, now that the entry's size is known
+    return HISTORY_ADDED;
+}
+
+// Length of 'text' cut to 'maxChars', never between the halves of a surrogate pair
+static size_t
+HistoryTruncatedLength(const wchar_t* text, size_t maxChars)
+{
+    if (maxChars > 1 && text[maxChars - 1] >= 0xD800 && text[maxChars - 1] <= 0xDBFF) return maxChars - 1;
+    return maxChars;
+}
+
+HistoryAddResult
+HistoryAdd(History* history, const wchar_t* text)
+{
+    if (text == NULL || text[0] == L'\0') return HISTORY_EMPTY;
+
+    size_t length = wcslen(text);
+    if (history->maxChars == 0 || length <= history->maxChars) {
+        return HistoryInsert(history, text, length, TextHashNoCase(text, length), false, NULL);
+    }
+
+    // Oversized
+    if (history->oversize == HISTORY_OVERSIZE_SKIP) {
+        history->skippedEntries++;
+        return HISTORY_TOO_LARGE;
+    }
+    if (history->oversize == HISTORY_OVERSIZE_SPILL && PlatformFileIsOpen(&history->spill)) {
+        uint32_t hash = TextHashNoCase(text, length);
+        uint32_t duplicate = HistoryFindHashed(history, text, length, hash);
+        if (duplicate != HISTORY_NO_SLOT) {
+            HistoryPromote(history, &history->entries[duplicate]);
+            return HISTORY_DUPLICATE;
+        }
+        HistoryPacked* spilled = HistorySpill(history, text, length);
+        if (spilled) return HistoryInsert(history, text, length, hash, false, spilled); // Releases it on failure
+        // Spill file unusable: keep what fits
+    }
+
+    length = HistoryTruncatedLength(text, history->maxChars);
+    HistoryAddResult result = HistoryInsert(history, text, length, TextHashNoCase(text, length), false, NULL);
+    if (result == HISTORY_ADDED) history->truncatedEntries++;
+    return result;
+}
+
+HistoryAddResult
+HistoryAddBorrowed(History* history, const wchar_t* text, size_t length, uint32_t hash)
+{
+    if (text == NULL || length == 0) return HISTORY_EMPTY;
+    return HistoryInsert(history, text, length, hash, true, NULL);
+}
+
+bool
+HistoryContains(const History* history, const wchar_t* text)
+{
+    if (!text) return false;
+    size_t length = wcslen(text);
+    return HistoryFindHashed(history, text, length, TextHashNoCase(text, length)) != HISTORY_NO_SLOT;
+}
+
+size_t
+HistoryCount(const History* history)
+{
+    return history->count;
+}
+
+// --- Metadata ---
+
+void
+HistoryGetMeta(const History* history, const HistoryEntry* entry, HistoryMeta* meta)
+{
+    size_t slot = (size_t)(entry - history->entries);
+    meta->time = history->meta.times[slot];
+    meta->source = MetaSourceName(&history->sources, history->meta.sources[slot]);
+    meta->bytes = history->meta.bytes[slot];
+    meta->metaClass = (MetaClass)history->meta.classes[slot];
+}
+
+void
+HistorySetOrigin(History* history, const HistoryEntry* entry, int64_t time, const wchar_t* source)
+{
+    size_t slot = (size_t)(entry - history->entries);
+    history->meta.times[slot] = time < 0 ? 0 : time > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)time;
+    if (source && source[0] != L'\0') history->meta.sources[slot] = MetaSourcesIntern(&history->sources, source);
+    history->generation++; // Filtered searches see it
+}
+
+void
+HistorySetClass(History* history, const HistoryEntry* entry, MetaClass metaClass)
+{
+    history->meta.classes[entry - history->entries] = (uint8_t)metaClass;
+    history->generation++;
+}
+
+// --- Order ---
+
+void
+HistoryPromote(History* history, const HistoryEntry* promoted)
+{
+    uint32_t slot = (uint32_t)(promoted - history->entries);
+    HistoryEntry* entry = &history->entries[slot];
+    if (history->newest != slot) {
+        HistoryUnlink(history, slot);
+        HistoryLinkNewest(history, slot);
+        if (!entry->reordered) {
+            entry->reordered = true;
+            history->reordered++;
+        }
+    }
+
+    // Up one bucket, as its most recent entry
+    uint32_t from = entry->bucket;
+    uint32_t to = from;
+    HistoryBucketUnlink(history, slot);
+    if (entry->uses < UINT32_MAX) {
+        entry->uses++;
+        uint32_t more = history->buckets[from].more;
+        if (more != HISTORY_NO_SLOT && history->buckets[more].uses == entry->uses) {
+            to = more;
+        } else if (history->buckets[from].newest != HISTORY_NO_SLOT) {
+            to = HistoryNewBucket(history, entry->uses, more, from);
+        } else {
+            history->buckets[from].uses = entry->uses; // It was alone in there
+        }
+        if (to != from && history->buckets[from].newest == HISTORY_NO_SLOT) HistoryDropBucket(history, from);
+    }
+    HistoryBucketPush(history, slot, to);
+
+    history->promotions++;
+    history->generation++;
+}
+
+const HistoryEntry*
+HistoryFirst(const History* history, HistoryOrder order)
+{
+    if (order == HISTORY_ORDER_FREQUENT) {
+        if (history->mostUsed == HISTORY_NO_SLOT) return NULL;
+        return &history->entries[history->buckets[history->mostUsed].newest];
+    }
+    return history->newest != HISTORY_NO_SLOT ? &history->entries[history->newest] : NULL;
+}
+
+const HistoryEntry*
+HistoryNext(const History* history, const HistoryEntry* entry, HistoryOrder order)
+{
+    uint32_t slot = entry->older;
+    if (order == HISTORY_ORDER_FREQUENT) {
+        slot = entry->bucketOlder;
+        uint32_t fewer = history->buckets[entry->bucket].fewer;
+        if (slot == HISTORY_NO_SLOT && fewer != HISTORY_NO_SLOT) slot = history->buckets[fewer].newest;
+    }
+    return slot != HISTORY_NO_SLOT ? &history->entries[slot] : NULL;
+}
+
+// The last entry in 'order', and the one before 'entry'
+static const HistoryEntry*
+HistoryLast(const History* history, HistoryOrder order)
+{
+    uint32_t slot = history->oldest;
+    if (order == HISTORY_ORDER_FREQUENT) {
+        slot = history->leastUsed != HISTORY_NO_SLOT ? history->buckets[history->leastUsed].oldest : HISTORY_NO_SLOT;
+    }
+    return slot != HISTORY_NO_SLOT ? &history->entries[slot] : NULL;
+}
+
+static const HistoryEntry*
+HistoryPrevious(const History* history, const HistoryEntry* entry, HistoryOrder order)
+{
+    uint32_t slot = entry->newer;
+    if (order == HISTORY_ORDER_FREQUENT) {
+        slot = entry->bucketNewer;
+        uint32_t more = history->buckets[entry->bucket].more;
+        if (slot == HISTORY_NO_SLOT && more != HISTORY_NO_SLOT) slot = history->buckets[more].oldest;
+    }
+    return slot != HISTORY_NO_SLOT ? &history->entries[slot] : NULL;
+}
+
+const HistoryEntry*
+HistoryGetInOrder(const History* history, HistoryOrder order, size_t index)
+{
+    if (index >= history->count) return NULL;
+
+    HistoryCursor* cursor = history->cursor;
+    if (cursor->generation != history->generation) {
+        HistoryForgetCursor(cursor);
+        cursor->generation = history->generation;
+    }
+    size_t at = 0;
+    const HistoryEntry* entry = HistoryFirst(history, order);
+    if (history->count - 1 - index < index) {
+        at = history->count - 1;
+        entry = HistoryLast(history, order);
+    }
+    if (cursor->slot[order] != HISTORY_NO_SLOT) {
+        size_t fromCursor = cursor->index[order] > index ? cursor->index[order] - index : index - cursor->index[order];
+        if (fromCursor < (at > index ? at - index : index - at)) {
+            at = cursor->index[order];
+            entry = &history->entries[cursor->slot[order]];
+        }
+    }
+    for (; at < index; ++at) entry = HistoryNext(history, entry, order);
+    for (; at > index; --at) entry = HistoryPrevious(history, entry, order);
+
+    cursor->index[order] = index;
+    cursor->slot[order] = (uint32_t)(entry - history->entries);
+    return entry;
+}
+
+bool
+HistorySeqOrdered(const History* history)
+{
+    if (history->reordered > 0) return false;
+    return history->seqGapEnd == 0 || history->count == 0 ||
+           history->entries[history->oldest].seq >= history->seqGapEnd;
+}
+
+const HistoryEntry*
+HistoryGet(const History* history, size_t index)
+{
+    if (index >= history->count) return NULL;
+    // In insertion order the entry is known by its sequence number
+    if (HistorySeqOrdered(history)) return HistoryFindSeq(history, history->nextSeq - 1 - (uint32_t)index);
+    return HistoryGetInOrder(history, HISTORY_ORDER_RECENT, index);
+}
+
+size_t
+HistoryRecencyIndex(const History* history, const HistoryEntry* entry)
+{
+    if (HistorySeqOrdered(history)) return history->nextSeq - 1 - entry->seq;
+    return HistoryCountStamps(history, (size_t)entry->stamp + 1, history->nextStamp);
+}
+
+const HistoryEntry*
+HistoryFindSeq(const History* history, uint32_t seq)
+{
+    HashIndexIter iter;
+    uint32_t slot;
+
+    HashIndexFind(&history->seqs, HistorySeqHash(seq), &iter);
+    return HashIndexNext(&iter, &slot) ? &history->entries[slot] : NULL;
+}
+
+static int
+HistoryCompareSeqs(const void* a, const void* b)
+{
+    uint32_t x = (*(const HistoryEntry* const*)a)->seq, y = (*(const HistoryEntry* const*)b)->seq;
+    return (x > y) - (x < y);
+}
+
+bool
+HistoryEnableTrigramIndex(History* history, bool enable)
+{
+    if (!enable) {
+        if (history->trigrams) {
+            TrigramFree(history->trigrams);
+            free(history->trigrams);
+            history->trigrams = NULL;
+        }
+        return true;
+    }
+    if (history->trigrams) return true;
+
+    // Posting lists must stay in ascending sequence order: oldest first,
+    // which re-copies may have moved out of order
+    const HistoryEntry** entries = malloc((history->count ? history->count : 1) * sizeof(HistoryEntry*));
+    TrigramIndex* trigrams = malloc(sizeof(TrigramIndex));
+    if (!entries || !trigrams || !TrigramInit(trigrams)) {
+        free(entries);
+        free(trigrams);
+        return false;
+    }
+    size_t count = 0;
+    for (uint32_t slot = history->oldest; slot != HISTORY_NO_SLOT; slot = history->entries[slot].newer) {
+        entries[count++] = &history->entries[slot];
+    }
+    if (history->reordered > 0) qsort(entries, count, sizeof(HistoryEntry*), HistoryCompareSeqs);
+
+    for (size_t i = 0; i < count; ++i) {
+        const wchar_t* text = HistoryEntryText(history, entries[i]);
+        if (!text || !TrigramAdd(trigrams, entries[i]->seq, text, entries[i]->length)) {
+            TrigramFree(trigrams);
+            free(trigrams);
+            free(entries);
+            return false;
+        }
+    }
+    free(entries);
+    history->trigrams = trigrams;
+    return true;
+}
+
+bool
+HistoryEnableNearDuplicates(History* history, const NearDupConfig* config)
+{
+    if (history->nearDups) {
+        NearDupFree(history->nearDups);
+        free(history->nearDups);
+        history->nearDups = NULL;
+    }
+    if (!config) return true;
+
+    NearDupIndex* nearDups = malloc(sizeof(NearDupIndex));
+    if (!nearDups || !NearDupInit(nearDups, config)) {
+        free(nearDups);
+        return false;
+    }
+    for (uint32_t slot = history->oldest; slot != HISTORY_NO_SLOT; slot = history->entries[slot].newer) {
+        const HistoryEntry* entry = &history->entries[slot];
+        const wchar_t* text = HistoryEntryText(history, entry);
+        NearDupPrint print;
+        if (text) NearDupFingerprint(text, entry->length, &print);
+        if (!text || !NearDupAdd(nearDups, entry->seq, &print)) {
+            NearDupFree(nearDups);
+            free(nearDups);
+            return false;
+        }
+    }
+    history->nearDups = nearDups;
+    return true;
+}
+
+// Takes an entry out of the store and every index, freeing its slot
+static void
+HistoryRemove(History* history, uint32_t slot)
+{
+    HistoryEntry* entry = &history->entries[slot];
+    if (slot != history->oldest || history->reordered > 0) {
+        // Maybe not the lowest sequence number: the ones left may skip it
+        if (entry->seq >= history->seqGapEnd) history->seqGapEnd = entry->seq + 1;
+    }
+    HashIndexRemove(&history->index, entry->hash, slot);
+    HashIndexRemove(&history->seqs, HistorySeqHash(entry->seq), slot);
+    if (history->trigrams) {
+        const wchar_t* text = HistoryEntryText(history, entry);
+        if (text) {
+            TrigramRemove(history->trigrams, entry->seq, text, entry->length);
+        } else {
+            HistoryEnableTrigramIndex(history, false); // Cannot unindex it, so stop indexing
+        }
+    }
+    if (history->nearDups) NearDupRemove(history->nearDups, entry->seq);
+    history->bytes -= HistoryEntryBytes(entry);
+    HistoryReleaseText(history, entry);
+    entry->length = 0;
+    entry->borrowed = false;
+
+    HistoryUnlink(history, slot);
+    HistoryBucketUnlink(history, slot);
+    if (history->buckets[entry->bucket].newest == HISTORY_NO_SLOT) HistoryDropBucket(history, entry->bucket);
+    if (entry->reordered) history->reordered--;
+    entry->reordered = false;
+    entry->older = history->freeSlot;
+    history->freeSlot = slot;
+
+    history->count--;
+    history->generation++;
+}
+
+bool
+HistoryEvictOldest(History* history)
+{
+    if (history->count == 0) return false;
+    HistoryRemove(history, history->oldest);
+    history->evictions++;
+    return true;
+}
+
+void
+HistoryGetStats(const History* history, HistoryStats* stats)
+{
+    stats->entries = history->count;
+    stats->evictions = history->evictions;
+    stats->byteEvictions = history->byteEvictions;
+    stats->promotions = history->promotions;
+    stats->maxEntries = history->maxEntries;
+    stats->maxBytes = history->maxBytes;
+    stats->entryBytes = history->bytes;
+    stats->slotBytes = history->capacity * sizeof(HistoryEntry);
+    stats->textBytes = history->arena.bytesUsed;
+    stats->reservedBytes = history->arena.bytesReserved;
+    stats->indexBytes = HashIndexMemory(&history->index) + HashIndexMemory(&history->seqs) +
+                        (history->capacity + 1) * sizeof(HistoryUseBucket) +
+                        history->stampWindow / 8 + history->stampWindow / HISTORY_STAMP_BLOCK * sizeof(uint32_t);
+    stats->recycledAllocs = history->arena.recycled;
+    stats->trigramBytes = history->trigrams ? TrigramMemory(history->trigrams) : 0;
+    stats->trigramPostings = history->trigrams ? history->trigrams->postings : 0;
+    stats->nearDupBytes = history->nearDups ? NearDupMemory(history->nearDups) : 0;
+    stats->nearDuplicates = history->nearDuplicates;
+    stats->metaBytes = MetaColumnsMemory(&history->meta) + MetaSourcesMemory(&history->sources);
+    stats->packedEntries = history->packedEntries;
+    stats->packedRawBytes = history->packedRawBytes;
+    stats->packedBytes = history->packedBytes;
+    stats->decodes = history->decoder->decodes;
+    stats->decodeNs = history->decoder->decodeNs;
+    stats->decodeMaxNs = history->decoder->decodeMaxNs;
+    stats->truncatedEntries = history->truncatedEntries;
+    stats->skippedEntries = history->skippedEntries;
+    stats->spilledEntries = history->spilledEntries;
+    stats->spilledBytes = history->spillLiveBytes;
+}
+
+size_t
+HistoryForEachMatch(const History* history, const wchar_t* filter,
+                    HistoryVisitFn visit, void* context)
+{
+    return HistoryScan(history, filter, filter ? wcslen(filter) : 0, visit, context, NULL);
+}
+
+// Polls the cancel flag every HISTORY_SCAN_POLL entries
+static bool
+HistoryScanCancelled(HistoryScanControl* control, size_t step)
+{
+    if (!control || !control->cancel || step % HISTORY_SCAN_POLL != 0) return false;
+    if (!PlatformAtomicLoad(control->cancel)) return false;
+    control->cancelled = true;
+    return true;
+}
+
+// Whether the entry is in the slots the scan is limited to
+static inline bool
+HistoryScanPasses(const History* history, const HistoryEntry* entry, const HistoryScanControl* control)
+{
+    return !control || !control->slots || MetaSlotPasses(control->slots, (size_t)(entry - history->entries));
+}
+
+static int
+HistoryCompareStamps(const void* a, const void* b)
+{
+    uint32_t x = (*(const HistoryEntry* const*)a)->stamp, y = (*(const HistoryEntry* const*)b)->stamp;
+    return (x < y) - (x > y); // Newest first
+}
+
+// Verifies trigram candidates (ascending sequence numbers), newest first.
+// False if they are out of recency order and memory to sort them runs out.
+static bool
+HistoryScanCandidates(const History* history, const HistoryFilter* filter,
+                      const uint32_t* seqs, size_t seqCount,
+                      HistoryVisitFn visit, void* context, HistoryScanControl* control, size_t* visited)
+{
+    const HistoryEntry** entries = NULL;
+    if (!HistorySeqOrdered(history) && seqCount > 0) {
+        entries = malloc(seqCount * sizeof(HistoryEntry*));
+        if (!entries) return false;
+        for (size_t i = 0; i < seqCount; ++i) entries[i] = HistoryFindSeq(history, seqs[i]);
+        qsort(entries, seqCount, sizeof(HistoryEntry*), HistoryCompareStamps);
+    }
+
+    size_t index = 0;
+    for (size_t i = 0; i < seqCount; ++i) {
+        if (HistoryScanCancelled(control, i)) break;
+        const HistoryEntry* entry;
+        if (entries) {
+            // Counted from the previous candidate: it, and the entries used in between
+            uint32_t newer = i > 0 ? entries[i - 1]->stamp : history->nextStamp;
+            entry = entries[i];
+            index = (i > 0 ? index + 1 : 0) + HistoryCountStamps(history, (size_t)entry->stamp + 1, newer);
+        } else {
+            uint32_t seq = seqs[seqCount - 1 - i];
+            entry = HistoryFindSeq(history, seq);
+            index = history->nextSeq - 1 - seq;
+        }
+        if (!HistoryScanPasses(history, entry, control)) continue;
+        if (filter->length > 0) {
+            if (control) control->tested++;
+            if (!HistoryEntryContains(history, entry, filter)) continue;
+        }
+        (*visited)++;
+        if (!visit(entry, index, context)) break;
+    }
+    free(entries);
+    return true;
+}
+
+static int
+HistoryCompareSeqValues(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Sequence numbers (ascending) of the entries whose slot bit is set, at most
+// 'limit' of them. NULL if memory runs out.
+static uint32_t*
+HistorySlotSeqs(const History* history, const uint64_t* slots, size_t limit, size_t* count)
+{
+    uint32_t* seqs = malloc((limit > 0 ? limit : 1) * sizeof(uint32_t));
+    if (!seqs) return NULL;
+    *count = 0;
+    size_t words = (history->capacity + 63) / 64;
+    for (size_t word = 0; word < words && *count < limit; ++word) {
+        for (uint64_t bits = slots[word]; bits && *count < limit; bits &= bits - 1) {
+            size_t slot = word * 64 + HistoryPopCount((bits & (~bits + 1)) - 1);
+            if (slot >= history->capacity) break;
+            const HistoryEntry* entry = &history->entries[slot];
+            if (HistoryFindSeq(history, entry->seq) == entry) seqs[(*count)++] = entry->seq; // Not a free slot
+        }
+    }
+    qsort(seqs, *count, sizeof(uint32_t), HistoryCompareSeqValues);
+    return seqs;
+}
+
+size_t
+HistoryScan(const History* history, const wchar_t* filter, size_t filterLength,
+            HistoryVisitFn visit, void* context, HistoryScanControl* control)
+{
+    size_t visited = 0;
+    HistoryFilter prepared;
+    HistoryPrepareFilter(&prepared, filter, filterLength);
+    if (history->trigrams && filterLength >= TRIGRAM_MIN_QUERY) {
+        uint32_t* seqs;
+        size_t seqCount;
+        if (TrigramQuery(history->trigrams, filter, filterLength, &seqs, &seqCount)) {
+            bool scanned = HistoryScanCandidates(history, &prepared, seqs, seqCount,
+                                                 visit, context, control, &visited);
+            free(seqs);
+            if (scanned) return visited;
+        }
+        // Out of memory: fall back to a full scan
+    }
+    if (control && control->slots && control->slotsSet <= history->count / HISTORY_SCAN_SPARSE) {
+        // Few entries pass the slots: visit just those, not the whole recency list
+        size_t seqCount;
+        uint32_t* seqs = HistorySlotSeqs(history, control->slots, control->slotsSet, &seqCount);
+        if (seqs) {
+            bool scanned = HistoryScanCandidates(history, &prepared, seqs, seqCount,
+                                                 visit, context, control, &visited);
+            free(seqs);
+            if (scanned) return visited;
+        }
+    }
+
+    size_t i = 0;
+    for (const HistoryEntry* entry = HistoryFirst(history, HISTORY_ORDER_RECENT); entry;
+         entry = HistoryNext(history, entry, HISTORY_ORDER_RECENT), ++i) {
+        if (HistoryScanCancelled(control, i)) break;
+        if (!HistoryScanPasses(history, entry, control)) continue;
+        if (filterLength > 0) {
+            if (control) control->tested++;
+            if (!HistoryEntryContains(history, entry, &prepared)) continue;
+        }
+        visited++;
+        if (!visit(entry, i, context)) break;
+    }
+    return visited;
+}
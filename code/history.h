@@ -0,0 +1,350 @@
+#ifndef MCLIP_HISTORY_H
+#define MCLIP_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include "arena.h"
+#include "hashindex.h"
+#include "meta.h"
+#include "neardup.h"
+#include "platform.h"
+#include "trigram.h"
+
+// --- History Engine ---
+// Platform-neutral clipboard history store. Contains no Win32 calls so it can
+// be unit-tested and benchmarked headlessly (see Makefile). mclip.c is a thin
+// UI shell over this API.
+
+typedef enum {
+    HISTORY_ADDED = 0,   // New entry stored as most recent
+    HISTORY_DUPLICATE,   // Already present (case-insensitive): that entry became the most recent, nothing stored
+    HISTORY_EMPTY,       // NULL or empty text, ignored
+    HISTORY_NO_MEMORY,   // Allocation failed, entry not stored
+    HISTORY_TOO_LARGE    // Over the size limit with HISTORY_OVERSIZE_SKIP, nothing stored
+} HistoryAddResult;
+
+// What happens to text longer than the size limit (HistorySetSizeLimit)
+typedef enum {
+    HISTORY_OVERSIZE_TRUNCATE = 0, // Only the first 'maxChars' characters are kept
+    HISTORY_OVERSIZE_SPILL,        // Kept whole, compressed in the spill file; truncated if there is none
+    HISTORY_OVERSIZE_SKIP          // Not stored at all
+} HistoryOversizePolicy;
+
+#define HISTORY_COLD_MIN_BYTES 256              // Cold entries smaller than this stay uncompressed
+#define HISTORY_TEXT_CACHE_SLOTS 16             // Converted texts kept by HistoryEntryText
+#define HISTORY_TEXT_CACHE_BYTES (8 * 1024 * 1024) // ... and the memory they may hold beyond the newest
+#define HISTORY_PREVIEW_CHARS 256               // Longest display preview (see HistoryEntryPreview)
+#define HISTORY_MIN_SLOTS 16                    // Smallest entry pool; it doubles as entries come and halves as they go
+#define HISTORY_STAMP_BLOCK 4096                // Recency stamps per counted block (HistoryRecencyIndex)
+
+#define HISTORY_NO_SLOT UINT32_MAX
+
+typedef struct HistoryPacked HistoryPacked;
+typedef struct HistoryDecoder HistoryDecoder;
+typedef struct HistoryCursor HistoryCursor;
+
+// Orders entries can be walked in (HistoryFirst / HistoryNext)
+typedef enum {
+    HISTORY_ORDER_RECENT = 0, // Most recently copied first
+    HISTORY_ORDER_FREQUENT    // Most often copied first, most recent first among equals
+} HistoryOrder;
+
+// Entries copied the same number of times, most recently used first. Buckets
+// are chained from the most used to the least, so a re-copy moves an entry
+// to the next bucket up in O(1) and the frequent order is walked, never sorted.
+typedef struct {
+    uint32_t uses;
+    uint32_t newest;     // Entries (slots)
+    uint32_t oldest;
+    uint32_t more;       // Neighbouring buckets, HISTORY_NO_SLOT past either end
+    uint32_t fewer;
+} HistoryUseBucket;
+
+typedef struct {
+    const wchar_t* text; // NUL-terminated wchar_t text when kept as such: borrowed, smaller than in UTF-8 (CJK in
+                         // UTF-16) or not Unicode; NULL otherwise. HistoryEntryText gives any entry's text.
+    const char* utf8;    // NUL-terminated UTF-8 (WTF-8) text in the store's arena, the usual form; NULL when
+                         // compressed or kept as 'text'
+    size_t length;       // Length of the text in wchar_t units, whatever its form
+    uint32_t hash;       // TextHashNoCase(text), key in the duplicate index
+    uint32_t seq;        // Insertion sequence number, stable for the entry's lifetime
+    uint32_t utf8Bytes;  // Size of the UTF-8 text (plain or compressed), 0 if kept as 'text'
+    bool ascii;          // UTF-8 text that is all ASCII: one byte per character
+    bool borrowed;       // Text is owned by the caller (e.g. a mapped log), not the arena
+    HistoryPacked* packed; // Compressed text (UTF-8, then LZ) in the arena or spill file, NULL if stored plain
+    const wchar_t* preview; // Single-line display text in the arena, NULL when 'text' is already one
+    uint16_t previewLength;
+    bool reordered;      // Promoted past newer entries: recency no longer follows 'seq'
+    uint32_t uses;       // Times copied: 1, plus one per re-copy
+    uint32_t newer;      // Recency list neighbours (slots), HISTORY_NO_SLOT past either end
+    uint32_t older;
+    uint32_t bucket;     // Use bucket it is in, and its neighbours there (see HistoryOrder)
+    uint32_t bucketNewer;
+    uint32_t bucketOlder;
+    uint32_t stamp;      // Recency stamp, increasing towards the newest (see HistoryRecencyIndex)
+} HistoryEntry;
+
+typedef struct {
+    HistoryEntry* entries; // Pool of 'capacity' slots, resized to fit 'count' (HistoryResize)
+    size_t capacity;
+    uint32_t newest;       // Recency list of the entries: ends (slots), HISTORY_NO_SLOT when empty;
+    uint32_t oldest;       // ... the oldest is evicted first
+    uint32_t freeSlot;     // Unused slots, chained through 'older'
+    size_t count;          // Number of valid items
+    size_t evictions;      // Total items dropped to make room ...
+    size_t byteEvictions;  // ... of which to stay within 'maxBytes'
+    size_t promotions;     // Re-copies that moved an entry to the front
+    size_t reordered;      // Entries with 'reordered' set: while 0, recency follows 'seq' ...
+    uint32_t seqGapEnd;    // ... and while every entry is newer than this, no 'seq' is missing: one past
+                           // the newest entry removed other than as the oldest (HistorySeqOrdered), 0 = none
+    size_t maxEntries;     // Limits (HistorySetLimits), 0 = none
+    size_t maxBytes;
+    size_t bytes;          // Sum of HistoryEntryBytes over the stored entries
+    uint64_t generation;   // Bumped on every insert/evict/promotion; recency indices are stable while unchanged
+    uint32_t nextSeq;      // Sequence number of the next insert
+    HashIndex seqs;        // Sequence number -> slot, for HistoryFindSeq
+    HistoryUseBucket* buckets; // Pool of 'capacity' + 1 use buckets, unused ones chained through 'more'
+    uint32_t mostUsed;     // Bucket chain ends
+    uint32_t leastUsed;
+    uint32_t freeBucket;
+    uint64_t* stamps;      // Bit per live recency stamp below 'nextStamp' ...
+    uint32_t* stampBlocks; // ... and their count per HISTORY_STAMP_BLOCK stamps
+    size_t stampWindow;    // Stamps the bitmap has room for; they are renumbered when used up
+    uint32_t nextStamp;
+    HistoryCursor* cursor; // Last HistoryGetInOrder position per order; updated even through a const History*
+    HashIndex index;       // Case-folded content hash -> slot, for duplicate checks
+    Arena arena;           // Backing memory for entry text
+    TrigramIndex* trigrams; // Optional substring index, NULL when disabled
+    NearDupIndex* nearDups; // Optional near-duplicate index (HistoryEnableNearDuplicates), NULL when disabled
+    size_t nearDuplicates;  // Entries replaced by a near-duplicate copy of theirs
+    MetaColumns meta;       // Time, source, size and class of the entries, by slot (see meta.h)
+    MetaSources sources;    // Names of the processes entries were copied from
+
+    size_t compressMinBytes; // Entries of at least this size are compressed on insert (0 = never)
+    size_t compressAge;      // Entries are compressed once this many were added after them (0 = never)
+    size_t packedEntries;    // Entries currently stored compressed ...
+    size_t packedRawBytes;   // ... their uncompressed size (UTF-8 text)
+    size_t packedBytes;      // ... and what they take compressed
+    HistoryDecoder* decoder; // Decompression cache and timing; updated even through a const History*
+
+    size_t maxChars;                 // Size limit of new entries (0 = none) ...
+    HistoryOversizePolicy oversize;  // ... and what happens above it
+    size_t truncatedEntries;         // Entries cut to the limit so far
+    size_t skippedEntries;           // Texts refused for being over the limit
+    PlatformFile spill;              // Out-of-line storage of oversized entries (HistoryOpenSpill)
+    uint64_t spillEnd;               // Bytes written to the spill file ...
+    uint64_t spillLiveBytes;         // ... and those still referenced; it is emptied when none are
+    size_t spilledEntries;
+} History;
+
+typedef struct {
+    size_t entries;
+    size_t evictions;
+    size_t byteEvictions;  // Evictions that kept the history within its byte budget
+    size_t promotions;     // Re-copies moved to the front
+    size_t maxEntries;     // Limits, 0 = none
+    size_t maxBytes;
+    size_t entryBytes;     // What the entries cost, the sum of HistoryEntryBytes
+    size_t slotBytes;      // Entry pool, allocated slots included
+    size_t textBytes;      // Bytes of entry text currently stored
+    size_t reservedBytes;  // Heap memory held for entry text (arena chunks + large blocks)
+    size_t indexBytes;     // Duplicate and sequence hash indexes, use buckets and recency stamps
+    size_t recycledAllocs; // Inserts that reused memory of an evicted entry
+    size_t trigramBytes;   // Trigram index overhead (0 when disabled)
+    size_t trigramPostings;
+    size_t nearDupBytes;   // Near-duplicate index (0 when disabled) ...
+    size_t nearDuplicates; // ... and the entries it replaced by newer copies
+    size_t metaBytes;      // Metadata columns and source names
+    size_t packedEntries;  // Compressed entries, their raw and compressed size
+    size_t packedRawBytes;
+    size_t packedBytes;
+    uint64_t decodes;      // Decompressions (cache misses of HistoryEntryText on compressed entries)
+    uint64_t decodeNs;     // Total and worst time spent in them
+    uint64_t decodeMaxNs;
+    size_t truncatedEntries; // Entries cut to the size limit
+    size_t skippedEntries;   // Texts refused for being over it
+    size_t spilledEntries;   // Entries in the spill file, and the bytes they take there
+    uint64_t spilledBytes;
+} HistoryStats;
+
+// Called for every matching entry, newest first. 'index' is the recency index
+// (0 = newest). Return false to stop the iteration early.
+typedef bool (*HistoryVisitFn)(const HistoryEntry* entry, size_t index, void* context);
+
+// A history of at most 'maxEntries' entries (not 0) and no byte budget; see
+// HistorySetLimits. Memory is taken as entries come, not up front.
+bool HistoryInit(History* history, size_t maxEntries);
+void HistoryFree(History* history);
+
+// Limits the history to 'maxEntries' entries and 'maxBytes' of
+// HistoryEntryBytes in total (0 = no limit), evicting the oldest entries
+// until both hold, now and after every insert. The newest entry is kept even
+// if it alone is over the budget: HistorySetSizeLimit bounds single entries.
+// Returns the number of entries evicted (captures of theirs are the caller's to prune).
+size_t HistorySetLimits(History* history, size_t maxEntries, size_t maxBytes);
+
+// What an entry costs the store: its slot, its text as stored (UTF-8,
+// compressed, the header of a spilled one, or the mapped text of a borrowed
+// one) and its preview. This is what HistorySetLimits budgets.
+size_t HistoryEntryBytes(const HistoryEntry* entry);
+
+// Inserts text as the most recent entry, evicting the oldest ones when over a
+// limit. Text already present is not stored again: its entry is promoted to
+// the most recent one and counts one more use (HistoryPromote). With the
+// near-duplicate index, a near-duplicate of the text is replaced by it: that
+// entry goes, and the new one counts its uses plus one.
+HistoryAddResult HistoryAdd(History* history, const wchar_t* text);
+
+// Like HistoryAdd, but stores 'text' by reference instead of copying it.
+// 'text' must be NUL-terminated at 'length', 'hash' must be its
+// TextHashNoCase, and both must stay valid until the entry is evicted or the
+// history is freed. Used to serve entries straight from the persistent log.
+HistoryAddResult HistoryAddBorrowed(History* history, const wchar_t* text, size_t length, uint32_t hash);
+
+// Case-insensitive lookup of an exact entry. O(1) expected: hashes the folded
+// text and only compares entries whose hash matches.
+bool HistoryContains(const History* history, const wchar_t* text);
+
+size_t HistoryCount(const History* history);
+
+// Compresses entries of at least 'minBytes' as they are added and entries that
+// 'age' entries were added after (at least HISTORY_COLD_MIN_BYTES, and not
+// re-copied since). 0 disables either rule. Entries already stored are left as they are.
+void HistorySetCompression(History* history, size_t minBytes, size_t age);
+
+// Limits new entries to 'maxChars' characters (0 = no limit); 'policy' says
+// what happens to longer text. Entries already stored are left as they are,
+// and so are borrowed ones, which cost no memory of their own.
+void HistorySetSizeLimit(History* history, size_t maxChars, HistoryOversizePolicy policy);
+
+// Opens (and empties) the file HISTORY_OVERSIZE_SPILL stores oversized
+// entries in. Its content only means something to this History; it is closed
+// by HistoryFree. Returns false if the file cannot be opened, or if entries
+// are already spilled to another one.
+bool HistoryOpenSpill(History* history, const char* path);
+
+// Builds the display preview of a text into 'preview' (room for
+// HISTORY_PREVIEW_CHARS + 1, ellipsis included): leading whitespace dropped, runs of whitespace
+// that contain a line break or tab collapsed to one space, other control
+// characters dropped, and an ellipsis (U+2026) if the text goes on. Reads
+// only as much of the text as the preview needs. Returns its length.
+size_t HistoryMakePreview(const wchar_t* text, size_t length, wchar_t* preview);
+
+// Single-line text to display for an entry, at most HISTORY_PREVIEW_CHARS
+// long. Built once on insert and never decompresses, so
+// painting costs the same whatever the size of the entry.
+const wchar_t* HistoryEntryPreview(const History* history, const HistoryEntry* entry, size_t* length);
+
+// Text of an entry as wchar_t, decoded from UTF-8 and decompressed as
+// needed. Unless the entry keeps wchar_t text, the result comes from a small
+// cache and is only guaranteed valid until the next HistoryEntryText call
+// (history functions call it internally) or until the history is modified.
+// NULL if memory runs out.
+const wchar_t* HistoryEntryText(const History* history, const HistoryEntry* entry);
+
+// A substring filter, prepared once for any number of HistoryEntryContains calls
+typedef struct {
+    const wchar_t* text;
+    size_t length;
+    bool ascii;          // Folds to ASCII (TextFoldsToAscii): looked for in UTF-8 text as stored
+} HistoryFilter;
+
+void HistoryPrepareFilter(HistoryFilter* filter, const wchar_t* text, size_t length);
+
+// True if an entry contains the filter (case-insensitive; an empty one is in
+// every entry). Filters that fold to ASCII are looked for in plain UTF-8
+// entries as stored, and other ones are never in all-ASCII entries, so only
+// the rest is converted by HistoryEntryText (out of memory: no match).
+bool HistoryEntryContains(const History* history, const HistoryEntry* entry, const HistoryFilter* filter);
+
+// Metadata of an entry (see meta.h)
+typedef struct {
+    int64_t time;        // Unix time (seconds) of the latest copy, 0 = unknown
+    const wchar_t* source; // Process it was last copied from, "" = unknown; valid while the history is
+    uint32_t bytes;      // Size of the text in UTF-8
+    MetaClass metaClass;
+} HistoryMeta;
+
+void HistoryGetMeta(const History* history, const HistoryEntry* entry, HistoryMeta* meta);
+
+// Records when and where from an entry was copied: 'time' in Unix seconds (0 =
+// unknown) and the name of the copying process (NULL or "": the one recorded
+// stays). Entries are added with both unknown, and with their text's size and
+// MetaClassify class; ClipIngest sets the origin of every copy, re-copies included.
+void HistorySetOrigin(History* history, const HistoryEntry* entry, int64_t time, const wchar_t* source);
+
+// Replaces the class of an entry, for labels of content without text
+void HistorySetClass(History* history, const HistoryEntry* entry, MetaClass metaClass);
+
+// Makes an entry the most recent one and counts a use, in O(1). Its
+// sequence number stays. Done by HistoryAdd for re-copied text.
+void HistoryPromote(History* history, const HistoryEntry* entry);
+
+// Returns entry by recency index (0 = newest) or NULL if out of range
+const HistoryEntry* HistoryGet(const History* history, size_t index);
+
+// Entry at 'index' in 'order', or NULL if out of range. Walks from the
+// nearest of both ends and the previous call's position, so stepping through
+// neighbouring indices costs O(1) each.
+const HistoryEntry* HistoryGetInOrder(const History* history, HistoryOrder order, size_t index);
+
+// First entry in 'order' and the one after 'entry' (NULL at the end)
+const HistoryEntry* HistoryFirst(const History* history, HistoryOrder order);
+const HistoryEntry* HistoryNext(const History* history, const HistoryEntry* entry, HistoryOrder order);
+
+// Whether the entries are their sequence numbers below nextSeq, newest
+// first, none missing: true until an entry is promoted or replaced, and again
+// once those have gone. Entry i (0 = newest) is then entry nextSeq - 1 - i.
+bool HistorySeqOrdered(const History* history);
+
+// Recency index of a stored entry (0 = newest). O(1) while HistorySeqOrdered;
+// otherwise counts live stamps, a block of HISTORY_STAMP_BLOCK at a time.
+size_t HistoryRecencyIndex(const History* history, const HistoryEntry* entry);
+
+// Returns entry by sequence number or NULL if it was evicted / never existed
+const HistoryEntry* HistoryFindSeq(const History* history, uint32_t seq);
+
+// Builds (or drops) the trigram index. Searches of TRIGRAM_MIN_QUERY or more
+// characters then only verify entries containing every trigram of the query.
+// Costs memory roughly proportional to the stored text; see HistoryGetStats.
+bool HistoryEnableTrigramIndex(History* history, bool enable);
+
+// Builds (or, with NULL, drops) the near-duplicate index under 'config' (see
+// neardup.h). Entries added from then on replace their near-duplicates,
+// which are removed once the new entry is stored (the pool keeps a slot past
+// the entry limit for it); those already stored are left as they are. False
+// if memory runs out.
+bool HistoryEnableNearDuplicates(History* history, const NearDupConfig* config);
+
+// Drops the least recent entry. Returns false if history is empty.
+bool HistoryEvictOldest(History* history);
+
+// Memory and churn figures for diagnostics and benchmarks
+void HistoryGetStats(const History* history, HistoryStats* stats);
+
+// Visits entries containing 'filter' (case-insensitive), newest first.
+// NULL or empty filter matches everything. Returns number of entries visited.
+size_t HistoryForEachMatch(const History* history, const wchar_t* filter,
+                           HistoryVisitFn visit, void* context);
+
+// Optional in/out parameters of HistoryScan
+typedef struct {
+    size_t tested;                  // Incremented per entry whose text was compared
+    const volatile int32_t* cancel; // Polled (PlatformAtomicLoad) every HISTORY_SCAN_POLL entries; NULL = never
+    bool cancelled;                 // Set when the scan stopped because *cancel was nonzero
+    const uint64_t* slots;          // Bit per slot (see MetaQueryScan): entries whose bit is clear are
+                                    // skipped before their text is looked at; NULL = none
+    size_t slotsSet;                // Bits set in 'slots' (or more): when few, only those entries are visited
+} HistoryScanControl;
+
+#define HISTORY_SCAN_POLL 64
+#define HISTORY_SCAN_SPARSE 16      // "Few" set slots: at most 1 in this many entries
+
+// HistoryForEachMatch with a known filter length. 'control' may be NULL.
+size_t HistoryScan(const History* history, const wchar_t* filter, size_t filterLength,
+                   HistoryVisitFn visit, void* context, HistoryScanControl* control);
+
+#endif // MCLIP_HISTORY_H
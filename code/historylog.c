@@ -0,0 +1,520 @@
+#include "historylog.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HISTORY_LOG_MAGIC 0x474C434Du    // "MCLG"
+#define HISTORY_INDEX_MAGIC 0x494C434Du  // "MCLI"
+#define HISTORY_RECORD_MAGIC 0x52434C4Du // "MLCR"
+#define HISTORY_LOG_VERSION 1
+
+// First 16 bytes of both files
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t charSize;   // sizeof(wchar_t) of the writer: 2 on Windows, 4 elsewhere
+    uint64_t logId;      // Index entries are only valid for the log with the same id
+} HistoryLogHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t length;     // Characters, excluding the terminator
+    uint32_t hash;       // TextHashNoCase of the text
+    uint32_t crc;        // CRC-32 of length, hash and the text including its terminator
+} HistoryLogRecord;      // Followed by the text, zero-padded to a multiple of 8 bytes
+
+#define HISTORY_LOG_DATA_START ((uint64_t)sizeof(HistoryLogHeader))
+
+// --- CRC-32 (IEEE, reflected) ---
+
+static uint32_t g_crcTable[256];
+
+static void
+HistoryLogInitCrc(void)
+{
+    if (g_crcTable[1] != 0) return;
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+        g_crcTable[i] = crc;
+    }
+}
+
+static uint32_t
+HistoryLogCrc(uint32_t crc, const void* data, size_t size)
+{
+    const unsigned char* bytes = data;
+    crc = ~crc;
+    while (size-- > 0) {
+        crc = g_crcTable[(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t
+HistoryLogRecordCrc(const HistoryLogRecord* record, const void* text)
+{
+    uint32_t crc = HistoryLogCrc(0, &record->length, sizeof(record->length));
+    crc = HistoryLogCrc(crc, &record->hash, sizeof(record->hash));
+    return HistoryLogCrc(crc, text, ((size_t)record->length + 1) * sizeof(wchar_t));
+}
+
+// --- File Layout Helpers ---
+
+static uint64_t
+HistoryLogRecordSize(uint64_t length)
+{
+    uint64_t textBytes = (length + 1) * sizeof(wchar_t);
+    return sizeof(HistoryLogRecord) + ((textBytes + 7) & ~(uint64_t)7);
+}
+
+static char*
+HistoryLogPath(const char* path, const char* suffix)
+{
+    size_t pathLength = strlen(path);
+    size_t suffixLength = strlen(suffix);
+    char* result = malloc(pathLength + suffixLength + 1);
+    if (!result) return NULL;
+    memcpy(result, path, pathLength);
+    memcpy(result + pathLength, suffix, suffixLength + 1);
+    return result;
+}
+
+static uint64_t
+HistoryLogNewId(const void* salt)
+{
+    return ((uint64_t)time(NULL) << 32) ^ (uint64_t)clock() ^ (uint64_t)(uintptr_t)salt;
+}
+
+static bool
+HistoryLogWriteHeader(const PlatformFile* file, uint32_t magic, uint64_t logId)
+{
+    HistoryLogHeader header = { magic, HISTORY_LOG_VERSION, (uint16_t)sizeof(wchar_t), logId };
+    return PlatformFileTruncate(file, 0) && PlatformFileWrite(file, 0, &header, sizeof(header));
+}
+
+static bool
+HistoryLogHeaderMatches(const HistoryLogHeader* header, uint32_t magic)
+{
+    return header->magic == magic && header->version == HISTORY_LOG_VERSION &&
+           header->charSize == sizeof(wchar_t);
+}
+
+// Empties the index; the records it described get re-indexed by the next scan
+static bool
+HistoryLogResetIndex(HistoryLog* log)
+{
+    log->indexCount = 0;
+    log->pendingIndexCount = 0;
+    if (log->logSize > HISTORY_LOG_DATA_START) log->indexRebuilt = true;
+    return HistoryLogWriteHeader(&log->index, HISTORY_INDEX_MAGIC, log->logId);
+}
+
+// Grows a buffer to hold at least 'needed' elements
+static bool
+HistoryLogReserve(void** buffer, size_t* capacity, size_t needed, size_t elementSize)
+{
+    if (needed <= *capacity) return true;
+    size_t newCapacity = *capacity ? *capacity : 64;
+    while (newCapacity < needed) newCapacity *= 2;
+    void* grown = realloc(*buffer, newCapacity * elementSize);
+    if (!grown) return false;
+    *buffer = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+static bool
+HistoryLogPushIndex(HistoryLog* log, const HistoryLogIndexEntry* entry)
+{
+    if (!HistoryLogReserve((void**)&log->pendingIndex, &log->pendingIndexCapacity,
+                           log->pendingIndexCount + 1, sizeof(HistoryLogIndexEntry))) {
+        return false;
+    }
+    log->pendingIndex[log->pendingIndexCount++] = *entry;
+    return true;
+}
+
+// Checks the record at 'offset' of the mapped log, ending at or before 'end'.
+// The CRC is only verified when 'verifyCrc' is set.
+static bool
+HistoryLogCheckRecord(const HistoryLog* log, uint64_t offset, uint64_t end, bool verifyCrc,
+                      HistoryLogIndexEntry* entry)
+{
+    if (offset < HISTORY_LOG_DATA_START || offset % 8 != 0 || offset > end ||
+        end - offset < sizeof(HistoryLogRecord)) {
+        return false;
+    }
+
+    const HistoryLogRecord* record = (const HistoryLogRecord*)((const unsigned char*)log->map.data + offset);
+    if (record->magic != HISTORY_RECORD_MAGIC) return false;
+    if (HistoryLogRecordSize(record->length) > end - offset) return false;
+
+    const wchar_t* text = (const wchar_t*)(record + 1);
+    if (text[record->length] != L'\0') return false;
+    if (verifyCrc && HistoryLogRecordCrc(record, text) != record->crc) return false;
+
+    entry->offset = offset;
+    entry->length = record->length;
+    entry->hash = record->hash;
+    return true;
+}
+
+// --- Open ---
+
+// Closes files and frees buffers without flushing
+static void
+HistoryLogRelease(HistoryLog* log)
+{
+    PlatformUnmap(&log->map);
+    PlatformFileClose(&log->log);
+    PlatformFileClose(&log->index);
+    free(log->pending);
+    free(log->pendingIndex);
+    log->pending = NULL;
+    log->pendingIndex = NULL;
+    log->open = false;
+}
+
+static HistoryLogResult
+HistoryLogOpenFiles(HistoryLog* log, const char* path, const char* indexPath)
+{
+    if (!PlatformFileOpen(&log->log, path) || !PlatformFileOpen(&log->index, indexPath)) {
+        return HISTORY_LOG_IO_ERROR;
+    }
+
+    HistoryLogHeader header;
+    uint64_t size;
+    if (!PlatformFileSize(&log->log, &size)) return HISTORY_LOG_IO_ERROR;
+    if (size < sizeof(header)) {
+        // New log, or its creation was interrupted
+        log->logId = HistoryLogNewId(log);
+        if (!HistoryLogWriteHeader(&log->log, HISTORY_LOG_MAGIC, log->logId) ||
+            !PlatformFileSync(&log->log)) {
+            return HISTORY_LOG_IO_ERROR;
+        }
+        size = sizeof(header);
+    } else {
+        if (!PlatformFileRead(&log->log, 0, &header, sizeof(header))) return HISTORY_LOG_IO_ERROR;
+        if (!HistoryLogHeaderMatches(&header, HISTORY_LOG_MAGIC)) return HISTORY_LOG_BAD_FORMAT;
+        log->logId = header.logId;
+    }
+    log->logSize = size; // Includes any torn tail until recovery
+
+    uint64_t indexSize;
+    if (!PlatformFileSize(&log->index, &indexSize)) return HISTORY_LOG_IO_ERROR;
+    if (indexSize >= sizeof(header)) {
+        if (!PlatformFileRead(&log->index, 0, &header, sizeof(header))) return HISTORY_LOG_IO_ERROR;
+        if (HistoryLogHeaderMatches(&header, HISTORY_INDEX_MAGIC) && header.logId == log->logId) {
+            // A torn last entry is ignored and overwritten by the next flush
+            log->indexCount = (indexSize - sizeof(header)) / sizeof(HistoryLogIndexEntry);
+            return HISTORY_LOG_OK;
+        }
+    }
+    return HistoryLogResetIndex(log) ? HISTORY_LOG_OK : HISTORY_LOG_IO_ERROR;
+}
+
+// Parses records that are in the log but not in the index, CRC-checking each.
+// Returns the offset just past the last good record.
+static HistoryLogResult
+HistoryLogScanTail(HistoryLog* log, uint64_t* validEnd)
+{
+    uint64_t offset = HISTORY_LOG_DATA_START;
+
+    if (log->indexCount > 0) {
+        HistoryLogIndexEntry last, found;
+        uint64_t at = HISTORY_LOG_DATA_START + (log->indexCount - 1) * sizeof(HistoryLogIndexEntry);
+        if (!PlatformFileRead(&log->index, at, &last, sizeof(last))) return HISTORY_LOG_IO_ERROR;
+
+        if (HistoryLogCheckRecord(log, last.offset, log->logSize, false, &found) &&
+            found.length == last.length && found.hash == last.hash) {
+            offset = last.offset + HistoryLogRecordSize(last.length);
+        } else if (!HistoryLogResetIndex(log)) {
+            return HISTORY_LOG_IO_ERROR;
+        }
+    }
+
+    HistoryLogIndexEntry entry;
+    while (offset < log->logSize && HistoryLogCheckRecord(log, offset, log->logSize, true, &entry)) {
+        if (!HistoryLogPushIndex(log, &entry)) return HISTORY_LOG_NO_MEMORY;
+        offset += HistoryLogRecordSize(entry.length);
+    }
+    *validEnd = offset;
+    return HISTORY_LOG_OK;
+}
+
+// Collects the index entries of the newest 'capacity' records, oldest first.
+// Entries read from the index file are bounds-checked against the log; sets
+// *consistent to false if they do not describe it.
+static HistoryLogResult
+HistoryLogCollectTail(HistoryLog* log, size_t capacity, uint64_t validEnd,
+                      HistoryLogIndexEntry** tail, size_t* tailCount, bool* consistent)
+{
+    uint64_t total = log->indexCount + log->pendingIndexCount;
+    size_t count = total < capacity ? (size_t)total : capacity;
+    size_t fromPending = count < log->pendingIndexCount ? count : log->pendingIndexCount;
+    size_t fromFile = count - fromPending;
+
+    *tail = NULL;
+    *tailCount = 0;
+    *consistent = true;
+    if (count == 0) return HISTORY_LOG_OK;
+
+    HistoryLogIndexEntry* entries = malloc(count * sizeof(HistoryLogIndexEntry));
+    if (!entries) return HISTORY_LOG_NO_MEMORY;
+
+    uint64_t at = HISTORY_LOG_DATA_START + (log->indexCount - fromFile) * sizeof(HistoryLogIndexEntry);
+    if (fromFile > 0 && !PlatformFileRead(&log->index, at, entries, fromFile * sizeof(HistoryLogIndexEntry))) {
+        free(entries);
+        return HISTORY_LOG_IO_ERROR;
+    }
+    if (fromPending > 0) {
+        memcpy(entries + fromFile, log->pendingIndex + (log->pendingIndexCount - fromPending),
+               fromPending * sizeof(HistoryLogIndexEntry));
+    }
+
+    // Records must lie inside the log, in order and without overlapping.
+    // Their headers are not touched: loading must not fault in the whole log.
+    uint64_t previousEnd = HISTORY_LOG_DATA_START;
+    for (size_t i = 0; i < fromFile; ++i) {
+        uint64_t offset = entries[i].offset;
+        if (offset < previousEnd || offset % 8 != 0 || offset > validEnd ||
+            HistoryLogRecordSize(entries[i].length) > validEnd - offset) {
+            *consistent = false;
+            break;
+        }
+        previousEnd = offset + HistoryLogRecordSize(entries[i].length);
+    }
+
+    *tail = entries;
+    *tailCount = count;
+    return HISTORY_LOG_OK;
+}
+
+// Drops the torn tail after 'validEnd'. The log must be unmapped to shrink it.
+static HistoryLogResult
+HistoryLogTruncate(HistoryLog* log, uint64_t validEnd)
+{
+    if (validEnd == log->logSize) return HISTORY_LOG_OK;
+
+    log->truncatedBytes = log->logSize - validEnd;
+    PlatformUnmap(&log->map);
+    if (!PlatformFileTruncate(&log->log, validEnd) || !PlatformFileSync(&log->log) ||
+        !PlatformMapFile(&log->map, &log->log, (size_t)validEnd)) {
+        return HISTORY_LOG_IO_ERROR;
+    }
+    log->logSize = validEnd;
+    return HISTORY_LOG_OK;
+}
+
+// Rewrites the log with only the records in 'tail' (the newest ones, which
+// are contiguous at its end). A failure before the new log is in place
+// leaves the old one untouched; a crash before the index is rewritten leaves
+// an index with the old log id, which the next open rebuilds.
+static HistoryLogResult
+HistoryLogCompact(HistoryLog* log, const char* path, const char* tempPath,
+                  HistoryLogIndexEntry* tail, size_t tailCount)
+{
+    uint64_t liveStart = tail[0].offset;
+    uint64_t shift = liveStart - HISTORY_LOG_DATA_START;
+    uint64_t newId = HistoryLogNewId(tail);
+    if (newId == log->logId) newId++;
+
+    PlatformFile temp = PLATFORM_FILE_CLOSED;
+    bool written = PlatformFileOpen(&temp, tempPath) &&
+                   HistoryLogWriteHeader(&temp, HISTORY_LOG_MAGIC, newId) &&
+                   PlatformFileWrite(&temp, HISTORY_LOG_DATA_START,
+                                     (const unsigned char*)log->map.data + liveStart,
+                                     (size_t)(log->logSize - liveStart)) &&
+                   PlatformFileSync(&temp);
+    PlatformFileClose(&temp);
+    if (!written) {
+        PlatformFileDelete(tempPath);
+        return HISTORY_LOG_OK; // Not worth failing the open over
+    }
+
+    PlatformUnmap(&log->map);
+    PlatformFileClose(&log->log);
+    bool replaced = PlatformFileReplace(tempPath, path);
+    if (!replaced) PlatformFileDelete(tempPath);
+    if (!PlatformFileOpen(&log->log, path)) return HISTORY_LOG_IO_ERROR;
+
+    if (replaced) {
+        log->logId = newId;
+        log->logSize -= shift;
+        for (size_t i = 0; i < tailCount; ++i) tail[i].offset -= shift;
+
+        bool wasRebuilt = log->indexRebuilt;
+        if (!HistoryLogResetIndex(log) ||
+            !PlatformFileWrite(&log->index, HISTORY_LOG_DATA_START, tail,
+                               tailCount * sizeof(HistoryLogIndexEntry))) {
+            return HISTORY_LOG_IO_ERROR;
+        }
+        log->indexRebuilt = wasRebuilt;
+        log->indexCount = tailCount;
+        log->compacted = true;
+    }
+    return PlatformMapFile(&log->map, &log->log, (size_t)log->logSize) ? HISTORY_LOG_OK
+                                                                        : HISTORY_LOG_IO_ERROR;
+}
+
+// Maps the log, repairs it and returns the entries to load, oldest first
+static HistoryLogResult
+HistoryLogRecover(HistoryLog* log, const char* path, const char* tempPath, size_t capacity,
+                  HistoryLogIndexEntry** tail, size_t* tailCount)
+{
+    if (log->logSize > SIZE_MAX) return HISTORY_LOG_NO_MEMORY; // Cannot map on a 32-bit build
+    if (!PlatformMapFile(&log->map, &log->log, (size_t)log->logSize)) return HISTORY_LOG_IO_ERROR;
+
+    uint64_t validEnd = 0;
+    bool consistent = false;
+    HistoryLogResult result = HISTORY_LOG_OK;
+
+    // Second pass only if the index turned out not to describe the log
+    for (int pass = 0; pass < 2 && !consistent && result == HISTORY_LOG_OK; ++pass) {
+        if (pass > 0 && !HistoryLogResetIndex(log)) return HISTORY_LOG_IO_ERROR;
+        result = HistoryLogScanTail(log, &validEnd);
+        if (result == HISTORY_LOG_OK) {
+            free(*tail);
+            result = HistoryLogCollectTail(log, capacity, validEnd, tail, tailCount, &consistent);
+        }
+    }
+    if (result != HISTORY_LOG_OK) return result;
+
+    result = HistoryLogTruncate(log, validEnd);
+    if (result != HISTORY_LOG_OK) return result;
+    log->records = log->indexCount + log->pendingIndexCount;
+
+    uint64_t deadBytes = *tailCount > 0 ? (*tail)[0].offset - HISTORY_LOG_DATA_START : 0;
+    if (log->records > 2 * (uint64_t)*tailCount && deadBytes >= HISTORY_LOG_COMPACT_MIN_BYTES) {
+        result = HistoryLogCompact(log, path, tempPath, *tail, *tailCount);
+        if (log->compacted) log->records = *tailCount;
+    }
+    return result;
+}
+
+HistoryLogResult
+HistoryLogOpen(HistoryLog* log, const char* path, History* history)
+{
+    PlatformFile closed = PLATFORM_FILE_CLOSED;
+    memset(log, 0, sizeof(*log));
+    log->log = closed;
+    log->index = closed;
+    HistoryLogInitCrc();
+
+    HistoryLogIndexEntry* tail = NULL;
+    size_t tailCount = 0;
+    char* indexPath = HistoryLogPath(path, ".idx");
+    char* tempPath = HistoryLogPath(path, ".tmp");
+
+    HistoryLogResult result = indexPath && tempPath ? HISTORY_LOG_OK : HISTORY_LOG_NO_MEMORY;
+    if (result == HISTORY_LOG_OK) result = HistoryLogOpenFiles(log, path, indexPath);
+    if (result == HISTORY_LOG_OK) {
+        // Without an entry limit every record is loaded, and the byte budget trims them
+        size_t capacity = history->maxEntries > 0 ? history->maxEntries : SIZE_MAX;
+        result = HistoryLogRecover(log, path, tempPath, capacity, &tail, &tailCount);
+    }
+    if (result == HISTORY_LOG_OK) {
+        // Index the records found by the tail scan
+        log->open = true;
+        if (!HistoryLogFlush(log)) result = HISTORY_LOG_IO_ERROR;
+    }
+
+    if (result == HISTORY_LOG_OK) {
+        for (size_t i = 0; i < tailCount; ++i) {
+            const HistoryLogRecord* record =
+                (const HistoryLogRecord*)((const unsigned char*)log->map.data + tail[i].offset);
+            const wchar_t* text = (const wchar_t*)(record + 1);
+            if (HistoryAddBorrowed(history, text, tail[i].length, tail[i].hash) == HISTORY_ADDED) {
+                log->loaded++;
+            }
+        }
+    } else {
+        HistoryLogRelease(log);
+    }
+
+    free(tail);
+    free(indexPath);
+    free(tempPath);
+    return result;
+}
+
+// --- Append / Flush / Close ---
+
+bool
+HistoryLogAppend(HistoryLog* log, const wchar_t* text, size_t length, uint32_t hash)
+{
+    if (!log->open || log->failed) return false;
+    if (length >= UINT32_MAX) return false;
+
+    uint64_t recordSize = HistoryLogRecordSize(length);
+    if (recordSize > SIZE_MAX - log->pendingBytes) return false;
+    if (!HistoryLogReserve((void**)&log->pending, &log->pendingCapacity,
+                           log->pendingBytes + (size_t)recordSize, 1)) {
+        return false;
+    }
+
+    HistoryLogIndexEntry indexEntry = { log->logSize + log->pendingBytes, (uint32_t)length, hash };
+    if (!HistoryLogPushIndex(log, &indexEntry)) return false;
+
+    unsigned char* out = log->pending + log->pendingBytes;
+    size_t textBytes = (length + 1) * sizeof(wchar_t);
+    HistoryLogRecord record = { HISTORY_RECORD_MAGIC, (uint32_t)length, hash, 0 };
+    record.crc = HistoryLogRecordCrc(&record, text);
+
+    memcpy(out, &record, sizeof(record));
+    memcpy(out + sizeof(record), text, textBytes);
+    memset(out + sizeof(record) + textBytes, 0, (size_t)recordSize - sizeof(record) - textBytes);
+    log->pendingBytes += (size_t)recordSize;
+    log->records++;
+
+    if (log->pendingBytes >= HISTORY_LOG_FLUSH_BYTES) return HistoryLogFlush(log);
+    return true;
+}
+
+bool
+HistoryLogFlush(HistoryLog* log)
+{
+    if (!log->open || log->failed) return false;
+
+    // Log first and durably, so the index never points past synced data
+    if (log->pendingBytes > 0) {
+        if (!PlatformFileWrite(&log->log, log->logSize, log->pending, log->pendingBytes) ||
+            !PlatformFileSync(&log->log)) {
+            log->failed = true;
+            return false;
+        }
+        log->logSize += log->pendingBytes;
+        log->pendingBytes = 0;
+    }
+
+    // The index is not synced: a lost tail of it is recovered by the next open's scan
+    if (log->pendingIndexCount > 0) {
+        uint64_t at = HISTORY_LOG_DATA_START + log->indexCount * sizeof(HistoryLogIndexEntry);
+        if (!PlatformFileWrite(&log->index, at, log->pendingIndex,
+                               log->pendingIndexCount * sizeof(HistoryLogIndexEntry))) {
+            log->failed = true;
+            return false;
+        }
+        log->indexCount += log->pendingIndexCount;
+        log->pendingIndexCount = 0;
+    }
+    return true;
+}
+
+void
+HistoryLogClose(HistoryLog* log)
+{
+    if (!log->open) return;
+    HistoryLogFlush(log);
+    HistoryLogRelease(log);
+}
+
+bool
+HistoryLogIsOpen(const HistoryLog* log)
+{
+    return log->open;
+}
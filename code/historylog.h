@@ -0,0 +1,95 @@
+#ifndef MCLIP_HISTORYLOG_H
+#define MCLIP_HISTORYLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "history.h"
+#include "platform.h"
+
+// --- Persistent History Log ---
+// Append-only on-disk log of added entries, so history survives restarts and
+// crashes. A re-copy is logged again; loading replays it as the promotion it
+// was (see HistoryAdd). Two files:
+//
+//   <path>      header, then one record per entry: magic, length, hash,
+//               CRC-32, NUL-terminated text padded to 8 bytes
+//   <path>.idx  header, then one fixed 16-byte entry per record
+//               (offset, length, hash)
+//
+// At open the log is memory-mapped read-only and the newest 'maxEntries'
+// records (all of them without a limit) are handed to the history with
+// HistoryAddBorrowed, which then applies its byte budget. Their text is
+// served straight from the mapping: nothing is copied, re-hashed or
+// re-checksummed. Only records past the end of the index (written before a
+// crash, or not yet indexed) are parsed and CRC-checked; the first bad one
+// and everything after it are truncated. An index that does not match the
+// log is rebuilt from a full scan.
+//
+// Appends are buffered and written in batches: HistoryLogFlush writes and
+// syncs the log first, then the index, so the index never points past
+// durable log data. The log is compacted at open once the live records are
+// less than half of it and the dead prefix is large enough to matter.
+
+#define HISTORY_LOG_FLUSH_BYTES (64 * 1024)          // Append flushes once this much is buffered
+#define HISTORY_LOG_COMPACT_MIN_BYTES (1024 * 1024)  // Dead prefix worth rewriting the log for
+
+typedef enum {
+    HISTORY_LOG_OK = 0,
+    HISTORY_LOG_IO_ERROR,    // A file operation failed (GetLastError / errno has the cause)
+    HISTORY_LOG_BAD_FORMAT,  // Not a log of this build (magic, version or character size); left untouched
+    HISTORY_LOG_NO_MEMORY
+} HistoryLogResult;
+
+typedef struct {
+    uint64_t offset;         // Byte offset of the record in the log
+    uint32_t length;         // Characters, excluding the terminator
+    uint32_t hash;           // TextHashNoCase of the text
+} HistoryLogIndexEntry;
+
+typedef struct {
+    bool open;
+    bool failed;             // A write failed: appends are dropped until reopened
+    PlatformFile log;
+    PlatformFile index;
+    PlatformMap map;         // Log as found at open; loaded entries point into it
+    uint64_t logId;          // Ties the index to its log; changes when the log is rewritten
+    uint64_t logSize;        // Bytes in the log file, excluding pending records
+    uint64_t indexCount;     // Entries in the index file, excluding pending ones
+
+    unsigned char* pending;  // Encoded records not yet written
+    size_t pendingBytes;
+    size_t pendingCapacity;
+    HistoryLogIndexEntry* pendingIndex;
+    size_t pendingIndexCount;
+    size_t pendingIndexCapacity;
+
+    // What the last HistoryLogOpen found (diagnostics and tests)
+    size_t loaded;           // Entries handed to the history
+    uint64_t records;        // Records in the log after recovery
+    uint64_t truncatedBytes; // Torn or corrupt tail dropped
+    bool indexRebuilt;       // Index did not match the log and was rebuilt by a full scan
+    bool compacted;          // Dead records were dropped by rewriting the log
+} HistoryLog;
+
+// Opens (or creates) the log at 'path' and loads its newest entries into
+// 'history', which should be empty and have its limits set (HistorySetLimits).
+// The log must stay open until the history is freed: loaded entries borrow
+// their text from its mapping.
+HistoryLogResult HistoryLogOpen(HistoryLog* log, const char* path, History* history);
+
+// Queues the text of an entry just added to the history ('hash' is the
+// entry's TextHashNoCase). Flushes when enough is buffered. Returns false if
+// the log is closed or a write failed.
+bool HistoryLogAppend(HistoryLog* log, const wchar_t* text, size_t length, uint32_t hash);
+
+// Writes and syncs queued records. Returns false if the log is closed or a write failed.
+bool HistoryLogFlush(HistoryLog* log);
+
+// Flushes and closes. Safe on a zeroed or already closed log.
+void HistoryLogClose(HistoryLog* log);
+
+bool HistoryLogIsOpen(const HistoryLog* log);
+
+#endif // MCLIP_HISTORYLOG_H
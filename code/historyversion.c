@@ -0,0 +1,212 @@
+#include "historyversion.h"
+#include "platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool
+HistoryVersionsInit(HistoryVersions* versions)
+{
+    memset(versions, 0, sizeof(*versions));
+    EpochInit(&versions->epochs);
+    return HashIndexInit(&versions->bySeq, 64);
+}
+
+void
+HistoryVersionsFree(HistoryVersions* versions)
+{
+    EpochFree(&versions->epochs);
+    free(versions->current);
+    for (size_t i = 0; i < versions->textCount; ++i) free(versions->texts[i]);
+    free(versions->texts);
+    free(versions->marks);
+    HashIndexFree(&versions->bySeq);
+    memset(versions, 0, sizeof(*versions));
+}
+
+static size_t
+HistoryVersionTextBytes(const HistoryVersionText* record)
+{
+    return record->text ? record->length * sizeof(wchar_t) : 0;
+}
+
+// Index in 'texts' of the record of entry 'seq', with or without its text,
+// or SIZE_MAX. An entry whose text went over the budget (or came back under
+// it) briefly has both: the one a publish does not use is retired.
+static size_t
+HistoryVersionsFind(const HistoryVersions* versions, uint32_t seq, bool withText)
+{
+    HashIndexIter iter;
+    uint32_t index;
+    HashIndexFind(&versions->bySeq, seq, &iter);
+    while (HashIndexNext(&iter, &index)) {
+        const HistoryVersionText* record = versions->texts[index];
+        if (record->seq == seq && (record->text != NULL) == withText) return index;
+    }
+    return SIZE_MAX;
+}
+
+static bool
+HistoryVersionsReserve(HistoryVersions* versions, size_t count)
+{
+    if (count <= versions->textCapacity) return true;
+    size_t capacity = versions->textCapacity ? versions->textCapacity : 64;
+    while (capacity < count) capacity *= 2;
+    HistoryVersionText** texts = realloc(versions->texts, capacity * sizeof(*texts));
+    if (!texts) return false;
+    versions->texts = texts;
+    uint32_t* marks = realloc(versions->marks, capacity * sizeof(*marks));
+    if (!marks) return false;
+    versions->marks = marks;
+    versions->textCapacity = capacity;
+    return true;
+}
+
+// Immutable record of an entry, with a copy of its text (decompressed if
+// need be) or without
+static HistoryVersionText*
+HistoryVersionsCopyText(const History* history, const HistoryEntry* entry, bool withText)
+{
+    const wchar_t* text = withText ? HistoryEntryText(history, entry) : NULL;
+    if (withText && !text) return NULL;
+    size_t textBytes = withText ? (entry->length + 1) * sizeof(wchar_t) : 0;
+    HistoryVersionText* record = malloc(sizeof(HistoryVersionText) + textBytes);
+    if (!record) return NULL;
+    record->seq = entry->seq;
+    record->hash = entry->hash;
+    record->length = entry->length;
+    record->text = NULL;
+    if (withText) {
+        wchar_t* copy = (wchar_t*)(record + 1);
+        memcpy(copy, text, entry->length * sizeof(wchar_t));
+        copy[entry->length] = L'\0';
+        record->text = copy;
+    }
+    return record;
+}
+
+// Takes the record at 'index' out of the writer's table; the last one moves into its place
+static void
+HistoryVersionsDrop(HistoryVersions* versions, size_t index)
+{
+    HistoryVersionText* record = versions->texts[index];
+    HashIndexRemove(&versions->bySeq, record->seq, (uint32_t)index);
+    versions->textBytes -= HistoryVersionTextBytes(record);
+    size_t last = --versions->textCount;
+    if (index != last) {
+        HistoryVersionText* moved = versions->texts[last];
+        HashIndexRemove(&versions->bySeq, moved->seq, (uint32_t)last);
+        HashIndexInsert(&versions->bySeq, moved->seq, (uint32_t)index); // Cannot grow: one was just removed
+        versions->texts[index] = moved;
+        versions->marks[index] = versions->marks[last];
+    }
+}
+
+bool
+HistoryVersionsPublish(HistoryVersions* versions, const History* history, HistoryOrder order)
+{
+    size_t count = HistoryCount(history);
+    if (!HistoryVersionsReserve(versions, versions->textCount + count)) return false;
+    HistoryVersion* version = malloc(sizeof(HistoryVersion) + count * sizeof(HistoryVersionEntry));
+    if (!version) return false;
+    HistoryVersionEntry* entries = (HistoryVersionEntry*)(version + 1);
+    version->generation = history->generation;
+    version->order = order;
+    version->count = count;
+    version->entries = entries;
+
+    uint32_t publish = ++versions->publish;
+    size_t firstNew = versions->textCount;
+    size_t i = 0;
+    size_t budgetLeft = versions->textBudget > 0 ? versions->textBudget : SIZE_MAX;
+    for (const HistoryEntry* entry = HistoryFirst(history, order); entry; entry = HistoryNext(history, entry, order)) {
+        size_t bytes = entry->length * sizeof(wchar_t);
+        bool withText = bytes <= budgetLeft;
+        if (withText) budgetLeft -= bytes;
+        size_t index = HistoryVersionsFind(versions, entry->seq, withText);
+        if (index == SIZE_MAX) {
+            HistoryVersionText* record = HistoryVersionsCopyText(history, entry, withText);
+            index = versions->textCount;
+            if (!record || !HashIndexInsert(&versions->bySeq, entry->seq, (uint32_t)index)) {
+                free(record);
+                // Undo: the records added so far are in no published version
+                while (versions->textCount > firstNew) {
+                    HistoryVersionText* added = versions->texts[versions->textCount - 1];
+                    HistoryVersionsDrop(versions, versions->textCount - 1);
+                    free(added);
+                }
+                free(version);
+                return false;
+            }
+            versions->texts[versions->textCount++] = record;
+            versions->textBytes += HistoryVersionTextBytes(record);
+        }
+        versions->marks[index] = publish;
+        entries[i].text = versions->texts[index];
+        entries[i].uses = entry->uses;
+        i++;
+    }
+
+    // Readers switch to the new version; the old one, and the texts only it
+    // had, go once the readers still on it are done
+    HistoryVersion* old = versions->current;
+    PlatformAtomicStorePointer((void* volatile*)&versions->current, version);
+    if (old) EpochRetire(&versions->epochs, old, free);
+    for (size_t index = 0; index < versions->textCount;) {
+        if (versions->marks[index] == publish) {
+            index++;
+            continue;
+        }
+        HistoryVersionText* record = versions->texts[index];
+        HistoryVersionsDrop(versions, index); // Moves an unchecked record into 'index'
+        EpochRetire(&versions->epochs, record, free);
+    }
+    EpochCollect(&versions->epochs);
+    return true;
+}
+
+size_t
+HistoryVersionsMemory(const HistoryVersions* versions)
+{
+    size_t bytes = versions->textBytes + versions->textCount * sizeof(HistoryVersionText) +
+                   versions->textCapacity * (sizeof(HistoryVersionText*) + sizeof(uint32_t)) +
+                   HashIndexMemory(&versions->bySeq);
+    if (versions->current) bytes += sizeof(HistoryVersion) + versions->current->count * sizeof(HistoryVersionEntry);
+    return bytes;
+}
+
+void
+HistoryVersionWriteSnapshot(const HistoryVersion* version, SnapshotWriter* writer)
+{
+    SnapshotWriterBegin(writer, version->generation, (uint32_t)version->order, version->count);
+    for (size_t i = 0; i < version->count; ++i) {
+        const HistoryVersionText* text = version->entries[i].text;
+        if (!SnapshotWriterAdd(writer, text->seq, version->entries[i].uses, text->text, text->length)) break;
+    }
+    SnapshotWriterCommit(writer);
+}
+
+int
+HistoryVersionsRegister(HistoryVersions* versions)
+{
+    return EpochRegister(&versions->epochs);
+}
+
+void
+HistoryVersionsUnregister(HistoryVersions* versions, int reader)
+{
+    EpochUnregister(&versions->epochs, reader);
+}
+
+const HistoryVersion*
+HistoryVersionsPin(HistoryVersions* versions, int reader)
+{
+    EpochPin(&versions->epochs, reader);
+    return PlatformAtomicLoadPointer((void* const volatile*)&versions->current);
+}
+
+void
+HistoryVersionsUnpin(HistoryVersions* versions, int reader)
+{
+    EpochUnpin(&versions->epochs, reader);
+}
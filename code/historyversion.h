@@ -0,0 +1,99 @@
+#ifndef MCLIP_HISTORYVERSION_H
+#define MCLIP_HISTORYVERSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include "epoch.h"
+#include "hashindex.h"
+#include "history.h"
+#include "snapshot.h"
+
+// --- Immutable History Versions ---
+// Read-only copies of the history that readers on any thread use without a
+// lock, while the owner of the History keeps adding and evicting. After a
+// change, the writer publishes a new HistoryVersion (generation, order and
+// entry table); readers pin the current one and keep it, unchanged, until
+// they unpin. Nothing a reader can reach is ever modified or freed under it:
+// versions and entry texts are retired through an EpochDomain and released
+// once no reader holds them.
+//
+// Texts are immutable records shared by every version their entry is in, so
+// a publish copies the text of new entries only (decompressing compressed
+// ones once) and otherwise costs O(entries) for the table. Records take as
+// much memory as the plain text of the entries they copy, so 'textBudget'
+// can bound it: texts are copied in list order until it is spent, and the
+// entries past it are listed without text (HistoryVersionsMemory counts it all).
+//
+// The app publishes a version after every change to its history and writes
+// the shared-memory snapshot (snapshot.h) from the pinned latest one, so the
+// snapshot never waits on the history lock a search holds.
+
+typedef struct {
+    uint32_t seq;          // HistoryEntry.seq
+    uint32_t hash;         // TextHashNoCase of the text
+    size_t length;
+    const wchar_t* text;   // NUL-terminated, in the same allocation; NULL past the text budget
+} HistoryVersionText;
+
+typedef struct {
+    const HistoryVersionText* text;
+    uint32_t uses;         // Times copied, as of this version
+} HistoryVersionEntry;
+
+typedef struct {
+    uint64_t generation;   // History.generation it was taken at
+    HistoryOrder order;
+    size_t count;
+    const HistoryVersionEntry* entries; // In 'order', in the same allocation
+} HistoryVersion;
+
+typedef struct {
+    EpochDomain epochs;
+    HistoryVersion* volatile current; // Published version, NULL before the first publish
+
+    // Writer only
+    HistoryVersionText** texts; // Records in the current version ...
+    uint32_t* marks;            // ... the publish that last used each ...
+    size_t textCount;
+    size_t textCapacity;
+    HashIndex bySeq;            // ... and seq -> index into 'texts'
+    uint32_t publish;
+    size_t textBytes;           // Held by the texts of the current version's records
+    size_t textBudget;          // Most of those a publish leaves, in list order; 0 = no limit
+} HistoryVersions;
+
+// Versions of one History: its entries are matched by sequence number. No
+// text budget; set 'textBudget' to bound the copies.
+bool HistoryVersionsInit(HistoryVersions* versions);
+
+// Releases every version and record. No reader may be pinned.
+void HistoryVersionsFree(HistoryVersions* versions);
+
+// Publishes the history as it is now, listed in 'order'. Writer only, and
+// the history must not change meanwhile. False if out of memory, in which
+// case readers keep seeing the previous version.
+bool HistoryVersionsPublish(HistoryVersions* versions, const History* history, HistoryOrder order);
+
+// Bytes held by the writer: records, texts, tables and the current version
+// (not versions retired but still pinned)
+size_t HistoryVersionsMemory(const HistoryVersions* versions);
+
+// Writes a pinned version to the shared-memory snapshot, in its order, with
+// texts until the snapshot's text area is full (see snapshot.h). Needs no
+// access to the History, so no lock on it.
+void HistoryVersionWriteSnapshot(const HistoryVersion* version, SnapshotWriter* writer);
+
+// Reader slots (EpochRegister): one per reading thread, -1 if none is left
+int HistoryVersionsRegister(HistoryVersions* versions);
+void HistoryVersionsUnregister(HistoryVersions* versions, int reader);
+
+// The current version (NULL before the first publish), valid until
+// HistoryVersionsUnpin. Keep pins short: while one is held, nothing retired
+// after it began is released.
+const HistoryVersion* HistoryVersionsPin(HistoryVersions* versions, int reader);
+void HistoryVersionsUnpin(HistoryVersions* versions, int reader);
+
+#endif // MCLIP_HISTORYVERSION_H
@@ -0,0 +1,179 @@
+#include "lz.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+#define LZ_SKIP_TRIGGER 6 // Search step grows by one every 2^6 misses
+
+size_t
+LzCompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+static uint32_t
+LzRead32(const unsigned char* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t
+LzHash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Writes the 255-valued continuation bytes of a length whose nibble was 15
+static unsigned char*
+LzWriteLength(unsigned char* out, const unsigned char* outEnd, size_t length)
+{
+    while (length >= 255) {
+        if (out >= outEnd) return NULL;
+        *out++ = 255;
+        length -= 255;
+    }
+    if (out >= outEnd) return NULL;
+    *out++ = (unsigned char)length;
+    return out;
+}
+
+// Emits one sequence; matchLength 0 means literals only (the final sequence)
+static unsigned char*
+LzWriteSequence(unsigned char* out, const unsigned char* outEnd,
+                const unsigned char* literals, size_t literalLength,
+                size_t offset, size_t matchLength)
+{
+    if (out >= outEnd) return NULL;
+    unsigned char* token = out++;
+    size_t matchCode = matchLength ? matchLength - LZ_MIN_MATCH : 0;
+
+    *token = (unsigned char)(((literalLength < 15 ? literalLength : 15) << 4) |
+                             (matchCode < 15 ? matchCode : 15));
+    if (literalLength >= 15 && !(out = LzWriteLength(out, outEnd, literalLength - 15))) return NULL;
+
+    if ((size_t)(outEnd - out) < literalLength) return NULL;
+    memcpy(out, literals, literalLength);
+    out += literalLength;
+
+    if (matchLength == 0) return out;
+    if (outEnd - out < 2) return NULL;
+    *out++ = (unsigned char)(offset & 0xFF);
+    *out++ = (unsigned char)(offset >> 8);
+    if (matchCode >= 15 && !(out = LzWriteLength(out, outEnd, matchCode - 15))) return NULL;
+    return out;
+}
+
+size_t
+LzCompress(const void* src, size_t srcSize, void* dst, size_t dstCapacity)
+{
+    const unsigned char* in = src;
+    const unsigned char* inEnd = in + srcSize;
+    unsigned char* out = dst;
+    const unsigned char* outEnd = out + dstCapacity;
+    const unsigned char* literals = in;
+
+    if (srcSize >= LZ_MIN_MATCH + 1) {
+        uint32_t table[1 << LZ_HASH_BITS];
+        memset(table, 0xFF, sizeof(table)); // UINT32_MAX: no candidate
+
+        const unsigned char* ip = in;
+        const unsigned char* matchLimit = inEnd - LZ_MIN_MATCH;
+        unsigned misses = 0;
+
+        while (ip <= matchLimit) {
+            uint32_t sequence = LzRead32(ip);
+            uint32_t slot = LzHash(sequence);
+            uint32_t candidate = table[slot];
+            table[slot] = (uint32_t)(ip - in);
+
+            if (candidate == UINT32_MAX || (size_t)(ip - in) - candidate > LZ_MAX_OFFSET ||
+                LzRead32(in + candidate) != sequence) {
+                ip += 1 + (misses++ >> LZ_SKIP_TRIGGER);
+                continue;
+            }
+            misses = 0;
+
+            // Extend forwards, then backwards over pending literals
+            const unsigned char* match = in + candidate;
+            const unsigned char* end = ip + LZ_MIN_MATCH;
+            const unsigned char* ref = match + LZ_MIN_MATCH;
+            while (end < inEnd && *end == *ref) { end++; ref++; }
+            while (ip > literals && match > in && ip[-1] == match[-1]) { ip--; match--; }
+
+            out = LzWriteSequence(out, outEnd, literals, (size_t)(ip - literals),
+                                  (size_t)(ip - match), (size_t)(end - ip));
+            if (!out) return 0;
+
+            // Seed the table inside the match so nearby repeats are found
+            if (end - 2 >= in && end - 2 <= matchLimit) {
+                table[LzHash(LzRead32(end - 2))] = (uint32_t)(end - 2 - in);
+            }
+            ip = end;
+            literals = end;
+        }
+    }
+
+    out = LzWriteSequence(out, outEnd, literals, (size_t)(inEnd - literals), 0, 0);
+    return out ? (size_t)(out - (unsigned char*)dst) : 0;
+}
+
+// Reads a length continuation; returns false if the input ends first
+static bool
+LzReadLength(const unsigned char** in, const unsigned char* inEnd, size_t* length)
+{
+    unsigned char byte;
+    do {
+        if (*in >= inEnd) return false;
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool
+LzDecompress(const void* src, size_t srcSize, void* dst, size_t dstSize)
+{
+    const unsigned char* in = src;
+    const unsigned char* inEnd = in + srcSize;
+    unsigned char* out = dst;
+    unsigned char* outStart = out;
+    unsigned char* outEnd = out + dstSize;
+
+    while (in < inEnd) {
+        unsigned token = *in++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !LzReadLength(&in, inEnd, &literalLength)) return false;
+        if ((size_t)(inEnd - in) < literalLength || (size_t)(outEnd - out) < literalLength) return false;
+        memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+
+        if (in == inEnd) break; // Final, literal-only sequence
+
+        if (inEnd - in < 2) return false;
+        size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !LzReadLength(&in, inEnd, &matchLength)) return false;
+        matchLength += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > (size_t)(out - outStart) || (size_t)(outEnd - out) < matchLength) {
+            return false;
+        }
+        const unsigned char* ref = out - offset;
+        if (offset >= matchLength) {
+            memcpy(out, ref, matchLength);
+            out += matchLength;
+        } else {
+            // Overlapping copy repeats the last 'offset' bytes
+            while (matchLength-- > 0) *out++ = *ref++;
+        }
+    }
+    return out == outEnd;
+}
@@ -0,0 +1,25 @@
+#ifndef MCLIP_LZ_H
+#define MCLIP_LZ_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// --- LZ Codec ---
+// Small byte-oriented LZ77 codec in the style of LZ4: greedy hash-chained
+// matching on compression, a tight copy loop on decompression (GB/s on text).
+// Stream: sequences of [token][literal length*][literals][offset:2][match length*],
+// token = literal length (high nibble) | match length - 4 (low nibble), a
+// nibble of 15 continues in 255-valued extra bytes. The last sequence has
+// literals only.
+
+// Worst-case compressed size of 'size' input bytes
+size_t LzCompressBound(size_t size);
+
+// Compresses into 'dst'. Returns the compressed size, or 0 if it would not fit in 'dstCapacity'.
+size_t LzCompress(const void* src, size_t srcSize, void* dst, size_t dstCapacity);
+
+// Decompresses exactly 'dstSize' bytes. Returns false on malformed or truncated
+// input; never reads or writes out of bounds.
+bool LzDecompress(const void* src, size_t srcSize, void* dst, size_t dstSize);
+
+#endif // MCLIP_LZ_H
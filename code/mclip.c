@@ -4,35 +4,113 @@
 
 #include <windows.h>
 #include <shellapi.h> // For system tray
-#include <shlwapi.h>  // For StrStrIW
+#include <shlobj.h>   // DROPFILES (copied files)
 #include <wchar.h>    // For wide char functions like _wcsdup, wcscpy_s
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>   // For setlocale (non-ASCII case folding in history search)
 #include "resource.h" // Assuming this contains your ICON IDs (IDI_MYICON_BIG, etc.)
+#include "history.h"  // Portable history engine
+#include "searchworker.h" // Searches the history off the UI thread
+#include "resultview.h" // Rows shown by the virtual listbox
+#include "historylog.h" // History saved across restarts
+#include "clipacquire.h" // When to retry a busy clipboard
+#include "clipingest.h"  // From clipboard read to stored entry
+#include "capture.h"     // Non-text formats kept with each entry
+#include "metrics.h"     // Latency histograms and counters (Help > Statistics)
+#include "snapshot.h"    // History published for other processes (tools/mclip_query.c)
+#include "historyversion.h" // ... from immutable copies of the history, read without its lock
+#include "exclude.h"     // Clipboard texts that are never stored (settings.ini [exclude])
 
 // --- Constants ---
-#define MAX_HISTORY 128       // TODO: Make this configurable
+#define DEFAULT_HISTORY_ENTRIES 128 // History limits until changed in the History menu ...
+#define DEFAULT_HISTORY_MB 256      // ... (0 = none), kept in settings.ini
+#define TRIGRAM_INDEX_MIN_HISTORY 4096 // Trigram search index pays off from this history size
 #define IDC_SEARCH_EDIT 1001
 #define IDC_LISTBOX 1002
+#define MAX_ENTRY_CHARS (1024 * 1024) // Longest entry kept in memory ...
+#define OVERSIZE_POLICY HISTORY_OVERSIZE_SPILL // ... longer ones go to the spill file (or are truncated / skipped)
+#define COMPRESS_MIN_BYTES (16 * 1024) // Entries at least this big are stored compressed
+#define COMPRESS_AFTER_ENTRIES 32      // Older entries are compressed once this many newer ones exist
 #define TIMER_ID_FLASH 1      // Timer for flashing background
 #define WM_TRAY_ICON (WM_APP + 1) // Message for tray icon events
+#define WM_SEARCH_RESULTS (WM_APP + 2) // Posted by the search worker when results are ready
 #define TRAY_ICON_ID 101      // ID for the tray icon itself
 #define HOTKEY_ID_TOGGLE 1    // ID for the Alt+; hotkey
 #define IDM_ABOUT 10001       // Menu item ID for About
-
-// --- NEW: Constants for Search Debouncing ---
-#define TIMER_ID_SEARCH_DEBOUNCE 2 // New Timer ID for search delay
-#define SEARCH_DEBOUNCE_MS 300     // Delay in milliseconds (adjust 200-500ms as needed)
-// --- End NEW ---
+#define IDM_STATS 10002       // Menu item ID for Statistics
+#define IDM_ENTRIES_FIRST 10100 // History menu: + index into g_entryPresets ...
+#define IDM_BUDGET_FIRST 10200  // ... and g_budgetPresetsMb
+#define IDM_MOST_USED 10300     // History menu: most used entries first
+
+// Search debouncing: the delay follows the cost of recent searches (SearchWorkerDebounceMs)
+#define TIMER_ID_SEARCH_DEBOUNCE 2
+
+// Saved history: new entries are written to disk in batches
+#define TIMER_ID_LOG_FLUSH 3
+#define LOG_FLUSH_DELAY_MS 2000    // Longest time a new entry waits before it is on disk
+#define LOG_DIR_NAME L"\\mclip"          // Under %LOCALAPPDATA%
+#define LOG_FILE_NAME L"\\history.log"
+#define SPILL_FILE_NAME L"\\oversized.tmp" // Entries over MAX_ENTRY_CHARS, this session only
+#define STATS_FILE_NAME L"\\stats.json"    // Statistics report, saved on request
+#define SETTINGS_FILE_NAME L"\\settings.ini" // History limits and order, exclusion rules
+#define EXCLUDE_SECTION_CHARS 32767 // Most GetPrivateProfileSectionW reads
+
+// Formats captured besides text, and put back on paste (see capture.h)
+#define CAPTURE_MAX_FORMAT_BYTES (64 * 1024 * 1024) // Larger payloads of a format are not kept
+#define IMAGE_LABEL_CHARS 96
+
+// Clipboard reads retried while another application holds the clipboard (see clipacquire.h)
+#define TIMER_ID_CLIPBOARD_RETRY 4
+
+// Shared memory snapshot of the history: republished shortly after it changes
+#define TIMER_ID_SNAPSHOT 5
+#define SNAPSHOT_DELAY_MS 200      // Batches bursts of copies into one publish
+#define ROW_CACHE_SLOTS 64         // Painted rows kept for repaints while a search holds the history
 
 // --- Global Variables ---
 HWND hwndList = NULL;
 HWND hwndEdit = NULL;
 HWND hMainWnd = NULL; // Store main window handle
 
-wchar_t* clipboardHistory[MAX_HISTORY] = {0}; // Store wide strings
-int currentHistoryIndex = 0; // Index for circular buffer
-size_t historyItemCount = 0; // Number of valid items currently in history
+History g_history = {0}; // Clipboard history store (see history.c)
+SearchWorker g_worker = {0}; // Runs searches on its own thread; guards g_history (see searchworker.h)
+ResultView g_results = {0}; // Rows of the listbox, which only holds their count
+typedef struct {
+    size_t row;                                 // Listbox row + 1; 0 = empty slot
+    size_t length;
+    wchar_t preview[HISTORY_PREVIEW_CHARS + 1];
+} RowCacheSlot;
+RowCacheSlot g_rowCache[ROW_CACHE_SLOTS]; // Last previews painted, by row; cleared with each new g_results
+HistoryLog g_log = {0}; // On-disk copy of the history (see historylog.c)
+ClipAcquire g_clipAcquire = {0}; // Retry schedule and counters of clipboard reads
+CaptureStore g_captures = {0}; // Files, images, HTML... captured with entries; UI thread only
+UINT g_captureFormats[CAPTURE_MAX_FORMATS]; // Which formats those are (InitCaptureFormats)
+size_t g_captureFormatCount = 0;
+Metrics g_metrics = {0}; // Stage latencies and counters recorded on the UI thread (the worker keeps its own)
+SnapshotWriter g_snapshot = {0}; // Published history (see snapshot.h); header is NULL if it could not be created
+bool g_snapshotScheduled = false; // TIMER_ID_SNAPSHOT is pending
+HistoryVersions g_versions = {0}; // Immutable copies of g_history that PublishSnapshot reads without its lock
+int g_versionReader = -1;         // PublishSnapshot's reader slot; -1 if versions (and the snapshot) are off
+uint64_t g_refreshId = 0;      // Latest search submitted by UpdateListBox ...
+uint64_t g_refreshStartNs = 0; // ... and when, for METRIC_LIST_REFRESH
+size_t g_historyEntries = DEFAULT_HISTORY_ENTRIES; // Entry limit of g_history ...
+size_t g_historyMb = DEFAULT_HISTORY_MB;           // ... and its budget in MB (0 = none)
+HistoryOrder g_historyOrder = HISTORY_ORDER_RECENT; // Order of the list, most recent or most used at the bottom
+bool g_nearDuplicates = false; // New entries replace their near-duplicates (see neardup.h); off unless set in settings.ini
+NearDupConfig g_nearDupConfig = { NEARDUP_DEFAULT_DISTANCE, NEARDUP_DEFAULT_MIN_WORDS, 0 };
+static const size_t g_entryPresets[] = { 128, 1000, 10000, 100000, 0 }; // History menu choices
+static const size_t g_budgetPresetsMb[] = { 16, 64, 256, 1024, 0 };
+ExcludeRules g_exclude = {0}; // Checked on the clipboard text before it is copied; UI thread only
+wchar_t g_clipSource[META_SOURCE_CHARS] = L""; // Process that owned the clipboard when it last changed ("" = unknown)
+// Exclusion rules when settings.ini has no [exclude] section: well-known access token prefixes and private keys
+static const wchar_t* const g_defaultExcludeRules[] = {
+    L"prefix=ghp_", L"prefix=gho_", L"prefix=ghs_", L"prefix=github_pat_", L"prefix=glpat-",
+    L"prefix=AKIA", L"prefix=xoxb-", L"prefix=xoxp-", L"prefix=sk_live_",
+    L"contains=PRIVATE KEY-----",
+};
 
 // System Tray
 NOTIFYICONDATAW nid = { sizeof(NOTIFYICONDATAW) }; // Use W version
@@ -57,16 +135,17 @@ HICON hIconTray = NULL;
 // --- Function Prototypes ---
 void DisplayLastError(const wchar_t *functionName);
 void ShowAboutDialog(HWND hwnd);
-bool EntryExistsW(const wchar_t *str1, const wchar_t *history[]);
+void ShowStatsDialog(HWND hwnd);
+static bool GetDataFilePath(const wchar_t* fileName, char* path);
 void UpdateListBox(HWND hwndListBox, const wchar_t* searchFilter);
-void AddClipboardEntry(HWND hwnd, LPCWSTR clipboardText);
+void AddClipboardEntry(HWND hwnd, const ClipContent* content, const wchar_t* label);
 void OnKeyDownHandler(HWND hwnd, WPARAM wParam);
 LRESULT CALLBACK EditSubclassProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
 LRESULT CALLBACK ListSubclassProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 bool InitializeResources(HINSTANCE hInstance, HWND hwnd);
 void CleanupResources();
-void SetClipboardText(HWND hwndOwner, const wchar_t* text);
+void SetClipboardText(HWND hwndOwner, const wchar_t* text, const CaptureRecord* formats);
 void ToggleWindowVisibility(HWND hwnd);
 
 
@@ -106,122 +185,432 @@ DisplayLastError(const wchar_t *functionName)
 void
 ShowAboutDialog(HWND hwnd)
 {
-    MessageBoxW(hwnd,
-               L"mclip - Clipboard History App\n\nAuthor: Ilija Tatalovic\nVersion: 0.5.1 (Debounced)\nLicence: MIT",
-               L"About mclip",
-               MB_OK | MB_ICONINFORMATION);
+    // Clipboard contention this session, for when copies seem slow to show up
+    const ClipAcquire* clip = &g_clipAcquire;
+    wchar_t text[512];
+    swprintf_s(text, _countof(text),
+               L"mclip - Clipboard History App\n\nAuthor: Ilija Tatalovic\nVersion: 0.5.1 (Debounced)\nLicence: MIT\n\n"
+               L"Clipboard reads: %llu, %llu found it busy (%llu retries)\nWait for a busy clipboard: %.1f ms average, %.1f ms longest",
+               clip->acquired, clip->contended, clip->busy,
+               clip->acquired ? clip->totalAcquireNs / 1e6 / clip->acquired : 0.0, clip->maxAcquireNs / 1e6);
+    MessageBoxW(hwnd, text, L"About mclip", MB_OK | MB_ICONINFORMATION);
+}
+
+// --- Statistics Dialog ---
+
+// Everything measured so far: the UI thread's metrics, the search worker's,
+// and counters the engine keeps anyway
+static void
+TakeMetricsSnapshot(Metrics* snapshot)
+{
+    *snapshot = g_metrics;
+    SearchWorkerMetrics(&g_worker, snapshot);
+    SearchWorkerLockHistory(&g_worker, false);
+    snapshot->counters[METRIC_EVICTIONS] = g_history.evictions;
+    snapshot->counters[METRIC_NEAR_DUPLICATES] = g_history.nearDuplicates;
+    SearchWorkerUnlockHistory(&g_worker, false);
+    snapshot->counters[METRIC_CLIPBOARD_RETRIES] = g_clipAcquire.busy;
+}
+
+// Shows the text report, and saves the JSON one to %LOCALAPPDATA%\mclip\stats.json if asked
+void
+ShowStatsDialog(HWND hwnd)
+{
+    static Metrics snapshot; // Too big to copy onto the stack each time
+    TakeMetricsSnapshot(&snapshot);
+    uint64_t now = PlatformNowNs();
+
+    char report[4096];
+    MetricsFormatText(&snapshot, now, report, sizeof(report));
+    wchar_t text[4096 + 512];
+    int length = MultiByteToWideChar(CP_UTF8, 0, report, -1, text, 4096);
+    if (length == 0) {
+        DisplayLastError(L"ShowStatsDialog MultiByteToWideChar");
+        return;
+    }
+    // What the history holds against its limits
+    HistoryStats stats;
+    SearchWorkerLockHistory(&g_worker, false);
+    HistoryGetStats(&g_history, &stats);
+    SearchWorkerUnlockHistory(&g_worker, false);
+    size_t versionBytes = g_versionReader >= 0 ? HistoryVersionsMemory(&g_versions) : 0; // UI thread: the writer
+    wchar_t memory[320];
+    swprintf_s(memory, _countof(memory),
+               L"\nHistory: %zu entries, %.1f MB (%.1f KB per entry), %zu evicted for memory, %zu re-copied, "
+               L"%zu near-duplicates replaced\nSnapshot copies: %.1f MB\n",
+               stats.entries, stats.entryBytes / 1048576.0,
+               stats.entries ? stats.entryBytes / 1024.0 / stats.entries : 0.0, stats.byteEvictions,
+               stats.promotions, stats.nearDuplicates, versionBytes / 1048576.0);
+    wcscat_s(text, _countof(text), memory);
+    wcscat_s(text, _countof(text), L"\nSave this report as JSON (mclip\\stats.json in %LOCALAPPDATA%)?");
+    if (MessageBoxW(hwnd, text, L"mclip Statistics", MB_YESNO | MB_ICONINFORMATION) != IDYES) return;
+
+    char path[MAX_PATH * 3];
+    if (!GetDataFilePath(STATS_FILE_NAME, path) || !MetricsSaveJson(&snapshot, now, path)) {
+        DisplayLastError(L"MetricsSaveJson");
+        MessageBoxW(hwnd, L"Failed to save the statistics report.", L"Error", MB_OK | MB_ICONERROR);
+    }
 }
 
 
 // --- History Management ---
+// Storage, duplicate detection and eviction live in history.c
 
-// Checks if an entry already exists (case-insensitive). Searches backwards for efficiency.
-bool
-EntryExistsW(const wchar_t *str1, const wchar_t *history[])
+// Tells the user once that saving stopped; the session carries on in memory
+static void
+ReportHistoryLogFailure(HWND hwnd)
 {
-    if (!str1 || wcslen(str1) == 0) return true; // Don't add empty strings implicitly
+    DisplayLastError(L"HistoryLogFlush");
+    MessageBoxW(hwnd, L"Failed to save clipboard history to disk.\nNew entries will not be saved until mclip is restarted.",
+                L"Error", MB_OK | MB_ICONERROR);
+}
 
-    int checkedCount = 0;
-    int idx = (currentHistoryIndex + MAX_HISTORY - 1) % MAX_HISTORY; // Start from last added item
+// Path of a file in %LOCALAPPDATA%\mclip, creating the directory if needed
+static bool
+GetDataFilePathW(const wchar_t* fileName, wchar_t pathW[MAX_PATH])
+{
+    DWORD length = GetEnvironmentVariableW(L"LOCALAPPDATA", pathW, MAX_PATH);
+    if (length == 0 || length + wcslen(LOG_DIR_NAME) + wcslen(fileName) >= MAX_PATH) return false;
 
-    while(checkedCount < historyItemCount) {
-         if (history[idx] != NULL) {
-            if (_wcsicmp(str1, history[idx]) == 0) { // Case-insensitive compare
-                return true;
-            }
-        }
-        idx = (idx + MAX_HISTORY - 1) % MAX_HISTORY; // Move backwards circularly
-        checkedCount++;
+    wcscat_s(pathW, MAX_PATH, LOG_DIR_NAME);
+    if (!CreateDirectoryW(pathW, NULL) && GetLastError() != ERROR_ALREADY_EXISTS) {
+        DisplayLastError(L"CreateDirectoryW");
+        return false;
     }
-    return false;
+    wcscat_s(pathW, MAX_PATH, fileName);
+    return true;
 }
 
+// UTF-8 path (as the engine takes them) of a file in %LOCALAPPDATA%\mclip,
+// creating the directory if needed. 'path' has room for MAX_PATH * 3 bytes.
+static bool
+GetDataFilePath(const wchar_t* fileName, char* path)
+{
+    wchar_t pathW[MAX_PATH];
+    if (!GetDataFilePathW(fileName, pathW)) return false;
 
-// Adds a new entry to the clipboard history (if it's new)
-void AddClipboardEntry(HWND hwnd, LPCWSTR clipboardText) {
-    if (clipboardText == NULL || wcslen(clipboardText) == 0) {
-        return; // Don't add empty strings
+    if (!WideCharToMultiByte(CP_UTF8, 0, pathW, -1, path, MAX_PATH * 3, NULL, NULL)) {
+        DisplayLastError(L"WideCharToMultiByte");
+        return false;
     }
+    return true;
+}
 
-    // Check if entry already exists
-    if (!EntryExistsW(clipboardText, (const wchar_t**)clipboardHistory)) {
-        // Free the oldest entry if the buffer is full
-        if (historyItemCount == MAX_HISTORY && clipboardHistory[currentHistoryIndex]) {
-            free(clipboardHistory[currentHistoryIndex]);
-            clipboardHistory[currentHistoryIndex] = NULL; // Avoid double free if _wcsdup fails
-        } else if (historyItemCount < MAX_HISTORY) {
-            // Only increment count if we are not overwriting
-            historyItemCount++;
-        }
+// Reads the history limits and order from settings.ini; defaults where it has none
+static void
+LoadHistoryLimits(void)
+{
+    wchar_t path[MAX_PATH];
+    if (!GetDataFilePathW(SETTINGS_FILE_NAME, path)) return;
+    g_historyEntries = GetPrivateProfileIntW(L"history", L"entries", DEFAULT_HISTORY_ENTRIES, path);
+    g_historyMb = GetPrivateProfileIntW(L"history", L"budget_mb", DEFAULT_HISTORY_MB, path);
+    g_historyOrder = GetPrivateProfileIntW(L"history", L"most_used_first", 0, path) ? HISTORY_ORDER_FREQUENT
+                                                                                    : HISTORY_ORDER_RECENT;
+    g_nearDuplicates = GetPrivateProfileIntW(L"history", L"near_duplicates", 0, path) != 0;
+    g_nearDupConfig.maxDistance = GetPrivateProfileIntW(L"history", L"near_duplicate_bits", NEARDUP_DEFAULT_DISTANCE, path);
+    g_nearDupConfig.minWords = GetPrivateProfileIntW(L"history", L"near_duplicate_min_words", NEARDUP_DEFAULT_MIN_WORDS, path);
+}
 
-        // Duplicate the string
-        clipboardHistory[currentHistoryIndex] = _wcsdup(clipboardText);
-        if (!clipboardHistory[currentHistoryIndex]) {
-            DisplayLastError(L"AddClipboardEntry _wcsdup");
-            // Decrement count if allocation failed and we were adding a new item
-             if (historyItemCount > 0 && historyItemCount <= MAX_HISTORY) {
-                  historyItemCount--;
-             }
-            MessageBoxW(hwnd, L"Failed to allocate memory for new clipboard entry.", L"Error", MB_OK | MB_ICONERROR);
-            return; // Stop processing this entry
+// Reads the exclusion rules, one per line of the [exclude] section of
+// settings.ini (see exclude.h); the defaults if there is no such section
+static void
+LoadExcludeRules(void)
+{
+    ExcludeRulesInit(&g_exclude);
+    wchar_t path[MAX_PATH];
+    wchar_t* section = malloc(EXCLUDE_SECTION_CHARS * sizeof(wchar_t));
+    DWORD length = section && GetDataFilePathW(SETTINGS_FILE_NAME, path)
+                       ? GetPrivateProfileSectionW(L"exclude", section, EXCLUDE_SECTION_CHARS, path)
+                       : 0;
+    size_t refused = 0;
+    if (length == 0) {
+        for (size_t i = 0; i < _countof(g_defaultExcludeRules); ++i) {
+            ExcludeRulesAddSetting(&g_exclude, g_defaultExcludeRules[i]);
+        }
+    } else {
+        // Double-NUL-terminated list of lines
+        for (const wchar_t* line = section; *line; line += wcslen(line) + 1) {
+            if (*line != L';' && !ExcludeRulesAddSetting(&g_exclude, line)) refused++;
         }
+    }
+    free(section);
+
+    wchar_t message[192];
+    if (!ExcludeRulesBuild(&g_exclude)) {
+        swprintf_s(message, _countof(message),
+                   L"The exclusion rules in settings.ini are too large.\nOnly max_chars and min_chars apply.");
+    } else if (refused > 0) {
+        swprintf_s(message, _countof(message),
+                   L"%zu exclusion rule(s) in settings.ini were not understood and are ignored.", refused);
+    } else {
+        return;
+    }
+    MessageBoxW(NULL, message, L"mclip", MB_OK | MB_ICONWARNING);
+}
+
+static void
+SaveHistoryLimits(void)
+{
+    wchar_t path[MAX_PATH];
+    wchar_t entries[32], budget[32];
+    swprintf_s(entries, _countof(entries), L"%zu", g_historyEntries);
+    swprintf_s(budget, _countof(budget), L"%zu", g_historyMb);
+    if (!GetDataFilePathW(SETTINGS_FILE_NAME, path) ||
+        !WritePrivateProfileStringW(L"history", L"entries", entries, path) ||
+        !WritePrivateProfileStringW(L"history", L"budget_mb", budget, path) ||
+        !WritePrivateProfileStringW(L"history", L"most_used_first",
+                                    g_historyOrder == HISTORY_ORDER_FREQUENT ? L"1" : L"0", path)) {
+        DisplayLastError(L"SaveHistoryLimits"); // Non-fatal, the limits apply for this session
+    }
+}
+
+// Applies g_historyEntries and g_historyMb to the history, evicting what no
+// longer fits, and builds or drops the trigram index to suit the new size.
+// Once the search worker runs, the caller holds the preempting history lock.
+static void
+ApplyHistoryLimits(void)
+{
+    size_t evicted = HistorySetLimits(&g_history, g_historyEntries, g_historyMb << 20);
+    if (evicted > 0) CaptureStorePrune(&g_captures, &g_history);
+
+    // Index costs about as much memory as the text itself; only worth it for big histories
+    bool indexed = g_historyEntries == 0 || g_historyEntries >= TRIGRAM_INDEX_MIN_HISTORY;
+    if (!HistoryEnableTrigramIndex(&g_history, indexed)) {
+        DisplayLastError(L"HistoryEnableTrigramIndex"); // Non-fatal, search falls back to scanning
+    }
+}
+
+// Republishes the history snapshot once the current burst of changes is over
+static void
+ScheduleSnapshot(HWND hwnd)
+{
+    if (!g_snapshot.header || g_snapshotScheduled) return;
+    if (SetTimer(hwnd, TIMER_ID_SNAPSHOT, SNAPSHOT_DELAY_MS, NULL)) g_snapshotScheduled = true;
+}
+
+// Publishes the history as it is now, in the order it is shown, to the
+// readers of g_versions. Call with the history locked, after every change.
+// Out of memory, readers keep the previous version.
+static void
+PublishHistoryVersion(void)
+{
+    if (g_versionReader < 0) return;
+    if (!HistoryVersionsPublish(&g_versions, &g_history, g_historyOrder)) {
+        DisplayLastError(L"HistoryVersionsPublish");
+    }
+}
+
+// Copies the list into the snapshot from the latest version, so it never
+// waits for a search to let go of the history. Texts go in until the
+// snapshot's budget is used up; the rest are listed without text.
+static void
+PublishSnapshot(void)
+{
+    if (g_versionReader < 0) return;
+    uint64_t start = PlatformNowNs();
+    const HistoryVersion* version = HistoryVersionsPin(&g_versions, g_versionReader);
+    if (version) HistoryVersionWriteSnapshot(version, &g_snapshot);
+    HistoryVersionsUnpin(&g_versions, g_versionReader);
+    MetricsRecord(&g_metrics, METRIC_SNAPSHOT_PUBLISH, PlatformNowNs() - start);
+}
+
+// Puts the marks of the History menu on the current limits and order
+static void
+CheckHistoryMenu(HMENU menu)
+{
+    CheckMenuItem(menu, IDM_MOST_USED,
+                  MF_BYCOMMAND | (g_historyOrder == HISTORY_ORDER_FREQUENT ? MF_CHECKED : MF_UNCHECKED));
+    for (UINT i = 0; i < _countof(g_entryPresets); ++i) {
+        CheckMenuItem(menu, IDM_ENTRIES_FIRST + i,
+                      MF_BYCOMMAND | (g_entryPresets[i] == g_historyEntries ? MF_CHECKED : MF_UNCHECKED));
+    }
+    for (UINT i = 0; i < _countof(g_budgetPresetsMb); ++i) {
+        CheckMenuItem(menu, IDM_BUDGET_FIRST + i,
+                      MF_BYCOMMAND | (g_budgetPresetsMb[i] == g_historyMb ? MF_CHECKED : MF_UNCHECKED));
+    }
+}
+
+// History menu: a new limit applies at once (the oldest entries go), so does
+// the order, and both are saved
+static bool
+OnHistoryMenu(HWND hwnd, WORD controlId)
+{
+    if (controlId == IDM_MOST_USED) {
+        g_historyOrder = g_historyOrder == HISTORY_ORDER_RECENT ? HISTORY_ORDER_FREQUENT : HISTORY_ORDER_RECENT;
+        SearchWorkerSetOrder(&g_worker, g_historyOrder);
+    } else if (controlId >= IDM_ENTRIES_FIRST && controlId < IDM_ENTRIES_FIRST + _countof(g_entryPresets)) {
+        g_historyEntries = g_entryPresets[controlId - IDM_ENTRIES_FIRST];
+    } else if (controlId >= IDM_BUDGET_FIRST && controlId < IDM_BUDGET_FIRST + _countof(g_budgetPresetsMb)) {
+        g_historyMb = g_budgetPresetsMb[controlId - IDM_BUDGET_FIRST];
+    } else {
+        return false;
+    }
+
+    SearchWorkerLockHistory(&g_worker, true);
+    if (controlId != IDM_MOST_USED) ApplyHistoryLimits();
+    PublishHistoryVersion(); // Entries evicted, or listed in the other order
+    SearchWorkerUnlockHistory(&g_worker, true);
+    SaveHistoryLimits();
+    CheckHistoryMenu(GetMenu(hwnd));
+    ScheduleSnapshot(hwnd);
+
+    wchar_t currentSearch[256] = {0};
+    if (hwndEdit) GetWindowTextW(hwndEdit, currentSearch, _countof(currentSearch));
+    UpdateListBox(hwndList, currentSearch);
+    return true;
+}
+
+// Opens %LOCALAPPDATA%\mclip\history.log and loads the saved history from it.
+// Not fatal: without the log mclip works as before, history just isn't kept.
+static void
+OpenHistoryLog(void)
+{
+    char path[MAX_PATH * 3];
+    if (!GetDataFilePath(LOG_FILE_NAME, path)) return;
+
+    HistoryLogResult result = HistoryLogOpen(&g_log, path, &g_history);
+    if (result == HISTORY_LOG_OK) return;
+
+    if (result == HISTORY_LOG_IO_ERROR) DisplayLastError(L"HistoryLogOpen");
+    MessageBoxW(NULL,
+                result == HISTORY_LOG_BAD_FORMAT
+                    ? L"The saved clipboard history was written by an incompatible version of mclip and was left untouched.\nHistory will not be saved this session."
+                    : L"Failed to open the saved clipboard history.\nHistory will not be saved this session.",
+                L"mclip", MB_OK | MB_ICONWARNING);
+}
+
+// Adds a new entry to the clipboard history (if it's new), with the other
+// formats that were copied; 'label' stands for content without text. Copying
+// an entry again moves it to the bottom of the list instead. A labelled entry
+// (files, images) isn't saved to disk: its formats are kept for the session
+// only. New entries and re-copies are queued for the on-disk log, and
+// TIMER_ID_LOG_FLUSH writes the batch.
+void AddClipboardEntry(HWND hwnd, const ClipContent* content, const wchar_t* label) {
+    uint64_t start = PlatformNowNs();
+    ClipSink sink = { &g_history, &g_captures, &g_log, &g_metrics };
+    bool flushScheduled = g_log.pendingBytes > 0;
+    bool logFailed = g_log.failed;
+
+    // Preempting: a search in progress stops and reruns after the change
+    SearchWorkerLockHistory(&g_worker, true);
+    HistoryAddResult result = ClipIngest(&sink, content, label); // Includes duplicate check
+    bool formatsLost = result == HISTORY_ADDED && content->payloadCount > 0 &&
+                       !CaptureStoreFind(&g_captures, HistoryGet(&g_history, 0)->seq);
+    if (result == HISTORY_ADDED || result == HISTORY_DUPLICATE) PublishHistoryVersion();
+    SearchWorkerUnlockHistory(&g_worker, true);
+    MetricsRecord(&g_metrics, METRIC_ADD_ENTRY, PlatformNowNs() - start);
+
+    if (formatsLost) DisplayLastError(L"AddClipboardEntry CaptureStoreAttach"); // Out of memory: text only
+    if (g_log.failed && !logFailed) {
+        ReportHistoryLogFailure(hwnd);
+    } else if (!flushScheduled && g_log.pendingBytes > 0) {
+        SetTimer(hwnd, TIMER_ID_LOG_FLUSH, LOG_FLUSH_DELAY_MS, NULL);
+    }
 
-        // Move to the next index (circularly)
-        currentHistoryIndex = (currentHistoryIndex + 1) % MAX_HISTORY;
+    if (result == HISTORY_TOO_LARGE) return; // Over MAX_ENTRY_CHARS with OVERSIZE_POLICY skipping it
 
-        // Update the list box only if the search filter is currently empty
-        // (avoids potentially slow updates when window is hidden but receiving clipboard events)
+    if (result == HISTORY_NO_MEMORY) {
+        DisplayLastError(L"AddClipboardEntry HistoryAdd");
+        MessageBoxW(hwnd, L"Failed to allocate memory for new clipboard entry.", L"Error", MB_OK | MB_ICONERROR);
+        return; // Stop processing this entry
+    }
+
+    if (result == HISTORY_ADDED || result == HISTORY_DUPLICATE) {
+        ScheduleSnapshot(hwnd);
+        // Rerun the current search; it happens on the worker, so this never blocks
         wchar_t currentSearch[256] = {0};
         if (hwndEdit) GetWindowTextW(hwndEdit, currentSearch, _countof(currentSearch));
-        // Only trigger full update if no search is active
-        if (currentSearch[0] == L'\0') {
-            UpdateListBox(hwndList, NULL);
-        }
-        // If a search *is* active, the next debounce timer execution will handle the update.
+        UpdateListBox(hwndList, currentSearch);
     }
 }
 
 // --- UI Update ---
 
-// Updates the listbox based on history and optional filter
+// Updates the listbox based on history and optional filter.
+// The search runs on the worker thread, which posts WM_SEARCH_RESULTS when
+// it is done (ShowSearchResults); a newer filter cancels an older search.
 void
 UpdateListBox(HWND hwndListBox, const wchar_t* searchFilter)
 {
     if (!hwndListBox) return;
 
-    SendMessageW(hwndListBox, WM_SETREDRAW, FALSE, 0); // Disable redrawing
-    SendMessageW(hwndListBox, LB_RESETCONTENT, 0, 0); // Clear the listbox
-
-    bool hasFilter = (searchFilter != NULL && searchFilter[0] != L'\0');
-
-    int addedCount = 0;
-    int historyIdx = (currentHistoryIndex + MAX_HISTORY - 1) % MAX_HISTORY; // Start from last added
-
-    // Iterate backwards through the valid history items
-    for (size_t i = 0; i < historyItemCount; ++i) {
-        if (clipboardHistory[historyIdx] != NULL) {
-            bool match = true;
-            if (hasFilter) {
-                // Case-insensitive search using StrStrIW
-                match = (StrStrIW(clipboardHistory[historyIdx], searchFilter) != NULL);
-            }
+    // Case-insensitive substring filter, fuzzy ranked matching when it starts
+    // with '~', or a regular expression when it starts with '/'. Refines the
+    // previous results when the filter was only extended (regexes rescan, from
+    // the worker's cache of compiled patterns).
+    // If memory runs out, the rows found so far are shown.
+    g_refreshId = SearchWorkerSubmit(&g_worker, searchFilter);
+    g_refreshStartNs = PlatformNowNs();
+}
 
-            if (match) {
-                // Insert strings at the top (index 0) to maintain newest-first order
-                SendMessageW(hwndListBox, LB_INSERTSTRING, 0, (LPARAM)clipboardHistory[historyIdx]);
-                addedCount++;
-            }
-        }
-        historyIdx = (historyIdx + MAX_HISTORY - 1) % MAX_HISTORY; // Move backwards circularly
-    }
+// Called on the worker thread: hands the results over to the UI thread
+static void
+NotifySearchResults(void* context)
+{
+    (void)context;
+    if (hMainWnd) PostMessageW(hMainWnd, WM_SEARCH_RESULTS, 0, 0);
+}
 
-    SendMessageW(hwndListBox, WM_SETREDRAW, TRUE, 0); // Enable redrawing
+// WM_SEARCH_RESULTS: shows the latest results.
+// The listbox is owner-data (LBS_NODATA): it only stores the row count and
+// asks for visible rows in WM_DRAWITEM, so an update costs the same no matter
+// how many entries match.
+static void
+ShowSearchResults(HWND hwndListBox)
+{
+    uint64_t requestId = 0;
+    if (!hwndListBox || !SearchWorkerTakeResults(&g_worker, &g_results, &requestId)) return;
+
+    // Rows now stand for other entries. Repainting also fills in rows left
+    // blank while the search held the history.
+    memset(g_rowCache, 0, sizeof(g_rowCache));
+    size_t rowCount = ResultViewCount(&g_results);
+    SendMessageW(hwndListBox, LB_SETCOUNT, (WPARAM)rowCount, 0);
     InvalidateRect(hwndListBox, NULL, TRUE); // Force repaint
 
      // Optionally, select the first item if any were added
-    if (addedCount > 0) {
+    if (rowCount > 0) {
          SendMessageW(hwndListBox, LB_SETCURSEL, 0, 0);
     }
+    if (requestId == g_refreshId) MetricsRecord(&g_metrics, METRIC_LIST_REFRESH, PlatformNowNs() - g_refreshStartNs);
+}
+
+// Paints one row of the owner-data listbox from the result view
+static void
+DrawListBoxRow(const DRAWITEMSTRUCT* dis)
+{
+    if (dis->itemID == (UINT)-1) { // Empty list with focus: only the focus rectangle
+        if (dis->itemState & ODS_FOCUS) DrawFocusRect(dis->hDC, &dis->rcItem);
+        return;
+    }
+
+    bool selected = (dis->itemState & ODS_SELECTED) != 0;
+    FillRect(dis->hDC, &dis->rcItem, GetSysColorBrush(selected ? COLOR_HIGHLIGHT : COLOR_WINDOW));
+
+    // The bounded single-line preview: rows cost the same whatever the size of the entry.
+    // Painting never waits out a search: while one holds the history, rows
+    // come from the cache of earlier paints, or stay blank until its results
+    // arrive and ShowSearchResults repaints.
+    RowCacheSlot* cached = &g_rowCache[dis->itemID % ROW_CACHE_SLOTS];
+    if (SearchWorkerTryLockHistory(&g_worker)) {
+        const HistoryEntry* entry = ResultViewGet(&g_results, &g_history, dis->itemID);
+        size_t previewLength = 0;
+        const wchar_t* preview = entry ? HistoryEntryPreview(&g_history, entry, &previewLength) : NULL;
+        cached->row = preview ? dis->itemID + 1 : 0;
+        cached->length = preview ? previewLength : 0;
+        if (preview) wmemcpy(cached->preview, preview, previewLength);
+        SearchWorkerUnlockHistory(&g_worker, false);
+    }
+    if (cached->row == dis->itemID + 1) {
+        RECT textRect = dis->rcItem;
+        textRect.left += 2;
+        SetBkMode(dis->hDC, TRANSPARENT);
+        SetTextColor(dis->hDC, GetSysColor(selected ? COLOR_HIGHLIGHTTEXT : COLOR_WINDOWTEXT));
+        DrawTextW(dis->hDC, cached->preview, (int)cached->length, &textRect,
+                  DT_SINGLELINE | DT_VCENTER | DT_NOPREFIX | DT_END_ELLIPSIS);
+    }
+
+    if (dis->itemState & ODS_FOCUS) DrawFocusRect(dis->hDC, &dis->rcItem);
 }
 
 // --- Resource Management ---
@@ -279,12 +668,18 @@ bool InitializeResources(HINSTANCE hInstance, HWND hwnd) {
 
 void CleanupResources() {
     // Free history strings
-    for (int i = 0; i < MAX_HISTORY; ++i) {
-        if (clipboardHistory[i]) {
-            free(clipboardHistory[i]);
-            clipboardHistory[i] = NULL;
-        }
+    SearchWorkerStop(&g_worker); // First: the worker reads the history
+    if (g_versionReader >= 0) {
+        HistoryVersionsUnregister(&g_versions, g_versionReader);
+        HistoryVersionsFree(&g_versions);
+        g_versionReader = -1;
     }
+    ResultViewFree(&g_results);
+    CaptureStoreFree(&g_captures);
+    ExcludeRulesFree(&g_exclude);
+    HistoryFree(&g_history);
+    HistoryLogClose(&g_log); // After HistoryFree: loaded entries point into the log's mapping
+    SnapshotWriterClose(&g_snapshot); // Readers see the segment go away
 
     // Destroy GDI Objects
     if (g_hBrushBackground) DeleteObject(g_hBrushBackground);
@@ -302,49 +697,288 @@ void CleanupResources() {
 }
 
 // --- Clipboard Interaction ---
-void SetClipboardText(HWND hwndOwner, const wchar_t* text) {
-    if (!text) return;
-    size_t textLen = wcslen(text);
-    if (textLen == 0) return;
 
-    if (!OpenClipboard(hwndOwner)) {
-        DisplayLastError(L"SetClipboardText OpenClipboard");
+// Formats kept besides CF_UNICODETEXT: files, images, HTML and RTF
+static void
+InitCaptureFormats(void)
+{
+    g_captureFormats[g_captureFormatCount++] = CF_HDROP;
+    g_captureFormats[g_captureFormatCount++] = CF_DIB; // Windows synthesizes CF_BITMAP and CF_DIBV5 from it
+    UINT html = RegisterClipboardFormatW(L"HTML Format");
+    UINT rtf = RegisterClipboardFormatW(L"Rich Text Format");
+    if (html) g_captureFormats[g_captureFormatCount++] = html;
+    if (rtf) g_captureFormats[g_captureFormatCount++] = rtf;
+}
+
+static bool
+IsCapturableFormatAvailable(void)
+{
+    if (IsClipboardFormatAvailable(CF_UNICODETEXT)) return true;
+    for (size_t i = 0; i < g_captureFormatCount; ++i) {
+        if (IsClipboardFormatAvailable(g_captureFormats[i])) return true;
+    }
+    return false;
+}
+
+// Copies one format of the open clipboard into the next payload, if present and not too big
+static void
+CopyClipboardFormat(UINT format, ClipContent* content)
+{
+    HANDLE hClipboardData = GetClipboardData(format);
+    if (hClipboardData == NULL) return;
+    SIZE_T size = GlobalSize(hClipboardData);
+    if (size == 0 || size > CAPTURE_MAX_FORMAT_BYTES) return;
+
+    const void* data = GlobalLock(hClipboardData);
+    if (data == NULL) {
+        DisplayLastError(L"CopyClipboardFormat GlobalLock");
         return;
     }
+    void* copy = malloc(size);
+    if (copy) {
+        memcpy(copy, data, size);
+        CapturePayload* payload = &content->payloads[content->payloadCount++];
+        payload->format = format;
+        payload->data = copy;
+        payload->size = size;
+    } else {
+        DisplayLastError(L"CopyClipboardFormat malloc");
+    }
+    GlobalUnlock(hClipboardData);
+}
 
-    if (!EmptyClipboard()) {
-         DisplayLastError(L"SetClipboardText EmptyClipboard");
-         CloseClipboard();
-         return;
+// Notes which process put the new content on the clipboard, in g_clipSource:
+// its image name without directory or ".exe". Taken as the change is
+// announced, before a retried read could see a later owner. Left unknown
+// without an owner window (some applications copy without one), for mclip's
+// own copies and if the process cannot be queried.
+static void
+NoteClipboardSource(void)
+{
+    g_clipSource[0] = L'\0';
+    HWND owner = GetClipboardOwner();
+    DWORD processId = 0;
+    if (!owner || !GetWindowThreadProcessId(owner, &processId) || processId == GetCurrentProcessId()) return;
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId);
+    if (!process) return;
+    wchar_t path[MAX_PATH];
+    DWORD length = MAX_PATH;
+    BOOL named = QueryFullProcessImageNameW(process, 0, path, &length);
+    CloseHandle(process);
+    if (!named) return;
+
+    const wchar_t* name = path;
+    for (const wchar_t* c = path; *c; ++c) {
+        if (*c == L'\\' || *c == L'/') name = c + 1;
+    }
+    size_t nameLength = wcslen(name);
+    if (nameLength > 4 && _wcsicmp(name + nameLength - 4, L".exe") == 0) nameLength -= 4;
+    if (nameLength > META_SOURCE_CHARS - 1) nameLength = META_SOURCE_CHARS - 1;
+    wmemcpy(g_clipSource, name, nameLength);
+    g_clipSource[nameLength] = L'\0';
+}
+
+// The Win32 ClipBackend ('context' is the window): copies the text and the
+// captured formats out, holding the clipboard only for the copies
+static ClipAttemptResult
+ReadClipboard(void* context, ClipContent* content)
+{
+    wcscpy_s(content->source, META_SOURCE_CHARS, g_clipSource);
+    if (!IsCapturableFormatAvailable()) return CLIP_ATTEMPT_ACQUIRED; // Nothing we keep
+    if (!OpenClipboard((HWND)context)) {
+        if (GetLastError() == ERROR_ACCESS_DENIED) return CLIP_ATTEMPT_BUSY; // Another application has it open
+        DisplayLastError(L"ReadClipboard OpenClipboard");
+        return CLIP_ATTEMPT_FAILED;
+    }
+
+    HANDLE hClipboardData = GetClipboardData(CF_UNICODETEXT);
+    if (hClipboardData != NULL) { // NULL might be okay if the format changed quickly
+        LPCWSTR clipboardText = (LPCWSTR)GlobalLock(hClipboardData);
+        if (clipboardText != NULL) {
+            // Checked where it lies: excluded text, and the formats copied
+            // with it, are never copied out
+            size_t length = wcsnlen(clipboardText, GlobalSize(hClipboardData) / sizeof(wchar_t));
+            if (ClipExcluded(&g_exclude, clipboardText, length, content)) {
+                GlobalUnlock(hClipboardData);
+                CloseClipboard();
+                return CLIP_ATTEMPT_ACQUIRED;
+            }
+            content->text = malloc((length + 1) * sizeof(wchar_t));
+            if (content->text) {
+                wmemcpy(content->text, clipboardText, length);
+                content->text[length] = L'\0';
+            } else {
+                DisplayLastError(L"ReadClipboard malloc");
+            }
+            GlobalUnlock(hClipboardData);
+        } else {
+            DisplayLastError(L"ReadClipboard GlobalLock");
+        }
+    }
+    for (size_t i = 0; i < g_captureFormatCount; ++i) {
+        if (IsClipboardFormatAvailable(g_captureFormats[i])) CopyClipboardFormat(g_captureFormats[i], content);
+    }
+    CloseClipboard();
+    return CLIP_ATTEMPT_ACQUIRED;
+}
+
+static const CapturePayload*
+FindPayload(const ClipContent* content, UINT format)
+{
+    for (size_t i = 0; i < content->payloadCount; ++i) {
+        if (content->payloads[i].format == format) return &content->payloads[i];
     }
+    return NULL;
+}
+
+// The copied files of a CF_HDROP payload, one path per line (malloc'd), or NULL
+static wchar_t*
+MakeFileListLabel(const CapturePayload* drop)
+{
+    DROPFILES header;
+    if (drop->size < sizeof(header)) return NULL;
+    memcpy(&header, drop->data, sizeof(header));
+    if (!header.fWide || header.pFiles >= drop->size) return NULL; // ANSI lists are long obsolete
+
+    const wchar_t* files = (const wchar_t*)((const char*)drop->data + header.pFiles);
+    size_t available = (drop->size - header.pFiles) / sizeof(wchar_t);
+    wchar_t* label = malloc((available + 1) * sizeof(wchar_t));
+    if (!label) return NULL;
+
+    // Double-NUL-terminated list: separators become line breaks
+    size_t used = 0;
+    for (size_t i = 0; i < available && files[i] != L'\0'; ++i) {
+        size_t length = wcsnlen(files + i, available - i);
+        if (used > 0) label[used++] = L'\n';
+        wmemcpy(label + used, files + i, length);
+        used += length;
+        i += length;
+    }
+    label[used] = L'\0';
+    if (used == 0) {
+        free(label);
+        return NULL;
+    }
+    return label;
+}
+
+// Text an entry without text is listed and searched by: the file list, or a
+// description of the image or formats. The hash tells different images of
+// the same size apart (entries are unique by text). Sets the class of
+// metadata the entry gets (see ClipIngest).
+static wchar_t*
+MakeFormatLabel(ClipContent* content)
+{
+    const CapturePayload* drop = FindPayload(content, CF_HDROP);
+    wchar_t* label = drop ? MakeFileListLabel(drop) : NULL;
+    content->labelClass = META_CLASS_FILES;
+    if (label || content->payloadCount == 0) return label;
+
+    label = malloc(IMAGE_LABEL_CHARS * sizeof(wchar_t));
+    if (!label) return NULL;
+    const CapturePayload* dib = FindPayload(content, CF_DIB);
+    const CapturePayload* first = dib ? dib : &content->payloads[0];
+    uint32_t tag = (uint32_t)BlobHash128(first->data, first->size).lo;
+    BITMAPINFOHEADER bitmap;
+    content->labelClass = dib ? META_CLASS_IMAGE : META_CLASS_FORMATS;
+    if (dib && dib->size >= sizeof(bitmap)) {
+        memcpy(&bitmap, dib->data, sizeof(bitmap));
+        swprintf_s(label, IMAGE_LABEL_CHARS, L"[Image %ld x %ld, %zu KB #%08x]",
+                   bitmap.biWidth, bitmap.biHeight < 0 ? -bitmap.biHeight : bitmap.biHeight,
+                   dib->size / 1024, tag);
+    } else {
+        swprintf_s(label, IMAGE_LABEL_CHARS, L"[Formatted content, %zu KB #%08x]", first->size / 1024, tag);
+    }
+    return label;
+}
+
+// Tells the user another application keeps the clipboard busy: flashes the
+// search box for a second and beeps. Reading carries on in the background.
+static void
+ShowClipboardContention(HWND hwnd)
+{
+    if (g_isFlashing) return; // Flash only if not already flashing
+    g_isFlashing = true;
+    InvalidateRect(hwndEdit, NULL, TRUE); // Redraw edit background
+    SetTimer(hwnd, TIMER_ID_FLASH, 1000, NULL); // Timer to stop flash
+    MessageBeep(MB_ICONWARNING); // Asynchronous, unlike Beep()
+}
 
-    // Allocate global memory for the text
+// One attempt at reading a changed clipboard (WM_CLIPBOARDUPDATE, then
+// TIMER_ID_CLIPBOARD_RETRY while it is busy). Never waits: a busy clipboard
+// schedules the next attempt instead.
+static void
+TryReadClipboard(HWND hwnd)
+{
+    KillTimer(hwnd, TIMER_ID_CLIPBOARD_RETRY);
+
+    ClipBackend clipboard = { ReadClipboard, hwnd };
+    ClipContent content;
+    UINT retryMs = ClipTryRead(&clipboard, &g_clipAcquire, &g_metrics, &content, PlatformNowNs());
+    if (retryMs > 0) SetTimer(hwnd, TIMER_ID_CLIPBOARD_RETRY, retryMs, NULL);
+    if (ClipAcquireTakeAlert(&g_clipAcquire)) ShowClipboardContention(hwnd);
+
+    // Processed with the clipboard closed again. Without text, the entry is
+    // listed under a label made from the other formats. Excluded content
+    // has neither, and is dropped.
+    wchar_t* label = content.text ? NULL : MakeFormatLabel(&content);
+    if (content.text || label) AddClipboardEntry(hwnd, &content, label);
+    free(label);
+    ClipContentFree(&content);
+}
+
+// Hands a copy of 'size' bytes to the open clipboard as 'format'
+static bool
+PutClipboardData(UINT format, const void* data, size_t size)
+{
     // Use GMEM_MOVEABLE as recommended for SetClipboardData
-    HGLOBAL hClipboardData = GlobalAlloc(GMEM_MOVEABLE, (textLen + 1) * sizeof(wchar_t));
+    HGLOBAL hClipboardData = GlobalAlloc(GMEM_MOVEABLE, size);
     if (hClipboardData == NULL) {
         DisplayLastError(L"SetClipboardText GlobalAlloc");
-        CloseClipboard();
-        return;
+        return false;
     }
 
-    // Lock the memory and copy the string
-    LPWSTR clipboardPtr = (LPWSTR)GlobalLock(hClipboardData);
+    void* clipboardPtr = GlobalLock(hClipboardData);
     if (clipboardPtr == NULL) {
         DisplayLastError(L"SetClipboardText GlobalLock");
         GlobalFree(hClipboardData); // Free if lock fails
-        CloseClipboard();
-        return;
+        return false;
     }
-
-    wcscpy_s(clipboardPtr, textLen + 1, text); // Safe copy
+    memcpy(clipboardPtr, data, size);
     GlobalUnlock(hClipboardData);
 
-    // Set the clipboard data
-    if (!SetClipboardData(CF_UNICODETEXT, hClipboardData)) {
+    if (!SetClipboardData(format, hClipboardData)) {
         DisplayLastError(L"SetClipboardText SetClipboardData");
         GlobalFree(hClipboardData); // MUST free if SetClipboardData fails
+        return false;
     }
     // If SetClipboardData succeeds, the system now owns hClipboardData.
+    return true;
+}
+
+// Puts an entry back on the clipboard: its text, unless that is only a label,
+// and every other format captured with it ('formats' may be NULL)
+void SetClipboardText(HWND hwndOwner, const wchar_t* text, const CaptureRecord* formats) {
+    bool withText = text && text[0] != L'\0' && !(formats && formats->textIsLabel);
+    if (!withText && !(formats && formats->count > 0)) return;
+
+    if (!OpenClipboard(hwndOwner)) {
+        DisplayLastError(L"SetClipboardText OpenClipboard");
+        return;
+    }
+
+    if (!EmptyClipboard()) {
+         DisplayLastError(L"SetClipboardText EmptyClipboard");
+         CloseClipboard();
+         return;
+    }
+
+    if (withText) PutClipboardData(CF_UNICODETEXT, text, (wcslen(text) + 1) * sizeof(wchar_t));
+    for (uint32_t i = 0; formats && i < formats->count; ++i) {
+        size_t size = 0;
+        const void* data = BlobStoreGet(&g_captures.blobs, formats->formats[i].blob, &size);
+        if (data) PutClipboardData(formats->formats[i].format, data, size);
+    }
 
     CloseClipboard();
 }
@@ -405,20 +1039,17 @@ void OnKeyDownHandler(HWND hwnd, WPARAM wParam)
 
         case VK_RETURN: // Enter key - copies selected item to clipboard
              if (focusedWnd == hwndList && selectedIndex != LB_ERR) {
-                 int itemLengthW = SendMessageW(hwndList, LB_GETTEXTLEN, selectedIndex, 0);
-                 if (itemLengthW != LB_ERR && itemLengthW > 0) {
-                     wchar_t *bufferW = malloc((itemLengthW + 1) * sizeof(wchar_t));
-                     if (bufferW) {
-                         SendMessageW(hwndList, LB_GETTEXT, selectedIndex, (LPARAM)bufferW);
-                         SetClipboardText(hwnd, bufferW); // Use helper function
-                         free(bufferW);
-                         // Optionally hide window after selection
-                         // ToggleWindowVisibility(hwnd);
-                     } else {
-                          DisplayLastError(L"OnKeyDownHandler malloc");
-                          MessageBoxW(hwnd, L"Failed to allocate memory to copy selection.", L"Error", MB_OK | MB_ICONERROR);
-                     }
+                 // The listbox holds no text; take it straight from the history,
+                 // cancelling a running search (retried after) rather than waiting it out
+                 SearchWorkerLockHistory(&g_worker, true);
+                 const HistoryEntry* entry = ResultViewGet(&g_results, &g_history, (size_t)selectedIndex);
+                 const wchar_t* text = entry ? HistoryEntryText(&g_history, entry) : NULL;
+                 if (text) {
+                     SetClipboardText(hwnd, text, CaptureStoreFind(&g_captures, entry->seq)); // Use helper function
+                     // Optionally hide window after selection
+                     // ToggleWindowVisibility(hwnd);
                  }
+                 SearchWorkerUnlockHistory(&g_worker, true);
              } else if (focusedWnd == hwndEdit) {
                   // Optional: If enter is pressed in edit box, maybe select first match in list?
                   if (itemCount > 0) {
@@ -517,12 +1148,31 @@ WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 
             // Create Menu Bar
             HMENU hMenu = CreateMenu();
+            HMENU hSubMenuHistory = CreatePopupMenu();
             HMENU hSubMenuHelp = CreatePopupMenu();
-            if (!hMenu || !hSubMenuHelp) {
+            if (!hMenu || !hSubMenuHistory || !hSubMenuHelp) {
                  DisplayLastError(L"CreateMenu/CreatePopupMenu");
                  return -1; // Fail creation
             }
+            for (UINT i = 0; i < _countof(g_entryPresets); ++i) {
+                wchar_t label[64];
+                if (g_entryPresets[i] == 0) wcscpy_s(label, _countof(label), L"Any number of entries");
+                else swprintf_s(label, _countof(label), L"Keep %zu entries", g_entryPresets[i]);
+                AppendMenuW(hSubMenuHistory, MF_STRING, IDM_ENTRIES_FIRST + i, label);
+            }
+            AppendMenuW(hSubMenuHistory, MF_SEPARATOR, 0, NULL);
+            for (UINT i = 0; i < _countof(g_budgetPresetsMb); ++i) {
+                wchar_t label[64];
+                if (g_budgetPresetsMb[i] == 0) wcscpy_s(label, _countof(label), L"No memory limit");
+                else swprintf_s(label, _countof(label), L"Use up to %zu MB", g_budgetPresetsMb[i]);
+                AppendMenuW(hSubMenuHistory, MF_STRING, IDM_BUDGET_FIRST + i, label);
+            }
+            AppendMenuW(hSubMenuHistory, MF_SEPARATOR, 0, NULL);
+            AppendMenuW(hSubMenuHistory, MF_STRING, IDM_MOST_USED, L"&Most used first");
+            CheckHistoryMenu(hSubMenuHistory);
+            AppendMenuW(hMenu, MF_POPUP, (UINT_PTR)hSubMenuHistory, L"Hi&story");
             // Use defined ID
+            AppendMenuW(hSubMenuHelp, MF_STRING, IDM_STATS, L"&Statistics");
             AppendMenuW(hSubMenuHelp, MF_STRING, IDM_ABOUT, L"&About"); // Use W version
             AppendMenuW(hMenu, MF_POPUP, (UINT_PTR)hSubMenuHelp, L"&Help"); // Use W version
             if (!SetMenu(hwnd, hMenu)) {
@@ -532,7 +1182,8 @@ WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 
             // Create ListBox (Use W version of class name)
             hwndList = CreateWindowW(L"LISTBOX", NULL,
-                                     WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL | LBS_NOTIFY | LBS_HASSTRINGS, // Added LBS_HASSTRINGS
+                                     WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL | LBS_NOTIFY |
+                                     LBS_OWNERDRAWFIXED | LBS_NODATA, // Virtual list, rows drawn from g_results
                                      10, 10, 360, 210, // Adjusted height slightly
                                      hwnd, (HMENU)IDC_LISTBOX, hInstance, NULL);
             if (!hwndList) {
@@ -566,6 +1217,7 @@ WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 
               // Add initial items to listbox
               UpdateListBox(hwndList, NULL);
+              ScheduleSnapshot(hwnd); // Publishes the history loaded from the log
 
               // Set initial focus
               SetFocus(hwndEdit);
@@ -579,6 +1231,33 @@ WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         }
         break; // End WM_CREATE
 
+        case WM_MEASUREITEM: // Row height of the owner-drawn listbox (sent while it is created)
+        {
+            LPMEASUREITEMSTRUCT mis = (LPMEASUREITEMSTRUCT)lParam;
+            if (mis->CtlID != IDC_LISTBOX) break;
+            HDC hdc = GetDC(hwnd);
+            if (hdc) {
+                TEXTMETRICW tm;
+                HGDIOBJ oldFont = SelectObject(hdc, GetStockObject(DEFAULT_GUI_FONT));
+                if (GetTextMetricsW(hdc, &tm)) mis->itemHeight = tm.tmHeight + tm.tmExternalLeading;
+                SelectObject(hdc, oldFont);
+                ReleaseDC(hwnd, hdc);
+            }
+            return TRUE;
+        }
+
+        case WM_SEARCH_RESULTS:
+            ShowSearchResults(hwndList);
+            break;
+
+        case WM_DRAWITEM:
+        {
+            LPDRAWITEMSTRUCT dis = (LPDRAWITEMSTRUCT)lParam;
+            if (dis->CtlID != IDC_LISTBOX) break;
+            DrawListBoxRow(dis);
+            return TRUE;
+        }
+
         case WM_TIMER:
             if (wParam == TIMER_ID_FLASH) {
                 KillTimer(hwnd, TIMER_ID_FLASH); // Stop the timer
@@ -601,6 +1280,27 @@ WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
                 }
             }
             // --- End NEW ---
+            else if (wParam == TIMER_ID_CLIPBOARD_RETRY) {
+                TryReadClipboard(hwnd);
+            }
+            else if (wParam == TIMER_ID_SNAPSHOT) {
+                KillTimer(hwnd, TIMER_ID_SNAPSHOT);
+                g_snapshotScheduled = false;
+                PublishSnapshot();
+            }
+            else if (wParam == TIMER_ID_LOG_FLUSH) {
+                KillTimer(hwnd, TIMER_ID_LOG_FLUSH);
+                if (HistoryLogIsOpen(&g_log) && !g_log.failed) {
+                    uint64_t start = PlatformNowNs();
+                    bool flushed = HistoryLogFlush(&g_log);
+                    MetricsRecord(&g_metrics, METRIC_LOG_FLUSH, PlatformNowNs() - start);
+                    if (!flushed) ReportHistoryLogFailure(hwnd);
+                }
+            }
+            break;
+
+        case WM_ENDSESSION: // Logoff/shutdown may end the process without WM_DESTROY
+            if (wParam && HistoryLogIsOpen(&g_log)) HistoryLogFlush(&g_log);
             break;
 
         case WM_KEYDOWN:
@@ -675,66 +1375,9 @@ WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 
 
         case WM_CLIPBOARDUPDATE:
-            // Check format availability and attempt to open clipboard
-             if (IsClipboardFormatAvailable(CF_UNICODETEXT)) {
-                 int retryCount = 0;
-                 const int maxRetries = 5;
-                 const int retryDelayMs = 50;
-
-                 while (retryCount < maxRetries) {
-                     if (OpenClipboard(hwnd)) {
-                         HANDLE hClipboardData = GetClipboardData(CF_UNICODETEXT);
-                         if (hClipboardData != NULL) {
-                              LPCWSTR clipboardText = (LPCWSTR)GlobalLock(hClipboardData);
-                              if (clipboardText != NULL) {
-                                  // Process and add the entry (includes duplicate check)
-                                  AddClipboardEntry(hwnd, clipboardText);
-                                  GlobalUnlock(hClipboardData);
-                              } else {
-                                  DisplayLastError(L"WM_CLIPBOARDUPDATE GlobalLock");
-                              }
-                         } else {
-                              // GetClipboardData returning NULL might be okay if format changed quickly
-                              // DisplayLastError(L"WM_CLIPBOARDUPDATE GetClipboardData");
-                         }
-                         CloseClipboard();
-                         break; // Success, exit retry loop
-                     } else {
-                         // Failed to open clipboard
-                          DWORD errorCode = GetLastError();
-                         if (errorCode == ERROR_ACCESS_DENIED) {
-                              retryCount++;
-                              if (retryCount < maxRetries) {
-                                  Sleep(retryDelayMs); // Wait before retrying
-                              } else {
-                                  // Max retries reached - indicate error visually
-                                  if (!g_isFlashing) { // Flash only if not already flashing
-                                       g_isFlashing = true;
-                                       InvalidateRect(hwndEdit, NULL, TRUE); // Redraw edit background
-                                       // Optional: Flash main window background too
-                                       // InvalidateRect(hwnd, NULL, TRUE);
-                                       SetTimer(hwnd, TIMER_ID_FLASH, 1000, NULL); // Timer to stop flash
-
-                                       // Optional: Flash taskbar icon (can be annoying)
-                                       // FLASHWINFO flashInfo = { sizeof(FLASHWINFO) };
-                                       // flashInfo.hwnd = hwnd;
-                                       // flashInfo.dwFlags = FLASHW_ALL | FLASHW_TIMERNOFG;
-                                       // flashInfo.uCount = 3;
-                                       // flashInfo.dwTimeout = 0;
-                                       // FlashWindowEx(&flashInfo);
-
-                                       // Play sound
-                                       Beep(750, 300);
-                                  }
-                             }
-                         } else {
-                              // Different error opening clipboard
-                              DisplayLastError(L"WM_CLIPBOARDUPDATE OpenClipboard");
-                              break; // Don't retry on unexpected errors
-                         }
-                     }
-                 } // End retry loop
-             }
+            NoteClipboardSource();
+            ClipAcquireNotify(&g_clipAcquire, PlatformNowNs());
+            TryReadClipboard(hwnd);
             break; // End WM_CLIPBOARDUPDATE
 
         case WM_COMMAND:
@@ -748,14 +1391,27 @@ WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
                         ShowAboutDialog(hwnd);
                         break;
 
+                    case IDM_STATS:
+                        ShowStatsDialog(hwnd);
+                        break;
+
+                    default:
+                        OnHistoryMenu(hwnd, controlId); // History limits
+                        break;
+
                     case IDC_SEARCH_EDIT:
                         if (notificationCode == EN_CHANGE) {
-                            // --- MODIFIED: Trigger Debounce Timer ---
                             // Kill any existing debounce timer to reset the delay
                             KillTimer(hwnd, TIMER_ID_SEARCH_DEBOUNCE);
-                            // Set a new timer to trigger the search update after a pause
-                            SetTimer(hwnd, TIMER_ID_SEARCH_DEBOUNCE, SEARCH_DEBOUNCE_MS, NULL);
-                            // --- End MODIFIED ---
+                            // Cheap searches run on every keystroke; slow ones wait for a pause
+                            UINT delay = SearchWorkerDebounceMs(&g_worker);
+                            if (delay == 0) {
+                                wchar_t searchText[256] = {0};
+                                GetWindowTextW(hwndEdit, searchText, _countof(searchText));
+                                UpdateListBox(hwndList, searchText);
+                            } else {
+                                SetTimer(hwnd, TIMER_ID_SEARCH_DEBOUNCE, delay, NULL);
+                            }
                         }
                         break;
 
@@ -810,6 +1466,59 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
     // AllocConsole();
     // FreeConsole(); // Use if you allocated it
 
+    // Use the user locale so history search folds non-ASCII case too
+    setlocale(LC_CTYPE, "");
+
+    // --- History Store ---
+    if (!HistoryInit(&g_history, DEFAULT_HISTORY_ENTRIES)) {
+        MessageBoxW(NULL, L"Failed to allocate clipboard history!", L"Error!", MB_ICONEXCLAMATION | MB_OK);
+        return 0;
+    }
+    HistorySetCompression(&g_history, COMPRESS_MIN_BYTES, COMPRESS_AFTER_ENTRIES);
+    HistorySetSizeLimit(&g_history, MAX_ENTRY_CHARS, OVERSIZE_POLICY);
+    char spillPath[MAX_PATH * 3];
+    if (OVERSIZE_POLICY == HISTORY_OVERSIZE_SPILL &&
+        (!GetDataFilePath(SPILL_FILE_NAME, spillPath) || !HistoryOpenSpill(&g_history, spillPath))) {
+        DisplayLastError(L"HistoryOpenSpill"); // Non-fatal, oversized entries are truncated instead
+    }
+    MetricsInit(&g_metrics, PlatformNowNs());
+    ResultViewInit(&g_results);
+    ClipAcquireInit(&g_clipAcquire, GetCurrentProcessId()); // Jitter differs from other mclip instances
+    if (!CaptureStoreInit(&g_captures)) {
+        MessageBoxW(NULL, L"Failed to allocate clipboard history!", L"Error!", MB_ICONEXCLAMATION | MB_OK);
+        return 0;
+    }
+    InitCaptureFormats();
+    LoadHistoryLimits();
+    LoadExcludeRules();
+    ApplyHistoryLimits();
+    // Before the log is loaded, so that its near-duplicates are replaced as when they were copied
+    if (g_nearDuplicates && !HistoryEnableNearDuplicates(&g_history, &g_nearDupConfig)) {
+        DisplayLastError(L"HistoryEnableNearDuplicates"); // Non-fatal, only exact duplicates are caught
+    }
+    OpenHistoryLog(); // Loads the history saved by the previous run, within those limits
+
+    // From here on the history is shared with the search thread
+    if (!SearchWorkerStart(&g_worker, &g_history, NotifySearchResults, NULL)) {
+        DisplayLastError(L"SearchWorkerStart");
+        MessageBoxW(NULL, L"Failed to start the search thread!", L"Error!", MB_ICONEXCLAMATION | MB_OK);
+        return 0;
+    }
+    SearchWorkerSetOrder(&g_worker, g_historyOrder);
+    // Not fatal: only tools reading the history (mclip_query) go without it
+    if (!SnapshotWriterOpen(&g_snapshot, SNAPSHOT_DEFAULT_NAME, SNAPSHOT_DEFAULT_BYTES)) {
+        DisplayLastError(L"SnapshotWriterOpen");
+    } else if (!HistoryVersionsInit(&g_versions)) { // The snapshot is written from them
+        DisplayLastError(L"HistoryVersionsInit");
+        SnapshotWriterClose(&g_snapshot);
+    } else {
+        g_versions.textBudget = SNAPSHOT_DEFAULT_BYTES; // About what a snapshot buffer holds; the rest go without text
+        g_versionReader = HistoryVersionsRegister(&g_versions);
+        SearchWorkerLockHistory(&g_worker, true);
+        PublishHistoryVersion(); // The history loaded from the log
+        SearchWorkerUnlockHistory(&g_worker, true);
+    }
+
     // --- Standard Window Class Registration ---
     const wchar_t CLASS_NAME[] = L"mclipWindowClass";
     WNDCLASSW wc = {0}; // Use W version
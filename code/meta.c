@@ -0,0 +1,558 @@
+#include "meta.h"
+#include "platform.h"
+#include "textmatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static const wchar_t* const g_classNames[META_CLASS_COUNT] = {
+    L"text", L"code", L"url", L"path", L"email", L"number", L"image", L"files", L"formats"
+};
+
+static unsigned
+MetaPopCount(uint64_t value)
+{
+#if defined(_MSC_VER)
+    return (unsigned)__popcnt64(value);
+#else
+    return (unsigned)__builtin_popcountll(value);
+#endif
+}
+
+static inline bool
+MetaIsSpace(wchar_t c)
+{
+    return c == L' ' || (c >= L'\t' && c <= L'\r') || c == 0xA0 || c == 0x3000;
+}
+
+static inline bool
+MetaIsDigit(wchar_t c)
+{
+    return c >= L'0' && c <= L'9';
+}
+
+// 'c' is one of the characters of 'set' (never the terminator)
+static inline bool
+MetaIsOneOf(wchar_t c, const wchar_t* set)
+{
+    return c != L'\0' && wcschr(set, c) != NULL;
+}
+
+static inline bool
+MetaIsAsciiLetter(wchar_t c)
+{
+    return (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z');
+}
+
+// --- Columns ---
+
+bool
+MetaColumnsInit(MetaColumns* columns, size_t capacity)
+{
+    size_t slots = capacity ? capacity : 1;
+    columns->times = calloc(slots, sizeof(uint32_t));
+    columns->sources = calloc(slots, sizeof(uint16_t));
+    columns->bytes = calloc(slots, sizeof(uint32_t));
+    columns->classes = calloc(slots, sizeof(uint8_t));
+    columns->capacity = capacity;
+    if (columns->times && columns->sources && columns->bytes && columns->classes) return true;
+    MetaColumnsFree(columns);
+    return false;
+}
+
+void
+MetaColumnsFree(MetaColumns* columns)
+{
+    free(columns->times);
+    free(columns->sources);
+    free(columns->bytes);
+    free(columns->classes);
+    memset(columns, 0, sizeof(*columns));
+}
+
+void
+MetaColumnsCopy(MetaColumns* to, size_t toSlot, const MetaColumns* from, size_t fromSlot)
+{
+    to->times[toSlot] = from->times[fromSlot];
+    to->sources[toSlot] = from->sources[fromSlot];
+    to->bytes[toSlot] = from->bytes[fromSlot];
+    to->classes[toSlot] = from->classes[fromSlot];
+}
+
+size_t
+MetaColumnsMemory(const MetaColumns* columns)
+{
+    return columns->capacity * (2 * sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint8_t));
+}
+
+// --- Sources ---
+
+void
+MetaSourcesInit(MetaSources* sources)
+{
+    memset(sources, 0, sizeof(*sources));
+}
+
+void
+MetaSourcesFree(MetaSources* sources)
+{
+    free(sources->names);
+    HashIndexFree(&sources->index);
+    memset(sources, 0, sizeof(*sources));
+}
+
+uint16_t
+MetaSourcesIntern(MetaSources* sources, const wchar_t* name)
+{
+    if (!name || name[0] == L'\0') return 0;
+    size_t length = wcslen(name);
+    if (length > META_SOURCE_CHARS - 1) length = META_SOURCE_CHARS - 1;
+    uint32_t hash = TextHashNoCase(name, length);
+
+    HashIndexIter iter;
+    uint32_t id;
+    HashIndexFind(&sources->index, hash, &iter);
+    while (sources->count > 0 && HashIndexNext(&iter, &id)) {
+        const wchar_t* known = sources->names[id];
+        if (wcsncmp(known, name, length) == 0 && known[length] == L'\0') return (uint16_t)id;
+    }
+    if (sources->count >= META_MAX_SOURCES) return 0;
+
+    if (sources->count + 1 > sources->capacity) {
+        size_t capacity = sources->capacity ? sources->capacity * 2 : 16;
+        if (capacity > META_MAX_SOURCES) capacity = META_MAX_SOURCES;
+        wchar_t (*names)[META_SOURCE_CHARS] = realloc(sources->names, capacity * sizeof(*names));
+        if (!names) return 0;
+        sources->names = names;
+        sources->capacity = capacity;
+    }
+    if (sources->count == 0) {
+        if (!HashIndexInit(&sources->index, 16)) return 0;
+        sources->names[0][0] = L'\0';
+        sources->count = 1;
+    }
+    id = (uint32_t)sources->count;
+    if (!HashIndexInsert(&sources->index, hash, id)) return 0;
+    wmemcpy(sources->names[id], name, length);
+    sources->names[id][length] = L'\0';
+    sources->count++;
+    return (uint16_t)id;
+}
+
+const wchar_t*
+MetaSourceName(const MetaSources* sources, uint16_t id)
+{
+    return id < sources->count ? sources->names[id] : L"";
+}
+
+size_t
+MetaSourcesMemory(const MetaSources* sources)
+{
+    return sources->capacity * sizeof(*sources->names) + HashIndexMemory(&sources->index);
+}
+
+// --- Classes ---
+
+// "scheme://" (letters, then letters, digits, '+', '-' or '.') or "www."
+static bool
+MetaHasUrlScheme(const wchar_t* text, size_t length)
+{
+    if (length > 4 && TextEqualsNoCase(text, 4, L"www.", 4)) return true;
+    size_t i = 0;
+    while (i < length && i < 32 &&
+           (MetaIsAsciiLetter(text[i]) || (i > 0 && (MetaIsDigit(text[i]) || MetaIsOneOf(text[i], L"+-."))))) {
+        i++;
+    }
+    return i > 0 && i + 3 < length && text[i] == L':' && text[i + 1] == L'/' && text[i + 2] == L'/';
+}
+
+// One '@' with something before it, and a '.' in what follows
+static bool
+MetaIsEmail(const wchar_t* text, size_t length)
+{
+    const wchar_t* at = wmemchr(text, L'@', length);
+    if (!at || at == text || wmemchr(at + 1, L'@', length - (size_t)(at + 1 - text))) return false;
+    size_t domain = length - (size_t)(at + 1 - text);
+    const wchar_t* dot = domain > 2 ? wmemchr(at + 2, L'.', domain - 1) : NULL;
+    return dot && dot + 1 < text + length && !wmemchr(text, L'/', length) && !wmemchr(text, L':', length);
+}
+
+// Starts like an absolute or relative path: C:\, C:/, \\server, /usr, ~/, ./ or ../
+static bool
+MetaStartsLikePath(const wchar_t* text, size_t length)
+{
+    if (length >= 3 && MetaIsAsciiLetter(text[0]) && text[1] == L':' && (text[2] == L'\\' || text[2] == L'/')) {
+        return true;
+    }
+    if (length >= 3 && text[0] == L'\\' && text[1] == L'\\' && !MetaIsSpace(text[2])) return true;
+    if (length >= 2 && text[0] == L'/') return MetaIsAsciiLetter(text[1]) || text[1] == L'.' || text[1] == L'_';
+    if (length >= 3 && (text[0] == L'~' || text[0] == L'.') && text[1] == L'/') return true;
+    return length >= 4 && text[0] == L'.' && text[1] == L'.' && text[2] == L'/';
+}
+
+MetaClass
+MetaClassify(const wchar_t* text, size_t length)
+{
+    size_t start = 0, end = length;
+    while (start < end && MetaIsSpace(text[start])) start++;
+    while (end > start && MetaIsSpace(text[end - 1])) end--;
+    if (start == end) return META_CLASS_TEXT;
+    const wchar_t* trimmed = text + start;
+    size_t trimmedLength = end - start;
+    size_t scanned = trimmedLength < META_CLASSIFY_CHARS ? trimmedLength : META_CLASSIFY_CHARS;
+
+    size_t lines = 1, spaces = 0, digits = 0, letters = 0, symbols = 0;
+    bool numeric = true;   // Digits and what numbers, dates and phone numbers are written with
+    for (size_t i = 0; i < scanned; ++i) {
+        wchar_t c = trimmed[i];
+        if (c == L'\n') lines++;
+        if (MetaIsSpace(c)) {
+            spaces++;
+        } else if (MetaIsDigit(c)) {
+            digits++;
+        } else {
+            if (MetaIsAsciiLetter(c) || c >= 0x80) letters++;
+            if (MetaIsOneOf(c, L"{}()[];=<>")) symbols++;
+            if (!MetaIsOneOf(c, L"+-.,:/%$#()")) numeric = false;
+        }
+    }
+
+    if (spaces == 0 && MetaHasUrlScheme(trimmed, trimmedLength)) return META_CLASS_URL;
+    if (spaces == 0 && trimmedLength < 256 && MetaIsEmail(trimmed, trimmedLength)) return META_CLASS_EMAIL;
+    if (lines == 1 && MetaStartsLikePath(trimmed, trimmedLength)) return META_CLASS_PATH;
+    if (numeric && digits > 0 && trimmedLength <= 64) return META_CLASS_NUMBER;
+
+    // Brackets, semicolons and operators at a few percent of the letters:
+    // several lines of them, or a statement ending in one
+    wchar_t last = trimmed[trimmedLength - 1];
+    bool statement = last == L';' || last == L'{' || last == L'}' || last == L')';
+    if (symbols >= 2 && symbols * 25 >= letters + digits && (lines > 1 || statement)) return META_CLASS_CODE;
+    return META_CLASS_TEXT;
+}
+
+const wchar_t*
+MetaClassName(MetaClass metaClass)
+{
+    return metaClass < META_CLASS_COUNT ? g_classNames[metaClass] : L"";
+}
+
+// --- Query Parsing ---
+
+void
+MetaQueryInit(MetaQuery* query)
+{
+    memset(query, 0, sizeof(*query));
+    query->before = UINT32_MAX;
+    query->maxBytes = UINT32_MAX;
+}
+
+// Decimal number at text[*i], moving *i past it. False if there is none.
+// Values past 2^40 are clamped there: larger than any time or size.
+static bool
+MetaParseNumber(const wchar_t* text, size_t length, size_t* i, uint64_t* value)
+{
+    size_t start = *i;
+    *value = 0;
+    for (; *i < length && MetaIsDigit(text[*i]); ++*i) {
+        *value = *value * 10 + (uint64_t)(text[*i] - L'0');
+        if (*value > (1ull << 40)) *value = 1ull << 40;
+    }
+    return *i > start;
+}
+
+// Two-digit-at-most field that must be followed by 'separator' (or end the text if 0)
+static bool
+MetaParseField(const wchar_t* text, size_t length, size_t* i, uint64_t* value, wchar_t separator)
+{
+    size_t start = *i;
+    if (!MetaParseNumber(text, length, i, value) || *i - start > 2) return false;
+    if (separator == 0) return *i == length;
+    if (*i >= length || text[*i] != separator) return false;
+    ++*i;
+    return true;
+}
+
+// WHEN of after: and before: (see meta.h) as Unix time
+static bool
+MetaParseTime(const wchar_t* text, size_t length, int64_t now, int64_t* time)
+{
+    static const struct { wchar_t unit; int64_t seconds; } ages[] = {
+        { L's', 1 }, { L'm', 60 }, { L'h', 3600 }, { L'd', 86400 }, { L'w', 604800 }
+    };
+    size_t i = 0;
+    uint64_t first;
+    if (!MetaParseNumber(text, length, &i, &first)) return false;
+    if (i + 1 == length) {
+        for (size_t u = 0; u < sizeof(ages) / sizeof(ages[0]); ++u) {
+            if (TextFoldChar(text[i]) != ages[u].unit) continue;
+            *time = now - (int64_t)first * ages[u].seconds;
+            return true;
+        }
+        return false;
+    }
+
+    struct tm local;
+    if (!PlatformLocalTime(now, &local)) return false;
+    uint64_t hour = 0, minute = 0;
+    if (i <= 2 && i < length && text[i] == L':') {
+        // HH:MM today
+        hour = first;
+        ++i;
+        if (!MetaParseField(text, length, &i, &minute, 0)) return false;
+    } else if (i == 4 && i < length && text[i] == L'-') {
+        // YYYY-MM-DD, optionally THH:MM
+        uint64_t month, day;
+        ++i;
+        if (!MetaParseField(text, length, &i, &month, L'-')) return false;
+        size_t dayStart = i;
+        if (!MetaParseNumber(text, length, &i, &day) || i - dayStart > 2) return false;
+        if (i < length) {
+            if (TextFoldChar(text[i]) != L't') return false;
+            ++i;
+            if (!MetaParseField(text, length, &i, &hour, L':') ||
+                !MetaParseField(text, length, &i, &minute, 0)) {
+                return false;
+            }
+        }
+        if (first < 1970 || month < 1 || month > 12 || day < 1 || day > 31) return false;
+        local.tm_year = (int)first - 1900;
+        local.tm_mon = (int)month - 1;
+        local.tm_mday = (int)day;
+    } else {
+        return false;
+    }
+    if (hour > 23 || minute > 59) return false;
+    local.tm_hour = (int)hour;
+    local.tm_min = (int)minute;
+    local.tm_sec = 0;
+    local.tm_isdst = -1;
+    time_t result = mktime(&local);
+    if (result == (time_t)-1) return false;
+    *time = (int64_t)result;
+    return true;
+}
+
+static uint32_t
+MetaClampTime(int64_t time)
+{
+    if (time < 1) return 1;
+    return time > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)time;
+}
+
+// size: value; narrows [minBytes, maxBytes]
+static bool
+MetaParseSize(MetaQuery* query, const wchar_t* text, size_t length)
+{
+    size_t i = 0;
+    wchar_t op = i < length && (text[i] == L'<' || text[i] == L'>' || text[i] == L'=') ? text[i++] : 0;
+    bool orEqual = op != L'=' && op != 0 && i < length && text[i] == L'=';
+    if (orEqual) i++;
+
+    uint64_t size;
+    if (!MetaParseNumber(text, length, &i, &size)) return false;
+    if (i < length && TextFoldChar(text[i]) == L'k') {
+        size <<= 10;
+        i++;
+    } else if (i < length && TextFoldChar(text[i]) == L'm') {
+        size <<= 20;
+        i++;
+    }
+    if (i < length && TextFoldChar(text[i]) == L'b') i++;
+    if (i != length) return false;
+
+    uint64_t low = 0, high = UINT32_MAX;
+    if (op == L'>') {
+        low = orEqual ? size : size + 1;
+    } else if (op == L'<') {
+        if (!orEqual && size == 0) {
+            low = 1; // Nothing is smaller than nothing
+            high = 0;
+        } else {
+            high = orEqual ? size : size - 1;
+        }
+    } else if (op == L'=') {
+        low = high = size;
+    } else {
+        low = size;
+    }
+    if (low > UINT32_MAX) {
+        low = 1; // Larger than anything stored
+        high = 0;
+    }
+    if (high > UINT32_MAX) high = UINT32_MAX;
+    if (low > query->minBytes) query->minBytes = (uint32_t)low;
+    if (high < query->maxBytes) query->maxBytes = (uint32_t)high;
+    return true;
+}
+
+// Applies one "key:value" word to the query. False, and the query
+// unchanged, if it is not a filter.
+static bool
+MetaParseFilter(MetaQuery* query, const wchar_t* word, size_t length, int64_t now)
+{
+    const wchar_t* colon = wmemchr(word, L':', length);
+    if (!colon || colon == word || colon + 1 == word + length) return false;
+    size_t keyLength = (size_t)(colon - word);
+    const wchar_t* value = colon + 1;
+    size_t valueLength = length - keyLength - 1;
+
+    if (TextEqualsNoCase(word, keyLength, L"app", 3)) {
+        if (query->appCount == META_QUERY_MAX_APPS || valueLength > META_SOURCE_CHARS - 1) return false;
+        wmemcpy(query->apps[query->appCount], value, valueLength);
+        query->apps[query->appCount][valueLength] = L'\0';
+        query->appCount++;
+        return true;
+    }
+    if (TextEqualsNoCase(word, keyLength, L"type", 4)) {
+        for (unsigned c = 0; c < META_CLASS_COUNT; ++c) {
+            if (!TextEqualsNoCase(value, valueLength, g_classNames[c], wcslen(g_classNames[c]))) continue;
+            query->classes |= 1u << c;
+            return true;
+        }
+        return false;
+    }
+    if (TextEqualsNoCase(word, keyLength, L"size", 4)) return MetaParseSize(query, value, valueLength);
+
+    bool after = TextEqualsNoCase(word, keyLength, L"after", 5);
+    if (!after && !TextEqualsNoCase(word, keyLength, L"before", 6)) return false;
+    int64_t time;
+    if (!MetaParseTime(value, valueLength, now, &time)) return false;
+    if (after) {
+        uint32_t clamped = MetaClampTime(time);
+        if (clamped > query->after) query->after = clamped;
+    } else {
+        uint32_t clamped = MetaClampTime(time - 1); // Before 'time': up to the second before
+        if (clamped < query->before) query->before = clamped;
+    }
+    if (query->after == 0) query->after = 1; // Unknown times never match
+    return true;
+}
+
+size_t
+MetaQueryParse(MetaQuery* query, const wchar_t* text, size_t length, int64_t now, wchar_t* rest)
+{
+    MetaQueryInit(query);
+    size_t used = 0;
+    size_t i = 0;
+    while (i < length) {
+        // Copy the space, then look at the word after it
+        while (i < length && MetaIsSpace(text[i])) rest[used++] = text[i++];
+        size_t start = i;
+        while (i < length && !MetaIsSpace(text[i])) i++;
+        if (i > start && MetaParseFilter(query, text + start, i - start, now)) {
+            query->active = true;
+            while (i < length && MetaIsSpace(text[i])) i++; // The space after it goes too
+            continue;
+        }
+        wmemcpy(rest + used, text + start, i - start);
+        used += i - start;
+    }
+    if (query->active) {
+        // Filters at the end leave the space before them
+        while (used > 0 && MetaIsSpace(rest[used - 1])) used--;
+    }
+    rest[used] = L'\0';
+    return used;
+}
+
+bool
+MetaQueryEqual(const MetaQuery* a, const MetaQuery* b)
+{
+    if (a->active != b->active || a->after != b->after || a->before != b->before ||
+        a->minBytes != b->minBytes || a->maxBytes != b->maxBytes || a->classes != b->classes ||
+        a->appCount != b->appCount) {
+        return false;
+    }
+    for (size_t i = 0; i < a->appCount; ++i) {
+        if (wcscmp(a->apps[i], b->apps[i]) != 0) return false;
+    }
+    return true;
+}
+
+// --- Query Evaluation ---
+// One pass per filtered column, each clearing the bits of slots that fail;
+// words already clear are skipped, so later columns cost less.
+
+static void
+MetaScanRange(const uint32_t* values, size_t slots, uint32_t low, uint32_t high, uint64_t* bits)
+{
+    uint32_t span = high - low; // Unsigned: values below 'low' wrap past it
+    for (size_t word = 0; word * 64 < slots; ++word) {
+        if (bits[word] == 0) continue;
+        const uint32_t* block = values + word * 64;
+        size_t count = slots - word * 64 < 64 ? slots - word * 64 : 64;
+        uint64_t passed = 0;
+        for (size_t j = 0; j < count; ++j) passed |= (uint64_t)(block[j] - low <= span) << j;
+        bits[word] &= passed;
+    }
+}
+
+static void
+MetaScanClasses(const uint8_t* classes, size_t slots, uint32_t wanted, uint64_t* bits)
+{
+    for (size_t word = 0; word * 64 < slots; ++word) {
+        if (bits[word] == 0) continue;
+        const uint8_t* block = classes + word * 64;
+        size_t count = slots - word * 64 < 64 ? slots - word * 64 : 64;
+        uint64_t passed = 0;
+        for (size_t j = 0; j < count; ++j) passed |= (uint64_t)((wanted >> (block[j] & 31)) & 1) << j;
+        bits[word] &= passed;
+    }
+}
+
+static void
+MetaScanSources(const uint16_t* sources, size_t slots, const uint8_t* allowed, size_t known, uint64_t* bits)
+{
+    for (size_t word = 0; word * 64 < slots; ++word) {
+        if (bits[word] == 0) continue;
+        const uint16_t* block = sources + word * 64;
+        size_t count = slots - word * 64 < 64 ? slots - word * 64 : 64;
+        uint64_t passed = 0;
+        for (size_t j = 0; j < count; ++j) passed |= (uint64_t)(block[j] < known && allowed[block[j]]) << j;
+        bits[word] &= passed;
+    }
+}
+
+size_t
+MetaQueryScan(const MetaQuery* query, const MetaColumns* columns, const MetaSources* sources,
+              size_t slots, uint64_t* bits)
+{
+    size_t words = (slots + 63) / 64;
+    bool none = query->after > query->before || query->minBytes > query->maxBytes;
+    memset(bits, none ? 0 : 0xFF, words * sizeof(uint64_t));
+    if (none || words == 0) return 0;
+    if (slots % 64 != 0) bits[words - 1] = (1ull << (slots % 64)) - 1;
+
+    if (query->after > 0 || query->before < UINT32_MAX) {
+        MetaScanRange(columns->times, slots, query->after, query->before, bits);
+    }
+    if (query->minBytes > 0 || query->maxBytes < UINT32_MAX) {
+        MetaScanRange(columns->bytes, slots, query->minBytes, query->maxBytes, bits);
+    }
+    if (query->classes != 0) MetaScanClasses(columns->classes, slots, query->classes, bits);
+    if (query->appCount > 0) {
+        // Which sources match is decided once per name, not per entry
+        uint8_t* allowed = calloc(sources->count ? sources->count : 1, 1);
+        if (!allowed) {
+            memset(bits, 0, words * sizeof(uint64_t));
+            return 0;
+        }
+        for (size_t id = 1; id < sources->count; ++id) {
+            const wchar_t* name = sources->names[id];
+            size_t nameLength = wcslen(name);
+            for (size_t a = 0; a < query->appCount && !allowed[id]; ++a) {
+                allowed[id] = TextFindNoCase(name, nameLength, query->apps[a], wcslen(query->apps[a])) != NULL;
+            }
+        }
+        MetaScanSources(columns->sources, slots, allowed, sources->count, bits);
+        free(allowed);
+    }
+
+    size_t passed = 0;
+    for (size_t word = 0; word < words; ++word) passed += MetaPopCount(bits[word]);
+    return passed;
+}
@@ -0,0 +1,133 @@
+#ifndef MCLIP_META_H
+#define MCLIP_META_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include "hashindex.h"
+
+// --- Entry Metadata ---
+// When, where from and what each history entry is: the time it was last
+// copied, the process that copied it, the size of its text and a rough class
+// of content. Stored column-wise, one packed array per field indexed by
+// history slot (History owns them and moves them with its entries), so a
+// filter on one field is a tight loop over one small array: 11 bytes an
+// entry in all.
+//
+// Filters are words of the search query, mixed with the text it looks for:
+//
+//   app:NAME     copied from a process whose name contains NAME
+//   after:WHEN   copied at or after WHEN ...
+//   before:WHEN  ... or before it. WHEN is HH:MM (today), YYYY-MM-DD or
+//                YYYY-MM-DDTHH:MM in local time, or an age: 30s, 15m, 2h,
+//                3d, 1w (ago). Entries of unknown time match neither.
+//   size:N       at least N bytes of text in UTF-8; also size:>N, <N, >=N,
+//                <=N and =N. A k or m suffix means KB or MB (1024-based).
+//   type:CLASS   text, code, url, path, email, number, image, files or formats
+//
+// Several app: or type: filters match any of their values, other filters
+// must all hold. Words that are not filters (another key, a value that does
+// not parse) stay in the text query. MetaQueryScan turns a query into a
+// bitmap of slots, one column at a time, before any text is looked at.
+
+typedef enum {
+    META_CLASS_TEXT = 0, // Anything below does not fit
+    META_CLASS_CODE,
+    META_CLASS_URL,
+    META_CLASS_PATH,
+    META_CLASS_EMAIL,
+    META_CLASS_NUMBER,   // Numbers, dates, times, phone numbers
+    META_CLASS_IMAGE,    // Content without text, stored under a label (see ClipIngest)
+    META_CLASS_FILES,
+    META_CLASS_FORMATS,
+    META_CLASS_COUNT
+} MetaClass;
+
+#define META_SOURCE_CHARS 64            // Room for a source name, terminator included; longer ones are cut
+#define META_MAX_SOURCES UINT16_MAX     // Distinct sources, the unknown one included; later ones are unknown
+#define META_QUERY_MAX_APPS 8           // app: filters per query; more stay in the text
+#define META_CLASSIFY_CHARS 4096        // Characters MetaClassify looks at
+
+typedef struct {
+    uint32_t* times;     // Unix time (seconds) of the latest copy, 0 = unknown
+    uint16_t* sources;   // Source id of the latest copy (MetaSources), 0 = unknown
+    uint32_t* bytes;     // Size of the text in UTF-8
+    uint8_t* classes;    // MetaClass
+    size_t capacity;     // Slots of each column
+} MetaColumns;
+
+// Names of the processes entries were copied from, interned to small ids
+typedef struct {
+    wchar_t (*names)[META_SOURCE_CHARS]; // By id; id 0 is the unknown source (empty name)
+    size_t count;        // Ids in use, the unknown one included
+    size_t capacity;
+    HashIndex index;     // TextHashNoCase of the name -> id
+} MetaSources;
+
+// Parsed filters: an entry passes if each active one holds
+typedef struct {
+    bool active;         // Some filter was given
+    uint32_t after;      // Copied in [after, before]; after is at least 1 with a time filter
+    uint32_t before;
+    uint32_t minBytes;   // Text size in [minBytes, maxBytes]
+    uint32_t maxBytes;
+    uint32_t classes;    // Bit per MetaClass, 0 = any
+    size_t appCount;     // Sources whose name contains one of 'apps', none = any
+    wchar_t apps[META_QUERY_MAX_APPS][META_SOURCE_CHARS];
+} MetaQuery;
+
+// Zeroed columns of 'capacity' slots. False if memory runs out.
+bool MetaColumnsInit(MetaColumns* columns, size_t capacity);
+void MetaColumnsFree(MetaColumns* columns);
+
+// Copies every field of one slot to a slot of other columns
+void MetaColumnsCopy(MetaColumns* to, size_t toSlot, const MetaColumns* from, size_t fromSlot);
+
+size_t MetaColumnsMemory(const MetaColumns* columns);
+
+void MetaSourcesInit(MetaSources* sources);
+void MetaSourcesFree(MetaSources* sources);
+
+// Id of a source name, added if new. 0 (unknown) for NULL or an empty name,
+// and once META_MAX_SOURCES are known or memory runs out.
+uint16_t MetaSourcesIntern(MetaSources* sources, const wchar_t* name);
+
+// Name of a source id, "" for the unknown one or an id not in use
+const wchar_t* MetaSourceName(const MetaSources* sources, uint16_t id);
+
+size_t MetaSourcesMemory(const MetaSources* sources);
+
+// Guesses what a text is from its first META_CLASSIFY_CHARS characters
+// (and its last one). Never returns the classes of labels.
+MetaClass MetaClassify(const wchar_t* text, size_t length);
+
+// Name used by type: filters
+const wchar_t* MetaClassName(MetaClass metaClass);
+
+// No filters: every entry passes
+void MetaQueryInit(MetaQuery* query);
+
+// Takes the filter words out of 'text' (of 'length' characters) into 'query',
+// times relative to 'now' (Unix seconds). What is left goes to 'rest' (room
+// for length + 1), with the space around removed filters dropped; without
+// filters it is 'text' unchanged. Returns the length of 'rest'.
+size_t MetaQueryParse(MetaQuery* query, const wchar_t* text, size_t length, int64_t now, wchar_t* rest);
+
+bool MetaQueryEqual(const MetaQuery* a, const MetaQuery* b);
+
+// Sets the bit of each of the first 'slots' slots (bit i % 64 of bits[i / 64],
+// room for (slots + 63) / 64 words) whose metadata passes the query, and
+// clears the others. Only the columns the query filters on are read. Returns
+// the number of bits set. Slots no entry uses pass or fail at random.
+size_t MetaQueryScan(const MetaQuery* query, const MetaColumns* columns, const MetaSources* sources,
+                     size_t slots, uint64_t* bits);
+
+static inline bool
+MetaSlotPasses(const uint64_t* bits, size_t slot)
+{
+    return (bits[slot / 64] >> (slot % 64)) & 1;
+}
+
+#endif // MCLIP_META_H
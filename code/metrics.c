@@ -0,0 +1,259 @@
+#include "metrics.h"
+#include "platform.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static const char* const g_stageNames[METRIC_STAGE_COUNT] = {
+    "clipboard_wait",
+    "clipboard_read",
+    "history_add",
+    "add_entry",
+    "search",
+    "list_refresh",
+    "log_flush",
+    "snapshot_publish",
+};
+
+static const char* const g_counterNames[METRIC_COUNTER_COUNT] = {
+    "entries_added",
+    "bytes_added",
+    "duplicates",
+    "evictions",
+    "clipboard_retries",
+    "searches_cancelled",
+    "excluded",
+    "near_duplicates",
+};
+
+// --- Histograms ---
+
+// Index of the highest set bit of a non-zero value
+static inline unsigned
+LatencyHighestBit(uint64_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (unsigned)index;
+#else
+    return 63u - (unsigned)__builtin_clzll(value);
+#endif
+}
+
+// Values below LATENCY_SUB_BUCKETS have a bucket each; above, bucket group g
+// covers [2^(g+2), 2^(g+3)) in LATENCY_SUB_BUCKETS equal steps
+static inline size_t
+LatencyBucketIndex(uint64_t ns)
+{
+    if (ns < LATENCY_SUB_BUCKETS) return (size_t)ns;
+    unsigned bit = LatencyHighestBit(ns);
+    if (bit >= LATENCY_MAX_BITS) return LATENCY_BUCKETS - 1;
+    unsigned shift = bit - LATENCY_SUB_BUCKET_BITS;
+    size_t group = shift + 1;
+    return group * LATENCY_SUB_BUCKETS + (size_t)((ns >> shift) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+void
+LatencyHistogramBucketRange(size_t index, uint64_t* lowNs, uint64_t* highNs)
+{
+    size_t group = index / LATENCY_SUB_BUCKETS;
+    uint64_t step = index % LATENCY_SUB_BUCKETS;
+    if (group == 0) {
+        *lowNs = *highNs = step;
+        return;
+    }
+    unsigned shift = (unsigned)group - 1;
+    *lowNs = (LATENCY_SUB_BUCKETS + step) << shift;
+    *highNs = *lowNs + (1ull << shift) - 1;
+}
+
+void
+LatencyHistogramRecord(LatencyHistogram* histogram, uint64_t ns)
+{
+    histogram->buckets[LatencyBucketIndex(ns)]++;
+    histogram->count++;
+    histogram->totalNs += ns;
+    if (ns > histogram->maxNs) histogram->maxNs = ns;
+}
+
+void
+LatencyHistogramMerge(LatencyHistogram* into, const LatencyHistogram* from)
+{
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) into->buckets[i] += from->buckets[i];
+    into->count += from->count;
+    into->totalNs += from->totalNs;
+    if (from->maxNs > into->maxNs) into->maxNs = from->maxNs;
+}
+
+uint64_t
+LatencyHistogramPercentile(const LatencyHistogram* histogram, double percentile)
+{
+    if (histogram->count == 0) return 0;
+    if (percentile < 0) percentile = 0;
+    if (percentile > 100) percentile = 100;
+
+    // The sample of this rank (1-based) is the one looked for
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->count + 0.999999);
+    if (rank == 0) rank = 1;
+    if (rank > histogram->count) rank = histogram->count;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            uint64_t low, high;
+            LatencyHistogramBucketRange(i, &low, &high);
+            return high < histogram->maxNs ? high : histogram->maxNs;
+        }
+    }
+    return histogram->maxNs;
+}
+
+// --- Metrics ---
+
+void
+MetricsInit(Metrics* metrics, uint64_t nowNs)
+{
+    memset(metrics, 0, sizeof(*metrics));
+    metrics->startNs = nowNs;
+}
+
+const char*
+MetricsStageName(MetricsStage stage)
+{
+    return stage < METRIC_STAGE_COUNT ? g_stageNames[stage] : "unknown";
+}
+
+const char*
+MetricsCounterName(MetricsCounter counter)
+{
+    return counter < METRIC_COUNTER_COUNT ? g_counterNames[counter] : "unknown";
+}
+
+// --- Reports ---
+
+typedef struct {
+    char* out;
+    size_t size;
+    size_t length; // Of the whole report, even past 'size'
+} MetricsWriter;
+
+static void
+MetricsAppend(MetricsWriter* writer, const char* format, ...)
+{
+    bool room = writer->length < writer->size;
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(room ? writer->out + writer->length : NULL, room ? writer->size - writer->length : 0,
+                            format, args);
+    va_end(args);
+    if (written > 0) writer->length += (size_t)written;
+}
+
+// Duration in the unit that suits it: "850 ns", "12.4 us", "3.1 ms", "2.05 s"
+static const char*
+MetricsDuration(char* buffer, size_t size, uint64_t ns)
+{
+    if (ns < 1000) snprintf(buffer, size, "%llu ns", (unsigned long long)ns);
+    else if (ns < 1000000) snprintf(buffer, size, "%.1f us", ns / 1e3);
+    else if (ns < 1000000000) snprintf(buffer, size, "%.1f ms", ns / 1e6);
+    else snprintf(buffer, size, "%.2f s", ns / 1e9);
+    return buffer;
+}
+
+size_t
+MetricsFormatText(const Metrics* metrics, uint64_t nowNs, char* out, size_t size)
+{
+    MetricsWriter writer = { out, size, 0 };
+    if (size > 0) out[0] = '\0';
+
+    uint64_t uptimeS = (nowNs - metrics->startNs) / 1000000000ull;
+    MetricsAppend(&writer, "Uptime %lluh %02llum %02llus\n\n", (unsigned long long)(uptimeS / 3600),
+                  (unsigned long long)(uptimeS / 60 % 60), (unsigned long long)(uptimeS % 60));
+
+    for (int stage = 0; stage < METRIC_STAGE_COUNT; ++stage) {
+        const LatencyHistogram* histogram = &metrics->stages[stage];
+        if (histogram->count == 0) {
+            MetricsAppend(&writer, "%s: no samples\n", g_stageNames[stage]);
+            continue;
+        }
+        char mean[16], p50[16], p90[16], p99[16], max[16];
+        MetricsAppend(&writer, "%s: %llu, mean %s, p50 %s, p90 %s, p99 %s, max %s\n", g_stageNames[stage],
+                      (unsigned long long)histogram->count,
+                      MetricsDuration(mean, sizeof(mean), histogram->totalNs / histogram->count),
+                      MetricsDuration(p50, sizeof(p50), LatencyHistogramPercentile(histogram, 50)),
+                      MetricsDuration(p90, sizeof(p90), LatencyHistogramPercentile(histogram, 90)),
+                      MetricsDuration(p99, sizeof(p99), LatencyHistogramPercentile(histogram, 99)),
+                      MetricsDuration(max, sizeof(max), histogram->maxNs));
+    }
+    MetricsAppend(&writer, "\n");
+    for (int counter = 0; counter < METRIC_COUNTER_COUNT; ++counter) {
+        MetricsAppend(&writer, "%s: %llu\n", g_counterNames[counter],
+                      (unsigned long long)metrics->counters[counter]);
+    }
+    return writer.length;
+}
+
+size_t
+MetricsFormatJson(const Metrics* metrics, uint64_t nowNs, char* out, size_t size)
+{
+    MetricsWriter writer = { out, size, 0 };
+    if (size > 0) out[0] = '\0';
+
+    MetricsAppend(&writer, "{\n  \"uptime_ns\": %llu,\n  \"stages\": {",
+                  (unsigned long long)(nowNs - metrics->startNs));
+    for (int stage = 0; stage < METRIC_STAGE_COUNT; ++stage) {
+        const LatencyHistogram* histogram = &metrics->stages[stage];
+        MetricsAppend(&writer,
+                      "%s\n    \"%s\": {\"count\": %llu, \"total_ns\": %llu, \"p50_ns\": %llu, \"p90_ns\": %llu, "
+                      "\"p99_ns\": %llu, \"max_ns\": %llu,\n      \"buckets\": [",
+                      stage ? "," : "", g_stageNames[stage], (unsigned long long)histogram->count,
+                      (unsigned long long)histogram->totalNs,
+                      (unsigned long long)LatencyHistogramPercentile(histogram, 50),
+                      (unsigned long long)LatencyHistogramPercentile(histogram, 90),
+                      (unsigned long long)LatencyHistogramPercentile(histogram, 99),
+                      (unsigned long long)histogram->maxNs);
+        // [lowest ns, highest ns, samples] of each non-empty bucket
+        bool first = true;
+        for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+            if (histogram->buckets[i] == 0) continue;
+            uint64_t low, high;
+            LatencyHistogramBucketRange(i, &low, &high);
+            MetricsAppend(&writer, "%s[%llu, %llu, %lu]", first ? "" : ", ", (unsigned long long)low,
+                          (unsigned long long)high, (unsigned long)histogram->buckets[i]);
+            first = false;
+        }
+        MetricsAppend(&writer, "]}");
+    }
+    MetricsAppend(&writer, "\n  },\n  \"counters\": {");
+    for (int counter = 0; counter < METRIC_COUNTER_COUNT; ++counter) {
+        MetricsAppend(&writer, "%s\n    \"%s\": %llu", counter ? "," : "", g_counterNames[counter],
+                      (unsigned long long)metrics->counters[counter]);
+    }
+    MetricsAppend(&writer, "\n  }\n}\n");
+    return writer.length;
+}
+
+bool
+MetricsSaveJson(const Metrics* metrics, uint64_t nowNs, const char* path)
+{
+    size_t length = MetricsFormatJson(metrics, nowNs, NULL, 0);
+    char* report = malloc(length + 1);
+    if (!report) return false;
+    MetricsFormatJson(metrics, nowNs, report, length + 1);
+
+    PlatformFile file = PLATFORM_FILE_CLOSED;
+    bool saved = PlatformFileOpen(&file, path)
+              && PlatformFileWrite(&file, 0, report, length)
+              && PlatformFileTruncate(&file, length);
+    PlatformFileClose(&file);
+    free(report);
+    return saved;
+}
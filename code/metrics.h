@@ -0,0 +1,105 @@
+#ifndef MCLIP_METRICS_H
+#define MCLIP_METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- Latency Metrics ---
+// How long the stages of ingesting and searching take on the user's machine,
+// and how often things happen, cheaply enough to stay on in release builds.
+// Durations go into fixed-bucket histograms in the style of HdrHistogram:
+// every power of two is split into 2^LATENCY_SUB_BUCKET_BITS linear buckets,
+// so any value is known to within 12.5% from 1 ns up to minutes, recording is
+// a bit scan and an increment, and nothing is ever allocated. Percentiles are
+// read back from the buckets.
+//
+// A Metrics is not synchronized: each thread records into its own (or under
+// a lock it already holds) and reports merge them (LatencyHistogramMerge).
+// Reports are UTF-8 text for people and JSON for tools.
+
+#define LATENCY_SUB_BUCKET_BITS 3
+#define LATENCY_SUB_BUCKETS (1u << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_BITS 40 // Longest duration told apart: 2^40 ns (18 minutes); longer ones count as that
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint32_t buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+typedef enum {
+    METRIC_CLIPBOARD_WAIT,  // Change notified -> clipboard opened, retries included
+    METRIC_CLIPBOARD_READ,  // Clipboard open, its formats copied out, closed
+    METRIC_HISTORY_ADD,     // Duplicate check, insert and eviction (HistoryAdd)
+    METRIC_ADD_ENTRY,       // All of adding an entry: history lock, HistoryAdd, captures, log queue
+    METRIC_SEARCH,          // One search of the history (on the search worker)
+    METRIC_LIST_REFRESH,    // Query submitted -> its results in the list
+    METRIC_LOG_FLUSH,       // Writing queued entries to the history log
+    METRIC_SNAPSHOT_PUBLISH, // Copying the history into the shared snapshot
+    METRIC_STAGE_COUNT
+} MetricsStage;
+
+typedef enum {
+    METRIC_ENTRIES_ADDED,
+    METRIC_BYTES_ADDED,       // Text of the added entries (UTF-16)
+    METRIC_DUPLICATES,        // Copies of text already in the history
+    METRIC_EVICTIONS,
+    METRIC_CLIPBOARD_RETRIES, // Reads that found the clipboard busy
+    METRIC_SEARCHES_CANCELLED,
+    METRIC_EXCLUDED,          // Clipboard texts refused by an exclusion rule (exclude.h)
+    METRIC_NEAR_DUPLICATES,   // Entries replaced by a near-duplicate copy (neardup.h)
+    METRIC_COUNTER_COUNT
+} MetricsCounter;
+
+typedef struct {
+    uint64_t startNs; // PlatformNowNs at MetricsInit, for the uptime in reports
+    LatencyHistogram stages[METRIC_STAGE_COUNT];
+    uint64_t counters[METRIC_COUNTER_COUNT];
+} Metrics;
+
+void LatencyHistogramRecord(LatencyHistogram* histogram, uint64_t ns);
+
+// Adds the samples of 'from' to 'into'
+void LatencyHistogramMerge(LatencyHistogram* into, const LatencyHistogram* from);
+
+// Duration that 'percentile' (0-100) of the samples did not exceed: the top
+// of its bucket, never more than the longest sample. 0 without samples.
+uint64_t LatencyHistogramPercentile(const LatencyHistogram* histogram, double percentile);
+
+// Range of durations counted in bucket 'index': [*lowNs, *highNs]
+void LatencyHistogramBucketRange(size_t index, uint64_t* lowNs, uint64_t* highNs);
+
+void MetricsInit(Metrics* metrics, uint64_t nowNs);
+
+static inline void
+MetricsRecord(Metrics* metrics, MetricsStage stage, uint64_t ns)
+{
+    LatencyHistogramRecord(&metrics->stages[stage], ns);
+}
+
+static inline void
+MetricsCount(Metrics* metrics, MetricsCounter counter, uint64_t n)
+{
+    metrics->counters[counter] += n;
+}
+
+// Stage and counter names as used in reports ("clipboard_wait", ...)
+const char* MetricsStageName(MetricsStage stage);
+const char* MetricsCounterName(MetricsCounter counter);
+
+// Formats a report of 'metrics' as of 'nowNs' into 'out', NUL-terminated and
+// cut short if 'size' is too small. The text report is one line per stage
+// (count, mean, p50/p90/p99, max) and per counter; the JSON one also lists
+// the non-empty buckets, so runs can be compared in full. Returns the length
+// of the whole report, which may exceed 'size' - 1.
+size_t MetricsFormatText(const Metrics* metrics, uint64_t nowNs, char* out, size_t size);
+size_t MetricsFormatJson(const Metrics* metrics, uint64_t nowNs, char* out, size_t size);
+
+// Writes the JSON report to 'path' (UTF-8), replacing the file. False on
+// failure (see platform.h for the cause).
+bool MetricsSaveJson(const Metrics* metrics, uint64_t nowNs, const char* path);
+
+#endif // MCLIP_METRICS_H
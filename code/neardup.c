@@ -0,0 +1,343 @@
+#include "neardup.h"
+#include "textmatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define NEARDUP_NO_RECORD UINT32_MAX
+#define NEARDUP_FNV_OFFSET 14695981039346656037ull
+#define NEARDUP_FNV_PRIME 1099511628211ull
+#define NEARDUP_NUMBER 0x9e3779b97f4a7c15ull // Hash every word with a digit in it counts as
+#define NEARDUP_SEEN_SLOTS 1024 // Features told apart per text: past half of it, repeats count again
+
+// Final avalanche of splitmix64: every bit of the result depends on every bit of 'value'
+static inline uint64_t
+NearDupMix(uint64_t value)
+{
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ull;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebull;
+    value ^= value >> 31;
+    return value;
+}
+
+unsigned
+NearDupDistance(uint64_t a, uint64_t b)
+{
+#if defined(_MSC_VER)
+    return (unsigned)__popcnt64(a ^ b);
+#else
+    return (unsigned)__builtin_popcountll(a ^ b);
+#endif
+}
+
+// --- Fingerprints ---
+
+static inline bool
+NearDupIsSpace(wchar_t c)
+{
+    if (c < 0x80) return c == L' ' || (c >= L'\t' && c <= L'\r');
+    return iswspace((wint_t)c) != 0;
+}
+
+// Letters, digits and '_'; any other character that is not ASCII and not a
+// space too, so that words of every script count
+static inline bool
+NearDupIsWordChar(wchar_t c)
+{
+    if (c < 0x80) return (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9') || c == L'_';
+    return !NearDupIsSpace(c);
+}
+
+// Set bits of the features of a text so far, per bit of the hash: eight
+// counts of up to 255 per lane (lane k counts bits k, k + 8, ... k + 56),
+// added to 'counts' before they can overflow. A feature counts once however
+// often it repeats: otherwise a line that recurs (a stack frame, a log
+// prefix) would decide most bits of the sketch by itself.
+typedef struct {
+    uint64_t lanes[8];
+    unsigned pending;    // Features in the lanes
+    uint32_t counts[64];
+    uint64_t seen[NEARDUP_SEEN_SLOTS]; // Features counted, 0 = unused
+    size_t seenCount;
+} NearDupCounts;
+
+static void
+NearDupFlush(NearDupCounts* counts)
+{
+    for (unsigned k = 0; k < 8; ++k) {
+        for (unsigned byte = 0; byte < 8; ++byte) {
+            counts->counts[8 * byte + k] += (uint32_t)(counts->lanes[k] >> (8 * byte)) & 0xFF;
+        }
+        counts->lanes[k] = 0;
+    }
+    counts->pending = 0;
+}
+
+// Counts a feature not seen before; returns whether it counted
+static bool
+NearDupAddFeature(NearDupCounts* counts, uint64_t feature)
+{
+    if (counts->seenCount < NEARDUP_SEEN_SLOTS / 2) {
+        uint64_t key = feature ? feature : 1;
+        size_t pos = (size_t)key & (NEARDUP_SEEN_SLOTS - 1);
+        while (counts->seen[pos] != 0) {
+            if (counts->seen[pos] == key) return false;
+            pos = (pos + 1) & (NEARDUP_SEEN_SLOTS - 1);
+        }
+        counts->seen[pos] = key;
+        counts->seenCount++;
+    }
+    for (unsigned k = 0; k < 8; ++k) counts->lanes[k] += (feature >> k) & 0x0101010101010101ull;
+    if (++counts->pending == 255) NearDupFlush(counts);
+    return true;
+}
+
+void
+NearDupFingerprint(const wchar_t* text, size_t length, NearDupPrint* print)
+{
+    NearDupCounts counts;
+    memset(&counts, 0, sizeof(counts));
+    uint32_t words = 0, features = 0;
+    uint64_t exact = NEARDUP_FNV_OFFSET, word = NEARDUP_FNV_OFFSET, previous = 0;
+    bool started = false, pendingSpace = false, inWord = false, hasDigit = false;
+
+    // One past the end stands for a space, which ends the last word
+    for (size_t i = 0; i <= length; ++i) {
+        wchar_t c = i < length ? text[i] : L' ';
+        if (NearDupIsSpace(c)) {
+            pendingSpace = started; // Leading and trailing whitespace is dropped
+        } else {
+            wchar_t folded = c >= L'A' && c <= L'Z' ? (wchar_t)(c + (L'a' - L'A')) : c < 0x80 ? c : TextFoldChar(c);
+            if (pendingSpace) exact = (exact ^ L' ') * NEARDUP_FNV_PRIME;
+            exact = (exact ^ (uint64_t)folded) * NEARDUP_FNV_PRIME;
+            started = true;
+            pendingSpace = false;
+            if (NearDupIsWordChar(c)) {
+                word = (word ^ (uint64_t)folded) * NEARDUP_FNV_PRIME;
+                hasDigit = hasDigit || (c >= L'0' && c <= L'9');
+                inWord = true;
+                continue;
+            }
+        }
+        if (!inWord) continue;
+
+        // A word ended: its bigram with the previous one is a feature. Numbers
+        // in a row are one (a date, a time, an address).
+        uint64_t hash = hasDigit ? NEARDUP_NUMBER : NearDupMix(word);
+        word = NEARDUP_FNV_OFFSET;
+        inWord = hasDigit = false;
+        if (words > 0 && hash == NEARDUP_NUMBER && previous == NEARDUP_NUMBER) continue;
+        if (words > 0) features += NearDupAddFeature(&counts, NearDupMix(previous * NEARDUP_FNV_PRIME ^ hash));
+        previous = hash;
+        words++;
+    }
+    if (words == 1) features += NearDupAddFeature(&counts, previous);
+    NearDupFlush(&counts);
+
+    uint64_t sketch = 0;
+    for (unsigned bit = 0; bit < 64; ++bit) {
+        if (2 * counts.counts[bit] > features) sketch |= 1ull << bit;
+    }
+    print->exact = NearDupMix(exact);
+    print->sketch = sketch;
+    print->words = words;
+}
+
+// --- Index ---
+
+void
+NearDupDefaultConfig(NearDupConfig* config)
+{
+    config->maxDistance = NEARDUP_DEFAULT_DISTANCE;
+    config->minWords = NEARDUP_DEFAULT_MIN_WORDS;
+    config->window = 0;
+}
+
+static inline uint32_t
+NearDupKey(uint64_t value)
+{
+    return (uint32_t)NearDupMix(value);
+}
+
+// Key of band 'band' of a sketch: bits [band * 64 / bands, (band + 1) * 64 / bands)
+static uint32_t
+NearDupBandKey(const NearDupIndex* index, uint64_t sketch, unsigned band)
+{
+    unsigned low = band * 64 / index->bands, width = (band + 1) * 64 / index->bands - low;
+    uint64_t bits = width == 64 ? sketch : (sketch >> low) & ((1ull << width) - 1);
+    return NearDupKey(bits ^ (uint64_t)band << 56); // Bands narrower than 56 bits are distinct
+}
+
+static bool
+NearDupHasSketch(const NearDupIndex* index, const NearDupPrint* print)
+{
+    return print->words >= index->config.minWords;
+}
+
+bool
+NearDupInit(NearDupIndex* index, const NearDupConfig* config)
+{
+    index->config = *config;
+    if (index->config.maxDistance > NEARDUP_MAX_DISTANCE) index->config.maxDistance = NEARDUP_MAX_DISTANCE;
+    index->bands = index->config.maxDistance + 1;
+    index->records = NULL;
+    index->capacity = 0;
+    index->freeRecord = NEARDUP_NO_RECORD;
+    index->count = 0;
+    index->candidates = 0;
+    index->exact.buckets = index->sketches.buckets = index->seqs.buckets = NULL;
+    if (!HashIndexInit(&index->exact, 16) || !HashIndexInit(&index->sketches, 16 * index->bands) ||
+        !HashIndexInit(&index->seqs, 16)) {
+        NearDupFree(index);
+        return false;
+    }
+    return true;
+}
+
+void
+NearDupFree(NearDupIndex* index)
+{
+    HashIndexFree(&index->exact);
+    HashIndexFree(&index->sketches);
+    HashIndexFree(&index->seqs);
+    free(index->records);
+    index->records = NULL;
+    index->capacity = index->count = 0;
+    index->freeRecord = NEARDUP_NO_RECORD;
+}
+
+// Doubles the record pool, chaining the new records as free
+static bool
+NearDupGrow(NearDupIndex* index)
+{
+    size_t capacity = index->capacity ? index->capacity * 2 : 16;
+    if (capacity >= HASH_INDEX_EMPTY) return false; // Records are index values
+    NearDupRecord* records = realloc(index->records, capacity * sizeof(NearDupRecord));
+    if (!records) return false;
+    for (size_t i = capacity; i-- > index->capacity;) {
+        records[i].seq = index->freeRecord;
+        index->freeRecord = (uint32_t)i;
+    }
+    index->records = records;
+    index->capacity = capacity;
+    return true;
+}
+
+// Takes a record out of the tables, from band 'bands' down (all of them: index->bands)
+static void
+NearDupUnindex(NearDupIndex* index, uint32_t id, unsigned bands)
+{
+    const NearDupRecord* record = &index->records[id];
+    if (NearDupHasSketch(index, &record->print)) {
+        for (unsigned band = 0; band < bands; ++band) {
+            HashIndexRemove(&index->sketches, NearDupBandKey(index, record->print.sketch, band), id);
+        }
+    }
+    HashIndexRemove(&index->exact, NearDupKey(record->print.exact), id);
+    HashIndexRemove(&index->seqs, NearDupKey(record->seq), id);
+}
+
+static void
+NearDupRelease(NearDupIndex* index, uint32_t id)
+{
+    index->records[id].seq = index->freeRecord;
+    index->freeRecord = id;
+}
+
+bool
+NearDupAdd(NearDupIndex* index, uint32_t seq, const NearDupPrint* print)
+{
+    if (index->freeRecord == NEARDUP_NO_RECORD && !NearDupGrow(index)) return false;
+    uint32_t id = index->freeRecord;
+    NearDupRecord* record = &index->records[id];
+    index->freeRecord = record->seq;
+    record->print = *print;
+    record->seq = seq;
+
+    if (!HashIndexInsert(&index->seqs, NearDupKey(seq), id)) {
+        NearDupRelease(index, id);
+        return false;
+    }
+    if (!HashIndexInsert(&index->exact, NearDupKey(print->exact), id)) {
+        HashIndexRemove(&index->seqs, NearDupKey(seq), id);
+        NearDupRelease(index, id);
+        return false;
+    }
+    if (NearDupHasSketch(index, print)) {
+        for (unsigned band = 0; band < index->bands; ++band) {
+            if (!HashIndexInsert(&index->sketches, NearDupBandKey(index, print->sketch, band), id)) {
+                NearDupUnindex(index, id, band);
+                NearDupRelease(index, id);
+                return false;
+            }
+        }
+    }
+    index->count++;
+    return true;
+}
+
+void
+NearDupRemove(NearDupIndex* index, uint32_t seq)
+{
+    HashIndexIter iter;
+    uint32_t id;
+
+    HashIndexFind(&index->seqs, NearDupKey(seq), &iter);
+    while (HashIndexNext(&iter, &id)) {
+        if (index->records[id].seq != seq) continue;
+        NearDupUnindex(index, id, index->bands);
+        NearDupRelease(index, id);
+        index->count--;
+        return;
+    }
+}
+
+bool
+NearDupFind(NearDupIndex* index, const NearDupPrint* print, uint32_t minSeq, uint32_t* seq)
+{
+    HashIndexIter iter;
+    uint32_t id;
+    bool found = false;
+
+    HashIndexFind(&index->exact, NearDupKey(print->exact), &iter);
+    while (HashIndexNext(&iter, &id)) {
+        const NearDupRecord* record = &index->records[id];
+        if (record->print.exact != print->exact || record->seq < minSeq) continue;
+        if (!found || record->seq > *seq) *seq = record->seq;
+        found = true;
+    }
+    if (found || !NearDupHasSketch(index, print)) return found;
+
+    // A record sharing several bands is compared once per band: cheaper than remembering it
+    unsigned best = 0;
+    for (unsigned band = 0; band < index->bands; ++band) {
+        HashIndexFind(&index->sketches, NearDupBandKey(index, print->sketch, band), &iter);
+        while (HashIndexNext(&iter, &id)) {
+            const NearDupRecord* record = &index->records[id];
+            index->candidates++;
+            if (record->seq < minSeq) continue;
+            unsigned distance = NearDupDistance(record->print.sketch, print->sketch);
+            if (distance > index->config.maxDistance) continue;
+            if (!found || distance < best || (distance == best && record->seq > *seq)) {
+                best = distance;
+                *seq = record->seq;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+size_t
+NearDupMemory(const NearDupIndex* index)
+{
+    return index->capacity * sizeof(NearDupRecord) + HashIndexMemory(&index->exact) +
+           HashIndexMemory(&index->sketches) + HashIndexMemory(&index->seqs);
+}
@@ -0,0 +1,91 @@
+#ifndef MCLIP_NEARDUP_H
+#define MCLIP_NEARDUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include "hashindex.h"
+
+// --- Near-Duplicate Index ---
+// Finds stored texts that are nearly the same as a new one: the same stack
+// trace with other timestamps, a snippet copied with trailing whitespace. Two
+// fingerprints are taken of every text:
+//
+//   exact   a hash of the case-folded text with runs of whitespace collapsed
+//           to one space and trimmed: equal for texts that differ only in
+//           whitespace and case
+//   sketch  a 64-bit SimHash of its distinct word bigrams, where words that
+//           contain a digit are all the same word and a run of them is one
+//           (a timestamp, a line number, an id): texts that share most of
+//           their words have sketches a few bits apart
+//
+// Sketches are split into maxDistance + 1 bands, each indexed on its own, so
+// two sketches at most maxDistance bits apart agree on at least one band and
+// a lookup only compares the entries that share one (locality-sensitive
+// hashing), not every entry. Records are keyed by the sequence number of
+// their history entry, like trigram.h.
+
+#define NEARDUP_MAX_DISTANCE 7      // Eight bands of 8 bits: more would match most of a large history
+#define NEARDUP_DEFAULT_DISTANCE 3
+#define NEARDUP_DEFAULT_MIN_WORDS 8
+
+typedef struct {
+    uint64_t exact;      // Hash of the whitespace-normalised, folded text
+    uint64_t sketch;     // SimHash of the word bigrams
+    uint32_t words;      // Words it was taken over
+} NearDupPrint;
+
+typedef struct {
+    unsigned maxDistance; // Sketches this many bits apart or less are near-duplicates (up to NEARDUP_MAX_DISTANCE) ...
+    unsigned minWords;    // ... if both texts have at least this many words; shorter ones only match on 'exact'
+    size_t window;        // Only the last 'window' entries added are looked at (0 = all)
+} NearDupConfig;
+
+typedef struct {
+    NearDupPrint print;
+    uint32_t seq;        // Entry it belongs to; next free record while unused
+} NearDupRecord;
+
+typedef struct {
+    NearDupConfig config;
+    unsigned bands;      // maxDistance + 1
+    HashIndex exact;     // Hash of 'exact' -> record
+    HashIndex sketches;  // Hash of (band, its bits) -> record, for sketches of at least 'minWords' words
+    HashIndex seqs;      // Sequence number -> record
+    NearDupRecord* records;
+    size_t capacity;
+    uint32_t freeRecord; // Unused records, chained through 'seq'
+    size_t count;
+    uint64_t candidates; // Sketches compared by NearDupFind, for benchmarks
+} NearDupIndex;
+
+// Both fingerprints of 'text', in one pass
+void NearDupFingerprint(const wchar_t* text, size_t length, NearDupPrint* print);
+
+// Bits in which two sketches differ
+unsigned NearDupDistance(uint64_t a, uint64_t b);
+
+// Defaults: NEARDUP_DEFAULT_DISTANCE, NEARDUP_DEFAULT_MIN_WORDS, no window
+void NearDupDefaultConfig(NearDupConfig* config);
+
+// maxDistance above NEARDUP_MAX_DISTANCE is lowered to it
+bool NearDupInit(NearDupIndex* index, const NearDupConfig* config);
+void NearDupFree(NearDupIndex* index);
+
+// Records the fingerprints of entry 'seq'. False if memory runs out.
+bool NearDupAdd(NearDupIndex* index, uint32_t seq, const NearDupPrint* print);
+
+void NearDupRemove(NearDupIndex* index, uint32_t seq);
+
+// Looks for a near-duplicate of 'print' among the entries of sequence number
+// 'minSeq' or more: one with the same exact hash, or else the one whose
+// sketch is nearest within the configured distance (the newest among
+// equals). Sets *seq and returns true if there is one.
+bool NearDupFind(NearDupIndex* index, const NearDupPrint* print, uint32_t minSeq, uint32_t* seq);
+
+// Bytes held by records and tables
+size_t NearDupMemory(const NearDupIndex* index);
+
+#endif // MCLIP_NEARDUP_H
@@ -0,0 +1,749 @@
+#include "platform.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// UTF-8 path to a malloc'd UTF-16 string, NULL on failure
+static wchar_t*
+PlatformWidePath(const char* path)
+{
+    int chars = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, path, -1, NULL, 0);
+    if (chars <= 0) return NULL;
+    wchar_t* wide = malloc(chars * sizeof(wchar_t));
+    if (wide && MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, path, -1, wide, chars) != chars) {
+        free(wide);
+        wide = NULL;
+    }
+    return wide;
+}
+
+bool
+PlatformFileOpen(PlatformFile* file, const char* path)
+{
+    file->handle = -1;
+    wchar_t* widePath = PlatformWidePath(path);
+    if (!widePath) return false;
+
+    HANDLE handle = CreateFileW(widePath, GENERIC_READ | GENERIC_WRITE,
+                                FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                                OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    free(widePath);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    file->handle = (intptr_t)handle;
+    return true;
+}
+
+void
+PlatformFileClose(PlatformFile* file)
+{
+    if (file->handle != -1) CloseHandle((HANDLE)file->handle);
+    file->handle = -1;
+}
+
+bool
+PlatformFileSize(const PlatformFile* file, uint64_t* size)
+{
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx((HANDLE)file->handle, &fileSize)) return false;
+    *size = (uint64_t)fileSize.QuadPart;
+    return true;
+}
+
+// ReadFile/WriteFile take 32-bit sizes: larger transfers are split
+#define PLATFORM_IO_CHUNK (1u << 30)
+
+bool
+PlatformFileRead(const PlatformFile* file, uint64_t offset, void* buffer, size_t size)
+{
+    unsigned char* out = buffer;
+    while (size > 0) {
+        DWORD chunk = size > PLATFORM_IO_CHUNK ? PLATFORM_IO_CHUNK : (DWORD)size;
+        OVERLAPPED at = {0};
+        at.Offset = (DWORD)offset;
+        at.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD done = 0;
+        if (!ReadFile((HANDLE)file->handle, out, chunk, &done, &at)) return false;
+        if (done == 0) {
+            SetLastError(ERROR_HANDLE_EOF);
+            return false;
+        }
+        out += done;
+        offset += done;
+        size -= done;
+    }
+    return true;
+}
+
+bool
+PlatformFileWrite(const PlatformFile* file, uint64_t offset, const void* data, size_t size)
+{
+    const unsigned char* in = data;
+    while (size > 0) {
+        DWORD chunk = size > PLATFORM_IO_CHUNK ? PLATFORM_IO_CHUNK : (DWORD)size;
+        OVERLAPPED at = {0};
+        at.Offset = (DWORD)offset;
+        at.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD done = 0;
+        if (!WriteFile((HANDLE)file->handle, in, chunk, &done, &at)) return false;
+        in += done;
+        offset += done;
+        size -= done;
+    }
+    return true;
+}
+
+bool
+PlatformFileTruncate(const PlatformFile* file, uint64_t size)
+{
+    LARGE_INTEGER position;
+    position.QuadPart = (LONGLONG)size;
+    return SetFilePointerEx((HANDLE)file->handle, position, NULL, FILE_BEGIN) &&
+           SetEndOfFile((HANDLE)file->handle);
+}
+
+bool
+PlatformFileSync(const PlatformFile* file)
+{
+    return FlushFileBuffers((HANDLE)file->handle) != 0;
+}
+
+bool
+PlatformFileReplace(const char* from, const char* to)
+{
+    wchar_t* wideFrom = PlatformWidePath(from);
+    wchar_t* wideTo = PlatformWidePath(to);
+    bool ok = wideFrom && wideTo &&
+              MoveFileExW(wideFrom, wideTo, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    free(wideFrom);
+    free(wideTo);
+    return ok;
+}
+
+bool
+PlatformFileDelete(const char* path)
+{
+    wchar_t* widePath = PlatformWidePath(path);
+    bool ok = widePath && (DeleteFileW(widePath) || GetLastError() == ERROR_FILE_NOT_FOUND);
+    free(widePath);
+    return ok;
+}
+
+bool
+PlatformMapFile(PlatformMap* map, const PlatformFile* file, size_t size)
+{
+    memset(map, 0, sizeof(*map));
+    if (size == 0) return true; // Windows cannot map zero bytes
+
+    uint64_t size64 = size;
+    HANDLE mapping = CreateFileMappingW((HANDLE)file->handle, NULL, PAGE_READONLY,
+                                        (DWORD)(size64 >> 32), (DWORD)size64, NULL);
+    if (!mapping) return false;
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+    if (!data) {
+        CloseHandle(mapping);
+        return false;
+    }
+    map->data = data;
+    map->size = size;
+    map->handle = (intptr_t)mapping;
+    return true;
+}
+
+uint64_t
+PlatformNowNs(void)
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    // Split to avoid overflowing 64 bits at high counter frequencies
+    uint64_t seconds = (uint64_t)now.QuadPart / (uint64_t)frequency.QuadPart;
+    uint64_t rest = (uint64_t)now.QuadPart % (uint64_t)frequency.QuadPart;
+    return seconds * 1000000000u + rest * 1000000000u / (uint64_t)frequency.QuadPart;
+}
+
+bool
+PlatformLocalTime(int64_t time, struct tm* local)
+{
+    __time64_t value = time;
+    return _localtime64_s(local, &value) == 0;
+}
+
+void
+PlatformUnmap(PlatformMap* map)
+{
+    if (map->data) UnmapViewOfFile(map->data);
+    if (map->handle) CloseHandle((HANDLE)map->handle);
+    memset(map, 0, sizeof(*map));
+}
+
+// --- Shared Memory (Win32) ---
+
+// Session-local name of the mapping object, as a malloc'd UTF-16 string
+static wchar_t*
+PlatformSharedName(PlatformShared* shared, const char* name)
+{
+    int length = snprintf(shared->name, sizeof(shared->name), "Local\\%s", name);
+    if (length < 0 || (size_t)length >= sizeof(shared->name)) {
+        SetLastError(ERROR_FILENAME_EXCED_RANGE);
+        return NULL;
+    }
+    return PlatformWidePath(shared->name);
+}
+
+bool
+PlatformSharedCreate(PlatformShared* shared, const char* name, size_t size)
+{
+    memset(shared, 0, sizeof(*shared));
+    wchar_t* wideName = PlatformSharedName(shared, name);
+    if (!wideName) return false;
+
+    uint64_t size64 = size;
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                        (DWORD)(size64 >> 32), (DWORD)size64, wideName);
+    DWORD error = GetLastError();
+    free(wideName);
+    if (!mapping) return false;
+    if (error == ERROR_ALREADY_EXISTS) { // Another process publishes under this name
+        CloseHandle(mapping);
+        SetLastError(ERROR_ALREADY_EXISTS);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+    if (!data) {
+        CloseHandle(mapping);
+        return false;
+    }
+    shared->data = data;
+    shared->size = size;
+    shared->handle = (intptr_t)mapping;
+    shared->owner = true;
+    return true;
+}
+
+bool
+PlatformSharedOpen(PlatformShared* shared, const char* name)
+{
+    memset(shared, 0, sizeof(*shared));
+    wchar_t* wideName = PlatformSharedName(shared, name);
+    if (!wideName) return false;
+    HANDLE mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, wideName);
+    free(wideName);
+    if (!mapping) return false;
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (!data || VirtualQuery(data, &info, sizeof(info)) == 0) {
+        if (data) UnmapViewOfFile(data);
+        CloseHandle(mapping);
+        return false;
+    }
+    shared->data = data;
+    shared->size = info.RegionSize; // Rounded up to whole pages
+    shared->handle = (intptr_t)mapping;
+    return true;
+}
+
+void
+PlatformSharedClose(PlatformShared* shared)
+{
+    if (shared->data) UnmapViewOfFile(shared->data);
+    if (shared->handle) CloseHandle((HANDLE)shared->handle);
+    memset(shared, 0, sizeof(*shared));
+}
+
+// --- Threads (Win32) ---
+
+struct PlatformLock {
+    SRWLOCK mutex;
+    CONDITION_VARIABLE changed;
+};
+
+struct PlatformThread {
+    HANDLE handle;
+    void (*run)(void* context);
+    void* context;
+};
+
+PlatformLock*
+PlatformLockCreate(void)
+{
+    PlatformLock* lock = malloc(sizeof(PlatformLock));
+    if (!lock) return NULL;
+    InitializeSRWLock(&lock->mutex);
+    InitializeConditionVariable(&lock->changed);
+    return lock;
+}
+
+void
+PlatformLockDestroy(PlatformLock* lock)
+{
+    free(lock); // SRW locks and condition variables hold no resources
+}
+
+void
+PlatformLockAcquire(PlatformLock* lock)
+{
+    AcquireSRWLockExclusive(&lock->mutex);
+}
+
+bool
+PlatformLockTryAcquire(PlatformLock* lock)
+{
+    return TryAcquireSRWLockExclusive(&lock->mutex) != 0;
+}
+
+void
+PlatformLockRelease(PlatformLock* lock)
+{
+    ReleaseSRWLockExclusive(&lock->mutex);
+}
+
+void
+PlatformLockWait(PlatformLock* lock)
+{
+    SleepConditionVariableSRW(&lock->changed, &lock->mutex, INFINITE, 0);
+}
+
+void
+PlatformLockWake(PlatformLock* lock)
+{
+    WakeAllConditionVariable(&lock->changed);
+}
+
+static DWORD WINAPI
+PlatformThreadMain(LPVOID parameter)
+{
+    PlatformThread* thread = parameter;
+    thread->run(thread->context);
+    return 0;
+}
+
+PlatformThread*
+PlatformThreadStart(void (*run)(void* context), void* context)
+{
+    PlatformThread* thread = malloc(sizeof(PlatformThread));
+    if (!thread) return NULL;
+    thread->run = run;
+    thread->context = context;
+    thread->handle = CreateThread(NULL, 0, PlatformThreadMain, thread, 0, NULL);
+    if (!thread->handle) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void
+PlatformThreadJoin(PlatformThread* thread)
+{
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    free(thread);
+}
+
+int32_t
+PlatformAtomicLoad(const volatile int32_t* value)
+{
+    // A no-op exchange: full barrier on every architecture Windows runs on
+    return (int32_t)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+}
+
+void
+PlatformAtomicStore(volatile int32_t* value, int32_t newValue)
+{
+    InterlockedExchange((volatile LONG*)value, (LONG)newValue);
+}
+
+bool
+PlatformAtomicCompareExchange(volatile int32_t* value, int32_t expected, int32_t desired)
+{
+    return InterlockedCompareExchange((volatile LONG*)value, (LONG)desired, (LONG)expected) == (LONG)expected;
+}
+
+void*
+PlatformAtomicLoadPointer(void* const volatile* value)
+{
+    return InterlockedCompareExchangePointer((PVOID volatile*)value, NULL, NULL);
+}
+
+void
+PlatformAtomicStorePointer(void* volatile* value, void* newValue)
+{
+    InterlockedExchangePointer((PVOID volatile*)value, newValue);
+}
+
+void
+PlatformAtomicFence(void)
+{
+    MemoryBarrier();
+}
+
+void
+PlatformYield(void)
+{
+    SwitchToThread();
+}
+
+#else // POSIX
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+bool
+PlatformFileOpen(PlatformFile* file, const char* path)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    file->handle = fd;
+    return fd != -1;
+}
+
+void
+PlatformFileClose(PlatformFile* file)
+{
+    if (file->handle != -1) close((int)file->handle);
+    file->handle = -1;
+}
+
+bool
+PlatformFileSize(const PlatformFile* file, uint64_t* size)
+{
+    struct stat info;
+    if (fstat((int)file->handle, &info) != 0) return false;
+    *size = (uint64_t)info.st_size;
+    return true;
+}
+
+bool
+PlatformFileRead(const PlatformFile* file, uint64_t offset, void* buffer, size_t size)
+{
+    unsigned char* out = buffer;
+    while (size > 0) {
+        ssize_t done = pread((int)file->handle, out, size, (off_t)offset);
+        if (done < 0 && errno == EINTR) continue;
+        if (done <= 0) {
+            if (done == 0) errno = EIO; // Unexpected end of file
+            return false;
+        }
+        out += done;
+        offset += (uint64_t)done;
+        size -= (size_t)done;
+    }
+    return true;
+}
+
+bool
+PlatformFileWrite(const PlatformFile* file, uint64_t offset, const void* data, size_t size)
+{
+    const unsigned char* in = data;
+    while (size > 0) {
+        ssize_t done = pwrite((int)file->handle, in, size, (off_t)offset);
+        if (done < 0 && errno == EINTR) continue;
+        if (done < 0) return false;
+        in += done;
+        offset += (uint64_t)done;
+        size -= (size_t)done;
+    }
+    return true;
+}
+
+bool
+PlatformFileTruncate(const PlatformFile* file, uint64_t size)
+{
+    return ftruncate((int)file->handle, (off_t)size) == 0;
+}
+
+bool
+PlatformFileSync(const PlatformFile* file)
+{
+    return fsync((int)file->handle) == 0;
+}
+
+bool
+PlatformFileReplace(const char* from, const char* to)
+{
+    return rename(from, to) == 0;
+}
+
+bool
+PlatformFileDelete(const char* path)
+{
+    return unlink(path) == 0 || errno == ENOENT;
+}
+
+bool
+PlatformMapFile(PlatformMap* map, const PlatformFile* file, size_t size)
+{
+    memset(map, 0, sizeof(*map));
+    if (size == 0) return true;
+
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, (int)file->handle, 0);
+    if (data == MAP_FAILED) return false;
+    map->data = data;
+    map->size = size;
+    return true;
+}
+
+uint64_t
+PlatformNowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+bool
+PlatformLocalTime(int64_t time, struct tm* local)
+{
+    time_t value = (time_t)time;
+    return localtime_r(&value, local) != NULL;
+}
+
+void
+PlatformUnmap(PlatformMap* map)
+{
+    if (map->data) munmap((void*)map->data, map->size);
+    memset(map, 0, sizeof(*map));
+}
+
+// --- Shared Memory (POSIX) ---
+
+// Segment names are global: the user id keeps users apart
+static bool
+PlatformSharedName(PlatformShared* shared, const char* name)
+{
+    int length = snprintf(shared->name, sizeof(shared->name), "/%s.%lu", name, (unsigned long)getuid());
+    if (length < 0 || (size_t)length >= sizeof(shared->name)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    return true;
+}
+
+bool
+PlatformSharedCreate(PlatformShared* shared, const char* name, size_t size)
+{
+    memset(shared, 0, sizeof(*shared));
+    if (!PlatformSharedName(shared, name)) return false;
+    if (size == 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    shm_unlink(shared->name); // Left by a process that did not close it
+    int fd = shm_open(shared->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1) return false;
+    void* data = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd); // The mapping keeps the segment
+    if (data == MAP_FAILED) {
+        shm_unlink(shared->name);
+        errno = error;
+        return false;
+    }
+    shared->data = data;
+    shared->size = size;
+    shared->owner = true;
+    return true;
+}
+
+bool
+PlatformSharedOpen(PlatformShared* shared, const char* name)
+{
+    memset(shared, 0, sizeof(*shared));
+    if (!PlatformSharedName(shared, name)) return false;
+    int fd = shm_open(shared->name, O_RDONLY, 0);
+    if (fd == -1) return false;
+
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &info) == 0) {
+        if (info.st_size > 0) data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        else errno = EINVAL;
+    }
+    int error = errno;
+    close(fd);
+    if (data == MAP_FAILED) {
+        errno = error;
+        return false;
+    }
+    shared->data = data;
+    shared->size = (size_t)info.st_size;
+    return true;
+}
+
+void
+PlatformSharedClose(PlatformShared* shared)
+{
+    if (shared->data) munmap(shared->data, shared->size);
+    if (shared->owner) shm_unlink(shared->name);
+    memset(shared, 0, sizeof(*shared));
+}
+
+// --- Threads (POSIX) ---
+
+struct PlatformLock {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+};
+
+struct PlatformThread {
+    pthread_t handle;
+    void (*run)(void* context);
+    void* context;
+};
+
+PlatformLock*
+PlatformLockCreate(void)
+{
+    PlatformLock* lock = malloc(sizeof(PlatformLock));
+    if (!lock) return NULL;
+    if (pthread_mutex_init(&lock->mutex, NULL) != 0) {
+        free(lock);
+        return NULL;
+    }
+    if (pthread_cond_init(&lock->changed, NULL) != 0) {
+        pthread_mutex_destroy(&lock->mutex);
+        free(lock);
+        return NULL;
+    }
+    return lock;
+}
+
+void
+PlatformLockDestroy(PlatformLock* lock)
+{
+    if (!lock) return;
+    pthread_cond_destroy(&lock->changed);
+    pthread_mutex_destroy(&lock->mutex);
+    free(lock);
+}
+
+void
+PlatformLockAcquire(PlatformLock* lock)
+{
+    pthread_mutex_lock(&lock->mutex);
+}
+
+bool
+PlatformLockTryAcquire(PlatformLock* lock)
+{
+    return pthread_mutex_trylock(&lock->mutex) == 0;
+}
+
+void
+PlatformLockRelease(PlatformLock* lock)
+{
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+void
+PlatformLockWait(PlatformLock* lock)
+{
+    pthread_cond_wait(&lock->changed, &lock->mutex);
+}
+
+void
+PlatformLockWake(PlatformLock* lock)
+{
+    pthread_cond_broadcast(&lock->changed);
+}
+
+static void*
+PlatformThreadMain(void* parameter)
+{
+    PlatformThread* thread = parameter;
+    thread->run(thread->context);
+    return NULL;
+}
+
+PlatformThread*
+PlatformThreadStart(void (*run)(void* context), void* context)
+{
+    PlatformThread* thread = malloc(sizeof(PlatformThread));
+    if (!thread) return NULL;
+    thread->run = run;
+    thread->context = context;
+    int error = pthread_create(&thread->handle, NULL, PlatformThreadMain, thread);
+    if (error != 0) {
+        free(thread);
+        errno = error;
+        return NULL;
+    }
+    return thread;
+}
+
+void
+PlatformThreadJoin(PlatformThread* thread)
+{
+    pthread_join(thread->handle, NULL);
+    free(thread);
+}
+
+int32_t
+PlatformAtomicLoad(const volatile int32_t* value)
+{
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+void
+PlatformAtomicStore(volatile int32_t* value, int32_t newValue)
+{
+    __atomic_store_n(value, newValue, __ATOMIC_SEQ_CST);
+}
+
+bool
+PlatformAtomicCompareExchange(volatile int32_t* value, int32_t expected, int32_t desired)
+{
+    return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+void*
+PlatformAtomicLoadPointer(void* const volatile* value)
+{
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+void
+PlatformAtomicStorePointer(void* volatile* value, void* newValue)
+{
+    __atomic_store_n(value, newValue, __ATOMIC_SEQ_CST);
+}
+
+void
+PlatformAtomicFence(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void
+PlatformYield(void)
+{
+    sched_yield();
+}
+
+#endif // _WIN32
+
+bool
+PlatformFileIsOpen(const PlatformFile* file)
+{
+    return file->handle != -1;
+}
@@ -0,0 +1,131 @@
+#ifndef MCLIP_PLATFORM_H
+#define MCLIP_PLATFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+// --- Platform Layer ---
+// The few OS services the engine needs (files, read-only mappings, shared
+// memory, clocks, threads), behind one small API with a Win32 and a POSIX implementation.
+// Paths are UTF-8.
+// Functions return false on failure; on Windows GetLastError() has the cause,
+// elsewhere errno.
+
+typedef struct {
+    intptr_t handle;     // HANDLE on Windows, file descriptor elsewhere; -1 when closed
+} PlatformFile;
+
+typedef struct {
+    const void* data;    // Start of the mapped bytes, NULL for an empty mapping
+    size_t size;
+    intptr_t handle;     // File mapping object on Windows, unused elsewhere
+} PlatformMap;
+
+typedef struct {
+    void* data;          // Start of the segment (read-only if opened with PlatformSharedOpen)
+    size_t size;
+    intptr_t handle;     // File mapping object on Windows, unused elsewhere
+    bool owner;          // Created by this process; on POSIX the name is removed on close
+    char name[64];       // OS name of the segment
+} PlatformShared;
+
+#define PLATFORM_FILE_CLOSED { -1 }
+
+typedef struct PlatformLock PlatformLock;     // Mutex with a condition variable (a monitor)
+typedef struct PlatformThread PlatformThread;
+
+// Opens a file for reading and writing, creating it if missing
+bool PlatformFileOpen(PlatformFile* file, const char* path);
+void PlatformFileClose(PlatformFile* file);
+bool PlatformFileIsOpen(const PlatformFile* file);
+
+bool PlatformFileSize(const PlatformFile* file, uint64_t* size);
+
+// Positional I/O of exactly 'size' bytes
+bool PlatformFileRead(const PlatformFile* file, uint64_t offset, void* buffer, size_t size);
+bool PlatformFileWrite(const PlatformFile* file, uint64_t offset, const void* data, size_t size);
+
+bool PlatformFileTruncate(const PlatformFile* file, uint64_t size);
+
+// Returns once written data is on stable storage
+bool PlatformFileSync(const PlatformFile* file);
+
+// Atomically replaces 'to' with 'from'; neither may be open
+bool PlatformFileReplace(const char* from, const char* to);
+bool PlatformFileDelete(const char* path);
+
+// Monotonic clock for measuring durations
+uint64_t PlatformNowNs(void);
+
+// Local calendar time of a Unix time (seconds), thread-safe unlike localtime()
+bool PlatformLocalTime(int64_t time, struct tm* local);
+
+// Maps the first 'size' bytes of an open file read-only. The file may grow
+// while mapped but must not shrink below 'size'.
+bool PlatformMapFile(PlatformMap* map, const PlatformFile* file, size_t size);
+void PlatformUnmap(PlatformMap* map);
+
+// --- Shared Memory ---
+// Named segments other processes of the same user can map: POSIX shm_open,
+// a pagefile-backed file mapping in the session's Local\ namespace on
+// Windows. 'name' is a short identifier (letters, digits, '.', '-', '_').
+
+// Creates a zero-filled read-write segment. On POSIX a segment left behind
+// by a process that crashed is replaced; on Windows, where segments go away
+// with their last handle, an existing one means another process owns the
+// name and creation fails.
+bool PlatformSharedCreate(PlatformShared* shared, const char* name, size_t size);
+
+// Maps an existing segment read-only, whole
+bool PlatformSharedOpen(PlatformShared* shared, const char* name);
+void PlatformSharedClose(PlatformShared* shared);
+
+// --- Threads ---
+// Just enough for a background worker: a monitor to guard shared state and
+// wait for changes to it, a thread, and atomic access to a flag polled
+// without the lock.
+
+// NULL if out of resources
+PlatformLock* PlatformLockCreate(void);
+void PlatformLockDestroy(PlatformLock* lock);
+void PlatformLockAcquire(PlatformLock* lock);
+void PlatformLockRelease(PlatformLock* lock);
+
+// Acquires the lock if it is free; false (without waiting) if it is held
+bool PlatformLockTryAcquire(PlatformLock* lock);
+
+// Releases the (held) lock, waits for PlatformLockWake, reacquires it. May
+// return spuriously: wait in a loop that re-checks the condition.
+void PlatformLockWait(PlatformLock* lock);
+
+// Wakes every thread waiting on the lock
+void PlatformLockWake(PlatformLock* lock);
+
+// Runs 'run(context)' on a new thread. NULL on failure.
+PlatformThread* PlatformThreadStart(void (*run)(void* context), void* context);
+
+// Waits for the thread to finish and frees it
+void PlatformThreadJoin(PlatformThread* thread);
+
+// Sequentially consistent load and store of a flag shared between threads
+int32_t PlatformAtomicLoad(const volatile int32_t* value);
+void PlatformAtomicStore(volatile int32_t* value, int32_t newValue);
+
+// Sets *value to 'desired' if it holds 'expected'; true if it did
+bool PlatformAtomicCompareExchange(volatile int32_t* value, int32_t expected, int32_t desired);
+
+// Sequentially consistent load and store of a pointer, to publish an object
+// other threads read without a lock (see epoch.h)
+void* PlatformAtomicLoadPointer(void* const volatile* value);
+void PlatformAtomicStorePointer(void* volatile* value, void* newValue);
+
+// Full memory barrier: no load or store moves across it, for publishing
+// plain data between threads or processes (see snapshot.c)
+void PlatformAtomicFence(void);
+
+// Gives the rest of the time slice to another thread, for short spin waits
+void PlatformYield(void);
+
+#endif // MCLIP_PLATFORM_H
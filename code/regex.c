@@ -0,0 +1,1104 @@
+#include "regex.h"
+#include "textmatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    REGEX_STATE_CHAR = 0,          // Consumes a character of 'set', then 'out'
+    REGEX_STATE_SPLIT,             // Continues at 'out' and 'out1'
+    REGEX_STATE_MATCH,
+    REGEX_STATE_BEGIN,             // ^, then 'out'
+    REGEX_STATE_END,               // $
+    REGEX_STATE_WORD_BOUNDARY,     // \b
+    REGEX_STATE_NOT_WORD_BOUNDARY  // \B
+} RegexStateType;
+
+typedef enum {
+    REGEX_NODE_EMPTY = 0,
+    REGEX_NODE_SET,
+    REGEX_NODE_ASSERT,
+    REGEX_NODE_CONCAT,
+    REGEX_NODE_ALTERNATE,
+    REGEX_NODE_REPEAT
+} RegexNodeType;
+
+// DFA state flags
+#define REGEX_DFA_START 1        // At the start of the text
+#define REGEX_DFA_PREV_WORD 2    // After a \w character (patterns with \b or \B only)
+#define REGEX_DFA_MATCH 4        // The pattern has matched
+#define REGEX_DFA_MATCH_AT_END 8 // The pattern matches if the text ends here
+
+// Transition sentinels
+#define REGEX_DFA_UNKNOWN (-1)   // Not computed yet
+#define REGEX_DFA_DEAD (-2)      // No match can start or continue past this character
+#define REGEX_DFA_MATCHED (-3)   // The pattern has matched
+
+#define REGEX_NO_NODE UINT32_MAX
+#define REGEX_UNBOUNDED UINT16_MAX
+#define REGEX_MAX_CHAR UINT32_MAX
+// Case folding of sets looks at the characters up to here; none above have case
+#define REGEX_FOLD_LIMIT ((uint32_t)(WCHAR_MAX < 0x1FFFF ? WCHAR_MAX : 0x1FFFF))
+
+typedef struct {
+    uint32_t lo;
+    uint32_t hi;
+} RegexRange;
+
+static const RegexRange g_digitRanges[] = { { '0', '9' } };
+static const RegexRange g_wordRanges[] = { { '0', '9' }, { 'A', 'Z' }, { '_', '_' }, { 'a', 'z' } };
+static const RegexRange g_spaceRanges[] = { { '\t', '\r' }, { ' ', ' ' } };
+
+static inline bool
+RegexIsWordChar(uint32_t c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+// --- Parser ---
+
+typedef struct {
+    uint8_t type;        // RegexNodeType
+    uint8_t assertion;   // RegexStateType of an assertion
+    uint16_t min;        // Repetition counts
+    uint16_t max;        // REGEX_UNBOUNDED: no limit
+    uint32_t left;       // Children (a repetition has 'left' only)
+    uint32_t right;
+    uint32_t set;
+    uint32_t size;       // NFA states the node compiles to
+} RegexNode;
+
+typedef struct {
+    const wchar_t* pattern;
+    size_t length;
+    size_t pos;
+    RegexNode* nodes;
+    uint32_t nodeCount;
+    uint32_t nodeCapacity;
+    RegexRange* ranges;  // Characters of the sets, sorted and merged per set
+    uint32_t rangeCount;
+    uint32_t rangeCapacity;
+    RegexSet* sets;      // Ranges of each set (in 'ranges' until RegexBuildClasses)
+    uint32_t setCount;
+    uint32_t setCapacity;
+    unsigned depth;      // Open groups
+    bool wordAssertions;
+    RegexError error;
+} RegexParser;
+
+static inline bool
+RegexPeek(const RegexParser* parser, wchar_t c)
+{
+    return parser->pos < parser->length && parser->pattern[parser->pos] == c;
+}
+
+static uint32_t
+RegexFail(RegexParser* parser, RegexError error)
+{
+    if (parser->error == REGEX_OK) parser->error = error;
+    return REGEX_NO_NODE;
+}
+
+static bool
+RegexFailed(RegexParser* parser)
+{
+    RegexFail(parser, REGEX_ERROR_SYNTAX);
+    return false;
+}
+
+// Adds a node of 'size' NFA states. REGEX_NO_NODE if the NFA gets too big or memory runs out.
+static uint32_t
+RegexNewNode(RegexParser* parser, RegexNodeType type, uint64_t size)
+{
+    if (size >= REGEX_MAX_STATES) return RegexFail(parser, REGEX_ERROR_TOO_BIG);
+    if (parser->nodeCount == parser->nodeCapacity) {
+        uint32_t capacity = parser->nodeCapacity ? parser->nodeCapacity * 2 : 64;
+        RegexNode* nodes = realloc(parser->nodes, capacity * sizeof(RegexNode));
+        if (!nodes) return RegexFail(parser, REGEX_ERROR_MEMORY);
+        parser->nodes = nodes;
+        parser->nodeCapacity = capacity;
+    }
+    RegexNode* node = &parser->nodes[parser->nodeCount];
+    memset(node, 0, sizeof(*node));
+    node->type = (uint8_t)type;
+    node->size = (uint32_t)size;
+    return parser->nodeCount++;
+}
+
+static uint32_t
+RegexNewPair(RegexParser* parser, RegexNodeType type, uint32_t left, uint32_t right)
+{
+    uint64_t size = (uint64_t)parser->nodes[left].size + parser->nodes[right].size;
+    uint32_t node = RegexNewNode(parser, type, type == REGEX_NODE_ALTERNATE ? size + 1 : size);
+    if (node == REGEX_NO_NODE) return node;
+    parser->nodes[node].left = left;
+    parser->nodes[node].right = right;
+    return node;
+}
+
+static uint32_t
+RegexNewRepeat(RegexParser* parser, uint32_t child, uint16_t min, uint16_t max)
+{
+    // 'min' copies, then a loop (one copy and a split) or max - min optional copies
+    uint64_t childSize = parser->nodes[child].size;
+    uint64_t size = min * childSize + (max == REGEX_UNBOUNDED ? childSize + 1 : (uint64_t)(max - min) * (childSize + 1));
+    uint32_t node = RegexNewNode(parser, REGEX_NODE_REPEAT, size);
+    if (node == REGEX_NO_NODE) return node;
+    parser->nodes[node].left = child;
+    parser->nodes[node].min = min;
+    parser->nodes[node].max = max;
+    return node;
+}
+
+static uint32_t
+RegexNewAssert(RegexParser* parser, RegexStateType assertion)
+{
+    uint32_t node = RegexNewNode(parser, REGEX_NODE_ASSERT, 1);
+    if (node != REGEX_NO_NODE) parser->nodes[node].assertion = (uint8_t)assertion;
+    return node;
+}
+
+static bool
+RegexPushRange(RegexParser* parser, uint32_t lo, uint32_t hi)
+{
+    if (parser->rangeCount == parser->rangeCapacity) {
+        uint32_t capacity = parser->rangeCapacity ? parser->rangeCapacity * 2 : 64;
+        RegexRange* ranges = realloc(parser->ranges, capacity * sizeof(RegexRange));
+        if (!ranges) {
+            RegexFail(parser, REGEX_ERROR_MEMORY);
+            return false;
+        }
+        parser->ranges = ranges;
+        parser->rangeCapacity = capacity;
+    }
+    parser->ranges[parser->rangeCount].lo = lo;
+    parser->ranges[parser->rangeCount].hi = hi;
+    parser->rangeCount++;
+    return true;
+}
+
+// Pushes the ranges of \d \w \s, or of their complement for \D \W \S
+static bool
+RegexPushShorthand(RegexParser* parser, wchar_t letter)
+{
+    const RegexRange* ranges = g_digitRanges;
+    size_t count = sizeof(g_digitRanges) / sizeof(g_digitRanges[0]);
+    if (letter == L'w' || letter == L'W') {
+        ranges = g_wordRanges;
+        count = sizeof(g_wordRanges) / sizeof(g_wordRanges[0]);
+    } else if (letter == L's' || letter == L'S') {
+        ranges = g_spaceRanges;
+        count = sizeof(g_spaceRanges) / sizeof(g_spaceRanges[0]);
+    }
+
+    if (letter == L'd' || letter == L'w' || letter == L's') {
+        for (size_t i = 0; i < count; ++i) {
+            if (!RegexPushRange(parser, ranges[i].lo, ranges[i].hi)) return false;
+        }
+        return true;
+    }
+    uint32_t lo = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (ranges[i].lo > lo && !RegexPushRange(parser, lo, ranges[i].lo - 1)) return false;
+        lo = ranges[i].hi + 1;
+    }
+    return RegexPushRange(parser, lo, REGEX_MAX_CHAR);
+}
+
+static int
+RegexCompareRanges(const void* a, const void* b)
+{
+    const RegexRange* x = a;
+    const RegexRange* y = b;
+    return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+// Turns the ranges pushed since 'first' into a set node. With 'fold', the
+// folded form of every character is added, since texts are matched folded;
+// 'negate' then complements the result, so [^a-z] excludes A-Z as well.
+static uint32_t
+RegexFinishSet(RegexParser* parser, uint32_t first, bool fold, bool negate)
+{
+    if (fold) {
+        uint32_t end = parser->rangeCount;
+        for (uint32_t i = first; i < end; ++i) {
+            RegexRange range = parser->ranges[i];
+            uint32_t lo = range.lo > 'A' ? range.lo : 'A';
+            uint32_t hi = range.hi < 'Z' ? range.hi : 'Z';
+            if (lo <= hi && !RegexPushRange(parser, lo + ('a' - 'A'), hi + ('a' - 'A'))) return REGEX_NO_NODE;
+
+            hi = range.hi < REGEX_FOLD_LIMIT ? range.hi : REGEX_FOLD_LIMIT;
+            for (uint32_t c = range.lo > 0x80 ? range.lo : 0x80; c <= hi; ++c) {
+                uint32_t folded = (uint32_t)TextFoldChar((wchar_t)c);
+                if (folded == c) continue;
+                RegexRange* last = &parser->ranges[parser->rangeCount - 1];
+                if (parser->rangeCount > end && last->hi + 1 == folded) {
+                    last->hi = folded;
+                } else if (!RegexPushRange(parser, folded, folded)) {
+                    return REGEX_NO_NODE;
+                }
+            }
+        }
+    }
+
+    // Sort and merge overlapping or adjacent ranges
+    uint32_t count = parser->rangeCount - first;
+    RegexRange* ranges = parser->ranges + first;
+    qsort(ranges, count, sizeof(RegexRange), RegexCompareRanges);
+    uint32_t merged = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (merged > 0 && (ranges[merged - 1].hi == REGEX_MAX_CHAR || ranges[i].lo <= ranges[merged - 1].hi + 1)) {
+            if (ranges[i].hi > ranges[merged - 1].hi) ranges[merged - 1].hi = ranges[i].hi;
+        } else {
+            ranges[merged++] = ranges[i];
+        }
+    }
+    parser->rangeCount = first + merged;
+
+    if (negate) {
+        // The complement goes after the set, then replaces it
+        uint32_t lo = 0;
+        bool open = true;
+        for (uint32_t i = first; i < first + merged; ++i) {
+            RegexRange range = parser->ranges[i];
+            if (range.lo > lo && !RegexPushRange(parser, lo, range.lo - 1)) return REGEX_NO_NODE;
+            if (range.hi == REGEX_MAX_CHAR) {
+                open = false;
+                break;
+            }
+            lo = range.hi + 1;
+        }
+        if (open && !RegexPushRange(parser, lo, REGEX_MAX_CHAR)) return REGEX_NO_NODE;
+        uint32_t complement = parser->rangeCount - (first + merged);
+        memmove(parser->ranges + first, parser->ranges + first + merged, complement * sizeof(RegexRange));
+        parser->rangeCount = first + complement;
+        merged = complement;
+    }
+
+    if (parser->setCount == parser->setCapacity) {
+        uint32_t capacity = parser->setCapacity ? parser->setCapacity * 2 : 32;
+        RegexSet* sets = realloc(parser->sets, capacity * sizeof(RegexSet));
+        if (!sets) return RegexFail(parser, REGEX_ERROR_MEMORY);
+        parser->sets = sets;
+        parser->setCapacity = capacity;
+    }
+    uint32_t node = RegexNewNode(parser, REGEX_NODE_SET, 1);
+    if (node == REGEX_NO_NODE) return node;
+    parser->sets[parser->setCount].first = first;
+    parser->sets[parser->setCount].count = merged;
+    parser->nodes[node].set = parser->setCount++;
+    return node;
+}
+
+static uint32_t
+RegexNewLiteral(RegexParser* parser, uint32_t c)
+{
+    uint32_t first = parser->rangeCount;
+    uint32_t folded = (uint32_t)TextFoldChar((wchar_t)c);
+    if (!RegexPushRange(parser, folded, folded)) return REGEX_NO_NODE;
+    return RegexFinishSet(parser, first, false, false);
+}
+
+static int
+RegexHexDigit(wchar_t c)
+{
+    if (c >= L'0' && c <= L'9') return c - L'0';
+    if (c >= L'a' && c <= L'f') return c - L'a' + 10;
+    if (c >= L'A' && c <= L'F') return c - L'A' + 10;
+    return -1;
+}
+
+// Parses the escape at 'pos' (a backslash). Sets *c to the character, or
+// *shorthand to the letter of \d \w \s \D \W \S \b \B (0 otherwise).
+static bool
+RegexParseEscape(RegexParser* parser, uint32_t* c, wchar_t* shorthand)
+{
+    *shorthand = 0;
+    parser->pos++;
+    if (parser->pos >= parser->length) return RegexFailed(parser);
+
+    wchar_t letter = parser->pattern[parser->pos++];
+    switch (letter) {
+    case L'd': case L'D': case L'w': case L'W': case L's': case L'S': case L'b': case L'B':
+        *shorthand = letter;
+        return true;
+    case L't': *c = '\t'; return true;
+    case L'n': *c = '\n'; return true;
+    case L'r': *c = '\r'; return true;
+    case L'f': *c = '\f'; return true;
+    case L'v': *c = '\v'; return true;
+    case L'x':
+    case L'u': {
+        size_t digits = letter == L'x' ? 2 : 4;
+        if (parser->length - parser->pos < digits) return RegexFailed(parser);
+        uint32_t value = 0;
+        for (size_t i = 0; i < digits; ++i) {
+            int digit = RegexHexDigit(parser->pattern[parser->pos++]);
+            if (digit < 0) return RegexFailed(parser);
+            value = value * 16 + (uint32_t)digit;
+        }
+        *c = value;
+        return true;
+    }
+    default:
+        // Escaped punctuation stands for itself; unknown letter escapes are reserved
+        if ((letter >= L'a' && letter <= L'z') || (letter >= L'A' && letter <= L'Z') || (letter >= L'0' && letter <= L'9')) {
+            return RegexFailed(parser);
+        }
+        *c = (uint32_t)letter;
+        return true;
+    }
+}
+
+// [...] after the '['
+static uint32_t
+RegexParseClass(RegexParser* parser)
+{
+    bool negate = RegexPeek(parser, L'^');
+    if (negate) parser->pos++;
+
+    uint32_t first = parser->rangeCount;
+    bool firstItem = true;
+    for (;;) {
+        if (parser->pos >= parser->length) return RegexFail(parser, REGEX_ERROR_SYNTAX);
+        wchar_t c = parser->pattern[parser->pos];
+        if (c == L']' && !firstItem) {
+            parser->pos++;
+            break;
+        }
+        firstItem = false;
+
+        uint32_t lo = (uint32_t)c;
+        wchar_t shorthand = 0;
+        if (c == L'\\') {
+            if (!RegexParseEscape(parser, &lo, &shorthand)) return REGEX_NO_NODE;
+            if (shorthand == L'b' || shorthand == L'B') return RegexFail(parser, REGEX_ERROR_SYNTAX);
+            if (shorthand) {
+                if (!RegexPushShorthand(parser, shorthand)) return REGEX_NO_NODE;
+                continue;
+            }
+        } else {
+            parser->pos++;
+        }
+
+        uint32_t hi = lo;
+        if (RegexPeek(parser, L'-') && parser->pos + 1 < parser->length && parser->pattern[parser->pos + 1] != L']') {
+            parser->pos++;
+            c = parser->pattern[parser->pos];
+            hi = (uint32_t)c;
+            if (c == L'\\') {
+                if (!RegexParseEscape(parser, &hi, &shorthand)) return REGEX_NO_NODE;
+                if (shorthand) return RegexFail(parser, REGEX_ERROR_SYNTAX);
+            } else {
+                parser->pos++;
+            }
+            if (hi < lo) return RegexFail(parser, REGEX_ERROR_SYNTAX);
+        }
+        if (!RegexPushRange(parser, lo, hi)) return REGEX_NO_NODE;
+    }
+    return RegexFinishSet(parser, first, true, negate);
+}
+
+// {n}, {n,} or {n,m} at 'pos'. False (nothing consumed) if it is not one: the '{' is a literal then.
+static bool
+RegexParseCount(RegexParser* parser, uint16_t* min, uint16_t* max)
+{
+    size_t pos = parser->pos + 1;
+    uint32_t values[2] = { 0, 0 };
+    size_t digits[2] = { 0, 0 };
+    int part = 0;
+    for (; pos < parser->length; ++pos) {
+        wchar_t c = parser->pattern[pos];
+        if (c >= L'0' && c <= L'9') {
+            if (values[part] <= REGEX_MAX_REPEAT) values[part] = values[part] * 10 + (uint32_t)(c - L'0');
+            digits[part]++;
+        } else if (c == L',' && part == 0) {
+            part = 1;
+        } else {
+            break;
+        }
+    }
+    if (pos >= parser->length || parser->pattern[pos] != L'}' || digits[0] == 0) return false;
+    parser->pos = pos + 1;
+
+    if (values[0] > REGEX_MAX_REPEAT || values[1] > REGEX_MAX_REPEAT) {
+        RegexFail(parser, REGEX_ERROR_TOO_BIG);
+        return true;
+    }
+    *min = (uint16_t)values[0];
+    *max = part == 0 ? *min : digits[1] == 0 ? REGEX_UNBOUNDED : (uint16_t)values[1];
+    if (*max < *min) RegexFail(parser, REGEX_ERROR_SYNTAX);
+    return true;
+}
+
+static uint32_t RegexParseAlternation(RegexParser* parser);
+
+static uint32_t
+RegexParseAtom(RegexParser* parser)
+{
+    wchar_t c = parser->pattern[parser->pos];
+    switch (c) {
+    case L'(': {
+        if (++parser->depth > REGEX_MAX_DEPTH) return RegexFail(parser, REGEX_ERROR_TOO_BIG);
+        parser->pos++;
+        if (RegexPeek(parser, L'?')) {
+            if (parser->pos + 1 >= parser->length || parser->pattern[parser->pos + 1] != L':') {
+                return RegexFail(parser, REGEX_ERROR_SYNTAX);
+            }
+            parser->pos += 2;
+        }
+        uint32_t inner = RegexParseAlternation(parser);
+        if (inner == REGEX_NO_NODE) return inner;
+        if (!RegexPeek(parser, L')')) return RegexFail(parser, REGEX_ERROR_SYNTAX);
+        parser->pos++;
+        parser->depth--;
+        return inner;
+    }
+    case L'*': case L'+': case L'?':
+        return RegexFail(parser, REGEX_ERROR_SYNTAX); // Nothing to repeat
+    case L'[':
+        parser->pos++;
+        return RegexParseClass(parser);
+    case L'.': {
+        parser->pos++;
+        uint32_t first = parser->rangeCount;
+        if (!RegexPushRange(parser, 0, '\n' - 1) || !RegexPushRange(parser, '\n' + 1, REGEX_MAX_CHAR)) {
+            return REGEX_NO_NODE;
+        }
+        return RegexFinishSet(parser, first, false, false);
+    }
+    case L'^':
+        parser->pos++;
+        return RegexNewAssert(parser, REGEX_STATE_BEGIN);
+    case L'$':
+        parser->pos++;
+        return RegexNewAssert(parser, REGEX_STATE_END);
+    case L'\\': {
+        uint32_t literal = 0;
+        wchar_t shorthand = 0;
+        if (!RegexParseEscape(parser, &literal, &shorthand)) return REGEX_NO_NODE;
+        if (shorthand == L'b' || shorthand == L'B') {
+            parser->wordAssertions = true;
+            return RegexNewAssert(parser, shorthand == L'b' ? REGEX_STATE_WORD_BOUNDARY : REGEX_STATE_NOT_WORD_BOUNDARY);
+        }
+        if (shorthand) {
+            uint32_t first = parser->rangeCount;
+            if (!RegexPushShorthand(parser, (wchar_t)(shorthand | 0x20))) return REGEX_NO_NODE;
+            return RegexFinishSet(parser, first, true, shorthand < L'a');
+        }
+        return RegexNewLiteral(parser, literal);
+    }
+    default:
+        parser->pos++;
+        return RegexNewLiteral(parser, (uint32_t)c);
+    }
+}
+
+// An atom and its repetitions
+static uint32_t
+RegexParseRepeat(RegexParser* parser)
+{
+    uint32_t node = RegexParseAtom(parser);
+    while (node != REGEX_NO_NODE && parser->pos < parser->length) {
+        uint16_t min = 0, max = 0;
+        wchar_t c = parser->pattern[parser->pos];
+        if (c == L'*') {
+            max = REGEX_UNBOUNDED;
+        } else if (c == L'+') {
+            min = 1;
+            max = REGEX_UNBOUNDED;
+        } else if (c == L'?') {
+            max = 1;
+        } else if (c != L'{' || !RegexParseCount(parser, &min, &max)) {
+            break;
+        }
+        if (parser->error != REGEX_OK) return REGEX_NO_NODE;
+        if (c != L'{') parser->pos++;
+        node = RegexNewRepeat(parser, node, min, max);
+    }
+    return node;
+}
+
+static uint32_t
+RegexParseConcat(RegexParser* parser)
+{
+    uint32_t node = REGEX_NO_NODE;
+    while (parser->pos < parser->length && !RegexPeek(parser, L'|') && !RegexPeek(parser, L')')) {
+        uint32_t next = RegexParseRepeat(parser);
+        if (next == REGEX_NO_NODE) return next;
+        node = node == REGEX_NO_NODE ? next : RegexNewPair(parser, REGEX_NODE_CONCAT, node, next);
+        if (node == REGEX_NO_NODE) return node;
+    }
+    return node == REGEX_NO_NODE ? RegexNewNode(parser, REGEX_NODE_EMPTY, 0) : node;
+}
+
+static uint32_t
+RegexParseAlternation(RegexParser* parser)
+{
+    uint32_t node = RegexParseConcat(parser);
+    while (node != REGEX_NO_NODE && RegexPeek(parser, L'|')) {
+        parser->pos++;
+        uint32_t right = RegexParseConcat(parser);
+        if (right == REGEX_NO_NODE) return right;
+        node = RegexNewPair(parser, REGEX_NODE_ALTERNATE, node, right);
+    }
+    return node;
+}
+
+// --- Character Classes ---
+// Characters no set tells apart share a class, so the DFA has one transition
+// per class instead of one per character.
+
+static int
+RegexCompareChars(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t
+RegexClassOf(const Regex* regex, uint32_t c)
+{
+    uint32_t lo = 0, hi = regex->classCount;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (regex->bounds[mid] <= c) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Splits the characters into classes at the edges of every set (and of \w,
+// for word boundaries), then rewrites the sets as ranges of classes
+static RegexError
+RegexBuildClasses(Regex* regex, RegexParser* parser)
+{
+    size_t wordCount = sizeof(g_wordRanges) / sizeof(g_wordRanges[0]);
+    regex->bounds = malloc((1 + 2 * ((size_t)parser->rangeCount + wordCount)) * sizeof(uint32_t));
+    regex->setClasses = malloc((2 * (size_t)parser->rangeCount + 1) * sizeof(uint32_t));
+    if (!regex->bounds || !regex->setClasses) return REGEX_ERROR_MEMORY;
+
+    size_t count = 0;
+    regex->bounds[count++] = 0;
+    for (uint32_t i = 0; i < parser->rangeCount; ++i) {
+        regex->bounds[count++] = parser->ranges[i].lo;
+        if (parser->ranges[i].hi != REGEX_MAX_CHAR) regex->bounds[count++] = parser->ranges[i].hi + 1;
+    }
+    if (parser->wordAssertions) {
+        for (size_t i = 0; i < wordCount; ++i) {
+            regex->bounds[count++] = g_wordRanges[i].lo;
+            regex->bounds[count++] = g_wordRanges[i].hi + 1;
+        }
+    }
+    qsort(regex->bounds, count, sizeof(uint32_t), RegexCompareChars);
+    size_t unique = 1;
+    for (size_t i = 1; i < count; ++i) {
+        if (regex->bounds[i] != regex->bounds[unique - 1]) regex->bounds[unique++] = regex->bounds[i];
+    }
+    if (unique > UINT16_MAX) return REGEX_ERROR_TOO_BIG;
+    regex->classCount = (uint32_t)unique;
+
+    regex->wordClass = malloc(unique);
+    if (!regex->wordClass) return REGEX_ERROR_MEMORY;
+    for (size_t i = 0; i < unique; ++i) regex->wordClass[i] = RegexIsWordChar(regex->bounds[i]);
+    for (uint32_t c = 0; c < 256; ++c) {
+        regex->byteClass[c] = (uint16_t)RegexClassOf(regex, (uint32_t)TextFoldChar((wchar_t)c));
+    }
+
+    // The sets move over from the parser
+    regex->sets = parser->sets;
+    regex->setCount = parser->setCount;
+    parser->sets = NULL;
+    uint32_t pairs = 0;
+    for (uint32_t s = 0; s < regex->setCount; ++s) {
+        RegexSet* set = &regex->sets[s];
+        uint32_t first = pairs;
+        for (uint32_t i = set->first; i < set->first + set->count; ++i) {
+            uint32_t lo = RegexClassOf(regex, parser->ranges[i].lo);
+            uint32_t hi = RegexClassOf(regex, parser->ranges[i].hi);
+            if (pairs > first && regex->setClasses[2 * pairs - 1] + 1 >= lo) {
+                regex->setClasses[2 * pairs - 1] = hi;
+            } else {
+                regex->setClasses[2 * pairs] = lo;
+                regex->setClasses[2 * pairs + 1] = hi;
+                pairs++;
+            }
+        }
+        set->first = first;
+        set->count = pairs - first;
+    }
+    return REGEX_OK;
+}
+
+static bool
+RegexSetHas(const Regex* regex, uint32_t set, uint32_t cls)
+{
+    const uint32_t* pairs = regex->setClasses + 2 * regex->sets[set].first;
+    size_t lo = 0, hi = regex->sets[set].count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (pairs[2 * mid + 1] < cls) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < regex->sets[set].count && pairs[2 * lo] <= cls;
+}
+
+// --- NFA ---
+
+static uint32_t
+RegexAddState(Regex* regex, RegexStateType type, uint32_t out, uint32_t out1, uint32_t set)
+{
+    RegexState* state = &regex->states[regex->stateCount];
+    state->type = (uint8_t)type;
+    state->out = out;
+    state->out1 = out1;
+    state->set = set;
+    return regex->stateCount++;
+}
+
+// Compiles 'node' to states leading to 'next', back to front, and returns its first state
+static uint32_t
+RegexCompileNode(Regex* regex, const RegexParser* parser, uint32_t node, uint32_t next)
+{
+    for (;;) {
+        const RegexNode* n = &parser->nodes[node];
+        switch (n->type) {
+        case REGEX_NODE_EMPTY:
+            return next;
+        case REGEX_NODE_SET:
+            return RegexAddState(regex, REGEX_STATE_CHAR, next, 0, n->set);
+        case REGEX_NODE_ASSERT:
+            return RegexAddState(regex, (RegexStateType)n->assertion, next, 0, 0);
+        case REGEX_NODE_CONCAT:
+            next = RegexCompileNode(regex, parser, n->right, next);
+            node = n->left;
+            continue;
+        case REGEX_NODE_ALTERNATE: {
+            uint32_t left = RegexCompileNode(regex, parser, n->left, next);
+            uint32_t right = RegexCompileNode(regex, parser, n->right, next);
+            return RegexAddState(regex, REGEX_STATE_SPLIT, left, right, 0);
+        }
+        default: {
+            uint32_t target = next;
+            if (n->max == REGEX_UNBOUNDED) {
+                uint32_t loop = RegexAddState(regex, REGEX_STATE_SPLIT, 0, next, 0);
+                uint32_t body = RegexCompileNode(regex, parser, n->left, loop);
+                regex->states[loop].out = body;
+                target = loop;
+            } else {
+                for (uint16_t i = n->min; i < n->max; ++i) {
+                    uint32_t body = RegexCompileNode(regex, parser, n->left, target);
+                    target = RegexAddState(regex, REGEX_STATE_SPLIT, body, next, 0);
+                }
+            }
+            for (uint16_t i = 0; i < n->min; ++i) target = RegexCompileNode(regex, parser, n->left, target);
+            return target;
+        }
+        }
+    }
+}
+
+// --- Lazy DFA ---
+// A DFA state is the set of NFA states live at a position, plus what the
+// assertions need to know about it (REGEX_DFA_START, REGEX_DFA_PREV_WORD).
+// Sets hold character, match and assertion states; assertions wait in the
+// set until the next character (or the end) shows whether they hold.
+// Matching anywhere in the text is the DFA of .*(pattern): every step adds
+// the start of the pattern again.
+
+typedef struct {
+    bool start;          // Position is the start of the text
+    bool end;            // ... its end
+    bool prevWord;       // Character before the position is a \w one
+    bool nextWord;       // ... the character after it
+} RegexContext;
+
+static void
+RegexNextMark(Regex* regex)
+{
+    if (++regex->mark == 0) {
+        memset(regex->marks, 0, regex->stateCount * sizeof(uint32_t));
+        regex->mark = 1;
+    }
+}
+
+static bool
+RegexAssertionHolds(RegexStateType type, const RegexContext* context)
+{
+    switch (type) {
+    case REGEX_STATE_BEGIN: return context->start;
+    case REGEX_STATE_END: return context->end;
+    case REGEX_STATE_WORD_BOUNDARY: return context->prevWord != context->nextWord;
+    default: return context->prevWord == context->nextWord;
+    }
+}
+
+// Follows the empty edges from NFA state 'from' (states marked since the last
+// RegexNextMark are skipped), appending the states reached to 'out' (if not
+// NULL). With a context, assertions that hold in it are passed and the others
+// dropped; without one they are kept, except ^ when not 'atStart'. Returns
+// true if the match state was reached.
+static bool
+RegexClosure(Regex* regex, uint32_t from, const RegexContext* context, bool atStart, uint16_t* out, size_t* length)
+{
+    bool matched = false;
+    size_t top = 0;
+    if (regex->marks[from] == regex->mark) return false;
+    regex->marks[from] = regex->mark;
+    regex->stack[top++] = from;
+    while (top > 0) {
+        uint32_t s = regex->stack[--top];
+        const RegexState* state = &regex->states[s];
+        uint32_t follow[2];
+        size_t followCount = 0;
+        switch ((RegexStateType)state->type) {
+        case REGEX_STATE_SPLIT:
+            follow[followCount++] = state->out1;
+            follow[followCount++] = state->out;
+            break;
+        case REGEX_STATE_MATCH:
+            matched = true;
+            break;
+        case REGEX_STATE_CHAR:
+            if (out) out[(*length)++] = (uint16_t)s;
+            break;
+        default:
+            if (context) {
+                if (RegexAssertionHolds((RegexStateType)state->type, context)) follow[followCount++] = state->out;
+            } else if (state->type != REGEX_STATE_BEGIN || atStart) {
+                if (out) out[(*length)++] = (uint16_t)s;
+            }
+            break;
+        }
+        for (size_t i = 0; i < followCount; ++i) {
+            if (regex->marks[follow[i]] == regex->mark) continue;
+            regex->marks[follow[i]] = regex->mark;
+            regex->stack[top++] = follow[i];
+        }
+    }
+    return matched;
+}
+
+static int
+RegexCompareStates(const void* a, const void* b)
+{
+    return (int)*(const uint16_t*)a - (int)*(const uint16_t*)b;
+}
+
+// Sets are sorted so equal sets hash and compare equal; most are small
+static void
+RegexSortSet(uint16_t* set, size_t length)
+{
+    if (length > 64) {
+        qsort(set, length, sizeof(uint16_t), RegexCompareStates);
+        return;
+    }
+    for (size_t i = 1; i < length; ++i) {
+        uint16_t value = set[i];
+        size_t j = i;
+        for (; j > 0 && set[j - 1] > value; --j) set[j] = set[j - 1];
+        set[j] = value;
+    }
+}
+
+static uint32_t
+RegexDfaHash(const uint16_t* set, size_t length, uint8_t flags)
+{
+    uint32_t hash = 2166136261u ^ flags;
+    for (size_t i = 0; i < length; ++i) hash = (hash ^ set[i]) * 16777619u;
+    hash ^= hash >> 16;
+    return hash * 0x45d9f3bu;
+}
+
+// Forgets every DFA state (the budget ran out)
+static void
+RegexDfaFlush(Regex* regex)
+{
+    RegexDfa* dfa = &regex->dfa;
+    memset(dfa->next, 0xFF, (size_t)dfa->count * regex->classCount * sizeof(int32_t));
+    memset(dfa->buckets, 0, dfa->bucketCount * sizeof(uint32_t));
+    dfa->count = 0;
+    dfa->setsUsed = 0;
+    dfa->start = -1;
+    dfa->flushes++;
+}
+
+// The DFA state of a sorted NFA state set, added if new. Flushes the DFA
+// first when it is full; *flushed tells the caller its state ids are gone.
+static int32_t
+RegexDfaAdd(Regex* regex, const uint16_t* set, size_t length, uint8_t flags, bool* flushed)
+{
+    RegexDfa* dfa = &regex->dfa;
+    uint32_t hash = RegexDfaHash(set, length, flags);
+    size_t mask = dfa->bucketCount - 1;
+    for (size_t b = hash & mask; dfa->buckets[b] != 0; b = (b + 1) & mask) {
+        uint32_t id = dfa->buckets[b] - 1;
+        if ((dfa->flags[id] & ~REGEX_DFA_MATCH_AT_END) == flags && dfa->setLength[id] == length &&
+            memcmp(dfa->sets + dfa->setStart[id], set, length * sizeof(uint16_t)) == 0) {
+            return (int32_t)id;
+        }
+    }
+
+    *flushed = false;
+    if (dfa->count == dfa->capacity || dfa->setsUsed + length > dfa->setsCapacity) {
+        RegexDfaFlush(regex);
+        *flushed = true;
+    }
+    uint32_t id = dfa->count++;
+    dfa->setStart[id] = (uint32_t)dfa->setsUsed;
+    dfa->setLength[id] = (uint16_t)length;
+    memcpy(dfa->sets + dfa->setsUsed, set, length * sizeof(uint16_t));
+    dfa->setsUsed += length;
+    size_t b = hash & mask;
+    while (dfa->buckets[b] != 0) b = (b + 1) & mask;
+    dfa->buckets[b] = id + 1;
+
+    // Whether the text may end here
+    RegexContext context = { (flags & REGEX_DFA_START) != 0, true, (flags & REGEX_DFA_PREV_WORD) != 0, false };
+    bool matchesAtEnd = false;
+    RegexNextMark(regex);
+    for (size_t i = 0; i < length && !matchesAtEnd; ++i) {
+        matchesAtEnd = RegexClosure(regex, set[i], &context, false, NULL, NULL);
+    }
+    dfa->flags[id] = flags | (matchesAtEnd ? REGEX_DFA_MATCH_AT_END : 0);
+    return (int32_t)id;
+}
+
+static int32_t
+RegexDfaStart(Regex* regex)
+{
+    size_t length = 0;
+    bool flushed = false;
+    RegexNextMark(regex);
+    bool matched = RegexClosure(regex, regex->startState, NULL, true, regex->scratch, &length);
+    RegexSortSet(regex->scratch, length);
+    uint8_t flags = REGEX_DFA_START | (matched ? REGEX_DFA_MATCH : 0);
+    regex->dfa.start = RegexDfaAdd(regex, regex->scratch, length, flags, &flushed);
+    return regex->dfa.start;
+}
+
+// Computes and caches the transition of DFA state 'id' on class 'cls': a state, or a sentinel
+static int32_t
+RegexDfaStep(Regex* regex, int32_t id, uint32_t cls)
+{
+    RegexDfa* dfa = &regex->dfa;
+    uint8_t flags = dfa->flags[id];
+    const uint16_t* set = dfa->sets + dfa->setStart[id];
+    size_t length = dfa->setLength[id];
+    bool nextWord = regex->wordClass[cls] != 0;
+    int32_t* transition = &dfa->next[(size_t)id * regex->classCount + cls];
+
+    // The waiting assertions are decided by the character
+    RegexContext context = { (flags & REGEX_DFA_START) != 0, false, (flags & REGEX_DFA_PREV_WORD) != 0, nextWord };
+    uint16_t* resolved = regex->scratch + regex->stateCount;
+    size_t resolvedLength = 0;
+    bool matched = false;
+    RegexNextMark(regex);
+    for (size_t i = 0; i < length; ++i) {
+        matched |= RegexClosure(regex, set[i], &context, false, resolved, &resolvedLength);
+    }
+    if (matched) return *transition = REGEX_DFA_MATCHED;
+
+    uint16_t* next = regex->scratch;
+    size_t nextLength = 0;
+    RegexNextMark(regex);
+    for (size_t i = 0; i < resolvedLength; ++i) {
+        const RegexState* state = &regex->states[resolved[i]];
+        if (state->type == REGEX_STATE_CHAR && RegexSetHas(regex, state->set, cls)) {
+            matched |= RegexClosure(regex, state->out, NULL, false, next, &nextLength);
+        }
+    }
+    matched |= RegexClosure(regex, regex->startState, NULL, false, next, &nextLength);
+    if (matched) return *transition = REGEX_DFA_MATCHED;
+    if (nextLength == 0) return *transition = REGEX_DFA_DEAD;
+
+    RegexSortSet(next, nextLength);
+    uint8_t nextFlags = regex->wordAssertions && nextWord ? REGEX_DFA_PREV_WORD : 0;
+    bool flushed = false;
+    int32_t to = RegexDfaAdd(regex, next, nextLength, nextFlags, &flushed);
+    if (!flushed) *transition = to;
+    return to;
+}
+
+static RegexError
+RegexDfaInit(Regex* regex)
+{
+    RegexDfa* dfa = &regex->dfa;
+    size_t rowBytes = regex->classCount * sizeof(int32_t) + sizeof(uint32_t) + sizeof(uint16_t) + 1;
+    size_t capacity = REGEX_DFA_BYTES / 2 / rowBytes;
+    if (capacity < 16) capacity = 16;
+    if (capacity > REGEX_DFA_MAX_STATES) capacity = REGEX_DFA_MAX_STATES;
+    dfa->capacity = (uint32_t)capacity;
+    dfa->setsCapacity = REGEX_DFA_BYTES / 2 / sizeof(uint16_t);
+    if (dfa->setsCapacity < 2 * (size_t)regex->stateCount) dfa->setsCapacity = 2 * (size_t)regex->stateCount;
+    dfa->bucketCount = 1;
+    while (dfa->bucketCount < 2 * capacity) dfa->bucketCount *= 2;
+    dfa->start = -1;
+
+    dfa->sets = malloc(dfa->setsCapacity * sizeof(uint16_t));
+    dfa->setStart = malloc(capacity * sizeof(uint32_t));
+    dfa->setLength = malloc(capacity * sizeof(uint16_t));
+    dfa->flags = malloc(capacity);
+    dfa->next = malloc(capacity * regex->classCount * sizeof(int32_t));
+    dfa->buckets = calloc(dfa->bucketCount, sizeof(uint32_t));
+    regex->marks = calloc(regex->stateCount, sizeof(uint32_t));
+    regex->stack = malloc(regex->stateCount * sizeof(uint32_t));
+    regex->scratch = malloc(2 * (size_t)regex->stateCount * sizeof(uint16_t));
+    if (!dfa->sets || !dfa->setStart || !dfa->setLength || !dfa->flags || !dfa->next || !dfa->buckets ||
+        !regex->marks || !regex->stack || !regex->scratch) {
+        return REGEX_ERROR_MEMORY;
+    }
+    memset(dfa->next, 0xFF, capacity * regex->classCount * sizeof(int32_t));
+    return REGEX_OK;
+}
+
+// --- Regex ---
+
+RegexError
+RegexCompile(Regex* regex, const wchar_t* pattern, size_t length)
+{
+    memset(regex, 0, sizeof(*regex));
+    if (length > REGEX_MAX_PATTERN) return REGEX_ERROR_TOO_BIG;
+
+    RegexParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.pattern = pattern;
+    parser.length = length;
+    uint32_t root = RegexParseAlternation(&parser);
+    if (parser.error == REGEX_OK && parser.pos < length) parser.error = REGEX_ERROR_SYNTAX; // ')' without '('
+    regex->wordAssertions = parser.wordAssertions;
+
+    RegexError error = parser.error;
+    if (error == REGEX_OK) error = RegexBuildClasses(regex, &parser);
+    if (error == REGEX_OK) {
+        regex->states = malloc(((size_t)parser.nodes[root].size + 1) * sizeof(RegexState));
+        if (!regex->states) error = REGEX_ERROR_MEMORY;
+    }
+    if (error == REGEX_OK) {
+        uint32_t match = RegexAddState(regex, REGEX_STATE_MATCH, 0, 0, 0);
+        regex->startState = RegexCompileNode(regex, &parser, root, match);
+        error = RegexDfaInit(regex);
+    }
+    if (error == REGEX_OK) {
+        regex->pattern = malloc((length + 1) * sizeof(wchar_t));
+        if (!regex->pattern) error = REGEX_ERROR_MEMORY;
+    }
+    free(parser.nodes);
+    free(parser.ranges);
+    free(parser.sets);
+    if (error != REGEX_OK) {
+        RegexFree(regex);
+        return error;
+    }
+    wmemcpy(regex->pattern, pattern, length);
+    regex->pattern[length] = L'\0';
+    regex->patternLength = length;
+    return REGEX_OK;
+}
+
+void
+RegexFree(Regex* regex)
+{
+    free(regex->pattern);
+    free(regex->states);
+    free(regex->sets);
+    free(regex->setClasses);
+    free(regex->bounds);
+    free(regex->wordClass);
+    free(regex->dfa.sets);
+    free(regex->dfa.setStart);
+    free(regex->dfa.setLength);
+    free(regex->dfa.flags);
+    free(regex->dfa.next);
+    free(regex->dfa.buckets);
+    free(regex->marks);
+    free(regex->stack);
+    free(regex->scratch);
+    memset(regex, 0, sizeof(*regex));
+}
+
+bool
+RegexMatch(Regex* regex, const wchar_t* text, size_t length)
+{
+    RegexDfa* dfa = &regex->dfa;
+    int32_t state = dfa->start >= 0 ? dfa->start : RegexDfaStart(regex);
+    if (dfa->flags[state] & REGEX_DFA_MATCH) return true;
+
+    const uint32_t stride = regex->classCount;
+    for (size_t i = 0; i < length; ++i) {
+        uint32_t c = (uint32_t)text[i];
+        uint32_t cls = c < 256 ? regex->byteClass[c] : RegexClassOf(regex, (uint32_t)TextFoldChar(text[i]));
+        int32_t to = dfa->next[(size_t)state * stride + cls];
+        if (to < 0) {
+            if (to == REGEX_DFA_UNKNOWN) to = RegexDfaStep(regex, state, cls);
+            if (to == REGEX_DFA_MATCHED) return true;
+            if (to == REGEX_DFA_DEAD) return false;
+        }
+        state = to;
+    }
+    return (dfa->flags[state] & REGEX_DFA_MATCH_AT_END) != 0;
+}
+
+// --- Cache ---
+
+void
+RegexCacheInit(RegexCache* cache)
+{
+    memset(cache, 0, sizeof(*cache));
+}
+
+void
+RegexCacheFree(RegexCache* cache)
+{
+    for (size_t i = 0; i < REGEX_CACHE_SIZE; ++i) {
+        if (!cache->slots[i]) continue;
+        RegexFree(cache->slots[i]);
+        free(cache->slots[i]);
+    }
+    memset(cache, 0, sizeof(*cache));
+}
+
+Regex*
+RegexCacheGet(RegexCache* cache, const wchar_t* pattern, size_t length, RegexError* error)
+{
+    *error = REGEX_OK;
+    size_t found = REGEX_CACHE_SIZE - 1; // The slot to reuse on a miss: the least recently used one
+    Regex* regex = NULL;
+    for (size_t i = 0; i < REGEX_CACHE_SIZE; ++i) {
+        Regex* slot = cache->slots[i];
+        if (!slot) {
+            found = i;
+            break;
+        }
+        if (slot->patternLength == length && wmemcmp(slot->pattern, pattern, length) == 0) {
+            found = i;
+            regex = slot;
+            break;
+        }
+    }
+
+    if (regex) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+        regex = malloc(sizeof(Regex));
+        if (!regex) {
+            *error = REGEX_ERROR_MEMORY;
+            return NULL;
+        }
+        *error = RegexCompile(regex, pattern, length);
+        if (*error != REGEX_OK) {
+            free(regex);
+            return NULL;
+        }
+        if (cache->slots[found]) {
+            RegexFree(cache->slots[found]);
+            free(cache->slots[found]);
+        }
+    }
+    // Most recently used first
+    memmove(cache->slots + 1, cache->slots, found * sizeof(Regex*));
+    cache->slots[0] = regex;
+    return regex;
+}
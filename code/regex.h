@@ -0,0 +1,120 @@
+#ifndef MCLIP_REGEX_H
+#define MCLIP_REGEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+// --- Regular Expressions ---
+// Case-insensitive regex filter, matched anywhere in a text (like a substring
+// query, not the whole text). Supported syntax:
+//
+//   abc  literal characters       .      any character except \n
+//   [a-z0-9_] [^...]  classes     \d \w \s, \D \W \S  digit, word, space (ASCII)
+//   \t \n \r \f \v \xHH \uHHHH    \. \* \\ ...  escaped characters
+//   (...) (?:...)  groups         a|b    alternation
+//   * + ?  {n} {n,} {n,m}         repetition ('{' without a valid count is literal)
+//   ^ $  start, end of the text   \b \B  word boundary, not a word boundary
+//
+// There is no backtracking: the pattern is compiled to a Thompson NFA and
+// matched by a DFA that is built lazily, one transition per new (state,
+// character class) pair, so a text costs O(length) once its transitions are
+// cached. The DFA has a fixed memory budget; when it fills up it is flushed
+// and rebuilt from the current position, which bounds the cost of a text at
+// O(length * NFA states) whatever the pattern. Characters are wchar_t units
+// (UTF-16 code units on Windows) folded with TextFoldChar, as everywhere
+// else in the engine.
+//
+// A Regex keeps its DFA between matches, so matching modifies it: one
+// thread at a time. RegexCache keeps the automata of recent patterns.
+
+#define REGEX_MAX_PATTERN 1024      // Longer patterns are refused (REGEX_ERROR_TOO_BIG)
+#define REGEX_MAX_STATES 8192       // NFA states, {n,m} copies included
+#define REGEX_MAX_DEPTH 64          // Nested groups
+#define REGEX_MAX_REPEAT 1000       // Largest count in {n,m}
+#define REGEX_DFA_BYTES (1u << 20)  // Transition tables and state sets of the DFA
+#define REGEX_DFA_MAX_STATES 4096
+#define REGEX_CACHE_SIZE 8          // Patterns kept by RegexCache
+
+typedef enum {
+    REGEX_OK = 0,
+    REGEX_ERROR_SYNTAX,   // Unbalanced (), unterminated [], bad escape or repetition
+    REGEX_ERROR_TOO_BIG,  // Pattern, nesting, counts or NFA past the limits above
+    REGEX_ERROR_MEMORY
+} RegexError;
+
+typedef struct {
+    uint8_t type;        // RegexStateType (regex.c)
+    uint32_t out;        // Next state
+    uint32_t out1;       // Second branch of a split
+    uint32_t set;        // Character set of a character state (index into 'sets')
+} RegexState;
+
+typedef struct {
+    uint32_t first;      // Class ranges of the set, in 'setClasses' ...
+    uint32_t count;
+} RegexSet;
+
+typedef struct {
+    uint16_t* sets;      // NFA state sets of the DFA states, back to back
+    size_t setsUsed;
+    size_t setsCapacity;
+    uint32_t* setStart;  // Per DFA state: its set ...
+    uint16_t* setLength;
+    uint8_t* flags;      // ... and its REGEX_DFA_* flags (regex.c)
+    int32_t* next;       // [state * classCount + class]: next state, or a REGEX_DFA_* sentinel
+    uint32_t* buckets;   // Hash of the sets: DFA state + 1, 0 = empty
+    size_t bucketCount;
+    uint32_t count;
+    uint32_t capacity;
+    int32_t start;       // State at the start of a text, -1 until built
+    size_t flushes;      // Times the budget ran out and the DFA was rebuilt (diagnostics)
+} RegexDfa;
+
+typedef struct {
+    wchar_t* pattern;    // Source (owned), the RegexCache key
+    size_t patternLength;
+
+    RegexState* states;  // NFA
+    uint32_t stateCount;
+    uint32_t startState;
+    RegexSet* sets;
+    uint32_t setCount;
+    uint32_t* setClasses; // [first, last] class pairs of the sets
+    uint32_t* bounds;    // Character classes: class i holds the characters [bounds[i], bounds[i + 1])
+    uint32_t classCount;
+    uint16_t byteClass[256]; // Class of each (folded) character below 256
+    uint8_t* wordClass;  // Per class: made of \w characters
+    bool wordAssertions; // Pattern uses \b or \B
+
+    RegexDfa dfa;
+    uint32_t* marks;     // Scratch for the DFA construction, per NFA state
+    uint32_t mark;
+    uint32_t* stack;
+    uint16_t* scratch;   // Set being built (and the resolved states of a step, after it)
+} Regex;
+
+typedef struct {
+    Regex* slots[REGEX_CACHE_SIZE]; // Most recently used first, NULL = empty
+    size_t hits;
+    size_t misses;
+} RegexCache;
+
+// Compiles 'pattern' (length in wchar_t units). On error 'regex' holds nothing to free.
+RegexError RegexCompile(Regex* regex, const wchar_t* pattern, size_t length);
+void RegexFree(Regex* regex);
+
+// True if the pattern matches somewhere in 'text'. Never fails: the DFA stays
+// within the memory allocated by RegexCompile.
+bool RegexMatch(Regex* regex, const wchar_t* text, size_t length);
+
+void RegexCacheInit(RegexCache* cache);
+void RegexCacheFree(RegexCache* cache);
+
+// The compiled 'pattern', compiling it (and evicting the least recently used
+// one) on a miss. NULL with *error set if it does not compile. The regex
+// belongs to the cache: valid until the next RegexCacheGet or RegexCacheFree.
+Regex* RegexCacheGet(RegexCache* cache, const wchar_t* pattern, size_t length, RegexError* error);
+
+#endif // MCLIP_REGEX_H
@@ -0,0 +1,174 @@
+#include "resultview.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void
+ResultViewInit(ResultView* view)
+{
+    memset(view, 0, sizeof(*view));
+}
+
+void
+ResultViewFree(ResultView* view)
+{
+    free(view->seqs);
+    memset(view, 0, sizeof(*view));
+}
+
+// SearchRun callback: appends the entry's sequence number, stops when out of memory
+static bool
+ResultViewCollect(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)index;
+    ResultView* view = context;
+    if (view->count == view->capacity) {
+        size_t capacity = view->capacity ? view->capacity * 2 : 256;
+        uint32_t* seqs = realloc(view->seqs, capacity * sizeof(uint32_t));
+        if (!seqs) return false;
+        view->seqs = seqs;
+        view->capacity = capacity;
+    }
+    view->seqs[view->count++] = entry->seq;
+    return true;
+}
+
+// Collects every entry in the view's order, stopping if memory runs out
+static bool
+ResultViewCollectAll(ResultView* view, const History* history)
+{
+    for (const HistoryEntry* entry = HistoryFirst(history, view->order); entry;
+         entry = HistoryNext(history, entry, view->order)) {
+        if (!ResultViewCollect(entry, 0, view)) return false;
+    }
+    return true;
+}
+
+typedef struct {
+    uint32_t uses;
+    uint32_t seq;
+    size_t row;          // Position among the hits: newer first
+} ResultViewUses;
+
+// qsort order: more uses first, then newer first
+static int
+ResultViewCompareUses(const void* a, const void* b)
+{
+    const ResultViewUses* x = a;
+    const ResultViewUses* y = b;
+    if (x->uses != y->uses) return x->uses > y->uses ? -1 : 1;
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+// Reorders hits collected newest first by use count. False if memory runs
+// out (the rows then stay newest first).
+static bool
+ResultViewSortByUses(ResultView* view, const History* history)
+{
+    if (view->count < 2) return true;
+    ResultViewUses* rows = malloc(view->count * sizeof(ResultViewUses));
+    if (!rows) return false;
+    for (size_t i = 0; i < view->count; ++i) {
+        rows[i].uses = HistoryFindSeq(history, view->seqs[i])->uses;
+        rows[i].seq = view->seqs[i];
+        rows[i].row = i;
+    }
+    qsort(rows, view->count, sizeof(ResultViewUses), ResultViewCompareUses);
+    for (size_t i = 0; i < view->count; ++i) view->seqs[i] = rows[i].seq;
+    free(rows);
+    return true;
+}
+
+static bool
+ResultViewRefreshFuzzy(ResultView* view, SearchState* search, const History* history,
+                       const wchar_t* pattern)
+{
+    const SearchRankedHit* hits = NULL;
+    size_t count = 0;
+    bool complete = SearchRunFuzzy(search, history, pattern, &hits, &count);
+
+    view->unfiltered = false;
+    view->ranked = true;
+    if (count > view->capacity) {
+        uint32_t* seqs = realloc(view->seqs, count * sizeof(uint32_t));
+        if (!seqs) return false;
+        view->seqs = seqs;
+        view->capacity = count;
+    }
+    for (size_t i = 0; i < count; ++i) view->seqs[i] = hits[i].seq;
+    view->count = count;
+    return complete;
+}
+
+// Rows for the text of a query, its metadata filter (if 'filtered') set on 'search'
+static bool
+ResultViewRefreshText(ResultView* view, SearchState* search, const History* history,
+                      const wchar_t* query, bool filtered)
+{
+    if (query[0] == RESULT_VIEW_FUZZY_PREFIX) {
+        return ResultViewRefreshFuzzy(view, search, history, query + 1);
+    }
+
+    if (query[0] == L'\0' && !filtered) {
+        // In insertion order the rows are the sequence numbers below the next one
+        view->unfiltered = view->order == HISTORY_ORDER_RECENT && HistorySeqOrdered(history);
+        if (!view->unfiltered) return ResultViewCollectAll(view, history);
+        view->count = HistoryCount(history);
+        view->newestSeq = history->nextSeq - 1;
+        return true;
+    }
+
+    view->unfiltered = false;
+    // The entry the collector failed on is counted as visited but not stored
+    bool regex = query[0] == RESULT_VIEW_REGEX_PREFIX;
+    size_t visited = regex ? SearchRunRegex(search, history, query + 1, ResultViewCollect, view)
+                           : SearchRun(search, history, query, ResultViewCollect, view);
+    bool complete = view->count == visited && !(regex && search->lastRegexError == REGEX_ERROR_MEMORY);
+    if (view->order == HISTORY_ORDER_FREQUENT) complete = ResultViewSortByUses(view, history) && complete;
+    return complete;
+}
+
+bool
+ResultViewRefresh(ResultView* view, SearchState* search, const History* history,
+                  const wchar_t* query)
+{
+    view->count = 0;
+    view->ranked = false;
+    if (query == NULL) query = L"";
+
+    // Metadata filters come out first (only a query with a colon can hold
+    // one); what is left is matched as text among the entries passing them
+    MetaQuery filter;
+    MetaQueryInit(&filter);
+    wchar_t* text = NULL;
+    if (wcschr(query, L':')) {
+        size_t length = wcslen(query);
+        text = malloc((length + 1) * sizeof(wchar_t));
+        if (!text) return false;
+        MetaQueryParse(&filter, query, length, (int64_t)time(NULL), text);
+        query = text;
+    }
+    view->unfiltered = false;
+    bool complete = SearchSetFilter(search, history, filter.active ? &filter : NULL) &&
+                    ResultViewRefreshText(view, search, history, query, filter.active);
+    free(text);
+    return complete;
+}
+
+size_t
+ResultViewCount(const ResultView* view)
+{
+    return view->count;
+}
+
+const HistoryEntry*
+ResultViewGet(const ResultView* view, const History* history, size_t row)
+{
+    if (row >= view->count) return NULL;
+
+    // Bottom row is the newest match
+    size_t age = view->count - 1 - row;
+    uint32_t seq = view->unfiltered ? view->newestSeq - (uint32_t)age : view->seqs[age];
+    return HistoryFindSeq(history, seq);
+}
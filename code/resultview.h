@@ -0,0 +1,62 @@
+#ifndef MCLIP_RESULTVIEW_H
+#define MCLIP_RESULTVIEW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include "history.h"
+#include "search.h"
+
+// --- Result View ---
+// Model behind the virtual (owner-data) result list. The UI control only knows
+// the row count and asks for visible rows as it paints them, so the text is
+// never copied into the control. Rows are numbered top to bottom, oldest match
+// first, matching the list's newest-at-the-bottom layout.
+//
+// Rows refer to entries by sequence number, so a view stays valid while the
+// history changes: rows whose entry was evicted since the refresh read as NULL.
+//
+// Other rows are in the view's HistoryOrder: most recently or most often
+// copied at the bottom. A query starting with RESULT_VIEW_FUZZY_PREFIX is a
+// fuzzy pattern (see fuzzy.h): rows are ranked by score, best match at the bottom.
+// One starting with RESULT_VIEW_REGEX_PREFIX is a regular expression (see
+// regex.h); a pattern that does not compile shows no rows.
+//
+// Metadata filters (app:, after:, before:, size:, type:, see meta.h) can go
+// anywhere in a query. They are taken out, and the rest is the text, pattern
+// or expression above, matched among the entries that pass them only.
+
+#define RESULT_VIEW_FUZZY_PREFIX L'~'
+#define RESULT_VIEW_REGEX_PREFIX L'/'
+
+typedef struct {
+    uint32_t* seqs;      // Matching entries, newest (or best) first (filtered views only)
+    size_t count;        // Number of rows
+    size_t capacity;
+    bool unfiltered;     // Every entry matches in insertion order: rows are computed, nothing collected
+    uint32_t newestSeq;  // Sequence number of the bottom row in an unfiltered view
+    bool ranked;         // Rows are in fuzzy score order
+    HistoryOrder order;  // Order of the other rows, set by the owner (ResultViewInit: HISTORY_ORDER_RECENT)
+} ResultView;
+
+void ResultViewInit(ResultView* view);
+void ResultViewFree(ResultView* view);
+
+// Rebuilds the rows for 'query' (NULL or empty shows every entry). An empty
+// query is O(1) while the history is in insertion order, otherwise a walk of
+// the history in the view's order (see HistoryFirst); other queries cost one
+// SearchRun (or SearchRunFuzzy, SearchRunRegex) plus 4 bytes per hit, and a sort of the hits
+// in HISTORY_ORDER_FREQUENT. Metadata filters add a scan of the columns they
+// filter on (see MetaQueryScan); times are relative to the current time.
+// Returns false if memory ran out; the view then holds the rows found so far.
+bool ResultViewRefresh(ResultView* view, SearchState* search, const History* history,
+                       const wchar_t* query);
+
+size_t ResultViewCount(const ResultView* view);
+
+// Entry shown in 'row' (0 = top), or NULL if out of range or evicted since the refresh
+const HistoryEntry* ResultViewGet(const ResultView* view, const History* history, size_t row);
+
+#endif // MCLIP_RESULTVIEW_H
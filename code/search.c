@@ -0,0 +1,464 @@
+#include "search.h"
+#include "platform.h"
+#include "textmatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void
+SearchInit(SearchState* search)
+{
+    memset(search, 0, sizeof(*search));
+    MetaQueryInit(&search->filter);
+    MetaQueryInit(&search->hitsFilter);
+}
+
+void
+SearchFree(SearchState* search)
+{
+    free(search->query);
+    free(search->hits);
+    free(search->ranked);
+    free(search->masks);
+    free(search->maskTags);
+    free(search->slots);
+    RegexCacheFree(&search->regexes);
+    memset(search, 0, sizeof(*search));
+}
+
+void
+SearchReset(SearchState* search)
+{
+    free(search->query);
+    search->query = NULL;
+    search->queryLength = 0;
+    search->hitCount = 0;
+}
+
+// --- Metadata Filter ---
+
+// Evaluates the filter over the history's current slots
+static bool
+SearchEvaluateFilter(SearchState* search, const History* history)
+{
+    size_t words = (history->capacity + 63) / 64;
+    if (words > search->slotWords) {
+        uint64_t* slots = realloc(search->slots, words * sizeof(uint64_t));
+        if (!slots) {
+            search->slotCount = 0;
+            return false;
+        }
+        search->slots = slots;
+        search->slotWords = words;
+    }
+    search->slotsSet = MetaQueryScan(&search->filter, &history->meta, &history->sources, history->capacity,
+                                     search->slots);
+    search->slotCount = history->capacity;
+    search->slotsGeneration = history->generation;
+    return true;
+}
+
+bool
+SearchSetFilter(SearchState* search, const History* history, const MetaQuery* filter)
+{
+    if (filter) {
+        memcpy(&search->filter, filter, sizeof(MetaQuery));
+    } else {
+        MetaQueryInit(&search->filter);
+    }
+    return !search->filter.active || SearchEvaluateFilter(search, history);
+}
+
+// Slots a run is limited to: false if memory ran out (nothing passes), else
+// *slots is the bitmap, or NULL without a filter
+static bool
+SearchFilterSlots(SearchState* search, const History* history, const uint64_t** slots)
+{
+    *slots = NULL;
+    if (!search->filter.active) return true;
+    bool current = search->slotCount == history->capacity && search->slotsGeneration == history->generation;
+    if (!current && !SearchEvaluateFilter(search, history)) return false;
+    *slots = search->slots;
+    return true;
+}
+
+static bool
+SearchPassesFilter(const History* history, const HistoryEntry* entry, const uint64_t* slots)
+{
+    return !slots || MetaSlotPasses(slots, (size_t)(entry - history->entries));
+}
+
+static bool
+SearchPushHit(SearchState* search, const HistoryEntry* entry, size_t index)
+{
+    if (search->hitCount == search->hitCapacity) {
+        size_t capacity = search->hitCapacity ? search->hitCapacity * 2 : 256;
+        SearchHit* hits = realloc(search->hits, capacity * sizeof(SearchHit));
+        if (!hits) return false;
+        search->hits = hits;
+        search->hitCapacity = capacity;
+    }
+    SearchHit* hit = &search->hits[search->hitCount++];
+    hit->seq = entry->seq;
+    hit->index = index;
+    return true;
+}
+
+// Polls the cancel flag every HISTORY_SCAN_POLL entries, like HistoryScan
+static bool
+SearchCancelled(SearchState* search, size_t step)
+{
+    if (!search->cancel || step % HISTORY_SCAN_POLL != 0) return false;
+    if (!PlatformAtomicLoad(search->cancel)) return false;
+    search->lastCancelled = true;
+    return true;
+}
+
+// Remembers 'query' as the key for the hits collected by this run
+static bool
+SearchRemember(SearchState* search, const wchar_t* query, size_t length)
+{
+    wchar_t* copy = malloc((length + 1) * sizeof(wchar_t));
+    if (!copy) return false;
+    memcpy(copy, query, length * sizeof(wchar_t));
+    copy[length] = L'\0';
+
+    free(search->query);
+    search->query = copy;
+    search->queryLength = length;
+    return true;
+}
+
+typedef struct {
+    SearchState* search;
+    HistoryVisitFn visit;
+    void* context;
+    bool complete;       // Every hit recorded and the visitor never stopped early
+} SearchCollector;
+
+// HistoryScan callback: records the hit, then forwards to the caller's visitor
+static bool
+SearchCollect(const HistoryEntry* entry, size_t index, void* context)
+{
+    SearchCollector* collector = context;
+    if (!SearchPushHit(collector->search, entry, index)) collector->complete = false;
+    if (!collector->visit(entry, index, collector->context)) {
+        collector->complete = false;
+        return false;
+    }
+    return true;
+}
+
+size_t
+SearchRun(SearchState* search, const History* history, const wchar_t* query,
+          HistoryVisitFn visit, void* context)
+{
+    if (!query) query = L"";
+    size_t queryLength = wcslen(query);
+
+    // Matches of a query are a subset of the matches of any substring of it
+    bool refine = search->query != NULL && !search->fuzzy &&
+                  search->generation == history->generation &&
+                  MetaQueryEqual(&search->filter, &search->hitsFilter) &&
+                  TextFindNoCase(query, queryLength, search->query, search->queryLength) != NULL;
+
+    size_t visited = 0;
+    bool complete = true;
+
+    search->lastRefined = refine;
+    search->lastCancelled = false;
+    search->lastTested = 0;
+
+    const uint64_t* slots;
+    if (!SearchFilterSlots(search, history, &slots)) {
+        SearchReset(search);
+        return 0;
+    }
+
+    if (refine) {
+        HistoryFilter filter;
+        HistoryPrepareFilter(&filter, query, queryLength);
+        size_t kept = 0;
+        for (size_t i = 0; i < search->hitCount; ++i) {
+            if (SearchCancelled(search, i)) {
+                complete = false;
+                break;
+            }
+            // Hits are compacted in place: kept <= i, so hits[i] is still unread
+            SearchHit hit = search->hits[i];
+            const HistoryEntry* entry = HistoryFindSeq(history, hit.seq);
+
+            if (queryLength > 0) {
+                search->lastTested++;
+                if (!HistoryEntryContains(history, entry, &filter)) continue;
+            }
+
+            search->hits[kept++] = hit;
+            visited++;
+            if (!visit(entry, hit.index, context)) {
+                complete = false;
+                break;
+            }
+        }
+        search->hitCount = kept;
+    } else {
+        // Full scan (trigram-accelerated when the history has an index)
+        SearchCollector collector = { search, visit, context, true };
+        HistoryScanControl control = { 0, search->cancel, false, slots, search->slotsSet };
+        search->hitCount = 0;
+        visited = HistoryScan(history, query, queryLength, SearchCollect, &collector, &control);
+        search->lastTested = control.tested;
+        search->lastCancelled = control.cancelled;
+        complete = collector.complete && !control.cancelled;
+    }
+
+    // Only keep results that cover the whole history
+    if (complete && SearchRemember(search, query, queryLength)) {
+        search->generation = history->generation;
+        search->fuzzy = false;
+        memcpy(&search->hitsFilter, &search->filter, sizeof(MetaQuery));
+    } else {
+        SearchReset(search);
+    }
+    return visited;
+}
+
+// --- Fuzzy Search ---
+
+// Sizes the mask cache for the history. Returns false (no prefilter) if memory is short.
+static bool
+SearchPrepareMasks(SearchState* search, const History* history)
+{
+    if (search->maskCapacity == history->capacity) return true;
+
+    free(search->masks);
+    free(search->maskTags);
+    search->masks = malloc(history->capacity * sizeof(uint64_t));
+    search->maskTags = calloc(history->capacity, sizeof(uint32_t));
+    if (!search->masks || !search->maskTags) {
+        free(search->masks);
+        free(search->maskTags);
+        search->masks = NULL;
+        search->maskTags = NULL;
+        search->maskCapacity = 0;
+        return false;
+    }
+    search->maskCapacity = history->capacity;
+    return true;
+}
+
+// Scores one candidate. False if it does not match; entries without a cached
+// mask get one, so the next pattern can reject them without their text.
+static bool
+SearchFuzzyTest(SearchState* search, const History* history, const HistoryEntry* entry,
+                const FuzzyPattern* fuzzy, bool useMasks, int32_t* score)
+{
+    const wchar_t* text = NULL;
+    if (useMasks) {
+        size_t slot = entry->seq % search->maskCapacity;
+        if (search->maskTags[slot] != entry->seq + 1) {
+            text = HistoryEntryText(history, entry);
+            if (!text) return false;
+            search->masks[slot] = FuzzyCharMask(text, entry->length);
+            search->maskTags[slot] = entry->seq + 1;
+        }
+        if ((fuzzy->mask & ~search->masks[slot]) != 0) return false;
+    }
+
+    search->lastTested++;
+    if (!text) text = HistoryEntryText(history, entry);
+    return text && FuzzyMatch(fuzzy, text, entry->length, score);
+}
+
+static bool
+SearchPushRanked(SearchState* search, size_t* count, const HistoryEntry* entry, int32_t score, size_t index)
+{
+    if (*count == search->rankedCapacity) {
+        size_t capacity = search->rankedCapacity ? search->rankedCapacity * 2 : 256;
+        SearchRankedHit* ranked = realloc(search->ranked, capacity * sizeof(SearchRankedHit));
+        if (!ranked) return false;
+        search->ranked = ranked;
+        search->rankedCapacity = capacity;
+    }
+    SearchRankedHit* hit = &search->ranked[(*count)++];
+    hit->seq = entry->seq;
+    hit->score = score;
+    hit->index = index;
+    return true;
+}
+
+// qsort order: higher score first, then newer first
+static int
+SearchCompareRanked(const void* a, const void* b)
+{
+    const SearchRankedHit* x = a;
+    const SearchRankedHit* y = b;
+    if (x->score != y->score) return x->score > y->score ? -1 : 1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// Sort key of a score: unsigned, ascending for descending scores
+static inline uint32_t
+SearchRankKey(int32_t score)
+{
+    return ~((uint32_t)score ^ 0x80000000u);
+}
+
+// Sorts hits collected newest first into rank order. A stable LSD radix sort
+// on the score keeps equal scores newest first; bytes that are the same in
+// every key (usually the top two) are skipped. Falls back to qsort if the
+// scratch buffer can't be allocated.
+static void
+SearchSortRanked(SearchRankedHit* hits, size_t count)
+{
+    SearchRankedHit* scratch = malloc(count * sizeof(SearchRankedHit));
+    if (!scratch) {
+        qsort(hits, count, sizeof(SearchRankedHit), SearchCompareRanked);
+        return;
+    }
+
+    SearchRankedHit* from = hits;
+    SearchRankedHit* to = scratch;
+    for (unsigned shift = 0; shift < 32; shift += 8) {
+        size_t offsets[256] = {0};
+        for (size_t i = 0; i < count; ++i) offsets[(SearchRankKey(from[i].score) >> shift) & 0xFF]++;
+        if (offsets[(SearchRankKey(from[0].score) >> shift) & 0xFF] == count) continue;
+
+        size_t sum = 0;
+        for (size_t b = 0; b < 256; ++b) {
+            size_t n = offsets[b];
+            offsets[b] = sum;
+            sum += n;
+        }
+        for (size_t i = 0; i < count; ++i) to[offsets[(SearchRankKey(from[i].score) >> shift) & 0xFF]++] = from[i];
+        SearchRankedHit* swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != hits) memcpy(hits, from, count * sizeof(SearchRankedHit));
+    free(scratch);
+}
+
+bool
+SearchRunFuzzy(SearchState* search, const History* history, const wchar_t* pattern,
+               const SearchRankedHit** hits, size_t* count)
+{
+    if (!pattern) pattern = L"";
+    size_t patternLength = wcslen(pattern);
+
+    FuzzyPattern fuzzy;
+    FuzzyCompile(&fuzzy, pattern, patternLength);
+    bool useMasks = fuzzy.termCount > 0 && SearchPrepareMasks(search, history);
+
+    // Every term of an extended pattern extends a term of the old one (or is
+    // new), so its matches are a subset of the old matches
+    bool refine = search->query != NULL && search->fuzzy &&
+                  search->generation == history->generation &&
+                  MetaQueryEqual(&search->filter, &search->hitsFilter) &&
+                  patternLength >= search->queryLength &&
+                  wmemcmp(pattern, search->query, search->queryLength) == 0;
+
+    size_t found = 0;
+    bool complete = true;
+
+    search->lastRefined = refine;
+    search->lastCancelled = false;
+    search->lastTested = 0;
+
+    const uint64_t* slots;
+    if (!SearchFilterSlots(search, history, &slots)) {
+        SearchReset(search);
+        *hits = search->ranked;
+        *count = 0;
+        return false;
+    }
+
+    if (refine) {
+        size_t kept = 0;
+        for (size_t i = 0; i < search->hitCount; ++i) {
+            if (SearchCancelled(search, i)) {
+                complete = false;
+                break;
+            }
+            SearchHit hit = search->hits[i];
+            const HistoryEntry* entry = HistoryFindSeq(history, hit.seq);
+            int32_t score = 0;
+            if (!SearchFuzzyTest(search, history, entry, &fuzzy, useMasks, &score)) continue;
+
+            search->hits[kept++] = hit;
+            if (!SearchPushRanked(search, &found, entry, score, hit.index)) {
+                complete = false;
+                break;
+            }
+        }
+        search->hitCount = kept;
+    } else {
+        search->hitCount = 0;
+        size_t index = 0;
+        for (const HistoryEntry* entry = HistoryFirst(history, HISTORY_ORDER_RECENT); entry;
+             entry = HistoryNext(history, entry, HISTORY_ORDER_RECENT), ++index) {
+            if (SearchCancelled(search, index)) {
+                complete = false;
+                break;
+            }
+            int32_t score = 0;
+            if (!SearchPassesFilter(history, entry, slots)) continue;
+            if (!SearchFuzzyTest(search, history, entry, &fuzzy, useMasks, &score)) continue;
+
+            if (!SearchPushHit(search, entry, index) || !SearchPushRanked(search, &found, entry, score, index)) {
+                complete = false;
+                break;
+            }
+        }
+    }
+
+    if (found > 1 && !search->lastCancelled) SearchSortRanked(search->ranked, found);
+    *hits = search->ranked;
+    *count = found;
+
+    if (complete && SearchRemember(search, pattern, patternLength)) {
+        search->generation = history->generation;
+        search->fuzzy = true;
+        memcpy(&search->hitsFilter, &search->filter, sizeof(MetaQuery));
+    } else {
+        SearchReset(search);
+    }
+    return complete;
+}
+
+// --- Regex Search ---
+
+size_t
+SearchRunRegex(SearchState* search, const History* history, const wchar_t* pattern,
+               HistoryVisitFn visit, void* context)
+{
+    if (!pattern) pattern = L"";
+
+    // Regex hits can't be refined by a later substring query
+    SearchReset(search);
+    search->lastRefined = false;
+    search->lastCancelled = false;
+    search->lastTested = 0;
+
+    Regex* regex = RegexCacheGet(&search->regexes, pattern, wcslen(pattern), &search->lastRegexError);
+    if (!regex) return 0;
+    const uint64_t* slots;
+    if (!SearchFilterSlots(search, history, &slots)) {
+        search->lastRegexError = REGEX_ERROR_MEMORY;
+        return 0;
+    }
+
+    size_t visited = 0;
+    size_t index = 0;
+    for (const HistoryEntry* entry = HistoryFirst(history, HISTORY_ORDER_RECENT); entry;
+         entry = HistoryNext(history, entry, HISTORY_ORDER_RECENT), ++index) {
+        if (SearchCancelled(search, index)) break;
+        if (!SearchPassesFilter(history, entry, slots)) continue;
+        search->lastTested++;
+        const wchar_t* text = HistoryEntryText(history, entry);
+        if (!text || !RegexMatch(regex, text, entry->length)) continue;
+        visited++;
+        if (!visit(entry, index, context)) break;
+    }
+    return visited;
+}
@@ -0,0 +1,108 @@
+#ifndef MCLIP_SEARCH_H
+#define MCLIP_SEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include "fuzzy.h"
+#include "history.h"
+#include "meta.h"
+#include "regex.h"
+
+// --- Incremental Search ---
+// Remembers the previous query and the entries it matched. When the
+// next query contains the previous one (the user typed more characters) and
+// the history generation is unchanged, only the previous hits are re-tested,
+// so each keystroke works on a shrinking candidate set instead of a full scan.
+//
+// Fuzzy runs (SearchRunFuzzy) rank their hits by FuzzyMatch score. They refine
+// the same way when the pattern was only extended at the end, and keep a
+// character mask per entry so entries lacking a pattern character are
+// rejected without touching their text again.
+//
+// Regex runs (SearchRunRegex) always scan every entry: a longer pattern can
+// match more than a shorter one. Their compiled automata are kept in a
+// RegexCache, so retyping or re-running a pattern skips the compilation and
+// starts with the DFA transitions earlier runs built.
+//
+// All three can be limited by a metadata filter (SearchSetFilter, see
+// meta.h): it is evaluated over the metadata columns into a bitmap of slots
+// first, and entries outside it are skipped without their text being
+// looked at. Hits are only refined under the same filter.
+
+// An entry a query matched
+typedef struct {
+    uint32_t seq;            // Entry sequence number, to find it again in O(1) ...
+    size_t index;            // ... and its recency index (0 = newest)
+} SearchHit;
+
+typedef struct {
+    uint32_t seq;            // Entry sequence number
+    int32_t score;           // FuzzyMatch score
+    size_t index;            // Recency index (0 = newest), the tie-breaker
+} SearchRankedHit;
+
+typedef struct {
+    wchar_t* query;          // Previous query (owned), NULL when nothing is cached
+    size_t queryLength;
+    SearchHit* hits;         // Entries matched by 'query', newest first
+    size_t hitCount;
+    size_t hitCapacity;
+    uint64_t generation;     // History generation 'hits' refer to
+    bool fuzzy;              // 'query' and 'hits' come from SearchRunFuzzy
+    size_t lastTested;       // Entries tested by the last run (diagnostics)
+    bool lastRefined;        // Last run reused previous hits
+    bool lastCancelled;      // Last run was stopped by 'cancel'; its results are partial
+    const volatile int32_t* cancel; // Runs stop early once this flag is nonzero (NULL = never), see HistoryScanControl
+
+    SearchRankedHit* ranked; // Hits of the last fuzzy run, best first
+    size_t rankedCapacity;
+    uint64_t* masks;         // FuzzyCharMask per entry, in slot seq % maskCapacity ...
+    uint32_t* maskTags;      // ... valid if the tag is seq + 1
+    size_t maskCapacity;
+
+    MetaQuery filter;        // Metadata filter of the runs (SearchSetFilter)
+    MetaQuery hitsFilter;    // ... and the one 'hits' were found under
+    uint64_t* slots;         // Slots passing 'filter' (MetaQueryScan) ...
+    size_t slotWords;        // ... room in 'slots' ...
+    size_t slotCount;        // ... slots evaluated ...
+    uint64_t slotsGeneration; // ... at this history generation
+    size_t slotsSet;         // Bits set in 'slots'
+
+        RegexCache regexes;      // Automata of recent regex patterns
+    RegexError lastRegexError; // Why the last regex run found nothing, REGEX_OK if it ran
+} SearchState;
+
+void SearchInit(SearchState* search);
+void SearchFree(SearchState* search);
+
+// Drops cached results; the next run does a full scan
+void SearchReset(SearchState* search);
+
+// Limits the runs that follow to entries passing 'filter' (NULL: no limit)
+// and evaluates it over the metadata of the history. Runs re-evaluate it once
+// the history changed. False if memory ran out: runs then find nothing.
+bool SearchSetFilter(SearchState* search, const History* history, const MetaQuery* filter);
+
+// Visits entries containing 'query' (case-insensitive), newest first, like
+// HistoryForEachMatch. Returns number of entries visited.
+size_t SearchRun(SearchState* search, const History* history, const wchar_t* query,
+                 HistoryVisitFn visit, void* context);
+
+// Finds entries matching the fuzzy 'pattern' (see fuzzy.h), best first; equal
+// scores (e.g. every entry for an empty pattern) are ordered newest first.
+// *hits is valid until the next run. Returns false if memory ran out or the
+// run was cancelled; *hits then holds the hits found so far (unsorted if cancelled).
+bool SearchRunFuzzy(SearchState* search, const History* history, const wchar_t* pattern,
+                    const SearchRankedHit** hits, size_t* count);
+
+// Visits entries matching the regular expression 'pattern' (see regex.h),
+// newest first, like SearchRun. A pattern that does not compile visits
+// nothing and leaves the reason in search->lastRegexError. Returns number of
+// entries visited.
+size_t SearchRunRegex(SearchState* search, const History* history, const wchar_t* pattern,
+                      HistoryVisitFn visit, void* context);
+
+#endif // MCLIP_SEARCH_H
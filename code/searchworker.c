@@ -0,0 +1,229 @@
+#include "searchworker.h"
+
+#include <string.h>
+
+// Runs one search with the history lock held. Returns false if it was cancelled.
+static bool
+SearchWorkerRun(SearchWorker* worker, const wchar_t* query, HistoryOrder order, bool* complete, uint64_t* elapsed)
+{
+    worker->building.order = order;
+    PlatformLockAcquire(worker->historyLock);
+    worker->search.lastCancelled = false; // Empty queries don't run a search that would reset it
+    uint64_t start = PlatformNowNs();
+    *complete = ResultViewRefresh(&worker->building, &worker->search, worker->history, query);
+    *elapsed = PlatformNowNs() - start;
+    PlatformLockRelease(worker->historyLock);
+    return !worker->search.lastCancelled;
+}
+
+static void
+SearchWorkerMain(void* context)
+{
+    SearchWorker* worker = context;
+    wchar_t query[SEARCH_WORKER_MAX_QUERY + 1];
+
+    PlatformLockAcquire(worker->state);
+    for (;;) {
+        // Preempting lockers go first, so the worker doesn't grab the history back
+        while (!worker->stopping && (!worker->pending || worker->preempting > 0)) {
+            PlatformLockWait(worker->state);
+        }
+        if (worker->stopping) break;
+
+        memcpy(query, worker->query, sizeof(query));
+        HistoryOrder order = worker->order;
+        uint64_t requestId = worker->requestId;
+        worker->pending = false;
+        worker->running = true;
+        PlatformAtomicStore(&worker->cancel, 0);
+        PlatformLockRelease(worker->state);
+
+        bool complete = false;
+        uint64_t elapsed = 0;
+        bool finished = SearchWorkerRun(worker, query, order, &complete, &elapsed);
+
+        PlatformLockAcquire(worker->state);
+        bool notify = false;
+        if (!finished) {
+            // Preempted: search again unless a newer query replaced this one
+            worker->cancelled++;
+            if (requestId == worker->requestId) worker->pending = true;
+        } else {
+            worker->completed++;
+            LatencyHistogramRecord(&worker->latency, elapsed);
+            if (query[0] != L'\0') {
+                worker->lastSearchNs = elapsed;
+                worker->averageSearchNs = worker->averageSearchNs
+                                              ? (worker->averageSearchNs * 3 + elapsed) / 4
+                                              : elapsed;
+            }
+            if (requestId == worker->requestId) {
+                ResultView swap = worker->ready;
+                worker->ready = worker->building;
+                worker->building = swap;
+                worker->readyId = requestId;
+                worker->readyComplete = complete;
+                worker->hasReady = true;
+                notify = worker->notify != NULL;
+            }
+        }
+
+        // Still 'running' while notifying, so SearchWorkerWaitIdle covers the callback
+        if (notify) {
+            PlatformLockRelease(worker->state);
+            worker->notify(worker->notifyContext);
+            PlatformLockAcquire(worker->state);
+        }
+        worker->running = false;
+        PlatformLockWake(worker->state); // SearchWorkerWaitIdle
+    }
+    PlatformLockRelease(worker->state);
+}
+
+bool
+SearchWorkerStart(SearchWorker* worker, History* history, SearchWorkerNotifyFn notify, void* context)
+{
+    memset(worker, 0, sizeof(*worker));
+    worker->history = history;
+    worker->notify = notify;
+    worker->notifyContext = context;
+    SearchInit(&worker->search);
+    ResultViewInit(&worker->building);
+    ResultViewInit(&worker->ready);
+    worker->search.cancel = &worker->cancel;
+
+    worker->historyLock = PlatformLockCreate();
+    worker->state = PlatformLockCreate();
+    if (worker->historyLock && worker->state) {
+        worker->thread = PlatformThreadStart(SearchWorkerMain, worker);
+    }
+    if (!worker->thread) {
+        SearchWorkerStop(worker);
+        return false;
+    }
+    return true;
+}
+
+void
+SearchWorkerStop(SearchWorker* worker)
+{
+    if (worker->thread) {
+        PlatformLockAcquire(worker->state);
+        worker->stopping = true;
+        PlatformAtomicStore(&worker->cancel, 1);
+        PlatformLockWake(worker->state);
+        PlatformLockRelease(worker->state);
+        PlatformThreadJoin(worker->thread);
+    }
+    PlatformLockDestroy(worker->historyLock);
+    PlatformLockDestroy(worker->state);
+    SearchFree(&worker->search);
+    ResultViewFree(&worker->building);
+    ResultViewFree(&worker->ready);
+    memset(worker, 0, sizeof(*worker));
+}
+
+uint64_t
+SearchWorkerSubmit(SearchWorker* worker, const wchar_t* query)
+{
+    size_t length = query ? wcslen(query) : 0;
+    if (length > SEARCH_WORKER_MAX_QUERY) length = SEARCH_WORKER_MAX_QUERY;
+
+    PlatformLockAcquire(worker->state);
+    if (length > 0) memcpy(worker->query, query, length * sizeof(wchar_t));
+    worker->query[length] = L'\0';
+    uint64_t requestId = ++worker->requestId;
+    worker->pending = true;
+    worker->hasReady = false; // Older results are stale now
+    if (worker->running) PlatformAtomicStore(&worker->cancel, 1);
+    PlatformLockWake(worker->state);
+    PlatformLockRelease(worker->state);
+    return requestId;
+}
+
+void
+SearchWorkerSetOrder(SearchWorker* worker, HistoryOrder order)
+{
+    PlatformLockAcquire(worker->state);
+    worker->order = order;
+    PlatformLockRelease(worker->state);
+}
+
+bool
+SearchWorkerTakeResults(SearchWorker* worker, ResultView* view, uint64_t* requestId)
+{
+    PlatformLockAcquire(worker->state);
+    bool taken = worker->hasReady;
+    if (taken) {
+        ResultView swap = *view;
+        *view = worker->ready;
+        worker->ready = swap;
+        worker->hasReady = false;
+        if (requestId) *requestId = worker->readyId;
+    }
+    PlatformLockRelease(worker->state);
+    return taken;
+}
+
+void
+SearchWorkerWaitIdle(SearchWorker* worker)
+{
+    PlatformLockAcquire(worker->state);
+    while ((worker->pending || worker->running) && !worker->stopping) {
+        PlatformLockWait(worker->state);
+    }
+    PlatformLockRelease(worker->state);
+}
+
+void
+SearchWorkerLockHistory(SearchWorker* worker, bool preempt)
+{
+    if (preempt) {
+        PlatformLockAcquire(worker->state);
+        worker->preempting++;
+        if (worker->running) PlatformAtomicStore(&worker->cancel, 1);
+        PlatformLockRelease(worker->state);
+    }
+    PlatformLockAcquire(worker->historyLock);
+}
+
+void
+SearchWorkerUnlockHistory(SearchWorker* worker, bool preempt)
+{
+    PlatformLockRelease(worker->historyLock);
+    if (preempt) {
+        PlatformLockAcquire(worker->state);
+        worker->preempting--;
+        PlatformLockWake(worker->state);
+        PlatformLockRelease(worker->state);
+    }
+}
+
+bool
+SearchWorkerTryLockHistory(SearchWorker* worker)
+{
+    return PlatformLockTryAcquire(worker->historyLock);
+}
+
+unsigned
+SearchWorkerDebounceMs(SearchWorker* worker)
+{
+    PlatformLockAcquire(worker->state);
+    uint64_t average = worker->averageSearchNs;
+    PlatformLockRelease(worker->state);
+
+    // Twice the usual cost: keystrokes closer together than that replace the
+    // query before any work is spent on it
+    if (average < SEARCH_WORKER_INSTANT_NS) return 0;
+    uint64_t delay = average * 2 / 1000000u;
+    return delay > SEARCH_WORKER_MAX_DEBOUNCE_MS ? SEARCH_WORKER_MAX_DEBOUNCE_MS : (unsigned)delay;
+}
+
+void
+SearchWorkerMetrics(SearchWorker* worker, Metrics* metrics)
+{
+    PlatformLockAcquire(worker->state);
+    LatencyHistogramMerge(&metrics->stages[METRIC_SEARCH], &worker->latency);
+    MetricsCount(metrics, METRIC_SEARCHES_CANCELLED, worker->cancelled);
+    PlatformLockRelease(worker->state);
+}
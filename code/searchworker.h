@@ -0,0 +1,114 @@
+#ifndef MCLIP_SEARCHWORKER_H
+#define MCLIP_SEARCHWORKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include "history.h"
+#include "metrics.h"
+#include "platform.h"
+#include "resultview.h"
+#include "search.h"
+
+// --- Background Search ---
+// Runs ResultViewRefresh on a worker thread so typing never waits for a scan.
+// The UI submits the query on every (debounced) keystroke; a newer query
+// cancels the search still running for an older one, which stops within
+// HISTORY_SCAN_POLL entries. Finished results are handed back through
+// 'notify' (on the worker thread; the app posts a window message) and taken
+// with SearchWorkerTakeResults, which swaps views instead of copying rows.
+//
+// The worker owns the incremental SearchState. The history itself is shared:
+// every access from another thread, reads included (entry text may be
+// decompressed into a shared cache), must be bracketed by
+// SearchWorkerLockHistory / SearchWorkerUnlockHistory. A preempting lock
+// (for changes to the history) makes a running search stop and retry once
+// the lock is released, so the caller waits microseconds, not a whole scan.
+//
+// SearchWorkerDebounceMs turns the measured cost of recent searches into the
+// delay the UI should wait after a keystroke: none while searches are cheap,
+// up to SEARCH_WORKER_MAX_DEBOUNCE_MS when they are not.
+
+#define SEARCH_WORKER_MAX_QUERY 256          // Characters kept from a query
+#define SEARCH_WORKER_INSTANT_NS 2000000ull  // Searches cheaper than this (on average) run without delay
+#define SEARCH_WORKER_MAX_DEBOUNCE_MS 300
+
+// Called on the worker thread when new results are ready
+typedef void (*SearchWorkerNotifyFn)(void* context);
+
+typedef struct {
+    History* history;
+    PlatformLock* historyLock;   // Guards the history (see above)
+    PlatformLock* state;         // Guards the fields below, and is the worker's wake-up signal
+    PlatformThread* thread;
+    SearchWorkerNotifyFn notify;
+    void* notifyContext;
+
+    wchar_t query[SEARCH_WORKER_MAX_QUERY + 1]; // Latest submitted query
+    HistoryOrder order;          // Row order of the results (SearchWorkerSetOrder)
+    uint64_t requestId;          // Id of the latest submission
+    bool pending;                // 'query' has not been searched yet
+    bool running;                // A search is in progress
+    bool stopping;
+    size_t preempting;           // Threads waiting for the history through a preempting lock
+    volatile int32_t cancel;     // Polled by the running search (SearchState.cancel)
+
+    SearchState search;          // Worker thread only
+    ResultView building;         // Worker thread only: the view being filled
+    ResultView ready;            // Latest finished results, not yet taken
+    uint64_t readyId;            // Request the ready view answers
+    bool hasReady;
+    bool readyComplete;          // False if memory ran out while collecting 'ready'
+
+    uint64_t lastSearchNs;       // Cost of the last completed non-empty search
+    uint64_t averageSearchNs;    // Moving average of the same
+    uint64_t completed;          // Searches finished / cancelled (diagnostics)
+    uint64_t cancelled;
+    LatencyHistogram latency;    // Of the finished searches
+} SearchWorker;
+
+// Starts the worker for 'history'. 'notify' may be NULL (poll with
+// SearchWorkerTakeResults or SearchWorkerWaitIdle). Returns false if the
+// thread or its locks could not be created.
+bool SearchWorkerStart(SearchWorker* worker, History* history, SearchWorkerNotifyFn notify, void* context);
+
+// Cancels any search, stops the thread and frees everything. Safe on a zeroed worker.
+void SearchWorkerStop(SearchWorker* worker);
+
+// Queues a search for 'query' (NULL or empty: every entry; see
+// ResultViewRefresh for the syntax), replacing any queued one and cancelling
+// a running one. Returns the request id.
+uint64_t SearchWorkerSubmit(SearchWorker* worker, const wchar_t* query);
+
+// Orders the results of the next submissions (see ResultView.order)
+void SearchWorkerSetOrder(SearchWorker* worker, HistoryOrder order);
+
+// Swaps the latest finished results into 'view' (its old rows are recycled).
+// Returns false if there are none. *requestId (optional) gets the request
+// they answer; results of superseded requests are never handed out.
+bool SearchWorkerTakeResults(SearchWorker* worker, ResultView* view, uint64_t* requestId);
+
+// Blocks until nothing is queued or running
+void SearchWorkerWaitIdle(SearchWorker* worker);
+
+// Access to the history from any thread but the worker. With 'preempt' a
+// running search is cancelled and retried afterwards; use it before changing
+// the history. Not reentrant.
+void SearchWorkerLockHistory(SearchWorker* worker, bool preempt);
+void SearchWorkerUnlockHistory(SearchWorker* worker, bool preempt);
+
+// Takes the history only if nothing holds it, for painting, which must not
+// wait out a search: false while one runs (repaint when its results arrive).
+// Release with SearchWorkerUnlockHistory(worker, false).
+bool SearchWorkerTryLockHistory(SearchWorker* worker);
+
+// Milliseconds to wait after a keystroke before submitting, from the cost of
+// recent searches
+unsigned SearchWorkerDebounceMs(SearchWorker* worker);
+
+// Adds the worker's search latencies (METRIC_SEARCH) and cancellations to 'metrics'
+void SearchWorkerMetrics(SearchWorker* worker, Metrics* metrics);
+
+#endif // MCLIP_SEARCHWORKER_H
@@ -0,0 +1,206 @@
+#include "snapshot.h"
+#include "utf8.h"
+
+#include <string.h>
+
+#define SNAPSHOT_ALIGN 8
+#define SNAPSHOT_MIN_BUFFER 256 // Smallest buffer SnapshotWriterOpen accepts
+
+static size_t
+SnapshotAlign(size_t size)
+{
+    return (size + SNAPSHOT_ALIGN - 1) & ~(size_t)(SNAPSHOT_ALIGN - 1);
+}
+
+// --- Writer ---
+
+bool
+SnapshotWriterOpen(SnapshotWriter* writer, const char* name, size_t bytes)
+{
+    memset(writer, 0, sizeof(*writer));
+    size_t headerBytes = SnapshotAlign(sizeof(SnapshotHeader));
+    if (bytes < headerBytes + 2 * SNAPSHOT_MIN_BUFFER) return false;
+    size_t bufferBytes = ((bytes - headerBytes) / 2) & ~(size_t)(SNAPSHOT_ALIGN - 1);
+    if (bufferBytes > UINT32_MAX) bufferBytes = UINT32_MAX & ~(size_t)(SNAPSHOT_ALIGN - 1); // Text offsets are 32-bit
+    if (!PlatformSharedCreate(&writer->shared, name, headerBytes + 2 * bufferBytes)) return false;
+
+    SnapshotHeader* header = writer->shared.data;
+    header->version = SNAPSHOT_VERSION;
+    header->size = writer->shared.size;
+    header->current = -1;
+    for (int i = 0; i < 2; ++i) {
+        header->slots[i].offset = headerBytes + i * bufferBytes;
+        header->slots[i].capacity = bufferBytes;
+    }
+    // Last: a reader that sees the magic sees the layout
+    PlatformAtomicFence();
+    header->magic = SNAPSHOT_MAGIC;
+    writer->header = header;
+    return true;
+}
+
+void
+SnapshotWriterClose(SnapshotWriter* writer)
+{
+    PlatformSharedClose(&writer->shared);
+    memset(writer, 0, sizeof(*writer));
+}
+
+void
+SnapshotWriterBegin(SnapshotWriter* writer, uint64_t generation, uint32_t order, size_t total)
+{
+    SnapshotHeader* header = writer->header;
+    int32_t slot = header->current == 0 ? 1 : 0; // Only this thread writes 'current'
+    SnapshotSlot* target = &header->slots[slot];
+    PlatformAtomicStore(&target->seq, target->seq + 1); // Odd: reads still on this buffer fail validation
+    PlatformAtomicFence();
+
+    SnapshotContents* contents = (SnapshotContents*)((uint8_t*)header + target->offset);
+    size_t room = target->capacity - sizeof(SnapshotContents);
+    size_t capacity = room / sizeof(SnapshotEntry);
+    if (total > UINT32_MAX) total = UINT32_MAX;
+    if (capacity > total) capacity = total;
+
+    contents->generation = generation;
+    contents->order = order;
+    contents->count = 0;
+    contents->total = (uint32_t)total;
+    contents->withText = 0;
+    contents->textBytes = 0;
+    writer->contents = contents;
+    writer->slot = slot;
+    writer->capacity = (uint32_t)capacity;
+    writer->textUsed = 0;
+    writer->textCapacity = room - capacity * sizeof(SnapshotEntry);
+}
+
+bool
+SnapshotWriterTextFits(const SnapshotWriter* writer, size_t length)
+{
+    // UTF-8 takes at least a byte per character, plus the terminator
+    return writer->contents && length < writer->textCapacity - writer->textUsed;
+}
+
+bool
+SnapshotWriterAdd(SnapshotWriter* writer, uint32_t seq, uint32_t uses, const wchar_t* text, size_t length)
+{
+    SnapshotContents* contents = writer->contents;
+    if (!contents || contents->count >= writer->capacity) return false;
+
+    SnapshotEntry* entry = (SnapshotEntry*)(contents + 1) + contents->count++;
+    entry->seq = seq;
+    entry->uses = uses;
+    entry->bytes = 0;
+    entry->textOffset = SNAPSHOT_NO_TEXT;
+    if (!text || !SnapshotWriterTextFits(writer, length)) return true;
+
+    size_t bytes = Utf8EncodedSize(text, length);
+    if (bytes == UTF8_INVALID || bytes >= writer->textCapacity - writer->textUsed) return true;
+    size_t offset = sizeof(SnapshotContents) + writer->capacity * sizeof(SnapshotEntry) + writer->textUsed;
+    char* out = (char*)contents + offset;
+    Utf8Encode(text, length, out);
+    out[bytes] = '\0';
+    entry->bytes = (uint32_t)bytes;
+    entry->textOffset = (uint32_t)offset;
+    writer->textUsed += bytes + 1;
+    contents->withText++;
+    return true;
+}
+
+void
+SnapshotWriterCommit(SnapshotWriter* writer)
+{
+    SnapshotHeader* header = writer->header;
+    SnapshotSlot* target = &header->slots[writer->slot];
+    writer->contents->textBytes = writer->textUsed;
+    PlatformAtomicFence(); // The contents are complete before the buffer is marked so
+    PlatformAtomicStore(&target->seq, target->seq + 1);
+    PlatformAtomicStore(&header->current, writer->slot);
+    header->publishes++;
+    writer->contents = NULL;
+}
+
+// --- Reader ---
+
+bool
+SnapshotReaderOpen(SnapshotReader* reader, const char* name)
+{
+    memset(reader, 0, sizeof(*reader));
+    if (!PlatformSharedOpen(&reader->shared, name)) return false;
+
+    const SnapshotHeader* header = reader->shared.data;
+    size_t size = reader->shared.size;
+    bool valid = size >= sizeof(SnapshotHeader) && header->magic == SNAPSHOT_MAGIC &&
+                 header->version == SNAPSHOT_VERSION && header->size <= size;
+    for (int i = 0; valid && i < 2; ++i) {
+        uint64_t offset = header->slots[i].offset;
+        uint64_t capacity = header->slots[i].capacity;
+        valid = offset >= sizeof(SnapshotHeader) && offset % SNAPSHOT_ALIGN == 0 &&
+                capacity >= sizeof(SnapshotContents) && capacity <= UINT32_MAX &&
+                offset <= size && capacity <= size - offset;
+        reader->offsets[i] = offset;
+        reader->capacities[i] = capacity;
+    }
+    if (!valid) {
+        SnapshotReaderClose(reader);
+        return false;
+    }
+    reader->header = header;
+    return true;
+}
+
+void
+SnapshotReaderClose(SnapshotReader* reader)
+{
+    PlatformSharedClose(&reader->shared);
+    memset(reader, 0, sizeof(*reader));
+}
+
+bool
+SnapshotReadBegin(const SnapshotReader* reader, SnapshotView* view)
+{
+    memset(view, 0, sizeof(*view));
+    int32_t slot = PlatformAtomicLoad(&reader->header->current);
+    if (slot != 0 && slot != 1) return false;
+    int32_t seq = PlatformAtomicLoad(&reader->header->slots[slot].seq);
+    if (seq & 1) return false;
+
+    view->base = (const uint8_t*)reader->header + reader->offsets[slot];
+    view->capacity = (size_t)reader->capacities[slot];
+    view->slot = slot;
+    view->seq = seq;
+
+    const SnapshotContents* contents = (const SnapshotContents*)view->base;
+    size_t fits = (view->capacity - sizeof(SnapshotContents)) / sizeof(SnapshotEntry);
+    view->generation = contents->generation;
+    view->order = contents->order;
+    view->count = contents->count <= fits ? contents->count : (uint32_t)fits;
+    view->total = contents->total;
+    view->withText = contents->withText;
+    return true;
+}
+
+bool
+SnapshotViewEntry(const SnapshotView* view, size_t index, SnapshotEntry* entry)
+{
+    if (index >= view->count) return false;
+    memcpy(entry, view->base + sizeof(SnapshotContents) + index * sizeof(SnapshotEntry), sizeof(*entry));
+    return true;
+}
+
+const char*
+SnapshotViewText(const SnapshotView* view, const SnapshotEntry* entry)
+{
+    size_t offset = entry->textOffset;
+    if (offset < sizeof(SnapshotContents) || offset >= view->capacity) return NULL; // SNAPSHOT_NO_TEXT included
+    if (entry->bytes >= view->capacity - offset) return NULL;
+    const char* text = (const char*)view->base + offset;
+    return text[entry->bytes] == '\0' ? text : NULL;
+}
+
+bool
+SnapshotReadValidate(const SnapshotReader* reader, const SnapshotView* view)
+{
+    PlatformAtomicFence(); // Everything read so far is read before the counter is checked
+    return PlatformAtomicLoad(&reader->header->slots[view->slot].seq) == view->seq;
+}
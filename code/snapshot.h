@@ -0,0 +1,145 @@
+#ifndef MCLIP_SNAPSHOT_H
+#define MCLIP_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include "platform.h"
+
+// --- History Snapshot ---
+// Read-only copy of the history list (sequence numbers, use counts, UTF-8
+// text) published in a named shared memory segment, so scripts and other
+// tools can read the history without driving the GUI (tools/mclip_query.c).
+//
+// The segment holds two buffers. The writer (the app's UI thread) fills the
+// one readers are not pointed at, then switches them over, so publishing
+// never waits for a reader and a reader never blocks the writer. Each buffer
+// has a sequence counter, odd while it is written (a seqlock): a reader
+// notes it, reads in place, and checks it is unchanged afterwards. That can
+// only fail if two publishes happen during one read; the reader then
+// retries. Readers take nothing in the segment on trust: every offset and
+// count is checked against the segment, so a torn or hostile snapshot gives
+// wrong data that validation rejects, never a bad access.
+//
+// Layout (all offsets from the start of the segment, little endian as the
+// machine is):
+//   SnapshotHeader
+//   buffer 0: SnapshotContents, SnapshotEntry[count], NUL-terminated texts
+//   buffer 1: same
+//
+// The segment does not grow (Windows mappings cannot): entries whose text no
+// longer fits in the buffer are published without it.
+
+#define SNAPSHOT_MAGIC 0x50534C43u          // "CLSP"
+#define SNAPSHOT_VERSION 1                  // Bumped on any layout change
+#define SNAPSHOT_DEFAULT_NAME "mclip-snapshot"
+#define SNAPSHOT_DEFAULT_BYTES (16u << 20)  // Both buffers; the app's segment
+#define SNAPSHOT_NO_TEXT 0                  // SnapshotEntry.textOffset of an entry published without text
+
+typedef struct {
+    volatile int32_t seq;  // Odd while the writer fills the buffer
+    uint32_t reserved;
+    uint64_t offset;       // Of the buffer's SnapshotContents
+    uint64_t capacity;     // Bytes of the buffer
+} SnapshotSlot;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;           // Bytes of the segment
+    volatile int32_t current; // Buffer readers use, -1 before the first publish
+    uint32_t publishes;      // Snapshots published since the writer started
+    SnapshotSlot slots[2];
+} SnapshotHeader;
+
+typedef struct {
+    uint64_t generation;   // Publisher's change counter (History.generation) at the snapshot
+    uint32_t order;        // HistoryOrder the entries are listed in
+    uint32_t count;        // Entries in the table ...
+    uint32_t total;        // ... out of this many in the history (more if the table filled up)
+    uint32_t withText;     // Entries published with their text
+    uint64_t textBytes;    // Text area used, terminators included
+} SnapshotContents;
+
+typedef struct {
+    uint32_t seq;          // HistoryEntry.seq, stable for the entry's lifetime
+    uint32_t uses;         // Times copied
+    uint32_t bytes;        // UTF-8 text length, no terminator; 0 without text
+    uint32_t textOffset;   // From the buffer's SnapshotContents, SNAPSHOT_NO_TEXT if it did not fit
+} SnapshotEntry;
+
+typedef struct {
+    PlatformShared shared;
+    SnapshotHeader* header;    // NULL when not open
+    SnapshotContents* contents; // Buffer being written, between Begin and Commit
+    int32_t slot;
+    uint32_t capacity;         // Entries the table of that buffer was sized for
+    size_t textUsed;           // Text area: used and total bytes
+    size_t textCapacity;
+} SnapshotWriter;
+
+typedef struct {
+    PlatformShared shared;
+    const SnapshotHeader* header; // NULL when not open
+    uint64_t offsets[2];          // Buffer layout, checked and copied once at open
+    uint64_t capacities[2];
+} SnapshotReader;
+
+// One read of a snapshot, from SnapshotReadBegin to SnapshotReadValidate.
+// The counts are copied (and clamped to the buffer) when the read begins.
+typedef struct {
+    const uint8_t* base;   // The buffer's SnapshotContents
+    size_t capacity;
+    int32_t slot;
+    int32_t seq;
+    uint64_t generation;
+    uint32_t order;
+    uint32_t count;
+    uint32_t total;
+    uint32_t withText;
+} SnapshotView;
+
+// Creates the segment 'name' of 'bytes' (at least a header and two small
+// buffers) and publishes nothing yet. False if the segment cannot be created.
+bool SnapshotWriterOpen(SnapshotWriter* writer, const char* name, size_t bytes);
+void SnapshotWriterClose(SnapshotWriter* writer);
+
+// Starts a snapshot of 'total' entries, which SnapshotWriterAdd then adds in
+// list order and SnapshotWriterCommit publishes.
+void SnapshotWriterBegin(SnapshotWriter* writer, uint64_t generation, uint32_t order, size_t total);
+
+// False if a text of 'length' characters certainly does not fit in what is
+// left of the text area. Lets the caller skip fetching (decompressing) it.
+bool SnapshotWriterTextFits(const SnapshotWriter* writer, size_t length);
+
+// Adds the next entry. 'text' may be NULL; it is published without text then,
+// as it is if it does not fit. False once the table is full.
+bool SnapshotWriterAdd(SnapshotWriter* writer, uint32_t seq, uint32_t uses, const wchar_t* text, size_t length);
+
+// Makes the snapshot the one readers see
+void SnapshotWriterCommit(SnapshotWriter* writer);
+
+// Maps the segment 'name' read-only. False if it does not exist (the app is
+// not running) or is not a snapshot of this version (errno / GetLastError()
+// is then meaningless).
+bool SnapshotReaderOpen(SnapshotReader* reader, const char* name);
+void SnapshotReaderClose(SnapshotReader* reader);
+
+// Starts reading the current snapshot. False if nothing was published yet,
+// or if the writer is busy with the buffer (retry).
+bool SnapshotReadBegin(const SnapshotReader* reader, SnapshotView* view);
+
+// Copies entry 'index' (list order). False if out of range.
+bool SnapshotViewEntry(const SnapshotView* view, size_t index, SnapshotEntry* entry);
+
+// The entry's text in place, NUL-terminated at 'entry->bytes', or NULL if it
+// has none (or the read is torn). Only trust it once the read validates.
+const char* SnapshotViewText(const SnapshotView* view, const SnapshotEntry* entry);
+
+// True if nothing read since SnapshotReadBegin was overwritten meanwhile;
+// otherwise discard it and read again.
+bool SnapshotReadValidate(const SnapshotReader* reader, const SnapshotView* view);
+
+#endif // MCLIP_SNAPSHOT_H
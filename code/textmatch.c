@@ -0,0 +1,511 @@
+#include "textmatch.h"
+#include "utf8.h"
+
+#include <wctype.h>
+
+// --- SIMD Configuration ---
+// Vector kernels are built for x86-64, where SSE2 is always present; AVX2 is
+// picked at runtime. wchar_t is 16-bit on Windows and 32-bit elsewhere, so the
+// lane width follows WCHAR_MAX. Other targets use the scalar code only.
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define TEXT_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TEXT_TARGET_AVX2
+#else
+#define TEXT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#ifdef TEXT_SIMD
+#if WCHAR_MAX <= 0xFFFF
+#define TEXT_LANE_BITS 2 // movemask bits per lane
+#define V128_SET1(x) _mm_set1_epi16((short)(x))
+#define V128_CMPEQ _mm_cmpeq_epi16
+#define V128_CMPGT _mm_cmpgt_epi16
+#define V256_SET1(x) _mm256_set1_epi16((short)(x))
+#define V256_CMPEQ _mm256_cmpeq_epi16
+#define V256_CMPGT _mm256_cmpgt_epi16
+#define TEXT_LANE_MASK 0x55555555u
+#else
+#define TEXT_LANE_BITS 4
+#define V128_SET1(x) _mm_set1_epi32((int)(x))
+#define V128_CMPEQ _mm_cmpeq_epi32
+#define V128_CMPGT _mm_cmpgt_epi32
+#define V256_SET1(x) _mm256_set1_epi32((int)(x))
+#define V256_CMPEQ _mm256_cmpeq_epi32
+#define V256_CMPGT _mm256_cmpgt_epi32
+#define TEXT_LANE_MASK 0x11111111u
+#endif
+#define V128_LANES (16 / sizeof(wchar_t))
+#define V256_LANES (32 / sizeof(wchar_t))
+#endif
+
+// --- Scalar Kernels ---
+
+wchar_t
+TextFoldChar(wchar_t c)
+{
+    if (c < 0x80) {
+        return (c >= L'A' && c <= L'Z') ? (wchar_t)(c + (L'a' - L'A')) : c;
+    }
+    return (wchar_t)towlower((wint_t)c);
+}
+
+bool
+TextEqualsNoCaseScalar(const wchar_t* a, size_t aLen, const wchar_t* b, size_t bLen)
+{
+    if (aLen != bLen) return false;
+    for (size_t i = 0; i < aLen; ++i) {
+        if (a[i] != b[i] && TextFoldChar(a[i]) != TextFoldChar(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t
+TextHashNoCase(const wchar_t* text, size_t length)
+{
+    // FNV-1a over folded characters, then a final avalanche so the low bits
+    // (used for bucket selection) depend on the whole string
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (uint32_t)TextFoldChar(text[i]);
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// True if needle matches haystack at 'pos' (folded compare of every character)
+static bool
+TextMatchAt(const wchar_t* haystack, size_t pos, const wchar_t* needle, size_t needleLen)
+{
+    for (size_t j = 0; j < needleLen; ++j) {
+        wchar_t h = haystack[pos + j];
+        if (h != needle[j] && TextFoldChar(h) != TextFoldChar(needle[j])) return false;
+    }
+    return true;
+}
+
+// Scalar search over candidate positions [from, last]
+static const wchar_t*
+TextFindFrom(const wchar_t* haystack, size_t from, size_t last, const wchar_t* needle, size_t needleLen)
+{
+    wchar_t first = TextFoldChar(needle[0]);
+    for (size_t i = from; i <= last; ++i) {
+        if (TextFoldChar(haystack[i]) != first) continue;
+        if (TextMatchAt(haystack, i, needle, needleLen)) return haystack + i;
+    }
+    return NULL;
+}
+
+const wchar_t*
+TextFindNoCaseScalar(const wchar_t* haystack, size_t hayLen, const wchar_t* needle, size_t needleLen)
+{
+    if (needleLen == 0) return haystack;
+    if (needleLen > hayLen) return NULL;
+    return TextFindFrom(haystack, 0, hayLen - needleLen, needle, needleLen);
+}
+
+bool
+TextFoldsToAscii(const wchar_t* text, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        if ((uint32_t)TextFoldChar(text[i]) >= 0x80) return false;
+    }
+    return true;
+}
+
+// --- Scalar UTF-8 Kernels ---
+// The needle folds to ASCII, so an ASCII byte of the haystack is compared as
+// it is, and only a non-ASCII character (which may fold to ASCII, like
+// KELVIN SIGN) is decoded. Matches start on a character boundary, never on a
+// continuation byte (0x80-0xBF), and take at least one byte per character.
+
+// Bit n set: lead byte 0xC0 + n may start a character that folds to ASCII.
+// Computed on first use under the locale of the time, like the SIMD level;
+// bit 0 (0xC0, never a lead byte) marks it computed.
+static uint64_t g_textFoldLeads;
+
+static uint64_t
+TextFoldLeads(void)
+{
+    // Benign race: every thread computes the same answer
+    uint64_t leads = g_textFoldLeads;
+    if (leads) return leads;
+    leads = 1 | 0xFFFFull << 0x30; // Four-byte characters (0xF0-) are not looked into
+    for (uint32_t c = 0x80; c < 0x10000; ++c) {
+        if (c >= 0xD800 && c < 0xE000) continue;
+        if ((uint32_t)TextFoldChar((wchar_t)c) >= 0x80) continue;
+        leads |= 1ull << (c < 0x800 ? c >> 6 : 0x20 | c >> 12); // (0xC0 | c >> 6) - 0xC0, (0xE0 | c >> 12) - 0xC0
+    }
+    g_textFoldLeads = leads;
+    return leads;
+}
+
+// True if byte 'c' (at least 0x80) may start a character that folds to ASCII
+static inline bool
+TextLeadFolds(unsigned c, uint64_t leads)
+{
+    return c >= 0xC0 && (leads >> (c - 0xC0) & 1);
+}
+
+// True if needle matches the UTF-8 text at byte 'pos'
+static bool
+TextMatchUtf8At(const char* haystack, size_t size, size_t pos, const wchar_t* needle, size_t needleLen)
+{
+    for (size_t j = 0; j < needleLen; ++j) {
+        if (pos >= size) return false;
+        uint32_t c = (unsigned char)haystack[pos];
+        if (c < 0x80) {
+            pos++;
+            if (c == (uint32_t)needle[j]) continue;
+            if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        } else {
+            c = Utf8DecodeChar(haystack, size, &pos);
+            if (c == UTF8_BAD_CHAR || c > (uint32_t)WCHAR_MAX) return false; // Surrogate pairs never fold to ASCII
+            c = (uint32_t)TextFoldChar((wchar_t)c);
+        }
+        if (c != (uint32_t)TextFoldChar(needle[j])) return false;
+    }
+    return true;
+}
+
+// Scalar search over candidate start bytes [from, last]
+static const char*
+TextFindUtf8From(const char* haystack, size_t size, size_t from, size_t last, const wchar_t* needle, size_t needleLen)
+{
+    unsigned first = (unsigned)TextFoldChar(needle[0]);
+    uint64_t leads = TextFoldLeads();
+    for (size_t i = from; i <= last; ++i) {
+        unsigned c = (unsigned char)haystack[i];
+        if (c < 0x80) {
+            if ((c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c) != first) continue;
+        } else if (!TextLeadFolds(c, leads)) {
+            continue; // Inside a character, or one that cannot match
+        }
+        if (TextMatchUtf8At(haystack, size, i, needle, needleLen)) return haystack + i;
+    }
+    return NULL;
+}
+
+const char*
+TextFindNoCaseUtf8Scalar(const char* haystack, size_t size, const wchar_t* needle, size_t needleLen)
+{
+    if (needleLen == 0) return haystack;
+    if (needleLen > size) return NULL;
+    return TextFindUtf8From(haystack, size, 0, size - needleLen, needle, needleLen);
+}
+
+// --- Vector Kernels ---
+// Substring search compares the folded first and last needle characters
+// against a block of candidate start positions at once, then verifies the
+// surviving candidates. Only ASCII A-Z is folded in-register; haystack lanes
+// outside ASCII are always treated as candidates (e.g. KELVIN SIGN folds to
+// 'k'), so the result is exactly the scalar result for any needle. Mostly
+// non-ASCII text degrades to verifying every position, i.e. the scalar cost.
+
+#ifdef TEXT_SIMD
+
+static inline unsigned
+TextLowestBit(unsigned mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+static inline __m128i
+TextFold128(__m128i v)
+{
+    __m128i upper = _mm_and_si128(V128_CMPGT(v, V128_SET1(L'A' - 1)), V128_CMPGT(V128_SET1(L'Z' + 1), v));
+    return _mm_or_si128(v, _mm_and_si128(upper, V128_SET1(0x20)));
+}
+
+// All-ones lanes where the character is outside ASCII
+static inline __m128i
+TextNonAscii128(__m128i v)
+{
+    __m128i high = _mm_and_si128(v, V128_SET1(~0x7F));
+    return _mm_xor_si128(V128_CMPEQ(high, _mm_setzero_si128()), _mm_set1_epi32(-1));
+}
+
+static const wchar_t*
+TextFindSse2(const wchar_t* haystack, size_t hayLen, const wchar_t* needle, size_t needleLen)
+{
+    __m128i first = V128_SET1(TextFoldChar(needle[0]));
+    __m128i last = V128_SET1(TextFoldChar(needle[needleLen - 1]));
+    size_t lastStart = hayLen - needleLen;
+    size_t i = 0;
+
+    for (; i + V128_LANES - 1 <= lastStart; i += V128_LANES) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(haystack + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(haystack + i + needleLen - 1));
+        __m128i hitA = _mm_or_si128(V128_CMPEQ(TextFold128(a), first), TextNonAscii128(a));
+        __m128i hitB = _mm_or_si128(V128_CMPEQ(TextFold128(b), last), TextNonAscii128(b));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(hitA, hitB)) & TEXT_LANE_MASK;
+        while (mask) {
+            size_t pos = i + TextLowestBit(mask) / TEXT_LANE_BITS;
+            if (TextMatchAt(haystack, pos, needle, needleLen)) return haystack + pos;
+            mask &= mask - 1;
+        }
+    }
+    return i <= lastStart ? TextFindFrom(haystack, i, lastStart, needle, needleLen) : NULL;
+}
+
+static bool
+TextEqualsSse2(const wchar_t* a, const wchar_t* b, size_t length)
+{
+    size_t i = 0;
+    for (; i + V128_LANES <= length; i += V128_LANES) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i same = V128_CMPEQ(TextFold128(x), TextFold128(y));
+        if (_mm_movemask_epi8(same) == 0xFFFF) continue;
+
+        // Differences in ASCII lanes are final; non-ASCII lanes need full folding
+        __m128i nonAscii = _mm_or_si128(TextNonAscii128(x), TextNonAscii128(y));
+        if (_mm_movemask_epi8(_mm_or_si128(same, nonAscii)) != 0xFFFF) return false;
+        if (!TextEqualsNoCaseScalar(a + i, V128_LANES, b + i, V128_LANES)) return false;
+    }
+    return TextEqualsNoCaseScalar(a + i, length - i, b + i, length - i);
+}
+
+// UTF-8: a lane per byte. A candidate starts with the folded first needle
+// character followed by the second (or by any non-ASCII byte, which may
+// fold to it), or with the lead byte of a non-ASCII character.
+static inline __m128i
+TextFoldBytes128(__m128i v)
+{
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), v));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+static const char*
+TextFindUtf8Sse2(const char* haystack, size_t size, const wchar_t* needle, size_t needleLen)
+{
+    __m128i first = _mm_set1_epi8((char)TextFoldChar(needle[0]));
+    __m128i second = _mm_set1_epi8((char)(needleLen > 1 ? TextFoldChar(needle[1]) : 0));
+    __m128i leadFloor = _mm_set1_epi8((char)0xBF); // Signed: lead bytes 0xC0-0xFF are above it, like ASCII
+    uint64_t leads = TextFoldLeads();
+    size_t lastStart = size - needleLen;
+    size_t i = 0;
+
+    for (; i + 15 <= lastStart; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(haystack + i));
+        unsigned high = (unsigned)_mm_movemask_epi8(a);
+        unsigned lead = high & (unsigned)_mm_movemask_epi8(_mm_cmpgt_epi8(a, leadFloor));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(TextFoldBytes128(a), first));
+        if (needleLen > 1) {
+            __m128i b = _mm_loadu_si128((const __m128i*)(haystack + i + 1));
+            mask &= (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(TextFoldBytes128(b), second)) |
+                    (unsigned)_mm_movemask_epi8(b);
+        }
+        mask |= lead;
+        for (; mask; mask &= mask - 1) {
+            size_t pos = i + TextLowestBit(mask);
+            unsigned c = (unsigned char)haystack[pos];
+            if (c >= 0x80 && !TextLeadFolds(c, leads)) continue;
+            if (TextMatchUtf8At(haystack, size, pos, needle, needleLen)) return haystack + pos;
+        }
+    }
+    return i <= lastStart ? TextFindUtf8From(haystack, size, i, lastStart, needle, needleLen) : NULL;
+}
+
+TEXT_TARGET_AVX2 static inline __m256i
+TextFold256(__m256i v)
+{
+    __m256i upper = _mm256_and_si256(V256_CMPGT(v, V256_SET1(L'A' - 1)), V256_CMPGT(V256_SET1(L'Z' + 1), v));
+    return _mm256_or_si256(v, _mm256_and_si256(upper, V256_SET1(0x20)));
+}
+
+TEXT_TARGET_AVX2 static inline __m256i
+TextNonAscii256(__m256i v)
+{
+    __m256i high = _mm256_and_si256(v, V256_SET1(~0x7F));
+    return _mm256_xor_si256(V256_CMPEQ(high, _mm256_setzero_si256()), _mm256_set1_epi32(-1));
+}
+
+TEXT_TARGET_AVX2 static const wchar_t*
+TextFindAvx2(const wchar_t* haystack, size_t hayLen, const wchar_t* needle, size_t needleLen)
+{
+    __m256i first = V256_SET1(TextFoldChar(needle[0]));
+    __m256i last = V256_SET1(TextFoldChar(needle[needleLen - 1]));
+    size_t lastStart = hayLen - needleLen;
+    size_t i = 0;
+
+    for (; i + V256_LANES - 1 <= lastStart; i += V256_LANES) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(haystack + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(haystack + i + needleLen - 1));
+        __m256i hitA = _mm256_or_si256(V256_CMPEQ(TextFold256(a), first), TextNonAscii256(a));
+        __m256i hitB = _mm256_or_si256(V256_CMPEQ(TextFold256(b), last), TextNonAscii256(b));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(hitA, hitB)) & TEXT_LANE_MASK;
+        while (mask) {
+            size_t pos = i + TextLowestBit(mask) / TEXT_LANE_BITS;
+            if (TextMatchAt(haystack, pos, needle, needleLen)) return haystack + pos;
+            mask &= mask - 1;
+        }
+    }
+    return i <= lastStart ? TextFindFrom(haystack, i, lastStart, needle, needleLen) : NULL;
+}
+
+TEXT_TARGET_AVX2 static bool
+TextEqualsAvx2(const wchar_t* a, const wchar_t* b, size_t length)
+{
+    size_t i = 0;
+    for (; i + V256_LANES <= length; i += V256_LANES) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i same = V256_CMPEQ(TextFold256(x), TextFold256(y));
+        if ((unsigned)_mm256_movemask_epi8(same) == 0xFFFFFFFFu) continue;
+
+        __m256i nonAscii = _mm256_or_si256(TextNonAscii256(x), TextNonAscii256(y));
+        if ((unsigned)_mm256_movemask_epi8(_mm256_or_si256(same, nonAscii)) != 0xFFFFFFFFu) return false;
+        if (!TextEqualsNoCaseScalar(a + i, V256_LANES, b + i, V256_LANES)) return false;
+    }
+    return TextEqualsSse2(a + i, b + i, length - i);
+}
+
+TEXT_TARGET_AVX2 static inline __m256i
+TextFoldBytes256(__m256i v)
+{
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+    return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+TEXT_TARGET_AVX2 static const char*
+TextFindUtf8Avx2(const char* haystack, size_t size, const wchar_t* needle, size_t needleLen)
+{
+    __m256i first = _mm256_set1_epi8((char)TextFoldChar(needle[0]));
+    __m256i second = _mm256_set1_epi8((char)(needleLen > 1 ? TextFoldChar(needle[1]) : 0));
+    __m256i leadFloor = _mm256_set1_epi8((char)0xBF);
+    uint64_t leads = TextFoldLeads();
+    size_t lastStart = size - needleLen;
+    size_t i = 0;
+
+    for (; i + 31 <= lastStart; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(haystack + i));
+        unsigned high = (unsigned)_mm256_movemask_epi8(a);
+        unsigned lead = high & (unsigned)_mm256_movemask_epi8(_mm256_cmpgt_epi8(a, leadFloor));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(TextFoldBytes256(a), first));
+        if (needleLen > 1) {
+            __m256i b = _mm256_loadu_si256((const __m256i*)(haystack + i + 1));
+            mask &= (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(TextFoldBytes256(b), second)) |
+                    (unsigned)_mm256_movemask_epi8(b);
+        }
+        mask |= lead;
+        for (; mask; mask &= mask - 1) {
+            size_t pos = i + TextLowestBit(mask);
+            unsigned c = (unsigned char)haystack[pos];
+            if (c >= 0x80 && !TextLeadFolds(c, leads)) continue;
+            if (TextMatchUtf8At(haystack, size, pos, needle, needleLen)) return haystack + pos;
+        }
+    }
+    // Matches start on character boundaries, so the rest is searched on its own
+    return i <= lastStart ? TextFindUtf8Sse2(haystack + i, size - i, needle, needleLen) : NULL;
+}
+
+static bool
+TextCpuHasAvx2(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false; // OS saves YMM state
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // TEXT_SIMD
+
+// --- Dispatch ---
+
+static TextSimdLevel g_textSimdLevel = TEXT_SIMD_AUTO;
+
+TextSimdLevel
+TextGetSimdLevel(void)
+{
+    // Benign race: every thread computes the same answer
+    if (g_textSimdLevel == TEXT_SIMD_AUTO) {
+#ifdef TEXT_SIMD
+        g_textSimdLevel = TextCpuHasAvx2() ? TEXT_SIMD_AVX2 : TEXT_SIMD_SSE2;
+#else
+        g_textSimdLevel = TEXT_SIMD_NONE;
+#endif
+    }
+    return g_textSimdLevel;
+}
+
+TextSimdLevel
+TextSetSimdLevel(TextSimdLevel level)
+{
+    g_textSimdLevel = TEXT_SIMD_AUTO;
+    TextSimdLevel best = TextGetSimdLevel();
+    if (level != TEXT_SIMD_AUTO && level < best) g_textSimdLevel = level;
+    return g_textSimdLevel;
+}
+
+bool
+TextEqualsNoCase(const wchar_t* a, size_t aLen, const wchar_t* b, size_t bLen)
+{
+    if (aLen != bLen) return false;
+#ifdef TEXT_SIMD
+    switch (TextGetSimdLevel()) {
+        case TEXT_SIMD_AVX2: return TextEqualsAvx2(a, b, aLen);
+        case TEXT_SIMD_SSE2: return TextEqualsSse2(a, b, aLen);
+        default: break;
+    }
+#endif
+    return TextEqualsNoCaseScalar(a, aLen, b, bLen);
+}
+
+const wchar_t*
+TextFindNoCase(const wchar_t* haystack, size_t hayLen, const wchar_t* needle, size_t needleLen)
+{
+    if (needleLen == 0) return haystack;
+    if (needleLen > hayLen) return NULL;
+
+#ifdef TEXT_SIMD
+    switch (TextGetSimdLevel()) {
+        case TEXT_SIMD_AVX2: return TextFindAvx2(haystack, hayLen, needle, needleLen);
+        case TEXT_SIMD_SSE2: return TextFindSse2(haystack, hayLen, needle, needleLen);
+        default: break;
+    }
+#endif
+    return TextFindFrom(haystack, 0, hayLen - needleLen, needle, needleLen);
+}
+
+const char*
+TextFindNoCaseUtf8(const char* haystack, size_t size, const wchar_t* needle, size_t needleLen)
+{
+    if (needleLen == 0) return haystack;
+    if (needleLen > size) return NULL;
+
+#ifdef TEXT_SIMD
+    switch (TextGetSimdLevel()) {
+        case TEXT_SIMD_AVX2: return TextFindUtf8Avx2(haystack, size, needle, needleLen);
+        case TEXT_SIMD_SSE2: return TextFindUtf8Sse2(haystack, size, needle, needleLen);
+        default: break;
+    }
+#endif
+    return TextFindUtf8From(haystack, size, 0, size - needleLen, needle, needleLen);
+}
@@ -0,0 +1,54 @@
+#ifndef MCLIP_TEXTMATCH_H
+#define MCLIP_TEXTMATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+// --- Case-Insensitive Text Matching ---
+// Portable replacements for _wcsicmp / StrStrIW so the history engine
+// behaves the same on every platform. Lengths are in wchar_t units, except
+// the size of UTF-8 text, which is in bytes. TextEqualsNoCase and the
+// TextFindNoCase family use SSE2 or AVX2 kernels on x86-64 (selected at
+// runtime) and give exactly the scalar results.
+
+typedef enum {
+    TEXT_SIMD_AUTO = -1, // Detect on first use
+    TEXT_SIMD_NONE = 0,
+    TEXT_SIMD_SSE2,
+    TEXT_SIMD_AVX2
+} TextSimdLevel;
+
+// Instruction set used by the dispatching kernels
+TextSimdLevel TextGetSimdLevel(void);
+
+// Caps the instruction set (for tests and benchmarks); TEXT_SIMD_AUTO restores
+// the best supported one. Returns the level now in use.
+TextSimdLevel TextSetSimdLevel(TextSimdLevel level);
+
+// Folds a single character to lower case (ASCII fast path, towlower otherwise)
+wchar_t TextFoldChar(wchar_t c);
+
+// True if both strings are equal ignoring case
+bool TextEqualsNoCase(const wchar_t* a, size_t aLen, const wchar_t* b, size_t bLen);
+bool TextEqualsNoCaseScalar(const wchar_t* a, size_t aLen, const wchar_t* b, size_t bLen);
+
+// Hash of the case-folded text: strings equal under TextEqualsNoCase hash equally
+uint32_t TextHashNoCase(const wchar_t* text, size_t length);
+
+// Returns pointer to first case-insensitive occurrence of needle in haystack, or NULL
+const wchar_t* TextFindNoCase(const wchar_t* haystack, size_t hayLen, const wchar_t* needle, size_t needleLen);
+const wchar_t* TextFindNoCaseScalar(const wchar_t* haystack, size_t hayLen, const wchar_t* needle, size_t needleLen);
+
+// True if every character of 'text' folds to ASCII, so that it can be
+// looked for in UTF-8 text with TextFindNoCaseUtf8
+bool TextFoldsToAscii(const wchar_t* text, size_t length);
+
+// TextFindNoCase over UTF-8 (WTF-8) text of 'size' bytes, without decoding
+// it, for needles that fold to ASCII. Matches exactly where TextFindNoCase
+// would in the decoded text; returns the first byte of the first match, or NULL.
+const char* TextFindNoCaseUtf8(const char* haystack, size_t size, const wchar_t* needle, size_t needleLen);
+const char* TextFindNoCaseUtf8Scalar(const char* haystack, size_t size, const wchar_t* needle, size_t needleLen);
+
+#endif // MCLIP_TEXTMATCH_H
@@ -0,0 +1,330 @@
+#include "trigram.h"
+#include "textmatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t
+TrigramKey(wchar_t a, wchar_t b, wchar_t c)
+{
+    return ((uint64_t)((uint32_t)a & 0x1FFFFF) << 42) |
+           ((uint64_t)((uint32_t)b & 0x1FFFFF) << 21) |
+            (uint64_t)((uint32_t)c & 0x1FFFFF);
+}
+
+static uint32_t
+TrigramHash(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    return (uint32_t)key;
+}
+
+static TrigramList*
+TrigramLookup(const TrigramIndex* index, uint64_t key)
+{
+    HashIndexIter iter;
+    uint32_t slot;
+
+    HashIndexFind(&index->keys, TrigramHash(key), &iter);
+    while (HashIndexNext(&iter, &slot)) {
+        if (index->lists[slot].key == key) return &index->lists[slot];
+    }
+    return NULL;
+}
+
+static TrigramList*
+TrigramLookupOrCreate(TrigramIndex* index, uint64_t key)
+{
+    TrigramList* list = TrigramLookup(index, key);
+    if (list) return list;
+
+    uint32_t slot;
+    if (index->freeCount > 0) {
+        slot = index->freeLists[--index->freeCount];
+    } else {
+        if (index->listCount == index->listCapacity) {
+            size_t capacity = index->listCapacity ? index->listCapacity * 2 : 1024;
+            TrigramList* lists = realloc(index->lists, capacity * sizeof(TrigramList));
+            if (!lists) return NULL;
+            index->lists = lists;
+            index->listCapacity = capacity;
+        }
+        slot = (uint32_t)index->listCount++;
+    }
+
+    if (!HashIndexInsert(&index->keys, TrigramHash(key), slot)) {
+        // Give the slot back where it came from
+        if (slot == index->listCount - 1) index->listCount--;
+        else index->freeLists[index->freeCount++] = slot;
+        return NULL;
+    }
+    list = &index->lists[slot];
+    memset(list, 0, sizeof(*list));
+    list->key = key;
+    return list;
+}
+
+static bool
+TrigramAppend(TrigramList* list, uint32_t seq)
+{
+    if (list->head + list->count == list->capacity) {
+        if (list->head > list->count) {
+            // Mostly trimmed: slide live ids to the front instead of growing
+            memmove(list->ids, list->ids + list->head, list->count * sizeof(uint32_t));
+            list->head = 0;
+        } else {
+            uint32_t capacity = list->capacity ? list->capacity * 2 : 4;
+            uint32_t* ids = realloc(list->ids, capacity * sizeof(uint32_t));
+            if (!ids) return false;
+            list->ids = ids;
+            list->capacity = capacity;
+        }
+    }
+    list->ids[list->head + list->count++] = seq;
+    return true;
+}
+
+// Releases the trimmed front of a list once it dominates the allocation
+static void
+TrigramShrink(TrigramList* list)
+{
+    if (list->head < 64 || list->head < 3 * list->count) return;
+
+    memmove(list->ids, list->ids + list->head, list->count * sizeof(uint32_t));
+    list->head = 0;
+    uint32_t capacity = list->count * 2;
+    uint32_t* ids = realloc(list->ids, capacity * sizeof(uint32_t));
+    if (ids) {
+        list->ids = ids;
+        list->capacity = capacity;
+    }
+}
+
+// Unlinks an empty list and recycles its slot
+static void
+TrigramDrop(TrigramIndex* index, TrigramList* list)
+{
+    uint32_t slot = (uint32_t)(list - index->lists);
+    if (index->freeCount == index->freeCapacity) {
+        size_t capacity = index->freeCapacity ? index->freeCapacity * 2 : 256;
+        uint32_t* freeLists = realloc(index->freeLists, capacity * sizeof(uint32_t));
+        if (!freeLists) return; // Keep the empty list; it is reused if the key returns
+        index->freeLists = freeLists;
+        index->freeCapacity = capacity;
+    }
+    HashIndexRemove(&index->keys, TrigramHash(list->key), slot);
+    free(list->ids);
+    memset(list, 0, sizeof(*list));
+    index->freeLists[index->freeCount++] = slot;
+}
+
+// Takes 'seq' out of a list. Usually it is the oldest entry, at the front;
+// an entry evicted after being moved up the history may be anywhere, and the
+// shorter side of the list slides over it. False if it is not listed.
+static bool
+TrigramUnlist(TrigramList* list, uint32_t seq)
+{
+    if (list->count == 0) return false;
+    uint32_t* ids = list->ids + list->head;
+    if (ids[0] != seq) {
+        uint32_t low = 1, high = list->count;
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            if (ids[mid] < seq) low = mid + 1;
+            else high = mid;
+        }
+        if (low == list->count || ids[low] != seq) return false;
+        if (low < list->count - 1 - low) {
+            memmove(ids + 1, ids, low * sizeof(uint32_t));
+        } else {
+            memmove(ids + low, ids + low + 1, (list->count - 1 - low) * sizeof(uint32_t));
+            list->count--;
+            return true;
+        }
+    }
+    list->head++;
+    list->count--;
+    return true;
+}
+
+bool
+TrigramInit(TrigramIndex* index)
+{
+    memset(index, 0, sizeof(*index));
+    return HashIndexInit(&index->keys, 4096);
+}
+
+void
+TrigramFree(TrigramIndex* index)
+{
+    for (size_t i = 0; i < index->listCount; ++i) {
+        free(index->lists[i].ids);
+    }
+    free(index->lists);
+    free(index->freeLists);
+    HashIndexFree(&index->keys);
+    memset(index, 0, sizeof(*index));
+}
+
+bool
+TrigramAdd(TrigramIndex* index, uint32_t seq, const wchar_t* text, size_t length)
+{
+    if (length < 3) return true;
+
+    wchar_t a = TextFoldChar(text[0]);
+    wchar_t b = TextFoldChar(text[1]);
+    for (size_t i = 2; i < length; ++i) {
+        wchar_t c = TextFoldChar(text[i]);
+        TrigramList* list = TrigramLookupOrCreate(index, TrigramKey(a, b, c));
+        if (!list) return false;
+
+        // Repeated trigram within the same entry: already listed
+        if (list->count == 0 || list->ids[list->head + list->count - 1] != seq) {
+            if (!TrigramAppend(list, seq)) return false;
+            index->postings++;
+        }
+        a = b;
+        b = c;
+    }
+    return true;
+}
+
+void
+TrigramRemove(TrigramIndex* index, uint32_t seq, const wchar_t* text, size_t length)
+{
+    if (length < 3) return;
+
+    wchar_t a = TextFoldChar(text[0]);
+    wchar_t b = TextFoldChar(text[1]);
+    for (size_t i = 2; i < length; ++i) {
+        wchar_t c = TextFoldChar(text[i]);
+        TrigramList* list = TrigramLookup(index, TrigramKey(a, b, c));
+
+        if (list && TrigramUnlist(list, seq)) {
+            index->postings--;
+            if (list->count == 0) TrigramDrop(index, list);
+            else TrigramShrink(list);
+        }
+        a = b;
+        b = c;
+    }
+}
+
+static int
+TrigramCompareKeys(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static int
+TrigramCompareLists(const void* a, const void* b)
+{
+    const TrigramList* x = *(const TrigramList* const*)a;
+    const TrigramList* y = *(const TrigramList* const*)b;
+    return (x->count > y->count) - (x->count < y->count);
+}
+
+// First position in ids[from..count) holding a value >= target (galloping search)
+static size_t
+TrigramSeek(const uint32_t* ids, size_t from, size_t count, uint32_t target)
+{
+    size_t step = 1;
+    size_t lo = from, hi = from;
+    while (hi < count && ids[hi] < target) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    if (hi > count) hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ids[mid] < target) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+bool
+TrigramQuery(const TrigramIndex* index, const wchar_t* query, size_t length,
+             uint32_t** out, size_t* count)
+{
+    *out = NULL;
+    *count = 0;
+    if (length < TRIGRAM_MIN_QUERY) return false;
+
+    size_t keyCount = length - 2;
+    uint64_t* keys = malloc(keyCount * sizeof(uint64_t));
+    const TrigramList** lists = malloc(keyCount * sizeof(TrigramList*));
+    if (!keys || !lists) {
+        free(keys);
+        free(lists);
+        return false;
+    }
+
+    for (size_t i = 0; i < keyCount; ++i) {
+        keys[i] = TrigramKey(TextFoldChar(query[i]), TextFoldChar(query[i + 1]),
+                             TextFoldChar(query[i + 2]));
+    }
+    qsort(keys, keyCount, sizeof(uint64_t), TrigramCompareKeys);
+
+    size_t listCount = 0;
+    bool missing = false;
+    for (size_t i = 0; i < keyCount && !missing; ++i) {
+        if (i > 0 && keys[i] == keys[i - 1]) continue;
+        const TrigramList* list = TrigramLookup(index, keys[i]);
+        if (!list) missing = true;
+        else lists[listCount++] = list;
+    }
+    free(keys);
+
+    // Some trigram never occurs: nothing can match
+    if (missing) {
+        free(lists);
+        return true;
+    }
+
+    // Intersect starting from the rarest trigram
+    qsort(lists, listCount, sizeof(TrigramList*), TrigramCompareLists);
+    uint32_t* result = malloc(lists[0]->count * sizeof(uint32_t));
+    if (!result) {
+        free(lists);
+        return false;
+    }
+    memcpy(result, lists[0]->ids + lists[0]->head, lists[0]->count * sizeof(uint32_t));
+    size_t resultCount = lists[0]->count;
+
+    for (size_t l = 1; l < listCount && resultCount > 0; ++l) {
+        const uint32_t* ids = lists[l]->ids + lists[l]->head;
+        size_t idCount = lists[l]->count;
+        size_t pos = 0, kept = 0;
+        for (size_t i = 0; i < resultCount && pos < idCount; ++i) {
+            pos = TrigramSeek(ids, pos, idCount, result[i]);
+            if (pos < idCount && ids[pos] == result[i]) result[kept++] = result[i];
+        }
+        resultCount = kept;
+    }
+    free(lists);
+
+    if (resultCount == 0) {
+        free(result);
+        result = NULL;
+    }
+    *out = result;
+    *count = resultCount;
+    return true;
+}
+
+size_t
+TrigramMemory(const TrigramIndex* index)
+{
+    size_t bytes = HashIndexMemory(&index->keys) +
+                   index->listCapacity * sizeof(TrigramList) +
+                   index->freeCapacity * sizeof(uint32_t);
+    for (size_t i = 0; i < index->listCount; ++i) {
+        bytes += index->lists[i].capacity * sizeof(uint32_t);
+    }
+    return bytes;
+}
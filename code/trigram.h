@@ -0,0 +1,58 @@
+#ifndef MCLIP_TRIGRAM_H
+#define MCLIP_TRIGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include "hashindex.h"
+
+// --- Trigram Index ---
+// Optional posting-list index over case-folded character trigrams. Each list
+// holds the sequence numbers of entries containing that trigram, in ascending
+// order (entries are added in sequence order). Eviction usually removes the
+// oldest sequence number, at the front of its lists, so trimming is O(1) per
+// trigram; an entry promoted by a re-copy may be evicted from further in. A query of 3+ characters intersects the lists of its
+// trigrams; only the resulting candidates need a real substring check.
+
+#define TRIGRAM_MIN_QUERY 3
+
+typedef struct {
+    uint64_t key;        // Three folded characters, 21 bits each
+    uint32_t* ids;       // Sequence numbers, ascending, valid from ids[head]
+    uint32_t head;
+    uint32_t count;      // Valid ids from 'head'
+    uint32_t capacity;
+} TrigramList;
+
+typedef struct {
+    HashIndex keys;      // Hash of trigram key -> index into 'lists'
+    TrigramList* lists;
+    size_t listCount;    // Used slots in 'lists' (including free ones)
+    size_t listCapacity;
+    uint32_t* freeLists; // Recycled slots of emptied lists
+    size_t freeCount;
+    size_t freeCapacity;
+    size_t postings;     // Total ids across all lists
+} TrigramIndex;
+
+bool TrigramInit(TrigramIndex* index);
+void TrigramFree(TrigramIndex* index);
+
+// Indexes 'text' under 'seq'. Sequence numbers must be added in increasing order.
+bool TrigramAdd(TrigramIndex* index, uint32_t seq, const wchar_t* text, size_t length);
+
+// Removes 'seq' from the lists of its trigrams; cheapest when it is the oldest indexed entry
+void TrigramRemove(TrigramIndex* index, uint32_t seq, const wchar_t* text, size_t length);
+
+// Sequence numbers of entries that contain every trigram of 'query', ascending.
+// *out is malloc'ed (NULL when there are none); caller frees it.
+// Returns false if the query is too short to use the index or on allocation failure.
+bool TrigramQuery(const TrigramIndex* index, const wchar_t* query, size_t length,
+                  uint32_t** out, size_t* count);
+
+// Bytes held by lists, key table and bookkeeping
+size_t TrigramMemory(const TrigramIndex* index);
+
+#endif // MCLIP_TRIGRAM_H
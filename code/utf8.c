@@ -0,0 +1,155 @@
+#include "utf8.h"
+
+#include <stdint.h>
+
+#if WCHAR_MAX <= 0xFFFF
+#define UTF8_WIDE_IS_UTF16 1
+#else
+#define UTF8_WIDE_IS_UTF16 0
+#endif
+
+// Reads one code point (or unpaired surrogate) and advances *i
+static uint32_t
+Utf8NextCodePoint(const wchar_t* text, size_t length, size_t* i)
+{
+    uint32_t c = (uint32_t)text[(*i)++];
+#if UTF8_WIDE_IS_UTF16
+    if (c >= 0xD800 && c <= 0xDBFF && *i < length) {
+        uint32_t low = (uint32_t)text[*i];
+        if (low >= 0xDC00 && low <= 0xDFFF) {
+            (*i)++;
+            return 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+        }
+    }
+#else
+    (void)length;
+#endif
+    return c;
+}
+
+static size_t
+Utf8CodePointSize(uint32_t c)
+{
+    if (c < 0x80) return 1;
+    if (c < 0x800) return 2;
+    if (c < 0x10000) return 3;
+    if (c <= 0x10FFFF) return 4;
+    return UTF8_INVALID;
+}
+
+size_t
+Utf8EncodedSize(const wchar_t* text, size_t length)
+{
+    size_t size = 0;
+    for (size_t i = 0; i < length; ) {
+        uint32_t c = (uint32_t)text[i];
+        if (c < 0x80) { // ASCII fast path
+            size++;
+            i++;
+            continue;
+        }
+        size_t bytes = Utf8CodePointSize(Utf8NextCodePoint(text, length, &i));
+        if (bytes == UTF8_INVALID) return UTF8_INVALID;
+        size += bytes;
+    }
+    return size;
+}
+
+size_t
+Utf8Encode(const wchar_t* text, size_t length, char* out)
+{
+    unsigned char* o = (unsigned char*)out;
+    for (size_t i = 0; i < length; ) {
+        uint32_t c = Utf8NextCodePoint(text, length, &i);
+        if (c < 0x80) {
+            *o++ = (unsigned char)c;
+        } else if (c < 0x800) {
+            *o++ = (unsigned char)(0xC0 | (c >> 6));
+            *o++ = (unsigned char)(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            *o++ = (unsigned char)(0xE0 | (c >> 12));
+            *o++ = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+            *o++ = (unsigned char)(0x80 | (c & 0x3F));
+        } else {
+            *o++ = (unsigned char)(0xF0 | (c >> 18));
+            *o++ = (unsigned char)(0x80 | ((c >> 12) & 0x3F));
+            *o++ = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+            *o++ = (unsigned char)(0x80 | (c & 0x3F));
+        }
+    }
+    return (size_t)(o - (unsigned char*)out);
+}
+
+// Decodes one sequence at utf8[*i]; returns UTF8_BAD_CHAR on malformed input
+static uint32_t
+Utf8DecodeOne(const unsigned char* in, size_t size, size_t* i)
+{
+    uint32_t c = in[*i];
+    size_t extra;
+    uint32_t min;
+    if (c < 0x80) { (*i)++; return c; }
+    else if ((c & 0xE0) == 0xC0) { extra = 1; c &= 0x1F; min = 0x80; }
+    else if ((c & 0xF0) == 0xE0) { extra = 2; c &= 0x0F; min = 0x800; }
+    else if ((c & 0xF8) == 0xF0) { extra = 3; c &= 0x07; min = 0x10000; }
+    else return UTF8_BAD_CHAR;
+
+    if (size - *i <= extra) return UTF8_BAD_CHAR;
+    for (size_t k = 1; k <= extra; ++k) {
+        uint32_t next = in[*i + k];
+        if ((next & 0xC0) != 0x80) return UTF8_BAD_CHAR;
+        c = (c << 6) | (next & 0x3F);
+    }
+    // Overlong forms and values past U+10FFFF; surrogates are allowed (WTF-8)
+    if (c < min || c > 0x10FFFF) return UTF8_BAD_CHAR;
+    *i += extra + 1;
+    return c;
+}
+
+size_t
+Utf8DecodedLength(const char* utf8, size_t size)
+{
+    const unsigned char* in = (const unsigned char*)utf8;
+    size_t length = 0;
+    for (size_t i = 0; i < size; ) {
+        if (in[i] < 0x80) {
+            length++;
+            i++;
+            continue;
+        }
+        uint32_t c = Utf8DecodeOne(in, size, &i);
+        if (c == UTF8_BAD_CHAR) return UTF8_INVALID;
+        length += (UTF8_WIDE_IS_UTF16 && c >= 0x10000) ? 2 : 1;
+    }
+    return length;
+}
+
+size_t
+Utf8Decode(const char* utf8, size_t size, wchar_t* out)
+{
+    const unsigned char* in = (const unsigned char*)utf8;
+    wchar_t* o = out;
+    for (size_t i = 0; i < size; ) {
+        if (in[i] < 0x80) {
+            *o++ = (wchar_t)in[i++];
+            continue;
+        }
+        uint32_t c = Utf8DecodeOne(in, size, &i);
+        if (c == UTF8_BAD_CHAR) return UTF8_INVALID;
+#if UTF8_WIDE_IS_UTF16
+        if (c >= 0x10000) {
+            c -= 0x10000;
+            *o++ = (wchar_t)(0xD800 + (c >> 10));
+            *o++ = (wchar_t)(0xDC00 + (c & 0x3FF));
+            continue;
+        }
+#endif
+        *o++ = (wchar_t)c;
+    }
+    return (size_t)(o - out);
+}
+
+uint32_t
+Utf8DecodeChar(const char* utf8, size_t size, size_t* i)
+{
+    return Utf8DecodeOne((const unsigned char*)utf8, size, i);
+}
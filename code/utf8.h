@@ -0,0 +1,35 @@
+#ifndef MCLIP_UTF8_H
+#define MCLIP_UTF8_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+
+// --- UTF-8 Conversion ---
+// Lossless conversion between wchar_t text (UTF-16 on Windows, UTF-32
+// elsewhere) and UTF-8. Unpaired UTF-16 surrogates, which the clipboard can
+// contain, are encoded as 3-byte sequences (WTF-8) so every string survives
+// a round trip unchanged.
+
+#define UTF8_INVALID ((size_t)-1)
+#define UTF8_BAD_CHAR UINT32_MAX
+
+// Bytes needed to encode 'length' characters (no terminator), or UTF8_INVALID
+// if the text holds values outside the Unicode range
+size_t Utf8EncodedSize(const wchar_t* text, size_t length);
+
+// Encodes into 'out', which must hold Utf8EncodedSize bytes. Returns bytes written.
+size_t Utf8Encode(const wchar_t* text, size_t length, char* out);
+
+// Characters Utf8Decode produces for 'size' bytes, or UTF8_INVALID if they are malformed
+size_t Utf8DecodedLength(const char* utf8, size_t size);
+
+// Decodes well-formed input into 'out' (room for Utf8DecodedLength characters).
+// Returns characters written, or UTF8_INVALID if the input is malformed.
+size_t Utf8Decode(const char* utf8, size_t size, wchar_t* out);
+
+// Decodes the sequence at utf8[*i] and moves *i past it. Returns the code
+// point (or unpaired surrogate), or UTF8_BAD_CHAR, leaving *i, if malformed.
+uint32_t Utf8DecodeChar(const char* utf8, size_t size, size_t* i);
+
+#endif // MCLIP_UTF8_H
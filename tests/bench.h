@@ -0,0 +1,46 @@
+#ifndef MCLIP_BENCH_H
+#define MCLIP_BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+// --- Minimal Benchmark Helpers ---
+// Each tests/bench_*.c file exposes one suite function, called from bench_main.c.
+
+static inline uint64_t
+BenchNowNs(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Prints one result line: total time and cost per operation
+static inline void
+BenchReport(const char* name, size_t size, size_t ops, uint64_t elapsedNs)
+{
+    printf("%-32s n=%-8zu %10.3f ms  %10.1f ns/op\n",
+           name, size, elapsedNs / 1e6, ops ? (double)elapsedNs / ops : 0.0);
+}
+
+void BenchHistory(void);
+void BenchArena(void);
+void BenchSearch(void);
+void BenchTrigram(void);
+void BenchTextMatch(void);
+void BenchResultView(void);
+void BenchHistoryLog(void);
+void BenchCompress(void);
+void BenchFuzzy(void);
+void BenchRegex(void);
+void BenchBlobStore(void);
+void BenchMetrics(void);
+void BenchReplay(void);
+void BenchHistoryVersion(void);
+void BenchExclude(void);
+void BenchNearDup(void);
+void BenchMeta(void);
+
+#endif // MCLIP_BENCH_H
@@ -0,0 +1,109 @@
+#include "bench.h"
+#include "../code/arena.h"
+#include "../code/history.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BURST_RING 4096
+#define BURST_EVENTS 400000
+
+// Clipboard-like sizes: mostly short snippets, some paragraphs, rare big dumps
+static size_t
+BurstSize(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    uint32_t r = *state >> 8;
+    switch (r % 16) {
+        case 15: return 16384 + r % 65536;
+        case 14: case 13: return 1024 + r % 4096;
+        default: return 8 + r % 400;
+    }
+}
+
+static void
+BenchRingMalloc(void)
+{
+    void* ring[BURST_RING] = {0};
+    uint32_t state = 1;
+
+    uint64_t start = BenchNowNs();
+    for (size_t i = 0; i < BURST_EVENTS; ++i) {
+        size_t slot = i % BURST_RING;
+        free(ring[slot]);
+        size_t size = BurstSize(&state);
+        ring[slot] = malloc(size);
+        memset(ring[slot], 0, 8);
+    }
+    BenchReport("burst alloc/evict (malloc)", BURST_RING, BURST_EVENTS, BenchNowNs() - start);
+
+    for (size_t i = 0; i < BURST_RING; ++i) free(ring[i]);
+}
+
+static void
+BenchRingArena(void)
+{
+    void* ring[BURST_RING] = {0};
+    size_t sizes[BURST_RING] = {0};
+    uint32_t state = 1;
+    Arena arena;
+    ArenaInit(&arena);
+
+    uint64_t start = BenchNowNs();
+    for (size_t i = 0; i < BURST_EVENTS; ++i) {
+        size_t slot = i % BURST_RING;
+        ArenaRelease(&arena, ring[slot], sizes[slot]);
+        sizes[slot] = BurstSize(&state);
+        ring[slot] = ArenaAlloc(&arena, sizes[slot]);
+        memset(ring[slot], 0, 8);
+    }
+    BenchReport("burst alloc/evict (arena)", BURST_RING, BURST_EVENTS, BenchNowNs() - start);
+    printf("  arena: %zu KB used / %zu KB reserved (%.1f%%), %zu of %zu allocations recycled\n",
+           arena.bytesUsed / 1024, arena.bytesReserved / 1024,
+           100.0 * arena.bytesUsed / arena.bytesReserved, arena.recycled, arena.allocations);
+
+    ArenaFree(&arena);
+}
+
+// Full ingest path: distinct entries of burst sizes through a bounded history
+static void
+BenchHistoryBurst(void)
+{
+    History history;
+    if (!HistoryInit(&history, BURST_RING)) return;
+
+    wchar_t* text = malloc((65536 + 16384 + 1) * sizeof(wchar_t));
+    if (!text) { HistoryFree(&history); return; }
+    uint32_t state = 7;
+    uint64_t elapsed = 0;
+
+    for (size_t i = 0; i < BURST_EVENTS / 4; ++i) {
+        size_t length = BurstSize(&state);
+        for (size_t j = 0; j < length; ++j) text[j] = (wchar_t)(L'a' + (i + j) % 26);
+        swprintf(text, 16, L"%zu", i); // Make every entry distinct
+        text[wcslen(text)] = L'-';
+        text[length] = L'\0';
+
+        uint64_t start = BenchNowNs();
+        HistoryAdd(&history, text);
+        elapsed += BenchNowNs() - start;
+    }
+    BenchReport("history burst ingest", BURST_RING, BURST_EVENTS / 4, elapsed);
+
+    HistoryStats stats;
+    HistoryGetStats(&history, &stats);
+    printf("  history: %zu KB text / %zu KB reserved (%.1f%%), %zu recycled\n",
+           stats.textBytes / 1024, stats.reservedBytes / 1024,
+           100.0 * stats.textBytes / stats.reservedBytes, stats.recycledAllocs);
+
+    free(text);
+    HistoryFree(&history);
+}
+
+void
+BenchArena(void)
+{
+    BenchRingMalloc();
+    BenchRingArena();
+    BenchHistoryBurst();
+}
@@ -0,0 +1,77 @@
+#include "bench.h"
+#include "../code/blobstore.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOB_DISTINCT 400    // Different payloads in the simulated session
+#define BLOB_CAPTURES 5000   // Captures made of them
+#define BLOB_IMAGE_BYTES (512 * 1024)
+
+// Payload 'id': every tenth an image, then HTML fragments and file lists
+static size_t
+MakePayload(unsigned char* buffer, uint32_t id)
+{
+    size_t size = id % 10 == 0 ? BLOB_IMAGE_BYTES : id % 3 == 0 ? 300 : 8 * 1024 + id;
+    uint32_t n = id * 2654435761u + 1;
+    for (size_t i = 0; i < size; ++i) {
+        n = n * 1103515245u + 12345u;
+        buffer[i] = (unsigned char)(n >> 16);
+    }
+    return size;
+}
+
+void
+BenchBlobStore(void)
+{
+    unsigned char* buffer = malloc(BLOB_IMAGE_BYTES);
+    if (!buffer) return;
+
+    // Raw hashing speed
+    size_t size = MakePayload(buffer, 0);
+    const size_t rounds = 200;
+    uint64_t sink = 0;
+    uint64_t start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) sink += BlobHash128(buffer, size).lo;
+    uint64_t elapsed = BenchNowNs() - start;
+    BenchReport("hash 512 KB", size, rounds, elapsed);
+    printf("  %.0f MB/s\n", (double)size * rounds / (elapsed / 1e9) / 1e6);
+
+    // A session: payloads copied again and again, recent ones more often
+    BlobStore store;
+    if (!BlobStoreInit(&store)) {
+        free(buffer);
+        return;
+    }
+    uint64_t putNs = 0, firstNs = 0, firstBytes = 0;
+    uint32_t n = 42;
+    for (uint32_t c = 0; c < BLOB_CAPTURES; ++c) {
+        n = n * 1103515245u + 12345u;
+        uint32_t newest = c * BLOB_DISTINCT / BLOB_CAPTURES; // New payloads keep appearing
+        uint32_t back = (n >> 16) % 8 == 0 ? (n >> 8) % (newest + 1) : (n >> 8) % 4;
+        uint32_t id = newest > back ? newest - back : 0;
+        size = MakePayload(buffer, id);
+
+        uint64_t storedBefore = store.blobs;
+        start = BenchNowNs();
+        uint32_t blob = BlobStorePut(&store, buffer, size);
+        elapsed = BenchNowNs() - start;
+        putNs += elapsed;
+        if (store.blobs > storedBefore) {
+            firstNs += elapsed;
+            firstBytes += size;
+        }
+        sink += blob;
+    }
+    BenchReport("session put", BLOB_CAPTURES, BLOB_CAPTURES, putNs);
+    printf("  %zu distinct of %llu puts, %.1f MB put, %.1f MB stored (dedup ratio %.2fx)\n",
+           store.blobs, (unsigned long long)store.puts, store.putBytes / 1e6, store.storedBytes / 1e6,
+           (double)store.putBytes / store.storedBytes);
+    printf("  ingest of new payloads %.0f MB/s, of repeats %.0f MB/s\n",
+           firstBytes / (firstNs / 1e9) / 1e6,
+           (store.putBytes - firstBytes) / ((putNs - firstNs) / 1e9) / 1e6);
+
+    BlobStoreFree(&store);
+    free(buffer);
+    if (sink == 42) printf("\n"); // Keep the hashing from being optimized away
+}
@@ -0,0 +1,162 @@
+#include "bench.h"
+#include "../code/history.h"
+#include "../code/lz.h"
+#include "../code/utf8.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define COMPRESS_TEXT_CHARS (256 * 1024)
+#define COMPRESS_ENTRIES 64
+
+static bool
+CountMatch(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry; (void)index;
+    (*(size_t*)context)++;
+    return true;
+}
+
+// Log-like JSON lines, the kind of large text people copy from terminals and browsers
+static void
+FillJsonLines(wchar_t* text, size_t length, unsigned seed)
+{
+    size_t used = 0;
+    unsigned n = seed;
+    while (used < length) {
+        wchar_t line[160];
+        n = n * 1103515245u + 12345u;
+        int written = swprintf(line, 160,
+                               L"{\"ts\": \"2024-05-%02u %02u:%02u:%02u\", \"level\": \"%ls\", \"req\": %u, \"path\": \"/api/v1/items/%u\"}\n",
+                               n % 28 + 1, (n >> 5) % 24, (n >> 9) % 60, (n >> 13) % 60,
+                               (n >> 3) % 5 ? L"info" : L"warn", n % 100000, (n >> 7) % 5000);
+        for (int i = 0; i < written && used < length; ++i) text[used++] = line[i];
+    }
+    text[length] = L'\0';
+}
+
+static void
+BenchCodec(const wchar_t* text, size_t length)
+{
+    size_t utf8Size = Utf8EncodedSize(text, length);
+    char* utf8 = malloc(utf8Size);
+    size_t bound = LzCompressBound(utf8Size);
+    unsigned char* packed = malloc(bound);
+    char* unpacked = malloc(utf8Size);
+    wchar_t* decoded = malloc((length + 1) * sizeof(wchar_t));
+    if (!utf8 || !packed || !unpacked || !decoded) goto done;
+
+    const size_t rounds = 20;
+    size_t packedSize = 0;
+    uint64_t start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) Utf8Encode(text, length, utf8);
+    BenchReport("utf8 encode", length, rounds, BenchNowNs() - start);
+
+    start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) packedSize = LzCompress(utf8, utf8Size, packed, bound);
+    uint64_t elapsed = BenchNowNs() - start;
+    BenchReport("lz compress", utf8Size, rounds, elapsed);
+    printf("  %.1f MB/s, %zu -> %zu bytes (%.1f%% of UTF-8, %.1f%% of wchar_t text)\n",
+           utf8Size * rounds / (elapsed / 1e9) / 1e6, utf8Size, packedSize,
+           100.0 * packedSize / utf8Size, 100.0 * packedSize / (length * sizeof(wchar_t)));
+
+    start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) LzDecompress(packed, packedSize, unpacked, utf8Size);
+    elapsed = BenchNowNs() - start;
+    BenchReport("lz decompress", utf8Size, rounds, elapsed);
+    printf("  %.1f MB/s\n", utf8Size * rounds / (elapsed / 1e9) / 1e6);
+
+    start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) Utf8Decode(unpacked, utf8Size, decoded);
+    BenchReport("utf8 decode", length, rounds, BenchNowNs() - start);
+
+done:
+    free(utf8);
+    free(packed);
+    free(unpacked);
+    free(decoded);
+}
+
+// Memory saved across a history of large entries, and what reading them back costs
+static void
+BenchHistoryText(wchar_t* text)
+{
+    History plain, packed;
+    if (!HistoryInit(&plain, COMPRESS_ENTRIES)) return;
+    if (!HistoryInit(&packed, COMPRESS_ENTRIES)) { HistoryFree(&plain); return; }
+    HistorySetCompression(&packed, 16 * 1024, 0);
+
+    uint64_t plainNs = 0, packedNs = 0;
+    for (unsigned i = 0; i < COMPRESS_ENTRIES; ++i) {
+        FillJsonLines(text, COMPRESS_TEXT_CHARS / 4, i + 1);
+        uint64_t start = BenchNowNs();
+        HistoryAdd(&plain, text);
+        plainNs += BenchNowNs() - start;
+        start = BenchNowNs();
+        HistoryAdd(&packed, text);
+        packedNs += BenchNowNs() - start;
+    }
+    BenchReport("add 64K-char entry (plain)", COMPRESS_ENTRIES, COMPRESS_ENTRIES, plainNs);
+    BenchReport("add 64K-char entry (packed)", COMPRESS_ENTRIES, COMPRESS_ENTRIES, packedNs);
+
+    HistoryStats plainStats, packedStats;
+    HistoryGetStats(&plain, &plainStats);
+    HistoryGetStats(&packed, &packedStats);
+    printf("  text held: plain %zu KB, packed %zu KB (%zu entries, %.1f%%)\n",
+           plainStats.textBytes / 1024, packedStats.textBytes / 1024, packedStats.packedEntries,
+           100.0 * packedStats.textBytes / plainStats.textBytes);
+
+    // Walking every entry misses the cache each time: worst case per access
+    size_t chars = 0;
+    uint64_t start = BenchNowNs();
+    for (size_t i = 0; i < COMPRESS_ENTRIES; ++i) {
+        const wchar_t* entryText = HistoryEntryText(&packed, HistoryGet(&packed, i));
+        if (entryText) chars += wcslen(entryText);
+    }
+    BenchReport("entry text (cold)", COMPRESS_ENTRIES, COMPRESS_ENTRIES, BenchNowNs() - start);
+
+    // Re-reading the same few rows, as repainting does, hits the cache
+    const size_t rounds = 10000;
+    start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) {
+        const wchar_t* entryText = HistoryEntryText(&packed, HistoryGet(&packed, r % 8));
+        if (entryText) chars += entryText[0] != 0;
+    }
+    BenchReport("entry text (cached)", COMPRESS_ENTRIES, rounds, BenchNowNs() - start);
+
+    // What painting a row costs: the preview, never decompressed
+    start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) {
+        size_t previewLength;
+        chars += HistoryEntryPreview(&packed, HistoryGet(&packed, r % COMPRESS_ENTRIES), &previewLength)[0] != 0;
+    }
+    BenchReport("entry preview (any row)", COMPRESS_ENTRIES, rounds, BenchNowNs() - start);
+
+    start = BenchNowNs();
+    size_t matches = 0;
+    HistoryForEachMatch(&plain, L"\"req\": 99999,", CountMatch, &matches);
+    BenchReport("scan plain", COMPRESS_ENTRIES, 1, BenchNowNs() - start);
+    start = BenchNowNs();
+    HistoryForEachMatch(&packed, L"\"req\": 99999,", CountMatch, &matches);
+    BenchReport("scan packed", COMPRESS_ENTRIES, 1, BenchNowNs() - start);
+
+    HistoryGetStats(&packed, &packedStats);
+    printf("  %llu decodes, avg %.1f us, max %.1f us (%zu chars, %zu matches)\n",
+           (unsigned long long)packedStats.decodes,
+           packedStats.decodes ? packedStats.decodeNs / 1e3 / packedStats.decodes : 0.0,
+           packedStats.decodeMaxNs / 1e3, chars, matches);
+
+    HistoryFree(&plain);
+    HistoryFree(&packed);
+}
+
+void
+BenchCompress(void)
+{
+    wchar_t* text = malloc((COMPRESS_TEXT_CHARS + 1) * sizeof(wchar_t));
+    if (!text) return;
+    FillJsonLines(text, COMPRESS_TEXT_CHARS, 1);
+    BenchCodec(text, COMPRESS_TEXT_CHARS);
+    BenchHistoryText(text);
+    free(text);
+}
@@ -0,0 +1,98 @@
+#include "bench.h"
+#include "../code/exclude.h"
+#include "../code/textmatch.h"
+
+#include <stdlib.h>
+
+// Rule 'i': a token-like literal that the generated text never contains
+static size_t
+MakeRule(wchar_t* rule, size_t i)
+{
+    static const wchar_t* const stems[] = { L"tok", L"key", L"sec", L"pwd", L"api", L"sk", L"pat", L"xo" };
+    return (size_t)swprintf(rule, 32, L"%ls%zu_%c%c", stems[i % 8], i, L'q' + (int)(i % 7), L'z' - (int)(i % 5));
+}
+
+// Log-like text: words, numbers and punctuation that share characters (and
+// so automaton states) with the rules without matching them
+static void
+FillText(wchar_t* text, size_t length)
+{
+    static const wchar_t words[] = L"token keys secret 2023-10-01 api_call sk=42 pattern xo; pwd-reset tok7_ ";
+    const size_t wordsLength = sizeof(words) / sizeof(words[0]) - 1;
+    for (size_t i = 0; i < length; ++i) text[i] = words[(i * 7 + i / wordsLength) % wordsLength];
+}
+
+static void
+BenchRules(size_t ruleCount, const wchar_t* text, size_t length, bool regexes)
+{
+    ExcludeRules rules;
+    ExcludeRulesInit(&rules);
+    wchar_t rule[32];
+    for (size_t i = 0; i < ruleCount; ++i) {
+        size_t ruleLength = MakeRule(rule, i);
+        ExcludeRulesAdd(&rules, i % 2 ? EXCLUDE_PREFIX : EXCLUDE_CONTAINS, rule, ruleLength);
+    }
+    if (regexes) {
+        static const wchar_t* const patterns[] = { L"\\bAKIA[0-9A-Z]{16}\\b", L"xox[bp]-\\d{10,}",
+                                                   L"^[0-9a-f]{40}$", L"-----BEGIN [A-Z ]*PRIVATE KEY" };
+        for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); ++i) {
+            ExcludeRulesAdd(&rules, EXCLUDE_REGEX, patterns[i], wcslen(patterns[i]));
+        }
+    }
+    uint64_t start = BenchNowNs();
+    bool built = ExcludeRulesBuild(&rules);
+    uint64_t buildNs = BenchNowNs() - start;
+    if (!built) {
+        printf("  build failed\n");
+        ExcludeRulesFree(&rules);
+        return;
+    }
+
+    size_t rounds = 3, excluded = 0;
+    start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) excluded += ExcludeCheck(&rules, text, length) != EXCLUDE_NONE;
+    uint64_t elapsed = BenchNowNs() - start;
+    char name[64];
+    snprintf(name, sizeof(name), "check %zu rules%s", ruleCount, regexes ? " + 4 regex" : "");
+    BenchReport(name, length, rounds, elapsed);
+    printf("  %.2f ns/char, %u states x %u classes, built in %.2f ms%s\n", (double)elapsed / rounds / length,
+           rules.stateCount, rules.classCount, buildNs / 1e6, excluded ? "  (EXCLUDED)" : "");
+    ExcludeRulesFree(&rules);
+}
+
+// The same literals looked for one by one, for comparison
+static void
+BenchRuleByRule(size_t ruleCount, const wchar_t* text, size_t length)
+{
+    wchar_t rule[32];
+    size_t found = 0;
+    uint64_t start = BenchNowNs();
+    for (size_t i = 0; i < ruleCount; ++i) {
+        size_t ruleLength = MakeRule(rule, i);
+        found += TextFindNoCase(text, length, rule, ruleLength) != NULL;
+    }
+    uint64_t elapsed = BenchNowNs() - start;
+    char name[64];
+    snprintf(name, sizeof(name), "rule by rule, %zu rules", ruleCount);
+    BenchReport(name, length, 1, elapsed);
+    printf("  %.2f ns/char%s\n", (double)elapsed / length, found ? "  (FOUND)" : "");
+}
+
+void
+BenchExclude(void)
+{
+    static const size_t lengths[] = { 1u << 20, 4u << 20 };
+    static const size_t ruleCounts[] = { 10, 100, 300, 1000 };
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+        wchar_t* text = malloc(lengths[l] * sizeof(wchar_t));
+        if (!text) return;
+        FillText(text, lengths[l]);
+        for (size_t r = 0; r < sizeof(ruleCounts) / sizeof(ruleCounts[0]); ++r) {
+            BenchRules(ruleCounts[r], text, lengths[l], false);
+        }
+        BenchRules(300, text, lengths[l], true);
+        BenchRuleByRule(10, text, lengths[l]);
+        BenchRuleByRule(300, text, lengths[l]);
+        free(text);
+    }
+}
@@ -0,0 +1,90 @@
+#include "bench.h"
+#include "../code/search.h"
+
+#define FUZZY_HISTORY 50000
+#define FUZZY_FRAME_NS 16000000ull // One frame at 60 Hz: the per-keystroke budget
+
+// Types 'pattern' one character at a time, as the edit box does, and reports
+// the cost of each keystroke
+static void
+BenchTyping(const History* history, const wchar_t* pattern, const char* name)
+{
+    SearchState search;
+    SearchInit(&search);
+
+    // First run pays for the character masks; reported separately
+    const SearchRankedHit* hits = NULL;
+    size_t count = 0;
+    uint64_t start = BenchNowNs();
+    SearchRunFuzzy(&search, history, L"", &hits, &count);
+    uint64_t warmup = BenchNowNs() - start;
+
+    wchar_t typed[64] = {0};
+    uint64_t total = 0, worst = 0;
+    size_t keystrokes = 0;
+    for (size_t i = 0; pattern[i] && i < 63; ++i) {
+        typed[i] = pattern[i];
+        start = BenchNowNs();
+        SearchRunFuzzy(&search, history, typed, &hits, &count);
+        uint64_t elapsed = BenchNowNs() - start;
+        total += elapsed;
+        if (elapsed > worst) worst = elapsed;
+        keystrokes++;
+    }
+    BenchReport(name, history->count, keystrokes, total);
+    printf("  worst keystroke %.2f ms (budget %.0f ms), %zu hits, first run %.2f ms\n",
+           worst / 1e6, FUZZY_FRAME_NS / 1e6, count, warmup / 1e6);
+
+    SearchFree(&search);
+}
+
+// Full, unrefined runs with warm masks: what a pasted or edited pattern costs
+static void
+BenchFullRun(const History* history, const wchar_t* pattern, const char* name)
+{
+    SearchState search;
+    SearchInit(&search);
+    const SearchRankedHit* hits = NULL;
+    size_t count = 0;
+    SearchRunFuzzy(&search, history, L"", &hits, &count);
+
+    const size_t rounds = 20;
+    uint64_t start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) {
+        SearchReset(&search);
+        SearchRunFuzzy(&search, history, pattern, &hits, &count);
+    }
+    BenchReport(name, history->count, rounds, BenchNowNs() - start);
+    printf("  %zu hits, %zu texts tested\n", count, search.lastTested);
+    SearchFree(&search);
+}
+
+void
+BenchFuzzy(void)
+{
+    History history;
+    if (!HistoryInit(&history, FUZZY_HISTORY)) return;
+
+    static const wchar_t* const words[] = {
+        L"config", L"server", L"deploy", L"commit", L"branch", L"release", L"review", L"client",
+        L"session", L"cache", L"invoice", L"meeting", L"password", L"template", L"window", L"buffer",
+    };
+    wchar_t buffer[160];
+    unsigned n = 12345;
+    for (size_t i = 0; i < FUZZY_HISTORY; ++i) {
+        n = n * 1103515245u + 12345u;
+        swprintf(buffer, 160, L"%ls %ls: C:\\Users\\dev\\src\\%ls_%u\\%ls.cpp line %u, see ticket #%u",
+                 words[n % 16], words[(n >> 4) % 16], words[(n >> 8) % 16], (n >> 12) % 100,
+                 words[(n >> 16) % 16], (n >> 3) % 5000, (unsigned)i);
+        HistoryAdd(&history, buffer);
+    }
+
+    BenchTyping(&history, L"cfgsrv", "fuzzy typing \"cfgsrv\"");
+    BenchTyping(&history, L"deploy win", "fuzzy typing \"deploy win\"");
+    BenchTyping(&history, L"qzx", "fuzzy typing \"qzx\"");
+    BenchFullRun(&history, L"cfgsrv", "fuzzy full \"cfgsrv\"");
+    BenchFullRun(&history, L"e", "fuzzy full \"e\"");
+    BenchFullRun(&history, L"qz", "fuzzy full \"qz\"");
+
+    HistoryFree(&history);
+}
@@ -0,0 +1,220 @@
+#include "bench.h"
+#include "../code/history.h"
+#include "../code/textmatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Builds a distinct, log-line-like entry for sequence number i
+static void
+MakeEntry(wchar_t* buffer, size_t size, size_t i)
+{
+    swprintf(buffer, size, L"2023-10-%02zu 12:%02zu:%02zu INFO worker-%zu processed request id=%zu",
+             i % 28 + 1, (i / 60) % 60, i % 60, i % 16, i);
+}
+
+static bool
+CountVisit(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry; (void)index;
+    (*(size_t*)context)++;
+    return true;
+}
+
+static void
+BenchIngest(size_t size)
+{
+    History history;
+    if (!HistoryInit(&history, size)) return;
+
+    wchar_t buffer[128];
+    uint64_t start = BenchNowNs();
+    for (size_t i = 0; i < size; ++i) {
+        MakeEntry(buffer, 128, i);
+        HistoryAdd(&history, buffer);
+    }
+    BenchReport("ingest (distinct)", size, size, BenchNowNs() - start);
+
+    // Full history: every insert also evicts the oldest entry
+    start = BenchNowNs();
+    for (size_t i = size; i < size * 2; ++i) {
+        MakeEntry(buffer, 128, i);
+        HistoryAdd(&history, buffer);
+    }
+    BenchReport("ingest (evicting)", size, size, BenchNowNs() - start);
+    MakeEntry(buffer, 128, size * 2 - 1);
+
+    // Re-copy of the newest entry: best case for the duplicate check
+    start = BenchNowNs();
+    for (size_t i = 0; i < 1000; ++i) {
+        HistoryAdd(&history, buffer);
+    }
+    BenchReport("ingest (duplicate, newest)", size, 1000, BenchNowNs() - start);
+
+    // Re-copy of the oldest entry: worst case for a linear scan. Each moves
+    // to the front, leaving the next one oldest.
+    start = BenchNowNs();
+    for (size_t i = 0; i < 1000; ++i) {
+        MakeEntry(buffer, 128, size + i % size);
+        HistoryAdd(&history, buffer);
+    }
+    BenchReport("ingest (duplicate, oldest)", size, 1000, BenchNowNs() - start);
+
+    size_t hits = 0;
+    start = BenchNowNs();
+    HistoryForEachMatch(&history, L"request id=1", CountVisit, &hits);
+    BenchReport("search (substring)", size, size, BenchNowNs() - start);
+
+    HistoryFree(&history);
+}
+
+// Re-copies of entries anywhere in the history, then the orders they leave:
+// costs per operation should not grow with the size
+static void
+BenchPromotion(size_t size)
+{
+    History history;
+    if (!HistoryInit(&history, size)) return;
+
+    wchar_t buffer[128];
+    for (size_t i = 0; i < size; ++i) {
+        MakeEntry(buffer, 128, i);
+        HistoryAdd(&history, buffer);
+    }
+
+    const size_t ops = 200000;
+    srand(7);
+    uint64_t start = BenchNowNs();
+    for (size_t i = 0; i < ops; ++i) {
+        HistoryPromote(&history, HistoryFindSeq(&history, (uint32_t)(((size_t)rand() * RAND_MAX + rand()) % size)));
+    }
+    BenchReport("promote (random)", size, ops, BenchNowNs() - start);
+
+    // The same through HistoryAdd: hash, compare, promote
+    start = BenchNowNs();
+    for (size_t i = 0; i < ops; ++i) {
+        MakeEntry(buffer, 128, ((size_t)rand() * RAND_MAX + rand()) % size);
+        HistoryAdd(&history, buffer);
+    }
+    BenchReport("ingest (re-copy, random)", size, ops, BenchNowNs() - start);
+
+    size_t visited = 0;
+    start = BenchNowNs();
+    for (const HistoryEntry* entry = HistoryFirst(&history, HISTORY_ORDER_FREQUENT); entry;
+         entry = HistoryNext(&history, entry, HISTORY_ORDER_FREQUENT)) {
+        visited++;
+    }
+    BenchReport("walk (most used first)", size, visited, BenchNowNs() - start);
+
+    // Rows of a scrolled list: neighbours of the previous lookup
+    size_t rows = size < ops ? size : ops;
+    start = BenchNowNs();
+    for (size_t i = 0; i < rows; ++i) {
+        visited += HistoryGetInOrder(&history, HISTORY_ORDER_RECENT, size / 2 + (i % 64) - 32) != NULL;
+    }
+    BenchReport("get (out of order, scrolling)", size, rows, BenchNowNs() - start);
+
+    start = BenchNowNs();
+    for (size_t i = 0; i < rows; ++i) {
+        const HistoryEntry* entry = HistoryFindSeq(&history, (uint32_t)(((size_t)rand() * RAND_MAX + rand()) % size));
+        visited += HistoryRecencyIndex(&history, entry);
+    }
+    BenchReport("recency index (random)", size, rows, BenchNowNs() - start);
+
+    HistoryFree(&history);
+}
+
+// Mixed-script clips: mostly ASCII code, logs and URLs, some Latin,
+// Cyrillic and CJK prose
+static void
+MakeMixedEntry(wchar_t* buffer, size_t size, size_t i)
+{
+    static const wchar_t* const lines[] = {
+        L"if (request->status != 200) retry(request, %zu);",
+        L"2023-10-01 12:00:%02zu WARN cache miss for key user:%zu",
+        L"https://example.com/search?q=clip&page=%zu&sort=recent",
+        L"Réunion déplacée à %zu h, merci de prévenir l'équipe",
+        L"Отчёт номер %zu готов, проверьте таблицу перед отправкой",
+        L"会议改到%zu点，请提前准备好季度报告和预算表格",
+        L"git commit -m \"Fix crash number %zu in the parser\"",
+        L"SELECT id, name FROM users WHERE id = %zu ORDER BY name;",
+    };
+    const size_t count = sizeof(lines) / sizeof(lines[0]);
+    swprintf(buffer, size, lines[i % count], i, i);
+}
+
+// Memory per entry as stored against the wchar_t form, then a scan of the
+// stored texts against the same scan over wchar_t copies
+static void
+BenchTextForms(size_t size)
+{
+    History history;
+    if (!HistoryInit(&history, size)) return;
+    wchar_t buffer[128];
+    for (size_t i = 0; i < size; ++i) {
+        MakeMixedEntry(buffer, 128, i);
+        HistoryAdd(&history, buffer);
+    }
+    size_t count = HistoryCount(&history), textChars = 0, textBytes = 0;
+    wchar_t** wide = malloc(count * sizeof(wchar_t*));
+    size_t* lengths = malloc(count * sizeof(size_t));
+    if (!wide || !lengths) {
+        free(wide);
+        free(lengths);
+        HistoryFree(&history);
+        return;
+    }
+    size_t n = 0;
+    for (const HistoryEntry* entry = HistoryFirst(&history, HISTORY_ORDER_RECENT); entry;
+         entry = HistoryNext(&history, entry, HISTORY_ORDER_RECENT), ++n) {
+        const wchar_t* text = HistoryEntryText(&history, entry);
+        lengths[n] = entry->length;
+        wide[n] = malloc((entry->length + 1) * sizeof(wchar_t));
+        if (wide[n]) memcpy(wide[n], text, (entry->length + 1) * sizeof(wchar_t));
+        textChars += entry->length;
+        textBytes += entry->utf8 ? entry->utf8Bytes : entry->length * sizeof(wchar_t);
+    }
+    printf("  %.1f bytes/entry stored, %.1f as wchar_t (%zu-byte wchar_t)\n",
+           (double)history.bytes / count,
+           (double)(history.bytes - textBytes + (textChars + count) * sizeof(wchar_t)) / count,
+           sizeof(wchar_t));
+
+    static const wchar_t* const filters[] = { L"REQUEST", L"page=1", L"отчёт" };
+    for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f) {
+        size_t filterLength = wcslen(filters[f]), hits = 0, wideHits = 0;
+        uint64_t start = BenchNowNs();
+        HistoryScan(&history, filters[f], filterLength, CountVisit, &hits, NULL);
+        uint64_t stored = BenchNowNs() - start;
+        start = BenchNowNs();
+        for (size_t i = 0; i < count; ++i) {
+            wideHits += wide[i] && TextFindNoCase(wide[i], lengths[i], filters[f], filterLength) != NULL;
+        }
+        uint64_t asWide = BenchNowNs() - start;
+
+        char name[64];
+        snprintf(name, sizeof(name), "scan mixed \"%ls\"", filters[f]);
+        BenchReport(name, size, count, stored);
+        printf("  %.0f MB/s of text stored, %.0f as wchar_t (%.3f ms)%s\n",
+               (double)textBytes * 1e3 / stored, (double)textChars * sizeof(wchar_t) * 1e3 / asWide,
+               asWide / 1e6, hits == wideHits ? "" : "  (MATCHES DIFFER)");
+    }
+    for (size_t i = 0; i < count; ++i) free(wide[i]);
+    free(wide);
+    free(lengths);
+    HistoryFree(&history);
+}
+
+void
+BenchHistory(void)
+{
+    static const size_t sizes[] = { 128, 1024, 16384, 131072, 524288 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BenchIngest(sizes[i]);
+    }
+    static const size_t promotionSizes[] = { 1024, 16384, 131072, 1048576 };
+    for (size_t i = 0; i < sizeof(promotionSizes) / sizeof(promotionSizes[0]); ++i) {
+        BenchPromotion(promotionSizes[i]);
+    }
+    BenchTextForms(16384);
+    BenchTextForms(131072);
+}
@@ -0,0 +1,148 @@
+#include "bench.h"
+#include "../code/historyversion.h"
+
+#include <string.h>
+
+#define VERSION_READ_HISTORY 1000
+#define VERSION_READ_MS 300
+#define VERSION_MAX_THREADS 8
+
+// Publish after one add, with the rest of the history unchanged (the usual case)
+static void
+BenchPublish(size_t count)
+{
+    History history;
+    HistoryVersions versions;
+    if (!HistoryInit(&history, count)) return;
+    if (!HistoryVersionsInit(&versions)) {
+        HistoryFree(&history);
+        return;
+    }
+    wchar_t text[64];
+    for (size_t i = 0; i < count; ++i) {
+        swprintf(text, 64, L"entry %zu of the version benchmark", i);
+        HistoryAdd(&history, text);
+    }
+    uint64_t start = BenchNowNs();
+    HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT);
+    uint64_t first = BenchNowNs() - start;
+
+    const size_t rounds = 200;
+    start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) {
+        swprintf(text, 64, L"new entry %zu", r);
+        HistoryAdd(&history, text);
+        HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT);
+    }
+    uint64_t elapsed = BenchNowNs() - start;
+    char name[64];
+    snprintf(name, sizeof(name), "add + publish, %zu entries", count);
+    BenchReport(name, count, rounds, elapsed);
+    printf("  first publish %.2f ms, %.1f ns/entry per publish, %zu KB of texts\n",
+           first / 1e6, (double)elapsed / rounds / count, versions.textBytes / 1024);
+    HistoryVersionsFree(&versions);
+    HistoryFree(&history);
+}
+
+typedef struct {
+    HistoryVersions* versions;
+    History* history;            // Locked readers walk the live history ...
+    PlatformLock* lock;          // ... under this
+    volatile int32_t* stop;
+    size_t reads;
+    size_t checksum;
+} BenchReader;
+
+static void
+ReadPinned(void* context)
+{
+    BenchReader* reader = context;
+    int slot = HistoryVersionsRegister(reader->versions);
+    if (slot < 0) return;
+    while (!PlatformAtomicLoad(reader->stop)) {
+        const HistoryVersion* version = HistoryVersionsPin(reader->versions, slot);
+        for (size_t i = 0; version && i < version->count; ++i) reader->checksum += version->entries[i].text->length;
+        HistoryVersionsUnpin(reader->versions, slot);
+        reader->reads++;
+    }
+    HistoryVersionsUnregister(reader->versions, slot);
+}
+
+static void
+ReadLocked(void* context)
+{
+    BenchReader* reader = context;
+    while (!PlatformAtomicLoad(reader->stop)) {
+        PlatformLockAcquire(reader->lock);
+        for (const HistoryEntry* entry = HistoryFirst(reader->history, HISTORY_ORDER_RECENT); entry;
+             entry = HistoryNext(reader->history, entry, HISTORY_ORDER_RECENT)) {
+            reader->checksum += entry->length;
+        }
+        PlatformLockRelease(reader->lock);
+        reader->reads++;
+    }
+}
+
+// 'threads' readers walk the whole list over and over for VERSION_READ_MS
+// while the writer adds and publishes. Pinned readers share nothing but the
+// version; locked ones take turns with each other and with the writer.
+static void
+BenchReaders(int threads, bool pinned)
+{
+    History history;
+    HistoryVersions versions;
+    PlatformLock* lock = PlatformLockCreate();
+    if (!lock || !HistoryInit(&history, VERSION_READ_HISTORY)) return;
+    HistoryVersionsInit(&versions);
+    wchar_t text[64];
+    for (size_t i = 0; i < VERSION_READ_HISTORY; ++i) {
+        swprintf(text, 64, L"entry %zu of the reader benchmark", i);
+        HistoryAdd(&history, text);
+    }
+    HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT);
+
+    volatile int32_t stop = 0;
+    BenchReader readers[VERSION_MAX_THREADS];
+    PlatformThread* running[VERSION_MAX_THREADS];
+    for (int i = 0; i < threads; ++i) {
+        readers[i] = (BenchReader){ &versions, &history, lock, &stop, 0, 0 };
+        running[i] = PlatformThreadStart(pinned ? ReadPinned : ReadLocked, &readers[i]);
+    }
+    uint64_t start = BenchNowNs();
+    size_t writes = 0;
+    while (BenchNowNs() - start < VERSION_READ_MS * 1000000ull) {
+        swprintf(text, 64, L"written %zu", writes++);
+        PlatformLockAcquire(lock);
+        HistoryAdd(&history, text);
+        PlatformLockRelease(lock);
+        HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT);
+    }
+    PlatformAtomicStore(&stop, 1);
+    uint64_t elapsed = BenchNowNs() - start;
+    size_t reads = 0;
+    for (int i = 0; i < threads; ++i) {
+        if (running[i]) PlatformThreadJoin(running[i]);
+        reads += readers[i].reads;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s readers x%d", pinned ? "pinned" : "locked", threads);
+    BenchReport(name, VERSION_READ_HISTORY, reads, elapsed);
+    printf("  %.0f list reads/s (%.0f per thread), %.0f writes/s\n",
+           reads / (elapsed / 1e9), reads / (elapsed / 1e9) / threads, writes / (elapsed / 1e9));
+    HistoryVersionsFree(&versions);
+    HistoryFree(&history);
+    PlatformLockDestroy(lock);
+}
+
+void
+BenchHistoryVersion(void)
+{
+    BenchPublish(1000);
+    BenchPublish(10000);
+    BenchPublish(100000);
+    for (int threads = 1; threads <= VERSION_MAX_THREADS; threads *= 2) {
+        BenchReaders(threads, true);
+        BenchReaders(threads, false);
+    }
+}
@@ -0,0 +1,48 @@
+#include "bench.h"
+
+#include <locale.h>
+#include <string.h>
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} BenchSuite;
+
+static const BenchSuite g_suites[] = {
+    { "history", BenchHistory },
+    { "arena", BenchArena },
+    { "search", BenchSearch },
+    { "trigram", BenchTrigram },
+    { "textmatch", BenchTextMatch },
+    { "resultview", BenchResultView },
+    { "historylog", BenchHistoryLog },
+    { "compress", BenchCompress },
+    { "fuzzy", BenchFuzzy },
+    { "regex", BenchRegex },
+    { "blobstore", BenchBlobStore },
+    { "metrics", BenchMetrics },
+    { "replay", BenchReplay },
+    { "versions", BenchHistoryVersion },
+    { "exclude", BenchExclude },
+    { "neardup", BenchNearDup },
+    { "meta", BenchMeta },
+};
+
+// Usage: mclip_bench [suite...]   (no arguments runs every suite)
+int
+main(int argc, char** argv)
+{
+    setlocale(LC_CTYPE, "C.UTF-8");
+
+    for (size_t i = 0; i < sizeof(g_suites) / sizeof(g_suites[0]); ++i) {
+        bool selected = (argc < 2);
+        for (int a = 1; a < argc; ++a) {
+            if (strcmp(argv[a], g_suites[i].name) == 0) selected = true;
+        }
+        if (selected) {
+            printf("--- %s ---\n", g_suites[i].name);
+            g_suites[i].run();
+        }
+    }
+    return 0;
+}
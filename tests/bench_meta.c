@@ -0,0 +1,157 @@
+#include "bench.h"
+#include "../code/meta.h"
+#include "../code/resultview.h"
+#include "../code/textmatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define META_HISTORY 1000000
+#define META_SPACING 5          // Seconds between copies: the history spans about two months
+#define META_LONG_EVERY 64      // One text in this many is over 1 KB
+
+static const wchar_t* const g_sources[] = { L"Code", L"WindowsTerminal", L"chrome", L"firefox", L"OUTLOOK",
+                                            L"Teams", L"explorer", L"notepad", L"devenv", L"slack",
+                                            L"EXCEL", L"WINWORD" };
+#define SOURCE_COUNT (sizeof(g_sources) / sizeof(g_sources[0]))
+
+static void
+Text(wchar_t* out, size_t i)
+{
+    size_t length;
+    switch (i % 5) {
+    case 0: length = (size_t)swprintf(out, 128, L"https://example.com/issues/%zu?tab=%zu", i, i % 7); break;
+    case 1: length = (size_t)swprintf(out, 128, L"if (count > %zu) {\n    return error_%zu;\n}", i % 997, i); break;
+    case 2: length = (size_t)swprintf(out, 128, L"C:\\src\\module%zu\\file%zu.c", i % 31, i); break;
+    default: length = (size_t)swprintf(out, 128, L"note %zu about the build error in step %zu", i, i % 13); break;
+    }
+    if (i % META_LONG_EVERY == 0) { // A log excerpt
+        while (length < 1100) length += (size_t)swprintf(out + length, 64, L" [%zu] retrying request", length);
+    }
+}
+
+// The same filters evaluated a row at a time over the entries, as they would
+// be without columns
+static size_t
+RowScan(const History* history, const MetaQuery* query)
+{
+    size_t passed = 0;
+    HistoryMeta meta;
+    for (const HistoryEntry* entry = HistoryFirst(history, HISTORY_ORDER_RECENT); entry;
+         entry = HistoryNext(history, entry, HISTORY_ORDER_RECENT)) {
+        HistoryGetMeta(history, entry, &meta);
+        if (meta.time < query->after || meta.time > query->before) continue;
+        if (meta.bytes < query->minBytes || meta.bytes > query->maxBytes) continue;
+        if (query->classes && !(query->classes & (1u << meta.metaClass))) continue;
+        bool app = query->appCount == 0;
+        for (size_t a = 0; !app && a < query->appCount; ++a) {
+            app = TextFindNoCase(meta.source, wcslen(meta.source), query->apps[a], wcslen(query->apps[a])) != NULL;
+        }
+        passed += app;
+    }
+    return passed;
+}
+
+static void
+BenchScan(const History* history, int64_t now, const wchar_t* filters, const char* name)
+{
+    MetaQuery query;
+    wchar_t rest[128];
+    MetaQueryParse(&query, filters, wcslen(filters), now, rest);
+    uint64_t* bits = malloc((history->capacity + 63) / 64 * sizeof(uint64_t));
+    if (!bits) return;
+
+    const size_t rounds = 20;
+    size_t passed = 0;
+    uint64_t start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) {
+        passed = MetaQueryScan(&query, &history->meta, &history->sources, history->capacity, bits);
+    }
+    uint64_t elapsed = BenchNowNs() - start;
+    BenchReport(name, history->count, rounds * history->capacity, elapsed);
+
+    size_t rowPassed = 0;
+    start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) rowPassed = RowScan(history, &query);
+    uint64_t rowElapsed = BenchNowNs() - start;
+    printf("  %zu slots pass (%zu entries); row at a time %.1f ns/entry, %.1fx the columns\n", passed, rowPassed,
+           (double)rowElapsed / (rounds * history->count), elapsed ? (double)rowElapsed / elapsed : 0.0);
+    free(bits);
+}
+
+static void
+BenchRefresh(const History* history, const wchar_t* query, const char* name)
+{
+    SearchState search;
+    ResultView view;
+    SearchInit(&search);
+    ResultViewInit(&view);
+
+    const size_t rounds = 5;
+    uint64_t start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) {
+        SearchReset(&search);
+        ResultViewRefresh(&view, &search, history, query);
+    }
+    uint64_t elapsed = BenchNowNs() - start;
+    BenchReport(name, history->count, rounds, elapsed);
+    printf("  %zu rows, %zu texts tested\n", ResultViewCount(&view), search.lastTested);
+
+    ResultViewFree(&view);
+    SearchFree(&search);
+}
+
+void
+BenchMeta(void)
+{
+    History history;
+    if (!HistoryInit(&history, META_HISTORY)) return;
+    wchar_t* text = malloc(2048 * sizeof(wchar_t));
+    if (!text) {
+        HistoryFree(&history);
+        return;
+    }
+
+    // Adding classifies and sizes each text; the origin comes after, as in ClipIngest
+    int64_t now = (int64_t)time(NULL);
+    uint64_t addNs = 0;
+    uint64_t originNs = 0;
+    for (size_t i = 0; i < META_HISTORY; ++i) {
+        Text(text, i);
+        uint64_t start = BenchNowNs();
+        HistoryAdd(&history, text);
+        uint64_t added = BenchNowNs();
+        HistorySetOrigin(&history, HistoryGet(&history, 0), now - (int64_t)(META_HISTORY - i) * META_SPACING,
+                         g_sources[(i * 7 + i / 3) % SOURCE_COUNT]);
+        originNs += BenchNowNs() - added;
+        addNs += added - start;
+    }
+    free(text);
+    BenchReport("add", history.count, META_HISTORY, addNs);
+    BenchReport("set origin", history.count, META_HISTORY, originNs);
+    HistoryStats stats;
+    HistoryGetStats(&history, &stats);
+    printf("  %zu bytes of metadata, %.1f per entry\n", stats.metaBytes, (double)stats.metaBytes / history.count);
+
+    const wchar_t* filters = L"app:code after:10:00 size:>1k";
+    MetaQuery query;
+    wchar_t rest[64];
+    const size_t parses = 100000;
+    uint64_t start = BenchNowNs();
+    for (size_t r = 0; r < parses; ++r) MetaQueryParse(&query, filters, wcslen(filters), now, rest);
+    BenchReport("parse", 1, parses, BenchNowNs() - start);
+
+    BenchScan(&history, now, L"app:code", "scan app:");
+    BenchScan(&history, now, L"app:code app:terminal app:chrome", "scan app: x3");
+    BenchScan(&history, now, L"after:1d", "scan after:");
+    BenchScan(&history, now, L"size:>1k", "scan size:");
+    BenchScan(&history, now, L"type:url type:path", "scan type:");
+    BenchScan(&history, now, L"app:code after:1w size:>1k", "scan combined");
+    BenchScan(&history, now, filters, "scan app: after:HH:MM size:");
+
+    BenchRefresh(&history, L"error", "refresh (text only)");
+    BenchRefresh(&history, L"app:code after:1w error", "refresh (filtered)");
+    BenchRefresh(&history, L"app:code after:1w size:>1k", "refresh (filters only)");
+
+    HistoryFree(&history);
+}
@@ -0,0 +1,46 @@
+#include "bench.h"
+#include "../code/metrics.h"
+
+#include <stdlib.h>
+
+#define METRICS_SAMPLES 10000000
+
+void
+BenchMetrics(void)
+{
+    static Metrics metrics;
+    MetricsInit(&metrics, BenchNowNs());
+
+    // Recording: what every instrumented stage pays, on durations spread over
+    // 100 ns - 10 ms like real ones
+    uint64_t* samples = malloc(4096 * sizeof(uint64_t));
+    if (!samples) return;
+    uint32_t n = 42;
+    for (size_t i = 0; i < 4096; ++i) {
+        n = n * 1103515245u + 12345u;
+        samples[i] = 100ull << ((n >> 16) % 17);
+        samples[i] += (n >> 8) % samples[i];
+    }
+    uint64_t start = BenchNowNs();
+    for (size_t i = 0; i < METRICS_SAMPLES; ++i) {
+        MetricsRecord(&metrics, (MetricsStage)(i % METRIC_STAGE_COUNT), samples[i & 4095]);
+    }
+    BenchReport("record", METRICS_SAMPLES, METRICS_SAMPLES, BenchNowNs() - start);
+
+    // Reading them back, as the Statistics dialog does
+    uint64_t sink = 0;
+    start = BenchNowNs();
+    for (size_t i = 0; i < 1000; ++i) sink += LatencyHistogramPercentile(&metrics.stages[METRIC_SEARCH], 99);
+    BenchReport("percentile", LATENCY_BUCKETS, 1000, BenchNowNs() - start);
+
+    static char report[64 * 1024];
+    start = BenchNowNs();
+    for (size_t i = 0; i < 100; ++i) sink += MetricsFormatText(&metrics, BenchNowNs(), report, sizeof(report));
+    BenchReport("text report", METRIC_STAGE_COUNT, 100, BenchNowNs() - start);
+    start = BenchNowNs();
+    for (size_t i = 0; i < 100; ++i) sink += MetricsFormatJson(&metrics, BenchNowNs(), report, sizeof(report));
+    BenchReport("json report", METRIC_STAGE_COUNT, 100, BenchNowNs() - start);
+
+    free(samples);
+    if (sink == 42) printf("\n");
+}
@@ -0,0 +1,334 @@
+#include "bench.h"
+#include "../code/history.h"
+#include "../code/neardup.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define STREAM_TEXTS 50000
+#define RECENT_BASES 1000   // Variants are of one of the last texts this many
+
+// What an ingested text is, compared with those before it
+typedef enum {
+    COPY_NEW = 0,      // Unrelated to any
+    COPY_REWRITTEN,    // The first half of an earlier text, the rest other words: not a near-duplicate
+    COPY_NUMBERS,      // An earlier text with other numbers (timestamps, line numbers)
+    COPY_WHITESPACE,   // ... with other whitespace and case
+    COPY_EDITED,       // ... with one word changed
+    COPY_KIND_COUNT
+} CopyKind;
+
+static const char* const g_kindNames[COPY_KIND_COUNT] = { "new", "rewritten", "numbers", "whitespace", "edited" };
+
+typedef struct {
+    CopyKind kind;
+    uint32_t family;   // Texts of one family are near-duplicates of each other
+    size_t offset;     // Into the stream's text
+    size_t length;
+} StreamText;
+
+typedef struct {
+    wchar_t* text;     // Every text, NUL-terminated one after the other
+    size_t used;
+    size_t capacity;
+    StreamText* texts;
+    size_t count;
+} Stream;
+
+static uint64_t
+Hash(uint64_t a, uint64_t b)
+{
+    uint64_t x = a * 0x9e3779b97f4a7c15ull ^ (b + 0x632be59bd9b4e5f5ull);
+    x ^= x >> 31;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 29;
+    return x;
+}
+
+// Pseudo-word 'n' of a 4096-word vocabulary, two to four syllables
+static size_t
+Word(wchar_t* out, uint64_t n)
+{
+    static const wchar_t* const syllables[] = { L"ka", L"lo", L"mi", L"ne", L"ru", L"sta", L"ter", L"vo", L"xi",
+                                                L"pre", L"con", L"ble", L"dra", L"fu", L"gen", L"hal" };
+    size_t length = 0;
+    for (unsigned s = 0; s < 2 + n % 3; ++s) {
+        const wchar_t* syllable = syllables[(n >> (4 * s)) % 16];
+        while (*syllable) out[length++] = *syllable++;
+    }
+    return length;
+}
+
+// Text of 'words' words; which ones depends on 'base' (and 'other' from word
+// 'otherFrom' on), the numbers among them on 'numbers'. Common words are
+// drawn far more often than rare ones, as in real text.
+static size_t
+Generate(wchar_t* out, uint64_t base, uint64_t numbers, size_t words, uint64_t other, size_t otherFrom, size_t edited)
+{
+    size_t length = 0;
+    for (size_t j = 0; j < words; ++j) {
+        uint64_t seed = j >= otherFrom ? other : base;
+        uint64_t h = Hash(j == edited ? seed ^ 0xed17 : seed, j);
+        if (j > 0) out[length++] = j % 9 == 0 ? L'\n' : L' ';
+        if (h % 6 == 0) {
+            uint64_t n = Hash(numbers, j);
+            length += (size_t)swprintf(out + length, 16, L"%02u:%02u:%02u.%03u", (unsigned)(n % 24),
+                                       (unsigned)(n >> 8) % 60, (unsigned)(n >> 16) % 60, (unsigned)(n >> 24) % 1000);
+        } else {
+            uint64_t r = (h >> 8) % 4096;
+            length += Word(out + length, r * r / 4096); // Skewed towards the first words
+        }
+    }
+    out[length] = L'\0';
+    return length;
+}
+
+// Trailing whitespace on every line, an indent, the first line in capitals
+static size_t
+Respace(wchar_t* out, const wchar_t* text, size_t length)
+{
+    size_t used = 0;
+    bool firstLine = true;
+    out[used++] = L'\t';
+    for (size_t i = 0; i < length; ++i) {
+        wchar_t c = text[i];
+        if (c == L'\n') {
+            out[used++] = L' ';
+            out[used++] = L' ';
+            firstLine = false;
+        }
+        out[used++] = firstLine && c >= L'a' && c <= L'z' ? c - 32 : c;
+    }
+    out[used++] = L'\n';
+    out[used] = L'\0';
+    return used;
+}
+
+static size_t
+WordCount(uint64_t base)
+{
+    switch (Hash(base, 999) % 4) {
+    case 0: return 2 + Hash(base, 998) % 5;    // Short: a command, a name
+    case 1: return 8 + Hash(base, 998) % 24;   // A line or two
+    default: return 32 + Hash(base, 998) % 96; // A stack trace, a paragraph
+    }
+}
+
+static bool
+BuildStream(Stream* stream, size_t count)
+{
+    memset(stream, 0, sizeof(*stream));
+    stream->capacity = count * 256;
+    stream->text = malloc(stream->capacity * sizeof(wchar_t));
+    stream->texts = malloc(count * sizeof(StreamText));
+    uint64_t* bases = malloc(count * sizeof(uint64_t));
+    uint32_t* families = malloc(count * sizeof(uint32_t));
+    wchar_t* scratch = malloc(8192 * sizeof(wchar_t));
+    size_t baseCount = 0;
+    uint32_t nextFamily = 0;
+    bool ok = stream->text && stream->texts && bases && families && scratch;
+
+    uint64_t rng = 88172645463325252ull;
+    for (size_t i = 0; ok && i < count; ++i) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        unsigned roll = (unsigned)(rng % 100);
+        CopyKind kind = baseCount == 0 || roll < 55 ? COPY_NEW : roll < 70 ? COPY_REWRITTEN
+                      : roll < 80 ? COPY_NUMBERS : roll < 90 ? COPY_WHITESPACE : COPY_EDITED;
+        size_t recent = baseCount < RECENT_BASES ? baseCount : RECENT_BASES;
+        size_t pick = recent ? baseCount - 1 - (size_t)(rng >> 32) % recent : 0;
+        uint64_t base = kind == COPY_NEW ? rng : bases[pick];
+        size_t words = WordCount(base);
+        if (kind == COPY_EDITED && words < 8) kind = COPY_NUMBERS; // One word of a few is not a near-duplicate
+
+        wchar_t* out = stream->text + stream->used;
+        size_t length;
+        switch (kind) {
+        case COPY_NEW: length = Generate(out, base, base, words, 0, SIZE_MAX, SIZE_MAX); break;
+        case COPY_REWRITTEN: length = Generate(out, base, base, words, rng, words / 2, SIZE_MAX); break;
+        case COPY_NUMBERS: length = Generate(out, base, rng, words, 0, SIZE_MAX, SIZE_MAX); break;
+        case COPY_WHITESPACE:
+            length = Generate(scratch, base, base, words, 0, SIZE_MAX, SIZE_MAX);
+            length = Respace(out, scratch, length);
+            break;
+        default: length = Generate(out, base, base, words, 0, SIZE_MAX, (size_t)(rng >> 40) % words); break;
+        }
+        StreamText* text = &stream->texts[stream->count++];
+        text->kind = kind;
+        text->offset = stream->used;
+        text->length = length;
+        if (kind == COPY_NEW) {
+            bases[baseCount] = base;
+            families[baseCount++] = text->family = nextFamily++;
+        } else {
+            text->family = kind == COPY_REWRITTEN ? nextFamily++ : families[pick]; // Rewritten ones are not varied
+        }
+        stream->used += length + 1;
+        if (stream->used + 8192 > stream->capacity) {
+            wchar_t* grown = realloc(stream->text, stream->capacity * 2 * sizeof(wchar_t));
+            if (grown) {
+                stream->text = grown;
+                stream->capacity *= 2;
+            } else {
+                ok = false;
+            }
+        }
+    }
+    free(bases);
+    free(families);
+    free(scratch);
+    return ok;
+}
+
+static void
+FreeStream(Stream* stream)
+{
+    free(stream->text);
+    free(stream->texts);
+}
+
+// Detection over the stream with every text indexed as it comes
+static void
+BenchPrecision(const Stream* stream, unsigned maxDistance, unsigned minWords)
+{
+    NearDupConfig config;
+    NearDupDefaultConfig(&config);
+    config.maxDistance = maxDistance;
+    config.minWords = minWords;
+    NearDupIndex index;
+    if (!NearDupInit(&index, &config)) return;
+
+    size_t found[COPY_KIND_COUNT] = { 0 }, right[COPY_KIND_COUNT] = { 0 }, total[COPY_KIND_COUNT] = { 0 };
+    uint64_t start = BenchNowNs();
+    for (size_t i = 0; i < stream->count; ++i) {
+        const StreamText* text = &stream->texts[i];
+        NearDupPrint print;
+        NearDupFingerprint(stream->text + text->offset, text->length, &print);
+        uint32_t seq;
+        total[text->kind]++;
+        if (NearDupFind(&index, &print, 0, &seq)) {
+            found[text->kind]++;
+            right[text->kind] += stream->texts[seq].family == text->family && text->kind >= COPY_NUMBERS;
+        }
+        NearDupAdd(&index, (uint32_t)i, &print);
+    }
+    uint64_t elapsed = BenchNowNs() - start;
+
+    size_t detected = 0, correct = 0, positives = 0;
+    for (int kind = 0; kind < COPY_KIND_COUNT; ++kind) {
+        detected += found[kind];
+        correct += right[kind];
+        positives += kind >= COPY_NUMBERS ? total[kind] : 0;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "ingest, %u bits, %u words", maxDistance, minWords);
+    BenchReport(name, stream->count, stream->count, elapsed);
+    printf("  precision %.4f  recall %.4f  (%.1f candidates/find, %.1f MB)\n",
+           detected ? (double)correct / detected : 1.0, positives ? (double)correct / positives : 1.0,
+           (double)index.candidates / stream->count, NearDupMemory(&index) / 1048576.0);
+    printf("  matched:");
+    for (int kind = 0; kind < COPY_KIND_COUNT; ++kind) {
+        printf(" %s %.3f", g_kindNames[kind], total[kind] ? (double)found[kind] / total[kind] : 0.0);
+    }
+    printf("\n");
+    NearDupFree(&index);
+}
+
+// The same lookups as a comparison against every stored sketch
+static void
+BenchLinearScan(const Stream* stream)
+{
+    size_t count = stream->count;
+    NearDupPrint* prints = malloc(count * sizeof(NearDupPrint));
+    if (!prints) return;
+    for (size_t i = 0; i < count; ++i) {
+        NearDupFingerprint(stream->text + stream->texts[i].offset, stream->texts[i].length, &prints[i]);
+    }
+
+    NearDupConfig config;
+    NearDupDefaultConfig(&config);
+    NearDupIndex index;
+    if (!NearDupInit(&index, &config)) {
+        free(prints);
+        return;
+    }
+    // Lookups of the last texts among all those before them
+    size_t queries = 2000, stored = count - queries, hits = 0;
+    for (size_t i = 0; i < stored; ++i) NearDupAdd(&index, (uint32_t)i, &prints[i]);
+    uint64_t start = BenchNowNs();
+    for (size_t q = stored; q < count; ++q) {
+        uint32_t seq;
+        hits += NearDupFind(&index, &prints[q], 0, &seq);
+    }
+    BenchReport("find, LSH", stored, queries, BenchNowNs() - start);
+    printf("  %zu near-duplicates\n", hits);
+
+    hits = 0;
+    start = BenchNowNs();
+    for (size_t q = stored; q < count; ++q) {
+        bool hit = false;
+        for (size_t i = 0; i < stored; ++i) {
+            hit = hit || prints[i].exact == prints[q].exact ||
+                  (prints[q].words >= config.minWords && prints[i].words >= config.minWords &&
+                   NearDupDistance(prints[i].sketch, prints[q].sketch) <= config.maxDistance);
+        }
+        hits += hit;
+    }
+    BenchReport("find, linear scan", stored, queries, BenchNowNs() - start);
+    printf("  %zu near-duplicates\n", hits);
+
+    uint64_t chars = 0;
+    start = BenchNowNs();
+    for (size_t i = 0; i < count; ++i) {
+        NearDupFingerprint(stream->text + stream->texts[i].offset, stream->texts[i].length, &prints[i]);
+        chars += stream->texts[i].length;
+    }
+    uint64_t elapsed = BenchNowNs() - start;
+    BenchReport("fingerprint", count, count, elapsed);
+    printf("  %.2f ns/char, %.0f chars per text\n", (double)elapsed / chars, (double)chars / count);
+    NearDupFree(&index);
+    free(prints);
+}
+
+// HistoryAdd of the whole stream, with and without replacing near-duplicates
+static void
+BenchHistoryAdd(const Stream* stream, size_t maxEntries, bool nearDuplicates)
+{
+    History history;
+    if (!HistoryInit(&history, maxEntries)) return;
+    NearDupConfig config;
+    NearDupDefaultConfig(&config);
+    if (nearDuplicates) HistoryEnableNearDuplicates(&history, &config);
+    uint64_t start = BenchNowNs();
+    for (size_t i = 0; i < stream->count; ++i) HistoryAdd(&history, stream->text + stream->texts[i].offset);
+    uint64_t elapsed = BenchNowNs() - start;
+    char name[64];
+    snprintf(name, sizeof(name), "HistoryAdd, %zu slots%s", maxEntries, nearDuplicates ? ", near-dups" : "");
+    BenchReport(name, stream->count, stream->count, elapsed);
+    printf("  %zu entries, %zu evicted, %zu replaced\n", history.count, history.evictions, history.nearDuplicates);
+    HistoryFree(&history);
+}
+
+void
+BenchNearDup(void)
+{
+    Stream stream;
+    if (!BuildStream(&stream, STREAM_TEXTS)) {
+        printf("  out of memory\n");
+        FreeStream(&stream);
+        return;
+    }
+    static const unsigned distances[] = { 0, 3, 5, 7 };
+    for (size_t d = 0; d < sizeof(distances) / sizeof(distances[0]); ++d) {
+        BenchPrecision(&stream, distances[d], NEARDUP_DEFAULT_MIN_WORDS);
+    }
+    BenchPrecision(&stream, NEARDUP_DEFAULT_DISTANCE, 4);
+    BenchPrecision(&stream, NEARDUP_DEFAULT_DISTANCE, 16);
+    BenchLinearScan(&stream);
+    BenchHistoryAdd(&stream, 128, false);
+    BenchHistoryAdd(&stream, 128, true);
+    BenchHistoryAdd(&stream, STREAM_TEXTS, false);
+    BenchHistoryAdd(&stream, STREAM_TEXTS, true);
+    FreeStream(&stream);
+}
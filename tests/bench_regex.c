@@ -0,0 +1,135 @@
+#include "bench.h"
+#include "../code/search.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define REGEX_HISTORY 100000
+#define REGEX_ADVERSARIAL_TEXTS 200
+#define REGEX_ADVERSARIAL_CHARS 4096
+
+static bool
+BenchCountHit(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry; (void)index;
+    (*(size_t*)context)++;
+    return true;
+}
+
+// Full regex runs over the stored history. MB/s counts the wchar_t text of
+// every entry, as a substring scan would read it.
+static void
+BenchRegexRun(const History* history, size_t textBytes, const wchar_t* pattern, const char* name)
+{
+    SearchState search;
+    SearchInit(&search);
+
+    // The first run compiles the pattern and builds the DFA; reported separately
+    size_t hits = 0;
+    uint64_t start = BenchNowNs();
+    SearchRunRegex(&search, history, pattern, BenchCountHit, &hits);
+    uint64_t first = BenchNowNs() - start;
+
+    const size_t rounds = 10;
+    start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) {
+        hits = 0;
+        SearchRunRegex(&search, history, pattern, BenchCountHit, &hits);
+    }
+    uint64_t elapsed = BenchNowNs() - start;
+    BenchReport(name, history->count, rounds * history->count, elapsed);
+    const Regex* regex = search.regexes.slots[0];
+    printf("  %.0f MB/s, %zu hits, first run %.2f ms, %u DFA states, %u classes\n",
+           (double)textBytes * rounds / (elapsed / 1e9) / 1e6, hits, first / 1e6,
+           regex ? regex->dfa.count : 0, regex ? regex->classCount : 0);
+    SearchFree(&search);
+}
+
+// Patterns that make backtracking engines (or a DFA without a budget) blow
+// up, matched against texts built to trigger them. Reports the worst text.
+static void
+BenchAdversarial(const wchar_t* pattern, wchar_t** texts, size_t count, size_t length, const char* name)
+{
+    Regex regex;
+    if (RegexCompile(&regex, pattern, wcslen(pattern)) != REGEX_OK) return;
+
+    uint64_t total = 0, worst = 0;
+    size_t matches = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t start = BenchNowNs();
+        matches += RegexMatch(&regex, texts[i], length);
+        uint64_t elapsed = BenchNowNs() - start;
+        total += elapsed;
+        if (elapsed > worst) worst = elapsed;
+    }
+    BenchReport(name, count, count * length, total);
+    printf("  worst text %.3f ms (%.1f ns/char), %zu matches, %zu DFA flushes\n",
+           worst / 1e6, (double)worst / length, matches, regex.dfa.flushes);
+    RegexFree(&regex);
+}
+
+void
+BenchRegex(void)
+{
+    History history;
+    if (!HistoryInit(&history, REGEX_HISTORY)) return;
+
+    static const wchar_t* const words[] = {
+        L"config", L"server", L"deploy", L"commit", L"branch", L"release", L"review", L"client",
+        L"session", L"cache", L"invoice", L"meeting", L"password", L"template", L"window", L"buffer",
+    };
+    wchar_t buffer[200];
+    size_t textBytes = 0;
+    unsigned n = 4321;
+    for (size_t i = 0; i < REGEX_HISTORY; ++i) {
+        n = n * 1103515245u + 12345u;
+        unsigned a = n;
+        n = n * 1103515245u + 12345u;
+        switch (i % 4) {
+        case 0:
+            swprintf(buffer, 200, L"2024-05-%02u %02u:%02u:%02u INFO %ls %ls from 10.%u.%u.%u took %u ms",
+                     1 + a % 28, a % 24, (a >> 5) % 60, (a >> 11) % 60, words[a % 16], words[(a >> 4) % 16],
+                     (n >> 8) % 256, (n >> 16) % 256, n % 256, (n >> 3) % 5000);
+            break;
+        case 1:
+            swprintf(buffer, 200, L"%ls the %ls before %ls, see PROJ-%u and ticket #%u",
+                     words[a % 16], words[(a >> 4) % 16], words[(a >> 8) % 16], (n >> 12) % 20000, n % 100000);
+            break;
+        case 2:
+            swprintf(buffer, 200, L"commit %08x%08x%08x%08x%08x %ls: %ls %ls",
+                     a, n, a ^ n, a * 31u, n * 17u, words[a % 16], words[(n >> 4) % 16], words[(n >> 8) % 16]);
+            break;
+        default:
+            swprintf(buffer, 200, L"C:\\Users\\dev\\src\\%ls_%u\\%ls.cpp line %u",
+                     words[a % 16], (a >> 12) % 100, words[(n >> 16) % 16], (n >> 3) % 5000);
+            break;
+        }
+        textBytes += wcslen(buffer) * sizeof(wchar_t);
+        HistoryAdd(&history, buffer);
+    }
+
+    BenchRegexRun(&history, textBytes, L"\\bPROJ-\\d{4,5}\\b", "regex ticket id");
+    BenchRegexRun(&history, textBytes, L"\\b\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}\\b", "regex IPv4");
+    BenchRegexRun(&history, textBytes, L"\\b[0-9a-f]{40}\\b", "regex SHA-1");
+    BenchRegexRun(&history, textBytes, L"(deploy|release).*(server|client)", "regex alternation");
+    BenchRegexRun(&history, textBytes, L"qzx", "regex no match");
+    HistoryFree(&history);
+
+    // Adversarial: a/b strings for the exponential DFA, x runs for nested repetition
+    wchar_t* texts[REGEX_ADVERSARIAL_TEXTS];
+    size_t built = 0;
+    for (; built < REGEX_ADVERSARIAL_TEXTS; ++built) {
+        texts[built] = malloc(REGEX_ADVERSARIAL_CHARS * sizeof(wchar_t));
+        if (!texts[built]) break;
+        for (size_t c = 0; c < REGEX_ADVERSARIAL_CHARS; ++c) {
+            n = n * 1103515245u + 12345u;
+            texts[built][c] = (n >> 16) & 1 ? L'a' : L'b';
+        }
+    }
+    BenchAdversarial(L"a(a|b){15}$", texts, built, REGEX_ADVERSARIAL_CHARS, "regex (a|b){15} from the end");
+    BenchAdversarial(L"a(a|b){15}c", texts, built, REGEX_ADVERSARIAL_CHARS, "regex (a|b){15} no match");
+    for (size_t i = 0; i < built; ++i) wmemset(texts[i], L'x', REGEX_ADVERSARIAL_CHARS);
+    BenchAdversarial(L"(x+x+)+y", texts, built, REGEX_ADVERSARIAL_CHARS, "regex (x+x+)+y");
+    BenchAdversarial(L"(.*){10}y", texts, built, REGEX_ADVERSARIAL_CHARS, "regex (.*){10}y");
+    for (size_t i = 0; i < built; ++i) free(texts[i]);
+}
@@ -0,0 +1,27 @@
+#include "bench.h"
+#include "replay.h"
+
+// The standard traces through mclip's ingestion path with its settings (see
+// tests/replay.h; mclip_replay compares them against saved baselines)
+void
+BenchReplay(void)
+{
+    ReplayConfig config;
+    ReplayConfigDefaults(&config); // No spill file: oversized entries are truncated
+    static ReplayResult result;
+
+    for (size_t i = 0; i < g_replayTraceCount; ++i) {
+        const ReplayTraceSpec* spec = &g_replayTraces[i];
+        ReplayTrace trace;
+        if (!ReplayTraceGenerate(&trace, spec)) return;
+        if (ReplayRun(&trace, &config, &result)) {
+            char name[64];
+            snprintf(name, sizeof(name), "replay %s", spec->name);
+            BenchReport(name, result.events, result.events, result.workNs);
+            printf("  %.0f events/s, %zu stored, p50 %.1f us, p99 %.1f us, peak %.2f MB\n", result.eventsPerSec,
+                   result.stored, LatencyHistogramPercentile(&result.latency, 50) / 1e3,
+                   LatencyHistogramPercentile(&result.latency, 99) / 1e3, result.peakBytes / 1e6);
+        }
+        ReplayTraceFree(&trace);
+    }
+}
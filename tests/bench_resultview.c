@@ -0,0 +1,56 @@
+#include "bench.h"
+#include "../code/resultview.h"
+
+#define VIEW_HISTORY 131072
+#define VIEW_VISIBLE_ROWS 20
+
+// One refresh plus painting a screenful of rows, as the UI does per update
+static void
+BenchRefresh(const History* history, const wchar_t* query, const char* name)
+{
+    SearchState search;
+    ResultView view;
+    SearchInit(&search);
+    ResultViewInit(&view);
+
+    const size_t rounds = 50;
+    size_t textChars = 0;
+    uint64_t start = BenchNowNs();
+    for (size_t r = 0; r < rounds; ++r) {
+        SearchReset(&search);
+        ResultViewRefresh(&view, &search, history, query);
+        size_t count = ResultViewCount(&view);
+        size_t top = count > VIEW_VISIBLE_ROWS ? count - VIEW_VISIBLE_ROWS : 0;
+        for (size_t row = top; row < count; ++row) {
+            const HistoryEntry* entry = ResultViewGet(&view, history, row);
+            if (entry) textChars += entry->length;
+        }
+    }
+    uint64_t elapsed = BenchNowNs() - start;
+
+    BenchReport(name, history->count, rounds, elapsed);
+    printf("  %zu rows, %zu bytes of row state, %zu chars painted\n",
+           ResultViewCount(&view), view.capacity * sizeof(uint32_t), textChars / rounds);
+
+    ResultViewFree(&view);
+    SearchFree(&search);
+}
+
+void
+BenchResultView(void)
+{
+    History history;
+    if (!HistoryInit(&history, VIEW_HISTORY)) return;
+
+    wchar_t buffer[128];
+    for (size_t i = 0; i < VIEW_HISTORY; ++i) {
+        swprintf(buffer, 128, L"entry %zu copied from window %zu of process %zu", i, i % 41, i % 7);
+        HistoryAdd(&history, buffer);
+    }
+
+    BenchRefresh(&history, NULL, "refresh (unfiltered)");
+    BenchRefresh(&history, L"process", "refresh (every entry matches)");
+    BenchRefresh(&history, L"window 40 ", "refresh (1 in 41 matches)");
+
+    HistoryFree(&history);
+}
@@ -0,0 +1,63 @@
+#include "bench.h"
+#include "../code/search.h"
+
+#include <string.h>
+
+#define SEARCH_HISTORY 131072
+
+static bool
+CountVisit(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry; (void)index;
+    (*(size_t*)context)++;
+    return true;
+}
+
+// Simulates typing 'query' one character at a time, one search per keystroke
+static void
+BenchTyping(const History* history, const wchar_t* query, bool incremental)
+{
+    SearchState search;
+    SearchInit(&search);
+
+    wchar_t typed[128];
+    size_t length = wcslen(query);
+    size_t tested = 0;
+    size_t hits = 0;
+
+    uint64_t start = BenchNowNs();
+    for (size_t i = 1; i <= length; ++i) {
+        wmemcpy(typed, query, i);
+        typed[i] = L'\0';
+        if (!incremental) SearchReset(&search);
+        hits = 0;
+        SearchRun(&search, history, typed, CountVisit, &hits);
+        tested += search.lastTested;
+    }
+    uint64_t elapsed = BenchNowNs() - start;
+
+    BenchReport(incremental ? "typing (incremental)" : "typing (full rescan)",
+                history->count, length, elapsed);
+    printf("  %zu entries tested over %zu keystrokes, %zu final hits\n", tested, length, hits);
+
+    SearchFree(&search);
+}
+
+void
+BenchSearch(void)
+{
+    History history;
+    if (!HistoryInit(&history, SEARCH_HISTORY)) return;
+
+    wchar_t buffer[160];
+    for (size_t i = 0; i < SEARCH_HISTORY; ++i) {
+        swprintf(buffer, 160, L"2023-10-%02zu 12:%02zu:%02zu INFO worker-%zu processed request id=%zu from host-%zu",
+                 i % 28 + 1, (i / 60) % 60, i % 60, i % 16, i, i % 97);
+        HistoryAdd(&history, buffer);
+    }
+
+    BenchTyping(&history, L"worker-3 processed request id=12", false);
+    BenchTyping(&history, L"worker-3 processed request id=12", true);
+
+    HistoryFree(&history);
+}
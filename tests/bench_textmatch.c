@@ -0,0 +1,106 @@
+#include "bench.h"
+#include "../code/textmatch.h"
+
+#include <stdlib.h>
+
+typedef const wchar_t* (*FindFn)(const wchar_t*, size_t, const wchar_t*, size_t);
+
+static const char*
+LevelName(TextSimdLevel level)
+{
+    switch (level) {
+        case TEXT_SIMD_AVX2: return "avx2";
+        case TEXT_SIMD_SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+// Mixed-case ASCII prose; the needle is planted (case-flipped) at the very end
+static void
+FillHaystack(wchar_t* hay, size_t length, const wchar_t* needle, size_t needleLen)
+{
+    static const wchar_t words[] = L"The quick Brown fox jumps over the Lazy dog while logging Requests ";
+    const size_t wordsLen = sizeof(words) / sizeof(words[0]) - 1;
+    for (size_t i = 0; i < length; ++i) hay[i] = words[i % wordsLen];
+    for (size_t j = 0; j < needleLen && j < length; ++j) {
+        wchar_t c = needle[j];
+        hay[length - needleLen + j] = (c >= L'a' && c <= L'z') ? (wchar_t)(c - 32) : c;
+    }
+}
+
+static void
+BenchFind(size_t hayLen, size_t needleLen)
+{
+    // Starts with a character absent from the filler so every find scans to the end
+    static const wchar_t needleSource[] = L"#ebra-crossing-quantum-xylophone";
+    wchar_t* hay = malloc(hayLen * sizeof(wchar_t));
+    if (!hay) return;
+    FillHaystack(hay, hayLen, needleSource, needleLen);
+
+    size_t rounds = 20000000 / (hayLen + 16) + 1;
+    for (int level = TEXT_SIMD_NONE; level <= TEXT_SIMD_AVX2; ++level) {
+        if (TextSetSimdLevel((TextSimdLevel)level) != (TextSimdLevel)level) continue;
+        FindFn find = level == TEXT_SIMD_NONE ? TextFindNoCaseScalar : TextFindNoCase;
+
+        size_t found = 0;
+        uint64_t start = BenchNowNs();
+        for (size_t r = 0; r < rounds; ++r) {
+            found += find(hay, hayLen, needleSource, needleLen) != NULL;
+        }
+        uint64_t elapsed = BenchNowNs() - start;
+
+        char name[64];
+        snprintf(name, sizeof(name), "find %-6s needle=%zu", LevelName((TextSimdLevel)level), needleLen);
+        BenchReport(name, hayLen, rounds, elapsed);
+        printf("  %.2f GB/s%s\n", (double)hayLen * sizeof(wchar_t) * rounds / elapsed,
+               found == rounds ? "" : "  (MISSED MATCHES)");
+    }
+    free(hay);
+}
+
+static void
+BenchEquals(size_t length)
+{
+    wchar_t* a = malloc(length * sizeof(wchar_t));
+    wchar_t* b = malloc(length * sizeof(wchar_t));
+    if (!a || !b) { free(a); free(b); return; }
+    FillHaystack(a, length, L"", 0);
+    for (size_t i = 0; i < length; ++i) {
+        b[i] = (a[i] >= L'a' && a[i] <= L'z') ? (wchar_t)(a[i] - 32) : a[i];
+    }
+
+    size_t rounds = 20000000 / (length + 16) + 1;
+    for (int level = TEXT_SIMD_NONE; level <= TEXT_SIMD_AVX2; ++level) {
+        if (TextSetSimdLevel((TextSimdLevel)level) != (TextSimdLevel)level) continue;
+
+        size_t equal = 0;
+        uint64_t start = BenchNowNs();
+        for (size_t r = 0; r < rounds; ++r) {
+            equal += level == TEXT_SIMD_NONE ? TextEqualsNoCaseScalar(a, length, b, length)
+                                             : TextEqualsNoCase(a, length, b, length);
+        }
+        uint64_t elapsed = BenchNowNs() - start;
+
+        char name[64];
+        snprintf(name, sizeof(name), "equals %-6s", LevelName((TextSimdLevel)level));
+        BenchReport(name, length, rounds, elapsed);
+        if (equal != rounds) printf("  (WRONG RESULT)\n");
+    }
+    free(a);
+    free(b);
+}
+
+void
+BenchTextMatch(void)
+{
+    static const size_t hayLengths[] = { 16, 64, 256, 4096, 65536 };
+    static const size_t needleLengths[] = { 1, 3, 8, 32 };
+
+    for (size_t h = 0; h < sizeof(hayLengths) / sizeof(hayLengths[0]); ++h) {
+        for (size_t n = 0; n < sizeof(needleLengths) / sizeof(needleLengths[0]); ++n) {
+            if (needleLengths[n] <= hayLengths[h]) BenchFind(hayLengths[h], needleLengths[n]);
+        }
+        BenchEquals(hayLengths[h]);
+    }
+    TextSetSimdLevel(TEXT_SIMD_AUTO);
+}
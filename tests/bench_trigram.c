@@ -0,0 +1,102 @@
+#include "bench.h"
+#include "../code/history.h"
+
+#include <stdlib.h>
+
+#define TRIGRAM_ENTRIES 100000
+#define TRIGRAM_WORDS 24
+
+static const wchar_t* g_vocabulary[] = {
+    L"error", L"warning", L"request", L"response", L"timeout", L"connection", L"user",
+    L"session", L"token", L"config", L"value", L"index", L"buffer", L"thread", L"queue",
+    L"server", L"client", L"cache", L"update", L"delete", L"insert", L"select", L"from",
+    L"where", L"function", L"return", L"const", L"static", L"struct", L"import",
+};
+
+// Pseudo-random text with a numeric id, so entries are distinct and rare tokens exist
+static void
+MakeText(wchar_t* buffer, size_t size, uint32_t* state, size_t id)
+{
+    const size_t vocabulary = sizeof(g_vocabulary) / sizeof(g_vocabulary[0]);
+    size_t used = (size_t)swprintf(buffer, size, L"#%zu", id);
+    for (int w = 0; w < TRIGRAM_WORDS && used + 16 < size; ++w) {
+        *state = *state * 1664525u + 1013904223u;
+        used += (size_t)swprintf(buffer + used, size - used, L" %ls", g_vocabulary[(*state >> 8) % vocabulary]);
+    }
+}
+
+static bool
+CountVisit(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry; (void)index;
+    (*(size_t*)context)++;
+    return true;
+}
+
+static void
+BenchQuery(const History* history, const wchar_t* query, const char* label)
+{
+    size_t hits = 0;
+    HistoryScanControl control = {0};
+    const int rounds = 20;
+    uint64_t start = BenchNowNs();
+    for (int r = 0; r < rounds; ++r) {
+        hits = 0;
+        control.tested = 0;
+        HistoryScan(history, query, wcslen(query), CountVisit, &hits, &control);
+    }
+    BenchReport(label, history->count, rounds, BenchNowNs() - start);
+    printf("  query \"%ls\": %zu hits, %zu entries verified\n", query, hits, control.tested);
+}
+
+static void
+BenchFill(History* history, bool indexed)
+{
+    if (indexed) HistoryEnableTrigramIndex(history, true);
+
+    wchar_t buffer[512];
+    uint32_t state = 99;
+    uint64_t start = BenchNowNs();
+    for (size_t i = 0; i < TRIGRAM_ENTRIES; ++i) {
+        MakeText(buffer, 512, &state, i);
+        HistoryAdd(history, buffer);
+    }
+    BenchReport(indexed ? "ingest (trigram index)" : "ingest (no index)",
+                TRIGRAM_ENTRIES, TRIGRAM_ENTRIES, BenchNowNs() - start);
+}
+
+void
+BenchTrigram(void)
+{
+    History plain, indexed;
+    if (!HistoryInit(&plain, TRIGRAM_ENTRIES)) return;
+    if (!HistoryInit(&indexed, TRIGRAM_ENTRIES)) { HistoryFree(&plain); return; }
+
+    BenchFill(&plain, false);
+    BenchFill(&indexed, true);
+
+    HistoryStats stats;
+    HistoryGetStats(&indexed, &stats);
+    printf("  text %zu MB, trigram index %zu MB (%.0f%% of text), %zu postings\n",
+           stats.textBytes >> 20, stats.trigramBytes >> 20,
+           100.0 * stats.trigramBytes / stats.textBytes, stats.trigramPostings);
+
+    static const wchar_t* queries[] = { L"#4242 ", L"#99", L"timeout connection", L"token" };
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); ++q) {
+        BenchQuery(&plain, queries[q], "search (full scan)");
+        BenchQuery(&indexed, queries[q], "search (trigram)");
+    }
+
+    // Steady-state churn with the index: insert + evict + list trimming
+    wchar_t buffer[512];
+    uint32_t state = 7;
+    uint64_t start = BenchNowNs();
+    for (size_t i = 0; i < TRIGRAM_ENTRIES / 4; ++i) {
+        MakeText(buffer, 512, &state, TRIGRAM_ENTRIES + i);
+        HistoryAdd(&indexed, buffer);
+    }
+    BenchReport("ingest (trigram, evicting)", TRIGRAM_ENTRIES, TRIGRAM_ENTRIES / 4, BenchNowNs() - start);
+
+    HistoryFree(&plain);
+    HistoryFree(&indexed);
+}
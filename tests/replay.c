@@ -0,0 +1,414 @@
+#include "replay.h"
+#include "../code/platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLAY_NO_TIME UINT64_MAX
+#define REPLAY_RECENT 8 // Repeats pick among this many latest contents most of the time
+
+// Sessions worth comparing across changes: typed snippets, a mixed day,
+// fillClipboard.bat's burst, huge pastes, and copying the same few things
+const ReplayTraceSpec g_replayTraces[] = {
+    //  name       events  chars          images         dups  burst       busy           seed
+    { "snippets",  20000,  4, 120,        0.0,  0,       0.30, 1, 0, 3000, 0.02, 20,      1 },
+    { "mixed",     20000,  8, 200000,     0.05, 2 << 20, 0.20, 4, 300, 8000, 0.05, 50,   2 },
+    { "burst",     20000,  1, 8,          0.0,  0,       0.00, 1000, 15, 5000, 0.20, 30, 3 },
+    { "large",       500,  50000, 4 << 20, 0.0, 0,       0.10, 1, 0, 10000, 0.10, 200,  4 },
+    { "repeats",   20000,  16, 4000,      0.02, 256 << 10, 0.90, 3, 200, 4000, 0.02, 20, 5 },
+};
+const size_t g_replayTraceCount = sizeof(g_replayTraces) / sizeof(g_replayTraces[0]);
+
+static const wchar_t* const g_words[] = {
+    L"the", L"clipboard", L"history", L"return", L"buffer", L"size_t", L"window", L"search",
+    L"of", L"and", L"int", L"const", L"struct", L"error", L"file", L"path", L"https://example.com/a",
+    L"SELECT", L"FROM", L"WHERE", L"null", L"true", L"0x7f", L"{", L"}", L"=", L"to", L"is",
+};
+#define REPLAY_WORD_COUNT (sizeof(g_words) / sizeof(g_words[0]))
+
+static inline uint32_t
+ReplayRandom(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Uniform in [0, 1)
+static inline double
+ReplayUniform(uint32_t* state)
+{
+    return (ReplayRandom(state) >> 8) / 16777216.0;
+}
+
+// Log-uniform over [min, max], a doubling at a time, so small and huge sizes are equally likely per scale
+static uint32_t
+ReplaySize(uint32_t* state, uint32_t min, uint32_t max)
+{
+    if (min >= max) return min;
+    uint32_t doublings = 0;
+    while (((uint64_t)min << (doublings + 1)) <= max) doublings++;
+    uint64_t low = (uint64_t)min << (ReplayRandom(state) % (doublings + 1));
+    uint64_t size = low + ReplayRandom(state) % low;
+    return size > max ? max : (uint32_t)size;
+}
+
+const ReplayTraceSpec*
+ReplayFindTrace(const char* name)
+{
+    for (size_t i = 0; i < g_replayTraceCount; ++i) {
+        if (strcmp(g_replayTraces[i].name, name) == 0) return &g_replayTraces[i];
+    }
+    return NULL;
+}
+
+// --- Traces ---
+
+void
+ReplayTraceInit(ReplayTrace* trace)
+{
+    memset(trace, 0, sizeof(*trace));
+}
+
+void
+ReplayTraceFree(ReplayTrace* trace)
+{
+    free(trace->events);
+    memset(trace, 0, sizeof(*trace));
+}
+
+bool
+ReplayTraceAppend(ReplayTrace* trace, const ReplayEvent* event)
+{
+    if (trace->count == trace->capacity) {
+        size_t capacity = trace->capacity ? trace->capacity * 2 : 1024;
+        ReplayEvent* grown = realloc(trace->events, capacity * sizeof(ReplayEvent));
+        if (!grown) return false;
+        trace->events = grown;
+        trace->capacity = capacity;
+    }
+    trace->events[trace->count++] = *event;
+    return true;
+}
+
+bool
+ReplayTraceGenerate(ReplayTrace* trace, const ReplayTraceSpec* spec)
+{
+    ReplayTraceInit(trace);
+    ReplayEvent* distinct = malloc((spec->events ? spec->events : 1) * sizeof(ReplayEvent));
+    if (!distinct) return false;
+    size_t distinctCount = 0;
+
+    uint32_t state = spec->seed * 2654435761u + 1;
+    uint64_t at = 0;
+    bool ok = true;
+    for (size_t i = 0; ok && i < spec->events; ++i) {
+        if (i > 0) {
+            bool newBurst = spec->burstLength <= 1 || i % spec->burstLength == 0;
+            at += (uint64_t)(newBurst ? spec->idleMs : spec->burstGapMs) * 1000000u;
+        }
+
+        ReplayEvent event;
+        if (distinctCount > 0 && ReplayUniform(&state) < spec->duplicateRate) {
+            size_t recent = distinctCount < REPLAY_RECENT ? distinctCount : REPLAY_RECENT;
+            size_t back = ReplayRandom(&state) % 5 != 0 ? ReplayRandom(&state) % recent
+                                                       : ReplayRandom(&state) % distinctCount;
+            event = distinct[distinctCount - 1 - back];
+        } else {
+            memset(&event, 0, sizeof(event));
+            event.contentId = (uint32_t)distinctCount + 1;
+            if (ReplayUniform(&state) < spec->imageRate) {
+                event.formatBytes = ReplaySize(&state, spec->imageBytes / 16 + 1, spec->imageBytes);
+            } else {
+                event.textChars = ReplaySize(&state, spec->minChars, spec->maxChars);
+            }
+            distinct[distinctCount++] = event;
+        }
+        event.atNs = at;
+        event.busyMs = ReplayUniform(&state) < spec->busyRate ? 1 + ReplayRandom(&state) % spec->busyMs : 0;
+        ok = ReplayTraceAppend(trace, &event);
+    }
+    free(distinct);
+    if (!ok) ReplayTraceFree(trace);
+    return ok;
+}
+
+bool
+ReplayTraceSave(const ReplayTrace* trace, const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+    fprintf(file, "# mclip trace 1\n# at_us text_chars format_bytes content_id busy_ms\n");
+    for (size_t i = 0; i < trace->count; ++i) {
+        const ReplayEvent* event = &trace->events[i];
+        fprintf(file, "%llu %lu %lu %lu %lu\n", (unsigned long long)(event->atNs / 1000),
+                (unsigned long)event->textChars, (unsigned long)event->formatBytes,
+                (unsigned long)event->contentId, (unsigned long)event->busyMs);
+    }
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+bool
+ReplayTraceLoad(ReplayTrace* trace, const char* path)
+{
+    ReplayTraceInit(trace);
+    FILE* file = fopen(path, "r");
+    if (!file) return false;
+
+    char line[256];
+    bool ok = fgets(line, sizeof(line), file) && strncmp(line, "# mclip trace 1", 15) == 0;
+    while (ok && fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        unsigned long long atUs;
+        unsigned long textChars, formatBytes, contentId, busyMs;
+        if (sscanf(line, "%llu %lu %lu %lu %lu", &atUs, &textChars, &formatBytes, &contentId, &busyMs) != 5) {
+            ok = false;
+            break;
+        }
+        ReplayEvent event = { atUs * 1000, (uint32_t)textChars, (uint32_t)formatBytes, (uint32_t)contentId,
+                              (uint32_t)busyMs };
+        ok = ReplayTraceAppend(trace, &event);
+    }
+    fclose(file);
+    if (!ok) ReplayTraceFree(trace);
+    return ok;
+}
+
+// --- Content ---
+
+void
+ReplayConfigDefaults(ReplayConfig* config)
+{
+    memset(config, 0, sizeof(*config));
+    config->maxEntries = 128;             // DEFAULT_HISTORY_ENTRIES
+    config->maxBytes = 256u << 20;        // DEFAULT_HISTORY_MB
+    config->compressMinBytes = 16 * 1024; // COMPRESS_MIN_BYTES
+    config->compressAge = 32;             // COMPRESS_AFTER_ENTRIES
+    config->maxChars = 1024 * 1024;       // MAX_ENTRY_CHARS
+    config->oversize = HISTORY_OVERSIZE_SPILL;
+    config->captures = true;
+    config->logFlushMs = 2000;            // LOG_FLUSH_DELAY_MS
+}
+
+size_t
+ReplayMakeText(wchar_t* buffer, size_t chars, uint32_t contentId)
+{
+    // Starts with the id, so that texts of different ids differ
+    int prefix = swprintf(buffer, REPLAY_TEXT_SLACK, L"#%lu", (unsigned long)contentId);
+    size_t length = prefix > 0 ? (size_t)prefix : 0;
+    uint32_t state = contentId * 2654435761u + 7;
+    size_t wordsOnLine = 0;
+    while (length < chars) {
+        buffer[length++] = ++wordsOnLine % 12 == 0 ? L'\n' : L' ';
+        const wchar_t* word = g_words[ReplayRandom(&state) % REPLAY_WORD_COUNT];
+        while (*word && length < chars) buffer[length++] = *word++;
+    }
+    buffer[length] = L'\0';
+    return length;
+}
+
+static void
+ReplayMakeImage(unsigned char* buffer, size_t size, uint32_t contentId)
+{
+    uint32_t state = contentId * 2246822519u + 3;
+    for (size_t i = 0; i < size; i += 4) {
+        uint32_t pixel = ReplayRandom(&state) & 0x0f0f0f0f; // Compressible, like screenshots
+        memcpy(buffer + i, &pixel, size - i < 4 ? size - i : 4);
+    }
+}
+
+// --- Fake Clipboard ---
+
+static ClipAttemptResult
+ReplayClipboardRead(void* context, ClipContent* content)
+{
+    ReplayClipboard* clipboard = context;
+    clipboard->reads++;
+    if (clipboard->nowNs < clipboard->busyUntilNs) return CLIP_ATTEMPT_BUSY;
+    if (clipboard->text && ClipExcluded(clipboard->exclude, clipboard->text, clipboard->textLength, content)) {
+        return CLIP_ATTEMPT_ACQUIRED;
+    }
+
+    if (clipboard->source) wcsncpy(content->source, clipboard->source, META_SOURCE_CHARS - 1);
+    if (clipboard->text) {
+        size_t bytes = (clipboard->textLength + 1) * sizeof(wchar_t);
+        content->text = malloc(bytes);
+        if (content->text) memcpy(content->text, clipboard->text, bytes);
+    }
+    if (clipboard->image) {
+        void* copy = malloc(clipboard->imageSize);
+        if (copy) {
+            memcpy(copy, clipboard->image, clipboard->imageSize);
+            CapturePayload* payload = &content->payloads[content->payloadCount++];
+            payload->format = REPLAY_IMAGE_FORMAT;
+            payload->data = copy;
+            payload->size = clipboard->imageSize;
+        }
+    }
+    return CLIP_ATTEMPT_ACQUIRED;
+}
+
+ClipBackend
+ReplayClipboardBackend(ReplayClipboard* clipboard)
+{
+    ClipBackend backend = { ReplayClipboardRead, clipboard };
+    return backend;
+}
+
+// --- Replay ---
+
+// Memory held by the stores: entry slots, text, indexes, captured images
+static size_t
+ReplayMemory(const History* history, const CaptureStore* captures)
+{
+    HistoryStats stats;
+    HistoryGetStats(history, &stats);
+    size_t bytes = stats.slotBytes + stats.reservedBytes + stats.indexBytes +
+                   stats.trigramBytes + stats.metaBytes;
+    if (captures) {
+        bytes += captures->blobs.arena.bytesReserved + captures->blobs.slotCapacity * sizeof(BlobSlot) +
+                 HashIndexMemory(&captures->blobs.index) + captures->capacity * sizeof(CaptureRecord);
+    }
+    return bytes;
+}
+
+static void
+ReplayFlush(HistoryLog* log, ReplayResult* result)
+{
+    uint64_t start = PlatformNowNs();
+    HistoryLogFlush(log);
+    uint64_t elapsed = PlatformNowNs() - start;
+    MetricsRecord(&result->metrics, METRIC_LOG_FLUSH, elapsed);
+    result->workNs += elapsed;
+}
+
+bool
+ReplayRun(const ReplayTrace* trace, const ReplayConfig* config, ReplayResult* result)
+{
+    memset(result, 0, sizeof(*result));
+    MetricsInit(&result->metrics, 0);
+
+    size_t maxChars = 0, maxImage = 0;
+    for (size_t i = 0; i < trace->count; ++i) {
+        if (trace->events[i].textChars > maxChars) maxChars = trace->events[i].textChars;
+        if (trace->events[i].formatBytes > maxImage) maxImage = trace->events[i].formatBytes;
+    }
+    wchar_t* text = malloc((maxChars + REPLAY_TEXT_SLACK) * sizeof(wchar_t));
+    unsigned char* image = malloc(maxImage + 1);
+
+    History history;
+    CaptureStore captures;
+    HistoryLog log;
+    memset(&log, 0, sizeof(log));
+    bool historyReady = false, capturesReady = false;
+    bool ok = text && image && (historyReady = HistoryInit(&history, config->maxEntries ? config->maxEntries : 1));
+    if (ok) {
+        HistorySetLimits(&history, config->maxEntries, config->maxBytes);
+        HistorySetCompression(&history, config->compressMinBytes, config->compressAge);
+        HistorySetSizeLimit(&history, config->maxChars, config->oversize);
+        if (config->spillPath) ok = HistoryOpenSpill(&history, config->spillPath);
+    }
+    if (ok && config->captures) ok = capturesReady = CaptureStoreInit(&captures);
+    if (ok && config->logPath) {
+        char indexPath[1024];
+        snprintf(indexPath, sizeof(indexPath), "%s.idx", config->logPath);
+        PlatformFileDelete(config->logPath); // A fresh log each run
+        PlatformFileDelete(indexPath);
+        ok = HistoryLogOpen(&log, config->logPath, &history) == HISTORY_LOG_OK;
+    }
+
+    ClipAcquire acquire;
+    ClipAcquireInit(&acquire, 1);
+    ReplayClipboard clipboard;
+    memset(&clipboard, 0, sizeof(clipboard));
+    ClipBackend backend = ReplayClipboardBackend(&clipboard);
+    ClipSink sink = { &history, capturesReady ? &captures : NULL, config->logPath ? &log : NULL,
+                      &result->metrics };
+
+    // Copies and retries in virtual time order, as the shell's messages and timers would come
+    uint64_t retryAt = REPLAY_NO_TIME, flushAt = REPLAY_NO_TIME, eventWork = 0;
+    size_t next = 0;
+    while (ok && (next < trace->count || retryAt != REPLAY_NO_TIME)) {
+        uint64_t now;
+        if (next < trace->count && (retryAt == REPLAY_NO_TIME || trace->events[next].atNs <= retryAt)) {
+            // A copy: replaces what is on the clipboard, read or not
+            const ReplayEvent* event = &trace->events[next++];
+            now = event->atNs;
+            clipboard.text = NULL;
+            clipboard.image = NULL;
+            if (event->textChars > 0) {
+                clipboard.textLength = ReplayMakeText(text, event->textChars, event->contentId);
+                clipboard.text = text;
+            }
+            if (event->formatBytes > 0) {
+                ReplayMakeImage(image, event->formatBytes, event->contentId);
+                clipboard.image = image;
+                clipboard.imageSize = event->formatBytes;
+            }
+            clipboard.busyUntilNs = now + (uint64_t)event->busyMs * 1000000u;
+            ClipAcquireNotify(&acquire, now);
+        } else {
+            now = retryAt;
+        }
+        retryAt = REPLAY_NO_TIME;
+        if (flushAt <= now) {
+            ReplayFlush(&log, result);
+            flushAt = REPLAY_NO_TIME;
+        }
+        clipboard.nowNs = now;
+
+        uint64_t start = PlatformNowNs();
+        ClipContent content;
+        unsigned retryMs = ClipTryRead(&backend, &acquire, &result->metrics, &content, now);
+        result->attempts++;
+        if (retryMs > 0) {
+            retryAt = now + (uint64_t)retryMs * 1000000u;
+        } else {
+            // As the shell, an image is listed under a label
+            wchar_t labelText[64];
+            const wchar_t* label = NULL;
+            if (!content.text && content.payloadCount > 0) {
+                swprintf(labelText, 64, L"[Image %lu KB #%lu]", (unsigned long)(content.payloads[0].size / 1024),
+                         (unsigned long)trace->events[next - 1].contentId);
+                label = labelText;
+                content.labelClass = META_CLASS_IMAGE;
+            }
+            uint64_t ingestStart = PlatformNowNs();
+            HistoryAddResult added = ClipIngest(&sink, &content, label);
+            MetricsRecord(&result->metrics, METRIC_ADD_ENTRY, PlatformNowNs() - ingestStart);
+            if (added == HISTORY_ADDED) result->stored++;
+            if (added == HISTORY_NO_MEMORY) ok = false;
+            if (sink.log && flushAt == REPLAY_NO_TIME && log.pendingBytes > 0) {
+                flushAt = now + (uint64_t)config->logFlushMs * 1000000u;
+            }
+        }
+        ClipContentFree(&content);
+        uint64_t elapsed = PlatformNowNs() - start;
+        result->workNs += elapsed;
+        eventWork += elapsed;
+        if (retryMs == 0) {
+            LatencyHistogramRecord(&result->latency, eventWork);
+            eventWork = 0;
+        }
+
+        size_t memory = ReplayMemory(&history, sink.captures);
+        if (memory > result->peakBytes) result->peakBytes = memory;
+    }
+    if (ok && sink.log && log.pendingBytes > 0) ReplayFlush(&log, result);
+
+    result->events = trace->count;
+    result->eventsPerSec = result->workNs ? trace->count / (result->workNs / 1e9) : 0;
+    result->metrics.counters[METRIC_EVICTIONS] = historyReady ? history.evictions : 0;
+    result->metrics.counters[METRIC_CLIPBOARD_RETRIES] = acquire.busy;
+
+    if (capturesReady) CaptureStoreFree(&captures);
+    if (historyReady) HistoryFree(&history);
+    if (config->logPath) HistoryLogClose(&log); // After the history, which borrows from it
+    free(text);
+    free(image);
+    return ok;
+}
@@ -0,0 +1,134 @@
+#ifndef MCLIP_REPLAY_H
+#define MCLIP_REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include "../code/clipingest.h"
+
+// --- Replay Harness ---
+// Feeds clipboard event traces through mclip's own ingestion path
+// (ClipTryRead -> ClipIngest, see code/clipingest.h). A fake clipboard in
+// memory stands in for the Win32 one. Time is virtual: copies, busy
+// clipboards and retries happen at trace time, and only the work is timed,
+// with the real clock. Results are events/sec, per-event latency
+// percentiles, per-stage metrics and the peak memory the stores held.
+//
+// Traces are synthetic (ReplayTraceGenerate) or read from a file. They
+// record the shape of a session only: sizes, repeats and timing. Text and
+// images are made up from each copy's content id, so a trace from a real
+// session gives nothing away. Shared by test_replay.c, bench_replay.c and
+// the mclip_replay tool (replay_main.c).
+
+#define REPLAY_IMAGE_FORMAT 8 // CF_DIB; the engine never interprets format ids
+
+typedef struct {
+    uint64_t atNs;        // When the copy happens, from the start of the trace
+    uint32_t textChars;   // Length of the copied text; 0 for content without text (an image)
+    uint32_t formatBytes; // Size of an image copied with it (0: none)
+    uint32_t contentId;   // Copies with the same id have the same content
+    uint32_t busyMs;      // How long the copying application keeps the clipboard open
+} ReplayEvent;
+
+typedef struct {
+    ReplayEvent* events;
+    size_t count;
+    size_t capacity;
+} ReplayTrace;
+
+// Parameters of a synthetic trace
+typedef struct {
+    const char* name;
+    size_t events;
+    uint32_t minChars;     // Text sizes, log-uniform between these
+    uint32_t maxChars;
+    double imageRate;      // Share of copies that are images without text ...
+    uint32_t imageBytes;   // ... of up to this size
+    double duplicateRate;  // Share of copies that repeat earlier content, mostly recent
+    uint32_t burstLength;  // Copies per burst ...
+    uint32_t burstGapMs;   // ... this far apart ...
+    uint32_t idleMs;       // ... and this long between bursts
+    double busyRate;       // Share of copies whose application holds the clipboard ...
+    uint32_t busyMs;       // ... for up to this long
+    uint32_t seed;
+} ReplayTraceSpec;
+
+// The store the trace is replayed into
+typedef struct {
+    size_t maxEntries;               // HistorySetLimits, 0 = no limit
+    size_t maxBytes;
+    size_t compressMinBytes;         // HistorySetCompression
+    size_t compressAge;
+    size_t maxChars;                 // HistorySetSizeLimit
+    HistoryOversizePolicy oversize;
+    const char* spillPath;           // NULL: oversized entries are truncated
+    bool captures;                   // Keep images (CaptureStore)
+    const char* logPath;             // NULL: entries are not saved
+    unsigned logFlushMs;             // Delay before queued entries are written, as mclip
+} ReplayConfig;
+
+typedef struct {
+    size_t events;             // Copies in the trace ...
+    size_t stored;             // ... that became entries; the rest were repeats, refused or overwritten
+    size_t attempts;           // Clipboard reads, retries of a busy clipboard included
+    uint64_t workNs;           // Real time spent reading, ingesting and saving
+    double eventsPerSec;       // events / workNs
+    size_t peakBytes;          // Most memory the history, its indexes and the captures held at once
+    LatencyHistogram latency;  // Work per copy, from the first read attempt to stored
+    Metrics metrics;           // Per stage
+} ReplayResult;
+
+// The standard traces, for benchmarks and baselines
+extern const ReplayTraceSpec g_replayTraces[];
+extern const size_t g_replayTraceCount;
+
+const ReplayTraceSpec* ReplayFindTrace(const char* name);
+
+void ReplayTraceInit(ReplayTrace* trace);
+void ReplayTraceFree(ReplayTrace* trace);
+bool ReplayTraceAppend(ReplayTrace* trace, const ReplayEvent* event);
+
+// Same spec, same trace. False if memory runs out.
+bool ReplayTraceGenerate(ReplayTrace* trace, const ReplayTraceSpec* spec);
+
+// Text trace files: a "# mclip trace 1" header, then one copy per line:
+// at_us text_chars format_bytes content_id busy_ms
+bool ReplayTraceSave(const ReplayTrace* trace, const char* path);
+bool ReplayTraceLoad(ReplayTrace* trace, const char* path);
+
+// mclip's own settings (see the constants in mclip.c), without files
+void ReplayConfigDefaults(ReplayConfig* config);
+
+// Fills 'buffer' (room for chars + 1) with the text of a copy; its length is
+// returned. Text of different ids differs (case-insensitively) even when
+// short, so the result may be a little longer than 'chars'.
+size_t ReplayMakeText(wchar_t* buffer, size_t chars, uint32_t contentId);
+#define REPLAY_TEXT_SLACK 16 // Room to add to 'chars' for the above
+
+// --- Fake Clipboard ---
+// The ClipBackend of the replay. It holds one copy at a time, with no
+// copies of its own, and reads return fresh malloc'd copies as Win32's
+// does. It is busy until 'busyUntilNs' of the virtual clock.
+
+typedef struct {
+    const wchar_t* text;       // NULL: no text
+    size_t textLength;
+    const void* image;         // NULL: no image
+    size_t imageSize;
+    const wchar_t* source;     // Process the copy comes from, NULL: unknown
+    uint64_t busyUntilNs;
+    uint64_t nowNs;            // Virtual clock, set by the caller
+    size_t reads;              // Read attempts, busy ones included
+    ExcludeRules* exclude;     // NULL: no exclusion rules
+} ReplayClipboard;
+
+// A backend reading 'clipboard'
+ClipBackend ReplayClipboardBackend(ReplayClipboard* clipboard);
+
+// Replays 'trace' into a fresh store set up by 'config'. False if the store
+// could not be set up or memory ran out.
+bool ReplayRun(const ReplayTrace* trace, const ReplayConfig* config, ReplayResult* result);
+
+#endif // MCLIP_REPLAY_H
@@ -0,0 +1,174 @@
+#include "replay.h"
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// mclip_replay: replays clipboard traces into the history engine and reports
+// throughput, latency and memory, optionally against a saved baseline.
+//
+//   mclip_replay [options] [trace...]
+//
+//   trace                 a standard trace (snippets, mixed, burst, large,
+//                         repeats) or a trace file; none: every standard trace
+//   --entries N           most entries kept, 0 = no limit (default: mclip's)
+//   --budget-mb N         most memory they may take, 0 = no limit (default: mclip's)
+//   --log                 also save entries to a history log, as mclip does
+//   --save-trace FILE     write the first trace replayed to FILE
+//   --baseline FILE       compare with results saved by --save-baseline
+//   --save-baseline FILE  save the results as a baseline
+//
+// Baselines are text, one trace per line:
+//   name events_per_sec p50_ns p90_ns p99_ns peak_bytes
+
+typedef struct {
+    char name[64];
+    double eventsPerSec;
+    unsigned long long p50, p90, p99, peakBytes;
+} Baseline;
+
+#define MAX_TRACES 64
+
+static size_t
+LoadBaselines(const char* path, Baseline* baselines, size_t capacity)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "cannot read baseline %s\n", path);
+        return 0;
+    }
+    char line[256];
+    size_t count = 0;
+    while (count < capacity && fgets(line, sizeof(line), file)) {
+        Baseline* b = &baselines[count];
+        if (line[0] != '#' && sscanf(line, "%63s %lf %llu %llu %llu %llu", b->name, &b->eventsPerSec, &b->p50,
+                                     &b->p90, &b->p99, &b->peakBytes) == 6) {
+            count++;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+static const Baseline*
+FindBaseline(const Baseline* baselines, size_t count, const char* name)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (strcmp(baselines[i].name, name) == 0) return &baselines[i];
+    }
+    return NULL;
+}
+
+static double
+Change(double now, double before)
+{
+    return before > 0 ? (now - before) / before * 100.0 : 0.0;
+}
+
+int
+main(int argc, char** argv)
+{
+    setlocale(LC_CTYPE, "C.UTF-8");
+
+    ReplayConfig config;
+    ReplayConfigDefaults(&config);
+    const char* traces[MAX_TRACES];
+    size_t traceCount = 0;
+    const char* saveTrace = NULL;
+    const char* baselinePath = NULL;
+    const char* saveBaseline = NULL;
+    bool withLog = false;
+
+    for (int a = 1; a < argc; ++a) {
+        bool hasValue = a + 1 < argc;
+        if (strcmp(argv[a], "--entries") == 0 && hasValue) config.maxEntries = strtoul(argv[++a], NULL, 10);
+        else if (strcmp(argv[a], "--budget-mb") == 0 && hasValue) {
+            config.maxBytes = (size_t)strtoul(argv[++a], NULL, 10) << 20;
+        }
+        else if (strcmp(argv[a], "--log") == 0) withLog = true;
+        else if (strcmp(argv[a], "--save-trace") == 0 && hasValue) saveTrace = argv[++a];
+        else if (strcmp(argv[a], "--baseline") == 0 && hasValue) baselinePath = argv[++a];
+        else if (strcmp(argv[a], "--save-baseline") == 0 && hasValue) saveBaseline = argv[++a];
+        else if (argv[a][0] == '-' || traceCount == MAX_TRACES) {
+            fprintf(stderr, "usage: %s [--entries N] [--budget-mb N] [--log] [--save-trace FILE] [--baseline FILE] "
+                            "[--save-baseline FILE] [trace...]\n", argv[0]);
+            return 2;
+        } else traces[traceCount++] = argv[a];
+    }
+    if (traceCount == 0) {
+        for (size_t i = 0; i < g_replayTraceCount && i < MAX_TRACES; ++i) traces[traceCount++] = g_replayTraces[i].name;
+    }
+
+    // Files of the run go to the temporary directory
+    const char* tmp = getenv("TMPDIR");
+    char spillPath[512], logPath[512];
+    snprintf(spillPath, sizeof(spillPath), "%s/mclip_replay_%d.spill", tmp ? tmp : "/tmp", (int)getpid());
+    snprintf(logPath, sizeof(logPath), "%s/mclip_replay_%d.log", tmp ? tmp : "/tmp", (int)getpid());
+    config.spillPath = spillPath;
+    if (withLog) config.logPath = logPath;
+
+    Baseline baselines[MAX_TRACES];
+    size_t baselineCount = baselinePath ? LoadBaselines(baselinePath, baselines, MAX_TRACES) : 0;
+    FILE* saved = saveBaseline ? fopen(saveBaseline, "w") : NULL;
+    if (saveBaseline && !saved) fprintf(stderr, "cannot write baseline %s\n", saveBaseline);
+    if (saved) fprintf(saved, "# name events_per_sec p50_ns p90_ns p99_ns peak_bytes\n");
+
+    printf("%-12s %8s %8s %12s %10s %10s %10s %10s %9s\n", "trace", "events", "stored", "events/s", "p50 us",
+           "p90 us", "p99 us", "max us", "peak MB");
+    int status = 0;
+    for (size_t t = 0; t < traceCount; ++t) {
+        ReplayTrace trace;
+        const ReplayTraceSpec* spec = ReplayFindTrace(traces[t]);
+        bool loaded = spec ? ReplayTraceGenerate(&trace, spec) : ReplayTraceLoad(&trace, traces[t]);
+        if (!loaded) {
+            fprintf(stderr, "%s: not a standard trace or a readable trace file\n", traces[t]);
+            status = 1;
+            continue;
+        }
+        if (saveTrace && t == 0 && !ReplayTraceSave(&trace, saveTrace)) {
+            fprintf(stderr, "cannot write trace %s\n", saveTrace);
+        }
+
+        static ReplayResult result;
+        if (!ReplayRun(&trace, &config, &result)) {
+            fprintf(stderr, "%s: replay failed (out of memory, or files in %s)\n", traces[t], tmp ? tmp : "/tmp");
+            ReplayTraceFree(&trace);
+            status = 1;
+            continue;
+        }
+        const char* name = spec ? spec->name : traces[t];
+        uint64_t p50 = LatencyHistogramPercentile(&result.latency, 50);
+        uint64_t p90 = LatencyHistogramPercentile(&result.latency, 90);
+        uint64_t p99 = LatencyHistogramPercentile(&result.latency, 99);
+        printf("%-12s %8zu %8zu %12.0f %10.1f %10.1f %10.1f %10.1f %9.2f\n", name, result.events, result.stored,
+               result.eventsPerSec, p50 / 1e3, p90 / 1e3, p99 / 1e3, result.latency.maxNs / 1e3,
+               result.peakBytes / 1e6);
+
+        const Baseline* before = FindBaseline(baselines, baselineCount, name);
+        if (before) {
+            printf("%-12s events/s %+.1f%%, p50 %+.1f%%, p90 %+.1f%%, p99 %+.1f%%, peak %+.1f%%\n", "  vs base",
+                   Change(result.eventsPerSec, before->eventsPerSec), Change(p50, before->p50),
+                   Change(p90, before->p90), Change(p99, before->p99), Change(result.peakBytes, before->peakBytes));
+        }
+        if (saved) {
+            fprintf(saved, "%s %.0f %llu %llu %llu %llu\n", name, result.eventsPerSec, (unsigned long long)p50,
+                    (unsigned long long)p90, (unsigned long long)p99, (unsigned long long)result.peakBytes);
+        }
+        ReplayTraceFree(&trace);
+    }
+    if (saved) fclose(saved);
+    PlatformFileDelete(spillPath);
+    if (withLog) {
+        char indexPath[520];
+        snprintf(indexPath, sizeof(indexPath), "%s.idx", logPath);
+        PlatformFileDelete(logPath);
+        PlatformFileDelete(indexPath);
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) printf("peak RSS %.1f MB\n", usage.ru_maxrss / 1024.0);
+    return status;
+}
@@ -0,0 +1,46 @@
+#ifndef MCLIP_TEST_H
+#define MCLIP_TEST_H
+
+#include <stdio.h>
+
+// --- Minimal Test Harness ---
+// Each tests/test_*.c file exposes one suite function, called from test_main.c.
+
+extern int g_testChecks;
+extern int g_testFailures;
+
+#define CHECK(cond)                                                           \
+    do {                                                                      \
+        g_testChecks++;                                                       \
+        if (!(cond)) {                                                        \
+            g_testFailures++;                                                 \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+        }                                                                     \
+    } while (0)
+
+void TestHistory(void);
+void TestHashIndex(void);
+void TestArena(void);
+void TestSearch(void);
+void TestTrigram(void);
+void TestTextMatchKernels(void);
+void TestResultView(void);
+void TestHistoryLog(void);
+void TestCompression(void);
+void TestFuzzy(void);
+void TestRegex(void);
+void TestSearchWorker(void);
+void TestClipAcquire(void);
+void TestIngestion(void);
+void TestBlobStore(void);
+void TestMetrics(void);
+void TestClipIngest(void);
+void TestReplay(void);
+void TestSnapshot(void);
+void TestEpoch(void);
+void TestHistoryVersion(void);
+void TestExclude(void);
+void TestNearDup(void);
+void TestMeta(void);
+
+#endif // MCLIP_TEST_H
@@ -0,0 +1,55 @@
+#include "test.h"
+#include "../code/arena.h"
+
+#include <stdint.h>
+#include <string.h>
+
+void
+TestArena(void)
+{
+    Arena arena;
+    ArenaInit(&arena);
+
+    // Blocks are aligned, distinct and writable
+    char* a = ArenaAlloc(&arena, 10);
+    char* b = ArenaAlloc(&arena, 10);
+    CHECK(a && b && a != b);
+    CHECK(((uintptr_t)a & 15) == 0 && ((uintptr_t)b & 15) == 0);
+    memset(a, 'a', 10);
+    memset(b, 'b', 10);
+    CHECK(a[9] == 'a' && b[0] == 'b');
+    CHECK(arena.bytesUsed == 20);
+    CHECK(arena.bytesReserved >= ARENA_CHUNK_SIZE);
+
+    // A released block is recycled for the next request of the same class
+    ArenaRelease(&arena, a, 10);
+    CHECK(arena.bytesUsed == 10);
+    char* c = ArenaAlloc(&arena, 16);
+    CHECK(c == a);
+    CHECK(arena.recycled == 1);
+
+    // Oversized blocks bypass the slabs and are returned to the heap on release
+    size_t reserved = arena.bytesReserved;
+    char* big = ArenaAlloc(&arena, ARENA_MAX_CLASS + 1);
+    CHECK(big != NULL);
+    CHECK(((uintptr_t)big & 15) == 0);
+    CHECK(arena.bytesReserved > reserved + ARENA_MAX_CLASS);
+    big[ARENA_MAX_CLASS] = 1;
+    ArenaRelease(&arena, big, ARENA_MAX_CLASS + 1);
+    CHECK(arena.bytesReserved == reserved);
+
+    // Steady ring-order churn stops growing once the ring is warm
+    char* ring[64] = {0};
+    size_t ringSize[64] = {0};
+    for (size_t i = 0; i < 64 * 50; ++i) {
+        size_t slot = i % 64;
+        if (i == 64 * 2) reserved = arena.bytesReserved;
+        if (ring[slot]) ArenaRelease(&arena, ring[slot], ringSize[slot]);
+        ringSize[slot] = 100 + (slot * 37) % 900;
+        ring[slot] = ArenaAlloc(&arena, ringSize[slot]);
+    }
+    CHECK(arena.bytesReserved == reserved);
+
+    ArenaFree(&arena);
+    CHECK(arena.bytesReserved == 0 && arena.chunks == NULL);
+}
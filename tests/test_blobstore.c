@@ -0,0 +1,143 @@
+#include "test.h"
+#include "../code/capture.h"
+
+#include <string.h>
+
+static void
+TestBlobHash(void)
+{
+    // Reference values of MurmurHash3_x64_128 (seed 0)
+    BlobHash empty = BlobHash128("", 0);
+    CHECK(empty.lo == 0 && empty.hi == 0);
+    const char* fox = "The quick brown fox jumps over the lazy dog";
+    BlobHash hash = BlobHash128(fox, strlen(fox));
+    CHECK(hash.lo == 0xe34bbc7bbc071b6cull && hash.hi == 0x7a433ca9c49a9347ull);
+
+    // Every tail length, and a change in any byte, gives a different hash
+    unsigned char data[64];
+    for (size_t i = 0; i < sizeof(data); ++i) data[i] = (unsigned char)(i * 7);
+    bool distinct = true;
+    BlobHash previous = BlobHash128(data, 0);
+    for (size_t size = 1; size <= sizeof(data); ++size) {
+        BlobHash next = BlobHash128(data, size);
+        if (next.lo == previous.lo && next.hi == previous.hi) distinct = false;
+        previous = next;
+    }
+    CHECK(distinct);
+    BlobHash before = BlobHash128(data, sizeof(data));
+    data[37] ^= 1;
+    BlobHash after = BlobHash128(data, sizeof(data));
+    CHECK(before.lo != after.lo && before.hi != after.hi);
+}
+
+static void
+TestBlobStoreDedup(void)
+{
+    BlobStore store;
+    CHECK(BlobStoreInit(&store));
+
+    static const char image[] = "\x89PNG pretend image bytes";
+    static const char files[] = "C:\\a.txt\0C:\\b.txt\0";
+    uint32_t a = BlobStorePut(&store, image, sizeof(image));
+    uint32_t b = BlobStorePut(&store, files, sizeof(files));
+    uint32_t again = BlobStorePut(&store, image, sizeof(image));
+    CHECK(a != BLOB_NONE && b != BLOB_NONE && a != b);
+    CHECK(again == a);
+    CHECK(store.blobs == 2 && store.puts == 3 && store.dedupHits == 1);
+    CHECK(store.storedBytes == sizeof(image) + sizeof(files));
+    CHECK(store.putBytes == 2 * sizeof(image) + sizeof(files));
+
+    size_t size = 0;
+    const void* data = BlobStoreGet(&store, a, &size);
+    CHECK(data && size == sizeof(image) && memcmp(data, image, size) == 0);
+    CHECK(BlobStoreHash(&store, a) && BlobStoreHash(&store, a)->lo == BlobHash128(image, sizeof(image)).lo);
+
+    // Freed with the last reference; its number is reused
+    BlobStoreRelease(&store, a);
+    CHECK(BlobStoreGet(&store, a, NULL) != NULL);
+    BlobStoreRelease(&store, a);
+    CHECK(BlobStoreGet(&store, a, NULL) == NULL && store.blobs == 1);
+    BlobStoreRelease(&store, a); // Harmless
+    uint32_t empty = BlobStorePut(&store, "", 0);
+    CHECK(empty == a);
+    CHECK(BlobStoreGet(&store, empty, &size) != NULL && size == 0);
+    CHECK(BlobStoreGet(&store, BLOB_NONE, NULL) == NULL);
+
+    // Many blobs: growth, then everything given back
+    unsigned char payload[300];
+    uint32_t blobs[2000];
+    for (uint32_t i = 0; i < 2000; ++i) {
+        memset(payload, 0, sizeof(payload));
+        memcpy(payload, &i, sizeof(i));
+        blobs[i] = BlobStorePut(&store, payload, 100 + i % 200);
+        CHECK(blobs[i] != BLOB_NONE);
+    }
+    CHECK(store.blobs == 2002);
+    for (uint32_t i = 0; i < 2000; ++i) {
+        CHECK(BlobStoreGet(&store, blobs[i], &size) && size == 100 + i % 200);
+        BlobStoreRelease(&store, blobs[i]);
+    }
+    BlobStoreRelease(&store, b);
+    BlobStoreRelease(&store, empty);
+    CHECK(store.blobs == 0 && store.storedBytes == 0 && store.index.count == 0);
+    CHECK(store.arena.bytesUsed == 0);
+    BlobStoreFree(&store);
+}
+
+static void
+TestCaptureStore(void)
+{
+    History history;
+    CaptureStore captures;
+    CHECK(HistoryInit(&history, 3));
+    CHECK(CaptureStoreInit(&captures));
+
+    static const char dib[] = "BITMAPINFOHEADER + pixels";
+    static const char html[] = "<b>bold</b>";
+    CapturePayload payloads[] = {
+        { 8, dib, sizeof(dib) },
+        { 49300, html, sizeof(html) },
+    };
+
+    HistoryAdd(&history, L"[Image]");
+    uint32_t first = HistoryGet(&history, 0)->seq;
+    CHECK(CaptureStoreAttach(&captures, first, payloads, 2, true));
+    HistoryAdd(&history, L"plain text");
+    HistoryAdd(&history, L"[Image again]");
+    uint32_t third = HistoryGet(&history, 0)->seq;
+    CHECK(CaptureStoreAttach(&captures, third, payloads, 1, true));
+    CHECK(!CaptureStoreAttach(&captures, first, payloads, 1, false)); // Out of order
+
+    // The same image twice is stored once
+    CHECK(captures.blobs.blobs == 2 && captures.blobs.dedupHits == 1);
+
+    const CaptureRecord* record = CaptureStoreFind(&captures, first);
+    CHECK(record && record->count == 2 && record->textIsLabel);
+    CHECK(record->formats[0].format == 8 && record->formats[1].format == 49300);
+    size_t size = 0;
+    const void* data = BlobStoreGet(&captures.blobs, record->formats[1].blob, &size);
+    CHECK(data && size == sizeof(html) && memcmp(data, html, size) == 0);
+    CHECK(CaptureStoreFind(&captures, first + 1) == NULL);
+    CHECK(CaptureStoreFind(&captures, third)->count == 1);
+
+    // Records of evicted entries go, and with them payloads nobody else uses
+    HistoryAdd(&history, L"evicts the first");
+    CHECK(CaptureStorePrune(&captures, &history) == 1);
+    CHECK(CaptureStoreFind(&captures, first) == NULL && CaptureStoreFind(&captures, third) != NULL);
+    CHECK(captures.blobs.blobs == 1);
+    HistoryAdd(&history, L"and the rest");
+    HistoryAdd(&history, L"of them");
+    CHECK(CaptureStorePrune(&captures, &history) == 1);
+    CHECK(captures.count == 0 && captures.blobs.blobs == 0);
+
+    CaptureStoreFree(&captures);
+    HistoryFree(&history);
+}
+
+void
+TestBlobStore(void)
+{
+    TestBlobHash();
+    TestBlobStoreDedup();
+    TestCaptureStore();
+}
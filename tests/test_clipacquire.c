@@ -0,0 +1,73 @@
+#include "test.h"
+#include "../code/clipacquire.h"
+
+#define MS 1000000ull
+
+void
+TestClipAcquire(void)
+{
+    ClipAcquire acquire;
+    ClipAcquireInit(&acquire, 1);
+
+    // Uncontended: one attempt, nothing scheduled
+    ClipAcquireNotify(&acquire, 10 * MS);
+    CHECK(acquire.pending);
+    CHECK(ClipAcquireAttempted(&acquire, CLIP_ATTEMPT_ACQUIRED, 10 * MS) == 0);
+    CHECK(!acquire.pending);
+    CHECK(acquire.acquired == 1 && acquire.contended == 0 && acquire.busy == 0);
+    CHECK(!ClipAcquireTakeAlert(&acquire));
+
+    // Contended: backoff doubles up to the cap, with jitter of up to half
+    uint64_t now = 100 * MS;
+    ClipAcquireNotify(&acquire, now);
+    unsigned expected = CLIP_ACQUIRE_FIRST_RETRY_MS;
+    bool alerted = false;
+    for (int i = 0; i < 12; ++i) {
+        unsigned delay = ClipAcquireAttempted(&acquire, CLIP_ATTEMPT_BUSY, now);
+        CHECK(delay >= expected - expected / 2 && delay <= expected);
+        CHECK(delay > 0); // Never "done" while busy
+        now += delay * MS;
+        alerted |= ClipAcquireTakeAlert(&acquire);
+        expected = expected * 2 > CLIP_ACQUIRE_MAX_RETRY_MS ? CLIP_ACQUIRE_MAX_RETRY_MS : expected * 2;
+    }
+    CHECK(alerted);
+    CHECK(!ClipAcquireTakeAlert(&acquire)); // Once per episode
+    CHECK(acquire.busy == 12 && acquire.contended == 1);
+
+    // A notification during the episode keeps its backoff and start time
+    ClipAcquireNotify(&acquire, now);
+    CHECK(acquire.updates == 3);
+    unsigned delay = ClipAcquireAttempted(&acquire, CLIP_ATTEMPT_BUSY, now);
+    CHECK(delay >= CLIP_ACQUIRE_MAX_RETRY_MS / 2 && delay <= CLIP_ACQUIRE_MAX_RETRY_MS);
+    now += delay * MS;
+
+    // The copy is read once the owner lets go, and the wait is measured
+    CHECK(ClipAcquireAttempted(&acquire, CLIP_ATTEMPT_ACQUIRED, now) == 0);
+    CHECK(acquire.acquired == 2);
+    CHECK(acquire.maxAcquireNs == now - 100 * MS);
+    CHECK(acquire.totalAcquireNs == acquire.maxAcquireNs);
+    CHECK(acquire.lastAcquireNs == acquire.maxAcquireNs);
+
+    // A new episode starts from the first retry delay again
+    ClipAcquireNotify(&acquire, now);
+    delay = ClipAcquireAttempted(&acquire, CLIP_ATTEMPT_BUSY, now);
+    CHECK(delay <= CLIP_ACQUIRE_FIRST_RETRY_MS);
+    CHECK(acquire.contended == 2);
+
+    // Other errors end the episode without a retry
+    CHECK(ClipAcquireAttempted(&acquire, CLIP_ATTEMPT_FAILED, now + MS) == 0);
+    CHECK(!acquire.pending && acquire.failed == 1);
+    CHECK(acquire.attempts == 17);
+
+    // Jitter differs between retries: no lockstep with another reader
+    ClipAcquireInit(&acquire, 7);
+    ClipAcquireNotify(&acquire, 0);
+    bool varied = false;
+    unsigned previous = 0;
+    for (int i = 0; i < 20; ++i) {
+        delay = ClipAcquireAttempted(&acquire, CLIP_ATTEMPT_BUSY, 0);
+        if (i > 8 && delay != previous) varied = true; // Past the cap, only jitter changes
+        previous = delay;
+    }
+    CHECK(varied);
+}
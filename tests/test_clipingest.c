@@ -0,0 +1,135 @@
+#include "test.h"
+#include "replay.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MS 1000000ull
+
+void
+TestClipIngest(void)
+{
+    History history;
+    CaptureStore captures;
+    Metrics metrics;
+    ClipAcquire acquire;
+    CHECK(HistoryInit(&history, 2));
+    CHECK(CaptureStoreInit(&captures));
+    MetricsInit(&metrics, 0);
+    ClipAcquireInit(&acquire, 1);
+    ClipSink sink = { &history, &captures, NULL, &metrics };
+
+    ReplayClipboard clipboard;
+    memset(&clipboard, 0, sizeof(clipboard));
+    ClipBackend backend = ReplayClipboardBackend(&clipboard);
+
+    // A busy clipboard is retried later; the read then copies the text out
+    clipboard.text = L"copied";
+    clipboard.textLength = 6;
+    clipboard.busyUntilNs = 20 * MS;
+    clipboard.nowNs = 10 * MS;
+    ClipAcquireNotify(&acquire, clipboard.nowNs);
+    ClipContent content;
+    unsigned retryMs = ClipTryRead(&backend, &acquire, &metrics, &content, clipboard.nowNs);
+    CHECK(retryMs > 0 && !content.text);
+    CHECK(metrics.stages[METRIC_CLIPBOARD_READ].count == 0);
+    clipboard.nowNs = 30 * MS;
+    CHECK(ClipTryRead(&backend, &acquire, &metrics, &content, clipboard.nowNs) == 0);
+    CHECK(content.text && wcscmp(content.text, L"copied") == 0 && content.text != clipboard.text);
+    CHECK(clipboard.reads == 2);
+    CHECK(metrics.stages[METRIC_CLIPBOARD_READ].count == 1);
+    CHECK(metrics.stages[METRIC_CLIPBOARD_WAIT].maxNs == 20 * MS);
+
+    // Stored once; the same text again (in any case) is a counted duplicate
+    CHECK(ClipIngest(&sink, &content, NULL) == HISTORY_ADDED);
+    ClipContentFree(&content);
+    CHECK(content.text == NULL);
+    ClipContent again = { 0 };
+    again.text = L"COPIED";
+    CHECK(ClipIngest(&sink, &again, NULL) == HISTORY_DUPLICATE);
+    CHECK(metrics.counters[METRIC_ENTRIES_ADDED] == 1 && metrics.counters[METRIC_DUPLICATES] == 1);
+    CHECK(metrics.counters[METRIC_BYTES_ADDED] == 6 * sizeof(wchar_t));
+    CHECK(metrics.stages[METRIC_HISTORY_ADD].count == 2);
+
+    // Without text: stored under the label, with the image captured
+    static const unsigned char pixels[] = { 1, 2, 3, 4, 5 };
+    clipboard.text = NULL;
+    clipboard.image = pixels;
+    clipboard.imageSize = sizeof(pixels);
+    ClipAcquireNotify(&acquire, clipboard.nowNs);
+    CHECK(ClipTryRead(&backend, &acquire, &metrics, &content, clipboard.nowNs) == 0);
+    CHECK(!content.text && content.payloadCount == 1 && content.payloads[0].size == sizeof(pixels));
+    CHECK(ClipIngest(&sink, &content, NULL) == HISTORY_EMPTY); // No label, nothing to list it by
+    CHECK(ClipIngest(&sink, &content, L"[Image]") == HISTORY_ADDED);
+    const CaptureRecord* record = CaptureStoreFind(&captures, HistoryGet(&history, 0)->seq);
+    CHECK(record && record->textIsLabel && record->count == 1);
+    CHECK(record->formats[0].format == REPLAY_IMAGE_FORMAT);
+    ClipContentFree(&content);
+
+    // Excluded text is not copied, nor are the formats copied with it
+    ExcludeRules exclude;
+    ExcludeRulesInit(&exclude);
+    CHECK(ExcludeRulesAddSetting(&exclude, L"prefix=ghp_") && ExcludeRulesBuild(&exclude));
+    clipboard.exclude = &exclude;
+    clipboard.text = L"token ghp_abc";
+    clipboard.textLength = 13;
+    ClipAcquireNotify(&acquire, clipboard.nowNs);
+    CHECK(ClipTryRead(&backend, &acquire, &metrics, &content, clipboard.nowNs) == 0);
+    CHECK(content.excluded && !content.text && content.payloadCount == 0);
+    CHECK(metrics.counters[METRIC_EXCLUDED] == 1);
+    clipboard.text = L"allowed";
+    clipboard.textLength = 7;
+    ClipAcquireNotify(&acquire, clipboard.nowNs);
+    CHECK(ClipTryRead(&backend, &acquire, &metrics, &content, clipboard.nowNs) == 0);
+    CHECK(!content.excluded && content.text && content.payloadCount == 1);
+    CHECK(metrics.counters[METRIC_EXCLUDED] == 1);
+    ClipContentFree(&content);
+    clipboard.exclude = NULL;
+    ExcludeRulesFree(&exclude);
+
+    // Evicting the image entry drops its capture
+    again.text = L"third";
+    CHECK(ClipIngest(&sink, &again, NULL) == HISTORY_ADDED);
+    again.text = L"fourth";
+    CHECK(ClipIngest(&sink, &again, NULL) == HISTORY_ADDED);
+    CHECK(captures.count == 0 && captures.blobs.blobs == 0);
+
+    // Text entries are queued on the log, labelled ones are not
+    char path[512];
+    const char* tmp = getenv("TMPDIR");
+    snprintf(path, sizeof(path), "%s/mclip_ingest_%d.log", tmp ? tmp : "/tmp", (int)getpid());
+    History logged;
+    HistoryLog log;
+    CHECK(HistoryInit(&logged, 8));
+    CHECK(HistoryLogOpen(&log, path, &logged) == HISTORY_LOG_OK);
+    ClipSink logSink = { &logged, NULL, &log, &metrics };
+    size_t pending = log.pendingBytes;
+    again.text = L"saved";
+    CHECK(ClipIngest(&logSink, &again, NULL) == HISTORY_ADDED && log.pendingBytes > pending);
+    pending = log.pendingBytes;
+    ClipContent image = { 0 };
+    CHECK(ClipIngest(&logSink, &image, L"[Files]") == HISTORY_ADDED && log.pendingBytes == pending);
+
+    // So are re-copies, and loading the log replays them
+    CHECK(ClipIngest(&logSink, &again, NULL) == HISTORY_DUPLICATE && log.pendingBytes > pending);
+    again.text = L"other";
+    CHECK(ClipIngest(&logSink, &again, NULL) == HISTORY_ADDED);
+    again.text = L"SAVED";
+    CHECK(ClipIngest(&logSink, &again, NULL) == HISTORY_DUPLICATE);
+    HistoryFree(&logged);
+    HistoryLogClose(&log);
+    CHECK(HistoryInit(&logged, 8));
+    CHECK(HistoryLogOpen(&log, path, &logged) == HISTORY_LOG_OK);
+    CHECK(HistoryCount(&logged) == 2 && wcscmp(HistoryEntryText(&logged, HistoryGet(&logged, 1)), L"other") == 0);
+    CHECK(wcscmp(HistoryEntryText(&logged, HistoryGet(&logged, 0)), L"saved") == 0 && HistoryGet(&logged, 0)->uses == 3);
+    HistoryFree(&logged);
+    HistoryLogClose(&log);
+    char indexPath[520];
+    snprintf(indexPath, sizeof(indexPath), "%s.idx", path);
+    PlatformFileDelete(path);
+    PlatformFileDelete(indexPath);
+
+    CaptureStoreFree(&captures);
+    HistoryFree(&history);
+}
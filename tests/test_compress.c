@@ -0,0 +1,264 @@
+#include "test.h"
+#include "../code/history.h"
+#include "../code/lz.h"
+#include "../code/textmatch.h"
+#include "../code/utf8.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static bool
+CountVisits(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry; (void)index;
+    (*(size_t*)context)++;
+    return true;
+}
+
+// Compresses and decompresses 'size' bytes, checking the data comes back unchanged
+static bool
+LzRoundTrip(const unsigned char* data, size_t size, size_t* packedSize)
+{
+    size_t bound = LzCompressBound(size);
+    unsigned char* packed = malloc(bound);
+    unsigned char* unpacked = malloc(size + 1);
+    bool ok = false;
+    if (packed && unpacked) {
+        size_t n = LzCompress(data, size, packed, bound);
+        ok = n > 0 && LzDecompress(packed, n, unpacked, size) && memcmp(data, unpacked, size) == 0;
+        if (packedSize) *packedSize = n;
+    }
+    free(packed);
+    free(unpacked);
+    return ok;
+}
+
+static void
+TestLz(void)
+{
+    // Empty and tiny inputs are literal-only streams
+    CHECK(LzRoundTrip((const unsigned char*)"", 0, NULL));
+    CHECK(LzRoundTrip((const unsigned char*)"a", 1, NULL));
+    CHECK(LzRoundTrip((const unsigned char*)"abcdabcdabcd", 12, NULL));
+
+    // Repetitive text shrinks a lot, long runs exercise the extended lengths
+    size_t size = 100000, packedSize = 0;
+    unsigned char* data = malloc(size);
+    CHECK(data != NULL);
+    if (!data) return;
+    for (size_t i = 0; i < size; ++i) data[i] = (unsigned char)"{\"id\": 1, \"name\": \"value\"},\n"[i % 29];
+    CHECK(LzRoundTrip(data, size, &packedSize));
+    CHECK(packedSize < size / 20);
+    memset(data, 'z', size);
+    CHECK(LzRoundTrip(data, size, &packedSize));
+    CHECK(packedSize < size / 100);
+
+    // Random data still round-trips and stays within the bound
+    srand(9);
+    for (size_t i = 0; i < size; ++i) data[i] = (unsigned char)rand();
+    CHECK(LzRoundTrip(data, size, &packedSize));
+    CHECK(packedSize <= LzCompressBound(size));
+
+    // Too small a destination fails instead of overflowing
+    unsigned char small[64];
+    CHECK(LzCompress(data, size, small, sizeof(small)) == 0);
+
+    // Malformed, truncated or mis-sized input is rejected without out-of-bounds access
+    for (size_t i = 0; i < size; ++i) data[i] = (unsigned char)"mclip clipboard history "[i % 24];
+    size_t bound = LzCompressBound(size);
+    unsigned char* packed = malloc(bound);
+    unsigned char* out = malloc(size);
+    CHECK(packed && out);
+    if (packed && out) {
+        size_t n = LzCompress(data, size, packed, bound);
+        CHECK(n > 0 && LzDecompress(packed, n, out, size));
+        CHECK(!LzDecompress(packed, n - 3, out, size));
+        CHECK(!LzDecompress(packed, n / 2, out, size));
+        CHECK(!LzDecompress(packed, n, out, size - 1));
+        for (size_t i = 0; i < 2000; ++i) { // Random corruption: any result is fine, but no crash
+            unsigned char saved = packed[i % n];
+            packed[i % n] = (unsigned char)rand();
+            LzDecompress(packed, n, out, size);
+            packed[i % n] = saved;
+        }
+        const unsigned char badOffset[] = { 0x14, 'a', 0x10, 0x00 }; // Match reaching before the start
+        CHECK(!LzDecompress(badOffset, sizeof(badOffset), out, 20));
+    }
+    free(packed);
+    free(out);
+    free(data);
+}
+
+static void
+TestUtf8(void)
+{
+    const wchar_t text[] = L"caf\x00E9 \x20AC \xD55C";
+    size_t length = wcslen(text);
+    char utf8[64];
+    wchar_t back[64];
+    CHECK(Utf8EncodedSize(text, length) == 3 + 2 + 1 + 3 + 1 + 3);
+    size_t bytes = Utf8Encode(text, length, utf8);
+    CHECK(bytes == 13 && memcmp(utf8, "caf\xC3\xA9 \xE2\x82\xAC \xED\x95\x9C", 13) == 0);
+    CHECK(Utf8DecodedLength(utf8, bytes) == length);
+    CHECK(Utf8Decode(utf8, bytes, back) == length && wmemcmp(back, text, length) == 0);
+
+    // A supplementary character, however wchar_t stores it
+    const char emoji[] = "\xF0\x9F\x98\x80";
+    size_t emojiLength = Utf8DecodedLength(emoji, 4);
+    CHECK(emojiLength == (sizeof(wchar_t) == 2 ? 2 : 1));
+    CHECK(Utf8Decode(emoji, 4, back) == emojiLength);
+    CHECK(Utf8EncodedSize(back, emojiLength) == 4);
+    CHECK(Utf8Encode(back, emojiLength, utf8) == 4 && memcmp(utf8, emoji, 4) == 0);
+
+    // A lone surrogate (possible in clipboard text) survives the round trip
+    const wchar_t lone[] = { L'a', (wchar_t)0xD800, L'b' };
+    bytes = Utf8Encode(lone, 3, utf8);
+    CHECK(bytes == 5);
+    CHECK(Utf8Decode(utf8, bytes, back) == 3 && wmemcmp(back, lone, 3) == 0);
+
+    // Malformed input
+    CHECK(Utf8DecodedLength("\xC3", 1) == UTF8_INVALID);          // Truncated
+    CHECK(Utf8DecodedLength("\xC0\xAF", 2) == UTF8_INVALID);      // Overlong
+    CHECK(Utf8DecodedLength("\x80", 1) == UTF8_INVALID);          // Stray continuation
+    CHECK(Utf8DecodedLength("\xF5\x80\x80\x80", 4) == UTF8_INVALID); // Past U+10FFFF
+    CHECK(Utf8Decode("\xE2\x82", 2, back) == UTF8_INVALID);
+
+    // One character at a time
+    size_t at = 0;
+    CHECK(Utf8DecodeChar("a\xE2\x82\xAC", 4, &at) == L'a' && at == 1);
+    CHECK(Utf8DecodeChar("a\xE2\x82\xAC", 4, &at) == 0x20AC && at == 4);
+    at = 1;
+    CHECK(Utf8DecodeChar("a\xE2\x82", 3, &at) == UTF8_BAD_CHAR && at == 1);
+    CHECK(Utf8DecodeChar(emoji, 4, &(size_t){ 0 }) == 0x1F600);
+}
+
+// Builds a large, compressible entry "<tag>: {...} {...} ..." of 'length' characters
+static wchar_t*
+MakeLargeText(const wchar_t* tag, size_t length)
+{
+    wchar_t* text = malloc((length + 1) * sizeof(wchar_t));
+    if (!text) return NULL;
+    size_t used = (size_t)swprintf(text, length + 1, L"%ls:", tag);
+    static const wchar_t pattern[] = L" {\"level\": \"info\", \"msg\": \"request served\"}";
+    size_t patternLength = wcslen(pattern);
+    for (size_t i = used; i < length; ++i) text[i] = pattern[(i - used) % patternLength];
+    text[length] = L'\0';
+    return text;
+}
+
+static void
+TestHistoryCompression(void)
+{
+    History history;
+    HistoryStats stats;
+    CHECK(HistoryInit(&history, 8));
+    HistorySetCompression(&history, 4096, 0);
+
+    // Large entries are stored compressed, small ones plain
+    wchar_t* big = MakeLargeText(L"first", 20000);
+    CHECK(big != NULL);
+    if (!big) return;
+    CHECK(HistoryAdd(&history, big) == HISTORY_ADDED);
+    CHECK(HistoryAdd(&history, L"small entry") == HISTORY_ADDED);
+    const HistoryEntry* packedEntry = HistoryGet(&history, 1);
+    CHECK(packedEntry->packed != NULL && packedEntry->utf8 == NULL && packedEntry->length == 20000);
+    CHECK(HistoryGet(&history, 0)->packed == NULL && HistoryGet(&history, 0)->utf8 != NULL);
+    CHECK(wcscmp(HistoryEntryText(&history, packedEntry), big) == 0);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 0)), L"small entry") == 0);
+
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.packedEntries == 1 && stats.packedRawBytes == 20001);
+    CHECK(stats.packedBytes < stats.packedRawBytes / 10);
+    CHECK(stats.textBytes < stats.packedRawBytes / 5);
+    CHECK(stats.decodes == 1);
+
+    // Repeated access is served from the cache
+    HistoryEntryText(&history, packedEntry);
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.decodes == 1);
+
+    // Duplicate detection and search see the original text
+    big[0] = L'F';
+    CHECK(HistoryAdd(&history, big) == HISTORY_DUPLICATE);
+    CHECK(HistoryContains(&history, big));
+    size_t visits = 0;
+    CHECK(HistoryForEachMatch(&history, L"FIRST:", CountVisits, &visits) == 1 && visits == 1);
+    CHECK(HistoryForEachMatch(&history, L"request served\"} {\"LEVEL", CountVisits, &visits) == 1);
+    CHECK(HistoryForEachMatch(&history, L"not in there", CountVisits, &visits) == 0);
+
+    // Several compressed entries: each decodes to its own text through the small cache
+    wchar_t tag[16];
+    for (int i = 0; i < 5; ++i) {
+        swprintf(tag, 16, L"big %d", i);
+        wchar_t* text = MakeLargeText(tag, 5000 + (size_t)i * 100);
+        CHECK(text && HistoryAdd(&history, text) == HISTORY_ADDED);
+        free(text);
+    }
+    for (int i = 0; i < 5; ++i) {
+        swprintf(tag, 16, L"big %d:", i);
+        const wchar_t* text = HistoryEntryText(&history, HistoryGet(&history, 4 - (size_t)i));
+        CHECK(text && wcsncmp(text, tag, wcslen(tag)) == 0 && wcslen(text) == 5000 + (size_t)i * 100);
+    }
+
+    // Eviction releases compressed blocks, also with the trigram index maintained
+    CHECK(HistoryEnableTrigramIndex(&history, true));
+    CHECK(HistoryForEachMatch(&history, L"big 3:", CountVisits, &visits) == 1);
+    for (int i = 0; i < 8; ++i) {
+        swprintf(tag, 16, L"plain %d", i);
+        HistoryAdd(&history, tag);
+    }
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.packedEntries == 0 && stats.packedBytes == 0 && stats.packedRawBytes == 0);
+    CHECK(HistoryForEachMatch(&history, L"big 3:", CountVisits, &visits) == 0);
+    CHECK(HistoryForEachMatch(&history, L"plain", CountVisits, &visits) == 8);
+    HistoryFree(&history);
+
+    // Cold entries: compressed once 'age' newer entries exist
+    CHECK(HistoryInit(&history, 16));
+    HistorySetCompression(&history, 0, 3);
+    wchar_t* medium = MakeLargeText(L"cold", 1000);
+    CHECK(medium && HistoryAdd(&history, medium) == HISTORY_ADDED);
+    CHECK(HistoryAdd(&history, L"short, never compressed") == HISTORY_ADDED);
+    HistoryAdd(&history, L"newer 0");
+    CHECK(HistoryGet(&history, 2)->packed == NULL);
+    HistoryAdd(&history, L"newer 1");
+    HistoryAdd(&history, L"newer 2");
+    CHECK(HistoryGet(&history, 3)->packed == NULL); // Below HISTORY_COLD_MIN_BYTES
+    const HistoryEntry* cold = HistoryGet(&history, 4);
+    CHECK(cold->packed != NULL && cold->utf8 == NULL);
+    CHECK(medium && wcscmp(HistoryEntryText(&history, cold), medium) == 0);
+    CHECK(HistoryContains(&history, medium));
+
+    // Text that does not shrink is kept plain rather than stored bigger, in
+    // whichever form is smaller: random CJK takes 3 bytes a character in
+    // UTF-8, more than UTF-16 and less than UTF-32.
+    HistorySetCompression(&history, 64, 0);
+    wchar_t noise[400];
+    srand(5);
+    for (size_t i = 0; i < 399; ++i) noise[i] = (wchar_t)(0x4E00 + rand() % 20000);
+    noise[399] = L'\0';
+    CHECK(HistoryAdd(&history, noise) == HISTORY_ADDED);
+    CHECK(HistoryGet(&history, 0)->packed == NULL);
+    CHECK((HistoryGet(&history, 0)->text != NULL) == (sizeof(wchar_t) == 2));
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 0)), noise) == 0);
+    free(medium);
+    HistoryFree(&history);
+
+    // Borrowed entries stay as they are: their memory isn't the history's to replace
+    CHECK(HistoryInit(&history, 4));
+    HistorySetCompression(&history, 64, 1);
+    CHECK(HistoryAddBorrowed(&history, big, 20000, TextHashNoCase(big, 20000)) == HISTORY_ADDED);
+    HistoryAdd(&history, L"another");
+    HistoryAdd(&history, L"and another");
+    CHECK(HistoryGet(&history, 2)->packed == NULL && HistoryGet(&history, 2)->text == big);
+    HistoryFree(&history);
+    free(big);
+}
+
+void
+TestCompression(void)
+{
+    TestLz();
+    TestUtf8();
+    TestHistoryCompression();
+}
@@ -0,0 +1,74 @@
+#include "test.h"
+#include "../code/epoch.h"
+
+static int g_released;
+
+static void
+CountRelease(void* object)
+{
+    (void)object;
+    g_released++;
+}
+
+void
+TestEpoch(void)
+{
+    EpochDomain domain;
+    EpochInit(&domain);
+    int objects[4];
+
+    // Reader slots run out, and come back when unregistered
+    int readers[EPOCH_MAX_READERS];
+    for (int i = 0; i < EPOCH_MAX_READERS; ++i) readers[i] = EpochRegister(&domain);
+    CHECK(readers[0] == 0 && readers[EPOCH_MAX_READERS - 1] == EPOCH_MAX_READERS - 1);
+    CHECK(EpochRegister(&domain) == -1);
+    EpochUnregister(&domain, readers[5]);
+    CHECK(EpochRegister(&domain) == 5);
+    for (int i = 2; i < EPOCH_MAX_READERS; ++i) EpochUnregister(&domain, readers[i]);
+    int a = readers[0], b = readers[1];
+
+    // Without readers, a retired object goes after two advances
+    g_released = 0;
+    EpochRetire(&domain, &objects[0], CountRelease);
+    CHECK(EpochCollect(&domain) == 0 && g_released == 0);
+    CHECK(EpochCollect(&domain) == 1 && g_released == 1);
+    CHECK(domain.retiredCount == 0 && domain.released == 1);
+
+    // A pinned reader keeps what was retired while it is pinned
+    EpochPin(&domain, a);
+    EpochRetire(&domain, &objects[1], CountRelease);
+    for (int i = 0; i < 10; ++i) EpochCollect(&domain);
+    CHECK(g_released == 1);
+    EpochUnpin(&domain, a);
+    EpochCollect(&domain);
+    EpochCollect(&domain);
+    CHECK(g_released == 2);
+
+    // A reader pinned in an older epoch holds back objects retired later too,
+    // while one that pins afterwards does not hold back older ones
+    EpochPin(&domain, a);
+    EpochRetire(&domain, &objects[2], CountRelease);
+    EpochCollect(&domain); // Advances: 'a' is in the current epoch
+    EpochPin(&domain, b);  // In the new epoch
+    EpochRetire(&domain, &objects[3], CountRelease);
+    for (int i = 0; i < 10; ++i) EpochCollect(&domain);
+    CHECK(g_released == 2);
+    EpochUnpin(&domain, a);
+    EpochCollect(&domain);
+    CHECK(g_released == 3); // objects[2]: retired before 'b' pinned
+    EpochUnpin(&domain, b);
+    EpochCollect(&domain);
+    EpochCollect(&domain);
+    CHECK(g_released == 4 && domain.retiredCount == 0);
+
+    // Synchronize releases everything at once; Free what is left
+    EpochRetire(&domain, &objects[0], CountRelease);
+    EpochRetire(&domain, &objects[1], CountRelease);
+    EpochSynchronize(&domain);
+    CHECK(g_released == 6 && domain.retiredCount == 0);
+    EpochPin(&domain, a);
+    EpochRetire(&domain, &objects[2], CountRelease);
+    EpochUnpin(&domain, a);
+    EpochFree(&domain);
+    CHECK(g_released == 7);
+}
@@ -0,0 +1,197 @@
+#include "test.h"
+#include "../code/fuzzy.h"
+#include "../code/resultview.h"
+
+#include <string.h>
+
+static bool
+Matches(const wchar_t* pattern, const wchar_t* text, int32_t* score)
+{
+    FuzzyPattern fuzzy;
+    FuzzyCompile(&fuzzy, pattern, wcslen(pattern));
+    return FuzzyMatch(&fuzzy, text, wcslen(text), score);
+}
+
+static int32_t
+Score(const wchar_t* pattern, const wchar_t* text)
+{
+    int32_t score = -1000000;
+    Matches(pattern, text, &score);
+    return score;
+}
+
+static void
+TestFuzzyMatch(void)
+{
+    int32_t score = 0;
+    FuzzyPattern fuzzy;
+
+    // Subsequence, case-insensitive, every term required
+    CHECK(Matches(L"fbr", L"FooBar", NULL));
+    CHECK(Matches(L"FBR", L"foobar", NULL));
+    CHECK(!Matches(L"fbx", L"FooBar", NULL));
+    CHECK(!Matches(L"rbf", L"FooBar", NULL)); // Order matters
+    CHECK(Matches(L"bar foo", L"FooBar", NULL));
+    CHECK(!Matches(L"bar baz", L"FooBar", NULL));
+    CHECK(!Matches(L"foobar", L"foo", NULL));
+
+    // Empty pattern (or only spaces) matches everything with score 0
+    CHECK(Matches(L"", L"anything", &score) && score == 0);
+    CHECK(Matches(L"   ", L"anything", &score) && score == 0);
+    FuzzyCompile(&fuzzy, L"  ab   cd ", 10);
+    CHECK(fuzzy.termCount == 2 && fuzzy.termLength[0] == 2 && fuzzy.termLength[1] == 2);
+
+    // Exact run beats a scattered match
+    CHECK(Score(L"abc", L"xx abc xx") > Score(L"abc", L"xx a-b-c xx"));
+    // Word boundary beats mid-word
+    CHECK(Score(L"bar", L"foo bar") > Score(L"bar", L"foobar"));
+    // camelCase hump beats mid-word
+    CHECK(Score(L"b", L"fooBar") > Score(L"b", L"foobar"));
+    // Path components: delimiter boundaries
+    CHECK(Score(L"mcc", L"src/mclip/code/mclip.c") > 0);
+    CHECK(Score(L"hist", L"code/history.c") > Score(L"hist", L"code/whistle.c"));
+    // Shorter gaps score higher
+    CHECK(Score(L"ac", L"abc") > Score(L"ac", L"abbbbbc"));
+    // The window is shortened backward: the later, tighter "ab" wins over "a    b"
+    CHECK(Score(L"ab", L"a      ab") == Score(L"ab", L"ab"));
+
+    // Non-ASCII folds like the rest of the engine
+    CHECK(Matches(L"\x00E9t\x00E9", L"\x00C9T\x00C9 2024", NULL));
+
+    // Character masks: a text can only match if its mask covers the pattern's
+    FuzzyCompile(&fuzzy, L"Fb9", 3);
+    uint64_t mask = FuzzyCharMask(L"foo BAR 9", 9);
+    CHECK((fuzzy.mask & ~mask) == 0);
+    CHECK((fuzzy.mask & ~FuzzyCharMask(L"foo bar", 7)) != 0);
+    CHECK(FuzzyCharMask(L"", 0) == 0);
+    FuzzyCompile(&fuzzy, L"-_", 2);
+    CHECK((fuzzy.mask & ~FuzzyCharMask(L"a-b_c", 5)) == 0);
+}
+
+static bool
+CountVisits(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry; (void)index;
+    (*(size_t*)context)++;
+    return true;
+}
+
+static void
+TestFuzzySearch(void)
+{
+    History history;
+    SearchState search;
+    const SearchRankedHit* hits = NULL;
+    size_t count = 0;
+    CHECK(HistoryInit(&history, 64));
+    SearchInit(&search);
+
+    HistoryAdd(&history, L"git commit --amend");        // index 5
+    HistoryAdd(&history, L"get coffee maybe");          // index 4
+    HistoryAdd(&history, L"echo gc");                   // index 3
+    HistoryAdd(&history, L"unrelated text");            // index 2
+    HistoryAdd(&history, L"GitCommit");                 // index 1
+    HistoryAdd(&history, L"git commit -m fix");         // index 0
+
+    // Ranked by score, newest first among equals
+    CHECK(SearchRunFuzzy(&search, &history, L"gc", &hits, &count));
+    CHECK(count == 5);
+    for (size_t i = 1; i < count; ++i) {
+        CHECK(hits[i - 1].score > hits[i].score ||
+              (hits[i - 1].score == hits[i].score && hits[i - 1].index < hits[i].index));
+    }
+    CHECK(hits[0].index == 3); // "gc" as a word
+    CHECK(hits[1].index == 0 && hits[2].index == 4 && hits[3].index == 5); // Word starts tie, newer first
+    CHECK(hits[4].index == 1); // camelCase hump scores a little less
+    CHECK(hits[count - 1].seq != HistoryGet(&history, 2)->seq);
+    CHECK(!search.lastRefined);
+
+    // Extending the pattern refines the previous hits
+    CHECK(SearchRunFuzzy(&search, &history, L"gco", &hits, &count));
+    CHECK(search.lastRefined && count == 4);
+    CHECK(SearchRunFuzzy(&search, &history, L"gco fix", &hits, &count));
+    CHECK(search.lastRefined && count == 1 && hits[0].index == 0);
+
+    // A substring search of the same text does not reuse fuzzy hits
+    size_t visits = 0;
+    CHECK(SearchRun(&search, &history, L"gco fix", CountVisits, &visits) == 0 && !search.lastRefined);
+    CHECK(SearchRunFuzzy(&search, &history, L"gco fix", &hits, &count) && !search.lastRefined);
+    HistoryFree(&history);
+    SearchFree(&search);
+}
+
+static void
+TestFuzzyRefineAndView(void)
+{
+    History history;
+    SearchState search, fresh;
+    ResultView view;
+    CHECK(HistoryInit(&history, 512));
+    SearchInit(&search);
+    SearchInit(&fresh);
+    ResultViewInit(&view);
+
+    wchar_t text[96];
+    for (int i = 0; i < 700; ++i) { // Wraps: masks of evicted entries must not leak to new ones
+        swprintf(text, 96, L"item %d %ls/%ls", i, i % 3 ? L"docs" : L"src", i % 5 ? L"readme.md" : L"main.c");
+        HistoryAdd(&history, text);
+    }
+
+    // Refined runs give exactly what a fresh full run gives
+    const wchar_t* patterns[] = { L"s", L"sr", L"src", L"src ", L"src m", L"src ma", L"src mai.c" };
+    for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p) {
+        const SearchRankedHit* hits = NULL;
+        const SearchRankedHit* expected = NULL;
+        size_t count = 0, expectedCount = 0;
+        CHECK(SearchRunFuzzy(&search, &history, patterns[p], &hits, &count));
+        CHECK(p == 0 || search.lastRefined);
+        SearchReset(&fresh);
+        CHECK(SearchRunFuzzy(&fresh, &history, patterns[p], &expected, &expectedCount));
+        CHECK(count == expectedCount && memcmp(hits, expected, count * sizeof(*hits)) == 0);
+    }
+
+    // Cached masks reject without testing the text
+    const SearchRankedHit* hits = NULL;
+    size_t count = 0;
+    SearchReset(&search);
+    CHECK(SearchRunFuzzy(&search, &history, L"zzz", &hits, &count) && count == 0);
+    CHECK(search.lastTested == 0);
+
+    // New entries invalidate refinement; their masks are computed on the fly
+    SearchRunFuzzy(&search, &history, L"src", &hits, &count);
+    size_t before = count;
+    HistoryAdd(&history, L"brand new src file");
+    CHECK(SearchRunFuzzy(&search, &history, L"src", &hits, &count));
+    CHECK(!search.lastRefined && count == before + 1 && hits[0].index == 0);
+
+    // The view switches to ranked mode on the '~' prefix, best match at the bottom
+    CHECK(ResultViewRefresh(&view, &search, &history, L"~mainc"));
+    CHECK(view.ranked && ResultViewCount(&view) > 0);
+    const HistoryEntry* bottom = ResultViewGet(&view, &history, ResultViewCount(&view) - 1);
+    CHECK(bottom && wcsstr(HistoryEntryText(&history, bottom), L"main.c") != NULL);
+
+    // Only the prefix: every entry, newest at the bottom
+    CHECK(ResultViewRefresh(&view, &search, &history, L"~"));
+    CHECK(view.ranked && ResultViewCount(&view) == HistoryCount(&history));
+    CHECK(ResultViewGet(&view, &history, ResultViewCount(&view) - 1) == HistoryGet(&history, 0));
+
+    // A plain query after a fuzzy one is a substring search again
+    size_t visits = 0;
+    SearchRun(&search, &history, L"src", CountVisits, &visits);
+    CHECK(!search.lastRefined);
+    CHECK(ResultViewRefresh(&view, &search, &history, L"mainc"));
+    CHECK(!view.ranked && ResultViewCount(&view) == 0);
+
+    ResultViewFree(&view);
+    SearchFree(&search);
+    SearchFree(&fresh);
+    HistoryFree(&history);
+}
+
+void
+TestFuzzy(void)
+{
+    TestFuzzyMatch();
+    TestFuzzySearch();
+    TestFuzzyRefineAndView();
+}
@@ -0,0 +1,74 @@
+#include "test.h"
+#include "../code/hashindex.h"
+
+static size_t
+CountValues(const HashIndex* index, uint32_t hash)
+{
+    HashIndexIter iter;
+    uint32_t value;
+    size_t found = 0;
+
+    HashIndexFind(index, hash, &iter);
+    while (HashIndexNext(&iter, &value)) found++;
+    return found;
+}
+
+static bool
+HasValue(const HashIndex* index, uint32_t hash, uint32_t wanted)
+{
+    HashIndexIter iter;
+    uint32_t value;
+
+    HashIndexFind(index, hash, &iter);
+    while (HashIndexNext(&iter, &value)) {
+        if (value == wanted) return true;
+    }
+    return false;
+}
+
+void
+TestHashIndex(void)
+{
+    HashIndex index;
+    CHECK(HashIndexInit(&index, 4));
+
+    // Colliding hashes share a probe chain
+    CHECK(HashIndexInsert(&index, 7, 1));
+    CHECK(HashIndexInsert(&index, 7, 2));
+    CHECK(HashIndexInsert(&index, 7 + 16, 3)); // Same home bucket, other hash
+    CHECK(CountValues(&index, 7) == 2);
+    CHECK(CountValues(&index, 7 + 16) == 1);
+
+    // Removing the head of a chain keeps the rest reachable
+    CHECK(HashIndexRemove(&index, 7, 1));
+    CHECK(!HashIndexRemove(&index, 7, 1));
+    CHECK(HasValue(&index, 7, 2));
+    CHECK(HasValue(&index, 7 + 16, 3));
+    CHECK(index.count == 2);
+
+    // Chains that wrap past the end of the table
+    uint32_t lastBucket = (uint32_t)index.mask;
+    CHECK(HashIndexInsert(&index, lastBucket, 10));
+    CHECK(HashIndexInsert(&index, lastBucket, 11));
+    CHECK(HashIndexInsert(&index, 0, 12));
+    CHECK(HashIndexRemove(&index, lastBucket, 10));
+    CHECK(HasValue(&index, lastBucket, 11));
+    CHECK(HasValue(&index, 0, 12));
+    HashIndexFree(&index);
+
+    // Grows under load and survives heavy churn
+    CHECK(HashIndexInit(&index, 1));
+    for (uint32_t i = 0; i < 5000; ++i) {
+        CHECK(HashIndexInsert(&index, i * 2654435761u, i));
+        if (i >= 100) CHECK(HashIndexRemove(&index, (i - 100) * 2654435761u, i - 100));
+    }
+    CHECK(index.count == 100);
+    bool allPresent = true;
+    for (uint32_t i = 4900; i < 5000; ++i) {
+        allPresent = allPresent && HasValue(&index, i * 2654435761u, i);
+    }
+    CHECK(allPresent);
+    CHECK(!HasValue(&index, 10 * 2654435761u, 10));
+    CHECK(HashIndexMemory(&index) >= 100 * sizeof(HashIndexBucket));
+    HashIndexFree(&index);
+}
@@ -0,0 +1,450 @@
+#include "test.h"
+#include "../code/history.h"
+#include "../code/textmatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static bool
+CollectEntry(const HistoryEntry* entry, size_t index, void* context)
+{
+    const HistoryEntry** out = context;
+    out[index] = entry;
+    return true;
+}
+
+static bool
+CountVisit(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry; (void)index;
+    (*(size_t*)context)++;
+    return true;
+}
+
+static bool
+StopAfterFirst(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry; (void)index;
+    (*(int*)context)++;
+    return false;
+}
+
+static void
+TestTextMatch(void)
+{
+    CHECK(TextFoldChar(L'A') == L'a');
+    CHECK(TextFoldChar(L'z') == L'z');
+    CHECK(TextFoldChar(L'\x00C9') == L'\x00E9'); // E acute
+    CHECK(TextEqualsNoCase(L"Hello", 5, L"hELLO", 5));
+    CHECK(!TextEqualsNoCase(L"Hello", 5, L"Hell", 4));
+    CHECK(!TextEqualsNoCase(L"Hello", 5, L"Help!", 5));
+
+    const wchar_t* hay = L"The Quick Brown Fox";
+    CHECK(TextFindNoCase(hay, wcslen(hay), L"quick", 5) == hay + 4);
+    CHECK(TextFindNoCase(hay, wcslen(hay), L"FOX", 3) == hay + 16);
+    CHECK(TextFindNoCase(hay, wcslen(hay), L"foxes", 5) == NULL);
+    CHECK(TextFindNoCase(hay, wcslen(hay), L"", 0) == hay);
+}
+
+static void
+TestAddAndDuplicates(void)
+{
+    History history;
+    CHECK(HistoryInit(&history, 4));
+
+    CHECK(HistoryAdd(&history, L"alpha") == HISTORY_ADDED);
+    CHECK(HistoryAdd(&history, L"ALPHA") == HISTORY_DUPLICATE);
+    CHECK(HistoryAdd(&history, L"") == HISTORY_EMPTY);
+    CHECK(HistoryAdd(&history, NULL) == HISTORY_EMPTY);
+    CHECK(HistoryAdd(&history, L"beta") == HISTORY_ADDED);
+    CHECK(HistoryCount(&history) == 2);
+
+    CHECK(HistoryContains(&history, L"Beta"));
+    CHECK(!HistoryContains(&history, L"gamma"));
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 0)), L"beta") == 0);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 1)), L"alpha") == 0);
+    CHECK(HistoryGet(&history, 2) == NULL);
+    CHECK(HistoryGet(&history, 0)->length == 4);
+
+    HistoryFree(&history);
+}
+
+static void
+TestEviction(void)
+{
+    History history;
+    CHECK(HistoryInit(&history, 3));
+
+    HistoryAdd(&history, L"one");
+    HistoryAdd(&history, L"two");
+    HistoryAdd(&history, L"three");
+    HistoryAdd(&history, L"four"); // Evicts "one"
+
+    CHECK(HistoryCount(&history) == 3);
+    CHECK(history.evictions == 1);
+    CHECK(!HistoryContains(&history, L"one"));
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 0)), L"four") == 0);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 2)), L"two") == 0);
+
+    // An evicted entry may come back
+    CHECK(HistoryAdd(&history, L"one") == HISTORY_ADDED);
+    CHECK(!HistoryContains(&history, L"two"));
+
+    CHECK(HistoryEvictOldest(&history));
+    CHECK(HistoryCount(&history) == 2);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 1)), L"four") == 0);
+    CHECK(HistoryEvictOldest(&history));
+    CHECK(HistoryEvictOldest(&history));
+    CHECK(!HistoryEvictOldest(&history));
+    CHECK(HistoryCount(&history) == 0);
+
+    HistoryFree(&history);
+
+    // Single-slot history keeps only the newest
+    CHECK(HistoryInit(&history, 1));
+    HistoryAdd(&history, L"a");
+    HistoryAdd(&history, L"b");
+    CHECK(HistoryCount(&history) == 1);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 0)), L"b") == 0);
+    HistoryFree(&history);
+
+    CHECK(!HistoryInit(&history, 0));
+}
+
+static void
+TestFilteredIteration(void)
+{
+    History history;
+    CHECK(HistoryInit(&history, 8));
+    HistoryAdd(&history, L"git status");
+    HistoryAdd(&history, L"https://example.com");
+    HistoryAdd(&history, L"GIT log --oneline");
+
+    const HistoryEntry* seen[8] = {0};
+    CHECK(HistoryForEachMatch(&history, NULL, CollectEntry, seen) == 3);
+    CHECK(wcscmp(HistoryEntryText(&history, seen[0]), L"GIT log --oneline") == 0);
+    CHECK(wcscmp(HistoryEntryText(&history, seen[2]), L"git status") == 0);
+
+    memset(seen, 0, sizeof(seen));
+    CHECK(HistoryForEachMatch(&history, L"Git", CollectEntry, seen) == 2);
+    CHECK(seen[0] && wcscmp(HistoryEntryText(&history, seen[0]), L"GIT log --oneline") == 0);
+    CHECK(seen[2] && wcscmp(HistoryEntryText(&history, seen[2]), L"git status") == 0);
+    CHECK(seen[1] == NULL);
+
+    CHECK(HistoryForEachMatch(&history, L"nothing", CollectEntry, seen) == 0);
+
+    int calls = 0;
+    CHECK(HistoryForEachMatch(&history, L"", StopAfterFirst, &calls) == 1);
+    CHECK(calls == 1);
+
+    HistoryFree(&history);
+}
+
+static void
+TestDuplicateIndex(void)
+{
+    History history;
+    CHECK(HistoryInit(&history, 16));
+
+    CHECK(TextHashNoCase(L"MiXeD", 5) == TextHashNoCase(L"mixed", 5));
+
+    // Churn well past capacity; the index must track inserts and evictions
+    wchar_t buffer[32];
+    for (int i = 0; i < 200; ++i) {
+        swprintf(buffer, 32, L"Entry %d", i);
+        CHECK(HistoryAdd(&history, buffer) == HISTORY_ADDED);
+    }
+    CHECK(history.index.count == HistoryCount(&history));
+    CHECK(HistoryContains(&history, L"ENTRY 199"));
+    CHECK(HistoryContains(&history, L"entry 184"));
+    CHECK(!HistoryContains(&history, L"entry 183"));
+    CHECK(HistoryAdd(&history, L"entry 190") == HISTORY_DUPLICATE);
+    CHECK(HistoryAdd(&history, L"entry 100") == HISTORY_ADDED);
+
+    HistoryStats stats;
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.entries == 16);
+    CHECK(stats.evictions == 185);
+    CHECK(stats.textBytes > 16 * 8);
+    CHECK(stats.reservedBytes >= stats.textBytes);
+    CHECK(stats.recycledAllocs > 0);
+
+    HistoryFree(&history);
+}
+
+// Sum of HistoryEntryBytes over the stored entries
+static size_t
+SumEntryBytes(const History* history)
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < HistoryCount(history); ++i) bytes += HistoryEntryBytes(HistoryGet(history, i));
+    return bytes;
+}
+
+static void
+TestLimits(void)
+{
+    History history;
+    CHECK(HistoryInit(&history, 1000));
+    CHECK(history.capacity == HISTORY_MIN_SLOTS); // Slots are taken as entries come
+
+    wchar_t buffer[64];
+    for (int i = 0; i < 100; ++i) {
+        swprintf(buffer, 64, L"Entry %d", i);
+        CHECK(HistoryAdd(&history, buffer) == HISTORY_ADDED);
+    }
+    CHECK(HistoryCount(&history) == 100 && history.evictions == 0);
+    CHECK(history.capacity >= 100 && history.capacity <= 128);
+    CHECK(history.bytes == SumEntryBytes(&history));
+    CHECK(HistoryEntryBytes(HistoryGet(&history, 0)) == sizeof(HistoryEntry) + 9); // "Entry 99" as UTF-8
+
+    // Lowering the entry limit evicts the oldest and shrinks the ring; lookups survive the move
+    uint32_t newestSeq = HistoryGet(&history, 0)->seq;
+    CHECK(HistorySetLimits(&history, 10, 0) == 90);
+    CHECK(HistoryCount(&history) == 10 && history.capacity <= 2 * HISTORY_MIN_SLOTS);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 0)), L"Entry 99") == 0);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 9)), L"Entry 90") == 0);
+    CHECK(HistoryFindSeq(&history, newestSeq) == HistoryGet(&history, 0));
+    CHECK(HistoryContains(&history, L"entry 90") && !HistoryContains(&history, L"entry 89"));
+    CHECK(HistoryAdd(&history, L"ENTRY 95") == HISTORY_DUPLICATE);
+    CHECK(history.index.count == HistoryCount(&history));
+    CHECK(history.bytes == SumEntryBytes(&history));
+
+    HistoryAdd(&history, L"Entry 100"); // At the limit: one in, one out
+    CHECK(HistoryCount(&history) == 10 && !HistoryContains(&history, L"entry 90"));
+
+    // A byte budget of about four entries, and no entry limit
+    size_t entryBytes = HistoryEntryBytes(HistoryGet(&history, 0));
+    CHECK(HistorySetLimits(&history, 0, 4 * entryBytes + entryBytes / 2) == 6);
+    CHECK(HistoryCount(&history) == 4 && history.byteEvictions == 6);
+    CHECK(history.bytes <= history.maxBytes && history.bytes == SumEntryBytes(&history));
+    for (int i = 101; i < 400; ++i) {
+        swprintf(buffer, 64, L"Entry %d", i);
+        CHECK(HistoryAdd(&history, buffer) == HISTORY_ADDED);
+    }
+    CHECK(HistoryCount(&history) == 4 && history.bytes <= history.maxBytes);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 3)), L"Entry 396") == 0);
+
+    // A big entry pushes out as many small ones as it takes; alone over the budget, it is still kept
+    wchar_t big[1000];
+    wmemset(big, L'x', 999);
+    big[999] = L'\0';
+    CHECK(HistoryAdd(&history, big) == HISTORY_ADDED);
+    CHECK(HistoryCount(&history) == 1 && wcscmp(HistoryEntryText(&history, HistoryGet(&history, 0)), big) == 0);
+    CHECK(HistoryAdd(&history, L"small") == HISTORY_ADDED);
+    CHECK(HistoryCount(&history) == 1 && wcscmp(HistoryEntryText(&history, HistoryGet(&history, 0)), L"small") == 0);
+
+    HistoryStats stats;
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.maxEntries == 0 && stats.maxBytes == history.maxBytes);
+    CHECK(stats.entryBytes == history.bytes && stats.byteEvictions == history.byteEvictions);
+    CHECK(stats.slotBytes == history.capacity * sizeof(HistoryEntry) && history.capacity <= HISTORY_MIN_SLOTS);
+    CHECK(stats.evictions == 90 + 1 + 6 + 299 + 4 + 1);
+    HistoryFree(&history);
+
+    // Compressed entries are budgeted at their compressed size
+    CHECK(HistoryInit(&history, 64));
+    HistorySetCompression(&history, 0, 2);
+    wchar_t text[2048];
+    for (int i = 0; i < 8; ++i) {
+        for (int c = 0; c < 2047; ++c) text[c] = L'a' + (c / 64 + i) % 26;
+        text[2047] = L'\0';
+        CHECK(HistoryAdd(&history, text) == HISTORY_ADDED);
+    }
+    CHECK(history.packedEntries == 6);
+    CHECK(history.bytes == SumEntryBytes(&history));
+    CHECK(HistoryEntryBytes(HistoryGet(&history, 7)) < 2048 * sizeof(wchar_t) / 2);
+    HistoryFree(&history);
+}
+
+// Model of a history with promotions: ids newest first, and uses per id
+typedef struct {
+    int ids[64];
+    uint32_t uses[64];
+    size_t count;
+} RecencyModel;
+
+static void
+ModelCopy(RecencyModel* model, int id, size_t maxEntries)
+{
+    uint32_t uses = 1;
+    size_t at = model->count;
+    for (size_t i = 0; i < model->count; ++i) {
+        if (model->ids[i] == id) at = i;
+    }
+    if (at < model->count) {
+        uses = model->uses[at] + 1;
+    } else if (model->count == maxEntries) {
+        at = --model->count; // Oldest evicted
+    }
+    memmove(model->ids + 1, model->ids, at * sizeof(int));
+    memmove(model->uses + 1, model->uses, at * sizeof(uint32_t));
+    model->ids[0] = id;
+    model->uses[0] = uses;
+    if (at == model->count) model->count++;
+}
+
+// True if the history holds the model's entries in its order, both ways of
+// looking them up included
+static bool
+MatchesModel(const History* history, const RecencyModel* model)
+{
+    if (HistoryCount(history) != model->count) return false;
+    wchar_t text[32];
+    const HistoryEntry* entry = HistoryFirst(history, HISTORY_ORDER_RECENT);
+    for (size_t i = 0; i < model->count; ++i, entry = HistoryNext(history, entry, HISTORY_ORDER_RECENT)) {
+        swprintf(text, 32, L"item %d", model->ids[i]);
+        if (!entry || !TextEqualsNoCase(HistoryEntryText(history, entry), entry->length, text, wcslen(text)) ||
+            entry->uses != model->uses[i] || HistoryGet(history, i) != entry ||
+            HistoryRecencyIndex(history, entry) != i || HistoryFindSeq(history, entry->seq) != entry) {
+            return false;
+        }
+    }
+    if (entry) return false;
+
+    // Most used first, most recent first among equals: a stable sort of the above
+    size_t order[64];
+    for (size_t i = 0; i < model->count; ++i) {
+        size_t at = i;
+        for (; at > 0 && model->uses[order[at - 1]] < model->uses[i]; --at) order[at] = order[at - 1];
+        order[at] = i;
+    }
+    for (size_t i = 0; i < model->count; ++i) {
+        if (HistoryGetInOrder(history, HISTORY_ORDER_FREQUENT, i) != HistoryGet(history, order[i])) return false;
+    }
+    return HistoryGetInOrder(history, HISTORY_ORDER_FREQUENT, model->count) == NULL;
+}
+
+static void
+TestPromotion(void)
+{
+    History history;
+    CHECK(HistoryInit(&history, 5));
+
+    CHECK(HistoryAdd(&history, L"one") == HISTORY_ADDED);
+    CHECK(HistoryAdd(&history, L"two") == HISTORY_ADDED);
+    CHECK(HistoryAdd(&history, L"three") == HISTORY_ADDED);
+    CHECK(history.reordered == 0 && HistoryGet(&history, 2)->uses == 1);
+
+    // A re-copy moves the entry to the front, keeps its sequence number, and counts
+    uint32_t seq = HistoryGet(&history, 2)->seq;
+    CHECK(HistoryAdd(&history, L"ONE") == HISTORY_DUPLICATE);
+    const HistoryEntry* one = HistoryGet(&history, 0);
+    CHECK(wcscmp(HistoryEntryText(&history, one), L"one") == 0 && one->seq == seq && one->uses == 2);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 1)), L"three") == 0);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 2)), L"two") == 0);
+    CHECK(HistoryRecencyIndex(&history, HistoryGet(&history, 2)) == 2);
+    CHECK(history.reordered == 1 && history.promotions == 1);
+
+    // Re-copying the newest entry counts a use and changes nothing else
+    CHECK(HistoryAdd(&history, L"one") == HISTORY_DUPLICATE);
+    CHECK(HistoryGet(&history, 0) == one && one->uses == 3 && history.reordered == 1);
+
+    // Most used first
+    CHECK(HistoryAdd(&history, L"two") == HISTORY_DUPLICATE);
+    CHECK(HistoryFirst(&history, HISTORY_ORDER_FREQUENT) == one);
+    const HistoryEntry* two = HistoryNext(&history, one, HISTORY_ORDER_FREQUENT);
+    CHECK(wcscmp(HistoryEntryText(&history, two), L"two") == 0 && two->uses == 2);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryNext(&history, two, HISTORY_ORDER_FREQUENT)), L"three") == 0);
+
+    // The least recently used goes first, whatever its sequence number
+    CHECK(HistoryAdd(&history, L"four") == HISTORY_ADDED);
+    CHECK(HistoryAdd(&history, L"five") == HISTORY_ADDED);
+    CHECK(HistoryAdd(&history, L"six") == HISTORY_ADDED);
+    CHECK(!HistoryContains(&history, L"three") && HistoryContains(&history, L"one"));
+    CHECK(HistoryAdd(&history, L"seven") == HISTORY_ADDED);
+    CHECK(!HistoryContains(&history, L"one") && HistoryFindSeq(&history, seq) == NULL);
+    CHECK(history.reordered == 1); // "two"
+    HistoryFree(&history);
+
+    // Against a model, through growth, shrinking, renumbered stamps and limits
+    RecencyModel model = {0};
+    size_t maxEntries = 64;
+    CHECK(HistoryInit(&history, maxEntries));
+    srand(4242);
+    wchar_t text[32];
+    bool agrees = true;
+    for (int step = 0; step < 20000; ++step) {
+        // Mostly re-copies of a few recent entries, as people do
+        int id = rand() % 4 == 0 ? step : model.count > 0 ? model.ids[rand() % (model.count < 8 ? model.count : 8)] : 0;
+        if (rand() % 3 == 0 && model.count > 0) id = model.ids[rand() % model.count];
+        swprintf(text, 32, rand() % 2 ? L"Item %d" : L"ITEM %d", id);
+        HistoryAddResult result = HistoryAdd(&history, text);
+        bool known = false;
+        for (size_t i = 0; i < model.count; ++i) known = known || model.ids[i] == id;
+        agrees = agrees && result == (known ? HISTORY_DUPLICATE : HISTORY_ADDED);
+        ModelCopy(&model, id, maxEntries);
+
+        if (step % 2500 == 2499) { // Down to a few entries and back up
+            maxEntries = maxEntries == 64 ? 6 : 64;
+            HistorySetLimits(&history, maxEntries, 0);
+            if (model.count > maxEntries) model.count = maxEntries;
+        }
+        if (step % 97 == 0 || step % 2500 == 2499) agrees = agrees && MatchesModel(&history, &model);
+    }
+    CHECK(agrees);
+    CHECK(history.promotions > 10000 && history.reordered > 0);
+    CHECK(history.index.count == HistoryCount(&history) && history.seqs.count == HistoryCount(&history));
+
+    // Random access in either order, in any direction
+    for (size_t i = 0; i < HistoryCount(&history); ++i) {
+        size_t index = (i * 37) % HistoryCount(&history);
+        const HistoryEntry* entry = HistoryGetInOrder(&history, HISTORY_ORDER_RECENT, index);
+        agrees = agrees && entry == HistoryGet(&history, index) && HistoryRecencyIndex(&history, entry) == index;
+    }
+    CHECK(agrees);
+    HistoryFree(&history);
+}
+
+// Text is stored as UTF-8 unless wchar_t is smaller, and searched as stored
+static void
+TestTextForms(void)
+{
+    History history;
+    CHECK(HistoryInit(&history, 8));
+    HistoryAdd(&history, L"plain ASCII");
+    HistoryAdd(&history, L"caf\x00E9 cr\x00E8me");
+    HistoryAdd(&history, L"\x4E2D\x6587\x6587\x672C");
+    HistoryAdd(&history, L"\x212A" L"elvin");
+
+    const HistoryEntry* ascii = HistoryGet(&history, 3);
+    CHECK(ascii->utf8 && ascii->ascii && ascii->utf8Bytes == 11 && !ascii->text);
+    CHECK(HistoryEntryBytes(ascii) == sizeof(HistoryEntry) + 12);
+    const HistoryEntry* latin = HistoryGet(&history, 2);
+    CHECK(latin->utf8 && !latin->ascii && latin->length == 10 && latin->utf8Bytes == 12);
+    const HistoryEntry* cjk = HistoryGet(&history, 1);
+    CHECK(cjk->length == 4 && (sizeof(wchar_t) == 2 ? cjk->text && !cjk->utf8 : cjk->utf8 && !cjk->text));
+    CHECK(wcscmp(HistoryEntryText(&history, ascii), L"plain ASCII") == 0);
+    CHECK(wcscmp(HistoryEntryText(&history, latin), L"caf\x00E9 cr\x00E8me") == 0);
+    CHECK(wcscmp(HistoryEntryText(&history, cjk), L"\x4E2D\x6587\x6587\x672C") == 0);
+    CHECK(HistoryAdd(&history, L"CAF\x00C9 CR\x00C8ME") == HISTORY_DUPLICATE);
+
+    // ASCII filters run on the UTF-8 bytes, others on the decoded text
+    HistoryFilter filter;
+    HistoryPrepareFilter(&filter, L"CAF", 3);
+    CHECK(filter.ascii && HistoryEntryContains(&history, latin, &filter) && !HistoryEntryContains(&history, ascii, &filter));
+    HistoryPrepareFilter(&filter, L"\x00C9 CR", 4);
+    CHECK(!filter.ascii && HistoryEntryContains(&history, latin, &filter) && !HistoryEntryContains(&history, ascii, &filter));
+    HistoryPrepareFilter(&filter, L"\x6587\x672C", 2);
+    CHECK(HistoryEntryContains(&history, cjk, &filter) && !HistoryEntryContains(&history, latin, &filter));
+    HistoryPrepareFilter(&filter, L"", 0);
+    CHECK(HistoryEntryContains(&history, cjk, &filter));
+    size_t visits = 0;
+    CHECK(HistoryForEachMatch(&history, L"kel", CountVisit, &visits) == 1 && visits == 1); // The Kelvin sign
+    CHECK(HistoryForEachMatch(&history, L"\x00E8", CountVisit, &visits) == 1);
+    CHECK(HistoryForEachMatch(&history, L"a", CountVisit, &visits) == 2);
+    HistoryFree(&history);
+}
+
+void
+TestHistory(void)
+{
+    TestTextMatch();
+    TestAddAndDuplicates();
+    TestEviction();
+    TestFilteredIteration();
+    TestDuplicateIndex();
+    TestLimits();
+    TestPromotion();
+    TestTextForms();
+}
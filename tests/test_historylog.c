@@ -0,0 +1,227 @@
+#include "test.h"
+#include "../code/historylog.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char g_logPath[512];
+static char g_indexPath[520];
+
+static void
+RemoveLogFiles(void)
+{
+    PlatformFileDelete(g_logPath);
+    PlatformFileDelete(g_indexPath);
+}
+
+static uint64_t
+FileSize(const char* path)
+{
+    PlatformFile file;
+    uint64_t size = 0;
+    if (PlatformFileOpen(&file, path)) {
+        PlatformFileSize(&file, &size);
+        PlatformFileClose(&file);
+    }
+    return size;
+}
+
+static void
+TruncateFile(const char* path, uint64_t size)
+{
+    PlatformFile file;
+    if (PlatformFileOpen(&file, path)) {
+        PlatformFileTruncate(&file, size);
+        PlatformFileClose(&file);
+    }
+}
+
+static void
+PatchFile(const char* path, uint64_t offset, const void* data, size_t size)
+{
+    PlatformFile file;
+    if (PlatformFileOpen(&file, path)) {
+        PlatformFileWrite(&file, offset, data, size);
+        PlatformFileClose(&file);
+    }
+}
+
+// Logs the entry just added, as the app does
+static bool
+AppendNewest(HistoryLog* log, const History* history)
+{
+    const HistoryEntry* entry = HistoryGet(history, 0);
+    return HistoryLogAppend(log, HistoryEntryText(history, entry), entry->length, entry->hash);
+}
+
+// Opens the log into a fresh history, appends 'count' entries "<prefix> <i>" and closes both
+static void
+WriteEntries(size_t capacity, const wchar_t* prefix, size_t count)
+{
+    History history;
+    HistoryLog log;
+    CHECK(HistoryInit(&history, capacity));
+    CHECK(HistoryLogOpen(&log, g_logPath, &history) == HISTORY_LOG_OK);
+
+    wchar_t text[128];
+    for (size_t i = 0; i < count; ++i) {
+        swprintf(text, 128, L"%ls %zu", prefix, i);
+        if (HistoryAdd(&history, text) == HISTORY_ADDED) {
+            CHECK(AppendNewest(&log, &history));
+        }
+    }
+    HistoryFree(&history);
+    HistoryLogClose(&log);
+}
+
+// Reopens the log and checks the newest entries are "<prefix> <last>" down to "<prefix> <last - expected + 1>"
+static void
+CheckReload(HistoryLog* log, size_t capacity, const wchar_t* prefix, size_t last, size_t expected)
+{
+    History history;
+    CHECK(HistoryInit(&history, capacity));
+    CHECK(HistoryLogOpen(log, g_logPath, &history) == HISTORY_LOG_OK);
+    CHECK(log->loaded == expected);
+    CHECK(HistoryCount(&history) == expected);
+
+    wchar_t text[128];
+    for (size_t i = 0; i < expected && i <= last; ++i) {
+        const HistoryEntry* entry = HistoryGet(&history, i);
+        swprintf(text, 128, L"%ls %zu", prefix, last - i);
+        CHECK(entry != NULL && entry->borrowed && wcscmp(entry->text, text) == 0);
+    }
+    HistoryFree(&history);
+    HistoryLogClose(log);
+}
+
+void
+TestHistoryLog(void)
+{
+    const char* tmp = getenv("TMPDIR");
+    snprintf(g_logPath, sizeof(g_logPath), "%s/mclip_test_%d.log", tmp ? tmp : "/tmp", (int)getpid());
+    snprintf(g_indexPath, sizeof(g_indexPath), "%s.idx", g_logPath);
+    RemoveLogFiles();
+
+    History history;
+    HistoryLog log;
+
+    // Fresh log: nothing to load
+    CHECK(HistoryInit(&history, 8));
+    CHECK(HistoryLogOpen(&log, g_logPath, &history) == HISTORY_LOG_OK);
+    CHECK(HistoryLogIsOpen(&log));
+    CHECK(log.loaded == 0 && log.records == 0 && !log.indexRebuilt);
+
+    // Loaded entries serve text from the mapping and keep duplicate detection
+    HistoryAdd(&history, L"first");
+    CHECK(AppendNewest(&log, &history));
+    HistoryAdd(&history, L"Second entry");
+    CHECK(AppendNewest(&log, &history));
+    HistoryFree(&history);
+    HistoryLogClose(&log);
+    CHECK(!HistoryLogIsOpen(&log));
+    HistoryLogClose(&log); // Closing twice is harmless
+
+    CHECK(HistoryInit(&history, 8));
+    CHECK(HistoryLogOpen(&log, g_logPath, &history) == HISTORY_LOG_OK);
+    CHECK(log.loaded == 2 && log.truncatedBytes == 0 && !log.indexRebuilt);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 0)), L"Second entry") == 0);
+    CHECK(HistoryGet(&history, 1)->borrowed);
+    CHECK(HistoryAdd(&history, L"SECOND ENTRY") == HISTORY_DUPLICATE);
+    CHECK(HistoryContains(&history, L"First"));
+
+    // Evicting a borrowed entry must not hand its text to the arena
+    for (int i = 0; i < 8; ++i) {
+        wchar_t text[16];
+        swprintf(text, 16, L"new %d", i);
+        HistoryAdd(&history, text);
+        CHECK(AppendNewest(&log, &history));
+    }
+    CHECK(!HistoryContains(&history, L"first"));
+    HistoryFree(&history);
+    HistoryLogClose(&log);
+
+    // Only the newest 'capacity' records are loaded
+    RemoveLogFiles();
+    WriteEntries(64, L"entry", 40);
+    CheckReload(&log, 64, L"entry", 39, 40);
+    CheckReload(&log, 10, L"entry", 39, 10);
+    CHECK(log.records == 40 && !log.compacted);
+
+    // Torn tail: the half-written record is dropped, the rest survive
+    uint64_t size = FileSize(g_logPath);
+    TruncateFile(g_logPath, size - 6);
+    CheckReload(&log, 64, L"entry", 38, 39);
+    CHECK(log.truncatedBytes > 0 && log.truncatedBytes < 64);
+    CHECK(FileSize(g_logPath) == size - 6 - log.truncatedBytes);
+
+    // Garbage after the last record (e.g. preallocated zeroes) is dropped as well
+    static const unsigned char zeroes[40];
+    size = FileSize(g_logPath);
+    PatchFile(g_logPath, size, zeroes, sizeof(zeroes));
+    CheckReload(&log, 64, L"entry", 38, 39);
+    CHECK(log.truncatedBytes == sizeof(zeroes));
+
+    // Index behind the log (crash between log sync and index write): tail is re-parsed
+    TruncateFile(g_indexPath, 16 + 16 * 5 + 7);
+    CheckReload(&log, 64, L"entry", 38, 39);
+    CHECK(!log.indexRebuilt && log.records == 39);
+    CHECK(FileSize(g_indexPath) == 16 + 16 * 39);
+
+    // Missing index: rebuilt from a full scan
+    PlatformFileDelete(g_indexPath);
+    CheckReload(&log, 64, L"entry", 38, 39);
+    CHECK(log.indexRebuilt && log.records == 39);
+    CheckReload(&log, 64, L"entry", 38, 39);
+    CHECK(!log.indexRebuilt);
+
+    // Index pointing past the end of the log: rebuilt
+    uint64_t bogus[2] = { 1u << 30, 5 };
+    PatchFile(g_indexPath, 16, bogus, sizeof(bogus));
+    CheckReload(&log, 64, L"entry", 38, 39);
+    CHECK(log.indexRebuilt && log.records == 39);
+
+    // Bit flip in an unindexed record: it fails its CRC and is cut off with what follows
+    TruncateFile(g_indexPath, 16 + 16 * 30);
+    size = FileSize(g_logPath);
+    unsigned char flip = 'X';
+    PatchFile(g_logPath, size - 200, &flip, 1);
+    History probe;
+    CHECK(HistoryInit(&probe, 64));
+    CHECK(HistoryLogOpen(&log, g_logPath, &probe) == HISTORY_LOG_OK);
+    CHECK(log.loaded >= 30 && log.loaded < 39 && log.truncatedBytes >= 200 - 64);
+    HistoryFree(&probe);
+    HistoryLogClose(&log);
+
+    // Compaction once dead records dominate and exceed the size threshold
+    RemoveLogFiles();
+    wchar_t longPrefix[100];
+    wmemset(longPrefix, L'p', 99);
+    longPrefix[99] = L'\0';
+    WriteEntries(16, longPrefix, 4000);
+    uint64_t before = FileSize(g_logPath);
+    CHECK(before > HISTORY_LOG_COMPACT_MIN_BYTES);
+    CheckReload(&log, 16, longPrefix, 3999, 16);
+    CHECK(log.compacted && log.records == 16);
+    CHECK(FileSize(g_logPath) < before / 100);
+    CHECK(FileSize(g_indexPath) == 16 + 16 * 16);
+    CheckReload(&log, 16, longPrefix, 3999, 16);
+    CHECK(!log.compacted && !log.indexRebuilt);
+
+    // Appends after compaction land after the moved records
+    WriteEntries(16, L"after", 3);
+    CheckReload(&log, 3, L"after", 2, 3);
+    CHECK(log.records == 19);
+
+    // A file that is not a log is refused and left alone
+    RemoveLogFiles();
+    PatchFile(g_logPath, 0, "definitely not a history log", 28);
+    CHECK(HistoryInit(&history, 8));
+    CHECK(HistoryLogOpen(&log, g_logPath, &history) == HISTORY_LOG_BAD_FORMAT);
+    CHECK(!HistoryLogIsOpen(&log) && HistoryCount(&history) == 0);
+    CHECK(FileSize(g_logPath) == 28);
+    CHECK(!HistoryLogAppend(&log, L"x", 1, 0) && !HistoryLogFlush(&log));
+    HistoryFree(&history);
+
+    RemoveLogFiles();
+}
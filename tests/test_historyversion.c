@@ -0,0 +1,261 @@
+#include "test.h"
+#include "../code/historyversion.h"
+#include "../code/textmatch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STRESS_READERS 4
+#define STRESS_HISTORY 64
+#define STRESS_ADDS 20000
+
+// Text of stress entry 'n': its number, then a length that depends on it
+static size_t
+StressText(uint32_t n, wchar_t* text)
+{
+    size_t length = (size_t)swprintf(text, 32, L"%u:", n);
+    size_t padding = n % 97;
+    wmemset(text + length, L'a' + n % 26, padding);
+    length += padding;
+    text[length] = L'\0';
+    return length;
+}
+
+// True if the version lists exactly the history, in its order
+static bool
+VersionMatches(const HistoryVersion* version, const History* history, HistoryOrder order)
+{
+    if (version->count != HistoryCount(history) || version->generation != history->generation) return false;
+    size_t i = 0;
+    for (const HistoryEntry* entry = HistoryFirst(history, order); entry; entry = HistoryNext(history, entry, order)) {
+        const HistoryVersionEntry* copy = &version->entries[i++];
+        const wchar_t* text = HistoryEntryText(history, entry);
+        if (copy->text->seq != entry->seq || copy->uses != entry->uses || copy->text->length != entry->length ||
+            !text || wcscmp(copy->text->text, text) != 0) {
+            return false;
+        }
+    }
+    return version->order == order;
+}
+
+// The same, but entries past the text budget may come without text
+static bool
+VersionMatchesBudgeted(const HistoryVersion* version, const History* history)
+{
+    if (version->count != HistoryCount(history)) return false;
+    size_t i = 0;
+    for (const HistoryEntry* entry = HistoryFirst(history, HISTORY_ORDER_RECENT); entry;
+         entry = HistoryNext(history, entry, HISTORY_ORDER_RECENT)) {
+        const HistoryVersionText* copy = version->entries[i++].text;
+        const wchar_t* text = HistoryEntryText(history, entry);
+        if (copy->seq != entry->seq || copy->length != entry->length || (copy->text && wcscmp(copy->text, text) != 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+typedef struct {
+    HistoryVersions* versions;
+    volatile int32_t* done;
+    size_t reads;
+    size_t torn;         // Versions that were not as published
+} StressReader;
+
+// Pins and checks versions until the writer is done. Every entry must be
+// intact, every version at least as new as the last.
+static void
+ReadVersions(void* context)
+{
+    StressReader* reader = context;
+    int slot = HistoryVersionsRegister(reader->versions);
+    if (slot < 0) return;
+    uint64_t lastGeneration = 0;
+    while (!PlatformAtomicLoad(reader->done)) {
+        const HistoryVersion* version = HistoryVersionsPin(reader->versions, slot);
+        if (version) {
+            bool intact = version->generation >= lastGeneration && version->count <= STRESS_HISTORY;
+            lastGeneration = version->generation;
+            wchar_t expected[160];
+            for (size_t i = 0; i < version->count && intact; ++i) {
+                const HistoryVersionText* text = version->entries[i].text;
+                size_t length = StressText((uint32_t)wcstoul(text->text, NULL, 10), expected);
+                intact = text->length == length && wcscmp(text->text, expected) == 0 &&
+                         text->hash == TextHashNoCase(text->text, length) && version->entries[i].uses >= 1;
+            }
+            if (!intact) reader->torn++;
+            reader->reads++;
+        }
+        HistoryVersionsUnpin(reader->versions, slot);
+    }
+    HistoryVersionsUnregister(reader->versions, slot);
+}
+
+void
+TestHistoryVersion(void)
+{
+    History history;
+    HistoryVersions versions;
+    CHECK(HistoryInit(&history, 4));
+    CHECK(HistoryVersionsInit(&versions));
+    int reader = HistoryVersionsRegister(&versions);
+    CHECK(reader >= 0);
+    CHECK(HistoryVersionsPin(&versions, reader) == NULL); // Nothing published yet
+    HistoryVersionsUnpin(&versions, reader);
+
+    // A version lists the history as it was, in the order asked for
+    HistoryAdd(&history, L"alpha");
+    HistoryAdd(&history, L"beta");
+    HistoryAdd(&history, L"gamma");
+    HistoryAdd(&history, L"alpha"); // Re-copy: first in both orders, 2 uses
+    CHECK(HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT));
+    const HistoryVersion* first = HistoryVersionsPin(&versions, reader);
+    CHECK(first && VersionMatches(first, &history, HISTORY_ORDER_RECENT));
+    CHECK(first && first->count == 3 && wcscmp(first->entries[0].text->text, L"alpha") == 0 &&
+          first->entries[0].uses == 2);
+    HistoryVersionsUnpin(&versions, reader);
+    CHECK(HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_FREQUENT));
+    const HistoryVersion* frequent = HistoryVersionsPin(&versions, reader);
+    CHECK(frequent && VersionMatches(frequent, &history, HISTORY_ORDER_FREQUENT));
+    HistoryVersionsUnpin(&versions, reader);
+
+    // Texts are shared between versions: only new entries are copied
+    const HistoryVersionText* beta = NULL;
+    for (size_t i = 0; frequent && i < frequent->count; ++i) {
+        if (wcscmp(frequent->entries[i].text->text, L"beta") == 0) beta = frequent->entries[i].text;
+    }
+    HistoryAdd(&history, L"delta");
+    CHECK(HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT));
+    const HistoryVersion* second = HistoryVersionsPin(&versions, reader);
+    CHECK(second && VersionMatches(second, &history, HISTORY_ORDER_RECENT));
+    CHECK(second && second->count == 4 && second->entries[3].text == beta);
+    CHECK(versions.textCount == 4 && versions.textBytes == (5 + 4 + 5 + 5) * sizeof(wchar_t));
+
+    // While pinned, the version and its texts outlive evictions and later
+    // publishes (ASan would flag a read of freed memory below)
+    HistoryAdd(&history, L"epsilon"); // Evicts beta
+    HistoryAdd(&history, L"zeta");    // ... and gamma
+    for (int i = 0; i < 5; ++i) CHECK(HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT));
+    CHECK(versions.epochs.retiredCount >= 5 + 2); // 'second' and 4 later versions, beta and gamma
+    size_t released = versions.epochs.released;
+    CHECK(second && wcscmp(second->entries[3].text->text, L"beta") == 0 && second->entries[3].text->seq == 1);
+    CHECK(versions.textCount == 4);
+    HistoryVersionsUnpin(&versions, reader);
+    CHECK(HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT));
+    CHECK(HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT));
+    CHECK(versions.epochs.released > released && versions.epochs.retiredCount <= 2);
+
+    HistoryVersionsUnregister(&versions, reader);
+    HistoryVersionsFree(&versions);
+    HistoryFree(&history);
+
+    // A text budget: texts are copied in list order while they fit, the
+    // others are listed without; a record changes side as the list does
+    CHECK(HistoryInit(&history, 8));
+    CHECK(HistoryVersionsInit(&versions));
+    versions.textBudget = 10 * sizeof(wchar_t);
+    reader = HistoryVersionsRegister(&versions);
+    HistoryAdd(&history, L"older");
+    HistoryAdd(&history, L"a longer one");
+    HistoryAdd(&history, L"new");
+    CHECK(HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT));
+    const HistoryVersion* budgeted = HistoryVersionsPin(&versions, reader);
+    CHECK(budgeted && VersionMatchesBudgeted(budgeted, &history));
+    CHECK(budgeted && budgeted->entries[0].text->text && !budgeted->entries[1].text->text &&
+          budgeted->entries[2].text->text && budgeted->entries[1].text->length == 12);
+    CHECK(versions.textBytes == 8 * sizeof(wchar_t) && versions.textCount == 3);
+    HistoryAdd(&history, L"fresh");
+    CHECK(HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT)); // "older" loses its text
+    const HistoryVersion* over = HistoryVersionsPin(&versions, reader);
+    CHECK(over && VersionMatchesBudgeted(over, &history) && !over->entries[3].text->text);
+    CHECK(versions.textBytes == 8 * sizeof(wchar_t) && versions.textCount == 4);
+    CHECK(budgeted && wcscmp(budgeted->entries[2].text->text, L"older") == 0); // Still pinned
+    HistoryVersionsUnpin(&versions, reader);
+    CHECK(HistoryVersionsMemory(&versions) > versions.textBytes + 4 * sizeof(HistoryVersionText));
+    HistoryVersionsUnregister(&versions, reader);
+    HistoryVersionsFree(&versions);
+    HistoryFree(&history);
+
+    // Compressed entries are copied decompressed
+    CHECK(HistoryInit(&history, 8));
+    CHECK(HistoryVersionsInit(&versions));
+    reader = HistoryVersionsRegister(&versions);
+    HistorySetCompression(&history, HISTORY_COLD_MIN_BYTES, 0);
+    wchar_t big[1024];
+    for (int i = 0; i < 1023; ++i) big[i] = L'a' + i % 7;
+    big[1023] = L'\0';
+    HistoryAdd(&history, big);
+    HistoryAdd(&history, L"plain");
+    CHECK(HistoryGet(&history, 1)->packed != NULL);
+    CHECK(HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT));
+    const HistoryVersion* packed = HistoryVersionsPin(&versions, reader);
+    CHECK(packed && VersionMatches(packed, &history, HISTORY_ORDER_RECENT) &&
+          wcscmp(packed->entries[1].text->text, big) == 0);
+
+    // A pinned version is written to the shared-memory snapshot without the
+    // history; later changes don't reach it
+    char name[64];
+    snprintf(name, sizeof(name), "mclip-test-version-%d", (int)getpid());
+    SnapshotWriter writer;
+    SnapshotReader snapshot;
+    CHECK(SnapshotWriterOpen(&writer, name, 64 * 1024) && SnapshotReaderOpen(&snapshot, name));
+    HistoryAdd(&history, L"later");
+    CHECK(HistoryVersionsPublish(&versions, &history, HISTORY_ORDER_RECENT));
+    if (packed) HistoryVersionWriteSnapshot(packed, &writer);
+    HistoryVersionsUnpin(&versions, reader);
+    SnapshotView view;
+    SnapshotEntry copied[2];
+    CHECK(SnapshotReadBegin(&snapshot, &view) && view.count == 2 && view.total == 2);
+    CHECK(packed && view.generation == packed->generation && view.order == HISTORY_ORDER_RECENT);
+    CHECK(SnapshotViewEntry(&view, 0, &copied[0]) && SnapshotViewEntry(&view, 1, &copied[1]));
+    const char* plain = SnapshotViewText(&view, &copied[0]);
+    const char* bigText = SnapshotViewText(&view, &copied[1]);
+    CHECK(plain && strcmp(plain, "plain") == 0 && copied[0].seq == HistoryGet(&history, 1)->seq);
+    CHECK(bigText && copied[1].bytes == 1023 && bigText[1022] == big[1022]);
+    CHECK(SnapshotReadValidate(&snapshot, &view));
+    SnapshotReaderClose(&snapshot);
+    SnapshotWriterClose(&writer);
+    HistoryVersionsUnregister(&versions, reader);
+    HistoryVersionsFree(&versions);
+    HistoryFree(&history);
+
+    // Readers on several threads while the writer adds, evicts, re-copies and
+    // publishes as fast as it can: no version is ever seen torn (and, under
+    // the sanitizers, no text is read after it was freed)
+    CHECK(HistoryInit(&history, STRESS_HISTORY));
+    CHECK(HistoryVersionsInit(&versions));
+    volatile int32_t done = 0;
+    StressReader readers[STRESS_READERS];
+    PlatformThread* threads[STRESS_READERS];
+    for (int i = 0; i < STRESS_READERS; ++i) {
+        readers[i] = (StressReader){ &versions, &done, 0, 0 };
+        threads[i] = PlatformThreadStart(ReadVersions, &readers[i]);
+        CHECK(threads[i] != NULL);
+    }
+    wchar_t text[160];
+    bool published = true;
+    for (uint32_t n = 0; n < STRESS_ADDS; ++n) {
+        uint32_t value = n % 5 == 4 ? n - 3 : n; // Some re-copies of recent entries
+        StressText(value, text);
+        HistoryAdd(&history, text);
+        published = HistoryVersionsPublish(&versions, &history, n % 3 ? HISTORY_ORDER_RECENT : HISTORY_ORDER_FREQUENT) &&
+                    published;
+    }
+    PlatformAtomicStore(&done, 1);
+    size_t reads = 0, torn = 0;
+    for (int i = 0; i < STRESS_READERS; ++i) {
+        if (threads[i]) PlatformThreadJoin(threads[i]);
+        reads += readers[i].reads;
+        torn += readers[i].torn;
+    }
+    CHECK(published);
+    CHECK(torn == 0);
+    CHECK(reads > 0);
+    // Everything retired is released once the readers are gone
+    EpochSynchronize(&versions.epochs);
+    CHECK(versions.epochs.retiredCount == 0 && versions.textCount == HistoryCount(&history));
+    HistoryVersionsFree(&versions);
+    HistoryFree(&history);
+}
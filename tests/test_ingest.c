@@ -0,0 +1,195 @@
+#include "test.h"
+#include "../code/history.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool
+PreviewIs(const wchar_t* text, const wchar_t* expected)
+{
+    wchar_t preview[HISTORY_PREVIEW_CHARS + 1];
+    size_t length = HistoryMakePreview(text, wcslen(text), preview);
+    return length == wcslen(expected) && wcscmp(preview, expected) == 0;
+}
+
+// 'length' characters of a log-like line, repeated
+static wchar_t*
+MakeText(size_t length, wchar_t first)
+{
+    wchar_t* text = malloc((length + 1) * sizeof(wchar_t));
+    if (!text) return NULL;
+    static const wchar_t pattern[] = L"GET /api/items 200 12ms\r\n";
+    for (size_t i = 0; i < length; ++i) text[i] = pattern[i % (sizeof(pattern) / sizeof(wchar_t) - 1)];
+    text[0] = first;
+    text[length] = L'\0';
+    return text;
+}
+
+static void
+TestPreviews(void)
+{
+    CHECK(PreviewIs(L"plain", L"plain"));
+    CHECK(PreviewIs(L"\r\n\t  indented\r\n\r\nnext line\n", L"indented next line"));
+    CHECK(PreviewIs(L"keeps   inner  spaces", L"keeps   inner  spaces"));
+    CHECK(PreviewIs(L"tab\tand \n mixed", L"tab and mixed"));
+    CHECK(PreviewIs(L"bell\a and\x1b escape", L"bell and escape"));
+    CHECK(PreviewIs(L" \r\n ", L""));
+
+    // Cut at the limit, ending in an ellipsis
+    wchar_t* text = MakeText(10000, L'X');
+    wchar_t preview[HISTORY_PREVIEW_CHARS + 1];
+    size_t length = HistoryMakePreview(text, 10000, preview);
+    CHECK(length == HISTORY_PREVIEW_CHARS || length == HISTORY_PREVIEW_CHARS - 1);
+    CHECK(preview[length - 1] == 0x2026 && preview[length] == L'\0');
+    CHECK(preview[0] == L'X' && wcschr(preview, L'\n') == NULL);
+
+    // Never ends in half a surrogate pair
+    for (size_t i = 0; i < 300; i += 2) {
+        text[i] = 0xD83D;
+        text[i + 1] = 0xDE00;
+    }
+    length = HistoryMakePreview(text, 300, preview);
+    CHECK(preview[length - 1] == 0x2026 && preview[length - 2] == 0xDE00);
+    free(text);
+}
+
+static void
+TestEntryPreviews(void)
+{
+    History history;
+    HistoryStats stats;
+    size_t length;
+    CHECK(HistoryInit(&history, 8));
+    HistorySetCompression(&history, 4096, 2);
+
+    // A single short line is its own preview
+    HistoryAdd(&history, L"short");
+    const HistoryEntry* entry = HistoryGet(&history, 0);
+    CHECK(entry->preview == NULL);
+    CHECK(wcscmp(HistoryEntryPreview(&history, entry, &length), L"short") == 0 && length == 5);
+
+    HistoryAdd(&history, L"two\r\nlines");
+    entry = HistoryGet(&history, 0);
+    CHECK(wcscmp(HistoryEntryPreview(&history, entry, &length), L"two lines") == 0 && length == 9);
+    CHECK(wcscmp(HistoryEntryText(&history, entry), L"two\r\nlines") == 0);
+
+    // Large entries are compressed; their preview never needs decompressing
+    wchar_t* large = MakeText(100000, L'L');
+    CHECK(HistoryAdd(&history, large) == HISTORY_ADDED);
+    entry = HistoryGet(&history, 0);
+    CHECK(entry->packed != NULL);
+    HistoryGetStats(&history, &stats);
+    uint64_t decodes = stats.decodes;
+    const wchar_t* preview = HistoryEntryPreview(&history, entry, &length);
+    CHECK(length <= HISTORY_PREVIEW_CHARS && preview[0] == L'L' && preview[length - 1] == 0x2026);
+
+    // Entries compressed when they turn cold get one too
+    wchar_t* cold = MakeText(1000, L'C');
+    HistoryAdd(&history, cold);
+    HistoryAdd(&history, L"newer 1");
+    HistoryAdd(&history, L"newer 2");
+    entry = HistoryGet(&history, 2);
+    CHECK(entry->packed != NULL && entry->preview != NULL);
+    preview = HistoryEntryPreview(&history, entry, &length);
+    CHECK(preview[0] == L'C' && preview[1] == L'E');
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.decodes == decodes);
+    CHECK(wcscmp(HistoryEntryText(&history, entry), cold) == 0);
+
+    // Eviction gives the preview memory back
+    while (HistoryEvictOldest(&history)) {}
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.textBytes == 0);
+
+    free(cold);
+    free(large);
+    HistoryFree(&history);
+}
+
+static void
+TestSizeLimit(void)
+{
+    History history;
+    HistoryStats stats;
+    size_t length;
+    wchar_t* huge = MakeText(1000000, L'H');
+    CHECK(HistoryInit(&history, 4));
+
+    // Truncate (also what spilling falls back to without a spill file)
+    HistorySetSizeLimit(&history, 1000, HISTORY_OVERSIZE_SPILL);
+    CHECK(HistoryAdd(&history, huge) == HISTORY_ADDED);
+    const HistoryEntry* entry = HistoryGet(&history, 0);
+    CHECK(entry->length == 1000 && HistoryEntryText(&history, entry)[1000] == L'\0');
+    CHECK(wcsncmp(HistoryEntryText(&history, entry), huge, 1000) == 0);
+    CHECK(HistoryAdd(&history, huge) == HISTORY_DUPLICATE); // Same text, same cut
+    CHECK(HistoryAdd(&history, L"short enough") == HISTORY_ADDED);
+
+    // ... never between the halves of a surrogate pair
+    huge[999] = 0xD83D;
+    huge[1000] = 0xDE00;
+    HistorySetSizeLimit(&history, 1000, HISTORY_OVERSIZE_TRUNCATE);
+    CHECK(HistoryAdd(&history, huge) == HISTORY_ADDED);
+    CHECK(HistoryGet(&history, 0)->length == 999);
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.truncatedEntries == 2);
+
+    // Skip
+    HistorySetSizeLimit(&history, 1000, HISTORY_OVERSIZE_SKIP);
+    size_t count = HistoryCount(&history);
+    CHECK(HistoryAdd(&history, huge) == HISTORY_TOO_LARGE);
+    CHECK(HistoryCount(&history) == count);
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.skippedEntries == 1);
+    huge[999] = L'x';
+    huge[1000] = L'y';
+
+    // Spill: kept whole, out of memory, read back on demand
+    char path[256];
+    const char* tmp = getenv("TMPDIR");
+    snprintf(path, sizeof(path), "%s/mclip_test_%d.spill", tmp ? tmp : "/tmp", (int)getpid());
+    CHECK(HistoryOpenSpill(&history, path));
+    HistorySetSizeLimit(&history, 1000, HISTORY_OVERSIZE_SPILL);
+    HistoryGetStats(&history, &stats);
+    size_t textBytes = stats.textBytes;
+    CHECK(HistoryAdd(&history, huge) == HISTORY_ADDED);
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.spilledEntries == 1 && stats.spilledBytes > 0);
+    CHECK(stats.packedEntries == 0);
+    CHECK(stats.textBytes - textBytes < 4 * HISTORY_PREVIEW_CHARS * sizeof(wchar_t)); // Header and preview
+    entry = HistoryGet(&history, 0);
+    CHECK(entry->length == 1000000);
+    CHECK(HistoryEntryPreview(&history, entry, &length)[0] == L'H' && length <= HISTORY_PREVIEW_CHARS);
+    const wchar_t* text = HistoryEntryText(&history, entry);
+    CHECK(text && wcscmp(text, huge) == 0);
+    CHECK(HistoryContains(&history, huge));
+    CHECK(HistoryAdd(&history, huge) == HISTORY_DUPLICATE);
+
+    huge[0] = L'I';
+    CHECK(HistoryAdd(&history, huge) == HISTORY_ADDED);
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.spilledEntries == 2);
+    CHECK(HistoryOpenSpill(&history, path) == false); // Entries live in the current one
+
+    // The file is emptied once nothing in it is referenced
+    PlatformFile file = PLATFORM_FILE_CLOSED;
+    uint64_t size = 0;
+    CHECK(PlatformFileOpen(&file, path) && PlatformFileSize(&file, &size) && size == stats.spilledBytes);
+    while (HistoryEvictOldest(&history)) {}
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.spilledEntries == 0 && stats.spilledBytes == 0 && stats.textBytes == 0);
+    CHECK(PlatformFileSize(&file, &size) && size == 0);
+    PlatformFileClose(&file);
+
+    HistoryFree(&history);
+    PlatformFileDelete(path);
+    free(huge);
+}
+
+void
+TestIngestion(void)
+{
+    TestPreviews();
+    TestEntryPreviews();
+    TestSizeLimit();
+}
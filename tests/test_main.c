@@ -0,0 +1,41 @@
+#include "test.h"
+
+#include <locale.h>
+
+int g_testChecks = 0;
+int g_testFailures = 0;
+
+int
+main(void)
+{
+    // Enable towlower() beyond ASCII, like the app does at startup
+    setlocale(LC_CTYPE, "C.UTF-8");
+
+    TestTextMatchKernels();
+    TestHistory();
+    TestHashIndex();
+    TestArena();
+    TestSearch();
+    TestTrigram();
+    TestResultView();
+    TestHistoryLog();
+    TestCompression();
+    TestFuzzy();
+    TestRegex();
+    TestSearchWorker();
+    TestClipAcquire();
+    TestIngestion();
+    TestBlobStore();
+    TestMetrics();
+    TestClipIngest();
+    TestReplay();
+    TestSnapshot();
+    TestEpoch();
+    TestHistoryVersion();
+    TestExclude();
+    TestNearDup();
+    TestMeta();
+
+    printf("%d checks, %d failures\n", g_testChecks, g_testFailures);
+    return g_testFailures == 0 ? 0 : 1;
+}
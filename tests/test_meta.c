@@ -0,0 +1,280 @@
+#include "test.h"
+#include "replay.h"
+#include "../code/meta.h"
+#include "../code/platform.h"
+#include "../code/resultview.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NOW 1700000000 // 2023-11-14
+
+static MetaQuery
+Parse(const wchar_t* text, wchar_t* rest)
+{
+    MetaQuery query;
+    MetaQueryParse(&query, text, wcslen(text), NOW, rest);
+    return query;
+}
+
+// Local time of 'hour':'minute' on the day of 'now'
+static int64_t
+Today(int64_t now, int hour, int minute)
+{
+    struct tm local;
+    PlatformLocalTime(now, &local);
+    local.tm_hour = hour;
+    local.tm_min = minute;
+    local.tm_sec = 0;
+    local.tm_isdst = -1;
+    return (int64_t)mktime(&local);
+}
+
+static bool
+RowIs(const ResultView* view, const History* history, size_t row, const wchar_t* text)
+{
+    const HistoryEntry* entry = ResultViewGet(view, history, row);
+    return entry != NULL && wcscmp(HistoryEntryText(history, entry), text) == 0;
+}
+
+typedef struct {
+    uint32_t seqs[64];
+    size_t indices[64];
+    size_t count;
+} Visited;
+
+static bool
+Visit(const HistoryEntry* entry, size_t index, void* context)
+{
+    Visited* visited = context;
+    if (visited->count == 64) return false;
+    visited->seqs[visited->count] = entry->seq;
+    visited->indices[visited->count++] = index;
+    return true;
+}
+
+void
+TestMeta(void)
+{
+    // Classes
+    CHECK(MetaClassify(L"  https://example.com/a?b=1\n", 28) == META_CLASS_URL);
+    CHECK(MetaClassify(L"www.example.com", 15) == META_CLASS_URL);
+    CHECK(MetaClassify(L"someone@example.com", 19) == META_CLASS_EMAIL);
+    CHECK(MetaClassify(L"C:\\Program Files\\mclip\\mclip.exe", 32) == META_CLASS_PATH);
+    CHECK(MetaClassify(L"/usr/local/bin", 14) == META_CLASS_PATH);
+    CHECK(MetaClassify(L"1,234.50", 8) == META_CLASS_NUMBER);
+    CHECK(MetaClassify(L"2024-03-01 12:30", 16) == META_CLASS_NUMBER);
+    const wchar_t* code = L"for (int i = 0; i < n; ++i) {\n    total += values[i];\n}\n";
+    CHECK(MetaClassify(code, wcslen(code)) == META_CLASS_CODE);
+    const wchar_t* prose = L"Meeting moved to Thursday (room 4), see you there.";
+    CHECK(MetaClassify(prose, wcslen(prose)) == META_CLASS_TEXT);
+    CHECK(MetaClassify(L"a@b", 3) == META_CLASS_TEXT && MetaClassify(L" \n", 2) == META_CLASS_TEXT);
+    CHECK(wcscmp(MetaClassName(META_CLASS_FILES), L"files") == 0);
+
+    // Parsing: filters out, the rest kept as typed
+    wchar_t rest[128];
+    MetaQuery query = Parse(L"app:code after:10:00 size:>1k", rest);
+    CHECK(query.active && rest[0] == L'\0');
+    CHECK(query.appCount == 1 && wcscmp(query.apps[0], L"code") == 0);
+    CHECK(query.minBytes == 1025 && query.maxBytes == UINT32_MAX);
+    CHECK(query.after == (uint32_t)Today(NOW, 10, 0) && query.before == UINT32_MAX);
+    query = Parse(L"foo  APP:term bar TYPE:url type:Path", rest);
+    CHECK(query.active && wcscmp(rest, L"foo  bar") == 0 && wcscmp(query.apps[0], L"term") == 0);
+    CHECK(query.classes == ((1u << META_CLASS_URL) | (1u << META_CLASS_PATH)));
+    query = Parse(L"  http://x.com size:lots type:blob after:25:00  ", rest);
+    CHECK(!query.active && wcscmp(rest, L"  http://x.com size:lots type:blob after:25:00  ") == 0);
+    query = Parse(L"before:2h x", rest);
+    CHECK(query.active && query.after == 1 && query.before == NOW - 7200 - 1 && wcscmp(rest, L"x") == 0);
+    query = Parse(L"after:2023-11-01 before:2023-11-10T08:30", rest);
+    struct tm day = { 0 };
+    day.tm_year = 123;
+    day.tm_mon = 10;
+    day.tm_mday = 1;
+    day.tm_isdst = -1;
+    CHECK(query.after == (uint32_t)mktime(&day));
+    day.tm_mday = 10;
+    day.tm_hour = 8;
+    day.tm_min = 30;
+    day.tm_isdst = -1;
+    CHECK(query.before == (uint32_t)mktime(&day) - 1);
+    query = Parse(L"size:<=2K size:>=10 size:=5", rest);
+    CHECK(query.minBytes == 10 && query.maxBytes == 5); // Contradicting: nothing passes
+    query = Parse(L"size:<0", rest);
+    CHECK(query.minBytes > query.maxBytes);
+    MetaQuery same = Parse(L"app:code  after:10:00   size:>1k ", rest);
+    query = Parse(L"app:code after:10:00 size:>1k", rest);
+    CHECK(MetaQueryEqual(&query, &same));
+    same = Parse(L"app:coder after:10:00 size:>1k", rest);
+    CHECK(!MetaQueryEqual(&query, &same));
+
+    // Sources
+    MetaSources sources;
+    MetaSourcesInit(&sources);
+    CHECK(MetaSourcesIntern(&sources, NULL) == 0 && MetaSourcesIntern(&sources, L"") == 0);
+    uint16_t codeId = MetaSourcesIntern(&sources, L"Code");
+    uint16_t termId = MetaSourcesIntern(&sources, L"WindowsTerminal");
+    CHECK(codeId == 1 && termId == 2 && MetaSourcesIntern(&sources, L"Code") == codeId);
+    CHECK(wcscmp(MetaSourceName(&sources, termId), L"WindowsTerminal") == 0);
+    CHECK(wcscmp(MetaSourceName(&sources, 0), L"") == 0 && wcscmp(MetaSourceName(&sources, 99), L"") == 0);
+    for (int i = 0; i < 100; ++i) {
+        wchar_t name[16];
+        swprintf(name, 16, L"app%d", i);
+        CHECK(MetaSourcesIntern(&sources, name) == 3 + i);
+    }
+    CHECK(MetaSourcesIntern(&sources, L"WindowsTerminal") == termId);
+
+    // Scans: one column at a time, slots past the end clear
+    MetaColumns columns;
+    CHECK(MetaColumnsInit(&columns, 200));
+    for (size_t slot = 0; slot < 200; ++slot) {
+        columns.times[slot] = slot % 10 == 0 ? 0 : (uint32_t)(NOW - 1000 + slot);
+        columns.sources[slot] = slot % 2 ? codeId : termId;
+        columns.bytes[slot] = (uint32_t)slot * 10;
+        columns.classes[slot] = (uint8_t)(slot % 3 == 0 ? META_CLASS_URL : META_CLASS_TEXT);
+    }
+    uint64_t bits[4];
+    MetaQueryInit(&query);
+    CHECK(MetaQueryScan(&query, &columns, &sources, 200, bits) == 200 && bits[3] == (1ull << 8) - 1);
+    query = Parse(L"app:cod", rest);
+    CHECK(MetaQueryScan(&query, &columns, &sources, 200, bits) == 100 && MetaSlotPasses(bits, 1) &&
+          !MetaSlotPasses(bits, 2));
+    query = Parse(L"app:CODE app:terminal size:>=1000 size:<1100", rest);
+    CHECK(MetaQueryScan(&query, &columns, &sources, 200, bits) == 10 && MetaSlotPasses(bits, 100));
+    query = Parse(L"type:url after:1000s", rest); // Slots 0..199 copied 1000..801 s ago, every tenth unknown
+    CHECK(MetaQueryScan(&query, &columns, &sources, 200, bits) == 60);
+    CHECK(!MetaSlotPasses(bits, 0) && MetaSlotPasses(bits, 3) && !MetaSlotPasses(bits, 30));
+    query = Parse(L"size:<0", rest);
+    CHECK(MetaQueryScan(&query, &columns, &sources, 200, bits) == 0 && bits[0] == 0);
+    query = Parse(L"app:nowhere", rest);
+    CHECK(MetaQueryScan(&query, &columns, &sources, 200, bits) == 0);
+    MetaColumnsFree(&columns);
+    MetaSourcesFree(&sources);
+
+    // In a history: columns follow their entries as the pool is resized
+    History history;
+    CHECK(HistoryInit(&history, 300));
+    int64_t now = (int64_t)time(NULL);
+    for (int i = 0; i < 300; ++i) {
+        wchar_t text[64];
+        if (i % 4 == 3) {
+            swprintf(text, 64, L"https://example.com/page/%d", i);
+        } else {
+            swprintf(text, 64, L"entry %d", i);
+        }
+        CHECK(HistoryAdd(&history, text) == HISTORY_ADDED);
+        HistorySetOrigin(&history, HistoryGet(&history, 0), now - 3000 + i * 10, i % 2 ? L"Code" : L"WindowsTerminal");
+    }
+    CHECK(HistoryAdd(&history, L"entry 10") == HISTORY_DUPLICATE); // Re-copied without a known source
+    HistorySetOrigin(&history, HistoryGet(&history, 0), now, NULL);
+    HistorySetLimits(&history, 200, 0); // The pool grew from 16 slots on the way
+    HistoryMeta meta;
+    bool consistent = true;
+    for (const HistoryEntry* entry = HistoryFirst(&history, HISTORY_ORDER_RECENT); entry;
+         entry = HistoryNext(&history, entry, HISTORY_ORDER_RECENT)) {
+        HistoryGetMeta(&history, entry, &meta);
+        int64_t copied = entry->seq == 10 ? now : now - 3000 + (int64_t)entry->seq * 10;
+        const wchar_t* source = entry->seq % 2 ? L"Code" : L"WindowsTerminal";
+        MetaClass metaClass = entry->seq % 4 == 3 ? META_CLASS_URL : META_CLASS_TEXT;
+        consistent = consistent && meta.time == copied && wcscmp(meta.source, source) == 0 &&
+                     meta.bytes == entry->length && meta.metaClass == metaClass;
+    }
+    CHECK(consistent && HistoryCount(&history) == 200);
+    CHECK(HistoryAdd(&history, L"h\u00e9llo \u4e16\u754c") == HISTORY_ADDED);
+    HistoryGetMeta(&history, HistoryGet(&history, 0), &meta);
+    CHECK(meta.bytes == 13 && meta.time == 0 && meta.source[0] == L'\0');
+    HistoryStats stats;
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.metaBytes >= history.capacity * 11);
+
+    // Scans limited to a few slots visit just those, as the full walk would
+    uint64_t* historyBits = malloc((history.capacity + 63) / 64 * sizeof(uint64_t));
+    CHECK(historyBits != NULL);
+    const wchar_t* recent = L"app:terminal after:150s"; // 286..298 even, and the re-copied entry 10
+    MetaQueryParse(&query, recent, wcslen(recent), now, rest);
+    HistoryScanControl sparse = { 0, NULL, false, historyBits, 0 };
+    sparse.slotsSet = MetaQueryScan(&query, &history.meta, &history.sources, history.capacity, historyBits);
+    HistoryScanControl full = sparse;
+    full.slotsSet = SIZE_MAX;
+    Visited fromSparse = { 0 }, fromFull = { 0 };
+    CHECK(HistoryScan(&history, L"", 0, Visit, &fromSparse, &sparse) == 8 &&
+          HistoryScan(&history, L"", 0, Visit, &fromFull, &full) == 8);
+    CHECK(memcmp(fromSparse.seqs, fromFull.seqs, sizeof(fromFull.seqs)) == 0 &&
+          memcmp(fromSparse.indices, fromFull.indices, sizeof(fromFull.indices)) == 0);
+    CHECK(fromFull.seqs[0] == 10 && fromFull.indices[0] == 1 && fromFull.seqs[1] == 298 && fromFull.indices[1] == 3);
+    memset(&fromSparse, 0, sizeof(fromSparse));
+    CHECK(HistoryScan(&history, L"entry 29", 8, Visit, &fromSparse, &sparse) == 5 && sparse.tested == 8);
+    CHECK(fromSparse.seqs[4] == 290 && fromSparse.indices[4] == 11);
+    free(historyBits);
+
+    // Result views: filters narrow the text query, anywhere in it
+    SearchState search;
+    ResultView view;
+    SearchInit(&search);
+    ResultViewInit(&view);
+    CHECK(ResultViewRefresh(&view, &search, &history, L"app:code"));
+    CHECK(ResultViewCount(&view) == 99 && RowIs(&view, &history, 98, L"https://example.com/page/299"));
+    CHECK(ResultViewRefresh(&view, &search, &history, L"app:code entry 2"));
+    CHECK(ResultViewCount(&view) == 25 && RowIs(&view, &history, 0, L"entry 201"));
+    CHECK(ResultViewRefresh(&view, &search, &history, L"app:code entry 29"));
+    CHECK(search.lastRefined && search.lastTested == 25 && ResultViewCount(&view) == 2);
+    CHECK(ResultViewRefresh(&view, &search, &history, L"app:terminal entry 29"));
+    CHECK(!search.lastRefined && ResultViewCount(&view) == 5 && RowIs(&view, &history, 0, L"entry 290"));
+    CHECK(ResultViewRefresh(&view, &search, &history, L"type:url after:200s"));
+    CHECK(ResultViewCount(&view) == 5 && RowIs(&view, &history, 0, L"https://example.com/page/283"));
+    CHECK(ResultViewRefresh(&view, &search, &history, L"before:2500s"));
+    CHECK(ResultViewCount(&view) == 0); // Entries 100..299 and the re-copy are newer; 301 has no time
+    CHECK(ResultViewRefresh(&view, &search, &history, L"~ntry 29"));
+    size_t fuzzyRows = ResultViewCount(&view);
+    CHECK(fuzzyRows > 0);
+    CHECK(ResultViewRefresh(&view, &search, &history, L"size:<10 ~ntry 29"));
+    CHECK(view.ranked && ResultViewCount(&view) == fuzzyRows);
+    CHECK(ResultViewRefresh(&view, &search, &history, L"size:>=10 ~ntry 29"));
+    CHECK(ResultViewCount(&view) == 0);
+    CHECK(ResultViewRefresh(&view, &search, &history, L"app:code /^entry 1[0-9]1$"));
+    CHECK(ResultViewCount(&view) == 4 && RowIs(&view, &history, 3, L"entry 181"));
+    CHECK(ResultViewRefresh(&view, &search, &history, L"entry 10"));
+    CHECK(ResultViewCount(&view) == 7); // Without filters: as before
+    view.order = HISTORY_ORDER_FREQUENT;
+    CHECK(ResultViewRefresh(&view, &search, &history, L"app:terminal entry 1"));
+    CHECK(RowIs(&view, &history, ResultViewCount(&view) - 1, L"entry 10")); // Copied twice
+    ResultViewFree(&view);
+    SearchFree(&search);
+    HistoryFree(&history);
+
+    // Ingestion records where and when each copy came from
+    CHECK(HistoryInit(&history, 8));
+    Metrics metrics;
+    MetricsInit(&metrics, 0);
+    ClipAcquire acquire;
+    ClipAcquireInit(&acquire, 1);
+    ClipSink sink = { &history, NULL, NULL, &metrics };
+    ReplayClipboard clipboard;
+    memset(&clipboard, 0, sizeof(clipboard));
+    ClipBackend backend = ReplayClipboardBackend(&clipboard);
+    clipboard.text = L"ls -la ~/src";
+    clipboard.textLength = wcslen(clipboard.text);
+    clipboard.source = L"WindowsTerminal";
+    ClipContent content;
+    ClipAcquireNotify(&acquire, 0);
+    CHECK(ClipTryRead(&backend, &acquire, &metrics, &content, 0) == 0);
+    CHECK(content.time >= now && wcscmp(content.source, L"WindowsTerminal") == 0);
+    content.time = 1000;
+    CHECK(ClipIngest(&sink, &content, NULL) == HISTORY_ADDED);
+    HistoryGetMeta(&history, HistoryGet(&history, 0), &meta);
+    CHECK(meta.time == 1000 && wcscmp(meta.source, L"WindowsTerminal") == 0 && meta.bytes == 12);
+    ClipContentFree(&content);
+    ClipContent again = { 0 };
+    again.text = L"LS -LA ~/SRC";
+    again.time = 2000;
+    CHECK(ClipIngest(&sink, &again, NULL) == HISTORY_DUPLICATE);
+    HistoryGetMeta(&history, HistoryGet(&history, 0), &meta);
+    CHECK(meta.time == 2000 && wcscmp(meta.source, L"WindowsTerminal") == 0);
+    ClipContent image = { 0 };
+    image.labelClass = META_CLASS_IMAGE;
+    wcscpy(image.source, L"mspaint");
+    CHECK(ClipIngest(&sink, &image, L"[Image 10 x 10, 1 KB #00000001]") == HISTORY_ADDED);
+    HistoryGetMeta(&history, HistoryGet(&history, 0), &meta);
+    CHECK(meta.metaClass == META_CLASS_IMAGE && wcscmp(meta.source, L"mspaint") == 0 && meta.time == 0);
+    HistoryFree(&history);
+}
@@ -0,0 +1,139 @@
+#include "test.h"
+#include "../code/metrics.h"
+#include "../code/platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void
+TestLatencyBuckets(void)
+{
+    // Buckets tile the range without gaps, each within 12.5% of its lower bound
+    uint64_t expectedLow = 0;
+    bool tiled = true, precise = true;
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        uint64_t low, high;
+        LatencyHistogramBucketRange(i, &low, &high);
+        if (low != expectedLow || high < low) tiled = false;
+        if (low >= LATENCY_SUB_BUCKETS && (high - low + 1) * LATENCY_SUB_BUCKETS > low) precise = false;
+        expectedLow = high + 1;
+    }
+    CHECK(tiled && precise);
+    CHECK(expectedLow == 1ull << LATENCY_MAX_BITS);
+
+    // Every value lands in the bucket whose range holds it
+    LatencyHistogram histogram;
+    uint64_t values[] = { 0, 1, 7, 8, 15, 16, 17, 1000, 123456789, (1ull << LATENCY_MAX_BITS) - 1 };
+    bool placed = true;
+    for (size_t v = 0; v < sizeof(values) / sizeof(values[0]); ++v) {
+        memset(&histogram, 0, sizeof(histogram));
+        LatencyHistogramRecord(&histogram, values[v]);
+        for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+            if (!histogram.buckets[i]) continue;
+            uint64_t low, high;
+            LatencyHistogramBucketRange(i, &low, &high);
+            if (values[v] < low || values[v] > high) placed = false;
+        }
+    }
+    CHECK(placed);
+
+    // Beyond the range: the last bucket, but the maximum stays exact
+    memset(&histogram, 0, sizeof(histogram));
+    LatencyHistogramRecord(&histogram, UINT64_MAX / 2);
+    CHECK(histogram.buckets[LATENCY_BUCKETS - 1] == 1 && histogram.maxNs == UINT64_MAX / 2);
+}
+
+static void
+TestLatencyPercentiles(void)
+{
+    LatencyHistogram histogram;
+    memset(&histogram, 0, sizeof(histogram));
+    CHECK(LatencyHistogramPercentile(&histogram, 50) == 0);
+
+    // 1..1000 us: percentiles within a bucket (12.5%) above the true value
+    for (uint64_t us = 1; us <= 1000; ++us) LatencyHistogramRecord(&histogram, us * 1000);
+    CHECK(histogram.count == 1000 && histogram.maxNs == 1000000);
+    CHECK(histogram.totalNs == 500500ull * 1000);
+    uint64_t p50 = LatencyHistogramPercentile(&histogram, 50);
+    uint64_t p99 = LatencyHistogramPercentile(&histogram, 99);
+    CHECK(p50 >= 500000 && p50 <= 562500);
+    CHECK(p99 >= 990000 && p99 <= 1000000); // Capped by the maximum
+    CHECK(LatencyHistogramPercentile(&histogram, 100) == 1000000);
+    CHECK(LatencyHistogramPercentile(&histogram, 0) <= 1125);
+
+    // A tail of slow samples shows at p99, not at p50
+    LatencyHistogram merged;
+    memset(&merged, 0, sizeof(merged));
+    for (int i = 0; i < 98; ++i) LatencyHistogramRecord(&merged, 2000);
+    LatencyHistogram slow;
+    memset(&slow, 0, sizeof(slow));
+    LatencyHistogramRecord(&slow, 50000000);
+    LatencyHistogramRecord(&slow, 60000000);
+    LatencyHistogramMerge(&merged, &slow);
+    CHECK(merged.count == 100 && merged.maxNs == 60000000);
+    CHECK(LatencyHistogramPercentile(&merged, 50) < 2300);
+    CHECK(LatencyHistogramPercentile(&merged, 99) >= 50000000);
+}
+
+static void
+TestMetricsReports(void)
+{
+    Metrics metrics;
+    MetricsInit(&metrics, 1000);
+    MetricsRecord(&metrics, METRIC_HISTORY_ADD, 1500);
+    MetricsRecord(&metrics, METRIC_HISTORY_ADD, 2500000);
+    MetricsCount(&metrics, METRIC_ENTRIES_ADDED, 2);
+    MetricsCount(&metrics, METRIC_BYTES_ADDED, 84);
+    CHECK(strcmp(MetricsStageName(METRIC_LIST_REFRESH), "list_refresh") == 0);
+    CHECK(strcmp(MetricsCounterName(METRIC_CLIPBOARD_RETRIES), "clipboard_retries") == 0);
+
+    uint64_t now = 1000 + 3723ull * 1000000000ull; // 1h 02m 03s later
+    char text[2048];
+    size_t length = MetricsFormatText(&metrics, now, text, sizeof(text));
+    CHECK(length == strlen(text));
+    CHECK(strstr(text, "Uptime 1h 02m 03s") != NULL);
+    CHECK(strstr(text, "history_add: 2, mean 1.3 ms,") != NULL);
+    CHECK(strstr(text, "max 2.5 ms") != NULL);
+    CHECK(strstr(text, "search: no samples") != NULL);
+    CHECK(strstr(text, "entries_added: 2\n") != NULL && strstr(text, "bytes_added: 84\n") != NULL);
+
+    char json[8192];
+    length = MetricsFormatJson(&metrics, now, json, sizeof(json));
+    CHECK(length == strlen(json) && json[0] == '{' && json[length - 2] == '}');
+    CHECK(strstr(json, "\"history_add\": {\"count\": 2, \"total_ns\": 2501500,") != NULL);
+    CHECK(strstr(json, "[1408, 1535, 1]") != NULL);
+    CHECK(strstr(json, "\"entries_added\": 2,") != NULL);
+
+    // Cut short, still terminated, and the full length is reported
+    char small[64];
+    CHECK(MetricsFormatJson(&metrics, now, small, sizeof(small)) == length);
+    CHECK(strlen(small) == sizeof(small) - 1 && memcmp(small, json, sizeof(small) - 1) == 0);
+    CHECK(MetricsFormatText(&metrics, now, NULL, 0) == strlen(text));
+
+    // Saved over whatever the file held
+    char path[512];
+    const char* tmp = getenv("TMPDIR");
+    snprintf(path, sizeof(path), "%s/mclip_stats_%d.json", tmp ? tmp : "/tmp", (int)getpid());
+    PlatformFile file = PLATFORM_FILE_CLOSED;
+    CHECK(PlatformFileOpen(&file, path));
+    CHECK(PlatformFileWrite(&file, 0, json, length));
+    CHECK(PlatformFileWrite(&file, length, json, length)); // Longer than the report
+    PlatformFileClose(&file);
+    CHECK(MetricsSaveJson(&metrics, now, path));
+    uint64_t size = 0;
+    char* saved = malloc(length);
+    CHECK(PlatformFileOpen(&file, path) && PlatformFileSize(&file, &size) && size == length);
+    CHECK(saved && PlatformFileRead(&file, 0, saved, length) && memcmp(saved, json, length) == 0);
+    PlatformFileClose(&file);
+    free(saved);
+    PlatformFileDelete(path);
+}
+
+void
+TestMetrics(void)
+{
+    TestLatencyBuckets();
+    TestLatencyPercentiles();
+    TestMetricsReports();
+}
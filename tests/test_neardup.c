@@ -0,0 +1,173 @@
+#include "test.h"
+#include "../code/history.h"
+#include "../code/neardup.h"
+#include "../code/resultview.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static NearDupPrint
+Print(const wchar_t* text)
+{
+    NearDupPrint print;
+    NearDupFingerprint(text, wcslen(text), &print);
+    return print;
+}
+
+static const wchar_t g_trace[] =
+    L"2024-03-01 12:00:01.117 ERROR Request failed: connection reset by peer\n"
+    L"    at Client.send (client.js:120:15)\n"
+    L"    at Retry.run (retry.js:44:9)\n"
+    L"    at Queue.drain (queue.js:77:3)\n";
+
+static const wchar_t g_traceLater[] =
+    L"2024-03-01 12:07:43.902 ERROR Request failed: connection reset by peer\n"
+    L"    at Client.send (client.js:121:15)\n"
+    L"    at Retry.run (retry.js:44:9)\n"
+    L"    at Queue.drain (queue.js:77:3)\n";
+
+static bool
+CountMatch(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry;
+    (void)index;
+    ++*(size_t*)context;
+    return true;
+}
+
+void
+TestNearDup(void)
+{
+    // Whitespace and case do not change the exact hash; other characters do
+    NearDupPrint a = Print(L"  int x = 1;\n\treturn x;  \n");
+    NearDupPrint b = Print(L"INT X = 1; RETURN X;");
+    CHECK(a.exact == b.exact && a.words == 5);
+    CHECK(Print(L"int x = 2; return x;").exact != b.exact);
+    CHECK(Print(L"intx = 1; return x;").exact != b.exact);
+    CHECK(Print(L"").words == 0 && Print(L" \n ").exact == Print(L"").exact);
+
+    // Numbers are all one word; texts differing in a few words are a few bits apart
+    NearDupPrint trace = Print(g_trace), later = Print(g_traceLater);
+    CHECK(trace.exact != later.exact && trace.sketch == later.sketch && trace.words > 20);
+    NearDupPrint edited = Print(L"2024-03-01 12:00:01.117 ERROR Request failed: connection refused by peer\n"
+                                L"    at Client.send (client.js:120:15)\n    at Retry.run (retry.js:44:9)\n"
+                                L"    at Queue.drain (queue.js:77:3)\n");
+    NearDupPrint other = Print(L"The quick brown fox jumps over the lazy dog while the cat sleeps on the mat");
+    CHECK(NearDupDistance(trace.sketch, edited.sketch) < NearDupDistance(trace.sketch, other.sketch));
+    CHECK(NearDupDistance(trace.sketch, other.sketch) > NEARDUP_MAX_DISTANCE);
+
+    // Index: exact matches first, sketches within the distance, a window of seqs
+    NearDupConfig config;
+    NearDupDefaultConfig(&config);
+    NearDupIndex index;
+    CHECK(NearDupInit(&index, &config) && index.bands == NEARDUP_DEFAULT_DISTANCE + 1);
+    CHECK(NearDupAdd(&index, 10, &trace));
+    CHECK(NearDupAdd(&index, 11, &other));
+    CHECK(NearDupAdd(&index, 12, &b));
+    uint32_t seq = 0;
+    CHECK(NearDupFind(&index, &later, 0, &seq) && seq == 10);
+    CHECK(!NearDupFind(&index, &later, 11, &seq));
+    CHECK(NearDupFind(&index, &a, 0, &seq) && seq == 12); // Too short for a sketch, but equal
+    NearDupPrint short1 = Print(L"call 555 0100"), short2 = Print(L"call 555 0199");
+    CHECK(short1.sketch == short2.sketch && short1.exact != short2.exact);
+    CHECK(NearDupAdd(&index, 13, &short1));
+    CHECK(!NearDupFind(&index, &short2, 0, &seq)); // Under minWords: only exact hashes count
+    NearDupPrint near = trace;
+    near.exact ^= 1;
+    near.sketch ^= 0x8000000000000101ull; // Three bits: two of the four bands unchanged
+    CHECK(NearDupFind(&index, &near, 0, &seq) && seq == 10);
+    near.sketch ^= 0x10;
+    CHECK(!NearDupFind(&index, &near, 0, &seq));
+    NearDupRemove(&index, 10);
+    NearDupRemove(&index, 99); // Unknown: ignored
+    CHECK(index.count == 3 && !NearDupFind(&index, &later, 0, &seq));
+
+    // Records are reused; every one is still found after many adds and removes
+    for (uint32_t i = 100; i < 1100; ++i) {
+        NearDupPrint print = { (uint64_t)i * 0x9e3779b97f4a7c15ull, (uint64_t)i * 0xc2b2ae3d27d4eb4full, 10 };
+        CHECK(NearDupAdd(&index, i, &print));
+        if (i % 3 == 0) NearDupRemove(&index, i);
+    }
+    bool all = true;
+    for (uint32_t i = 100; i < 1100; ++i) {
+        NearDupPrint print = { (uint64_t)i * 0x9e3779b97f4a7c15ull ^ 1, (uint64_t)i * 0xc2b2ae3d27d4eb4full ^ 2, 10 };
+        bool found = NearDupFind(&index, &print, 0, &seq) && seq == i;
+        all = all && found == (i % 3 != 0);
+    }
+    CHECK(all);
+    NearDupFree(&index);
+
+    // In a history: the newer copy replaces the older one and takes its uses
+    History history;
+    CHECK(HistoryInit(&history, 4));
+    CHECK(HistoryEnableTrigramIndex(&history, true));
+    CHECK(HistoryAdd(&history, g_trace) == HISTORY_ADDED);
+    CHECK(HistoryAdd(&history, L"unrelated") == HISTORY_ADDED);
+    CHECK(HistoryAdd(&history, L"unrelated") == HISTORY_DUPLICATE);
+    CHECK(HistoryEnableNearDuplicates(&history, &config)); // Indexes the entries already there
+    CHECK(HistoryAdd(&history, L"UNRELATED \n") == HISTORY_ADDED);
+    CHECK(HistoryCount(&history) == 2 && history.nearDuplicates == 1 && history.evictions == 0);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 0)), L"UNRELATED \n") == 0);
+    CHECK(HistoryGet(&history, 0)->uses == 3);
+    CHECK(HistoryFirst(&history, HISTORY_ORDER_FREQUENT) == HistoryGet(&history, 0));
+    CHECK(HistoryAdd(&history, g_traceLater) == HISTORY_ADDED);
+    CHECK(HistoryCount(&history) == 2 && history.nearDuplicates == 2 && HistoryGet(&history, 0)->uses == 2);
+    CHECK(!HistoryContains(&history, g_trace) && HistoryContains(&history, g_traceLater));
+    size_t matches = 0;
+    HistoryForEachMatch(&history, L"ERROR Request", CountMatch, &matches);
+    CHECK(matches == 1); // The trigram index forgot the replaced entry
+
+    // A full history does not evict for a replacing copy; evicted entries are not matched
+    CHECK(HistoryAdd(&history, L"third") == HISTORY_ADDED);
+    CHECK(HistoryAdd(&history, L"fourth") == HISTORY_ADDED);
+    CHECK(HistoryAdd(&history, L"  third") == HISTORY_ADDED);
+    CHECK(HistoryCount(&history) == 4 && history.evictions == 0 && history.nearDuplicates == 3);
+    CHECK(history.capacity == 5); // The copy was stored in a spare slot before "third" went
+    CHECK(HistoryAdd(&history, L"fifth") == HISTORY_ADDED && history.evictions == 1);
+    CHECK(HistoryAdd(&history, L"unrelated!") == HISTORY_ADDED && history.nearDuplicates == 3);
+    CHECK(history.nearDups->count == HistoryCount(&history));
+
+    // A window: only the newest entries are replaced
+    config.window = 2;
+    CHECK(HistoryEnableNearDuplicates(&history, &config));
+    CHECK(HistoryAdd(&history, L"fourth ") == HISTORY_ADDED && history.nearDuplicates == 3);
+    CHECK(HistoryAdd(&history, L"unrelated! ") == HISTORY_ADDED && history.nearDuplicates == 4);
+    HistoryStats stats;
+    HistoryGetStats(&history, &stats);
+    CHECK(stats.nearDuplicates == 4 && stats.nearDupBytes > 0);
+    CHECK(HistoryEnableNearDuplicates(&history, NULL) && history.nearDups == NULL);
+    CHECK(HistoryAdd(&history, L"unrelated!  ") == HISTORY_ADDED && history.nearDuplicates == 4);
+    HistoryFree(&history);
+
+    // Replacing an entry between others leaves its sequence number missing
+    CHECK(HistoryInit(&history, 8));
+    NearDupDefaultConfig(&config);
+    CHECK(HistoryEnableNearDuplicates(&history, &config));
+    CHECK(HistoryAdd(&history, L"alpha") == HISTORY_ADDED && HistoryAdd(&history, L"beta") == HISTORY_ADDED);
+    CHECK(HistoryAdd(&history, L"gamma") == HISTORY_ADDED && HistoryAdd(&history, L"beta ") == HISTORY_ADDED);
+    CHECK(HistoryCount(&history) == 3 && history.reordered == 0 && !HistorySeqOrdered(&history));
+    const HistoryEntry* alpha = HistoryGet(&history, 2);
+    CHECK(alpha && wcscmp(HistoryEntryText(&history, alpha), L"alpha") == 0);
+    CHECK(HistoryRecencyIndex(&history, alpha) == 2 && HistoryGet(&history, 3) == NULL);
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 1)), L"gamma") == 0);
+    SearchState search;
+    ResultView view;
+    SearchInit(&search);
+    ResultViewInit(&view);
+    CHECK(ResultViewRefresh(&view, &search, &history, L"") && ResultViewCount(&view) == 3);
+    const wchar_t* rows[] = { L"alpha", L"gamma", L"beta " };
+    bool shown = true;
+    for (size_t row = 0; row < 3; ++row) {
+        const HistoryEntry* entry = ResultViewGet(&view, &history, row);
+        shown = shown && entry && wcscmp(HistoryEntryText(&history, entry), rows[row]) == 0;
+    }
+    CHECK(shown);
+    CHECK(ResultViewRefresh(&view, &search, &history, L"a") && ResultViewCount(&view) == 3);
+    CHECK(ResultViewGet(&view, &history, 0) == alpha);
+    HistorySetLimits(&history, 1, 0); // Once the gap is evicted the shortcut is back
+    CHECK(HistoryCount(&history) == 1 && HistorySeqOrdered(&history));
+    CHECK(wcscmp(HistoryEntryText(&history, HistoryGet(&history, 0)), L"beta ") == 0);
+    ResultViewFree(&view);
+    SearchFree(&search);
+    HistoryFree(&history);
+}
@@ -0,0 +1,293 @@
+#include "test.h"
+#include "../code/regex.h"
+#include "../code/resultview.h"
+#include "../code/textmatch.h"
+
+#include <string.h>
+
+// 1 on a match, 0 on none, -error if the pattern does not compile
+static int
+Match(const wchar_t* pattern, const wchar_t* text)
+{
+    Regex regex;
+    RegexError error = RegexCompile(&regex, pattern, wcslen(pattern));
+    if (error != REGEX_OK) return -(int)error;
+    int matched = RegexMatch(&regex, text, wcslen(text));
+    RegexFree(&regex);
+    return matched;
+}
+
+static void
+TestRegexSyntax(void)
+{
+    // Literals match anywhere, case-insensitively
+    CHECK(Match(L"abc", L"xxABCxx") == 1);
+    CHECK(Match(L"abc", L"ab") == 0);
+    CHECK(Match(L"", L"") == 1);
+    CHECK(Match(L"", L"anything") == 1);
+    CHECK(Match(L"\x00C9t\x00C9", L"\x00E9T\x00E9 2024") == 1);
+
+    // Anchors are the ends of the text
+    CHECK(Match(L"^abc", L"abcx") == 1);
+    CHECK(Match(L"^abc", L"xabc") == 0);
+    CHECK(Match(L"abc$", L"xabc") == 1);
+    CHECK(Match(L"abc$", L"abcx") == 0);
+    CHECK(Match(L"^$", L"") == 1);
+    CHECK(Match(L"^$", L"a") == 0);
+    CHECK(Match(L"^a|b$", L"xxb") == 1);
+
+    // Classes, shorthands and the dot
+    CHECK(Match(L"[a-c]x", L"Bx") == 1);
+    CHECK(Match(L"[^a-z]", L"ABC") == 0); // Negation applies to both cases
+    CHECK(Match(L"[^a-z]", L"AB1") == 1);
+    CHECK(Match(L"[]a]", L"]") == 1);
+    CHECK(Match(L"[a-]", L"-") == 1);
+    CHECK(Match(L"[\\d_]+", L"x_") == 1);
+    CHECK(Match(L"[\x00C0-\x00DE]", L"\x00E9") == 1);
+    CHECK(Match(L"\\d{3}-\\d{4}", L"call 555-1234 now") == 1);
+    CHECK(Match(L"\\d{3}-\\d{4}", L"55-1234") == 0);
+    CHECK(Match(L"\\W", L"abc_1") == 0);
+    CHECK(Match(L"\\s", L"a\tb") == 1);
+    CHECK(Match(L"\\S+@\\S+\\.\\w+", L"mail bob@example.org") == 1);
+    CHECK(Match(L"a.c", L"a-c") == 1);
+    CHECK(Match(L"a.c", L"a\nc") == 0);
+    CHECK(Match(L"\\x41\\u00e9", L"a\x00C9") == 1);
+
+    // Repetition, groups and alternation
+    CHECK(Match(L"(?:ab)+$", L"xababab") == 1);
+    CHECK(Match(L"^(ab)+$", L"ababa") == 0);
+    CHECK(Match(L"^a{2,3}$", L"aaa") == 1);
+    CHECK(Match(L"^a{2,3}$", L"aaaa") == 0);
+    CHECK(Match(L"^a{2,}$", L"aaaaaaa") == 1);
+    CHECK(Match(L"^a{2}$", L"a") == 0);
+    CHECK(Match(L"colou?r", L"COLOR") == 1);
+    CHECK(Match(L"a|", L"zzz") == 1);
+    CHECK(Match(L"x{", L"x{") == 1); // Not a count: literal
+    CHECK(Match(L"(a*)*b", L"aaab") == 1);
+
+    // Word boundaries
+    CHECK(Match(L"\\bcat\\b", L"a cat.") == 1);
+    CHECK(Match(L"\\bcat\\b", L"concat") == 0);
+    CHECK(Match(L"\\Bcat", L"concat") == 1);
+    CHECK(Match(L"\\d\\b", L"12a") == 0);
+    CHECK(Match(L"\\d\\b", L"12 a") == 1);
+    CHECK(Match(L"\\d\\b", L"12") == 1);
+
+    // Errors
+    CHECK(Match(L"[abc", L"") == -REGEX_ERROR_SYNTAX);
+    CHECK(Match(L"(a", L"") == -REGEX_ERROR_SYNTAX);
+    CHECK(Match(L"a)", L"") == -REGEX_ERROR_SYNTAX);
+    CHECK(Match(L"*a", L"") == -REGEX_ERROR_SYNTAX);
+    CHECK(Match(L"a{2,1}", L"") == -REGEX_ERROR_SYNTAX);
+    CHECK(Match(L"[z-a]", L"") == -REGEX_ERROR_SYNTAX);
+    CHECK(Match(L"\\q", L"") == -REGEX_ERROR_SYNTAX);
+    CHECK(Match(L"a\\", L"") == -REGEX_ERROR_SYNTAX);
+    CHECK(Match(L"[\\b]", L"") == -REGEX_ERROR_SYNTAX);
+    CHECK(Match(L"a{5000}", L"") == -REGEX_ERROR_TOO_BIG);
+    CHECK(Match(L"(a{100}){100}", L"") == -REGEX_ERROR_TOO_BIG);
+}
+
+// Backtracking reference matcher for patterns over single characters, '.',
+// '*', '+', '?', '^' and '$' (each quantifier applies to one character)
+static bool
+ReferenceHere(const wchar_t* pattern, const wchar_t* text)
+{
+    if (pattern[0] == L'\0') return true;
+    if (pattern[0] == L'$' && pattern[1] == L'\0') return text[0] == L'\0';
+    bool first = text[0] != L'\0' && (pattern[0] == L'.' || TextFoldChar(pattern[0]) == TextFoldChar(text[0]));
+    switch (pattern[1]) {
+    case L'*':
+        return ReferenceHere(pattern + 2, text) || (first && ReferenceHere(pattern, text + 1));
+    case L'+':
+        return first && (ReferenceHere(pattern + 2, text + 1) || ReferenceHere(pattern, text + 1));
+    case L'?':
+        return ReferenceHere(pattern + 2, text) || (first && ReferenceHere(pattern + 2, text + 1));
+    default:
+        return first && ReferenceHere(pattern + 1, text + 1);
+    }
+}
+
+static bool
+ReferenceMatch(const wchar_t* pattern, const wchar_t* text)
+{
+    if (pattern[0] == L'^') return ReferenceHere(pattern + 1, text);
+    do {
+        if (ReferenceHere(pattern, text)) return true;
+    } while (*text++ != L'\0');
+    return false;
+}
+
+static void
+TestRegexAgainstReference(void)
+{
+    static const wchar_t atoms[] = L"abB.";
+    static const wchar_t quantifiers[] = L"*+?";
+    static const wchar_t letters[] = L"aAbB";
+    unsigned n = 2024;
+    size_t mismatches = 0;
+    for (int p = 0; p < 400; ++p) {
+        wchar_t pattern[16];
+        size_t length = 0;
+        n = n * 1103515245u + 12345u;
+        if ((n >> 20) % 4 == 0) pattern[length++] = L'^';
+        size_t atomCount = 1 + (n >> 8) % 4;
+        for (size_t i = 0; i < atomCount; ++i) {
+            n = n * 1103515245u + 12345u;
+            pattern[length++] = atoms[(n >> 16) % 4];
+            if ((n >> 12) % 3 == 0) pattern[length++] = quantifiers[(n >> 4) % 3];
+        }
+        if ((n >> 24) % 4 == 0) pattern[length++] = L'$';
+        pattern[length] = L'\0';
+
+        Regex regex;
+        CHECK(RegexCompile(&regex, pattern, length) == REGEX_OK);
+        for (int t = 0; t < 40; ++t) {
+            wchar_t text[12];
+            n = n * 1103515245u + 12345u;
+            size_t textLength = (n >> 16) % 10;
+            for (size_t i = 0; i < textLength; ++i) {
+                n = n * 1103515245u + 12345u;
+                text[i] = letters[(n >> 16) % 4];
+            }
+            text[textLength] = L'\0';
+            if (RegexMatch(&regex, text, textLength) != ReferenceMatch(pattern, text)) mismatches++;
+        }
+        RegexFree(&regex);
+    }
+    CHECK(mismatches == 0);
+
+    // Literal patterns agree with the substring search
+    static const wchar_t* const texts[] = { L"Hello World", L"hello-world", L"WORLD", L"", L"lo W" };
+    static const wchar_t* const literals[] = { L"hello", L"o w", L"world", L"lo", L"xyz", L"H" };
+    for (size_t t = 0; t < sizeof(texts) / sizeof(texts[0]); ++t) {
+        for (size_t l = 0; l < sizeof(literals) / sizeof(literals[0]); ++l) {
+            bool expected = TextFindNoCase(texts[t], wcslen(texts[t]), literals[l], wcslen(literals[l])) != NULL;
+            CHECK((Match(literals[l], texts[t]) == 1) == expected);
+        }
+    }
+}
+
+static void
+TestRegexBudget(void)
+{
+    // Matching 'a' 13 characters from the end needs a DFA state per 13-character
+    // window: far past the budget. The DFA is flushed and rebuilt as it goes,
+    // and gives the same answers.
+    Regex regex;
+    CHECK(RegexCompile(&regex, L"a(a|b){12}$", 11) == REGEX_OK);
+    enum { TEXT = 20000 };
+    static wchar_t text[TEXT];
+    unsigned n = 7;
+    for (size_t i = 0; i < TEXT; ++i) {
+        n = n * 1103515245u + 12345u;
+        text[i] = (n >> 16) & 1 ? L'a' : L'b';
+    }
+    size_t mismatches = 0;
+    for (size_t length = 13; length <= TEXT; length += 101) {
+        if (RegexMatch(&regex, text, length) != (text[length - 13] == L'a')) mismatches++;
+    }
+    CHECK(mismatches == 0);
+    CHECK(regex.dfa.flushes > 0);
+    CHECK(regex.dfa.count <= regex.dfa.capacity);
+    RegexFree(&regex);
+
+    // Nested repetition stays linear: no backtracking
+    CHECK(RegexCompile(&regex, L"(x+x+)+y", 8) == REGEX_OK);
+    for (size_t i = 0; i < TEXT; ++i) text[i] = L'x';
+    CHECK(!RegexMatch(&regex, text, TEXT));
+    text[TEXT - 1] = L'y';
+    CHECK(RegexMatch(&regex, text, TEXT));
+    CHECK(regex.dfa.flushes == 0);
+    RegexFree(&regex);
+}
+
+static void
+TestRegexCache(void)
+{
+    RegexCache cache;
+    RegexError error = REGEX_OK;
+    RegexCacheInit(&cache);
+
+    Regex* first = RegexCacheGet(&cache, L"ab+c", 4, &error);
+    CHECK(first && error == REGEX_OK && cache.misses == 1);
+    CHECK(RegexCacheGet(&cache, L"ab+c", 4, &error) == first && cache.hits == 1);
+    CHECK(RegexCacheGet(&cache, L"(", 1, &error) == NULL && error == REGEX_ERROR_SYNTAX);
+
+    // The least recently used pattern is evicted
+    wchar_t pattern[8];
+    for (int i = 0; i < REGEX_CACHE_SIZE; ++i) {
+        swprintf(pattern, 8, L"p%d", i);
+        CHECK(RegexCacheGet(&cache, pattern, wcslen(pattern), &error) != NULL);
+        if (i == 0) CHECK(RegexCacheGet(&cache, L"ab+c", 4, &error) == first); // Used again: kept longer
+    }
+    size_t misses = cache.misses;
+    CHECK(RegexCacheGet(&cache, L"ab+c", 4, &error) == first && cache.misses == misses);
+    CHECK(RegexCacheGet(&cache, L"p0", 2, &error) != NULL && cache.misses == misses + 1);
+    RegexCacheFree(&cache);
+}
+
+static bool
+CollectIndex(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry;
+    size_t* indices = context;
+    indices[++indices[0]] = index;
+    return true;
+}
+
+static void
+TestRegexSearch(void)
+{
+    History history;
+    SearchState search;
+    ResultView view;
+    CHECK(HistoryInit(&history, 64));
+    SearchInit(&search);
+    ResultViewInit(&view);
+
+    HistoryAdd(&history, L"server at 10.0.0.12 is down");   // index 4
+    HistoryAdd(&history, L"see JIRA-1234 for details");     // index 3
+    HistoryAdd(&history, L"sha 9f86d081884c7d659a2feaa0"); // index 2
+    HistoryAdd(&history, L"jira-99 is a duplicate");        // index 1
+    HistoryAdd(&history, L"nothing to see here");           // index 0
+
+    size_t indices[8] = {0};
+    CHECK(SearchRunRegex(&search, &history, L"\\bjira-\\d{2,}\\b", CollectIndex, indices) == 2);
+    CHECK(indices[0] == 2 && indices[1] == 1 && indices[2] == 3); // Newest first
+    CHECK(search.lastRegexError == REGEX_OK && search.lastTested == 5);
+
+    memset(indices, 0, sizeof(indices));
+    CHECK(SearchRunRegex(&search, &history, L"(\\d{1,3}\\.){3}\\d{1,3}", CollectIndex, indices) == 1);
+    CHECK(indices[1] == 4);
+    CHECK(SearchRunRegex(&search, &history, L"[", CollectIndex, indices) == 0);
+    CHECK(search.lastRegexError == REGEX_ERROR_SYNTAX);
+
+    // A substring query after a regex one does not refine its hits
+    CHECK(SearchRunRegex(&search, &history, L"see", CollectIndex, indices) == 2);
+    memset(indices, 0, sizeof(indices));
+    CHECK(SearchRun(&search, &history, L"see j", CollectIndex, indices) == 1 && !search.lastRefined);
+
+    // The view runs regexes behind the '/' prefix; bad patterns show nothing
+    CHECK(ResultViewRefresh(&view, &search, &history, L"/[0-9a-f]{16,}"));
+    CHECK(ResultViewCount(&view) == 1 && ResultViewGet(&view, &history, 0) == HistoryGet(&history, 2));
+    CHECK(ResultViewRefresh(&view, &search, &history, L"/jira|sha"));
+    CHECK(ResultViewCount(&view) == 3 && ResultViewGet(&view, &history, 2) == HistoryGet(&history, 1));
+    CHECK(ResultViewRefresh(&view, &search, &history, L"/(unclosed"));
+    CHECK(ResultViewCount(&view) == 0);
+    CHECK(ResultViewRefresh(&view, &search, &history, L"/"));
+    CHECK(ResultViewCount(&view) == HistoryCount(&history));
+
+    ResultViewFree(&view);
+    SearchFree(&search);
+    HistoryFree(&history);
+}
+
+void
+TestRegex(void)
+{
+    TestRegexSyntax();
+    TestRegexAgainstReference();
+    TestRegexBudget();
+    TestRegexCache();
+    TestRegexSearch();
+}
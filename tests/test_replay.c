@@ -0,0 +1,112 @@
+#include "test.h"
+#include "replay.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void
+TestReplayTraces(void)
+{
+    ReplayTraceSpec spec = { "test", 2000, 10, 5000, 0.1, 4096, 0.5, 10, 15, 1000, 0.2, 40, 7 };
+    ReplayTrace first, second;
+    CHECK(ReplayTraceGenerate(&first, &spec));
+    CHECK(ReplayTraceGenerate(&second, &spec));
+    CHECK(first.count == 2000 && second.count == 2000);
+    CHECK(memcmp(first.events, second.events, first.count * sizeof(ReplayEvent)) == 0); // Deterministic
+
+    // The trace has the shape asked for
+    size_t repeats = 0, images = 0, busy = 0;
+    uint32_t newest = 0;
+    bool sizesOk = true, timingOk = true;
+    for (size_t i = 0; i < first.count; ++i) {
+        const ReplayEvent* event = &first.events[i];
+        if (event->contentId <= newest) {
+            repeats++;
+        } else {
+            newest = event->contentId;
+            if (event->formatBytes > 0) images++; // Among new contents
+        }
+        if (event->busyMs > 0) busy++;
+        if (event->formatBytes == 0 && (event->textChars < 10 || event->textChars > 5000)) sizesOk = false;
+        if (i > 0) {
+            uint64_t gap = event->atNs - first.events[i - 1].atNs;
+            if (gap != (i % 10 == 0 ? 1000 : 15) * 1000000ull) timingOk = false;
+        }
+    }
+    CHECK(sizesOk && timingOk);
+    CHECK(repeats > 900 && repeats < 1100);
+    CHECK(images > 50 && images < 150);
+    CHECK(newest == first.count - repeats);
+    CHECK(busy > 320 && busy < 480);
+
+    // Saved and loaded back unchanged
+    char path[512];
+    const char* tmp = getenv("TMPDIR");
+    snprintf(path, sizeof(path), "%s/mclip_trace_%d.txt", tmp ? tmp : "/tmp", (int)getpid());
+    CHECK(ReplayTraceSave(&first, path));
+    ReplayTraceFree(&second);
+    CHECK(ReplayTraceLoad(&second, path));
+    CHECK(second.count == first.count && memcmp(first.events, second.events, first.count * sizeof(ReplayEvent)) == 0);
+    ReplayTraceFree(&second);
+    PlatformFileDelete(path);
+    CHECK(!ReplayTraceLoad(&second, path));
+
+    ReplayTraceFree(&first);
+    CHECK(ReplayFindTrace("burst") != NULL && ReplayFindTrace("nope") == NULL);
+
+    // Texts are as long as asked, and differ between ids even when short
+    wchar_t a[64 + REPLAY_TEXT_SLACK], b[64 + REPLAY_TEXT_SLACK];
+    CHECK(ReplayMakeText(a, 64, 3) == 64 && wcslen(a) == 64);
+    CHECK(ReplayMakeText(a, 1, 12) >= 1 && ReplayMakeText(b, 1, 13) >= 1 && wcscmp(a, b) != 0);
+}
+
+static void
+TestReplayRun(void)
+{
+    ReplayConfig config;
+    ReplayConfigDefaults(&config);
+    config.maxEntries = 64;
+    char logPath[512];
+    const char* tmp = getenv("TMPDIR");
+    snprintf(logPath, sizeof(logPath), "%s/mclip_replay_test_%d.log", tmp ? tmp : "/tmp", (int)getpid());
+    config.logPath = logPath;
+
+    // Copies 5 ms apart, some while the clipboard is held for up to 40 ms:
+    // those are retried, and some are overwritten before they can be read
+    ReplayTraceSpec spec = { "test", 500, 4, 3000, 0.05, 8192, 0.3, 50, 5, 500, 0.1, 40, 11 };
+    ReplayTrace trace;
+    CHECK(ReplayTraceGenerate(&trace, &spec));
+    static ReplayResult result;
+    CHECK(ReplayRun(&trace, &config, &result));
+    CHECK(result.events == 500);
+    CHECK(result.stored > 200 && result.stored < 500);
+    CHECK(result.attempts > 500 && result.metrics.counters[METRIC_CLIPBOARD_RETRIES] > 0);
+    CHECK(result.latency.count + result.metrics.counters[METRIC_CLIPBOARD_RETRIES] == result.attempts);
+    CHECK(result.metrics.counters[METRIC_ENTRIES_ADDED] == result.stored);
+    CHECK(result.metrics.counters[METRIC_DUPLICATES] > 0);
+    CHECK(result.metrics.counters[METRIC_EVICTIONS] == result.stored - 64);
+    CHECK(result.metrics.stages[METRIC_LOG_FLUSH].count > 0);
+    CHECK(result.workNs > 0 && result.eventsPerSec > 0 && result.peakBytes > 0);
+
+    // The log holds the text entries: reopening loads the newest of them
+    History history;
+    HistoryLog log;
+    CHECK(HistoryInit(&history, 64));
+    CHECK(HistoryLogOpen(&log, logPath, &history) == HISTORY_LOG_OK);
+    CHECK(log.loaded > 0 && log.loaded <= 64);
+    HistoryFree(&history);
+    HistoryLogClose(&log);
+    char indexPath[520];
+    snprintf(indexPath, sizeof(indexPath), "%s.idx", logPath);
+    PlatformFileDelete(logPath);
+    PlatformFileDelete(indexPath);
+    ReplayTraceFree(&trace);
+}
+
+void
+TestReplay(void)
+{
+    TestReplayTraces();
+    TestReplayRun();
+}
@@ -0,0 +1,96 @@
+#include "test.h"
+#include "../code/resultview.h"
+
+#include <wchar.h>
+
+static bool
+RowIs(const ResultView* view, const History* history, size_t row, const wchar_t* text)
+{
+    const HistoryEntry* entry = ResultViewGet(view, history, row);
+    return entry != NULL && wcscmp(HistoryEntryText(history, entry), text) == 0;
+}
+
+void
+TestResultView(void)
+{
+    History history;
+    SearchState search;
+    ResultView view;
+    CHECK(HistoryInit(&history, 4));
+    SearchInit(&search);
+    ResultViewInit(&view);
+
+    // Empty history
+    CHECK(ResultViewRefresh(&view, &search, &history, NULL));
+    CHECK(ResultViewCount(&view) == 0);
+    CHECK(ResultViewGet(&view, &history, 0) == NULL);
+
+    HistoryAdd(&history, L"alpha");
+    HistoryAdd(&history, L"beta");
+    HistoryAdd(&history, L"alphabet");
+
+    // Unfiltered: oldest at the top, newest at the bottom
+    CHECK(ResultViewRefresh(&view, &search, &history, L""));
+    CHECK(ResultViewCount(&view) == 3);
+    CHECK(RowIs(&view, &history, 0, L"alpha"));
+    CHECK(RowIs(&view, &history, 1, L"beta"));
+    CHECK(RowIs(&view, &history, 2, L"alphabet"));
+    CHECK(ResultViewGet(&view, &history, 3) == NULL);
+
+    // Filtered rows keep the same order
+    CHECK(ResultViewRefresh(&view, &search, &history, L"ALPHA"));
+    CHECK(ResultViewCount(&view) == 2);
+    CHECK(RowIs(&view, &history, 0, L"alpha"));
+    CHECK(RowIs(&view, &history, 1, L"alphabet"));
+
+    CHECK(ResultViewRefresh(&view, &search, &history, L"alphab"));
+    CHECK(search.lastRefined);
+    CHECK(ResultViewCount(&view) == 1);
+    CHECK(RowIs(&view, &history, 0, L"alphabet"));
+
+    CHECK(ResultViewRefresh(&view, &search, &history, L"zzz"));
+    CHECK(ResultViewCount(&view) == 0);
+
+    // Rows survive inserts until the next refresh; evicted entries read as NULL
+    CHECK(ResultViewRefresh(&view, &search, &history, L"a"));
+    CHECK(ResultViewCount(&view) == 3);
+    HistoryAdd(&history, L"gamma");
+    HistoryAdd(&history, L"delta");
+    CHECK(ResultViewGet(&view, &history, 0) == NULL);
+    CHECK(RowIs(&view, &history, 1, L"beta"));
+    CHECK(RowIs(&view, &history, 2, L"alphabet"));
+
+    CHECK(ResultViewRefresh(&view, &search, &history, NULL));
+    CHECK(ResultViewCount(&view) == 4);
+    HistoryAdd(&history, L"epsilon");
+    CHECK(ResultViewGet(&view, &history, 0) == NULL);
+    CHECK(RowIs(&view, &history, 3, L"delta"));
+
+    // A re-copied entry moves to the bottom
+    CHECK(HistoryAdd(&history, L"Gamma") == HISTORY_DUPLICATE);
+    CHECK(ResultViewRefresh(&view, &search, &history, NULL));
+    CHECK(!view.unfiltered && ResultViewCount(&view) == 4);
+    CHECK(RowIs(&view, &history, 1, L"delta"));
+    CHECK(RowIs(&view, &history, 2, L"epsilon"));
+    CHECK(RowIs(&view, &history, 3, L"gamma"));
+
+    // Most used at the bottom, then the most recent
+    HistoryAdd(&history, L"delta");
+    HistoryAdd(&history, L"gamma");
+    view.order = HISTORY_ORDER_FREQUENT;
+    CHECK(ResultViewRefresh(&view, &search, &history, L""));
+    CHECK(ResultViewCount(&view) == 4);
+    CHECK(RowIs(&view, &history, 0, L"alphabet"));
+    CHECK(RowIs(&view, &history, 1, L"epsilon"));
+    CHECK(RowIs(&view, &history, 2, L"delta"));
+    CHECK(RowIs(&view, &history, 3, L"gamma"));
+    CHECK(ResultViewRefresh(&view, &search, &history, L"L"));
+    CHECK(ResultViewCount(&view) == 3);
+    CHECK(RowIs(&view, &history, 0, L"alphabet"));
+    CHECK(RowIs(&view, &history, 1, L"epsilon"));
+    CHECK(RowIs(&view, &history, 2, L"delta"));
+
+    ResultViewFree(&view);
+    SearchFree(&search);
+    HistoryFree(&history);
+}
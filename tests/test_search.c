@@ -0,0 +1,99 @@
+#include "test.h"
+#include "../code/search.h"
+
+#include <string.h>
+
+typedef struct {
+    size_t indices[64];
+    size_t count;
+} Collected;
+
+static bool
+Collect(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry;
+    Collected* out = context;
+    out->indices[out->count++] = index;
+    return true;
+}
+
+static bool
+StopImmediately(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry; (void)index; (void)context;
+    return false;
+}
+
+// SearchRun must always agree with a plain full scan
+static bool
+SameAsFullScan(SearchState* search, const History* history, const wchar_t* query)
+{
+    Collected incremental = {0}, full = {0};
+    SearchRun(search, history, query, Collect, &incremental);
+    HistoryForEachMatch(history, query, Collect, &full);
+    return incremental.count == full.count &&
+           memcmp(incremental.indices, full.indices, full.count * sizeof(size_t)) == 0;
+}
+
+void
+TestSearch(void)
+{
+    History history;
+    SearchState search;
+    CHECK(HistoryInit(&history, 32));
+    SearchInit(&search);
+
+    HistoryAdd(&history, L"git commit -m fix");
+    HistoryAdd(&history, L"git checkout main");
+    HistoryAdd(&history, L"https://github.com");
+    HistoryAdd(&history, L"GIT CHERRY-PICK abc");
+    HistoryAdd(&history, L"make test");
+
+    // First query scans everything
+    CHECK(SameAsFullScan(&search, &history, L"g"));
+    CHECK(!search.lastRefined);
+    CHECK(search.lastTested == 5);
+
+    // Extending the query only re-tests previous hits
+    CHECK(SameAsFullScan(&search, &history, L"gi"));
+    CHECK(search.lastRefined);
+    CHECK(search.lastTested == 4);
+    CHECK(SameAsFullScan(&search, &history, L"git c"));
+    CHECK(search.lastRefined && search.lastTested == 4);
+    CHECK(SameAsFullScan(&search, &history, L"Git Che"));
+    CHECK(search.lastRefined && search.lastTested == 3);
+    CHECK(search.hitCount == 2);
+
+    // Backspace (query no longer contains the previous one) forces a full scan
+    CHECK(SameAsFullScan(&search, &history, L"git ch"));
+    CHECK(!search.lastRefined && search.lastTested == 5);
+
+    // New entries change the generation and invalidate the cache
+    HistoryAdd(&history, L"git cherry");
+    CHECK(SameAsFullScan(&search, &history, L"git che"));
+    CHECK(!search.lastRefined);
+
+    // Empty query matches everything and can be refined from
+    CHECK(SameAsFullScan(&search, &history, L""));
+    CHECK(SameAsFullScan(&search, &history, NULL));
+    CHECK(search.hitCount == 6);
+    CHECK(SameAsFullScan(&search, &history, L"make"));
+    CHECK(search.lastRefined);
+
+    // A visitor that stops early leaves no partial cache behind
+    CHECK(SearchRun(&search, &history, L"git", StopImmediately, NULL) == 1);
+    CHECK(search.query == NULL);
+    CHECK(SameAsFullScan(&search, &history, L"git c"));
+    CHECK(!search.lastRefined);
+
+    // A re-copy moves its entry up: hits follow, refined ones included
+    CHECK(HistoryAdd(&history, L"git checkout MAIN") == HISTORY_DUPLICATE);
+    CHECK(SameAsFullScan(&search, &history, L"git"));
+    CHECK(!search.lastRefined);
+    CHECK(SameAsFullScan(&search, &history, L"git ch"));
+    CHECK(search.lastRefined && search.hitCount == 3);
+    CHECK(search.hits[0].index == 0 && search.hits[0].seq == HistoryGet(&history, 0)->seq);
+
+    SearchFree(&search);
+    HistoryFree(&history);
+}
@@ -0,0 +1,171 @@
+#include "test.h"
+#include "../code/searchworker.h"
+
+#include <string.h>
+
+static volatile int32_t g_notifications;
+static volatile int32_t g_painterLocked;   // 1 if the painter got the history, -1 if not
+
+static void
+CountNotification(void* context)
+{
+    (void)context;
+    PlatformAtomicStore(&g_notifications, PlatformAtomicLoad(&g_notifications) + 1);
+}
+
+// Spins until the worker has taken up the submitted query
+static void
+WaitUntilRunning(SearchWorker* worker)
+{
+    for (;;) {
+        PlatformLockAcquire(worker->state);
+        bool running = worker->running;
+        PlatformLockRelease(worker->state);
+        if (running) return;
+    }
+}
+
+static void
+WaitUntilPreempting(SearchWorker* worker)
+{
+    for (;;) {
+        PlatformLockAcquire(worker->state);
+        size_t preempting = worker->preempting;
+        PlatformLockRelease(worker->state);
+        if (preempting > 0) return;
+    }
+}
+
+typedef struct {
+    SearchWorker* worker;
+    History* history;
+} AddContext;
+
+// Helper thread: adds an entry the way the UI does, through a preempting lock
+static void
+AddThroughPreemptingLock(void* context)
+{
+    AddContext* add = context;
+    SearchWorkerLockHistory(add->worker, true);
+    HistoryAdd(add->history, L"needle added while searching");
+    SearchWorkerUnlockHistory(add->worker, true);
+}
+
+// Helper thread: paints the way the UI does, giving up if the history is held
+static void
+TryLockFromPainter(void* context)
+{
+    SearchWorker* worker = context;
+    bool locked = SearchWorkerTryLockHistory(worker);
+    if (locked) SearchWorkerUnlockHistory(worker, false);
+    PlatformAtomicStore(&g_painterLocked, locked ? 1 : -1);
+}
+
+void
+TestSearchWorker(void)
+{
+    History history;
+    SearchWorker worker;
+    ResultView view;
+    uint64_t id = 0;
+    CHECK(HistoryInit(&history, 4096));
+    ResultViewInit(&view);
+
+    wchar_t text[64];
+    for (int i = 0; i < 4096; ++i) {
+        swprintf(text, 64, L"entry %d %ls", i, i % 10 == 0 ? L"needle" : L"hay");
+        HistoryAdd(&history, text);
+    }
+
+    // Results arrive through notify and match a synchronous refresh
+    g_notifications = 0;
+    CHECK(SearchWorkerStart(&worker, &history, CountNotification, NULL));
+    uint64_t first = SearchWorkerSubmit(&worker, L"needle");
+    SearchWorkerWaitIdle(&worker);
+    CHECK(PlatformAtomicLoad(&g_notifications) == 1);
+    CHECK(SearchWorkerTakeResults(&worker, &view, &id) && id == first);
+    CHECK(ResultViewCount(&view) == 410);
+    CHECK(!SearchWorkerTakeResults(&worker, &view, NULL)); // Taken once
+    CHECK(worker.completed == 1 && worker.cancelled == 0);
+
+    // Extending the query refines on the worker's own search state
+    SearchWorkerSubmit(&worker, L"needle ");
+    SearchWorkerWaitIdle(&worker);
+    CHECK(worker.search.lastRefined);
+    CHECK(SearchWorkerTakeResults(&worker, &view, NULL) && ResultViewCount(&view) == 0);
+
+    // Only the latest of several queued queries is searched and delivered
+    SearchWorkerLockHistory(&worker, false); // Hold the worker off while queueing
+    SearchWorkerSubmit(&worker, L"entry 1");
+    WaitUntilRunning(&worker);
+    SearchWorkerSubmit(&worker, L"entry 2");
+    uint64_t last = SearchWorkerSubmit(&worker, L"~ntr 409");
+    SearchWorkerUnlockHistory(&worker, false);
+    SearchWorkerWaitIdle(&worker);
+    CHECK(SearchWorkerTakeResults(&worker, &view, &id) && id == last);
+    CHECK(view.ranked && ResultViewCount(&view) > 0);
+    CHECK(worker.cancelled == 1 && worker.completed == 3); // "entry 1" was cancelled, "entry 2" skipped
+
+    // Finished searches are timed for the statistics report
+    Metrics metrics;
+    MetricsInit(&metrics, 0);
+    SearchWorkerMetrics(&worker, &metrics);
+    CHECK(metrics.stages[METRIC_SEARCH].count == 3 && metrics.counters[METRIC_SEARCHES_CANCELLED] == 1);
+
+    // Empty query: every entry
+    SearchWorkerSubmit(&worker, NULL);
+    SearchWorkerWaitIdle(&worker);
+    CHECK(SearchWorkerTakeResults(&worker, &view, NULL) && ResultViewCount(&view) == 4096);
+
+    // Painting takes the history when it is free and does not wait when it is held
+    CHECK(SearchWorkerTryLockHistory(&worker));
+    SearchWorkerUnlockHistory(&worker, false);
+    SearchWorkerLockHistory(&worker, false); // Stands in for a running search
+    PlatformThread* painter = PlatformThreadStart(TryLockFromPainter, &worker);
+    CHECK(painter != NULL);
+    if (painter) PlatformThreadJoin(painter);
+    SearchWorkerUnlockHistory(&worker, false);
+    CHECK(PlatformAtomicLoad(&g_painterLocked) == -1);
+
+    // A preempting lock cancels the running search, which is retried after the
+    // change and sees it
+    SearchWorkerLockHistory(&worker, false);
+    uint64_t needle = SearchWorkerSubmit(&worker, L"needle");
+    WaitUntilRunning(&worker);
+    AddContext add = { &worker, &history };
+    PlatformThread* adder = PlatformThreadStart(AddThroughPreemptingLock, &add);
+    CHECK(adder != NULL);
+    if (adder) {
+        WaitUntilPreempting(&worker);
+        SearchWorkerUnlockHistory(&worker, false);
+        PlatformThreadJoin(adder);
+    } else {
+        SearchWorkerUnlockHistory(&worker, false);
+    }
+    SearchWorkerWaitIdle(&worker);
+    CHECK(worker.cancelled == 2);
+    CHECK(SearchWorkerTakeResults(&worker, &view, &id) && id == needle);
+    CHECK(ResultViewCount(&view) == 410); // One needle evicted, one added
+    SearchWorkerLockHistory(&worker, false);
+    const HistoryEntry* newest = ResultViewGet(&view, &history, ResultViewCount(&view) - 1);
+    CHECK(newest && wcscmp(HistoryEntryText(&history, newest), L"needle added while searching") == 0);
+    SearchWorkerUnlockHistory(&worker, false);
+
+    // Debounce follows the measured cost: none for cheap searches, capped for expensive ones
+    CHECK(worker.lastSearchNs > 0);
+    worker.averageSearchNs = SEARCH_WORKER_INSTANT_NS / 2;
+    CHECK(SearchWorkerDebounceMs(&worker) == 0);
+    worker.averageSearchNs = 40 * 1000000ull;
+    CHECK(SearchWorkerDebounceMs(&worker) == 80);
+    worker.averageSearchNs = 5 * 1000000000ull;
+    CHECK(SearchWorkerDebounceMs(&worker) == SEARCH_WORKER_MAX_DEBOUNCE_MS);
+
+    // Stopping with a search queued or running neither hangs nor leaks
+    SearchWorkerSubmit(&worker, L"hay");
+    SearchWorkerStop(&worker);
+    CHECK(worker.thread == NULL);
+    SearchWorkerStop(&worker); // Harmless on a stopped worker
+
+    ResultViewFree(&view);
+    HistoryFree(&history);
+}
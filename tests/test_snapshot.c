@@ -0,0 +1,192 @@
+#include "test.h"
+#include "../code/snapshot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STRESS_ENTRIES 64
+#define STRESS_PUBLISHES 20000
+
+static char g_snapshotName[64];
+
+// Snapshot 'k' of the stress test: entry i has seq k * STRESS_ENTRIES + i,
+// 'k' uses and text "k/i", so a read mixing two snapshots shows
+static void
+StressText(uint32_t k, uint32_t i, wchar_t* text, size_t size)
+{
+    swprintf(text, size, L"%u/%u", k, i);
+}
+
+typedef struct {
+    SnapshotWriter* writer;
+    volatile int32_t done;
+} StressContext;
+
+static void
+PublishContinuously(void* context)
+{
+    StressContext* stress = context;
+    wchar_t text[32];
+    for (uint32_t k = 1; k <= STRESS_PUBLISHES; ++k) {
+        SnapshotWriterBegin(stress->writer, k, 0, STRESS_ENTRIES);
+        for (uint32_t i = 0; i < STRESS_ENTRIES; ++i) {
+            StressText(k, i, text, 32);
+            SnapshotWriterAdd(stress->writer, k * STRESS_ENTRIES + i, k, text, wcslen(text));
+        }
+        SnapshotWriterCommit(stress->writer);
+    }
+    PlatformAtomicStore(&stress->done, 1);
+}
+
+// Reads the whole snapshot; true if it validated, with *consistent telling
+// whether every entry came from the snapshot its header announced
+static bool
+ReadWholeSnapshot(const SnapshotReader* reader, bool* consistent)
+{
+    SnapshotView view;
+    if (!SnapshotReadBegin(reader, &view)) return false;
+    uint32_t k = (uint32_t)view.generation;
+    bool same = view.count == STRESS_ENTRIES;
+    char expected[32];
+    for (uint32_t i = 0; i < view.count; ++i) {
+        SnapshotEntry entry;
+        SnapshotViewEntry(&view, i, &entry);
+        const char* text = SnapshotViewText(&view, &entry);
+        snprintf(expected, sizeof(expected), "%u/%u", k, i);
+        same = same && entry.seq == k * STRESS_ENTRIES + i && entry.uses == k && text && strcmp(text, expected) == 0;
+    }
+    if (!SnapshotReadValidate(reader, &view)) return false;
+    *consistent = same;
+    return true;
+}
+
+void
+TestSnapshot(void)
+{
+    snprintf(g_snapshotName, sizeof(g_snapshotName), "mclip-test-%d", (int)getpid());
+    SnapshotWriter writer;
+    SnapshotReader reader;
+    SnapshotView view;
+    SnapshotEntry entry;
+
+    // Nothing to read until a writer creates the segment, nor until it publishes
+    CHECK(!SnapshotReaderOpen(&reader, g_snapshotName));
+    CHECK(!SnapshotWriterOpen(&writer, g_snapshotName, 64)); // Too small
+    CHECK(SnapshotWriterOpen(&writer, g_snapshotName, 64 * 1024));
+    CHECK(SnapshotReaderOpen(&reader, g_snapshotName));
+    CHECK(!SnapshotReadBegin(&reader, &view));
+
+    // Round trip, in list order, UTF-8 text
+    SnapshotWriterBegin(&writer, 7, 1, 3);
+    CHECK(SnapshotWriterAdd(&writer, 12, 3, L"newest", 6));
+    CHECK(SnapshotWriterAdd(&writer, 10, 1, L"gr\u00fc\u00dfe \u20ac", 7));
+    CHECK(SnapshotWriterAdd(&writer, 4, 2, NULL, 0));
+    CHECK(!SnapshotWriterAdd(&writer, 1, 1, L"past total", 10)); // Table sized for 'total'
+    SnapshotWriterCommit(&writer);
+
+    CHECK(SnapshotReadBegin(&reader, &view));
+    CHECK(view.generation == 7 && view.order == 1 && view.count == 3 && view.total == 3 && view.withText == 2);
+    CHECK(SnapshotViewEntry(&view, 0, &entry) && entry.seq == 12 && entry.uses == 3 && entry.bytes == 6);
+    CHECK(SnapshotViewText(&view, &entry) && strcmp(SnapshotViewText(&view, &entry), "newest") == 0);
+    CHECK(SnapshotViewEntry(&view, 1, &entry) && entry.seq == 10 && entry.bytes == 11);
+    CHECK(SnapshotViewText(&view, &entry) &&
+          strcmp(SnapshotViewText(&view, &entry), "gr\xc3\xbc\xc3\x9f" "e \xe2\x82\xac") == 0);
+    CHECK(SnapshotViewEntry(&view, 2, &entry) && entry.seq == 4 && entry.textOffset == SNAPSHOT_NO_TEXT);
+    CHECK(SnapshotViewText(&view, &entry) == NULL);
+    CHECK(!SnapshotViewEntry(&view, 3, &entry));
+    CHECK(SnapshotReadValidate(&reader, &view));
+
+    // One publish during a read lands in the other buffer: the read holds.
+    // A second one overwrites the buffer being read: it fails validation.
+    SnapshotWriterBegin(&writer, 8, 0, 1);
+    SnapshotWriterAdd(&writer, 13, 1, L"one more", 8);
+    SnapshotWriterCommit(&writer);
+    CHECK(SnapshotReadValidate(&reader, &view));
+    SnapshotWriterBegin(&writer, 9, 0, 0);
+    CHECK(!SnapshotReadValidate(&reader, &view)); // Already while it is being written
+    SnapshotWriterCommit(&writer);
+    CHECK(!SnapshotReadValidate(&reader, &view));
+    CHECK(SnapshotReadBegin(&reader, &view) && view.generation == 9 && view.count == 0);
+    CHECK(SnapshotReadValidate(&reader, &view));
+    CHECK(writer.header->publishes == 3);
+
+    // Texts that do not fit are left out, smaller ones after them still go in
+    size_t big = 20 * 1024; // One fits in a 32 KB buffer, two do not
+    wchar_t* text = malloc((big + 1) * sizeof(wchar_t));
+    CHECK(text != NULL);
+    if (text) {
+        wmemset(text, L'x', big);
+        text[big] = L'\0';
+        SnapshotWriterBegin(&writer, 10, 0, 3);
+        CHECK(SnapshotWriterTextFits(&writer, big));
+        CHECK(SnapshotWriterAdd(&writer, 1, 1, text, big));
+        CHECK(!SnapshotWriterTextFits(&writer, big));
+        CHECK(SnapshotWriterAdd(&writer, 2, 1, text, big));
+        CHECK(SnapshotWriterAdd(&writer, 3, 1, L"small", 5));
+        SnapshotWriterCommit(&writer);
+        CHECK(SnapshotReadBegin(&reader, &view) && view.count == 3 && view.withText == 2);
+        CHECK(SnapshotViewEntry(&view, 0, &entry) && entry.bytes == big && SnapshotViewText(&view, &entry));
+        CHECK(SnapshotViewEntry(&view, 1, &entry) && !SnapshotViewText(&view, &entry));
+        CHECK(SnapshotViewEntry(&view, 2, &entry) && SnapshotViewText(&view, &entry));
+        free(text);
+    }
+
+    // A table larger than the buffer holds as many entries as fit
+    SnapshotWriterBegin(&writer, 11, 0, 1000000);
+    uint32_t added = 0;
+    while (SnapshotWriterAdd(&writer, added, 1, NULL, 0)) added++;
+    SnapshotWriterCommit(&writer);
+    CHECK(added > 1000 && added < 1000000);
+    CHECK(SnapshotReadBegin(&reader, &view) && view.count == added && view.total == 1000000);
+
+    // Bad offsets and lengths in the segment never point readers outside it
+    SnapshotWriterBegin(&writer, 12, 0, 1);
+    SnapshotWriterAdd(&writer, 1, 1, L"text", 4);
+    SnapshotWriterCommit(&writer);
+    CHECK(SnapshotReadBegin(&reader, &view) && SnapshotViewEntry(&view, 0, &entry));
+    SnapshotEntry bad = entry;
+    bad.textOffset = (uint32_t)view.capacity;
+    CHECK(SnapshotViewText(&view, &bad) == NULL);
+    bad.textOffset = 3;
+    CHECK(SnapshotViewText(&view, &bad) == NULL);
+    bad = entry;
+    bad.bytes = UINT32_MAX;
+    CHECK(SnapshotViewText(&view, &bad) == NULL);
+    bad.bytes = entry.bytes - 1; // No terminator there
+    CHECK(SnapshotViewText(&view, &bad) == NULL);
+    SnapshotContents* contents = (SnapshotContents*)((uint8_t*)writer.header + writer.header->slots[view.slot].offset);
+    contents->count = UINT32_MAX;
+    CHECK(SnapshotReadBegin(&reader, &view) && view.count < view.capacity / sizeof(SnapshotEntry));
+    SnapshotReaderClose(&reader);
+
+    // Other versions are refused
+    writer.header->version = SNAPSHOT_VERSION + 1;
+    CHECK(!SnapshotReaderOpen(&reader, g_snapshotName));
+    writer.header->version = SNAPSHOT_VERSION;
+    SnapshotWriterClose(&writer);
+    CHECK(!SnapshotReaderOpen(&reader, g_snapshotName)); // The writer removed it
+
+    // A reader racing a writer that publishes as fast as it can: reads that
+    // validate are never a mix of two snapshots
+    CHECK(SnapshotWriterOpen(&writer, g_snapshotName, 64 * 1024));
+    CHECK(SnapshotReaderOpen(&reader, g_snapshotName));
+    StressContext stress = { &writer, 0 };
+    PlatformThread* thread = PlatformThreadStart(PublishContinuously, &stress);
+    CHECK(thread != NULL);
+    size_t validated = 0, mixed = 0;
+    while (thread && !PlatformAtomicLoad(&stress.done)) {
+        bool consistent = false;
+        if (!ReadWholeSnapshot(&reader, &consistent)) continue;
+        validated++;
+        if (!consistent) mixed++;
+    }
+    if (thread) PlatformThreadJoin(thread);
+    bool consistent = false;
+    CHECK(ReadWholeSnapshot(&reader, &consistent) && consistent);
+    CHECK(mixed == 0);
+    CHECK(validated > 0 || !thread);
+    SnapshotReaderClose(&reader);
+    SnapshotWriterClose(&writer);
+}
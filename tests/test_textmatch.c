@@ -0,0 +1,117 @@
+#include "test.h"
+#include "../code/textmatch.h"
+#include "../code/utf8.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Alphabet mixing ASCII letters of both cases with characters the vector
+// kernels cannot fold in-register
+static const wchar_t g_alphabet[] = {
+    L'a', L'b', L'A', L'B', L'c', L' ', L'-', L'1',
+    0x00C9, 0x00E9,  // E acute, upper/lower
+    0x212A,          // KELVIN SIGN, folds to 'k'
+    L'k', L'K', 0x0416, 0x0436, 0x4E2D
+};
+
+static void
+RandomText(wchar_t* out, size_t length, unsigned* state)
+{
+    for (size_t i = 0; i < length; ++i) {
+        *state = *state * 1103515245u + 12345u;
+        out[i] = g_alphabet[(*state >> 16) % (sizeof(g_alphabet) / sizeof(g_alphabet[0]))];
+    }
+    out[length] = L'\0';
+}
+
+// Dispatching kernels must agree with the scalar reference at every SIMD level
+static void
+CompareWithScalar(TextSimdLevel level)
+{
+    TextSetSimdLevel(level);
+
+    unsigned state = 42;
+    wchar_t hay[200], needle[12];
+    char utf8[800];
+    bool findAgrees = true, equalsAgrees = true, utf8Agrees = true;
+
+    for (int round = 0; round < 20000; ++round) {
+        size_t hayLen = (size_t)(round % 97) + (round % 5 == 0 ? 100 : 0);
+        size_t needleLen = 1 + (size_t)(round % 7);
+        RandomText(hay, hayLen, &state);
+        RandomText(needle, needleLen, &state);
+
+        // Plant the needle (with flipped case) half of the time
+        if (hayLen >= needleLen && round % 2) {
+            size_t at = (size_t)(state % (hayLen - needleLen + 1));
+            for (size_t j = 0; j < needleLen; ++j) {
+                wchar_t c = needle[j];
+                hay[at + j] = (c >= L'a' && c <= L'z') ? (wchar_t)(c - 32) : (c == L'k' ? 0x212A : c);
+            }
+        }
+
+        const wchar_t* expected = TextFindNoCaseScalar(hay, hayLen, needle, needleLen);
+        findAgrees = findAgrees && TextFindNoCase(hay, hayLen, needle, needleLen) == expected;
+
+        // The same search in UTF-8, with the needle's non-ASCII-folding
+        // characters replaced: it must stop at the same character
+        for (size_t j = 0; j < needleLen; ++j) {
+            if (TextFoldChar(needle[j]) >= 0x80) needle[j] = L'b';
+        }
+        size_t size = Utf8Encode(hay, hayLen, utf8);
+        expected = TextFindNoCaseScalar(hay, hayLen, needle, needleLen);
+        const char* found = TextFindNoCaseUtf8(utf8, size, needle, needleLen);
+        utf8Agrees = utf8Agrees && TextFoldsToAscii(needle, needleLen) &&
+                     found == TextFindNoCaseUtf8Scalar(utf8, size, needle, needleLen) &&
+                     (found ? expected && (size_t)(found - utf8) == Utf8EncodedSize(hay, (size_t)(expected - hay))
+                            : !expected);
+
+        // Equality against a case-flipped copy and against a one-character change
+        wchar_t other[200];
+        for (size_t i = 0; i < hayLen; ++i) {
+            wchar_t c = hay[i];
+            other[i] = (c >= L'a' && c <= L'z') ? (wchar_t)(c - 32) : (c == 0x00E9 ? 0x00C9 : c);
+        }
+        equalsAgrees = equalsAgrees &&
+            TextEqualsNoCase(hay, hayLen, other, hayLen) == TextEqualsNoCaseScalar(hay, hayLen, other, hayLen);
+        if (hayLen > 0) {
+            other[state % hayLen] = L'#';
+            equalsAgrees = equalsAgrees &&
+                TextEqualsNoCase(hay, hayLen, other, hayLen) == TextEqualsNoCaseScalar(hay, hayLen, other, hayLen);
+        }
+    }
+    CHECK(findAgrees);
+    CHECK(equalsAgrees);
+    CHECK(utf8Agrees);
+}
+
+void
+TestTextMatchKernels(void)
+{
+    TextSimdLevel best = TextSetSimdLevel(TEXT_SIMD_AUTO);
+    CHECK(TextGetSimdLevel() == best);
+
+    CompareWithScalar(TEXT_SIMD_NONE);
+    CompareWithScalar(TEXT_SIMD_SSE2);
+    CompareWithScalar(TEXT_SIMD_AVX2);
+
+    // Cannot raise above what the CPU supports
+    CHECK(TextSetSimdLevel(TEXT_SIMD_AVX2) <= best);
+
+    // Kelvin sign in the haystack matches ASCII 'k' in the needle
+    const wchar_t hay[] = L"0123456789abcdefghij\x212A" L"elvin";
+    CHECK(TextFindNoCase(hay, wcslen(hay), L"KELVIN", 6) == hay + 20);
+    CHECK(TextEqualsNoCase(L"\x212A\x00C9", 2, L"k\x00E9", 2));
+
+    // UTF-8: the Kelvin sign is decoded, and matches start on characters
+    const char kelvin[] = "0123456789abcdefghij\xE2\x84\xAA" "elvin, \xF0\x9F\x98\x80 KELVIN";
+    CHECK(TextFindNoCaseUtf8(kelvin, strlen(kelvin), L"kelvin", 6) == kelvin + 20);
+    CHECK(TextFindNoCaseUtf8(kelvin, strlen(kelvin), L"\x212A" L"ELVIN,", 7) == kelvin + 20);
+    CHECK(TextFindNoCaseUtf8(kelvin, strlen(kelvin), L" kelvin", 7) == kelvin + strlen(kelvin) - 7);
+    CHECK(TextFindNoCaseUtf8(kelvin, 21, L"k", 1) == NULL); // Cut inside the sequence
+    CHECK(TextFindNoCaseUtf8("\xC3\xA9t\xC3\xA9", 5, L"t", 1) != NULL);
+    CHECK(TextFindNoCaseUtf8("\xE2\x84\xAA", 3, L"k", 1) != NULL && TextFindNoCaseUtf8("\x84\xAA", 2, L"k", 1) == NULL);
+    CHECK(TextFoldsToAscii(L"Kelvin \x212A", 8) && !TextFoldsToAscii(L"caf\x00E9", 4));
+
+    TextSetSimdLevel(TEXT_SIMD_AUTO);
+}
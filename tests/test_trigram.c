@@ -0,0 +1,150 @@
+#include "test.h"
+#include "../code/history.h"
+#include "../code/textmatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    size_t indices[512];
+    size_t count;
+} Collected;
+
+static bool
+Collect(const HistoryEntry* entry, size_t index, void* context)
+{
+    (void)entry;
+    Collected* out = context;
+    if (out->count < 512) out->indices[out->count] = index;
+    out->count++;
+    return true;
+}
+
+// Brute-force oracle: plain scan over every entry
+static void
+Oracle(const History* history, const wchar_t* query, Collected* out)
+{
+    for (size_t i = 0; i < HistoryCount(history); ++i) {
+        const HistoryEntry* entry = HistoryGet(history, i);
+        if (wcslen(query) == 0 || TextFindNoCase(HistoryEntryText(history, entry), entry->length, query, wcslen(query))) {
+            Collect(entry, i, out);
+        }
+    }
+}
+
+static void
+TestTrigramQueries(void)
+{
+    TrigramIndex index;
+    CHECK(TrigramInit(&index));
+    CHECK(TrigramAdd(&index, 0, L"hello world", 11));
+    CHECK(TrigramAdd(&index, 1, L"HELLO there", 11));
+    CHECK(TrigramAdd(&index, 2, L"yellow", 6));
+    CHECK(TrigramAdd(&index, 3, L"ab", 2));           // Too short to index
+    CHECK(TrigramAdd(&index, 4, L"aaaaaa", 6));       // Repeated trigram listed once
+
+    uint32_t* ids;
+    size_t count;
+    CHECK(TrigramQuery(&index, L"Hello", 5, &ids, &count));
+    CHECK(count == 2 && ids[0] == 0 && ids[1] == 1);
+    free(ids);
+
+    CHECK(TrigramQuery(&index, L"ello", 4, &ids, &count));
+    CHECK(count == 3 && ids[2] == 2);
+    free(ids);
+
+    CHECK(TrigramQuery(&index, L"aaaa", 4, &ids, &count));
+    CHECK(count == 1 && ids[0] == 4);
+    free(ids);
+
+    CHECK(TrigramQuery(&index, L"xyz", 3, &ids, &count));
+    CHECK(count == 0 && ids == NULL);
+    CHECK(!TrigramQuery(&index, L"he", 2, &ids, &count));
+
+    // Removing the oldest entry trims it from the front of its lists
+    TrigramRemove(&index, 0, L"hello world", 11);
+    CHECK(TrigramQuery(&index, L"hello", 5, &ids, &count));
+    CHECK(count == 1 && ids[0] == 1);
+    free(ids);
+    CHECK(TrigramQuery(&index, L"world", 5, &ids, &count));
+    CHECK(count == 0);
+    free(ids);
+
+    CHECK(TrigramMemory(&index) > 0);
+    TrigramFree(&index);
+}
+
+static void
+TestTrigramHistory(void)
+{
+    static const wchar_t* words[] = {
+        L"alpha", L"Beta", L"gamma", L"DELTA", L"epsilon", L"zeta", L"eta",
+        L"theta", L"iota", L"kappa", L"lambda", L"mu", L"\x00C9t\x00E9", L" ", L"-"
+    };
+    static const wchar_t* queries[] = {
+        L"alp", L"ALPHA beta", L"ta", L"eta", L"a g", L"kappa-", L"\x00E9t\x00E9",
+        L"zzz", L"lambda lambda", L"mu mu", L"", L"gamma DELTA"
+    };
+    const size_t wordCount = sizeof(words) / sizeof(words[0]);
+
+    History plain, indexed;
+    CHECK(HistoryInit(&plain, 300));
+    CHECK(HistoryInit(&indexed, 300));
+
+    // Index enabled part-way through, then churn well past capacity
+    srand(12345);
+    wchar_t buffer[256];
+    for (int i = 0; i < 2000; ++i) {
+        if (i == 150) CHECK(HistoryEnableTrigramIndex(&indexed, true));
+        buffer[0] = L'\0';
+        int parts = 1 + rand() % 6;
+        for (int p = 0; p < parts; ++p) {
+            wcscat(buffer, words[rand() % wordCount]);
+            if (rand() % 2) wcscat(buffer, L" ");
+        }
+        CHECK(HistoryAdd(&plain, buffer) == HistoryAdd(&indexed, buffer));
+    }
+    CHECK(HistoryCount(&indexed) == HistoryCount(&plain));
+    CHECK(indexed.reordered > 0); // Repeats moved entries up: candidates are out of sequence order
+
+    bool allAgree = true;
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); ++q) {
+        Collected expected = {0}, actual = {0};
+        Oracle(&plain, queries[q], &expected);
+        HistoryForEachMatch(&indexed, queries[q], Collect, &actual);
+        allAgree = allAgree && expected.count == actual.count &&
+                   memcmp(expected.indices, actual.indices,
+                          (expected.count < 512 ? expected.count : 512) * sizeof(size_t)) == 0;
+    }
+    CHECK(allAgree);
+
+    // Index only verifies candidates
+    HistoryScanControl control = {0};
+    Collected hits = {0};
+    HistoryScan(&indexed, L"lambda lambda", 13, Collect, &hits, &control);
+    CHECK(control.tested < HistoryCount(&indexed));
+    CHECK(control.tested >= hits.count && !control.cancelled);
+
+    // Sequence lookup
+    const HistoryEntry* newest = HistoryGet(&indexed, 0);
+    CHECK(HistoryFindSeq(&indexed, newest->seq) == newest);
+    CHECK(HistoryFindSeq(&indexed, newest->seq + 1) == NULL);
+    CHECK(HistoryFindSeq(&indexed, HistoryGet(&indexed, 299)->seq - 1) == NULL);
+
+    HistoryStats stats;
+    HistoryGetStats(&indexed, &stats);
+    CHECK(stats.trigramBytes > 0 && stats.trigramPostings > 0);
+    CHECK(HistoryEnableTrigramIndex(&indexed, false));
+    HistoryGetStats(&indexed, &stats);
+    CHECK(stats.trigramBytes == 0);
+
+    HistoryFree(&plain);
+    HistoryFree(&indexed);
+}
+
+void
+TestTrigram(void)
+{
+    TestTrigramQueries();
+    TestTrigramHistory();
+}
@@ -0,0 +1,341 @@
+// mclip_query - reads the clipboard history a running mclip publishes
+// (code/snapshot.h), for scripts and terminals.
+//
+//   mclip_query [--name NAME] list [N]        first N entries (default 20): index, uses, preview
+//   mclip_query [--name NAME] find TEXT [N]   the same for entries containing TEXT (ASCII case-insensitive)
+//   mclip_query [--name NAME] get INDEX       text of an entry, as is (UTF-8)
+//   mclip_query [--name NAME] copy INDEX      puts an entry back on the clipboard (Windows)
+//   mclip_query [--name NAME] stat            what the snapshot holds
+//
+// Entries are listed in the app's order, index 0 first (the most recent, or
+// the most used with History > Most used first). Exit status: 0 done, 1 no
+// snapshot or no such entry, 2 bad usage.
+//
+// The snapshot is read in place: nothing is copied but what is printed,
+// which is buffered until the read validates (a publish in the middle of it
+// means reading again) and only then written out.
+
+#include "../code/snapshot.h"
+#include "../code/utf8.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <time.h>
+#endif
+
+#define QUERY_DEFAULT_COUNT 20
+#define QUERY_PREVIEW_BYTES 72 // Of the text shown per listed entry
+#define QUERY_ATTEMPTS 200     // Reads tried before giving up ...
+#define QUERY_RETRY_MS 5       // ... this far apart when nothing is published
+
+typedef enum { QUERY_OK = 0, QUERY_FAILED, QUERY_USAGE } QueryStatus;
+
+typedef enum { QUERY_LIST, QUERY_FIND, QUERY_GET, QUERY_COPY, QUERY_STAT } QueryCommand;
+
+typedef struct {
+    QueryCommand command;
+    const char* text;     // find
+    size_t textLength;
+    size_t index;         // get, copy
+    size_t count;         // list, find
+} QueryArgs;
+
+// What a read prints, kept until the read validates
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+    bool failed;          // Out of memory
+    const char* error;    // Message for stderr instead, with QUERY_FAILED
+    size_t entryBytes;    // get, copy: bytes of the entry's text, at the start of 'data'
+} QueryOutput;
+
+static void
+OutputBytes(QueryOutput* out, const char* bytes, size_t size)
+{
+    if (out->failed) return;
+    if (size > out->capacity - out->size) {
+        size_t capacity = out->capacity ? out->capacity : 4096;
+        while (capacity - out->size < size) capacity *= 2;
+        char* data = realloc(out->data, capacity);
+        if (!data) {
+            out->failed = true;
+            return;
+        }
+        out->data = data;
+        out->capacity = capacity;
+    }
+    memcpy(out->data + out->size, bytes, size);
+    out->size += size;
+}
+
+static void
+OutputFormat(QueryOutput* out, const char* format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length > 0) OutputBytes(out, line, (size_t)length < sizeof(line) ? (size_t)length : sizeof(line) - 1);
+}
+
+// --- Commands ---
+
+static char
+QueryFoldAscii(char c)
+{
+    return c >= 'A' && c <= 'Z' ? (char)(c + ('a' - 'A')) : c;
+}
+
+static bool
+QueryContains(const char* text, size_t size, const char* needle, size_t needleSize)
+{
+    if (needleSize == 0) return true;
+    for (size_t i = 0; i + needleSize <= size; ++i) {
+        size_t j = 0;
+        while (j < needleSize && QueryFoldAscii(text[i + j]) == QueryFoldAscii(needle[j])) ++j;
+        if (j == needleSize) return true;
+    }
+    return false;
+}
+
+// "index <TAB> uses <TAB> preview": the start of the text on one line,
+// control characters as spaces, cut at a character boundary
+static void
+OutputListLine(QueryOutput* out, size_t index, const SnapshotEntry* entry, const char* text)
+{
+    OutputFormat(out, "%zu\t%u\t", index, entry->uses);
+    if (!text) {
+        OutputFormat(out, "(text not in snapshot)\n");
+        return;
+    }
+    size_t size = entry->bytes;
+    bool cut = size > QUERY_PREVIEW_BYTES;
+    if (cut) {
+        size = QUERY_PREVIEW_BYTES;
+        while (size > 0 && ((unsigned char)text[size] & 0xC0) == 0x80) --size;
+    }
+    char preview[QUERY_PREVIEW_BYTES];
+    for (size_t i = 0; i < size; ++i) preview[i] = (unsigned char)text[i] < 0x20 || text[i] == 0x7F ? ' ' : text[i];
+    OutputBytes(out, preview, size);
+    OutputFormat(out, cut ? "...\n" : "\n");
+}
+
+static void
+QueryRunList(const SnapshotView* view, const QueryArgs* args, QueryOutput* out)
+{
+    size_t listed = 0;
+    for (size_t i = 0; i < view->count && listed < args->count; ++i) {
+        SnapshotEntry entry;
+        SnapshotViewEntry(view, i, &entry);
+        const char* text = SnapshotViewText(view, &entry);
+        if (args->command == QUERY_FIND && (!text || !QueryContains(text, entry.bytes, args->text, args->textLength))) {
+            continue;
+        }
+        OutputListLine(out, i, &entry, text);
+        listed++;
+    }
+}
+
+static void
+QueryRunGet(const SnapshotView* view, const QueryArgs* args, QueryOutput* out)
+{
+    SnapshotEntry entry;
+    if (!SnapshotViewEntry(view, args->index, &entry)) {
+        out->error = "no such entry";
+        return;
+    }
+    const char* text = SnapshotViewText(view, &entry);
+    if (!text) {
+        out->error = "the entry's text is too large for the snapshot";
+        return;
+    }
+    OutputBytes(out, text, entry.bytes);
+    out->entryBytes = entry.bytes;
+}
+
+static void
+QueryRunStat(const SnapshotReader* reader, const SnapshotView* view, QueryOutput* out)
+{
+    OutputFormat(out, "generation\t%llu\n", (unsigned long long)view->generation);
+    OutputFormat(out, "order\t%s\n", view->order == 0 ? "most recent first" : "most used first");
+    OutputFormat(out, "entries\t%u of %u\n", view->count, view->total);
+    OutputFormat(out, "with text\t%u\n", view->withText);
+    OutputFormat(out, "publishes\t%u\n", reader->header->publishes);
+    OutputFormat(out, "segment\t%zu bytes\n", reader->shared.size);
+}
+
+// --- Output ---
+
+static void
+QuerySleepMs(unsigned ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec delay = { 0, (long)ms * 1000000L };
+    nanosleep(&delay, NULL);
+#endif
+}
+
+static bool
+QueryCopyToClipboard(const char* text, size_t size)
+{
+#ifdef _WIN32
+    size_t length = Utf8DecodedLength(text, size);
+    if (length == UTF8_INVALID) return false;
+    HGLOBAL memory = GlobalAlloc(GMEM_MOVEABLE, (length + 1) * sizeof(wchar_t));
+    if (!memory) return false;
+    wchar_t* wide = GlobalLock(memory);
+    Utf8Decode(text, size, wide);
+    wide[length] = L'\0';
+    GlobalUnlock(memory);
+    bool copied = false;
+    if (OpenClipboard(NULL)) {
+        EmptyClipboard();
+        copied = SetClipboardData(CF_UNICODETEXT, memory) != NULL; // The clipboard owns it from here
+        CloseClipboard();
+    }
+    if (!copied) GlobalFree(memory);
+    return copied;
+#else
+    (void)text; (void)size;
+    fprintf(stderr, "mclip_query: copy needs the Windows clipboard; use get and your system's tool\n");
+    return false;
+#endif
+}
+
+// Runs the command on a snapshot that validates, then prints its output
+static QueryStatus
+QueryRun(const SnapshotReader* reader, const QueryArgs* args)
+{
+    QueryOutput out = { 0 };
+    bool read = false;
+    for (int attempt = 0; attempt < QUERY_ATTEMPTS && !read; ++attempt) {
+        SnapshotView view;
+        if (!SnapshotReadBegin(reader, &view)) {
+            QuerySleepMs(QUERY_RETRY_MS); // Starting up, or a publish caught at a bad time
+            continue;
+        }
+        out.size = 0;
+        out.error = NULL;
+        out.entryBytes = 0;
+        switch (args->command) {
+        case QUERY_LIST:
+        case QUERY_FIND: QueryRunList(&view, args, &out); break;
+        case QUERY_GET:
+        case QUERY_COPY: QueryRunGet(&view, args, &out); break;
+        case QUERY_STAT: QueryRunStat(reader, &view, &out); break;
+        }
+        read = SnapshotReadValidate(reader, &view);
+    }
+
+    QueryStatus status = QUERY_OK;
+    if (!read) {
+        fprintf(stderr, "mclip_query: no snapshot published (mclip is starting or busy)\n");
+        status = QUERY_FAILED;
+    } else if (out.failed) {
+        fprintf(stderr, "mclip_query: out of memory\n");
+        status = QUERY_FAILED;
+    } else if (out.error) {
+        fprintf(stderr, "mclip_query: %s\n", out.error);
+        status = QUERY_FAILED;
+    } else if (args->command == QUERY_COPY) {
+        if (!QueryCopyToClipboard(out.data, out.entryBytes)) status = QUERY_FAILED;
+    } else if (out.size > 0 && fwrite(out.data, 1, out.size, stdout) != out.size) {
+        status = QUERY_FAILED;
+    }
+    free(out.data);
+    return status;
+}
+
+// --- Command Line ---
+
+static void
+QueryUsage(void)
+{
+    fprintf(stderr,
+            "usage: mclip_query [--name NAME] list [N]\n"
+            "       mclip_query [--name NAME] find TEXT [N]\n"
+            "       mclip_query [--name NAME] get INDEX\n"
+            "       mclip_query [--name NAME] copy INDEX\n"
+            "       mclip_query [--name NAME] stat\n");
+}
+
+static bool
+QueryParseNumber(const char* text, size_t* value)
+{
+    char* end;
+    unsigned long long number = strtoull(text, &end, 10);
+    if (end == text || *end != '\0' || text[0] == '-') return false;
+    *value = (size_t)number;
+    return true;
+}
+
+static bool
+QueryParseArgs(int argc, char** argv, const char** name, QueryArgs* args)
+{
+    int i = 1;
+    if (i + 1 < argc && strcmp(argv[i], "--name") == 0) {
+        *name = argv[i + 1];
+        i += 2;
+    }
+    if (i >= argc) return false;
+    const char* command = argv[i++];
+    int rest = argc - i;
+    memset(args, 0, sizeof(*args));
+    args->count = QUERY_DEFAULT_COUNT;
+
+    if (strcmp(command, "list") == 0 && rest <= 1) {
+        args->command = QUERY_LIST;
+        return rest == 0 || QueryParseNumber(argv[i], &args->count);
+    }
+    if (strcmp(command, "find") == 0 && (rest == 1 || rest == 2)) {
+        args->command = QUERY_FIND;
+        args->text = argv[i];
+        args->textLength = strlen(argv[i]);
+        return rest == 1 || QueryParseNumber(argv[i + 1], &args->count);
+    }
+    if ((strcmp(command, "get") == 0 || strcmp(command, "copy") == 0) && rest == 1) {
+        args->command = command[0] == 'g' ? QUERY_GET : QUERY_COPY;
+        return QueryParseNumber(argv[i], &args->index);
+    }
+    if (strcmp(command, "stat") == 0 && rest == 0) {
+        args->command = QUERY_STAT;
+        return true;
+    }
+    return false;
+}
+
+int
+main(int argc, char** argv)
+{
+    const char* name = SNAPSHOT_DEFAULT_NAME;
+    QueryArgs args;
+    if (!QueryParseArgs(argc, argv, &name, &args)) {
+        QueryUsage();
+        return QUERY_USAGE;
+    }
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY); // Texts keep their own line endings
+#endif
+
+    SnapshotReader reader;
+    if (!SnapshotReaderOpen(&reader, name)) {
+        fprintf(stderr, "mclip_query: no history snapshot '%s' (is mclip running?)\n", name);
+        return QUERY_FAILED;
+    }
+    QueryStatus status = QueryRun(&reader, &args);
+    SnapshotReaderClose(&reader);
+    return status;
+}